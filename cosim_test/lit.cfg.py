@@ -22,7 +22,7 @@ config.name = 'CIRCT-HLS cosim'
 config.test_format = lit.formats.ShTest(not llvm_config.use_lit_shell)
 
 # suffixes: A list of file extensions to treat as test files.
-config.suffixes = ['.mlir', '.c']
+config.suffixes = ['.mlir', '.c', '.test']
 
 # test_source_root: The root path where tests are located.
 config.test_source_root = os.path.dirname(__file__)
@@ -41,6 +41,41 @@ config.substitutions.append(('%circt_hls_obj_root', config.circt_hls_obj_root))
 
 llvm_config.with_system_environment(['HOME', 'INCLUDE', 'LIB', 'TMP', 'TEMP'])
 
+llvm_config.with_system_environment(['HLSTOOL_SIM_SERVER'])
+
+# Run the testbenches against simulation servers, which are shared by all tests
+# of identical RTL (see hlstool --sim_server).
+if lit_config.params.get('sim_server'):
+  config.environment['HLSTOOL_SIM_SERVER'] = '1'
+
+# Each test builds and runs a multi-threaded Verilator model. The threads of
+# concurrent tests are drawn from a pool which is shared by all tests (see the
+# ThreadPool of hlstool), such that the suite never runs more threads than there
+# are cores, regardless of the test parallelism. Tests wait for threads to be
+# returned to the pool once it is exhausted. The pool size is set through
+# '--param threads=<n>'; 0 disables the pool.
+pool_threads = int(lit_config.params.get('threads', os.cpu_count() or 1))
+if pool_threads > 0:
+  config.environment['HLSTOOL_THREAD_POOL'] = '{}:{}'.format(
+      os.path.join(config.test_exec_root, 'thread_pool'), pool_threads)
+
+# Tests may check the cycle counts and call latencies of their simulation
+# against the baseline of their kernel through '%perf_check' (see
+# perf_check.py), which must be recorded along with the RUN line. No test of
+# the suites does so yet, since no baselines have been measured; the script
+# itself is checked by perf_check/perf_check.test.
+# '--param update_perf=1' rewrites the baselines of the tests which are run from
+# their results, and '--param perf_tolerance=<fraction>' allows the baselines to
+# be exceeded by the given fraction.
+config.substitutions.append(
+    ('%perf_check', '"{}" "{}"'.format(
+        config.python_executable,
+        os.path.join(config.test_source_root, 'perf_check.py'))))
+if lit_config.params.get('update_perf'):
+  config.environment['HLT_PERF_UPDATE'] = '1'
+if lit_config.params.get('perf_tolerance'):
+  config.environment['HLT_PERF_TOLERANCE'] = lit_config.params['perf_tolerance']
+
 llvm_config.use_default_substitutions()
 
 # excludes: A list of directories to exclude from the testsuite. The 'Inputs'
@@ -68,7 +103,8 @@ if config.polygeist_bin_dir != "":
 
 # Maximum 500 seconds for each test. This might be too much but some of these
 # tests might be very slow depending on the executing machine capabilities and the
-# amount of test parallelism used.
+# amount of test parallelism used, including the time which a test waits on the
+# thread pool.
 lit_config.maxIndividualTestTime = 500
 
 llvm_config.add_tool_substitutions(tools, tool_dirs)
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+""" Checks the end-of-run metrics of a cosim test against upper bounds, such
+that throughput regressions fail the test suite like functional regressions.
+The metrics are read from the call statistics which the simulator writes when
+it finishes (call_stats.json, see SimLog.h), and printed as 'PERF: <metric> =
+<value>' lines, which tests may FileCheck as well:
+
+  cycles    the cycle of the last output of the kernel
+  calls     the number of kernel calls
+  latency   the mean latency of a call, in cycles
+  ii        the mean interval between consecutive calls, in cycles
+
+  perf_check.py [--stats call_stats.json] [--max cycles=<n> ...] [baseline]
+
+Bounds are given through '--max', and by the baseline file of the test (by
+convention '<kernel>.perf', next to the testbench), which holds a
+'<metric> <= <value>' line per bound; '#' starts a comment. A baseline bound
+may be exceeded by the fraction $HLT_PERF_TOLERANCE (0 by default). If
+$HLT_PERF_UPDATE is set, the baseline file is instead (re)written from the
+metrics of the run, which then always passes. Otherwise, a missing baseline
+file fails the check, such that a test cannot silently check nothing.
+
+The cosim suite substitutes '%perf_check' by this script; pass
+'--param update_perf=1' to lit to record the baselines of the tests which are
+run, and '--param perf_tolerance=<fraction>' to set the tolerance.
+"""
+import argparse
+import json
+import math
+import os
+import re
+import sys
+
+METRICS = ["cycles", "calls", "latency", "ii"]
+BOUND = re.compile(r"^(\w+)\s*<=\s*([0-9.eE+-]+)$")
+
+
+def read_metrics(path):
+  with open(path, "r") as f:
+    stats = json.load(f)
+  return {
+      "cycles": stats["cycles"],
+      "calls": stats["calls"],
+      "latency": stats["latency"]["mean"],
+      "ii": stats["ii"]["mean"],
+  }
+
+
+def parse_bound(spec, where):
+  m = BOUND.match(spec.strip())
+  if not m or m.group(1) not in METRICS:
+    sys.exit(f"{where}: expected '<metric> <= <value>' of a metric of "
+             f"{', '.join(METRICS)}, got '{spec.strip()}'")
+  return m.group(1), float(m.group(2))
+
+
+def read_baseline(path):
+  bounds = {}
+  with open(path, "r") as f:
+    for lineNo, line in enumerate(f, start=1):
+      line = line.split("#", 1)[0]
+      if not line.strip():
+        continue
+      metric, value = parse_bound(line, f"{path}:{lineNo}")
+      bounds[metric] = value
+  return bounds
+
+
+def write_baseline(path, metrics):
+  # Bounds are recorded for the metrics which a lowering change may regress;
+  # the number of calls is fixed by the testbench.
+  with open(path, "w") as f:
+    f.write("# Performance baseline of the cosim test; see "
+            "cosim_test/perf_check.py.\n")
+    for metric in ["cycles", "latency", "ii"]:
+      value = metrics[metric]
+      # Rounded up, such that the run meets its own baseline.
+      if isinstance(value, float):
+        value = f"{math.ceil(value * 100) / 100:.2f}"
+      f.write(f"{metric} <= {value}\n")
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Check the metrics of a cosim test against upper bounds.")
+  parser.add_argument("baseline", nargs="?", help="Baseline file of the test.")
+  parser.add_argument("--stats",
+                      default="call_stats.json",
+                      help="Call statistics of the simulation.")
+  parser.add_argument("--max",
+                      action="append",
+                      default=[],
+                      metavar="METRIC=VALUE",
+                      help="Upper bound of a metric; not subject to the "
+                      "tolerance.")
+  args = parser.parse_args()
+
+  if not os.path.exists(args.stats):
+    sys.exit(f"PERF: {args.stats} was not written by the simulator")
+  metrics = read_metrics(args.stats)
+  for metric in METRICS:
+    print(f"PERF: {metric} = {metrics[metric]}")
+
+  if args.baseline and os.environ.get("HLT_PERF_UPDATE"):
+    write_baseline(args.baseline, metrics)
+    print(f"PERF: wrote {args.baseline}")
+    return
+
+  tolerance = float(os.environ.get("HLT_PERF_TOLERANCE", "0"))
+  bounds = []
+  for spec in args.max:
+    metric, value = parse_bound(spec.replace("=", "<=", 1), "--max")
+    bounds.append((metric, value, "--max"))
+  if args.baseline and os.path.exists(args.baseline):
+    for metric, value in read_baseline(args.baseline).items():
+      bounds.append((metric, value * (1 + tolerance), args.baseline))
+  elif args.baseline:
+    sys.exit(f"PERF: no baseline at {args.baseline}; record it with "
+             "'--param update_perf=1'")
+
+  failed = False
+  for metric, bound, where in bounds:
+    if metrics[metric] > bound:
+      print(f"PERF: {metric} of {metrics[metric]} exceeds the bound of "
+            f"{bound:g} ({where})")
+      failed = True
+  if failed:
+    sys.exit(1)
+
+
+if __name__ == "__main__":
+  main()
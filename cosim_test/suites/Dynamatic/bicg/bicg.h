@@ -1,6 +1,12 @@
 #pragma once
 
+#ifndef NX
 #define NX 30
+#endif
+#ifndef NY
 #define NY 30
+#endif
+#ifndef N
 #define N 30
+#endif
 int bicg(int A[N][N], int s[N], int q[N], int p[N], int r[N]);
@@ -9,7 +9,7 @@
 #include <stdlib.h>
 
 #ifndef N_KERNEL_CALLS
-#define N_KERNEL_CALLS 10
+#define N_KERNEL_CALLS 1
 #endif
 
 int main(void) {
@@ -23,7 +23,7 @@ int main(void) {
       idx[i][j] = rand() % 100;
     }
   }
-  for (int i = 0; i < 1; ++i) {
+  for (int i = 0; i < N_KERNEL_CALLS; ++i) {
     fir(d_i[i], idx[i]);
   }
   return 0;
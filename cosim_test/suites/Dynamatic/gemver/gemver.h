@@ -1,4 +1,6 @@
 #pragma once
+#ifndef N
 #define N 30
+#endif
 void gemver(int alpha, int beta, int A[N][N], int u1[N], int v1[N], int u2[N],
             int v2[N], int w[N], int x[N], int y[N], int z[N]);
\ No newline at end of file
@@ -1,4 +1,6 @@
 #pragma once
 
+#ifndef N
 #define N 1000
+#endif
 void histogram(int feature[N], int weight[N], int hist[N], int n);
\ No newline at end of file
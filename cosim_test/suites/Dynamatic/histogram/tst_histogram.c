@@ -8,16 +8,18 @@
 #include "histogram.h"
 #include <stdlib.h>
 
-#define AMOUNT_OF_TEST 1
+#ifndef N_KERNEL_CALLS
+#define N_KERNEL_CALLS 1
+#endif
 
 int main(void) {
-  int feature[AMOUNT_OF_TEST][N];
-  int weight[AMOUNT_OF_TEST][N];
-  int hist[AMOUNT_OF_TEST][N];
-  int n[AMOUNT_OF_TEST];
+  int feature[N_KERNEL_CALLS][N];
+  int weight[N_KERNEL_CALLS][N];
+  int hist[N_KERNEL_CALLS][N];
+  int n[N_KERNEL_CALLS];
 
   srand(13);
-  for (int i = 0; i < AMOUNT_OF_TEST; ++i) {
+  for (int i = 0; i < N_KERNEL_CALLS; ++i) {
     n[i] = N;
     for (int j = 0; j < N; ++j) {
       feature[i][j] = rand() % N;
@@ -26,7 +28,7 @@ int main(void) {
     }
   }
 
-  for (int i = 0; i < AMOUNT_OF_TEST; ++i) {
+  for (int i = 0; i < N_KERNEL_CALLS; ++i) {
     histogram(feature[i], weight[i], hist[i], n[i]);
   }
   return 0;
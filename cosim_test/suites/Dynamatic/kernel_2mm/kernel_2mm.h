@@ -1,8 +1,18 @@
 #pragma once
+#ifndef NI
 #define NI 10
+#endif
+#ifndef NJ
 #define NJ 10
+#endif
+#ifndef NK
 #define NK 10
+#endif
+#ifndef NL
 #define NL 10
+#endif
+#ifndef N
 #define N 10
+#endif
 void kernel_2mm(int alpha, int beta, int tmp[N][N], int A[N][N], int B[N][N],
                 int C[N][N], int D[N][N]);
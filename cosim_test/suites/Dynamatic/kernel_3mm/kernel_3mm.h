@@ -1,9 +1,21 @@
 #pragma once
+#ifndef NI
 #define NI 10
+#endif
+#ifndef NJ
 #define NJ 10
+#endif
+#ifndef NK
 #define NK 10
+#endif
+#ifndef NL
 #define NL 10
+#endif
+#ifndef NM
 #define NM 10
+#endif
+#ifndef N
 #define N 10
+#endif
 void kernel_3mm(int A[N][N], int B[N][N], int C[N][N], int D[N][N], int E[N][N],
                 int F[N][N], int G[N][N]);
\ No newline at end of file
@@ -1,7 +1,15 @@
 #pragma once
+#ifndef A_ROWS
 #define A_ROWS 30
+#endif
+#ifndef A_COLS
 #define A_COLS 30
+#endif
+#ifndef B_ROWS
 #define B_ROWS 30
+#endif
+#ifndef B_COLS
 #define B_COLS 30
+#endif
 void matrix(int in_a[A_ROWS][A_COLS], int in_b[A_COLS][B_COLS],
             int out_c[A_ROWS][B_COLS]);
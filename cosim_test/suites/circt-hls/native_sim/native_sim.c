@@ -0,0 +1,13 @@
+int native_sim(int a[8]) {
+  // Lowered to an internal memory of the kernel. Each call only stores the
+  // elements of its positive inputs, so the others are read as left by the
+  // previous call, or as zero on the first call after a reset.
+  int scaled[8];
+  for (int i = 0; i < 8; ++i)
+    if (a[i] > 0)
+      scaled[i] = 3 * a[i];
+  int sum = 0;
+  for (int i = 0; i < 8; ++i)
+    sum += scaled[7 - i] - a[i];
+  return sum;
+}
@@ -0,0 +1,25 @@
+// The testbench is run twice against the same simulation server, which resets
+// the simulator in place in between. Both runs must start from a cleared
+// internal memory, and so return the same checksum.
+// RUN: hlstool --no_trace --rebuild --tb_file %s dynamic-polygeist --run_sim --native_sim --sim_server
+// RUN: FileCheck --input-file *tb_output.txt %s
+// RUN: hlstool --no_trace --rebuild --tb_file %s dynamic-polygeist --run_sim --native_sim --sim_server
+// RUN: FileCheck --input-file *tb_output.txt %s
+
+// CHECK: 2111
+
+#ifndef N_KERNEL_CALLS
+#define N_KERNEL_CALLS 10
+#endif
+
+int native_sim(int a[8]);
+int main(void) {
+  int a[N_KERNEL_CALLS][8];
+  for (int i = 0; i < N_KERNEL_CALLS; ++i)
+    for (int j = 0; j < 8; ++j)
+      a[i][j] = i * j - 4;
+  int checksum = 0;
+  for (int i = 0; i < N_KERNEL_CALLS; ++i)
+    checksum += native_sim(a[i]);
+  return checksum;
+}
@@ -0,0 +1,7 @@
+int tile_views(int tile[4][8]) {
+  int sum = 0;
+  for (int y = 0; y < 4; ++y)
+    for (int x = 0; x < 4; ++x)
+      sum += tile[y][x];
+  return sum;
+}
@@ -0,0 +1,26 @@
+// RUN: hlstool --no_trace --rebuild --tb_file %s dynamic-polygeist --run_sim --strided_memrefs
+
+// Each call passes a different 4x4 tile of the same 8x8 buffer, such that the
+// memory of the kernel is bound to a new view on every call. The tile sums are
+// 216, 280, 728 and 792, whereas a stale view would repeat the first one.
+// RUN: FileCheck --input-file *tb_output.txt %s
+
+// CHECK: 2016
+
+#ifndef N_KERNEL_CALLS
+#define N_KERNEL_CALLS 4
+#endif
+
+int tile_views(int tile[4][8]);
+int main(void) {
+  int buffer[8][8];
+  for (int y = 0; y < 8; ++y)
+    for (int x = 0; x < 8; ++x)
+      buffer[y][x] = 8 * y + x;
+  int checksum = 0;
+  for (int i = 0; i < N_KERNEL_CALLS; ++i) {
+    int *corner = &buffer[4 * (i / 2 % 2)][4 * (i % 2)];
+    checksum += tile_views((int(*)[8])corner);
+  }
+  return checksum;
+}
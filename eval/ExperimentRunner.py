@@ -5,9 +5,12 @@ import sys
 sys.path.append("../calyx/fud/fud/stages/vivado/")
 from rpt import RPTParser
 
+from hltlog import HLTLog
+from compileprofile import CompileProfile, get_superlinear
+from resultdb import ResultDB, compare, print_regressions
+
 import subprocess
-from vcdvcd import VCDVCD
-from dataclasses import dataclass
+from dataclasses import dataclass, replace
 import os
 import json
 import argparse
@@ -16,9 +19,22 @@ import concurrent
 import re
 import shutil
 import glob
+import hashlib
+import itertools
+import math
+import posixpath
+import shlex
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+from contextlib import contextmanager, nullcontext
 
 DYNAMATIC_DIR = ""
 
+# Exit code of hlstool when the simulation reached the cycle limit of
+# --max_cycles.
+CYCLE_LIMIT_EXIT_CODE = 3
+
 
 def print_yellow(string):
   print("\033[93m{}\033[00m".format(string))
@@ -125,6 +141,27 @@ def parse_timing_report(timing_file):
   return report
 
 
+def parse_power_report(power_file):
+  """
+  Parses the total and dynamic on-chip power, in W, from a report_power report
+  generated by vivado. The summary of the report looks like:
+  | Total On-Chip Power (W)  | 0.593        |
+  | Dynamic (W)              | 0.108        |
+  | Device Static (W)        | 0.485        |
+  """
+  power = {}
+  with open(power_file, "r") as f:
+    for line in f:
+      m = re.match(r"\|\s*(Total On-Chip Power|Dynamic) \(W\)\s*\|\s*([\d.]+)",
+                   line)
+      if m and m.group(1) not in power:
+        power[m.group(1)] = float(m.group(2))
+  return {
+      "total": power.get("Total On-Chip Power"),
+      "dynamic": power.get("Dynamic")
+  }
+
+
 def find_row(table, colname, key, certain=True):
   for row in table:
     if row[colname] == key:
@@ -148,11 +185,16 @@ def to_int(s):
 
 
 class VCDEvaluator:
+  """ Counts the clock cycles after reset in a VCD trace. The trace is parsed
+  in a single pass which only tracks the clock and reset signals, such that
+  large traces need not fit in memory. Prefer HLTLogEval, which reads the
+  cycle count from the summary of the simulator log."""
+
+  CLOCKS = ["clock", "clk", "TOP.clock", "TOP.clk"]
+  RESETS = ["reset", "rst", "TOP.reset", "TOP.rst"]
 
   def __init__(self, fn):
-    print_yellow(
-        "Loading VCD trace, this might take a while for large files...")
-    self.vcd = VCDVCD(fn)
+    self.fn = fn
     self.cycles = None
 
   def exectime(self, cp):
@@ -162,45 +204,82 @@ class VCDEvaluator:
     cycles = self.get_cycles()
     return cycles * cp
 
-  def getTrace(self, signalcandidates):
-    trace = None
+  @staticmethod
+  def tokens(f):
+    for line in f:
+      yield from line.split()
+
+  @staticmethod
+  def find_id(ids, signalcandidates, kind):
     for n in signalcandidates:
-      if n in self.vcd.signals:
-        trace = self.vcd[n]
-        break
-    if trace is None:
-      raise Exception("Could not find clock signal")
-    return trace
+      if n in ids:
+        return ids[n]
+    raise Exception(f"Could not find {kind} signal")
 
   def get_cycles(self):
     """
     Estimates the number of cycles in the vcd file.
     """
-    if self.cycles:
+    if self.cycles is not None:
       return self.cycles
 
-    clockTrace = self.getTrace(["clock", "clk", "TOP.clock", "TOP.clk"])
-    resetTrace = self.getTrace(["reset", "rst", "TOP.reset", "TOP.rst"])
-
-    if len(resetTrace.tv) != 2:
+    with open(self.fn, "r") as f:
+      tokens = self.tokens(f)
+
+      # Map the (hierarchical) names of the signals to their identifiers.
+      ids = {}
+      scopes = []
+      for token in tokens:
+        if token == "$scope":
+          next(tokens)
+          scopes.append(next(tokens))
+        elif token == "$upscope":
+          scopes.pop()
+        elif token == "$var":
+          next(tokens)
+          next(tokens)
+          id = next(tokens)
+          name = ".".join(scopes + [next(tokens)])
+          ids.setdefault(name, id)
+        elif token == "$enddefinitions":
+          break
+      clockId = self.find_id(ids, self.CLOCKS, "clock")
+      resetId = self.find_id(ids, self.RESETS, "reset")
+
+      # The reset signal is expected to change once after its initial value.
+      # Every change of the clock after that is half a cycle.
+      time = 0
+      resetChanges = 0
+      outOfReset = None
+      clockChanges = 0
+      for token in tokens:
+        c = token[0]
+        if c == "#":
+          time = int(token[1:])
+          continue
+        if c == "$":
+          if token == "$comment":
+            while next(tokens) != "$end":
+              pass
+          continue
+        if c in "bBrR":
+          id = next(tokens)
+        else:
+          id = token[1:]
+        if id == resetId:
+          resetChanges += 1
+          if resetChanges == 2:
+            outOfReset = time
+        elif id == clockId and outOfReset is not None and time > outOfReset:
+          clockChanges += 1
+
+    if resetChanges != 2:
       raise Exception("Expected two values in the reset signal vector")
 
-    # [1] gives us the value after the init value of the reset signal
-    # [0] indexes into the (step, value) tuple
-    outOfReset = resetTrace.tv[1][0]
-
-    OORClockTrace = None
-
-    # Find the first index in the clock trace after the reset signal has flipped
-    for i in range(len(clockTrace.tv)):
-      if clockTrace.tv[i][0] > outOfReset:
-        OORClockTrace = clockTrace.tv[i:]
-        break
-
     # number of cycles is equal to the number of entries in the clock trace divided
     # by two (high, followed by low).
-    self.cycles = len(OORClockTrace) // 2
-    return self.get_cycles()
+    self.cycles = clockChanges // 2
+    return self.cycles
 
 
 def run_hls_tool(args):
@@ -223,6 +302,7 @@ def run_hls_tool(args):
   proc.wait()
   stdErr = proc.stderr.read().decode("utf-8")
   code = proc.returncode
+  return code
 
   # if code and code != 0 or stdErr:
   #   print(stdErr)
@@ -243,23 +323,332 @@ class HLTLogEval:
     return cycles * cp
 
   def get_cycles(self):
-    """ The HLT log file has lines on the format
-    {clock cycle} @ {info message}
+    """ The number of cycles executed, as recorded in the summary of the HLT
+    event log. This is the cycle at which the output of the last call was
+    handed to the host.
+    """
+    if self.cycles is None:
+      self.cycles = HLTLog(self.log_file).cycles
+    return self.cycles
 
-    We assume that the number of cycles executed was the number of cycles for the
-    last "OUT TO WAITER" message.
-  """
-    if self.cycles:
-      return self.cycles
 
-    with open(self.log_file, "r") as f:
-      lines = f.readlines()
-      for line in reversed(lines):
-        if "OUT TO WAITER" in line:
-          self.cycles = int(line.split("@")[0].strip())
-          return self.get_cycles()
+class HLTMemStatsEval:
+
+  def __init__(self, stats_file):
+    with open(stats_file, "r") as f:
+      self.stats = json.load(f)
+
+  def get_bytes(self):
+    """ Total number of bytes loaded and stored across all memories."""
+    return sum(mem["bytes"] for mem in self.stats["memories"])
+
+  def get_bytes_per_cycle(self):
+    cycles = self.stats["cycles"]
+    return self.get_bytes() / cycles if cycles else 0.0
+
+  def get_cache_hit_rate(self):
+    """ Hit rate across all memories with a cache, or None if no memory has a
+    cache."""
+    caches = [mem["cache"] for mem in self.stats["memories"] if "cache" in mem]
+    accesses = sum(c["hits"] + c["misses"] for c in caches)
+    if not caches:
+      return None
+    return sum(c["hits"] for c in caches) / accesses if accesses else 0.0
+
+  def get_stall_cycles(self):
+    """ Total number of cycles in which any memory port stalled."""
+    return sum(port["stallCycles"]
+               for mem in self.stats["memories"]
+               for port in mem["loads"] + mem["stores"])
 
-    raise Exception("Could not find number of cycles in HLT log file")
+
+class HLTCallStatsEval:
+
+  def __init__(self, stats_file):
+    with open(stats_file, "r") as f:
+      self.stats = json.load(f)
+
+  def get_calls(self):
+    return self.stats["calls"]
+
+  def get_latency(self):
+    """ Latency statistics (min, mean, p99, max) of the kernel calls, in
+    cycles."""
+    return self.stats["latency"]
+
+  def get_ii(self):
+    """ Statistics (min, mean, p99, max) of the initiation interval between
+    consecutive kernel calls, in cycles."""
+    return self.stats["ii"]
+
+
+class HLTChannelStatsEval:
+
+  def __init__(self, stats_file):
+    with open(stats_file, "r") as f:
+      self.stats = json.load(f)
+
+  def get_most_stalled(self, n):
+    """ The n channels which stalled (valid without ready) for the most
+    cycles, as (name, stall cycles, fire cycles) tuples."""
+    channels = sorted(self.stats["channels"],
+                      key=lambda c: c["stall"],
+                      reverse=True)
+    return [(c["name"], c["stall"], c["fire"]) for c in channels[:n]]
+
+
+class HLTScheduleEval:
+
+  def __init__(self, schedule_file):
+    with open(schedule_file, "r") as f:
+      self.schedule = json.load(f)
+
+  def get_loops(self):
+    """ The II, latency and bottleneck of each pipelined loop of the kernel,
+    as scheduled by the static flow."""
+    keys = ["loop", "ii", "latency", "trip_count", "bottleneck"]
+    return [{k: loop[k] for k in keys} for loop in self.schedule["loops"]]
+
+
+class HLTResourceEstimateEval:
+
+  def __init__(self, estimate_file):
+    with open(estimate_file, "r") as f:
+      self.estimate = json.load(f)
+
+  def get_estimate(self):
+    """ The LUTs, registers and DSPs of the kernel, and the delay (in ns) of
+    its critical path, as estimated before synthesis from its handshake IR."""
+    return {k: self.estimate[k] for k in ["luts", "ffs", "dsps", "delay"]}
+
+
+class HLTIICheckEval:
+
+  def __init__(self, check_file):
+    with open(check_file, "r") as f:
+      self.check = json.load(f)
+
+  def get_mismatches(self):
+    """ The memories whose stores were measured at a different II than the
+    schedule expects, as (argument, expected, measured) tuples."""
+    return [(m["arg"], m["expected"], m["measured"])
+            for m in self.check["memories"]
+            if m["measured"] is not None and m["measured"] != m["expected"]]
+
+
+def get_total_memory():
+  # Physical memory of the host, in GB.
+  return os.sysconf("SC_PAGE_SIZE") * os.sysconf("SC_PHYS_PAGES") / 2**30
+
+
+class ResourcePool:
+  """ The cores and memory (in GB) of the host, which the phases of the
+  experiments acquire while they run. Phases run as soon as the resources
+  which they need are free, such that the phases of different experiments
+  overlap."""
+
+  def __init__(self, cores, memory, max_jobs=0):
+    self.cores = cores
+    self.memory = memory
+    self.max_jobs = max_jobs
+    self.free_cores = cores
+    self.free_memory = memory
+    self.jobs = 0
+    self.cond = threading.Condition()
+
+  def fits(self, cores, memory):
+    if self.max_jobs and self.jobs >= self.max_jobs:
+      return False
+    return self.free_cores >= cores and self.free_memory >= memory
+
+  @contextmanager
+  def acquire(self, cores, memory):
+    # A phase which needs more than the host has runs on its own.
+    cores = min(cores, self.cores)
+    memory = min(memory, self.memory)
+    with self.cond:
+      self.cond.wait_for(lambda: self.fits(cores, memory))
+      self.free_cores -= cores
+      self.free_memory -= memory
+      self.jobs += 1
+    try:
+      yield
+    finally:
+      with self.cond:
+        self.free_cores += cores
+        self.free_memory += memory
+        self.jobs -= 1
+        self.cond.notify_all()
+
+
+class LocalExecutor:
+  """ Runs the phases of the experiments on this host, each once the
+  resources of the pool which it occupies are free."""
+
+  def __init__(self, pool):
+    self.pool = pool
+
+  @contextmanager
+  def session(self, experiment):
+    experiment.run_tb = experiment.tb
+    experiment.run_outdir = experiment.outdir
+    yield
+
+  def phase(self, experiment, phase):
+    return self.pool.acquire(*experiment.get_cost(phase))
+
+  def run(self, experiment, phase, hlstool_args):
+    return run_hls_tool(hlstool_args)
+
+
+# The files of the output directory of an experiment which are fetched from
+# the node which ran it: the simulator log, the Vivado reports, the
+# statistics and profiles which hlstool writes, and the RTL of the kernel,
+# which Fmax sweeps synthesize on this host.
+RESULT_FILTERS = [
+    "--include=*/", "--include=sim.log", "--include=*.rpt",
+    "--include=*.json", "--include=*.sv", "--include=*.vhd", "--exclude=*",
+    "--prune-empty-dirs"
+]
+
+
+class RemoteExecutor:
+  """ Runs the phases of the experiments on other nodes. The sources next to
+  the testbench of an experiment are shipped to '<root>/<key>/src', wherein
+  'key' is the hash of the inputs of the experiment (see get_input_hash), and
+  hlstool runs with '<root>/<key>/out' as its output directory, such that
+  the build cache of hlstool is kept across runs of the same inputs. The
+  results are fetched back into the output directory of the experiment once
+  it has run, even if a phase failed. hlstool must be on the PATH of the
+  nodes."""
+
+  def __init__(self, root):
+    self.root = root
+
+  @contextmanager
+  def session(self, experiment):
+    with self.node(experiment) as node:
+      experiment.node = node
+      workdir = posixpath.join(self.root, experiment.key)
+      srcdir = experiment.get_src_dir()
+      remote_src = posixpath.join(workdir, "src")
+      experiment.run_tb = (remote_src if os.path.isdir(experiment.tb) else
+                           posixpath.join(remote_src,
+                                          os.path.basename(experiment.tb)))
+      experiment.run_outdir = posixpath.join(workdir, "out")
+      self.makedirs(node, [remote_src, experiment.run_outdir])
+      self.transfer([
+          os.path.join(srcdir or ".", ""),
+          self.location(node, remote_src + "/")
+      ])
+      try:
+        yield
+      finally:
+        self.transfer([
+            *RESULT_FILTERS,
+            self.location(node, experiment.run_outdir + "/"),
+            os.path.join(experiment.outdir, "")
+        ])
+
+  def phase(self, experiment, phase):
+    # Remote resources are managed by the node or the scheduler.
+    return nullcontext()
+
+  def run(self, experiment, phase, hlstool_args):
+    cores, memory = experiment.get_cost(phase)
+    return run_hls_tool(
+        self.wrap(experiment.node, " ".join(hlstool_args), cores, memory))
+
+  def transfer(self, rsync_args):
+    print_yellow("Transferring: " + " ".join(rsync_args[-2:]))
+    res = subprocess.run(["rsync", "-a", *rsync_args])
+    if res.returncode:
+      raise Exception(f"Failed to transfer {rsync_args[-2]}")
+
+
+class SSHExecutor(RemoteExecutor):
+  """ Runs each experiment on one of a list of hosts, reached through ssh
+  and rsync. All phases of an experiment run on the same host, and each host
+  runs up to 'jobs_per_host' experiments at once."""
+
+  def __init__(self, hosts, root, jobs_per_host=1):
+    super().__init__(root)
+    self.free = {host: max(jobs_per_host, 1) for host in hosts}
+    self.cond = threading.Condition()
+
+  @contextmanager
+  def node(self, experiment):
+    with self.cond:
+      self.cond.wait_for(lambda: any(self.free.values()))
+      host = max(self.free, key=self.free.get)
+      self.free[host] -= 1
+    print_yellow(f"Running experiment {experiment.name} on {host}")
+    try:
+      yield host
+    finally:
+      with self.cond:
+        self.free[host] += 1
+        self.cond.notify_all()
+
+  def location(self, node, path):
+    return f"{node}:{path}"
+
+  def makedirs(self, node, dirs):
+    subprocess.run(["ssh", node, "mkdir", "-p", *map(shlex.quote, dirs)],
+                   check=True)
+
+  def wrap(self, node, cmd, cores, memory):
+    # The command is parsed by the local shell, and then by the remote one.
+    return ["ssh", node, shlex.quote("bash -lc " + shlex.quote(cmd))]
+
+
+class SlurmExecutor(RemoteExecutor):
+  """ Runs each phase of the experiments as a Slurm job step (srun) which
+  reserves the cores and memory of the phase (see get_cost). The root
+  directory must be on a filesystem which is shared with the nodes, since
+  the phases of an experiment may run on different nodes."""
+
+  def __init__(self, root, srun_args=[]):
+    super().__init__(os.path.abspath(root))
+    self.srun_args = srun_args
+
+  @contextmanager
+  def node(self, experiment):
+    yield None
+
+  def location(self, node, path):
+    return path
+
+  def makedirs(self, node, dirs):
+    for d in dirs:
+      os.makedirs(d, exist_ok=True)
+
+  def wrap(self, node, cmd, cores, memory):
+    return [
+        "srun", "--nodes=1", "--ntasks=1", f"--cpus-per-task={cores}",
+        f"--mem={max(int(memory), 1)}G", *self.srun_args, "bash", "-lc",
+        shlex.quote(cmd)
+    ]
+
+
+def get_arg_value(args, name, default):
+  # Returns the value of option 'name' within a list of hlstool arguments,
+  # wherein each argument may hold an option and its value.
+  words = " ".join(args).replace("=", " ").split()
+  for i, word in enumerate(words[:-1]):
+    if word == name:
+      return words[i + 1]
+  return default
+
+
+# Vivado is limited to this many threads by synth.tcl.
+SYNTH_CORES = 8
+# The FPGA part which designs are synthesized for.
+VIVADO_PART = "xczu3eg-sbva484-1-e"
+# Memory, in GB, which is reserved for each phase.
+COMPILE_MEMORY = 2
+SIM_MEMORY = 1
+SYNTH_MEMORY = 16
 
 
 @dataclass
@@ -284,19 +673,248 @@ class Experiment:
   sim: bool = True
   # dynamatic or circt-hls
   style: str = "default"
-
-  def run(self):
+  # Clock periods (in ns) which the design is synthesized and implemented at
+  # to find its maximum frequency (see sweep_fmax), if any.
+  fmax_sweep: list = None
+  # Functions of the experiment which are called as its simulation and its
+  # synthesis start, and which return the cycle limit of its simulation, if
+  # any, and whether to skip its synthesis (see explore). These are not
+  # inputs of the experiment: a run which is cut short is not recorded.
+  cycle_budget: object = None
+  skip_synth: object = None
+  # The batch directory which the kernel of the experiment is lowered in (see
+  # batch_lower), if any. This is not an input of the experiment either: the
+  # batch runs the steps which hlstool would.
+  batch_dir: str = None
+
+  def run(self, pool=None, db=None, label=None, force=False, executor=None):
     print_header("Running experiment: " + self.name)
 
-    self.outdir = os.path.join(os.getcwd(), "results", self.experimentName,
-                               self.name)
+    self.outdir = self.get_outdir()
     if not os.path.exists(self.outdir):
       os.makedirs(self.outdir)
 
+    # Experiments whose inputs are unchanged since a previous run reuse the
+    # results of that run.
+    self.key = self.get_input_hash()
+    self.compileprofile = None
+    record = self.lookup(db, force)
+    if record:
+      print_yellow(f"Inputs of experiment {self.name} are unchanged; reusing "
+                   "its previous results.")
+      self.results = record
+      # The reused results are recorded under the label of this run, such that
+      # they are found when comparing against it later.
+      if label is not None and record.get("label") != label:
+        self.results = dict(record, label=label, time=time.time())
+        db.append(self.results)
+      return
+
+    # The phases of an experiment run in order, each once the resources which
+    # it occupies are free. Dynamatic experiments are set up and synthesized
+    # on this host.
+    if pool is None:
+      pool = ResourcePool(multiprocessing.cpu_count(), get_total_memory())
+    if executor is None or self.style != "circt-hls":
+      executor = LocalExecutor(pool)
+    self.executor = executor
+    self.max_cycles = None
+    self.aborted = False
+    self.synth_skipped = False
+    with executor.session(self):
+      with executor.phase(self, "compile"):
+        self.compile()
+      if self.sim and self.style == "circt-hls":
+        with executor.phase(self, "sim"):
+          self.simulate()
+      if self.aborted:
+        print_yellow(f"Aborted experiment {self.name} at its cycle limit of "
+                     f"{self.max_cycles} cycles.")
+        self.results = {"aborted": True, "max_cycles": self.max_cycles}
+        return
+      if self.synth and self.skip_synth and self.skip_synth(self):
+        print_yellow(f"Skipped the synthesis of experiment {self.name}, "
+                     "which is dominated by a synthesized design point.")
+        self.synth_skipped = True
+      if self.synth and not self.synth_skipped:
+        with executor.phase(self, "synth"):
+          self.synthesize()
+    self.sweep = (self.sweep_fmax(pool)
+                  if self.fmax_sweep and not self.synth_skipped else None)
+    self.report()
+
+    if db and not self.synth_skipped:
+      self.results.update({
+          "experiment": self.experimentName,
+          "name": self.name,
+          "key": self.key,
+          "label": label,
+          "time": time.time()
+      })
+      db.append(self.results)
+
+  def get_outdir(self):
+    return os.path.join(os.getcwd(), "results", self.experimentName, self.name)
+
+  def lookup(self, db, force):
+    # Returns the recorded results of a previous run of the experiment with
+    # the same inputs, if any.
+    if not db or force:
+      return None
+    return db.lookup(self.experimentName, self.name, self.get_input_hash())
+
+  def get_input_hash(self):
+    # The results of an experiment are determined by its setup, the sources
+    # next to its testbench (which include the kernel) and the tools which
+    # hlstool runs. Tools are identified by their timestamp and size.
+    h = hashlib.sha256()
+    h.update(
+        json.dumps([
+            self.tb, self.kernel_calls, self.mode, self.args, self.mode_args,
+            self.synth, self.sim, self.style, self.fmax_sweep
+        ]).encode("utf-8"))
+    for root, _, files in sorted(os.walk(self.get_src_dir())):
+      for file in sorted(files):
+        with open(os.path.join(root, file), "rb") as f:
+          h.update(file.encode("utf-8") + hashlib.sha256(f.read()).digest())
+    for tool in [
+        "hlstool", "hls-opt", "circt-opt", "polygeist-opt", "mlir-clang",
+        "firtool", "verilator", "vivado"
+    ]:
+      path = shutil.which(tool)
+      if path:
+        st = os.stat(path)
+        h.update(f"{path}:{st.st_mtime_ns}:{st.st_size};".encode("utf-8"))
+    return h.hexdigest()
+
+  def get_src_dir(self):
+    # The directory of the sources of the experiment, which include the kernel.
+    return self.tb if os.path.isdir(self.tb) else os.path.dirname(self.tb)
+
+  def get_top(self):
+    # The top level of the RTL of the experiment. circt-hls kernels are named
+    # after their testbench ('tst_<kernel>.c').
+    if self.style == "dynamatic":
+      return self.name
+    return os.path.splitext(os.path.basename(self.tb))[0][len("tst_"):]
+
+  def get_cost(self, phase):
+    # Returns the cores and memory (in GB) which 'phase' occupies. Each
+    # simulator instance runs the verilated model on --vlt_threads threads,
+    # and building the model compiles about as many of its sources at once.
+    cpus = multiprocessing.cpu_count()
+    threads = max(int(get_arg_value(self.args, "--vlt_threads", cpus // 2)), 1)
+    instances = int(get_arg_value(self.mode_args, "--sim_instances", 1))
+    if phase == "synth":
+      return SYNTH_CORES, SYNTH_MEMORY
+    if phase == "sim":
+      return (threads * instances if instances else cpus), SIM_MEMORY
+    return (threads if self.sim else 1), COMPILE_MEMORY
+
+  def compile(self):
     if self.style == "circt-hls":
-      self.run_hlstool()
+      # Lower the kernel, and build the simulator if it will be run. Static
+      # modes always lower the kernel.
+      if self.sim:
+        self.run_hlstool("compile", mode_args=["--build_tb", "--build_sim"])
+      elif self.mode.startswith("dynamic"):
+        self.run_hlstool("compile", mode_args=["--lower"])
+      else:
+        self.run_hlstool("compile")
+    elif self.style == "dynamatic":
+      self.setup_dynamatic()
+
+  def simulate(self):
+    # The build cache of hlstool skips the steps of the compile phase. A
+    # simulation which reaches its cycle limit aborts the experiment.
+    self.max_cycles = self.cycle_budget(self) if self.cycle_budget else None
+    phase_args = ([f"--max_cycles={self.max_cycles}"]
+                  if self.max_cycles else [])
+    code = self.run_hlstool("sim",
+                            phase_args=phase_args,
+                            mode_args=["--run_sim"])
+    self.aborted = bool(self.max_cycles) and code == CYCLE_LIMIT_EXIT_CODE
+
+  def synthesize(self):
+    if self.style == "circt-hls":
+      self.run_hlstool("synth", phase_args=["--synth"])
     elif self.style == "dynamatic":
-      self.run_dynamatic()
+      self.run_vivado(self.name)
+
+  def sweep_fmax(self, pool):
+    """ Synthesizes and implements the RTL of the experiment at each clock
+    period of 'fmax_sweep' concurrently, each run once the pool has the
+    resources of a synthesis run free, and returns the period, WNS and
+    achieved frequency (in MHz) of each run. Runs start from the loosest
+    period, and a period which is tighter than a period which failed timing
+    is skipped. Runs are in 'fmax/<period>ns' of the output directory."""
+    periods = sorted(self.fmax_sweep, reverse=True)
+    sources = sorted(
+        glob.glob(os.path.join(self.outdir, "*.sv")) +
+        glob.glob(os.path.join(self.outdir, "*.vhd")))
+    script_dir = os.path.dirname(os.path.realpath(__file__))
+    hlstool_dir = os.path.join(script_dir, os.path.pardir, "tools", "hlstool")
+    synth_tcl = os.path.join(hlstool_dir, "synth.tcl")
+    # The clock constraint of each run is that of the flow, at its period.
+    device_xdc = (os.path.join(DYNAMATIC_DIR, "device.xdc") if self.style
+                  == "dynamatic" else os.path.join(hlstool_dir, "device.xdc"))
+    with open(device_xdc, "r") as f:
+      constraints = f.read()
+    failed = []
+    lock = threading.Lock()
+
+    def run(period):
+      with pool.acquire(SYNTH_CORES, SYNTH_MEMORY):
+        with lock:
+          if any(f > period for f in failed):
+            print_yellow(f"Skipping {period}ns for {self.name}, since a "
+                         "looser period failed timing")
+            return None
+        rundir = os.path.join(self.outdir, "fmax", f"{period:g}ns")
+        os.makedirs(rundir, exist_ok=True)
+        shutil.copy(synth_tcl, rundir)
+        xdc = os.path.join(rundir, "device.xdc")
+        with open(xdc, "w") as f:
+          f.write(
+              re.sub(r"-period\s+[\d.]+", f"-period {period:.2f}",
+                     constraints))
+        vivado_args = [
+            "vivado", "-mode", "batch", "-source", "synth.tcl", "-tclargs",
+            self.get_top(), VIVADO_PART, "vivado", "1", "-", *sources, xdc
+        ]
+        print_yellow(f"Synthesizing {self.name} at {period}ns")
+        subprocess.run([" ".join(vivado_args)],
+                       shell=True,
+                       cwd=rundir,
+                       stdout=subprocess.DEVNULL,
+                       stderr=subprocess.DEVNULL)
+
+      reports = glob.glob(os.path.join(rundir, "**",
+                                       "*timing_summary_routed.rpt"),
+                          recursive=True)
+      wns = None
+      if reports:
+        wns = float(
+            parse_timing_report(reports[0])["Design Timing Summary"]["WNS(ns)"])
+      if wns is None or wns < 0:
+        with lock:
+          failed.append(period)
+      if wns is None:
+        return None
+      return {"period": period, "wns": wns, "fmax": 1000.0 / (period - wns)}
+
+    with ThreadPoolExecutor(max_workers=len(periods)) as executor:
+      return [point for point in executor.map(run, periods) if point]
+
+  def report(self):
+    self.results = {}
+
+    # The compile profile is only written if hlstool ran with
+    # --profile_compile.
+    profilepath = os.path.join(self.outdir, "compile_profile.json")
+    if os.path.exists(profilepath):
+      self.compileprofile = CompileProfile(profilepath)
+      print_yellow(f"Compile time: {self.compileprofile.get_wall():.3f}s")
 
     if self.sim:
       # Extract # of cycles executed from simulator log file.
@@ -304,7 +922,67 @@ class Experiment:
       self.cycleeval = HLTLogEval(simlogpath)
       print_yellow(
           f"Estimated execution time: {self.cycleeval.get_cycles()} cycles")
-    if self.synth:
+      self.results["cycles"] = self.cycleeval.get_cycles()
+
+      callstatspath = os.path.join(self.outdir, "call_stats.json")
+      self.callstats = None
+      if os.path.exists(callstatspath):
+        self.callstats = HLTCallStatsEval(callstatspath)
+        lat = self.callstats.get_latency()
+        ii = self.callstats.get_ii()
+        print_yellow(f"Call latency (min/mean/p99/max): {lat['min']}/"
+                     f"{lat['mean']:.1f}/{lat['p99']}/{lat['max']} cycles")
+        print_yellow(f"Initiation interval (min/mean/p99/max): {ii['min']}/"
+                     f"{ii['mean']:.1f}/{ii['p99']}/{ii['max']} cycles")
+
+      # Channel statistics are only written if the kernel was profiled.
+      channelstatspath = os.path.join(self.outdir, "channel_stats.json")
+      if os.path.exists(channelstatspath):
+        channelstats = HLTChannelStatsEval(channelstatspath)
+        print_yellow("Most stalled channels (stall/fire cycles):")
+        for name, stall, fire in channelstats.get_most_stalled(5):
+          print_yellow(f"   {name}: {stall}/{fire}")
+
+      # Memory traffic statistics are only written for kernels with memories.
+      memstatspath = os.path.join(self.outdir, "mem_stats.json")
+      self.memstats = None
+      if os.path.exists(memstatspath):
+        self.memstats = HLTMemStatsEval(memstatspath)
+        print_yellow(f"Memory bandwidth: "
+                     f"{self.memstats.get_bytes_per_cycle():.3f} bytes/cycle")
+    # The schedule report is only written for pipelined static kernels.
+    schedules = glob.glob(os.path.join(self.outdir, "*_schedule.json"))
+    if schedules:
+      schedule = HLTScheduleEval(schedules[0])
+      self.results["schedule"] = schedule.get_loops()
+      for loop in schedule.get_loops():
+        print_yellow(f"Pipelined loop {loop['loop']}: II {loop['ii']}, "
+                     f"latency {loop['latency']}, "
+                     f"bottleneck: {loop['bottleneck']}")
+
+      # The simulator checks the II of the loops which store to memories.
+      iicheckpath = os.path.join(self.outdir, "ii_check.json")
+      if self.sim and os.path.exists(iicheckpath):
+        mismatches = HLTIICheckEval(iicheckpath).get_mismatches()
+        self.results["ii_mismatches"] = len(mismatches)
+        for arg, expected, measured in mismatches:
+          print(
+              to_red(f"Stores to argument {arg} were measured at an II of "
+                     f"{measured}, but were scheduled at an II of {expected}"))
+
+    # The resource estimate is only written if hlstool ran with
+    # --estimate_resources.
+    estimatepath = os.path.join(self.outdir,
+                                self.get_top() + "_resource_estimate.json")
+    if os.path.exists(estimatepath):
+      estimate = HLTResourceEstimateEval(estimatepath).get_estimate()
+      self.results["estimate"] = estimate
+      print_yellow(f"Estimated resources: {estimate['luts']:.0f} LUTs, "
+                   f"{estimate['ffs']:.0f} registers, "
+                   f"{estimate['dsps']:.0f} DSPs, critical path "
+                   f"{estimate['delay']:.2f}ns")
+
+    if self.synth and not self.synth_skipped:
       # Get reports
       rpts = []
       for root, dirs, files in os.walk(self.outdir):
@@ -320,9 +998,27 @@ class Experiment:
 
       utilReport = RPTParser(getReport("utilization_placed"))
       timingFile = getReport("timing_summary_routed")
-      self.print_summary(utilReport, timingFile)
+      # The power report is only annotated with switching activity if the
+      # kernel was simulated with --saif.
+      powerFile = getReport("power_saif")
+      self.print_summary(utilReport, timingFile, powerFile)
+
+    # The maximum frequency of the sweep supersedes that of the synthesis run
+    # at the period of the flow, and gives the execution time of the kernel.
+    if self.sweep:
+      best = max(self.sweep, key=lambda point: point["fmax"])
+      self.results["sweep"] = self.sweep
+      self.results["fmax"] = best["fmax"]
+      for point in self.sweep:
+        print_yellow(f"{point['period']}ns: WNS {point['wns']}ns, "
+                     f"{point['fmax']:.1f} MHz")
+      print_yellow(f"Maximum frequency: {best['fmax']:.1f} MHz")
+      if self.sim:
+        self.results["exectime"] = (self.cycleeval.get_cycles() * 1000.0 /
+                                    best["fmax"])
+        print_yellow(f"Execution time: {self.results['exectime']:.1f}ns")
 
-  def print_summary(self, util, timingFile):
+  def print_summary(self, util, timingFile, powerFile=None):
     slice_logic = util.get_table(re.compile(r"1\. CLB Logic"), 2)
     CLB_logic = util.get_table(re.compile(r"2\. CLB Logic Distribution"), 2)
     dsp_table = util.get_table(re.compile(r"4\. ARITHMETIC"), 2)
@@ -345,19 +1041,58 @@ class Experiment:
       f.write("Clock period(ns): " + str(cp) + "\n")
       max_cp = cp - wsn
       f.write("Max clock period(ns): " + str(max_cp) + "\n")
+      self.results.update({
+          "wns": wsn,
+          "period": cp,
+          "fmax": 1000.0 / max_cp
+      })
 
       if self.sim:
         min_exectime = float(self.cycleeval.exectime(max_cp))
         exectime = float(self.cycleeval.exectime(cp))
+        self.results["exectime"] = min_exectime
         f.write("cycles executed: " + str(self.cycleeval.get_cycles()) + "\n")
         f.write("Execution time(ns): " + str(exectime) + "\n")
         f.write("Min execution time(ns): " + str(min_exectime))
+        if self.callstats:
+          for name, stats in [("latency", self.callstats.get_latency()),
+                              ("II", self.callstats.get_ii())]:
+            f.write(f"\nCall {name} (min/mean/p99/max): {stats['min']}/"
+                    f"{stats['mean']}/{stats['p99']}/{stats['max']}")
+        if self.memstats:
+          f.write("\nMemory bytes transferred: " +
+                  str(self.memstats.get_bytes()) + "\n")
+          f.write("Memory bytes/cycle: " +
+                  str(self.memstats.get_bytes_per_cycle()) + "\n")
+          f.write("Memory stall cycles: " +
+                  str(self.memstats.get_stall_cycles()))
+          hitRate = self.memstats.get_cache_hit_rate()
+          if hitRate is not None:
+            f.write("\nCache hit rate: " + str(hitRate))
+
+      # The energy of a kernel call is the power of the kernel over the
+      # execution time of each call, at the constrained clock period.
+      if powerFile:
+        power = parse_power_report(powerFile)
+        self.results["power"] = power["total"]
+        f.write("\nTotal on-chip power(W): " + str(power["total"]))
+        f.write("\nDynamic power(W): " + str(power["dynamic"]))
+        if self.sim and power["total"] is not None and self.kernel_calls:
+          energy = power["total"] * exectime / self.kernel_calls
+          self.results["energy_per_call"] = energy
+          f.write("\nEnergy per kernel call(nJ): " + str(energy))
 
       clb = to_int(find_row(CLB_logic, "Site Type", "CLB")["Used"])
       clb_lut = to_int(find_row(slice_logic, "Site Type", "CLB LUTs")["Used"])
       clb_reg = to_int(
           find_row(slice_logic, "Site Type", "CLB Registers")["Used"])
       dsp = to_int(find_row(dsp_table, "Site Type", "DSPs")["Used"])
+      self.results.update({
+          "clb": clb,
+          "luts": clb_lut,
+          "registers": clb_reg,
+          "dsps": dsp
+      })
 
       f.write("\n")
       f.write("CLB logic:\n")
@@ -371,13 +1106,14 @@ class Experiment:
     with open(summary_file, "r") as f:
       print(f.read())
 
-  def run_hlstool(self):
-    hlstool_args = ["hlstool"]
-    if self.synth:
-      hlstool_args.append("--synth")  # Synthesize the design
-    hlstool_args.append("--rebuild")  # Always ensure fresh results
-    hlstool_args.append("--tb_file " + self.tb)
-    hlstool_args.append("--outdir " + self.outdir)
+  def run_hlstool(self, phase, phase_args=[], mode_args=[]):
+    hlstool_args = ["hlstool", *phase_args]
+    # The build cache of hlstool reruns any step whose inputs changed, and
+    # shares the simulator library of identical RTL across experiments. The
+    # testbench and output directory are those on the node which runs the
+    # phase.
+    hlstool_args.append("--tb_file " + self.run_tb)
+    hlstool_args.append("--outdir " + self.run_outdir)
     hlstool_args += self.args
     # The # of kernel calls for this test is controlled through the #define in
     # the testbenches. This is elaborated in the polygeist front-end, so inject
@@ -385,12 +1121,13 @@ class Experiment:
     hlstool_args.append(
         f"--extra_polygeist_tb_args=\"-DN_KERNEL_CALLS={self.kernel_calls}\"")
     hlstool_args.append(self.mode)
-    if self.sim:
-      hlstool_args.append("--run_sim")  # Run the testbench
+    hlstool_args += mode_args
     hlstool_args += self.mode_args
-    run_hls_tool(hlstool_args)
+    if self.batch_dir:
+      hlstool_args.append("--batch_dir " + self.batch_dir)
+    return self.executor.run(self, phase, hlstool_args)
 
-  def run_dynamatic(self):
+  def setup_dynamatic(self):
     # Dynamatic expects the kernel to be within a "src" directory. It is ok that the dir exists
     # since it is created by the front-end.
     src_dir = os.path.join(self.outdir, "src")
@@ -417,18 +1154,574 @@ class Experiment:
     shutil.copy(synth_tcl, self.outdir)
     shutil.copy(device_xdc, self.outdir)
 
-    curdir = os.getcwd()
-    os.chdir(self.outdir)
-    # Run vivado
+  def run_vivado(self, top):
     vivado_args = ["vivado", "-mode", "batch", "-source", "synth.tcl"]
     # synth arguments (see synth.tcl)
     vivado_args.append("-tclargs")
-    vivado_args.append(self.name)  # top level
-    vivado_args.append("xczu3eg-sbva484-1-e")  # part
+    vivado_args.append(top)  # top level
+    vivado_args.append(VIVADO_PART)  # part
     vivado_args.append("vivado")  # outdir
     vivado_args.append("1")  # do routing
-    subprocess.run([" ".join(vivado_args)], shell=True)
-    os.chdir(curdir)
+    # Experiments run concurrently, so run Vivado within the output directory
+    # rather than changing the working directory of the runner.
+    subprocess.run([" ".join(vivado_args)], shell=True, cwd=self.outdir)
+
+
+def run_experiments(experiments, pool, db, label, force, runner,
+                    keep_going=False):
+  """ Runs 'experiments' concurrently. Each experiment runs on its own thread,
+  and the pool schedules the phases of all experiments onto the host, such
+  that e.g. the simulation of one experiment overlaps the synthesis of
+  another. Returns the experiments which failed, if 'keep_going' is set;
+  otherwise, the first failure is raised."""
+  failed = []
+  with ThreadPoolExecutor(max_workers=max(len(experiments), 1)) as executor:
+    futures = {
+        executor.submit(experiment.run, pool, db, label, force, runner):
+        experiment for experiment in experiments
+    }
+    for future in concurrent.futures.as_completed(futures):
+      try:
+        future.result()
+      except Exception as e:
+        if not keep_going:
+          raise
+        print(to_red(f"Experiment {futures[future].name} failed: {e}"))
+        failed.append(futures[future])
+  return failed
+
+
+# =============================================================================
+# Batch lowering
+# =============================================================================
+
+# The definition of an attribute or type alias of an MLIR module.
+MLIR_ALIAS_PATTERN = re.compile(r"^([#!][\w.$-]+)\s*=", re.MULTILINE)
+# A symbol of an MLIR module.
+MLIR_SYMBOL_PATTERN = re.compile(r"@([\w.$-]+)")
+
+
+def mlir_rename(text, names, prefix):
+  # Prefixes each of 'names' (symbols, or aliases with their sigil) with
+  # 'prefix' throughout 'text'.
+  if not names:
+    return text
+  pattern = re.compile("(" + "|".join(
+      re.escape(n) for n in sorted(names, key=len, reverse=True)) +
+                       r")(?![\w.$-])")
+  return pattern.sub(
+      lambda m: (m.group(1)[0] + prefix + m.group(1)[1:]), text)
+
+
+def split_mlir_module(text):
+  """ Splits the text of an MLIR module into the definitions of its aliases,
+  the header of the module, and the text of each of its top-level ops."""
+  lines = text.splitlines(keepends=True)
+  start = next(i for i, l in enumerate(lines) if l.startswith("module"))
+  end = max(i for i, l in enumerate(lines) if l.startswith("}"))
+  aliases = "".join(l for l in lines[:start] if l.strip())
+  ops = []
+  for line in lines[start + 1:end]:
+    # Top-level ops are printed at an indentation of two spaces.
+    if not ops or (line.startswith("  ") and line[2:3] not in " }"):
+      ops.append("")
+    ops[-1] += line
+  return aliases, lines[start], ops
+
+
+def merge_kernels(kernels):
+  """ Merges the affine kernels of a batch into a single module, wherein the
+  symbols and aliases of each kernel are prefixed by its own prefix.
+  'kernels' holds the prefix and the text of the module of each kernel."""
+  merged_aliases = ""
+  header = None
+  body = ""
+  for prefix, text in kernels:
+    aliases, kernel_header, ops = split_mlir_module(text)
+    header = header or kernel_header
+    symbols = set()
+    for op in ops:
+      m = MLIR_SYMBOL_PATTERN.search(op.splitlines()[0])
+      if m:
+        symbols.add("@" + m.group(1))
+    names = symbols | set(MLIR_ALIAS_PATTERN.findall(aliases))
+    merged_aliases += mlir_rename(aliases, names, prefix)
+    body += mlir_rename("".join(ops), names, prefix)
+  return merged_aliases + header + body + "}\n"
+
+
+def split_kernels(text, prefixes):
+  """ Splits a module of merged kernels (see merge_kernels) into the module of
+  each kernel, with the prefix of its symbols stripped. Returns the text of
+  the module of each of 'prefixes'. Since tools print aliases of their own,
+  each module holds the aliases which its ops use."""
+  aliases, header, ops = split_mlir_module(text)
+  definitions = {
+      m.group(1): line
+      for line in aliases.splitlines(keepends=True)
+      for m in [MLIR_ALIAS_PATTERN.match(line)] if m
+  }
+  alias_use = re.compile(
+      "(" + "|".join(re.escape(a) for a in definitions) + r")(?![\w.$-])"
+  ) if definitions else None
+  bodies = {prefix: "" for prefix in prefixes}
+  for op in ops:
+    m = MLIR_SYMBOL_PATTERN.search(op.splitlines()[0])
+    owner = next((p for p in prefixes if m and m.group(1).startswith(p)),
+                 None)
+    # Ops without a symbol of a kernel are kept in all of them.
+    for prefix in ([owner] if owner else prefixes):
+      bodies[prefix] += op.replace("@" + prefix, "@")
+  modules = {}
+  for prefix, body in bodies.items():
+    used = set()
+    pending = [body]
+    while alias_use and pending:
+      for a in alias_use.findall(pending.pop()):
+        if a not in used:
+          used.add(a)
+          pending.append(definitions[a].split("=", 1)[1])
+    modules[prefix] = "".join(l for a, l in definitions.items()
+                              if a in used) + header + body + "}\n"
+  return modules
+
+
+def run_batch(requests, workdir):
+  """ Runs the steps of a batch of lowering requests of hlstool (see hlstool
+  --batch_dir), which share their steps, over a single module of all of their
+  kernels, and writes the outputs of each request. Returns False if a step
+  failed."""
+  prefixes = [f"b{i}_" for i in range(len(requests))]
+  texts = []
+  for request in requests:
+    with open(request["affine"], "r") as f:
+      texts.append(f.read())
+  if len(requests) > 1:
+    text = merge_kernels(list(zip(prefixes, texts)))
+  else:
+    text = texts[0]
+  current = os.path.join(workdir, "batch.mlir")
+  with open(current, "w") as f:
+    f.write(text)
+  for i, (tool, tool_args, suffix) in enumerate(requests[0]["steps"]):
+    output = os.path.join(workdir, f"batch_{i}.mlir")
+    # The kernels of the batch are lowered on the threads of the tool.
+    cmd = " ".join([
+        tool, current, "--allow-unregistered-dialect", *tool_args, "-o", output
+    ])
+    print_yellow("Running batch step: " + cmd)
+    if subprocess.run(cmd, shell=True).returncode != 0:
+      return False
+    current = output
+    if suffix is None:
+      continue
+    with open(output, "r") as f:
+      text = f.read()
+    prefix_of = {p: r for p, r in zip(prefixes, requests)}
+    modules = (split_kernels(text, prefixes)
+               if len(requests) > 1 else {prefixes[0]: text})
+    for prefix, module in modules.items():
+      # The outputs are named after the affine kernel of the request.
+      base = prefix_of[prefix]["affine"][:-len("_affine.mlir")]
+      with open(base + suffix, "w") as f:
+        f.write(module)
+  return True
+
+
+def batch_lower(experiments, batch_dir, pool, db, force):
+  """ Lowers the kernels of the dynamic circt-hls experiments to handshake in
+  batches. Each experiment first queues its kernel in 'batch_dir' through
+  hlstool --batch_dir. The queued kernels which share the steps of their
+  lowering (and thereby the options of their pipelines) are then merged into
+  a single module, such that each step runs once for the batch, and the
+  lowered kernels are split back out for the experiments to continue from.
+  Kernels of a batch which fails are lowered on their own."""
+  batch_dir = os.path.abspath(batch_dir)
+  os.makedirs(batch_dir, exist_ok=True)
+  batched = []
+  for e in experiments:
+    if e.style != "circt-hls" or not e.mode.startswith("dynamic"):
+      continue
+    e.outdir = e.get_outdir()
+    os.makedirs(e.outdir, exist_ok=True)
+    e.batch_dir = batch_dir
+    if not e.lookup(db, force):
+      batched.append(e)
+
+  def queue(e):
+    e.executor = LocalExecutor(pool)
+    with e.executor.session(e):
+      with e.executor.phase(e, "compile"):
+        e.run_hlstool("batch", mode_args=["--lower"])
+
+  with ThreadPoolExecutor(max_workers=max(len(batched), 1)) as executor:
+    list(executor.map(queue, batched))
+
+  groups = {}
+  for path in sorted(glob.glob(os.path.join(batch_dir, "*.json"))):
+    with open(path, "r") as f:
+      request = json.load(f)
+    base = path[:-len(".json")]
+    if all(
+        os.path.exists(base + suffix)
+        for _, _, suffix in request["steps"]
+        if suffix):
+      continue
+    with open(request["affine"], "r") as f:
+      header = next((l for l in f if l.startswith("module")), "")
+    groups.setdefault((json.dumps(request["steps"]), header),
+                      []).append(request)
+
+  def lower(requests):
+    workdir = os.path.join(batch_dir,
+                           "run_" + hashlib.sha256("".join(
+                               r["affine"] for r in requests).encode(
+                                   "utf-8")).hexdigest()[:16])
+    os.makedirs(workdir, exist_ok=True)
+    with pool.acquire(min(len(requests), pool.cores), COMPILE_MEMORY):
+      if run_batch(requests, workdir) or len(requests) == 1:
+        return
+    print_yellow(f"Batch of {len(requests)} kernels failed; lowering them "
+                 "one at a time.")
+    for request in requests:
+      lower([request])
+
+  print_yellow(f"Lowering {sum(len(g) for g in groups.values())} kernels in "
+               f"{len(groups)} batches.")
+  with ThreadPoolExecutor(max_workers=max(len(groups), 1)) as executor:
+    list(executor.map(lower, groups.values()))
+
+
+# =============================================================================
+# Design-space exploration
+# =============================================================================
+
+
+def get_design_points(space):
+  """ Returns each point of 'space', which maps hlstool mode options (e.g.
+  'unroll_loops') to the list of their values, as a dict of the value of each
+  option."""
+  options = sorted(space)
+  return [
+      dict(zip(options, values))
+      for values in itertools.product(*(space[o] for o in options))
+  ]
+
+
+def get_point_args(point):
+  # Boolean options are flags (e.g. '--pipeline').
+  args = []
+  for option, value in point.items():
+    if value is True:
+      args.append(f"--{option}")
+    elif value is not False:
+      args.append(f"--{option}={value}")
+  return args
+
+
+def get_point_name(point):
+  return "_".join(f"{option}-{value}" for option, value in point.items())
+
+
+def is_costlier(a, b):
+  # True if point 'a' differs from 'b' only in larger integer options.
+  diff = [o for o in a if a[o] != b[o]]
+  return diff and all(
+      isinstance(a[o], int) and not isinstance(a[o], bool) and a[o] > b[o]
+      for o in diff)
+
+
+def prune_points(points, threshold):
+  """ Returns the (point, experiment) pairs of 'points' which are worth
+  synthesizing, given the cycles which their screening simulation took.
+  Integer options (unroll and partition factors) are assumed to cost more
+  resources as they grow, so a point is pruned if another point only has
+  smaller values of such options (see is_costlier), and takes at most
+  'threshold' (a fraction) more cycles."""
+  kept = []
+  for point, experiment in points:
+    cycles = experiment.results["cycles"]
+    if not any(
+        is_costlier(point, other) and
+        cycles >= other_experiment.results["cycles"] * (1 - threshold)
+        for other, other_experiment in points):
+      kept.append((point, experiment))
+    else:
+      print_yellow(f"Pruned {experiment.name} ({cycles} cycles)")
+  return kept
+
+
+# The estimates of --estimate_resources, which are calibrated against the
+# results of synthesis.
+ESTIMATE_METRICS = ["luts", "ffs", "dsps", "delay"]
+
+
+def get_measured(results, metric):
+  # The result of a synthesized run which corresponds to 'metric' of its
+  # estimate, if any. The delay of the critical path bounds the period.
+  if metric == "ffs":
+    return results.get("registers")
+  if metric == "delay":
+    return 1000.0 / results["fmax"] if results.get("fmax") else None
+  return results.get(metric)
+
+
+def get_estimate_scales(db):
+  """ Returns the factor that each estimate of --estimate_resources is scaled
+  by to match synthesis, fitted to the runs of 'db' which were both estimated
+  and synthesized: the ratio of the sum of the measured results to that of
+  the estimates, i.e. the least-squares fit of the measured results to the
+  estimates, weighted by their inverse. Estimates without any such runs are
+  not scaled."""
+  sums = {m: [0.0, 0.0] for m in ESTIMATE_METRICS}
+  for record in db.latest().values():
+    estimate = record.get("estimate")
+    if not estimate:
+      continue
+    for metric in ESTIMATE_METRICS:
+      measured = get_measured(record, metric)
+      if measured is not None and estimate[metric]:
+        sums[metric][0] += measured
+        sums[metric][1] += estimate[metric]
+  return {m: (s[0] / s[1] if s[1] else 1.0) for m, s in sums.items()}
+
+
+def get_estimated_costs(results, scales):
+  """ Returns the calibrated estimate of the execution time (cycles x the
+  delay of the critical path), LUTs and DSPs of the screening run which had
+  'results'."""
+  estimate = results["estimate"]
+  return {
+      "exectime": results["cycles"] * estimate["delay"] * scales["delay"],
+      "luts": estimate["luts"] * scales["luts"],
+      "dsps": estimate["dsps"] * scales["dsps"]
+  }
+
+
+def prune_estimated_points(points, scales, threshold, max_luts, max_dsps):
+  """ Returns the (point, experiment) pairs of 'points' which are worth
+  synthesizing, given the calibrated resource estimates of their screening
+  runs (see get_estimated_costs). A point is pruned if its LUTs or DSPs
+  exceed 'max_luts' or 'max_dsps' (unless 0), or, unless 'threshold' is
+  None, if another point is estimated to be as good in execution time, LUTs
+  and DSPs, and better by more than 'threshold' (a fraction) in one of them.
+  Points without an estimate are kept."""
+  costs = {
+      id(e): get_estimated_costs(e.results, scales)
+      for _, e in points
+      if "estimate" in e.results
+  }
+
+  def dominates(a, b):
+    return all(a[m] <= b[m] for m in a) and any(
+        a[m] < b[m] * (1 - threshold) for m in a)
+
+  kept = []
+  for point, experiment in points:
+    cost = costs.get(id(experiment))
+    if cost is None:
+      kept.append((point, experiment))
+    elif max_luts and cost["luts"] > max_luts:
+      print_yellow(f"Pruned {experiment.name} (estimated "
+                   f"{cost['luts']:.0f} LUTs)")
+    elif max_dsps and cost["dsps"] > max_dsps:
+      print_yellow(f"Pruned {experiment.name} (estimated "
+                   f"{cost['dsps']:.0f} DSPs)")
+    elif threshold is not None and any(
+        dominates(other, cost)
+        for other in costs.values()
+        if other is not cost):
+      print_yellow(f"Pruned {experiment.name} (estimated "
+                   f"{cost['exectime']:.1f}ns, {cost['luts']:.0f} LUTs, "
+                   f"{cost['dsps']:.0f} DSPs)")
+    else:
+      kept.append((point, experiment))
+  return kept
+
+
+def get_cycle_budget(point, screened, threshold):
+  """ Returns the cycle limit of the screening simulation of 'point', given
+  the (point, experiment) pairs of 'screened' which have finished: the
+  cycles beyond which 'point' would be pruned by prune_points, or None if no
+  screened point can prune it."""
+  limits = [
+      e.results["cycles"] * (1 - threshold)
+      for other, e in screened
+      if is_costlier(point, other)
+  ]
+  return math.ceil(min(limits)) if limits else None
+
+
+def is_synth_dominated(point, results, scales, synthesized, threshold):
+  """ Returns true if 'point', whose screening run had 'results', is
+  dominated before it is synthesized by one of the (point, results) pairs of
+  'synthesized': if that point is as good as a bound of the execution time,
+  LUTs and DSPs of 'point', and better by more than 'threshold' (a fraction)
+  in one of them. The execution time is bounded by the cycles of 'point' at
+  the shortest period that any synthesized point achieved. The LUTs and DSPs
+  are bounded by their calibrated estimates, if 'point' was estimated (see
+  get_estimated_costs), and otherwise by those of the synthesized points
+  which 'point' only has larger integer options than (see is_costlier)."""
+  if not synthesized:
+    return False
+  period = min(1000.0 / r["fmax"] for _, r in synthesized)
+  bound = {"exectime": results["cycles"] * period, "luts": 0, "dsps": 0}
+  if scales and "estimate" in results:
+    estimate = get_estimated_costs(results, scales)
+    bound.update(luts=estimate["luts"], dsps=estimate["dsps"])
+  else:
+    for other, r in synthesized:
+      if is_costlier(point, other):
+        bound.update(luts=max(bound["luts"], r["luts"]),
+                     dsps=max(bound["dsps"], r["dsps"]))
+  return any(
+      all(r[m] <= bound[m] for m in bound) and
+      any(r[m] < bound[m] * (1 - threshold) for m in bound)
+      for _, r in synthesized)
+
+
+def get_pareto_front(entries, metrics):
+  """ Returns the entries (dicts) which no other entry is at least as good as
+  in every one of 'metrics', and better in one of them; lower is better."""
+
+  def dominates(a, b):
+    return all(a[m] <= b[m] for m in metrics) and any(
+        a[m] < b[m] for m in metrics)
+
+  return [e for e in entries if not any(dominates(o, e) for o in entries)]
+
+
+def explore(bases, space, pool, db, args, runner):
+  """ Explores the design points of 'space' for each experiment of 'bases':
+  every point is first screened in simulation only, the points which are
+  pruned by their cycles (see prune_points) are dropped, and the rest are
+  simulated and synthesized (and swept, if the base has an 'fmax_sweep').
+  Reports the Pareto front of the execution time (cycles x achieved period)
+  against the LUTs and DSPs of each base, and returns the experiments which
+  ran successfully.
+
+  With --prune_estimates, --max_luts or --max_dsps, the resources of the
+  dynamic kernels are also estimated in screening, calibrated against the
+  runs of 'db' which were synthesized (see get_estimate_scales), and the
+  points which are over budget or dominated by their estimates are pruned
+  as well (see prune_estimated_points).
+
+  With --abort_dominated, the screening simulation of each point is limited
+  to the cycles beyond which the points screened so far would prune it (see
+  get_cycle_budget), and a point is not synthesized if the points
+  synthesized so far dominate it (see is_synth_dominated). Only the points
+  which have finished when a run starts are considered, and runs which are
+  cut short are not recorded."""
+  estimate = args.prune_estimates or args.max_luts or args.max_dsps
+  screens = []
+  candidates = []
+
+  def screen_budget(base, point):
+    # The cycle limit of the screening run of 'point', as it starts.
+    def budget(experiment):
+      screened = [(p, e)
+                  for b, p, e in screens
+                  if b is base and "cycles" in getattr(e, "results", {})]
+      return get_cycle_budget(point, screened, args.prune_threshold)
+
+    return budget if args.abort_dominated else None
+
+  def synth_dominated(base, point, screen):
+    # Whether to skip the synthesis of 'point', as it starts.
+    def skip(experiment):
+      synthesized = [(p, e.results)
+                     for b, p, e in candidates
+                     if b is base and e is not experiment and
+                     "exectime" in getattr(e, "results", {})]
+      return is_synth_dominated(point, screen.results, scales, synthesized,
+                                args.prune_threshold)
+
+    return skip if args.abort_dominated else None
+
+  for base in bases:
+    estimate_args = (["--estimate_resources"] if estimate and
+                     base.style == "circt-hls" and
+                     base.mode.startswith("dynamic") else [])
+    for point in get_design_points(space):
+      screens.append((base, point,
+                      replace(base,
+                              name=f"{base.name}-{get_point_name(point)}",
+                              mode_args=base.mode_args + estimate_args +
+                              get_point_args(point),
+                              synth=False,
+                              sim=True,
+                              fmax_sweep=None,
+                              cycle_budget=screen_budget(base, point))))
+  print_header(f"Screening {len(screens)} design points")
+  failed = run_experiments([e for _, _, e in screens],
+                           pool,
+                           db,
+                           args.label,
+                           args.force,
+                           runner,
+                           keep_going=True)
+
+  scales = get_estimate_scales(db) if estimate else None
+  if scales:
+    print_yellow("Estimate calibration: " +
+                 ", ".join(f"{m} x{scale:.3g}" for m, scale in scales.items()))
+  for base in bases:
+    points = [(point, e)
+              for b, point, e in screens
+              if b is base and e not in failed and "cycles" in e.results]
+    kept = prune_points(points, args.prune_threshold)
+    if estimate:
+      kept = prune_estimated_points(
+          kept, scales, args.prune_threshold if args.prune_estimates else None,
+          args.max_luts, args.max_dsps)
+    kept = sorted(kept, key=lambda p: p[1].results["cycles"])
+    if args.max_synth:
+      kept = kept[:args.max_synth]
+    candidates += [(base, point,
+                    replace(e,
+                            synth=True,
+                            fmax_sweep=base.fmax_sweep,
+                            cycle_budget=None,
+                            skip_synth=synth_dominated(base, point, e)))
+                   for point, e in kept]
+  print_header(f"Synthesizing {len(candidates)} design points")
+  failed += run_experiments([e for _, _, e in candidates],
+                            pool,
+                            db,
+                            args.label,
+                            args.force,
+                            runner,
+                            keep_going=True)
+
+  report = {}
+  for base in bases:
+    entries = []
+    for b, point, e in candidates:
+      if b is not base or e in failed or "exectime" not in e.results:
+        continue
+      entries.append({
+          "name": e.name,
+          "point": point,
+          **{k: e.results[k] for k in ["cycles", "fmax", "exectime", "luts",
+                                       "dsps"]}
+      })
+    front = get_pareto_front(entries, ["exectime", "luts", "dsps"])
+    report[base.name] = {"points": entries, "front": front}
+    print_header(f"Pareto front of {base.name}")
+    for entry in sorted(front, key=lambda e: e["exectime"]):
+      print_yellow(f"{entry['name']}: {entry['cycles']} cycles at "
+                   f"{entry['fmax']:.1f} MHz = {entry['exectime']:.1f}ns, "
+                   f"{entry['luts']} LUTs, {entry['dsps']} DSPs")
+
+  if bases:
+    reportpath = os.path.join("results", bases[0].experimentName,
+                              "pareto.json")
+    with open(reportpath, "w") as f:
+      json.dump(report, f, indent=2)
+    print_yellow(f"Wrote the design points and Pareto fronts to {reportpath}")
+  return [
+      e for _, _, e in screens + candidates if e not in failed
+  ]
 
 
 # =============================================================================
@@ -443,9 +1736,134 @@ if __name__ == "__main__":
                       type=str)
   parser.add_argument(
       "--concurrency",
-      help="Run the experiments concurrently (specify # of threads)",
+      help="The maximum number of experiment phases (compilation, simulation "
+      "and synthesis) to run concurrently. 0 runs as many as the cores and "
+      "memory of the host allow.",
       type=int,
       default=1)
+  parser.add_argument("--cores",
+                      help="The number of cores to run experiments on.",
+                      type=int,
+                      default=multiprocessing.cpu_count())
+  parser.add_argument("--memory",
+                      help="The memory (in GB) to run experiments in.",
+                      type=float,
+                      default=get_total_memory())
+  parser.add_argument("--synth_memory",
+                      help="The memory (in GB) that each synthesis run needs.",
+                      type=float,
+                      default=SYNTH_MEMORY)
+
+  parser.add_argument(
+      "--executor",
+      help="Where the experiments run: on this host ('local'), on the hosts "
+      "of --hosts through ssh ('ssh'), or as Slurm job steps ('slurm'). "
+      "Remote experiments are shipped with the sources next to their "
+      "testbench, and their logs, reports and statistics are fetched back "
+      "into the results directory. Dynamatic experiments always run locally.",
+      choices=["local", "ssh", "slurm"],
+      default="local")
+  parser.add_argument(
+      "--hosts",
+      help="Comma-separated list of the hosts of --executor=ssh.",
+      type=str,
+      default="")
+  parser.add_argument(
+      "--jobs_per_host",
+      help="The number of experiments which each host of --hosts runs at once.",
+      type=int,
+      default=1)
+  parser.add_argument(
+      "--remote_root",
+      help="Directory on the nodes (relative to the home directory through "
+      "ssh) which holds the inputs and outputs of the remote experiments, "
+      "keyed by the hash of their inputs. With --executor=slurm, it must be "
+      "shared with the nodes.",
+      type=str,
+      default="circt-hls-experiments")
+  parser.add_argument(
+      "--srun_args",
+      help="Extra arguments of srun with --executor=slurm (e.g. the "
+      "partition). Expects a space-delimited string.",
+      type=str,
+      default="")
+
+  parser.add_argument(
+      "--prune_threshold",
+      help="In design-space exploration (a 'space' in the experiments file), "
+      "the relative reduction in cycles below which growing an unroll or "
+      "partition factor is not worth synthesizing.",
+      type=float,
+      default=0.02)
+  parser.add_argument(
+      "--prune_estimates",
+      help="In design-space exploration, estimate the resources of each "
+      "screened dynamic design point (see hlstool --estimate_resources), and "
+      "prune the points which another point is estimated to match in "
+      "execution time, LUTs and DSPs, and to beat by more than "
+      "--prune_threshold in one of them. The estimates are calibrated against "
+      "the synthesized runs of --db.",
+      action="store_true")
+  parser.add_argument(
+      "--max_luts",
+      help="In design-space exploration, prune the design points which are "
+      "estimated to take more LUTs than this. 0 sets no bound.",
+      type=int,
+      default=0)
+  parser.add_argument(
+      "--max_dsps",
+      help="In design-space exploration, prune the design points which are "
+      "estimated to take more DSPs than this. 0 sets no bound.",
+      type=int,
+      default=0)
+  parser.add_argument(
+      "--abort_dominated",
+      help="In design-space exploration, abort the screening simulation of "
+      "each design point once --prune_threshold would prune it against the "
+      "points screened so far (through hlstool --max_cycles), and skip the "
+      "synthesis of each point which the points synthesized so far dominate.",
+      action="store_true")
+  parser.add_argument(
+      "--max_synth",
+      help="In design-space exploration, the maximum number of the fastest "
+      "screened design points of each run to synthesize. 0 synthesizes all "
+      "points which are not pruned.",
+      type=int,
+      default=0)
+
+  parser.add_argument(
+      "--db",
+      help="JSON-lines database which the results of each experiment are "
+      "appended to.",
+      type=str,
+      default=os.path.join("results", "results.jsonl"))
+  parser.add_argument(
+      "--force",
+      help="Run experiments whose inputs are unchanged since a run recorded "
+      "in the database.",
+      action="store_true")
+  parser.add_argument(
+      "--label",
+      help="Label (e.g. the revision being evaluated) of the recorded results.",
+      type=str)
+  parser.add_argument(
+      "--baseline",
+      help="Compare the results to the latest results with this label, and "
+      "fail if any cycle count or Fmax regressed by more than --threshold.",
+      type=str)
+  parser.add_argument("--threshold",
+                      help="The relative change which is a regression.",
+                      type=float,
+                      default=0.02)
+
+  parser.add_argument(
+      "--batch_lowering",
+      help="Lower the kernels of the dynamic experiments to handshake in "
+      "batches before running them, wherein each step of the lowering runs "
+      "once over a module of all kernels which share the options of its "
+      "pipelines (see hlstool --batch_dir). Requires --executor=local, and is "
+      "not supported with design-space exploration.",
+      action="store_true")
 
   parser.add_argument("--dynamatic_dir",
                       help="Path to the dynamatic directory",
@@ -454,6 +1872,7 @@ if __name__ == "__main__":
   args = parser.parse_args()
 
   DYNAMATIC_DIR = args.dynamatic_dir
+  SYNTH_MEMORY = args.synth_memory
 
   if not os.path.isfile(args.experiments):
     print("Experiments file does not exist: ", args.experiments)
@@ -477,6 +1896,8 @@ if __name__ == "__main__":
     synth = setup["synth"]
     sim = setup["sim"]
     style = setup["style"]
+    # The options of hlstool to explore, and their values, if any.
+    space = expFile.get("space")
 
     def overrideIfExists(container, key, current):
       if key in container:
@@ -493,6 +1914,8 @@ if __name__ == "__main__":
       run_kernel_calls = overrideIfExists(expValues, "kernel_calls",
                                           kernel_calls)
       run_synth = overrideIfExists(expValues, "synth", synth)
+      run_fmax_sweep = overrideIfExists(expValues, "fmax_sweep",
+                                        setup.get("fmax_sweep"))
       run_sim = overrideIfExists(expValues, "sim", sim)
       run_tb = expValues["tb"]
 
@@ -505,6 +1928,7 @@ if __name__ == "__main__":
                      args=run_general_args,
                      mode_args=run_mode_args,
                      synth=run_synth,
+                     fmax_sweep=run_fmax_sweep,
                      sim=run_sim,
                      style=style))
 
@@ -519,11 +1943,39 @@ if __name__ == "__main__":
     os.makedirs(os.path.join("results", experiments_file))
 
   # Run the experiments
-  from concurrent.futures import ThreadPoolExecutor
-  futures = []
-  with ThreadPoolExecutor(max_workers=args.concurrency) as executor:
-    for experiment in experiments:
-      futures.append(executor.submit(experiment.run))
-    # join
-    for future in concurrent.futures.as_completed(futures):
-      future.result()
+  pool = ResourcePool(args.cores, args.memory, args.concurrency)
+  db = ResultDB(args.db)
+  if args.executor == "ssh":
+    hosts = [h for h in args.hosts.split(",") if h]
+    if not hosts:
+      print("--executor=ssh requires --hosts")
+      exit(1)
+    runner = SSHExecutor(hosts, args.remote_root, args.jobs_per_host)
+  elif args.executor == "slurm":
+    runner = SlurmExecutor(args.remote_root, args.srun_args.split())
+  else:
+    runner = LocalExecutor(pool)
+  if args.batch_lowering and (space or args.executor != "local"):
+    print("--batch_lowering requires --executor=local, and no 'space'")
+    exit(1)
+  if space:
+    experiments = explore(experiments, space, pool, db, args, runner)
+  else:
+    if args.batch_lowering:
+      batch_lower(experiments, os.path.join("results", experiments_file,
+                                            "batch"), pool, db, args.force)
+    run_experiments(experiments, pool, db, args.label, args.force, runner)
+
+  # Report the compile stages which scale poorly across the experiments.
+  profiles = [e.compileprofile for e in experiments if e.compileprofile]
+  for name, exponent, n in get_superlinear(profiles):
+    print_yellow(f"Superlinear compile time: {name} scales with "
+                 f"(# input ops)^{exponent:.2f} over {n} kernels")
+
+  # Gate on regressions against the baseline.
+  if args.baseline:
+    current = {(e.experimentName, e.name): e.results for e in experiments}
+    regressions = compare(db.latest(args.baseline), current, args.threshold)
+    print_regressions(regressions)
+    if regressions:
+      sys.exit(1)
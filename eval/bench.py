@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+""" Throughput benchmarks of the HLT simulator and the HLS lowering, built on
+the Dynamatic kernels of the cosim test suite. Each kernel is run at several
+numbers of kernel calls and problem sizes. For each run, the simulated cycles
+per call, the host wall time per simulated cycle and the compile time are
+appended to a results database (see resultdb.py).
+
+  bench.py [--calls 1,10,100] [--scales 1,2] [--label rev] [kernel ...]
+
+Problem sizes are scaled through the size macros (e.g. '#define N 30') of the
+header of each kernel which guards them by '#ifndef'. Kernels without such
+macros are only run at their default size.
+"""
+import argparse
+import glob
+import hashlib
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+
+from hltlog import HLTLog
+from resultdb import ResultDB
+
+SUITE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..",
+                     "cosim_test", "suites", "Dynamatic")
+
+SIZE_MACRO = re.compile(r"^#ifndef (\w+)\n#define \1 (\d+)$", re.M)
+
+
+def get_size_macros(tb):
+  """ Returns (name, default value) of each overridable size macro of the
+  kernel which testbench 'tb' calls."""
+  kernel = os.path.basename(tb)[len("tst_"):-len(".c")]
+  header = os.path.join(os.path.dirname(tb), kernel + ".h")
+  if not os.path.exists(header):
+    return []
+  with open(header) as f:
+    return [(name, int(value)) for name, value in SIZE_MACRO.findall(f.read())]
+
+
+def get_input_hash(tb, calls, scale, hlstool_args):
+  # Runs are identified by their setup and the sources of the kernel, such
+  # that results of a changed kernel aren't compared against earlier runs.
+  h = hashlib.sha256()
+  h.update(json.dumps([calls, scale, hlstool_args]).encode("utf-8"))
+  srcdir = os.path.dirname(tb)
+  for file in sorted(os.listdir(srcdir)):
+    with open(os.path.join(srcdir, file), "rb") as f:
+      h.update(file.encode("utf-8") + hashlib.sha256(f.read()).digest())
+  return h.hexdigest()
+
+
+class BenchRun:
+
+  def __init__(self, tb, calls, scale, outdir):
+    self.tb = os.path.abspath(tb)
+    self.kernel = os.path.basename(tb)[len("tst_"):-len(".c")]
+    self.calls = calls
+    self.scale = scale
+    self.name = f"{self.kernel}/calls={calls}/scale={scale}"
+    self.outdir = os.path.join(os.path.abspath(outdir), self.kernel,
+                               f"calls{calls}_scale{scale}")
+
+  def hlstool(self, hlstool, hlstool_args, mode_args):
+    # Runs hlstool, and returns its wall time in seconds, or None if it failed.
+    # The output of hlstool is appended to bench.log in the output directory.
+    defines = [
+        f"-D{name}={value * self.scale}"
+        for name, value in get_size_macros(self.tb)
+    ]
+    cmd = [hlstool, "--no_trace", "--tb_file", self.tb, "--outdir", self.outdir]
+    cmd += hlstool_args
+    cmd.append("--extra_polygeist_tb_args=\"" +
+               " ".join(defines + [f"-DN_KERNEL_CALLS={self.calls}"]) + "\"")
+    if defines:
+      cmd.append("--extra_polygeist_kernel_args=\"" + " ".join(defines) + "\"")
+    cmd += ["dynamic-polygeist", *mode_args]
+    with open(os.path.join(self.outdir, "bench.log"), "a") as log:
+      start = time.perf_counter()
+      proc = subprocess.run(" ".join(cmd),
+                            shell=True,
+                            stdout=log,
+                            stderr=subprocess.STDOUT)
+      wall = time.perf_counter() - start
+    return wall if proc.returncode == 0 else None
+
+  def run(self, hlstool, hlstool_args):
+    """ Returns the results of the run, or None if it failed."""
+    os.makedirs(self.outdir, exist_ok=True)
+    # Lower the kernel and build the simulator and testbench. The simulation
+    # is timed separately; the build cache of hlstool skips the steps of the
+    # compile phase.
+    compileWall = self.hlstool(hlstool, ["--rebuild", *hlstool_args],
+                               ["--build_tb", "--build_sim"])
+    if compileWall is None:
+      return None
+    simWall = self.hlstool(hlstool, hlstool_args, ["--run_sim"])
+    if simWall is None:
+      return None
+
+    log = HLTLog(os.path.join(self.outdir, "sim.log"))
+    return {
+        "cycles": log.cycles,
+        "calls": log.num_calls,
+        "cycles_per_call": log.cycles / log.num_calls if log.num_calls else 0,
+        "sim_wall": simWall,
+        "wall_per_cycle": simWall / log.cycles if log.cycles else 0,
+        "compile_wall": compileWall,
+    }
+
+
+def to_list(arg):
+  return [int(x) for x in arg.split(",")]
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser()
+  parser.add_argument(
+      "kernels",
+      nargs="*",
+      help="The kernels of the Dynamatic suite to run. Defaults to all.")
+  parser.add_argument("--calls",
+                      type=to_list,
+                      default=[1, 10, 100],
+                      help="Comma-separated numbers of kernel calls.")
+  parser.add_argument(
+      "--scales",
+      type=to_list,
+      default=[1, 2],
+      help="Comma-separated factors which the problem size of each kernel is "
+      "scaled by.")
+  parser.add_argument("--hlstool",
+                      default="hlstool",
+                      help="The hlstool executable.")
+  parser.add_argument(
+      "--hlstool_args",
+      default="",
+      help="Arguments (e.g. '--vlt_threads 1') passed to each invocation of "
+      "hlstool.")
+  parser.add_argument("--outdir",
+                      default=os.path.join("results", "bench"),
+                      help="Directory which each run is built in.")
+  parser.add_argument("--db",
+                      default=os.path.join("results", "bench.jsonl"),
+                      help="JSON-lines database which the results of each "
+                      "run are appended to.")
+  parser.add_argument(
+      "--label",
+      help="Label (e.g. the revision being evaluated) of the recorded results.")
+  args = parser.parse_args()
+
+  tbs = sorted(glob.glob(os.path.join(SUITE, "*", "tst_*.c")))
+  if args.kernels:
+    tbs = [
+        tb for tb in tbs
+        if os.path.basename(os.path.dirname(tb)) in args.kernels
+    ]
+  hlstool_args = args.hlstool_args.split()
+
+  os.makedirs(os.path.dirname(os.path.abspath(args.db)), exist_ok=True)
+  db = ResultDB(args.db)
+  failed = []
+  for tb in tbs:
+    # Kernels without size macros only have a default size.
+    scales = args.scales if get_size_macros(tb) else [1]
+    for scale in scales:
+      for calls in args.calls:
+        run = BenchRun(tb, calls, scale, args.outdir)
+        results = run.run(args.hlstool, hlstool_args)
+        if results is None:
+          print(f"{run.name}: FAILED (see {run.outdir}/bench.log)")
+          failed.append(run.name)
+          continue
+        print(f"{run.name}: {results['cycles_per_call']:.1f} cycles/call, "
+              f"{results['wall_per_cycle'] * 1e6:.2f} us/cycle, "
+              f"compiled in {results['compile_wall']:.1f} s")
+        results.update({
+            "experiment": "bench",
+            "name": run.name,
+            "key": get_input_hash(tb, calls, scale, hlstool_args),
+            "label": args.label,
+            "time": time.time()
+        })
+        db.append(results)
+
+  print(f"Results are in {args.db}")
+  sys.exit(1 if failed else 0)
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+""" Reader for the compile profiles (compile_profile.json) written by
+'hlstool --profile_compile'.
+
+Run as a script to report the stages and passes whose wall time grows
+superlinearly in the size of their input across a suite of kernels:
+  compileprofile.py results/<experiment>/*/compile_profile.json
+"""
+import argparse
+import json
+import math
+
+# Stages which take less than this many seconds for every kernel are too noisy
+# to fit.
+MIN_WALL = 0.01
+
+
+class CompileProfile:
+
+  def __init__(self, path):
+    with open(path) as f:
+      profile = json.load(f)
+    self.kernel = profile["kernel"]
+    self.stages = profile["stages"]
+
+  def get_wall(self):
+    return sum(stage["wall"] for stage in self.stages)
+
+  def samples(self):
+    """ Yields (name, ops in, wall time) for each stage and each pass of a
+    stage in the profile."""
+    for stage in self.stages:
+      if not stage["ops_in"]:
+        continue
+      yield stage["stage"], stage["ops_in"], stage["wall"]
+      for p in stage["passes"]:
+        yield f"{stage['stage']}: {p['name']}", stage["ops_in"], p["wall"]
+
+
+def fit_exponent(samples):
+  """ Returns the exponent k of the least-squares fit of wall = c * ops^k, or
+  None if the samples don't span more than one input size."""
+  points = [(math.log(ops), math.log(wall))
+            for ops, wall in samples
+            if wall > 0]
+  if len(set(x for x, _ in points)) < 2:
+    return None
+  meanX = sum(x for x, _ in points) / len(points)
+  meanY = sum(y for _, y in points) / len(points)
+  cov = sum((x - meanX) * (y - meanY) for x, y in points)
+  var = sum((x - meanX)**2 for x, _ in points)
+  return cov / var
+
+
+def get_scaling(profiles, min_kernels=3):
+  """ Returns (name, exponent, # kernels) for each stage and pass which was
+  profiled for at least 'min_kernels' kernels, fastest growing first."""
+  samples = {}
+  for profile in profiles:
+    for name, ops, wall in profile.samples():
+      samples.setdefault(name, []).append((ops, wall))
+
+  scaling = []
+  for name, points in samples.items():
+    if len(points) < min_kernels or max(w for _, w in points) < MIN_WALL:
+      continue
+    exponent = fit_exponent(points)
+    if exponent is not None:
+      scaling.append((name, exponent, len(points)))
+  return sorted(scaling, key=lambda s: -s[1])
+
+
+def get_superlinear(profiles, threshold=1.2, min_kernels=3):
+  return [s for s in get_scaling(profiles, min_kernels) if s[1] > threshold]
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser()
+  parser.add_argument("profiles", nargs="+", help="compile_profile.json files")
+  parser.add_argument(
+      "--threshold",
+      type=float,
+      default=1.2,
+      help="Flag stages whose wall time grows with an exponent of the number "
+      "of input ops above this.")
+  parser.add_argument("--min_kernels",
+                      type=int,
+                      default=3,
+                      help="The number of kernels needed to fit a stage.")
+  args = parser.parse_args()
+
+  profiles = [CompileProfile(path) for path in args.profiles]
+  for profile in profiles:
+    print(f"{profile.kernel}: {profile.get_wall():.3f}s")
+  print("Scaling of wall time in # of input ops (exponent, # kernels):")
+  for name, exponent, n in get_scaling(profiles, args.min_kernels):
+    flag = " (superlinear)" if exponent > args.threshold else ""
+    print(f"  {name}: {exponent:.2f}, {n}{flag}")
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+""" Reader for the binary event logs (sim.log) written by the HLT simulator.
+See include/circt-hls/Tools/hlt/Simulator/SimLog.h for the format.
+
+Run as a script to print the events and summary of a log:
+  hltlog.py sim.log
+
+The events of a log which was cut short, e.g. by a simulator which was killed
+mid-run, are read up to its last complete record.
+"""
+import struct
+import sys
+
+HEADER = struct.Struct("=4sI")
+RECORD = struct.Struct("=QII")
+SUMMARY = struct.Struct("=QI4s")
+
+MAGIC = b"HLTL"
+SUMMARY_MAGIC = b"HLTF"
+VERSION = 1
+
+EVENTS = [
+    "PUSH INPUT", "POP OUTPUT", "OUT TO WAITER", "CHECKPOINT", "RESTORED",
+    "RESET", "TIMED OUT", "FINISHED", "END", "TRANSFER INPUT", "CYCLE LIMIT"
+]
+END = EVENTS.index("END")
+
+
+class HLTLog:
+
+  def __init__(self, path, require_summary=True):
+    # A log without a summary raises, unless 'require_summary' is unset; its
+    # cycles are then None, and it has no calls.
+    self.path = path
+    self.cycles = None
+    self.num_calls = 0
+    self.latencies = []
+    with open(path, "rb") as f:
+      magic, version = HEADER.unpack(f.read(HEADER.size))
+      if magic != MAGIC:
+        raise Exception(f"{path} is not an HLT event log")
+      if version != VERSION:
+        raise Exception(f"Unsupported HLT event log version {version}")
+
+      # The summary is at the end of the log, preceded by the latencies.
+      f.seek(0, 2)
+      size = f.tell()
+      summary = None
+      if size >= HEADER.size + RECORD.size + SUMMARY.size:
+        f.seek(size - SUMMARY.size)
+        summary = SUMMARY.unpack(f.read(SUMMARY.size))
+      if summary is None or summary[2] != SUMMARY_MAGIC:
+        if not require_summary:
+          return
+        raise Exception(f"{path} has no summary; the simulation did not exit "
+                        "cleanly")
+      self.cycles, self.num_calls, _ = summary
+      f.seek(size - SUMMARY.size - 8 * self.num_calls)
+      self.latencies = list(
+          struct.unpack(f"={self.num_calls}Q", f.read(8 * self.num_calls)))
+
+  def events(self):
+    """ Yields (cycle, event name, call index) for each event in the log. The
+    events of a truncated log end at its last complete record."""
+    with open(self.path, "rb") as f:
+      f.seek(HEADER.size)
+      while True:
+        record = f.read(RECORD.size)
+        if len(record) < RECORD.size:
+          print(f"{self.path} is truncated; the simulation did not exit "
+                "cleanly",
+                file=sys.stderr)
+          return
+        cycle, event, id = RECORD.unpack(record)
+        if event == END:
+          return
+        yield cycle, EVENTS[event], id
+
+
+if __name__ == "__main__":
+  log = HLTLog(sys.argv[1], require_summary=False)
+  for cycle, event, id in log.events():
+    print(f"{cycle} @ {event} {id}")
+  if log.cycles is None:
+    sys.exit(1)
+  print(f"Cycles: {log.cycles}")
+  print(f"Calls: {log.num_calls}")
+  if log.latencies:
+    print(f"Latency (min/avg/max): {min(log.latencies)}/"
+          f"{sum(log.latencies) / len(log.latencies):.1f}/"
+          f"{max(log.latencies)}")
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+""" A JSON-lines database of the results of experiments run by
+ExperimentRunner.py. Each line records one run of an experiment: its name,
+the hash of its inputs, an optional label (e.g. the revision that was
+evaluated) and its cycles, utilization and timing.
+
+Run as a script to compare the latest results of two labels:
+  resultdb.py results/results.jsonl --baseline main --label my-change
+"""
+import argparse
+import json
+import sys
+import threading
+
+# Metrics which are compared between runs, and whether larger values are
+# better.
+METRICS = {"cycles": False, "fmax": True, "exectime": False}
+
+
+class ResultDB:
+
+  def __init__(self, path):
+    self.path = path
+    self.records = []
+    self.lock = threading.Lock()
+    try:
+      with open(path, "r") as f:
+        self.records = [json.loads(line) for line in f if line.strip()]
+    except FileNotFoundError:
+      pass
+
+  def lookup(self, experiment, name, key):
+    """ Returns the latest record of a run of 'name' with inputs 'key', if
+    any."""
+    for record in reversed(self.records):
+      if (record["experiment"], record["name"],
+          record["key"]) == (experiment, name, key):
+        return record
+    return None
+
+  def append(self, record):
+    with self.lock:
+      self.records.append(record)
+      with open(self.path, "a") as f:
+        f.write(json.dumps(record) + "\n")
+
+  def latest(self, label=None):
+    """ Returns the latest record of each experiment run with 'label', keyed
+    by (experiment, name)."""
+    latest = {}
+    for record in self.records:
+      if label is None or record.get("label") == label:
+        latest[(record["experiment"], record["name"])] = record
+    return latest
+
+
+def compare(baseline, current, threshold):
+  """ Returns (experiment, name, metric, baseline, current, change) for each
+  metric of 'current' which regressed by more than 'threshold' (a fraction)
+  against the record of the same run in 'baseline'."""
+  regressions = []
+  for run, record in current.items():
+    base = baseline.get(run)
+    if not base:
+      continue
+    for metric, higherIsBetter in METRICS.items():
+      old, new = base.get(metric), record.get(metric)
+      if not old or new is None:
+        continue
+      change = (new - old) / old
+      if (-change if higherIsBetter else change) > threshold:
+        regressions.append((*run, metric, old, new, change))
+  return regressions
+
+
+def print_regressions(regressions):
+  for experiment, name, metric, old, new, change in regressions:
+    print(f"REGRESSION: {experiment}/{name} {metric}: {old:.6g} -> {new:.6g} "
+          f"({change:+.1%})")
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser()
+  parser.add_argument("db", help="The results database")
+  parser.add_argument("--baseline",
+                      required=True,
+                      help="The label of the baseline runs.")
+  parser.add_argument(
+      "--label",
+      help="The label of the runs to compare to the baseline. Defaults to the "
+      "latest run of each experiment.")
+  parser.add_argument("--threshold",
+                      type=float,
+                      default=0.02,
+                      help="The relative change which is a regression.")
+  args = parser.parse_args()
+
+  db = ResultDB(args.db)
+  regressions = compare(db.latest(args.baseline), db.latest(args.label),
+                        args.threshold)
+  print_regressions(regressions)
+  sys.exit(1 if regressions else 0)
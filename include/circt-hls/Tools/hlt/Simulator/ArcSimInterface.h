@@ -0,0 +1,252 @@
+#ifndef CIRCT_TOOLS_HLT_ARCSIMINTERFACE_H
+#define CIRCT_TOOLS_HLT_ARCSIMINTERFACE_H
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// The handshake ports of the simulators are shared with verilated models: the
+// signals of an arcilator model are the same fixed-width unsigned integers as
+// those of Verilator (CData, SData, IData and QData). Only the Verilator
+// headers are required for these; the model is not linked against the
+// Verilator runtime.
+#include "circt-hls/Tools/hlt/Simulator/VerilatorSimInterface.h"
+
+// The signals of arcilator models are not introspected, and the models serve
+// no DPI-C calls.
+#if HLT_CHANNEL_STATS || HLT_OP_STATS || HLT_TOKEN_TRACE || HLT_SAIF ||        \
+    HLT_DEBUG_SERVER || HLT_DPI_MEMORIES || HLT_MEMORY_IMAGES
+#error "The enabled HLT_* features require a verilated model"
+#endif
+
+namespace circt {
+namespace hlt {
+
+/// Simulates a model compiled by arcilator, CIRCT's cycle-based simulator of
+/// the HW dialect, in place of a verilated model. This provides the interface
+/// of VerilatorSimInterface to the simulators which derive from it (see
+/// HandshakeSimInterface and CalyxSimInterface), such that these run on either
+/// model. 'TModel' is the class of the model, as emitted by
+/// arcilator-header-cpp.py: it owns the state of the model ('storage'), which
+/// its 'view' exposes as a reference to each port, and which 'eval' advances.
+/// 'dut' points to the view, such that the ports of the model are accessed as
+/// those of a verilated model. The model is traced by neither VCD nor FST.
+template <typename TInput, typename TOutput, typename TModel>
+class ArcSimInterface : public SimInterface<TInput, TOutput> {
+  using TView = decltype(std::declval<TModel>().view);
+
+public:
+  ArcSimInterface() : SimInterface<TInput, TOutput>() {
+    // The signals of the ports which the simulator constructs mark the model
+    // to be evaluated.
+    constructingModelDirty() = &modelDirty;
+    model = std::make_unique<TModel>();
+    dut = &model->view;
+  }
+
+  uint64_t time() override { return m_clockCycles; }
+
+  void step() override {
+    clock_flip();
+    m_clockCycles++;
+  }
+
+  void dump(std::ostream &out) const override {
+    out << "Port states:\n";
+    for (auto &inPort : this->inPorts)
+      out << *inPort << "\n";
+    for (auto &outPort : this->outPorts)
+      out << *outPort << "\n";
+    out << "\n";
+  }
+
+  void setup() override {
+    if (constructingModelDirty() == &modelDirty)
+      constructingModelDirty() = nullptr;
+
+    // Verify generic interface
+    assert(interface.clock != nullptr && "Must set pointer to clock signal");
+    assert((static_cast<bool>(interface.reset) ^
+            static_cast<bool>(interface.nReset)) &&
+           "Must set pointer to either reset or nReset");
+
+    resetModel();
+  }
+
+  void resetInPlace() override { resetModel(); }
+
+  /// The memories of arcilator models are not introspected; see
+  /// VerilatorSimInterface::addMemoryImage.
+  void addMemoryImage(const std::string &name, const std::string &,
+                      const std::string &) {
+    std::cerr << "The image of memory " << name
+              << " requires a verilated model\n";
+    std::abort();
+  }
+
+  bool saveCheckpoint(const std::string &path) override {
+#if HLT_CHECKPOINTS
+    // The whole state of the model is its storage, which is written as is,
+    // followed by the state of the ports and any other harness state.
+    std::ostringstream state;
+    saveState(state);
+    std::string stateStr = state.str();
+    uint64_t storageSize = model->storage.size();
+    uint64_t stateSize = stateStr.size();
+
+    std::ofstream os(path, std::ios::binary);
+    if (!os)
+      return false;
+    writeState(os, storageSize);
+    os.write(reinterpret_cast<const char *>(model->storage.data()),
+             storageSize);
+    writeState(os, stateSize);
+    os.write(stateStr.data(), stateSize);
+    return static_cast<bool>(os);
+#else
+    return false;
+#endif
+  }
+
+  bool restoreCheckpoint(const std::string &path) override {
+#if HLT_CHECKPOINTS
+    std::ifstream is(path, std::ios::binary);
+    if (!is)
+      return false;
+    uint64_t storageSize = 0;
+    readState(is, storageSize);
+    if (storageSize != model->storage.size())
+      return false;
+    is.read(reinterpret_cast<char *>(model->storage.data()), storageSize);
+    uint64_t stateSize = 0;
+    readState(is, stateSize);
+    std::string stateStr(stateSize, '\0');
+    is.read(stateStr.data(), stateSize);
+    if (!is)
+      return false;
+
+    std::istringstream state(stateStr);
+    restoreState(state);
+    modelDirty = true;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  void saveState(std::ostream &os) const override {
+    writeState(os, m_clockCycles);
+    for (auto &inPort : this->inPorts)
+      inPort->saveState(os);
+    for (auto &outPort : this->outPorts)
+      outPort->saveState(os);
+  }
+
+  void restoreState(std::istream &is) override {
+    readState(is, m_clockCycles);
+    for (auto &inPort : this->inPorts)
+      inPort->restoreState(is);
+    for (auto &outPort : this->outPorts)
+      outPort->restoreState(is);
+  }
+
+  void finish() override {}
+  void idle() override {}
+
+  /// Arcilator models are not traced; this is provided for the simulators
+  /// which close the trace of a verilated model before failing.
+  void closeTrace() {}
+
+protected:
+  // Holds the model in reset for HLT_RESET_CYCLES cycles, and resets the in-
+  // and output ports.
+  void resetModel() {
+    if (interface.reset)
+      *interface.reset = !0;
+    else
+      *interface.nReset = !1;
+    modelDirty = true;
+
+    for (auto &port : this->inPorts)
+      port->reset();
+    for (auto &port : this->outPorts)
+      port->reset();
+
+    for (int i = 0; i < HLT_RESET_CYCLES; ++i)
+      this->clock();
+
+    if (interface.reset)
+      *interface.reset = !1;
+    else
+      *interface.nReset = !0;
+    modelDirty = true;
+    this->clock();
+  }
+
+  void advanceTime() {
+    // As for verilated models, the model is only evaluated if its inputs were
+    // written since it was last evaluated.
+    if (HLT_EVAL_ON_CHANGE && !modelDirty)
+      return;
+    HLT_PROFILE_SCOPE("eval");
+    HLT_PERF_SCOPE(SimPerfComponent::Model);
+    model->eval();
+    modelDirty = false;
+  }
+
+  // Clocks the model a half phase (rising or falling edge)
+  void clock_half(bool rising) {
+    advanceTime();
+    *interface.clock = rising;
+    {
+      HLT_PERF_SCOPE(SimPerfComponent::Model);
+      model->eval();
+    }
+    modelDirty = false;
+    advanceTime();
+  }
+
+  void clock_rising() { clock_half(true); }
+  void clock_falling() { clock_half(false); }
+  void clock_flip() { clock_half(!*interface.clock); }
+  void clock() {
+    clock_rising();
+    clock_falling();
+  }
+
+  // Returns true if the state of the model changed since the last call. The
+  // storage of the model holds all of its state, including its ports.
+  bool modelChanged() {
+    const std::vector<uint8_t> &storage = model->storage;
+    if (modelSnapshot.size() == storage.size() &&
+        std::memcmp(modelSnapshot.data(), storage.data(), storage.size()) == 0)
+      return false;
+    modelSnapshot = storage;
+    return true;
+  }
+
+  // Snapshot of the storage of the model, as of the last call to
+  // modelChanged().
+  std::vector<uint8_t> modelSnapshot;
+
+  // The arcilator model, and the view of its ports.
+  std::unique_ptr<TModel> model;
+  TView *dut = nullptr;
+  VerilatorGenericInterface interface;
+
+  // Number of clock-cycles executed.
+  uint64_t m_clockCycles = 0;
+
+  // Set whenever an input of the model was written since the model was last
+  // evaluated; see advanceTime.
+  bool modelDirty = true;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_ARCSIMINTERFACE_H
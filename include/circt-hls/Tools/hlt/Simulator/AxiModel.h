@@ -0,0 +1,272 @@
+#ifndef CIRCT_TOOLS_HLT_AXIMODEL_H
+#define CIRCT_TOOLS_HLT_AXIMODEL_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <ostream>
+
+namespace circt {
+namespace hlt {
+
+struct AxiConfig {
+  // Width of the read and write data channels, in bytes.
+  unsigned beatBytes = 8;
+  // Number of beats of each burst. Bursts are aligned to their size.
+  unsigned burstBeats = 16;
+  // Maximum number of read, and of write, bursts in flight.
+  unsigned maxOutstanding = 4;
+  // Number of cycles from a read request until the first beat of its data,
+  // and from the last beat of a write until its response.
+  unsigned readLatency = 20;
+  unsigned writeLatency = 10;
+};
+
+/// An AxiModel models the timing of an AXI4 master through which a kernel
+/// accesses a memory. Accesses are served by fixed-length bursts: a load which
+/// falls into one of the last 'maxOutstanding' read bursts is served by the
+/// beat of that burst, and otherwise issues a new burst once a read
+/// transaction is free. Beats of consecutive bursts are serialized on the
+/// data channel. Stores are collected into write bursts, and a store which
+/// opens a new burst stalls while all write transactions are in flight. Only
+/// the timing is modelled; data is always accessed in the backing memory.
+class AxiModel {
+  struct Burst {
+    // Index of the burst within the memory.
+    size_t index = 0;
+    // For reads, the cycles at which the first and last beat of the burst
+    // are delivered; for writes, the cycles at which the burst was opened and
+    // its response is received.
+    uint64_t first = 0;
+    uint64_t last = 0;
+  };
+
+public:
+  AxiModel(const AxiConfig &config) : config(config) {
+    assert(config.beatBytes > 0 && config.burstBeats > 0 &&
+           config.maxOutstanding > 0 && "Invalid AXI configuration");
+  }
+
+  /// Reads the byte address 'addr' in 'cycle', returning the latency of the
+  /// read in cycles.
+  unsigned read(size_t addr, uint64_t cycle) {
+    size_t index = addr / burstBytes();
+    uint64_t beat = (addr % burstBytes()) / config.beatBytes;
+    auto it = std::find_if(reads.begin(), reads.end(),
+                           [&](const Burst &b) { return b.index == index; });
+    if (it == reads.end()) {
+      // Wait for the oldest burst to complete if all transactions are in
+      // flight.
+      uint64_t issue = cycle;
+      if (reads.size() == config.maxOutstanding) {
+        issue = std::max(issue, reads.front().last + 1);
+        reads.pop_front();
+      }
+      readStallCycles += issue - cycle;
+      uint64_t first =
+          std::max(issue + config.readLatency, lastReadBeat + 1);
+      lastReadBeat = first + config.burstBeats - 1;
+      reads.push_back({index, first, lastReadBeat});
+      readBursts++;
+      it = std::prev(reads.end());
+      peakReads = std::max(peakReads, inFlight(reads, cycle));
+    }
+    return std::max(it->first + beat, cycle + 1) - cycle;
+  }
+
+  /// Returns true if a store to the byte address 'addr' may be accepted in
+  /// 'cycle'.
+  bool canWrite(size_t addr, uint64_t cycle) const {
+    if (!writes.empty() && writes.back().index == addr / burstBytes() &&
+        openBeats < config.burstBeats)
+      return true;
+    return inFlight(writes, cycle) < config.maxOutstanding;
+  }
+
+  /// Writes the byte address 'addr' in 'cycle'. The write must be accepted
+  /// (see canWrite).
+  void write(size_t addr, uint64_t cycle) {
+    size_t index = addr / burstBytes();
+    if (!writes.empty() && writes.back().index == index &&
+        openBeats < config.burstBeats) {
+      openBeats++;
+      return;
+    }
+    while (!writes.empty() && writes.front().last < cycle)
+      writes.pop_front();
+    writes.push_back(
+        {index, cycle, cycle + config.burstBeats + config.writeLatency});
+    openBeats = 1;
+    writeBursts++;
+    peakWrites = std::max(peakWrites, inFlight(writes, cycle));
+  }
+
+  /// Returns the largest latency of a read which does not wait for a free
+  /// transaction.
+  unsigned maxLatency() const {
+    return config.readLatency + config.burstBeats;
+  }
+
+  /// Writes the traffic statistics of the master as a JSON object.
+  void dumpStatsJSON(std::ostream &os) const {
+    os << "{\"readBursts\": " << readBursts
+       << ", \"readBytes\": " << readBursts * burstBytes()
+       << ", \"readStallCycles\": " << readStallCycles
+       << ", \"peakReadsInFlight\": " << peakReads
+       << ", \"writeBursts\": " << writeBursts
+       << ", \"writeBytes\": " << writeBursts * burstBytes()
+       << ", \"peakWritesInFlight\": " << peakWrites << "}";
+  }
+
+  /// Writes the bursts and statistics of the master to a checkpoint stream,
+  /// and restores them. The configuration is not part of the state.
+  void saveState(std::ostream &os) const {
+    for (auto *bursts : {&reads, &writes}) {
+      size_t n = bursts->size();
+      os.write(reinterpret_cast<const char *>(&n), sizeof(n));
+      for (auto &burst : *bursts)
+        os.write(reinterpret_cast<const char *>(&burst), sizeof(burst));
+    }
+    for (auto *v : {&lastReadBeat, &openBeats, &readBursts, &writeBursts,
+                    &readStallCycles, &peakReads, &peakWrites})
+      os.write(reinterpret_cast<const char *>(v), sizeof(*v));
+  }
+  void restoreState(std::istream &is) {
+    for (auto *bursts : {&reads, &writes}) {
+      size_t n = 0;
+      is.read(reinterpret_cast<char *>(&n), sizeof(n));
+      bursts->resize(n);
+      for (auto &burst : *bursts)
+        is.read(reinterpret_cast<char *>(&burst), sizeof(burst));
+    }
+    for (auto *v : {&lastReadBeat, &openBeats, &readBursts, &writeBursts,
+                    &readStallCycles, &peakReads, &peakWrites})
+      is.read(reinterpret_cast<char *>(v), sizeof(*v));
+  }
+
+  uint64_t readBursts = 0;
+  uint64_t writeBursts = 0;
+  // Number of cycles which reads waited for a free transaction.
+  uint64_t readStallCycles = 0;
+
+private:
+  size_t burstBytes() const {
+    return static_cast<size_t>(config.beatBytes) * config.burstBeats;
+  }
+
+  static uint64_t inFlight(const std::deque<Burst> &bursts, uint64_t cycle) {
+    return std::count_if(bursts.begin(), bursts.end(),
+                         [&](const Burst &b) { return b.last >= cycle; });
+  }
+
+  AxiConfig config;
+  // The last read bursts, whose data may serve subsequent reads, and the
+  // write bursts which may be in flight; both in issue order.
+  std::deque<Burst> reads;
+  std::deque<Burst> writes;
+  uint64_t lastReadBeat = 0;
+  // Number of stores collected into the last write burst.
+  uint64_t openBeats = 0;
+  uint64_t peakReads = 0;
+  uint64_t peakWrites = 0;
+};
+
+struct AxiStreamConfig {
+  // Width of the data channel, in bytes. Each beat transfers as many elements
+  // of the stream as fit into it, and at least one.
+  unsigned beatBytes = 0;
+  // Number of cycles between consecutive beats.
+  unsigned interval = 1;
+  // Number of elements which may be buffered between the host and the kernel.
+  size_t depth = 8;
+};
+
+/// An AxiStreamModel models the timing of an AXI-Stream channel between the
+/// host and a kernel, through which the elements of a memory are streamed to
+/// the loads, or from the stores, of the kernel. The host transfers a beat
+/// once every 'interval' cycles while the buffer has room for it (towards the
+/// kernel) or holds elements (from the kernel). Only the timing is modelled;
+/// data is always accessed in the backing memory.
+class AxiStreamModel {
+public:
+  AxiStreamModel(const AxiStreamConfig &config, size_t elementBytes)
+      : config(config),
+        elementsPerBeat(std::max<size_t>(config.beatBytes / elementBytes, 1)) {
+    assert(config.interval > 0 && config.depth > 0 &&
+           "Invalid AXI-Stream configuration");
+  }
+
+  /// Whether the buffer holds an element to be loaded, or room for an element
+  /// to be stored, by the kernel.
+  bool ready(bool toKernel) const {
+    return toKernel ? buffered != 0 : buffered < config.depth;
+  }
+
+  /// Records an access of the kernel to the next element of the stream.
+  void access(bool toKernel) {
+    accessed++;
+    if (!toKernel)
+      buffered++;
+    else if (buffered != 0)
+      buffered--;
+  }
+
+  /// Transfers a beat between the host and the buffer, if the interval since
+  /// the last beat passed. Counts the cycles in which the buffer blocked the
+  /// transfer.
+  void transfer(bool toKernel, uint64_t cycle) {
+    if (cycle < nextBeat)
+      return;
+    if (!pending(toKernel)) {
+      blockedCycles++;
+      return;
+    }
+    if (toKernel)
+      buffered += std::min(elementsPerBeat, config.depth - buffered);
+    else
+      buffered -= std::min(elementsPerBeat, buffered);
+    beats++;
+    nextBeat = cycle + config.interval;
+  }
+
+  /// Whether the host has a beat to transfer.
+  bool pending(bool toKernel) const {
+    return toKernel ? buffered < config.depth : buffered != 0;
+  }
+
+  /// Writes the traffic statistics of the stream as a JSON object.
+  void dumpStatsJSON(std::ostream &os) const {
+    os << "{\"beats\": " << beats << ", \"elements\": " << accessed
+       << ", \"blockedCycles\": " << blockedCycles << "}";
+  }
+
+  void saveState(std::ostream &os) const {
+    for (auto *v : {&accessed, &buffered, &nextBeat, &beats, &blockedCycles})
+      os.write(reinterpret_cast<const char *>(v), sizeof(*v));
+  }
+  void restoreState(std::istream &is) {
+    for (auto *v : {&accessed, &buffered, &nextBeat, &beats, &blockedCycles})
+      is.read(reinterpret_cast<char *>(v), sizeof(*v));
+  }
+
+  // Number of elements accessed by the kernel, over all invocations.
+  uint64_t accessed = 0;
+
+private:
+  AxiStreamConfig config;
+  uint64_t elementsPerBeat;
+  // Number of elements in the buffer.
+  uint64_t buffered = 0;
+  uint64_t nextBeat = 0;
+  uint64_t beats = 0;
+  // Number of cycles in which a beat was due, but the buffer was full
+  // (towards the kernel) or empty (from the kernel).
+  uint64_t blockedCycles = 0;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_AXIMODEL_H
@@ -0,0 +1,158 @@
+#ifndef CIRCT_TOOLS_HLT_CACHEMODEL_H
+#define CIRCT_TOOLS_HLT_CACHEMODEL_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <random>
+#include <vector>
+
+namespace circt {
+namespace hlt {
+
+/// Policies for selecting which line of a cache set is evicted on a miss.
+enum class ReplacementPolicy {
+  // Evict the least recently accessed line.
+  LRU,
+  // Evict the line which was filled first.
+  FIFO,
+  // Evict a random line.
+  Random
+};
+
+struct CacheConfig {
+  // Total capacity of the cache, in bytes.
+  size_t sizeBytes = 32 * 1024;
+  // Number of lines in each set.
+  unsigned associativity = 4;
+  // Size of each cache line, in bytes.
+  unsigned lineBytes = 64;
+  ReplacementPolicy policy = ReplacementPolicy::LRU;
+  // Number of cycles from a request until its data is available, for hits and
+  // misses respectively.
+  unsigned hitLatency = 1;
+  unsigned missLatency = 20;
+};
+
+/// A CacheModel models the timing of a set-associative, write-allocate cache in
+/// front of a memory. Only the cache tags are modelled; data is always
+/// accessed in the backing memory.
+class CacheModel {
+  struct Line {
+    bool valid = false;
+    size_t tag = 0;
+    // Access counter values at which the line was last accessed and filled.
+    uint64_t lastAccess = 0;
+    uint64_t filled = 0;
+  };
+
+public:
+  CacheModel(const CacheConfig &config) : config(config) {
+    assert(config.associativity > 0 && config.lineBytes > 0 &&
+           "Invalid cache configuration");
+    numSets = config.sizeBytes / (config.lineBytes * config.associativity);
+    assert(numSets > 0 && "Cache must hold at least one set");
+    sets.assign(numSets, std::vector<Line>(config.associativity));
+  }
+
+  /// Accesses the byte address 'addr', returning the latency of the access in
+  /// cycles.
+  unsigned access(size_t addr) {
+    size_t lineAddr = addr / config.lineBytes;
+    auto &set = sets[lineAddr % numSets];
+    size_t tag = lineAddr / numSets;
+    accessCntr++;
+
+    for (auto &line : set) {
+      if (line.valid && line.tag == tag) {
+        line.lastAccess = accessCntr;
+        hits++;
+        return config.hitLatency;
+      }
+    }
+
+    misses++;
+    Line &victim = selectVictim(set);
+    victim.valid = true;
+    victim.tag = tag;
+    victim.lastAccess = accessCntr;
+    victim.filled = accessCntr;
+    return config.missLatency;
+  }
+
+  /// Returns the largest latency of any access to the cache.
+  unsigned maxLatency() const {
+    return std::max(config.hitLatency, config.missLatency);
+  }
+
+  double hitRate() const {
+    uint64_t accesses = hits + misses;
+    return accesses == 0 ? 0.0 : static_cast<double>(hits) / accesses;
+  }
+
+  /// Writes the statistics of the cache as a JSON object.
+  void dumpStatsJSON(std::ostream &os) const {
+    os << "{\"hits\": " << hits << ", \"misses\": " << misses
+       << ", \"hitRate\": " << hitRate() << "}";
+  }
+
+  /// Writes the tags and replacement state of the cache to a checkpoint
+  /// stream, and restores them. The configuration is not part of the state.
+  void saveState(std::ostream &os) const {
+    for (auto &set : sets)
+      os.write(reinterpret_cast<const char *>(set.data()),
+               set.size() * sizeof(Line));
+    for (auto *v : {&accessCntr, &hits, &misses})
+      os.write(reinterpret_cast<const char *>(v), sizeof(*v));
+    os << rng << '\n';
+  }
+  void restoreState(std::istream &is) {
+    for (auto &set : sets)
+      is.read(reinterpret_cast<char *>(set.data()), set.size() * sizeof(Line));
+    for (auto *v : {&accessCntr, &hits, &misses})
+      is.read(reinterpret_cast<char *>(v), sizeof(*v));
+    is >> rng;
+    is.ignore();
+  }
+
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+
+private:
+  Line &selectVictim(std::vector<Line> &set) {
+    for (auto &line : set)
+      if (!line.valid)
+        return line;
+
+    switch (config.policy) {
+    case ReplacementPolicy::LRU:
+      return *std::min_element(set.begin(), set.end(),
+                               [](const Line &lhs, const Line &rhs) {
+                                 return lhs.lastAccess < rhs.lastAccess;
+                               });
+    case ReplacementPolicy::FIFO:
+      return *std::min_element(set.begin(), set.end(),
+                               [](const Line &lhs, const Line &rhs) {
+                                 return lhs.filled < rhs.filled;
+                               });
+    case ReplacementPolicy::Random:
+      return set[rng() % set.size()];
+    }
+    assert(false && "Unhandled replacement policy");
+    return set.front();
+  }
+
+  CacheConfig config;
+  size_t numSets;
+  std::vector<std::vector<Line>> sets;
+  uint64_t accessCntr = 0;
+  // Fixed seed, such that simulations are reproducible.
+  std::minstd_rand rng{0};
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_CACHEMODEL_H
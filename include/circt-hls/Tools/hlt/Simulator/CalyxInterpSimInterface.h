@@ -0,0 +1,366 @@
+#ifndef CIRCT_TOOLS_HLT_CALYXINTERPSIMINTERFACE_H
+#define CIRCT_TOOLS_HLT_CALYXINTERPSIMINTERFACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "circt-hls/Tools/hlt/Simulator/MemoryInterface.h"
+#include "circt-hls/Tools/hlt/Simulator/StdSimInterface.h"
+
+namespace circt {
+namespace hlt {
+
+/// A scalar port of a Calyx component, and its width in bits.
+struct CalyxInterpPort {
+  std::string name;
+  unsigned width;
+};
+
+/// An external memory of a Calyx component: the shape and element width of
+/// the memory, and the ports through which the component accesses it. There
+/// is an address port for each dimension of the memory.
+struct CalyxInterpMemory {
+  unsigned width;
+  std::vector<int64_t> shape;
+  CalyxInterpPort readData;
+  CalyxInterpPort done;
+  CalyxInterpPort writeData;
+  CalyxInterpPort writeEn;
+  std::vector<CalyxInterpPort> addrs;
+};
+
+/// Simulates a Calyx component through the Calyx interpreter (Cider), rather
+/// than a verilated model of its RTL. Each call writes a harness program,
+/// which instantiates the component and a memory for each memory argument and
+/// result, and invokes the component once; the interpreter runs the program
+/// and returns the final contents of the memories, which are copied back to
+/// the host memories of the call. This skips lowering the kernel to RTL and
+/// verilating it, and is intended for functional iteration on static kernels,
+/// and for checking verilated models against the interpreter. Time is counted
+/// in calls, as for StdSimInterface; the cycles of the component are not.
+///
+/// The interpreter runs as a subprocess: the command given by
+/// HLT_CALYX_INTERP (by default, through fud) is invoked as
+///   <command> <program.futil> -s verilog.data <data.json> -o <out.json>
+/// in the working directory of the simulation. The harness files are named
+/// hlt_interp_<component>_<instance>*.
+template <typename TInput, typename TOutput>
+class CalyxInterpSimInterface : public StdSimInterface<TInput, TOutput> {
+public:
+  /// 'futil' is the Calyx program which defines 'component'.
+  CalyxInterpSimInterface(const std::string &futil,
+                          const std::string &component)
+      : futil(futil), component(component), instance(nextInstance()++) {}
+
+protected:
+  /// Describes the next argument of the kernel, in the order of TInput.
+  void addScalarArg(const CalyxInterpPort &port) {
+    args.push_back({false, port, {}});
+  }
+  void addMemoryArg(const CalyxInterpMemory &memory) {
+    args.push_back({true, {}, memory});
+  }
+  /// Describes the next result of the kernel, in the order of TOutput.
+  void addResult(const CalyxInterpPort &port) { results.push_back(port); }
+
+  TOutput call(const TInput &input) override {
+    // Gather the values of the scalar arguments and the contents of the
+    // memory arguments.
+    std::vector<std::vector<uint64_t>> values(args.size());
+    std::vector<std::function<void(const std::vector<uint64_t> &)>> writeBack(
+        args.size());
+    std::apply(
+        [&](const auto &...value) {
+          size_t i = 0;
+          (readArg(i++, value, values, writeBack), ...);
+        },
+        input);
+
+    // The files of each instance are distinct, such that a pool of simulators
+    // may run concurrently.
+    std::string prefix =
+        "hlt_interp_" + component + "_" + std::to_string(instance);
+    std::string program = prefix + ".futil";
+    std::string data = prefix + "_data.json";
+    std::string out = prefix + "_out.json";
+    writeProgram(program, values);
+    writeData(data, values);
+
+    const char *cmd = std::getenv("HLT_CALYX_INTERP");
+    std::string command = cmd ? cmd : "fud exec --from futil --to "
+                                      "interpreter-out";
+    command += " " + program + " -s verilog.data " + data + " -o " + out;
+    if (std::system(command.c_str()) != 0) {
+      std::cerr << "Calyx interpreter failed: " << command << "\n";
+      std::abort();
+    }
+
+    std::ifstream is(out);
+    std::string json((std::istreambuf_iterator<char>(is)),
+                     std::istreambuf_iterator<char>());
+    for (size_t i = 0; i < args.size(); ++i) {
+      if (!args[i].isMemory)
+        continue;
+      writeBack[i](readValues(json, memName(i), numElements(args[i].memory)));
+    }
+    std::vector<uint64_t> resValues;
+    for (size_t i = 0; i < results.size(); ++i)
+      resValues.push_back(readValues(json, resName(i), 1).front());
+    return makeOutput(resValues,
+                      std::make_index_sequence<std::tuple_size_v<TOutput>>());
+  }
+
+private:
+  struct Arg {
+    bool isMemory;
+    CalyxInterpPort scalar;
+    CalyxInterpMemory memory;
+  };
+
+  static std::atomic<unsigned> &nextInstance() {
+    static std::atomic<unsigned> next{0};
+    return next;
+  }
+
+  static std::string memName(size_t arg) { return "mem" + std::to_string(arg); }
+  static std::string resName(size_t res) { return "res" + std::to_string(res); }
+
+  static size_t numElements(const CalyxInterpMemory &memory) {
+    size_t n = 1;
+    for (int64_t size : memory.shape)
+      n *= size;
+    return n;
+  }
+
+  static uint64_t mask(uint64_t value, unsigned width) {
+    return width >= 64 ? value : value & ((uint64_t(1) << width) - 1);
+  }
+
+  // Returns the element at row-major index 'addr' of the host memory 'desc'.
+  template <typename TData, unsigned Rank>
+  static TData &element(const MemRefDescriptor<TData, Rank> &desc,
+                        size_t addr) {
+    TData *base = desc.aligned + desc.offset;
+    bool strided = false;
+    for (unsigned i = 0; i < Rank; ++i)
+      strided |= desc.strides[i] != 0;
+    if (!strided)
+      return base[addr];
+    int64_t offset = 0;
+    for (unsigned i = Rank; i-- > 0;) {
+      offset += (addr % desc.sizes[i]) * desc.strides[i];
+      addr /= desc.sizes[i];
+    }
+    return base[offset];
+  }
+
+  template <typename T>
+  void readArg(size_t i, const T &value,
+               std::vector<std::vector<uint64_t>> &values,
+               std::vector<std::function<void(const std::vector<uint64_t> &)>>
+                   &writeBack) {
+    if constexpr (IsMemRefDescriptor<T>::value) {
+      size_t n = numElements(args[i].memory);
+      for (size_t addr = 0; addr < n; ++addr)
+        values[i].push_back(static_cast<uint64_t>(element(value, addr)));
+      writeBack[i] = [value, n](const std::vector<uint64_t> &contents) {
+        using TData = MemoryElementT<T>;
+        for (size_t addr = 0; addr < n; ++addr)
+          element(value, addr) = static_cast<TData>(contents[addr]);
+      };
+    } else {
+      values[i].push_back(static_cast<uint64_t>(value));
+    }
+  }
+
+  // Writes the harness program: the program of the kernel, of which the
+  // harness is the entrypoint, and a 'main' component which connects the
+  // kernel to its memories, invokes it with the scalar arguments of the call,
+  // and stores its results.
+  void writeProgram(const std::string &path,
+                    const std::vector<std::vector<uint64_t>> &values) {
+    if (kernelSource.empty()) {
+      std::ifstream is(futil);
+      if (!is) {
+        std::cerr << "Could not read the Calyx program " << futil << "\n";
+        std::abort();
+      }
+      kernelSource.assign(std::istreambuf_iterator<char>(is),
+                          std::istreambuf_iterator<char>());
+      eraseAll(kernelSource, "\"toplevel\"=1, ");
+      eraseAll(kernelSource, ", \"toplevel\"=1");
+      eraseAll(kernelSource, "<\"toplevel\"=1>");
+    }
+
+    std::ostringstream os;
+    os << kernelSource << "\ncomponent main() -> () {\n  cells {\n"
+       << "    dut = " << component << "();\n";
+    for (size_t i = 0; i < args.size(); ++i) {
+      if (!args[i].isMemory)
+        continue;
+      auto &memory = args[i].memory;
+      os << "    @external(1) " << memName(i) << " = std_mem_d"
+         << memory.shape.size() << "(" << memory.width;
+      for (int64_t size : memory.shape)
+        os << ", " << size;
+      for (auto &addr : memory.addrs)
+        os << ", " << addr.width;
+      os << ");\n";
+    }
+    for (size_t i = 0; i < results.size(); ++i)
+      os << "    @external(1) " << resName(i) << " = std_mem_d1("
+         << results[i].width << ", 1, 1);\n";
+    os << "  }\n  wires {\n";
+    if (!results.empty()) {
+      os << "    group store_results {\n";
+      for (size_t i = 0; i < results.size(); ++i)
+        os << "      " << resName(i) << ".addr0 = 1'd0;\n      " << resName(i)
+           << ".write_data = dut." << results[i].name << ";\n      "
+           << resName(i) << ".write_en = 1'd1;\n";
+      os << "      store_results[done] = " << resName(0) << ".done;\n    }\n";
+    }
+    os << "  }\n  control {\n    seq {\n      invoke dut(";
+    std::vector<std::string> ins, outs;
+    for (size_t i = 0; i < args.size(); ++i) {
+      if (!args[i].isMemory) {
+        auto &port = args[i].scalar;
+        ins.push_back(port.name + " = " + std::to_string(port.width) + "'d" +
+                      std::to_string(mask(values[i].front(), port.width)));
+        continue;
+      }
+      auto &memory = args[i].memory;
+      std::string mem = memName(i) + ".";
+      ins.push_back(memory.readData.name + " = " + mem + "read_data");
+      ins.push_back(memory.done.name + " = " + mem + "done");
+      outs.push_back(memory.writeData.name + " = " + mem + "write_data");
+      outs.push_back(memory.writeEn.name + " = " + mem + "write_en");
+      for (size_t d = 0; d < memory.addrs.size(); ++d)
+        outs.push_back(memory.addrs[d].name + " = " + mem + "addr" +
+                       std::to_string(d));
+    }
+    auto emitBindings = [&](const std::vector<std::string> &bindings) {
+      for (size_t i = 0; i < bindings.size(); ++i)
+        os << (i == 0 ? "" : ", ") << bindings[i];
+    };
+    emitBindings(ins);
+    os << ")(";
+    emitBindings(outs);
+    os << ");\n";
+    if (!results.empty())
+      os << "      store_results;\n";
+    os << "    }\n  }\n}\n";
+
+    std::ofstream(path) << os.str();
+  }
+
+  // Writes the initial contents of the memories, nested by their shapes.
+  void writeData(const std::string &path,
+                 const std::vector<std::vector<uint64_t>> &values) {
+    std::ofstream os(path);
+    auto emitFormat = [&](unsigned width) {
+      os << "\"format\": {\"numeric_type\": \"bitnum\", \"is_signed\": false, "
+         << "\"width\": " << width << "}}";
+    };
+    os << "{";
+    bool first = true;
+    for (size_t i = 0; i < args.size(); ++i) {
+      if (!args[i].isMemory)
+        continue;
+      auto &memory = args[i].memory;
+      os << (first ? "" : ",") << "\n  \"" << memName(i) << "\": {\"data\": ";
+      size_t addr = 0;
+      std::function<void(size_t)> emitDim = [&](size_t dim) {
+        os << "[";
+        for (int64_t j = 0; j < memory.shape[dim]; ++j) {
+          os << (j == 0 ? "" : ", ");
+          if (dim + 1 < memory.shape.size())
+            emitDim(dim + 1);
+          else
+            os << mask(values[i][addr++], memory.width);
+        }
+        os << "]";
+      };
+      emitDim(0);
+      os << ", ";
+      emitFormat(memory.width);
+      first = false;
+    }
+    for (size_t i = 0; i < results.size(); ++i) {
+      os << (first ? "" : ",") << "\n  \"" << resName(i)
+         << "\": {\"data\": [0], ";
+      emitFormat(results[i].width);
+      first = false;
+    }
+    os << "\n}\n";
+  }
+
+  // Returns the first 'n' values of the array of memory 'name' within the
+  // output of the interpreter, flattening any nested arrays.
+  static std::vector<uint64_t> readValues(const std::string &json,
+                                          const std::string &name, size_t n) {
+    std::vector<uint64_t> res;
+    size_t pos = json.find("\"" + name + "\"");
+    if (pos != std::string::npos)
+      pos = json.find('[', pos);
+    if (pos == std::string::npos) {
+      std::cerr << "Memory " << name
+                << " is missing from the output of the Calyx interpreter\n";
+      std::abort();
+    }
+    int depth = 0;
+    for (; pos < json.size() && res.size() < n; ++pos) {
+      char c = json[pos];
+      if (c == '[') {
+        ++depth;
+      } else if (c == ']') {
+        if (--depth == 0)
+          break;
+      } else if (c == '-' || (c >= '0' && c <= '9')) {
+        char *end = nullptr;
+        if (c == '-')
+          res.push_back(static_cast<uint64_t>(
+              std::strtoll(json.c_str() + pos, &end, 10)));
+        else
+          res.push_back(std::strtoull(json.c_str() + pos, &end, 10));
+        pos = end - json.c_str() - 1;
+      }
+    }
+    res.resize(n, 0);
+    return res;
+  }
+
+  template <size_t... Is>
+  static TOutput makeOutput(const std::vector<uint64_t> &values,
+                            std::index_sequence<Is...>) {
+    return TOutput{
+        static_cast<std::tuple_element_t<Is, TOutput>>(values[Is])...};
+  }
+
+  static void eraseAll(std::string &str, const std::string &pattern) {
+    for (size_t pos = str.find(pattern); pos != std::string::npos;
+         pos = str.find(pattern, pos))
+      str.erase(pos, pattern.size());
+  }
+
+  std::string futil;
+  std::string component;
+  unsigned instance;
+  // The program of the kernel, as read on the first call.
+  std::string kernelSource;
+  std::vector<Arg> args;
+  std::vector<CalyxInterpPort> results;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_CALYXINTERPSIMINTERFACE_H
@@ -5,7 +5,32 @@
 #include "circt-hls/Tools/hlt/Simulator/VerilatorSimInterface.h"
 #include "llvm/ADT/STLExtras.h"
 
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
 #include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef HLT_CALYX_PIPELINED
+// Set to 1 to overlap consecutive invocations of a Calyx component. The next
+// input is then written as soon as the component signals 'done', and outputs
+// are buffered until popped by the host. Otherwise, an input is only accepted
+// once the output of the previous invocation has been popped.
+#define HLT_CALYX_PIPELINED 0
+#endif
+
+#ifndef HLT_CALYX_STATIC_FAST_FORWARD
+// Set to 0 to step components of a static latency (see
+// CalyxSimInterface::setStaticLatency) through every cycle of an invocation.
+// Otherwise, the cycles before 'done' is due are run in a tight loop within a
+// single step, such that the runner and the cycle limit, checkpoints and debug
+// server observe the invocation at a coarser granularity.
+#define HLT_CALYX_STATIC_FAST_FORWARD 1
+#endif
 
 namespace circt {
 namespace hlt {
@@ -14,7 +39,7 @@ template <typename TSig, typename TPort>
 class CalyxPort : public TPort, public VerilatorSignal<TSig> {
 public:
   using VerilatorSignal<TSig>::VerilatorSignal;
-  bool eval(bool firstInStep) override {}
+  bool eval(bool firstInStep) override { return false; }
   void reset() override {}
 };
 
@@ -24,9 +49,48 @@ using CalyxOutPort = CalyxPort<TSig, SimulatorOutPort>;
 template <typename TSig>
 using CalyxInPort = CalyxPort<TSig, SimulatorInPort>;
 
+/// Measures the intervals between consecutive writes to a Calyx memory. Within
+/// a pipelined loop which stores to the memory once per iteration, the most
+/// frequent interval is the initiation interval (II) of the loop.
+class CalyxWriteIntervals {
+public:
+  virtual ~CalyxWriteIntervals() = default;
+
+  /// Returns the most frequent interval between consecutive writes, in cycles,
+  /// if the memory was written to at least twice.
+  std::optional<uint64_t> getWriteII() const {
+    std::optional<uint64_t> ii;
+    uint64_t count = 0;
+    for (auto &it : intervals)
+      if (it.second > count) {
+        ii = it.first;
+        count = it.second;
+      }
+    return ii;
+  }
+
+protected:
+  // Records a write in cycle 'cycle'.
+  void recordWrite(uint64_t cycle) {
+    if (lastWrite)
+      intervals[cycle - *lastWrite]++;
+    lastWrite = cycle;
+  }
+
+private:
+  std::optional<uint64_t> lastWrite;
+  // Number of times that consecutive writes were each interval apart.
+  std::map<uint64_t, uint64_t> intervals;
+};
+
+/// A CalyxMemoryInterface models a Calyx std_mem_d1 memory; reads are
+/// combinational, and writes are committed on the clock edge following the
+/// cycle in which write_en was asserted, with 'done' raised for the cycle
+/// after the write.
 template <typename TData, typename TAddr>
 class CalyxMemoryInterface : public SimulatorInPort,
-                             public MemoryInterfaceBase<TData> {
+                             public MemoryInterfaceBase<TData>,
+                             public CalyxWriteIntervals {
 
 public:
   // A memory interface is initialized with a static memory size. This is
@@ -37,60 +101,139 @@ public:
                        std::shared_ptr<CalyxInPort<TData>> writeDataSignal,
                        std::shared_ptr<CalyxInPort<CData>> writeEnSignal,
                        std::shared_ptr<CalyxInPort<TAddr>> addrSignal)
-      : MemoryInterfaceBase<TData>(size), readDataSignal(readDataSignal),
-        addrSignal(addrSignal), doneSignal(doneSignal),
-        writeDataSignal(writeDataSignal), writeEnSignal(writeEnSignal) {}
+      : MemoryInterfaceBase<TData>(size), size(size),
+        readDataSignal(readDataSignal), doneSignal(doneSignal),
+        writeDataSignal(writeDataSignal), writeEnSignal(writeEnSignal),
+        addrSignal(addrSignal), readData(readDataSignal.get()),
+        done(doneSignal.get()), writeData(writeDataSignal.get()),
+        writeEn(writeEnSignal.get()), addr(addrSignal.get()) {}
   void dump(std::ostream &os) const {}
 
-  void reset() {
-    *readDataSignal = 0;
-    *writeDataSignal = 0;
-    *doneSignal = 0;
-    *writeEnSignal = 0;
-    *addrSignal = 0;
+  void reset() override {
+    // Assigned through assign(); '*port = 0' would select the implicit copy
+    // assignment of the port, and reset the signal pointer.
+    readData->assign(0);
+    writeData->assign(0);
+    done->assign(0);
+    writeEn->assign(0);
+    addr->assign(0);
+    writeNext = false;
+    readValid = false;
   }
 
   // Writing to an input port implies setting the valid signal.
   virtual void write() { assert(false && "N/A for memory interfaces."); }
+
+  void setMemory(void *memory) override {
+    MemoryInterfaceBase<TData>::setMemory(memory);
+    readValid = false;
+  }
+
+  // Evaluated on each clock edge (firstInStep) and whenever the model settled.
+  // Returns true if any signals driven by the memory changed.
   bool eval(bool firstInStep) override {
-    if (this->writeEnSignal)
-      this->write(*addrSignal, *writeDataSignal);
-    *readDataSignal = this->read(*addrSignal);
+    bool changed = false;
+    if (firstInStep) {
+      // Commit the write requested in the previous cycle.
+      changed |= done->assign(writeNext);
+      if (writeNext) {
+        MemoryInterfaceBase<TData>::write(nextAddr, nextData);
+        recordWrite(cycle);
+        readValid = false;
+      }
+      writeNext = false;
+      cycle++;
+    }
+
+    // Sample the write request of the current cycle. The last evaluation
+    // before the next clock edge sees the settled signals.
+    writeNext = *writeEn != 0;
+    if (writeNext) {
+      nextAddr = *addr;
+      nextData = *writeData;
+    }
+
+    // The read port is combinational; only re-read the memory if the address
+    // or the memory contents changed. The address need not be valid when the
+    // kernel is not reading, so out of bounds addresses are not read.
+    TAddr readAddr = *addr;
+    if ((!readValid || readAddr != lastReadAddr) && this->memory_ptr &&
+        static_cast<size_t>(readAddr) < size) {
+      changed |= readData->assign(this->read(readAddr));
+      lastReadAddr = readAddr;
+      readValid = true;
+    }
+    return changed;
   }
 
 private:
+  size_t size;
+
+  // Owning references to the signals of the memory.
   std::shared_ptr<CalyxOutPort<TData>> readDataSignal;
-  std::shared_ptr<CalyxOutPort<TData>> writeDataSignal;
-  std::shared_ptr<CalyxInPort<TAddr>> addrSignal;
-  std::shared_ptr<CalyxInPort<CData>> doneSignal;
+  std::shared_ptr<CalyxOutPort<CData>> doneSignal;
+  std::shared_ptr<CalyxInPort<TData>> writeDataSignal;
   std::shared_ptr<CalyxInPort<CData>> writeEnSignal;
+  std::shared_ptr<CalyxInPort<TAddr>> addrSignal;
+
+  // Raw pointers to the above, used during evaluation.
+  CalyxOutPort<TData> *readData;
+  CalyxOutPort<CData> *done;
+  CalyxInPort<TData> *writeData;
+  CalyxInPort<CData> *writeEn;
+  CalyxInPort<TAddr> *addr;
+
+  // A write which is committed on the next clock edge.
+  bool writeNext = false;
+  TAddr nextAddr = 0;
+  TData nextData = 0;
+
+  // The address currently presented on the read port, if readData holds the
+  // memory contents at that address.
+  bool readValid = false;
+  TAddr lastReadAddr = 0;
+
+  // Number of clock edges which the memory was evaluated on.
+  uint64_t cycle = 0;
 };
 
-template <typename TInput, typename TOutput, typename TModel>
-class CalyxSimInterface
-    : public VerilatorSimInterface<TInput, TOutput, TModel> {
-  using VerilatorSimImpl = VerilatorSimInterface<TInput, TOutput, TModel>;
+/// 'TModelSim' is the interface of the simulated model: VerilatorSimInterface
+/// for verilated models, or ArcSimInterface for arcilator models.
+template <typename TInput, typename TOutput, typename TModel,
+          template <typename, typename, typename> class TModelSim =
+              VerilatorSimInterface>
+class CalyxSimInterface : public TModelSim<TInput, TOutput, TModel> {
+  using VerilatorSimImpl = TModelSim<TInput, TOutput, TModel>;
 
 public:
   CalyxSimInterface() : VerilatorSimImpl() {}
 
   // The Calyx simulator is ready to accept inputs whenever it is not
-  // currently transacting an input buffer.
-  bool inReady() override { return !this->inBuffer.has_value(); }
+  // currently transacting an input buffer. Unless pipelined, the previous
+  // invocation must additionally have finished and its output been popped.
+  bool inReady() override {
+    if (this->inBuffer.has_value())
+      return false;
+    return HLT_CALYX_PIPELINED || (!running && outBuffer.empty());
+  }
 
   // The Calyx simulator is ready to provide an output whenever it has
   // a valid output buffer.
-  bool outValid() override { return this->outBuffer.has_value(); }
+  bool outValid() override { return !this->outBuffer.empty(); }
 
   void pushInput(const TInput &input) override {
     assert(!this->inBuffer.has_value());
     this->inBuffer = input;
   }
+  void pushInput(TInput &&input) override {
+    assert(!this->inBuffer.has_value());
+    this->inBuffer = std::move(input);
+  }
 
   TOutput popOutput() override {
-    assert(this->outBuffer.has_value());
-    TOutput out = this->outBuffer.value();
-    this->outBuffer.reset();
+    assert(!this->outBuffer.empty());
+    TOutput out = this->outBuffer.front();
+    this->outBuffer.pop_front();
     return out;
   }
 
@@ -98,19 +241,82 @@ public:
     // Rising edge
     VerilatorSimImpl::clock_rising();
 
+    // Let the memories commit writes and respond to the new addresses.
+    if (evalPorts(/*firstInStep=*/true))
+      this->advanceTime();
+    if (HLT_CALYX_STATIC_FAST_FORWARD && running && staticLatency)
+      fastForwardStatic();
+
     readToOutputBuffer();
-    bool wroteInput = writeFromInputBuffer();
+    writeFromInputBuffer();
+    // 'go' is held until the kernel signals 'done'. When pipelined, the next
+    // invocation may already have been started in the same cycle.
+    if (!running)
+      this->go->assign(0);
     VerilatorSimImpl::clock_falling();
 
-    if (wroteInput) {
-      // Reset the 'go' signal.
-      this->go->assign(0);
-    }
+    // Sample the settled signals of the current cycle.
+    if (evalPorts(/*firstInStep=*/false))
+      this->advanceTime();
 
     this->advanceTime();
     this->m_clockCycles++;
   }
 
+  void setup() override {
+    VerilatorSimImpl::setup();
+    parseExpectedII();
+  }
+
+  void finish() override {
+    VerilatorSimImpl::finish();
+    checkII();
+  }
+
+  void idle() override {
+    VerilatorSimImpl::idle();
+    // The runner may never finish the simulator, so keep the check on disk up
+    // to date whenever the simulation goes idle.
+    if (!expectedII.empty() && this->m_clockCycles != iiCheckCycle)
+      writeIICheck();
+  }
+
+  /// Sets the latency of the component, in cycles from the cycle in which 'go'
+  /// is raised to the cycle in which 'done' is raised, as inferred by the
+  /// Calyx compiler for static components. The harness then skips the cycles
+  /// of an invocation before 'done' is due; see HLT_CALYX_STATIC_FAST_FORWARD.
+  /// 'done' is still checked in each cycle, so an invocation which finishes
+  /// early is not missed.
+  void setStaticLatency(uint64_t cycles) { staticLatency = cycles; }
+
+  // Runs the cycles of the current invocation up to the cycle before 'done'
+  // is due, from the rising edge of the current cycle. The ports are
+  // evaluated as in step(), but the host is not consulted: while the
+  // component is running and has not signalled 'done', reading outputs and
+  // writing inputs are no-ops.
+  void fastForwardStatic() {
+    while (*this->done == 0 && this->m_clockCycles + 1 < doneCycle) {
+      VerilatorSimImpl::clock_falling();
+      if (evalPorts(/*firstInStep=*/false))
+        this->advanceTime();
+      this->advanceTime();
+      this->m_clockCycles++;
+
+      VerilatorSimImpl::clock_rising();
+      if (evalPorts(/*firstInStep=*/true))
+        this->advanceTime();
+    }
+  }
+
+  // Evaluates the input ports, including the memories. Returns true if any
+  // signals changed.
+  bool evalPorts(bool firstInStep) {
+    bool changed = false;
+    for (auto &port : this->inPorts)
+      changed |= port->eval(firstInStep);
+    return changed;
+  }
+
   template <std::size_t I = 0, typename... Tp>
   inline typename std::enable_if<I == sizeof...(Tp), void>::type
   readOutputRec(std::tuple<Tp...> &) {
@@ -132,9 +338,10 @@ public:
     if (*this->done == 0)
       return;
     // Kernel indicated 'done'; read to output buffer.
-    assert(!this->outBuffer.has_value() && "Output buffer already has value");
-    outBuffer = TOutput();
-    readOutputRec(outBuffer.value());
+    assert(running && "Kernel signalled 'done' without being started");
+    outBuffer.emplace_back();
+    readOutputRec(outBuffer.back());
+    running = false;
   }
 
   template <std::size_t I = 0, typename... Tp>
@@ -148,11 +355,18 @@ public:
       typename std::enable_if < I<sizeof...(Tp), void>::type
                                 writeInputRec(const std::tuple<Tp...> &tInput) {
     auto value = std::get<I>(tInput);
-    auto &inBufferV = inBuffer.value();
     // Is this a simple input port?
     auto p = this->inPorts.at(I).get();
+    // Memory interface, passed as a memref descriptor?
+    if constexpr (IsMemRefDescriptor<decltype(value)>::value) {
+      auto inMemPort = dynamic_cast<
+          MemoryInterfaceBase<MemoryElementT<decltype(value)>> *>(p);
+      assert(inMemPort && "Unsupported input port type");
+      inMemPort->setMemory(value);
+    }
     // Normal port?
-    if (auto inPort = dynamic_cast<CalyxInPort<decltype(value)> *>(p); inPort)
+    else if (auto inPort = dynamic_cast<CalyxInPort<decltype(value)> *>(p);
+             inPort)
       inPort->assign(value);
     // Memory interface?
     else if (auto inMemPort = dynamic_cast<
@@ -168,24 +382,112 @@ public:
   }
 
   // Writes a value from the input buffer to the ports of the model. Returns
-  // true if the kernel was initiated.
+  // true if the kernel was initiated. When pipelined, this happens in the same
+  // cycle that the previous invocation signalled 'done'.
   bool writeFromInputBuffer() {
-    if (!this->inBuffer.has_value())
+    if (!this->inBuffer.has_value() || running)
       return false;
-    assert(!this->inBuffer.has_value() && "Input buffer already has a value!");
     auto &inBufferV = inBuffer.value();
     writeInputRec(inBufferV);
+    inBuffer.reset();
+    running = true;
+    if (staticLatency)
+      doneCycle = this->m_clockCycles + *staticLatency;
 
     // Finally, write the 'go' port.
     return this->go.get()->assign(1);
   }
 
 protected:
+  // Reads the II which the schedule of the kernel (<kernel>_schedule.json,
+  // see hlstool static --pipeline) expects of the pipelined loop storing to
+  // each memory, from HLT_CALYX_EXPECTED_II. This is a comma-separated list of
+  // '<argument index>:<II>'.
+  void parseExpectedII() {
+    const char *spec = std::getenv("HLT_CALYX_EXPECTED_II");
+    if (!spec)
+      return;
+    std::istringstream ss(spec);
+    std::string entry;
+    while (std::getline(ss, entry, ',')) {
+      size_t colon = entry.find(':');
+      if (colon == std::string::npos) {
+        std::cerr << "Warning: Ignoring malformed HLT_CALYX_EXPECTED_II entry '"
+                  << entry << "'\n";
+        continue;
+      }
+      size_t arg = std::stoul(entry.substr(0, colon));
+      if (arg >= this->inPorts.size() ||
+          !dynamic_cast<CalyxWriteIntervals *>(this->inPorts[arg].get())) {
+        std::cerr << "Warning: HLT_CALYX_EXPECTED_II names argument " << arg
+                  << ", which is not a memory\n";
+        continue;
+      }
+      expectedII.push_back({arg, std::stoull(entry.substr(colon + 1))});
+    }
+  }
+
+  // Writes the expected and measured II of each memory to ii_check.json, next
+  // to the simulator log. Returns false if any measured II differs from the
+  // expected II.
+  bool writeIICheck() {
+    iiCheckCycle = this->m_clockCycles;
+    bool matches = true;
+    std::ofstream os(this->instance == 0
+                         ? "ii_check.json"
+                         : "ii_check_" + std::to_string(this->instance) +
+                               ".json");
+    os << "{\"memories\": [";
+    for (size_t i = 0; i < expectedII.size(); ++i) {
+      auto [arg, expected] = expectedII[i];
+      auto measured = dynamic_cast<CalyxWriteIntervals *>(
+                          this->inPorts[arg].get())
+                          ->getWriteII();
+      os << (i == 0 ? "" : ", ") << "{\"arg\": " << arg
+         << ", \"expected\": " << expected << ", \"measured\": ";
+      if (measured)
+        os << *measured;
+      else
+        os << "null";
+      os << "}";
+      matches &= !measured || *measured == expected;
+    }
+    os << "]}\n";
+    return matches;
+  }
+
+  // Checks the measured II of each memory against the expected II.
+  void checkII() {
+    if (expectedII.empty() || writeIICheck())
+      return;
+    for (auto [arg, expected] : expectedII) {
+      auto measured = dynamic_cast<CalyxWriteIntervals *>(
+                          this->inPorts[arg].get())
+                          ->getWriteII();
+      if (measured && *measured != expected)
+        std::cerr << "Warning: Measured an II of " << *measured
+                  << " for the stores to argument " << arg
+                  << ", but the schedule expects an II of " << expected
+                  << "\n";
+    }
+  }
+
+  // Expected II of the stores to each memory, by argument index.
+  std::vector<std::pair<size_t, uint64_t>> expectedII;
+  // Clock cycle at which ii_check.json was last written.
+  uint64_t iiCheckCycle = 0;
+
   // Pointer to the "go" and "done" ports of the calyx component.
   std::shared_ptr<CalyxInPort<CData>> go, done;
   std::optional<TInput> inBuffer;
-  std::optional<TOutput> outBuffer;
+  // Outputs of finished invocations, in the order they finished.
+  std::deque<TOutput> outBuffer;
+  // Set while an invocation of the kernel is in progress.
   bool running = false;
+  // The static latency of the component, if known, and the cycle in which the
+  // current invocation is due to signal 'done'.
+  std::optional<uint64_t> staticLatency;
+  uint64_t doneCycle = 0;
 };
 
 } // namespace hlt
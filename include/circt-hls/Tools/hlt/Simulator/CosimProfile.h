@@ -0,0 +1,170 @@
+#ifndef CIRCT_TOOLS_HLT_COSIMPROFILE_H
+#define CIRCT_TOOLS_HLT_COSIMPROFILE_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <dlfcn.h>
+
+// Per call site timing of the reference and the targets of cosimulated calls
+// (see cosim-lower-call{profile}).
+
+namespace circt {
+namespace hlt {
+
+/// The simulated cycles of a target are read through the '<target>_cycles'
+/// function of its wrapper, which is resolved at runtime, such that software
+/// targets need not define it. Speedups in hardware are at a clock of
+/// $HLT_COSIM_CLOCK_MHZ (100 MHz by default).
+class CosimProfiler {
+  struct Entry {
+    const char *name;
+    bool isRef;
+    uint64_t calls = 0;
+    int64_t hostNs = 0;
+    // The simulated cycles of the calls, if the target reports them.
+    uint64_t cycles = 0;
+    uint64_t cycleCalls = 0;
+  };
+
+  struct Site {
+    // The reference and targets of the site, in order of first record.
+    std::vector<Entry> entries;
+  };
+
+public:
+  /// Returns the profiler of the process. The profiler is never destroyed;
+  /// the table is printed by an exit handler.
+  static CosimProfiler &get() {
+    static CosimProfiler *profiler = []() {
+      auto *p = new CosimProfiler();
+      std::atexit([]() { get().dump(); });
+      return p;
+    }();
+    return *profiler;
+  }
+
+  int64_t now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /// Records a call of 'name' at 'site', which took 'ns' on the host. 'site'
+  /// and 'name' are strings of the testbench, which outlive the profiler.
+  void record(const char *site, const char *name, int64_t ns, bool isRef) {
+    uint64_t cycles = isRef ? 0 : getCycles(name);
+    std::lock_guard<std::mutex> l(lock);
+    Site &s = sites[site];
+    Entry *entry = nullptr;
+    for (Entry &e : s.entries)
+      if (std::strcmp(e.name, name) == 0)
+        entry = &e;
+    if (!entry)
+      entry = &s.entries.emplace_back(Entry{name, isRef});
+    ++entry->calls;
+    entry->hostNs += ns;
+    if (cycles) {
+      entry->cycles += cycles;
+      ++entry->cycleCalls;
+    }
+  }
+
+private:
+  using CyclesFn = uint64_t (*)();
+
+  // Returns the simulated cycles of the last call of 'name', or 0 if the
+  // target doesn't report them.
+  uint64_t getCycles(const char *name) {
+    CyclesFn fn;
+    {
+      std::lock_guard<std::mutex> l(lock);
+      auto it = cyclesFns.find(name);
+      if (it == cyclesFns.end()) {
+        std::string symbol = std::string(name) + "_cycles";
+        it = cyclesFns
+                 .emplace(name, reinterpret_cast<CyclesFn>(
+                                    dlsym(RTLD_DEFAULT, symbol.c_str())))
+                 .first;
+      }
+      fn = it->second;
+    }
+    return fn ? fn() : 0;
+  }
+
+  void dump() {
+    std::lock_guard<std::mutex> l(lock);
+    if (sites.empty())
+      return;
+    double mhz = 100.0;
+    if (const char *env = std::getenv("HLT_COSIM_CLOCK_MHZ"))
+      mhz = std::atof(env) > 0 ? std::atof(env) : mhz;
+
+    std::printf("COSIM PROFILE: speedups at %g MHz\n", mhz);
+    for (auto &[site, s] : sites) {
+      // Speedups are relative to the mean host time of the reference.
+      double refNs = 0;
+      for (Entry &e : s.entries)
+        if (e.isRef && e.calls)
+          refNs = static_cast<double>(e.hostNs) / e.calls;
+
+      std::printf("%s\n", site.c_str());
+      std::printf("  %-32s %10s %14s %14s %12s %12s\n", "function", "calls",
+                  "host us/call", "cycles/call", "host x", "hw x");
+      for (Entry &e : s.entries) {
+        double hostNs = e.calls ? static_cast<double>(e.hostNs) / e.calls : 0;
+        std::printf("  %-32s %10llu %14.3f", e.name,
+                    static_cast<unsigned long long>(e.calls), hostNs / 1e3);
+        if (e.cycleCalls) {
+          double cycles = static_cast<double>(e.cycles) / e.cycleCalls;
+          std::printf(" %14.1f", cycles);
+          printSpeedup(refNs, hostNs);
+          printSpeedup(refNs, cycles * 1e3 / mhz);
+        } else {
+          std::printf(" %14s", "-");
+          printSpeedup(e.isRef ? 0 : refNs, hostNs);
+          std::printf(" %12s", "-");
+        }
+        std::printf("\n");
+      }
+    }
+    std::fflush(stdout);
+  }
+
+  static void printSpeedup(double refNs, double ns) {
+    if (refNs > 0 && ns > 0)
+      std::printf(" %12.2f", refNs / ns);
+    else
+      std::printf(" %12s", "-");
+  }
+
+  std::mutex lock;
+  std::map<std::string, Site> sites;
+  std::map<std::string, CyclesFn> cyclesFns;
+};
+
+} // namespace hlt
+} // namespace circt
+
+/// Returns the host time, in nanoseconds, which calls are timed by.
+extern "C" int64_t hlt_cosim_profile_now() {
+  return circt::hlt::CosimProfiler::get().now();
+}
+
+/// Records a call of 'name' at 'site' which started at 'begin' (see
+/// hlt_cosim_profile_now). 'isRef' is nonzero for the reference.
+extern "C" void hlt_cosim_profile_record(const char *site, const char *name,
+                                         int64_t begin, int32_t isRef) {
+  auto &profiler = circt::hlt::CosimProfiler::get();
+  profiler.record(site, name, profiler.now() - begin, isRef != 0);
+}
+
+#endif // CIRCT_TOOLS_HLT_COSIMPROFILE_H
@@ -0,0 +1,323 @@
+#ifndef CIRCT_TOOLS_HLT_COSIMRUNTIME_H
+#define CIRCT_TOOLS_HLT_COSIMRUNTIME_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// The runtime of memref comparisons in cosimulation, to a call of which
+// cosim-lower-compare{runtime} lowers the comparison of each contiguous memref
+// (see hlt_cosim_compare_memref).
+
+namespace circt {
+namespace hlt {
+
+/// Memories are compared in chunks on up to HLT_COSIM_THREADS threads (one per
+/// hardware thread by default). Each chunk only counts its mismatches, such
+/// that its loop is vectorized; the elements of a mismatching memory are then
+/// reported in order, as the lowered comparison loops report them.
+class CosimRuntime {
+public:
+  /// The flags of a comparison, as passed by cosim-lower-compare.
+  enum Flags : int32_t {
+    EarlyExit = 1,
+    NanEqual = 2,
+    Hash = 4,
+    PrintDigests = 8,
+  };
+
+  /// The kinds of elements of the compared memories.
+  enum Kind : int32_t { Int = 0, Float = 1 };
+
+  struct Compare {
+    const uint8_t *ref;
+    const uint8_t *target;
+    std::vector<int64_t> shape;
+    int64_t elements;
+    Kind kind;
+    unsigned bits;
+    int64_t maxReports;
+    int32_t flags;
+    double absTolerance;
+    uint64_t ulpTolerance;
+    // The sources of the compared memories, appended to each report.
+    const char *sites;
+  };
+
+  static void compare(const Compare &cmp) {
+    switch (cmp.kind == Float ? cmp.bits : 0) {
+    case 32:
+      return compareAs<float, uint32_t>(cmp);
+    case 64:
+      return compareAs<double, uint64_t>(cmp);
+    default:
+      break;
+    }
+    switch ((cmp.bits + 7) / 8) {
+    case 1:
+      return compareAs<uint8_t, uint8_t>(cmp);
+    case 2:
+      return compareAs<uint16_t, uint16_t>(cmp);
+    case 4:
+      return compareAs<uint32_t, uint32_t>(cmp);
+    default:
+      return compareAs<uint64_t, uint64_t>(cmp);
+    }
+  }
+
+private:
+  // Elements per thread below which a memory is compared on fewer threads.
+  static constexpr int64_t kMinChunk = 1 << 16;
+
+  static unsigned getThreads(int64_t elements) {
+    static const unsigned threads = [] {
+      if (const char *env = std::getenv("HLT_COSIM_THREADS"))
+        return std::max(1, std::atoi(env));
+      return static_cast<int>(
+          std::max(1u, std::thread::hardware_concurrency()));
+    }();
+    int64_t chunks = std::min<int64_t>(threads, elements / kMinChunk);
+    return static_cast<unsigned>(std::max<int64_t>(1, chunks));
+  }
+
+  // Runs 'f(begin, end, chunk)' over the chunks of [0, elements), each on a
+  // thread of its own, and returns the number of chunks.
+  template <typename F>
+  static unsigned forEachChunk(int64_t elements, F &&f) {
+    unsigned chunks = getThreads(elements);
+    if (chunks == 1) {
+      f(0, elements, 0);
+      return 1;
+    }
+    int64_t chunkSize = (elements + chunks - 1) / chunks;
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < chunks; ++i) {
+      int64_t begin = std::min(elements, i * chunkSize);
+      int64_t end = std::min(elements, begin + chunkSize);
+      workers.emplace_back([&f, begin, end, i] { f(begin, end, i); });
+    }
+    for (auto &worker : workers)
+      worker.join();
+    return chunks;
+  }
+
+  // The splitmix64 finalizer; see insertMix of cosim-lower-compare.
+  static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+  }
+
+  // Returns the digest of the memory 'data', which equals that of the
+  // digest loops of cosim-lower-compare{hash}: the sum of the hash of each
+  // element with its linear index.
+  template <typename Bits>
+  static uint64_t digest(const Bits *data, int64_t elements, Bits mask) {
+    std::vector<uint64_t> sums(getThreads(elements), 0);
+    forEachChunk(elements, [&](int64_t begin, int64_t end, unsigned chunk) {
+      uint64_t sum = 0;
+      for (int64_t i = begin; i < end; ++i) {
+        uint64_t bits = static_cast<uint64_t>(data[i] & mask);
+        uint64_t position = static_cast<uint64_t>(i) * 0x9e3779b97f4a7c15ULL;
+        sum += mix(bits + mix(position));
+      }
+      sums[chunk] = sum;
+    });
+    uint64_t sum = 0;
+    for (uint64_t chunkSum : sums)
+      sum += chunkSum;
+    return sum;
+  }
+
+  template <typename T, typename Bits>
+  static bool mismatch(const Compare &cmp, T a, T b, Bits mask) {
+    if constexpr (std::is_floating_point_v<T>) {
+      if (a == b)
+        return false;
+      bool aNaN = std::isnan(a), bNaN = std::isnan(b);
+      if (aNaN || bNaN)
+        return !(aNaN && bNaN && (cmp.flags & NanEqual));
+      if (cmp.absTolerance != 0.0 && std::fabs(a - b) <= cmp.absTolerance)
+        return false;
+      if (cmp.ulpTolerance != 0) {
+        // Floats of the same sign are ordered as their bit patterns.
+        using SBits = std::make_signed_t<Bits>;
+        SBits aBits, bBits;
+        std::memcpy(&aBits, &a, sizeof(T));
+        std::memcpy(&bBits, &b, sizeof(T));
+        if ((aBits ^ bBits) >= 0) {
+          Bits ulps = aBits > bBits ? Bits(aBits) - Bits(bBits)
+                                    : Bits(bBits) - Bits(aBits);
+          if (ulps <= cmp.ulpTolerance)
+            return false;
+        }
+      }
+      return true;
+    } else {
+      (void)cmp;
+      return ((a ^ b) & mask) != 0;
+    }
+  }
+
+  template <typename T, typename Bits>
+  static void report(const Compare &cmp, int64_t linear, T a, T b,
+                     Bits mask) {
+    std::string indices;
+    for (size_t d = cmp.shape.size(); d-- > 0;) {
+      indices = "[" + std::to_string(linear % cmp.shape[d]) + "]" + indices;
+      linear /= cmp.shape[d];
+    }
+    if (!indices.empty())
+      indices += ": ";
+    if constexpr (std::is_floating_point_v<T>) {
+      std::printf(sizeof(T) > 4 ? "COSIM: %s%.17g != %.17g%s\n"
+                                : "COSIM: %s%.9g != %.9g%s\n",
+                  indices.c_str(), static_cast<double>(a),
+                  static_cast<double>(b), cmp.sites);
+    } else {
+      // Integers are printed as the signed values of their bits.
+      auto toSigned = [&](T v) {
+        uint64_t bits = static_cast<uint64_t>(v & mask);
+        if (cmp.bits < 64 && (bits >> (cmp.bits - 1)) & 1)
+          bits |= ~uint64_t(0) << cmp.bits;
+        return static_cast<long long>(bits);
+      };
+      std::printf("COSIM: %s%lld != %lld%s\n", indices.c_str(), toSigned(a),
+                  toSigned(b), cmp.sites);
+    }
+  }
+
+  template <typename T, typename Bits>
+  static void compareAs(const Compare &cmp) {
+    const T *ref = reinterpret_cast<const T *>(cmp.ref);
+    const T *target = reinterpret_cast<const T *>(cmp.target);
+    Bits mask = cmp.bits >= sizeof(Bits) * 8
+                    ? ~Bits(0)
+                    : static_cast<Bits>((Bits(1) << cmp.bits) - 1);
+    constexpr bool isFloat = std::is_floating_point_v<T>;
+    bool bitwiseMatch = !isFloat || (cmp.flags & NanEqual);
+
+    // Equal memories are told apart from unequal ones as a whole first.
+    if (cmp.flags & Hash) {
+      uint64_t refDigest = digest(reinterpret_cast<const Bits *>(ref),
+                                  cmp.elements, mask);
+      uint64_t targetDigest = digest(reinterpret_cast<const Bits *>(target),
+                                     cmp.elements, mask);
+      if (cmp.flags & PrintDigests)
+        std::printf("COSIM: digests %016llx, %016llx%s\n",
+                    static_cast<unsigned long long>(refDigest),
+                    static_cast<unsigned long long>(targetDigest), cmp.sites);
+      if (bitwiseMatch && refDigest == targetDigest)
+        return;
+    } else if (bitwiseMatch &&
+               std::memcmp(ref, target, cmp.elements * sizeof(T)) == 0) {
+      return;
+    }
+
+    if (cmp.flags & EarlyExit) {
+      for (int64_t i = 0; i < cmp.elements; ++i) {
+        if (!mismatch(cmp, ref[i], target[i], mask))
+          continue;
+        report(cmp, i, ref[i], target[i], mask);
+        std::printf("COSIM: mismatch found, stopped comparing%s\n",
+                    cmp.sites);
+        return;
+      }
+      return;
+    }
+
+    // Count the mismatches of each chunk, along with the maximum absolute
+    // error of mismatching floats, which is NaN if any such error is NaN.
+    std::vector<int64_t> counts(getThreads(cmp.elements), 0);
+    std::vector<double> maxErrors(counts.size(), 0.0);
+    forEachChunk(cmp.elements, [&](int64_t begin, int64_t end,
+                                   unsigned chunk) {
+      int64_t count = 0;
+      double maxError = 0.0;
+      for (int64_t i = begin; i < end; ++i) {
+        bool isMismatch = mismatch(cmp, ref[i], target[i], mask);
+        count += isMismatch;
+        if constexpr (isFloat) {
+          double error = std::fabs(static_cast<double>(ref[i]) -
+                                   static_cast<double>(target[i]));
+          if (isMismatch && !(error <= maxError))
+            maxError = std::isnan(maxError) ? maxError : error;
+        }
+      }
+      counts[chunk] = count;
+      maxErrors[chunk] = maxError;
+    });
+    int64_t total = 0;
+    double maxError = 0.0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+      total += counts[i];
+      if (!(maxErrors[i] <= maxError) && !std::isnan(maxError))
+        maxError = maxErrors[i];
+    }
+    if (total == 0)
+      return;
+
+    int64_t reported = 0;
+    for (int64_t i = 0; i < cmp.elements; ++i) {
+      if (cmp.maxReports != 0 && reported == cmp.maxReports)
+        break;
+      if (!mismatch(cmp, ref[i], target[i], mask))
+        continue;
+      report(cmp, i, ref[i], target[i], mask);
+      ++reported;
+    }
+    if (isFloat)
+      std::printf("COSIM: %lld mismatching elements, max. abs. error %.17g%s\n",
+                  static_cast<long long>(total), maxError, cmp.sites);
+    else
+      std::printf("COSIM: %lld mismatching elements%s\n",
+                  static_cast<long long>(total), cmp.sites);
+  }
+};
+
+} // namespace hlt
+} // namespace circt
+
+/// Compares the contiguous memories 'ref' and 'target', of 'rank' dimensions
+/// of sizes 'shape', and of elements of 'kind' (see CosimRuntime::Kind) and
+/// 'bits' bits. 'flags' are the CosimRuntime::Flags of the comparison, and
+/// 'sites' names the sources of the memories in reports.
+extern "C" void hlt_cosim_compare_memref(const void *ref, const void *target,
+                                         int64_t rank, const int64_t *shape,
+                                         int32_t kind, int32_t bits,
+                                         int64_t maxReports, int32_t flags,
+                                         double absTolerance,
+                                         int64_t ulpTolerance,
+                                         const char *sites) {
+  using circt::hlt::CosimRuntime;
+  CosimRuntime::Compare cmp;
+  cmp.ref = static_cast<const uint8_t *>(ref);
+  cmp.target = static_cast<const uint8_t *>(target);
+  cmp.shape.assign(shape, shape + rank);
+  cmp.elements = 1;
+  for (int64_t size : cmp.shape)
+    cmp.elements *= size;
+  cmp.kind = static_cast<CosimRuntime::Kind>(kind);
+  cmp.bits = static_cast<unsigned>(bits);
+  cmp.maxReports = maxReports;
+  cmp.flags = flags;
+  cmp.absTolerance = absTolerance;
+  cmp.ulpTolerance = static_cast<uint64_t>(ulpTolerance);
+  cmp.sites = sites;
+  // Reports are interleaved with the output of the testbench.
+  std::fflush(stdout);
+  CosimRuntime::compare(cmp);
+  std::fflush(stdout);
+}
+
+#endif // CIRCT_TOOLS_HLT_COSIMRUNTIME_H
@@ -0,0 +1,77 @@
+#ifndef CIRCT_TOOLS_HLT_COSIMSNAPSHOT_H
+#define CIRCT_TOOLS_HLT_COSIMSNAPSHOT_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Copy-on-write snapshots of the inputs of cosimulated calls, through which
+// each target only duplicates the pages of an input that it writes (see
+// cosim-lower-call{cow-snapshots}).
+
+namespace circt {
+namespace hlt {
+
+struct CosimSnapshot {
+  int fd;
+  size_t bytes;
+
+  [[noreturn]] static void fail(const char *what) {
+    std::cerr << "Failed to " << what << " a cosim snapshot: "
+              << std::strerror(errno) << "\n";
+    std::abort();
+  }
+};
+
+} // namespace hlt
+} // namespace circt
+
+/// Returns a snapshot of the 'bytes' bytes at 'data'.
+extern "C" void *hlt_cosim_snapshot(const void *data, int64_t bytes) {
+  using circt::hlt::CosimSnapshot;
+  auto *snapshot = new CosimSnapshot{-1, static_cast<size_t>(bytes)};
+  snapshot->fd = memfd_create("hlt_cosim_snapshot", MFD_CLOEXEC);
+  if (snapshot->fd < 0 ||
+      ftruncate(snapshot->fd, static_cast<off_t>(snapshot->bytes)) != 0)
+    CosimSnapshot::fail("create");
+  void *base = mmap(nullptr, snapshot->bytes, PROT_WRITE, MAP_SHARED,
+                    snapshot->fd, 0);
+  if (base == MAP_FAILED)
+    CosimSnapshot::fail("map");
+  std::memcpy(base, data, snapshot->bytes);
+  munmap(base, snapshot->bytes);
+  return snapshot;
+}
+
+/// Returns a private, copy-on-write view of 'snapshot', which is unmapped
+/// through hlt_cosim_snapshot_unmap. Views remain valid once the snapshot is
+/// released.
+extern "C" void *hlt_cosim_snapshot_view(void *snapshot) {
+  using circt::hlt::CosimSnapshot;
+  auto *s = static_cast<CosimSnapshot *>(snapshot);
+  void *view =
+      mmap(nullptr, s->bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, s->fd, 0);
+  if (view == MAP_FAILED)
+    CosimSnapshot::fail("map a view of");
+  return view;
+}
+
+/// Releases 'snapshot', once all of its views have been created.
+extern "C" void hlt_cosim_snapshot_release(void *snapshot) {
+  auto *s = static_cast<circt::hlt::CosimSnapshot *>(snapshot);
+  close(s->fd);
+  delete s;
+}
+
+/// Unmaps the view 'view' of a snapshot of 'bytes' bytes.
+extern "C" void hlt_cosim_snapshot_unmap(void *view, int64_t bytes) {
+  munmap(view, static_cast<size_t>(bytes));
+}
+
+#endif // CIRCT_TOOLS_HLT_COSIMSNAPSHOT_H
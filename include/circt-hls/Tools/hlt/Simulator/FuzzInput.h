@@ -0,0 +1,65 @@
+#ifndef CIRCT_TOOLS_HLT_FUZZINPUT_H
+#define CIRCT_TOOLS_HLT_FUZZINPUT_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "circt-hls/Tools/hlt/Simulator/SimFork.h"
+
+// Inputs of fuzzing testbenches (see hlstool --fuzz). Rather than generating
+// the inputs of its kernel calls itself, a fuzzing testbench draws them from
+// hlt_fuzz_input, which the fuzzer feeds through the file named by
+// HLT_FUZZ_INPUT. The file holds the input words in little endian order.
+// The first draw is the fork point of the testbench (see SimFork.h), such
+// that the inputs of each forked job are read within its child.
+
+namespace circt {
+namespace hlt {
+
+/// Returns the words of the fuzzer input, which is read on first use.
+inline const std::vector<int32_t> &getFuzzInput() {
+  static const std::vector<int32_t> words = []() {
+    SimForkServer::get().forkPoint();
+    std::vector<int32_t> words;
+    const char *path = std::getenv("HLT_FUZZ_INPUT");
+    if (!path)
+      return words;
+    std::ifstream is(path, std::ios::binary);
+    if (!is) {
+      std::cerr << "Failed to open fuzzer input '" << path << "'\n";
+      std::abort();
+    }
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(is)),
+                                     std::istreambuf_iterator<char>());
+    for (size_t i = 0; i + 4 <= bytes.size(); i += 4)
+      words.push_back(static_cast<int32_t>(
+          bytes[i] | bytes[i + 1] << 8 | bytes[i + 2] << 16 |
+          static_cast<uint32_t>(bytes[i + 3]) << 24));
+    return words;
+  }();
+  return words;
+}
+
+} // namespace hlt
+} // namespace circt
+
+/// Returns the number of words of the fuzzer input.
+extern "C" int32_t hlt_fuzz_size() {
+  return circt::hlt::getFuzzInput().size();
+}
+
+/// Returns word 'i' of the fuzzer input. Indices wrap around the input, such
+/// that a testbench may draw more words than the fuzzer provides; an empty
+/// input reads as zeros.
+extern "C" int32_t hlt_fuzz_input(int32_t i) {
+  auto &words = circt::hlt::getFuzzInput();
+  if (words.empty())
+    return 0;
+  return words[static_cast<uint32_t>(i) % words.size()];
+}
+
+#endif // CIRCT_TOOLS_HLT_FUZZINPUT_H
@@ -0,0 +1,131 @@
+#ifndef CIRCT_TOOLS_HLT_HANDSHAKEDPIMEMORY_H
+#define CIRCT_TOOLS_HLT_HANDSHAKEDPIMEMORY_H
+
+#include "circt-hls/Tools/hlt/Simulator/HandshakeSimInterface.h"
+#include "circt-hls/Tools/hlt/Simulator/MemoryInterface.h"
+
+#include <cstdint>
+#include <vector>
+
+// Memories of handshake kernels which are served by the model itself (see
+// hlt-wrapgen --dpi-memories). The memory ports of the kernel are connected to
+// an adapter in the model, which accesses the memory through the DPI-C
+// functions below at the rising clock edge. The simulator then only evaluates
+// the argument and result ports of the kernel, and the harness does not
+// iterate with the model for the memory signals to converge.
+//
+// A load is answered in the cycle after its address was accepted. Memories
+// with a load latency, initiation interval, banking or cache are simulated by
+// HandshakeMemoryInterface instead.
+
+namespace circt {
+namespace hlt {
+
+/// Type-erased accesses of a memory, as performed by the DPI-C functions.
+struct DpiMemory {
+  virtual ~DpiMemory() = default;
+  virtual uint64_t dpiRead(unsigned port, uint64_t addr) = 0;
+  virtual void dpiWrite(unsigned port, uint64_t addr, uint64_t data) = 0;
+};
+
+/// The memories served through DPI-C by a model, in the order of their memory
+/// indices. The address of the list is passed to the model through its
+/// hlt_memories input, such that each simulator instance accesses its own
+/// memories.
+using DpiMemories = std::vector<DpiMemory *>;
+
+template <typename TData, typename TCheckPolicy = DefaultMemoryCheckPolicy>
+class HandshakeDpiMemory : public SimulatorInPort,
+                           public MemoryInterfaceBase<TData>,
+                           public TransactableTrait,
+                           public DpiMemory {
+  static_assert(sizeof(TData) <= sizeof(uint64_t),
+                "DPI memories are accessed through 64-bit values");
+
+public:
+  HandshakeDpiMemory(size_t size, unsigned numLoads, unsigned numStores)
+      : MemoryInterfaceBase<TData>(size) {
+    for (unsigned i = 0; i < numLoads; ++i)
+      loadStats.push_back(this->addLoadStats());
+    for (unsigned i = 0; i < numStores; ++i)
+      storeStats.push_back(this->addStoreStats());
+  }
+
+  uint64_t dpiRead(unsigned port, uint64_t addr) override {
+    auto *stats = loadStats.at(port);
+    stats->recordAccess(addr);
+    if (this->keepAlive)
+      this->keepAlive();
+    return static_cast<uint64_t>(this->template read<TCheckPolicy>(
+        static_cast<unsigned>(addr), stats->name.c_str()));
+  }
+
+  void dpiWrite(unsigned port, uint64_t addr, uint64_t data) override {
+    auto *stats = storeStats.at(port);
+    stats->recordAccess(addr);
+    if (this->keepAlive)
+      this->keepAlive();
+    this->template write<TCheckPolicy>(static_cast<unsigned>(addr),
+                                       static_cast<TData>(data),
+                                       stats->name.c_str());
+  }
+
+  void reset() override {
+    txState = Idle;
+    // The memory of a subsequent run may be placed at a different address.
+    this->clearMemory();
+  }
+
+  // The memory ports are driven by the model, so only the transaction of the
+  // memory input itself is evaluated.
+  bool eval(bool firstInStep) override {
+    State prevState = this->txState;
+    if (txState == TransactNext)
+      txState = Transacted;
+    else if (txState == Transacted)
+      txState = Idle;
+    this->txStateChanged |= this->txState != prevState;
+    return false;
+  }
+
+  void setMemory(void *memory) override {
+    MemoryInterfaceBase<TData>::setMemory(memory);
+    txState = TransactNext;
+  }
+
+  void saveState(std::ostream &os) const override {
+    writeState(os, txState);
+    this->saveMemory(os);
+  }
+  void restoreState(std::istream &is) override {
+    readState(is, txState);
+    this->restoreMemory(is);
+  }
+
+private:
+  std::vector<MemoryPortStats *> loadStats;
+  std::vector<MemoryPortStats *> storeStats;
+};
+
+} // namespace hlt
+} // namespace circt
+
+/// Reads the element at 'addr' of memory 'mem' through load port 'port'.
+/// 'memories' is the DpiMemories of the calling model.
+extern "C" uint64_t hlt_dpi_read(uint64_t memories, int32_t mem, int32_t port,
+                                 uint64_t addr) {
+  HLT_PERF_SCOPE(circt::hlt::SimPerfComponent::Memory);
+  auto &list = *reinterpret_cast<circt::hlt::DpiMemories *>(memories);
+  return list.at(mem)->dpiRead(port, addr);
+}
+
+/// Writes 'data' to the element at 'addr' of memory 'mem' through store port
+/// 'port'.
+extern "C" void hlt_dpi_write(uint64_t memories, int32_t mem, int32_t port,
+                              uint64_t addr, uint64_t data) {
+  HLT_PERF_SCOPE(circt::hlt::SimPerfComponent::Memory);
+  auto &list = *reinterpret_cast<circt::hlt::DpiMemories *>(memories);
+  list.at(mem)->dpiWrite(port, addr, data);
+}
+
+#endif // CIRCT_TOOLS_HLT_HANDSHAKEDPIMEMORY_H
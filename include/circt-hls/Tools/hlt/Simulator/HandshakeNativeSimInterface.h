@@ -0,0 +1,772 @@
+#ifndef CIRCT_TOOLS_HLT_HANDSHAKENATIVESIMINTERFACE_H
+#define CIRCT_TOOLS_HLT_HANDSHAKENATIVESIMINTERFACE_H
+
+#include "circt-hls/Tools/hlt/Simulator/MemoryInterface.h"
+#include "circt-hls/Tools/hlt/Simulator/SimInterface.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef HLT_NATIVE_CHANNEL_DEPTH
+// Number of tokens which each channel between two operations of a native
+// handshake simulator can hold. A depth of 1 models a plain handshake
+// connection, where the producer is stalled until the consumer has accepted
+// the token.
+#define HLT_NATIVE_CHANNEL_DEPTH 1
+#endif
+
+namespace circt {
+namespace hlt {
+namespace native {
+
+// The native simulator executes handshake.func operations directly, without
+// lowering them to RTL. Each operation of the function is modelled by a Node,
+// which passes tokens between the bounded Channels which model the SSA values
+// of the function. Within a cycle, nodes are evaluated until none of them is
+// able to fire, and every node fires at most once per cycle. This makes all
+// operations combinational, except for sequential buffers and memories which
+// model the latency of the kernel. The resulting cycle counts are an
+// approximation of those of the RTL simulation.
+
+/// A token is the raw bit representation of a handshake value, zero-extended
+/// to 64 bits. Tokens of control (none-typed) values are 0.
+using Token = uint64_t;
+
+/// Truncates 'v' to its lower 'width' bits.
+inline Token truncate(Token v, unsigned width) {
+  return width >= 64 ? v : v & ((Token(1) << width) - 1);
+}
+
+/// Sign-extends the lower 'width' bits of 'v'.
+inline int64_t signExtend(Token v, unsigned width) {
+  if (width == 0 || width >= 64)
+    return static_cast<int64_t>(v);
+  unsigned shift = 64 - width;
+  return static_cast<int64_t>(v << shift) >> shift;
+}
+
+// Integer division and remainder of 'width'-bit values. Division by zero is
+// undefined in the IR; it yields 0, rather than crashing the simulator.
+inline Token divSigned(Token a, Token b, unsigned width) {
+  int64_t d = signExtend(b, width);
+  return d == 0 ? 0 : truncate(signExtend(a, width) / d, width);
+}
+inline Token divUnsigned(Token a, Token b, unsigned /*width*/) {
+  return b == 0 ? 0 : a / b;
+}
+inline Token remSigned(Token a, Token b, unsigned width) {
+  int64_t d = signExtend(b, width);
+  return d == 0 ? 0 : truncate(signExtend(a, width) % d, width);
+}
+inline Token remUnsigned(Token a, Token b, unsigned /*width*/) {
+  return b == 0 ? 0 : a % b;
+}
+
+// Shifts of 'width'-bit values. Shifting by 'width' or more is undefined in the
+// IR; it shifts out all bits.
+inline Token shiftLeft(Token a, Token b, unsigned width) {
+  return b >= width ? 0 : truncate(a << b, width);
+}
+inline Token shiftRightUnsigned(Token a, Token b, unsigned width) {
+  return b >= width ? 0 : a >> b;
+}
+inline Token shiftRightSigned(Token a, Token b, unsigned width) {
+  int64_t v = signExtend(a, width);
+  return truncate(v >> (b >= width ? width - 1 : b), width);
+}
+
+/// A bounded FIFO of tokens, modelling an SSA value of the handshake function.
+/// A channel has a single producer and a single consumer.
+class Channel {
+public:
+  Channel(std::string name = {}, unsigned depth = HLT_NATIVE_CHANNEL_DEPTH)
+      : name(std::move(name)), tokens(depth) {
+    assert(depth > 0 && "Channels must be able to hold a token");
+  }
+
+  /// Returns true if the channel holds a token for its consumer.
+  bool valid() const { return count != 0; }
+
+  /// Returns true if the channel has room for a token of its producer.
+  bool ready() const { return count != tokens.size(); }
+
+  Token front() const {
+    assert(valid() && "Reading an empty channel");
+    return tokens[head];
+  }
+
+  Token pop() {
+    Token t = front();
+    head = head + 1 == tokens.size() ? 0 : head + 1;
+    --count;
+    return t;
+  }
+
+  void push(Token t) {
+    assert(ready() && "Pushing to a full channel");
+    size_t tail = head + count;
+    tokens[tail >= tokens.size() ? tail - tokens.size() : tail] = t;
+    ++count;
+  }
+
+  void reset() { head = count = 0; }
+
+  size_t size() const { return count; }
+  const std::string &getName() const { return name; }
+
+private:
+  std::string name;
+  std::vector<Token> tokens;
+  size_t head = 0;
+  size_t count = 0;
+};
+
+using Channels = std::vector<Channel *>;
+
+inline bool allValid(const Channels &channels) {
+  for (auto *c : channels)
+    if (!c->valid())
+      return false;
+  return true;
+}
+
+inline bool allReady(const Channels &channels) {
+  for (auto *c : channels)
+    if (!c->ready())
+      return false;
+  return true;
+}
+
+/// A node models a single handshake operation.
+class Node {
+public:
+  virtual ~Node() = default;
+
+  /// Evaluates the node during cycle 'now'. Returns true if the node consumed
+  /// or produced any token. By default, a node fires at most once per cycle.
+  virtual bool eval(uint64_t /*now*/) {
+    if (fired)
+      return false;
+    return fired = fire();
+  }
+
+  /// Called at the end of each cycle, once no node is able to fire anymore.
+  virtual void clock() { fired = false; }
+
+  /// Resets the node to its initial state.
+  virtual void reset() { fired = false; }
+
+  /// Returns true if the node holds tokens which only become available after
+  /// cycle 'now'.
+  virtual bool busy(uint64_t /*now*/) const { return false; }
+
+protected:
+  /// Fires the node if its firing rule is met; returns true if it did.
+  virtual bool fire() { return false; }
+
+  bool fired = false;
+};
+
+/// An operation with 'N' operands and a single result, which is computed by
+/// 'F' from the operand tokens, once all of them are available. This models
+/// handshake.br and handshake.constant, as well as all arithmetic operations.
+template <unsigned N, typename F>
+class Op : public Node {
+public:
+  Op(std::array<Channel *, N> ins, Channel *out, F f)
+      : ins(ins), out(out), f(std::move(f)) {}
+
+protected:
+  bool fire() override {
+    if (!out->ready())
+      return false;
+    for (auto *in : ins)
+      if (!in->valid())
+        return false;
+    Token v[N];
+    for (unsigned i = 0; i < N; ++i)
+      v[i] = ins[i]->pop();
+    out->push(f(v));
+    return true;
+  }
+
+private:
+  std::array<Channel *, N> ins;
+  Channel *out;
+  F f;
+};
+
+/// handshake.fork and handshake.lazy_fork. Both are modelled as lazy forks;
+/// the operand is only consumed once all results can accept it.
+class Fork : public Node {
+public:
+  Fork(Channel *in, Channels outs) : in(in), outs(std::move(outs)) {}
+
+protected:
+  bool fire() override {
+    if (!in->valid() || !allReady(outs))
+      return false;
+    Token t = in->pop();
+    for (auto *out : outs)
+      out->push(t);
+    return true;
+  }
+
+private:
+  Channel *in;
+  Channels outs;
+};
+
+/// handshake.join.
+class Join : public Node {
+public:
+  Join(Channels ins, Channel *out) : ins(std::move(ins)), out(out) {}
+
+protected:
+  bool fire() override {
+    if (!out->ready() || !allValid(ins))
+      return false;
+    for (auto *in : ins)
+      in->pop();
+    out->push(0);
+    return true;
+  }
+
+private:
+  Channels ins;
+  Channel *out;
+};
+
+/// handshake.sync. The operands are passed to their results once all of them
+/// are available and all results can accept them.
+class Sync : public Node {
+public:
+  Sync(Channels ins, Channels outs)
+      : ins(std::move(ins)), outs(std::move(outs)) {
+    assert(this->ins.size() == this->outs.size());
+  }
+
+protected:
+  bool fire() override {
+    if (!allValid(ins) || !allReady(outs))
+      return false;
+    for (size_t i = 0; i < ins.size(); ++i)
+      outs[i]->push(ins[i]->pop());
+    return true;
+  }
+
+private:
+  Channels ins;
+  Channels outs;
+};
+
+/// handshake.merge. Operands are prioritized by their index.
+class Merge : public Node {
+public:
+  Merge(Channels ins, Channel *out) : ins(std::move(ins)), out(out) {}
+
+protected:
+  bool fire() override {
+    if (!out->ready())
+      return false;
+    for (auto *in : ins) {
+      if (in->valid()) {
+        out->push(in->pop());
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  Channels ins;
+  Channel *out;
+};
+
+/// handshake.control_merge. Operands are prioritized by their index, and the
+/// index of the selected operand is passed to the 'index' result.
+class ControlMerge : public Node {
+public:
+  ControlMerge(Channels ins, Channel *out, Channel *index)
+      : ins(std::move(ins)), out(out), index(index) {}
+
+protected:
+  bool fire() override {
+    if (!out->ready() || !index->ready())
+      return false;
+    for (size_t i = 0; i < ins.size(); ++i) {
+      if (ins[i]->valid()) {
+        out->push(ins[i]->pop());
+        index->push(i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  Channels ins;
+  Channel *out;
+  Channel *index;
+};
+
+/// handshake.mux.
+class Mux : public Node {
+public:
+  Mux(Channel *select, Channels ins, Channel *out)
+      : select(select), ins(std::move(ins)), out(out) {}
+
+protected:
+  bool fire() override {
+    if (!select->valid() || !out->ready())
+      return false;
+    Token idx = select->front();
+    if (idx >= ins.size()) {
+      std::cerr << "Mux select value " << idx << " of channel '"
+                << select->getName() << "' is out of range of its "
+                << ins.size() << " operands.\n";
+      std::abort();
+    }
+    if (!ins[idx]->valid())
+      return false;
+    select->pop();
+    out->push(ins[idx]->pop());
+    return true;
+  }
+
+private:
+  Channel *select;
+  Channels ins;
+  Channel *out;
+};
+
+/// handshake.cond_br.
+class ConditionalBranch : public Node {
+public:
+  ConditionalBranch(Channel *cond, Channel *in, Channel *trueOut,
+                    Channel *falseOut)
+      : cond(cond), in(in), trueOut(trueOut), falseOut(falseOut) {}
+
+protected:
+  bool fire() override {
+    if (!cond->valid() || !in->valid())
+      return false;
+    Channel *out = cond->front() ? trueOut : falseOut;
+    if (!out->ready())
+      return false;
+    cond->pop();
+    out->push(in->pop());
+    return true;
+  }
+
+private:
+  Channel *cond;
+  Channel *in;
+  Channel *trueOut;
+  Channel *falseOut;
+};
+
+/// handshake.sink.
+class Sink : public Node {
+public:
+  Sink(Channel *in) : in(in) {}
+
+protected:
+  bool fire() override {
+    if (!in->valid())
+      return false;
+    in->pop();
+    return true;
+  }
+
+private:
+  Channel *in;
+};
+
+/// handshake.source.
+class Source : public Node {
+public:
+  Source(Channel *out) : out(out) {}
+
+protected:
+  bool fire() override {
+    if (!out->ready())
+      return false;
+    out->push(0);
+    return true;
+  }
+
+private:
+  Channel *out;
+};
+
+/// handshake.buffer. A sequential buffer holds each token for 'slots' cycles,
+/// as the chain of registers which it lowers to does. A FIFO buffer passes
+/// tokens through within the cycle which they arrive in. Either holds up to
+/// 'slots' tokens, and is initialized with 'init'.
+class Buffer : public Node {
+public:
+  Buffer(Channel *in, Channel *out, unsigned slots, bool sequential,
+         std::vector<Token> init = {})
+      : in(in), out(out), slots(slots), sequential(sequential),
+        init(std::move(init)) {
+    reset();
+  }
+
+  bool eval(uint64_t now) override {
+    bool progress = false;
+    if (!emitted && !tokens.empty() && tokens.front().first <= now &&
+        out->ready()) {
+      out->push(tokens.front().second);
+      tokens.pop_front();
+      emitted = progress = true;
+    }
+    if (!accepted && in->valid() && tokens.size() < slots) {
+      tokens.emplace_back(sequential ? now + slots : now, in->pop());
+      accepted = progress = true;
+    }
+    return progress;
+  }
+
+  void clock() override { emitted = accepted = false; }
+
+  bool busy(uint64_t now) const override {
+    return !tokens.empty() && tokens.front().first > now;
+  }
+
+  void reset() override {
+    clock();
+    tokens.clear();
+    for (Token t : init)
+      tokens.emplace_back(0, t);
+  }
+
+private:
+  Channel *in;
+  Channel *out;
+  unsigned slots;
+  bool sequential;
+  std::vector<Token> init;
+
+  // The buffered tokens, along with the cycle from which they may be emitted.
+  std::deque<std::pair<uint64_t, Token>> tokens;
+  bool emitted = false;
+  bool accepted = false;
+};
+
+/// handshake.load. The address operands are passed to the memory once the
+/// control operand is available, and the data from the memory is passed to the
+/// data result independently.
+class Load : public Node {
+public:
+  Load(Channels addrIns, Channel *ctrl, Channels addrOuts, Channel *dataIn,
+       Channel *dataOut)
+      : addrIns(std::move(addrIns)), ctrl(ctrl), addrOuts(std::move(addrOuts)),
+        dataIn(dataIn), dataOut(dataOut) {}
+
+  bool eval(uint64_t /*now*/) override {
+    bool progress = false;
+    if (!addrSent && ctrl->valid() && allValid(addrIns) && allReady(addrOuts)) {
+      ctrl->pop();
+      for (size_t i = 0; i < addrIns.size(); ++i)
+        addrOuts[i]->push(addrIns[i]->pop());
+      addrSent = progress = true;
+    }
+    if (!dataSent && dataIn->valid() && dataOut->ready()) {
+      dataOut->push(dataIn->pop());
+      dataSent = progress = true;
+    }
+    return progress;
+  }
+
+  void clock() override { addrSent = dataSent = false; }
+  void reset() override { clock(); }
+
+private:
+  Channels addrIns;
+  Channel *ctrl;
+  Channels addrOuts;
+  Channel *dataIn;
+  Channel *dataOut;
+  bool addrSent = false;
+  bool dataSent = false;
+};
+
+/// handshake.store. The address and data operands are passed to the memory
+/// once all of them, and the control operand, are available.
+class Store : public Node {
+public:
+  Store(Channels addrIns, Channel *dataIn, Channel *ctrl, Channels addrOuts,
+        Channel *dataOut)
+      : addrIns(std::move(addrIns)), dataIn(dataIn), ctrl(ctrl),
+        addrOuts(std::move(addrOuts)), dataOut(dataOut) {}
+
+protected:
+  bool fire() override {
+    if (!ctrl->valid() || !dataIn->valid() || !allValid(addrIns) ||
+        !dataOut->ready() || !allReady(addrOuts))
+      return false;
+    ctrl->pop();
+    dataOut->push(dataIn->pop());
+    for (size_t i = 0; i < addrIns.size(); ++i)
+      addrOuts[i]->push(addrIns[i]->pop());
+    return true;
+  }
+
+private:
+  Channels addrIns;
+  Channel *dataIn;
+  Channel *ctrl;
+  Channels addrOuts;
+  Channel *dataOut;
+};
+
+/// handshake.extmemory and handshake.memory. Each port accepts an access per
+/// cycle, and completes it 'latency' cycles later. Load ports only accept a
+/// load every 'initiationInterval' cycles, as in HandshakeMemoryInterface.
+/// Loads read the memory, and stores write it, when the access is accepted. An external memory accesses
+/// the host memory passed to the kernel, whereas an internal memory is
+/// allocated by the simulator.
+template <typename TData>
+class Memory : public Node, public MemoryInterfaceBase<TData> {
+public:
+  Memory(std::string name, unsigned size, unsigned latency,
+         unsigned initiationInterval, Channels ldAddr, Channels ldData,
+         Channels ldDone, Channels stAddr, Channels stData, Channels stDone)
+      : MemoryInterfaceBase<TData>(size), name(std::move(name)),
+        latency(latency), initiationInterval(initiationInterval) {
+    assert(initiationInterval > 0 && "Initiation interval must be positive");
+    assert(ldAddr.size() == ldData.size() && ldAddr.size() == ldDone.size());
+    assert(stAddr.size() == stData.size() && stAddr.size() == stDone.size());
+    for (size_t i = 0; i < ldAddr.size(); ++i)
+      loads.push_back({portName("ld", i), ldAddr[i], nullptr, ldData[i],
+                       ldDone[i], this->addLoadStats()});
+    for (size_t i = 0; i < stAddr.size(); ++i)
+      stores.push_back({portName("st", i), stAddr[i], stData[i], nullptr,
+                        stDone[i], this->addStoreStats()});
+  }
+
+  /// Allocates the memory of a handshake.memory operation.
+  void allocate() {
+    storage.assign(this->memorySize.value(), TData());
+    MemoryInterfaceBase<TData>::setMemory(storage.data());
+  }
+
+  bool eval(uint64_t now) override {
+    bool progress = false;
+    for (auto &port : loads)
+      progress |= evalPort(port, now);
+    for (auto &port : stores)
+      progress |= evalPort(port, now);
+    return progress;
+  }
+
+  void clock() override {
+    for (auto *ports : {&loads, &stores})
+      for (auto &port : *ports)
+        port.accepted = port.completed = false;
+  }
+
+  bool busy(uint64_t now) const override {
+    for (auto *ports : {&loads, &stores})
+      for (auto &port : *ports)
+        if (!port.pending.empty() && port.pending.front().first > now)
+          return true;
+    // A load port waits for its initiation interval to pass.
+    for (auto &port : loads)
+      if (port.lastIssue && now - *port.lastIssue < initiationInterval)
+        return true;
+    return false;
+  }
+
+  void reset() override {
+    clock();
+    for (auto *ports : {&loads, &stores})
+      for (auto &port : *ports) {
+        port.pending.clear();
+        port.lastIssue.reset();
+      }
+    // A new run may pass a different host memory, and starts with a cleared
+    // internal memory, as a newly created simulator would.
+    if (storage.empty())
+      this->clearMemory();
+    else
+      std::fill(storage.begin(), storage.end(), TData());
+  }
+
+  const std::string &getName() const { return name; }
+
+private:
+  struct Port {
+    std::string name;
+    Channel *addr;
+    // Store data operand, or load data result.
+    Channel *dataIn;
+    Channel *dataOut;
+    Channel *done;
+    MemoryPortStats *stats;
+
+    // The accesses in flight, along with the cycle which they complete in.
+    std::deque<std::pair<uint64_t, Token>> pending;
+    // The cycle which the last access was accepted in.
+    std::optional<uint64_t> lastIssue;
+    bool accepted = false;
+    bool completed = false;
+  };
+
+  std::string portName(const char *kind, size_t idx) {
+    return name + "_" + kind + std::to_string(idx);
+  }
+
+  bool evalPort(Port &port, uint64_t now) {
+    bool progress = false;
+    if (!port.completed && !port.pending.empty() &&
+        port.pending.front().first <= now && port.done->ready() &&
+        (!port.dataOut || port.dataOut->ready())) {
+      if (port.dataOut)
+        port.dataOut->push(port.pending.front().second);
+      port.done->push(0);
+      port.pending.pop_front();
+      port.completed = progress = true;
+    }
+    // Loads are accepted at most every 'initiationInterval' cycles.
+    bool intervalPassed = port.dataIn || !port.lastIssue ||
+                          now - *port.lastIssue >= initiationInterval;
+    if (!port.accepted && port.addr->valid() &&
+        (!port.dataIn || port.dataIn->valid()) &&
+        port.pending.size() <= latency && intervalPassed) {
+      auto addr = static_cast<unsigned>(port.addr->pop());
+      Token data = 0;
+      if (port.dataIn)
+        this->write(addr, static_cast<TData>(port.dataIn->pop()),
+                    port.name.c_str());
+      else
+        data = static_cast<Token>(this->read(addr, port.name.c_str()));
+#if HLT_MEMORY_STATS
+      port.stats->recordAccess(addr);
+#endif
+      port.pending.emplace_back(now + latency, data);
+      port.lastIssue = now;
+      port.accepted = progress = true;
+    }
+    return progress;
+  }
+
+  std::string name;
+  unsigned latency;
+  unsigned initiationInterval;
+  std::vector<Port> loads;
+  std::vector<Port> stores;
+  std::vector<TData> storage;
+};
+
+/// Base class of the native simulators of handshake functions, which
+/// hlt-wrapgen emits for --type=handshake-native. The simulator owns the
+/// channels and nodes of the function; the emitted simulator creates these, and
+/// maps the in- and outputs of the function to and from its argument and
+/// result channels.
+template <typename TInput, typename TOutput>
+class HandshakeNativeSimInterface : public SimInterface<TInput, TOutput> {
+public:
+  void step() override {
+    bool progress = false, anyProgress = false;
+    do {
+      progress = false;
+      for (auto &node : nodes)
+        progress |= node->eval(cycle);
+      anyProgress |= progress;
+    } while (progress);
+    for (auto &node : nodes)
+      node->clock();
+    ++cycle;
+
+    // Without any node firing, the channels and nodes are in the same state in
+    // the next cycle, unless a node holds tokens which become available later.
+    isDeadlocked = !anyProgress && std::none_of(nodes.begin(), nodes.end(),
+                                                [this](auto &node) {
+                                                  return node->busy(cycle);
+                                                });
+
+    // Firing any operation is considered a valid keepAlive reason.
+    if (anyProgress && this->keepAlive)
+      this->keepAlive();
+  }
+
+  // An input is accepted once all values of the previous input have been
+  // consumed by the function.
+  bool inReady() override { return allReady(inputs); }
+
+  // An output is available once all results, and the output control, are.
+  bool outValid() override { return allValid(outputs); }
+
+  void setup() override {}
+  void finish() override {}
+  uint64_t time() override { return cycle; }
+  bool deadlocked() override { return isDeadlocked; }
+
+  void resetInPlace() override {
+    for (auto &channel : channels)
+      channel.reset();
+    for (auto &node : nodes)
+      node->reset();
+    isDeadlocked = false;
+  }
+
+  void dump(std::ostream &out) const override {
+    out << "Cycle " << cycle << ", channels holding tokens:\n";
+    for (auto &channel : channels)
+      if (channel.valid())
+        out << "  " << channel.getName() << ": " << channel.size()
+            << " token(s), front: " << channel.front() << "\n";
+  }
+
+protected:
+  /// Creates a channel for each name in 'names'. Must only be called once,
+  /// before any nodes are added.
+  void addChannels(std::initializer_list<const char *> names) {
+    assert(channels.empty() && "Channels have already been added");
+    for (auto *name : names)
+      channels.emplace_back(name);
+  }
+  Channel *ch(size_t idx) { return &channels.at(idx); }
+
+  template <typename TNode, typename... Args>
+  TNode *addNode(Args &&...args) {
+    auto *node = new TNode(std::forward<Args>(args)...);
+    nodes.emplace_back(node);
+    return node;
+  }
+
+  /// Adds an Op node, deducing the type of the operation function.
+  template <unsigned N, typename F>
+  Op<N, F> *addOp(std::array<Channel *, N> ins, Channel *out, F f) {
+    return addNode<Op<N, F>>(ins, out, std::move(f));
+  }
+
+  /// Registers the channels which the simulator pushes the arguments of the
+  /// function to, and pops its results from, including the control channels.
+  void addInput(Channel *c) { inputs.push_back(c); }
+  void addOutput(Channel *c) { outputs.push_back(c); }
+
+  // A deque, such that channels are never moved once created.
+  std::deque<Channel> channels;
+  std::vector<std::unique_ptr<Node>> nodes;
+  Channels inputs;
+  Channels outputs;
+  uint64_t cycle = 0;
+  bool isDeadlocked = false;
+};
+
+} // namespace native
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_HANDSHAKENATIVESIMINTERFACE_H
@@ -5,7 +5,84 @@
 #include "circt-hls/Tools/hlt/Simulator/VerilatorSimInterface.h"
 #include "llvm/ADT/STLExtras.h"
 
+#include <array>
+#include <bitset>
+#include <deque>
+#include <fstream>
+#include <functional>
 #include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef HLT_PORT_FIFO_DEPTH
+// Number of values which can be buffered for each in- and output port of a
+// handshake simulator. A depth of 1 means that a new input is only accepted
+// once all values of the previous input have been transacted.
+#define HLT_PORT_FIFO_DEPTH 1
+#endif
+
+#ifndef HLT_CHANNEL_STATS
+// Set to 1 to count the transactions and stalls of each handshake channel
+// within the model, written to channel_stats.json next to the simulator log.
+// This requires the model to be verilated with --public-flat-rw.
+#define HLT_CHANNEL_STATS 0
+#endif
+
+#if HLT_CHANNEL_STATS
+#include "circt-hls/Tools/hlt/Simulator/VerilatorChannelStats.h"
+#endif
+
+#ifndef HLT_OP_STATS
+// Set to 1 to count the cycles in which each handshake op within the model
+// fired, written to op_stats.json next to the simulator log, and printed with
+// the utilization of each op when the simulator finishes. This requires the
+// model to be verilated with --public-flat-rw.
+#define HLT_OP_STATS 0
+#endif
+
+#if HLT_OP_STATS
+#include "circt-hls/Tools/hlt/Simulator/VerilatorOpStats.h"
+#endif
+
+#ifndef HLT_TOKEN_TRACE
+// Set to 1 to record the tokens transferred over each handshake channel within
+// the model to tokens.bin, next to the simulator log. The trace can be viewed
+// with hsdbg in place of a VCD trace. This requires the model to be verilated
+// with --public-flat-rw.
+#define HLT_TOKEN_TRACE 0
+#endif
+
+#if HLT_TOKEN_TRACE
+#include "circt-hls/Tools/hlt/Simulator/VerilatorTokenTrace.h"
+#endif
+
+#ifndef HLT_DEADLOCK_INTERVAL
+// Number of cycles between each check for whether a handshake simulator has
+// deadlocked, while none of its ports are transacting. A deadlock is reported
+// as soon as it is detected, rather than after HLT_TIMEOUT steps. A value of 0
+// disables deadlock detection.
+#define HLT_DEADLOCK_INTERVAL 64
+#endif
+
+#ifndef HLT_SETTLE_CYCLES
+// Number of clock cycles that a handshake simulator runs for after the model
+// has been reset, before accepting inputs.
+#define HLT_SETTLE_CYCLES 2
+#endif
+
+#ifndef HLT_STREAM_ARG_INTERVAL
+// Number of cycles between the transfers of consecutive elements of a streamed
+// memref argument between the host and the kernel (see
+// HandshakeMemoryInterface::setStream).
+#define HLT_STREAM_ARG_INTERVAL 1
+#endif
+
+#ifndef HLT_STREAM_ARG_DEPTH
+// Number of elements of a streamed memref argument which may be buffered
+// between the host and the kernel.
+#define HLT_STREAM_ARG_DEPTH 8
+#endif
 
 namespace circt {
 namespace hlt {
@@ -22,6 +99,16 @@ struct TransactableTrait {
   // If this is set, the port was transacted in the last cycle.
   State txState = Idle;
   bool transacted() { return txState == State::Transacted; }
+
+  // Set whenever an eval() changed the transaction state of the port. A port
+  // whose state changed may drive different signals when evaluated again, even
+  // if none of its signals changed.
+  bool txStateChanged = false;
+  bool consumeTxStateChanged() {
+    bool changed = txStateChanged;
+    txStateChanged = false;
+    return changed;
+  }
 };
 
 template <typename TSimPort>
@@ -42,6 +129,16 @@ struct HandshakePort : public TSimPort, public TransactableTrait {
   bool valid() { return *this->validSig == 1; }
   bool ready() { return *this->readySig == 1; }
 
+  void dumpStalled(std::ostream &out) const override {
+    if (*validSig == 1 && *readySig == 0) {
+      this->dump(out);
+      out << "\n";
+    }
+  }
+
+  void saveState(std::ostream &os) const override { writeState(os, txState); }
+  void restoreState(std::istream &is) override { readState(is, txState); }
+
   std::unique_ptr<VerilatorSignal<CData>> readySig;
   std::unique_ptr<VerilatorSignal<CData>> validSig;
   std::string name;
@@ -49,7 +146,10 @@ struct HandshakePort : public TSimPort, public TransactableTrait {
 
 struct HandshakeInPort : public HandshakePort<SimulatorInPort> {
   using HandshakePort<SimulatorInPort>::HandshakePort;
-  void reset() override { *(this->validSig) = !1; }
+  void reset() override {
+    *(this->validSig) = !1;
+    txState = Idle;
+  }
   bool ready() {
     // An input port is ready to accept inputs when an input is not already
     // pushed onto the port (validSig == 1).
@@ -63,6 +163,7 @@ struct HandshakeInPort : public HandshakePort<SimulatorInPort> {
   // signal of his handshake bundle.
   bool eval(bool firstInStep) override {
     bool changed = false;
+    State prevState = txState;
     if (txState == Transacted)
       txState = Idle;
 
@@ -78,13 +179,17 @@ struct HandshakeInPort : public HandshakePort<SimulatorInPort> {
         txState = TransactNext;
     } else
       txState = Idle;
+    txStateChanged |= txState != prevState;
     return changed;
   }
 };
 
 struct HandshakeOutPort : public HandshakePort<SimulatorOutPort> {
   using HandshakePort<SimulatorOutPort>::HandshakePort;
-  void reset() override { *(this->readySig) = !1; }
+  void reset() override {
+    *(this->readySig) = !1;
+    txState = Idle;
+  }
   virtual void read() {
     // todo
   }
@@ -93,6 +198,7 @@ struct HandshakeOutPort : public HandshakePort<SimulatorOutPort> {
   // handshake bundle is asserted and the valid signal is not. A precondition
   // is that the valid signal was asserter before the ready signal.
   bool eval(bool firstInStep) override {
+    State prevState = txState;
     if (txState == Transacted)
       txState = Idle;
 
@@ -108,6 +214,7 @@ struct HandshakeOutPort : public HandshakePort<SimulatorOutPort> {
         txState = TransactNext;
     } else
       txState = Idle;
+    txStateChanged |= txState != prevState;
 
     // Implementing port determines whether there are any actual state changes
     // on the port signals.
@@ -117,7 +224,6 @@ struct HandshakeOutPort : public HandshakePort<SimulatorOutPort> {
 
 template <typename TData, typename THandshakeIOPort>
 struct HandshakeDataPort : public THandshakeIOPort {
-  HandshakeDataPort() {}
   HandshakeDataPort(CData *readySig, CData *validSig, TData *dataSig)
       : THandshakeIOPort(readySig, validSig), dataSig(dataSig){};
   HandshakeDataPort(const std::string &name, CData *readySig, CData *validSig,
@@ -125,7 +231,8 @@ struct HandshakeDataPort : public THandshakeIOPort {
       : THandshakeIOPort(name, readySig, validSig), dataSig(dataSig){};
   void dump(std::ostream &out) const {
     THandshakeIOPort::dump(out);
-    out << "\t" << static_cast<int>(*dataSig);
+    out << "\t";
+    dumpData(out, *dataSig);
   }
   TData *dataSig = nullptr;
 };
@@ -150,6 +257,83 @@ struct HandshakeDataOutPort : HandshakeDataPort<TData, HandshakeOutPort> {
   }
 };
 
+/// The packed handshake state of an ordered set of ports. Evaluating a
+/// handshake port which is idle and isn't handshaking is a no-op, so rather
+/// than evaluating each port of the set, the ready, valid and busy (non-idle)
+/// state of the handshake ports is gathered into bitmasks once per evaluation
+/// of the model. Only the ports of the set bits of the combined masks are then
+/// evaluated. Ports which aren't handshake ports are always evaluated.
+class HandshakePortMask {
+public:
+  /// Appends 'port' to the set.
+  void add(SimulatorPort *port) {
+    size_t idx = numPorts++;
+    if (idx % 64 == 0) {
+      for (auto *words : {&always, &ready, &valid, &busy, &active})
+        words->push_back(0);
+    }
+    const CData *readySig = nullptr, *validSig = nullptr;
+    if (auto *in = dynamic_cast<HandshakeInPort *>(port)) {
+      readySig = in->readySig->get();
+      validSig = in->validSig->get();
+    } else if (auto *out = dynamic_cast<HandshakeOutPort *>(port)) {
+      readySig = out->readySig->get();
+      validSig = out->validSig->get();
+    }
+    auto *transactable = dynamic_cast<TransactableTrait *>(port);
+    if (!validSig || !transactable) {
+      always[idx / 64] |= uint64_t(1) << (idx % 64);
+      return;
+    }
+    ports.push_back({readySig, validSig, &transactable->txState, idx / 64,
+                     static_cast<unsigned>(idx % 64)});
+  }
+
+  void clear() {
+    ports.clear();
+    for (auto *words : {&always, &ready, &valid, &busy, &active})
+      words->clear();
+    numPorts = 0;
+  }
+
+  /// Gathers the state of the ports, and calls 'f' with the index of each
+  /// port which is to be evaluated, in order.
+  template <typename TFunc>
+  void forEachActive(TFunc f) {
+    gather();
+    for (size_t w = 0, e = active.size(); w < e; ++w)
+      for (uint64_t bits = active[w]; bits != 0; bits &= bits - 1)
+        f(w * 64 + static_cast<size_t>(__builtin_ctzll(bits)));
+  }
+
+private:
+  void gather() {
+    for (auto *words : {&ready, &valid, &busy})
+      std::fill(words->begin(), words->end(), 0);
+    for (const Signals &p : ports) {
+      ready[p.word] |= uint64_t(*p.ready != 0) << p.bit;
+      valid[p.word] |= uint64_t(*p.valid != 0) << p.bit;
+      busy[p.word] |= uint64_t(*p.txState != TransactableTrait::Idle) << p.bit;
+    }
+    for (size_t w = 0, e = active.size(); w < e; ++w)
+      active[w] = (ready[w] & valid[w]) | busy[w] | always[w];
+  }
+
+  struct Signals {
+    const CData *ready;
+    const CData *valid;
+    const TransactableTrait::State *txState;
+    size_t word;
+    unsigned bit;
+  };
+  // The signals of the handshake ports.
+  std::vector<Signals> ports;
+  // A bit for each port which is always evaluated, the gathered state of each
+  // handshake port, and a bit for each port which is to be evaluated.
+  std::vector<uint64_t> always, ready, valid, busy, active;
+  size_t numPorts = 0;
+};
+
 // A HandshakeMemoryInterface represents a wrapper around a
 // handshake.extmemory operation. It is initialized with a set of load- and
 // store ports which, when transacting, will access the pointer provided to
@@ -162,38 +346,111 @@ struct HandshakeDataOutPort : HandshakeDataPort<TData, HandshakeOutPort> {
 // HandshakeMemoryInterface due to TAddr (not directly known from a value that
 // is pushed onto the simulator).
 
-template <typename TData, typename TAddr>
+/// Functions for mapping the addresses of a banked memory to banks.
+enum class BankInterleaving {
+  // Consecutive addresses are mapped to consecutive banks.
+  Cyclic,
+  // The memory is split into equally sized blocks of consecutive addresses.
+  Block
+};
+
+/// A memory interface which may share its memory model with the memory
+/// interfaces of other arguments of the kernel which are bound to the same host
+/// memory, e.g. the arguments of an in-place kernel. The arguments then access
+/// the memory as a single memory with the ports of all of them; see
+/// HandshakeMemoryInterface::shareWith().
+struct SharedMemoryTrait {
+  virtual ~SharedMemoryTrait() = default;
+
+  /// Returns the host memory which the interface is bound to, if any.
+  virtual const void *hostMemory() const = 0;
+
+  /// Serves the ports of this interface through the memory model of 'owner'.
+  /// Returns false if 'owner' can't serve them, as it is not of the type of
+  /// this interface.
+  virtual bool shareWith(SharedMemoryTrait &owner) = 0;
+};
+
+#if HLT_STREAM_CHECK
+/// A memory interface whose stores are checked against the contents which the
+/// memory is expected to hold after the call in flight; see SimExpectation.
+struct CheckedMemoryTrait {
+  virtual ~CheckedMemoryTrait() = default;
+
+  /// Sets the expected contents of the memory, as a contiguous array of its
+  /// elements, or null to check no stores.
+  void expectContents(const void *contents) { expected = contents; }
+
+  /// Describes the first store which did not match the expected contents, if
+  /// any.
+  std::string storeMismatch;
+
+protected:
+  const void *expected = nullptr;
+};
+#endif
+
+template <typename TData, typename TAddr,
+          typename TCheckPolicy = DefaultMemoryCheckPolicy>
 class HandshakeMemoryInterface : public SimulatorInPort,
                                  public MemoryInterfaceBase<TData>,
-                                 public TransactableTrait {
+                                 public TransactableTrait,
+#if HLT_STREAM_CHECK
+                                 public CheckedMemoryTrait,
+#endif
+                                 public SharedMemoryTrait {
 
   class MemoryPortBundle : public SimulatorPort {
   public:
     MemoryPortBundle(const std::vector<SimulatorPort *> &ports) : ports(ports) {
+      for (auto *p : ports) {
+        auto transactable = dynamic_cast<TransactableTrait *>(p);
+        assert(transactable);
+        transactables.push_back(transactable);
+        portMask.add(p);
+      }
       clearTransacted();
     }
     std::vector<SimulatorPort *> ports;
+    // The TransactableTrait of each port in 'ports'.
+    std::vector<TransactableTrait *> transactables;
+    // The packed handshake state of 'ports'.
+    HandshakePortMask portMask;
 
     /// Evaluates each of the ports in this bundle. This interacts with the
     /// propagate(...) function in that the transacted flag will be set to true
     /// after transaction occured.
     bool eval(bool firstInStep) override {
       bool changed = false;
-      for (auto &p : ports) {
+      portMask.forEachActive([&](size_t i) {
+        auto *p = ports[i];
         changed |= p->eval(firstInStep);
-        auto transactable = dynamic_cast<TransactableTrait *>(p);
-        assert(transactable);
-        if (transactable->transacted()) {
+        stateChanged |= transactables[i]->consumeTxStateChanged();
+        if (transactables[i]->transacted()) {
           portTransacted(p);
           p->keepAlive();
         }
-      }
+      });
       return changed;
     }
 
+    // Set whenever the state of the bundle changed during eval(), without
+    // necessarily changing any signals.
+    bool stateChanged = false;
+
     bool hasTransacted(SimulatorPort *p) const { return transacted.at(p); }
 
-    void reset() override {}
+    // Resets the transaction state of the bundle. The signals of the ports are
+    // reset by the memory interface.
+    void reset() override {
+      for (auto *transactable : transactables)
+        transactable->txState = TransactableTrait::Idle;
+      clearTransacted();
+      grantCycle.reset();
+      conflictCycle.reset();
+      stalling = false;
+      stateChanged = false;
+    }
 
     // Propagation function for this memory bundle. This is where we'll
     // implement the combinational logic for the port, pre-rising edge.
@@ -206,19 +463,85 @@ class HandshakeMemoryInterface : public SimulatorInPort,
       SimulatorPort::setKeepAliveCallback(f);
     }
 
+    // Called when all ports of the bundle have transacted.
+    virtual void allTransacted() {}
+
+    // Requests a port of the memory bank holding 'addr' for the current cycle.
+    // Returns true if the bundle may access the memory in this cycle. A bundle
+    // keeps its grant for the remainder of the cycle once granted. The ports
+    // of a shared memory contend for the banks of its owner.
+    bool requestAccess(HandshakeMemoryInterface &mem, size_t addr) {
+      if (mem.stream)
+        return mem.stream->ready(mem.toKernel());
+      HandshakeMemoryInterface &banks = mem.owner ? *mem.owner : mem;
+      if (!banks.banked() || grantCycle == mem.cycle)
+        return true;
+      unsigned bank = banks.bankOf(addr);
+      if (banks.bankUsage.at(bank) < banks.portsPerBank) {
+        banks.bankUsage[bank]++;
+        grantCycle = mem.cycle;
+        return true;
+      }
+      // Count each conflicting bundle once per cycle.
+      if (conflictCycle != mem.cycle) {
+        banks.bankConflicts[bank]++;
+        conflictCycle = mem.cycle;
+      }
+      return false;
+    }
+
+    // The cycles in which the bundle was last granted access to a bank, and
+    // last failed to be granted access to a bank.
+    std::optional<uint64_t> grantCycle;
+    std::optional<uint64_t> conflictCycle;
+
+    // Access statistics of the bundle, owned by the memory interface.
+    MemoryPortStats *stats = nullptr;
+    // Set by propagate() whenever the bundle requests an access which the
+    // memory is not ready to accept.
+    bool stalling = false;
+
+    // Records a stall if the bundle was stalling in the previous cycle. Must
+    // be called on the rising edge before propagate().
+    void recordStall() {
+      if (stalling)
+        stats->recordStall();
+    }
+
     // Ready whenever none of the ports have transacted.
     bool ready() {
       return llvm::all_of(transacted, [](auto &p) { return !p.second; });
     }
 
+    void saveState(std::ostream &os) const override {
+      for (auto *p : ports) {
+        p->saveState(os);
+        writeState(os, transacted.at(p));
+      }
+      writeState(os, grantCycle);
+      writeState(os, conflictCycle);
+      writeState(os, stalling);
+    }
+    void restoreState(std::istream &is) override {
+      for (auto *p : ports) {
+        p->restoreState(is);
+        readState(is, transacted.at(p));
+      }
+      readState(is, grantCycle);
+      readState(is, conflictCycle);
+      readState(is, stalling);
+    }
+
   private:
     // Register that 'port' transacted. Upon all ports being transacted, this
     // will clear the 'transacted' map. This is how we maintain the fork-like
     // logic of the memory interface.
     void portTransacted(SimulatorPort *port) {
       transacted.at(port) = true;
-      if (llvm::all_of(transacted, [](const auto &p) { return p.second; }))
+      if (llvm::all_of(transacted, [](const auto &p) { return p.second; })) {
+        allTransacted();
         clearTransacted();
+      }
     }
     void clearTransacted() {
       transacted.clear();
@@ -241,8 +564,33 @@ class HandshakeMemoryInterface : public SimulatorInPort,
     std::shared_ptr<HandshakeDataOutPort<TAddr>> addr;
     std::shared_ptr<HandshakeInPort> done;
     bool storeNext = false;
-    TData nextData = 0;
+    TData nextData{};
     TAddr nextAddr = 0;
+    // Set once the current store has been recorded in the port statistics.
+    bool storeRecorded = false;
+
+    void allTransacted() override { storeRecorded = false; }
+
+    void reset() override {
+      MemoryPortBundle::reset();
+      storeNext = false;
+      storeRecorded = false;
+    }
+
+    void saveState(std::ostream &os) const override {
+      MemoryPortBundle::saveState(os);
+      writeState(os, storeNext);
+      writeState(os, nextData);
+      writeState(os, nextAddr);
+      writeState(os, storeRecorded);
+    }
+    void restoreState(std::istream &is) override {
+      MemoryPortBundle::restoreState(is);
+      readState(is, storeNext);
+      readState(is, nextData);
+      readState(is, nextAddr);
+      readState(is, storeRecorded);
+    }
 
     // Store port transaction rules:
     // Whenever data and address are valid, stores data into the memory.
@@ -251,11 +599,21 @@ class HandshakeMemoryInterface : public SimulatorInPort,
     bool propagate(HandshakeMemoryInterface &mem) override {
       bool changed = false;
 
-      // Ready mode implies address and data signals are ready.
+      // Ready mode implies address and data signals are ready. For a banked
+      // memory, this additionally requires a free port on the bank that is
+      // to be written, and for an AXI master, a free write transaction.
       if (this->ready()) {
-        changed |= addr->readySig->assign(1);
-        changed |= data->readySig->assign(1);
+        bool granted =
+            !mem.arbitrated() ||
+            (*(addr->validSig) && this->requestAccess(mem, *(addr->dataSig)));
+        if (mem.hasAxi())
+          granted &= *(addr->validSig) &&
+                     mem.canStore(*(addr->dataSig), mem.cycle);
+        changed |= addr->readySig->assign(granted);
+        changed |= data->readySig->assign(granted);
       }
+      this->stalling =
+          this->ready() && *(addr->validSig) && !*(addr->readySig);
 
       // Deassert ready signals on address and data once transacted
       if (this->hasTransacted(addr.get()))
@@ -291,8 +649,17 @@ class HandshakeMemoryInterface : public SimulatorInPort,
       // If we have a valid address and data in the previous cycle, store the
       // data into the memory.
       if (firstInStep && storeNext) {
-        mem.write(nextAddr, nextData);
+        mem.store(nextAddr, nextData, data->name);
+        // The store is repeated until the ports transact; only count it once.
+        if (!storeRecorded) {
+          this->stats->recordAccess(nextAddr);
+          mem.streamAccess(nextAddr, data->name);
+          mem.storeAccess(nextAddr, mem.cycle);
+          storeRecorded = true;
+        }
         storeNext = false;
+        // Loads may observe the stored value.
+        this->stateChanged = true;
       }
       return MemoryPortBundle::eval(firstInStep);
     }
@@ -302,40 +669,106 @@ class HandshakeMemoryInterface : public SimulatorInPort,
 
     LoadPort(const std::shared_ptr<HandshakeDataInPort<TData>> &data,
              const std::shared_ptr<HandshakeDataOutPort<TAddr>> &addr,
-             const std::shared_ptr<HandshakeInPort> &done)
-        : MemoryPortBundle({data.get(), addr.get(), done.get()}), data(data),
-          addr(addr), done(done){};
+             const std::shared_ptr<HandshakeInPort> &done, unsigned latency,
+             unsigned initiationInterval)
+        : MemoryPortBundle(forkedPorts(data.get(), addr.get(), done.get(),
+                                       latency)),
+          data(data), addr(addr), done(done), latency(latency),
+          initiationInterval(initiationInterval) {
+      assert(initiationInterval > 0 && "Initiation interval must be positive");
+    }
     std::shared_ptr<HandshakeDataInPort<TData>> data;
     std::shared_ptr<HandshakeDataOutPort<TAddr>> addr;
     std::shared_ptr<HandshakeInPort> done;
 
+    // Returns the ports which must all transact before the bundle may accept
+    // another load. For a pipelined memory, the address port transacts
+    // independently of the data and done ports.
+    static std::vector<SimulatorPort *> forkedPorts(SimulatorPort *data,
+                                                    SimulatorPort *addr,
+                                                    SimulatorPort *done,
+                                                    unsigned latency) {
+      if (latency == 0)
+        return {data, addr, done};
+      return {data, done};
+    }
+
+    // A load which has been issued to the memory, the data which it read, and
+    // the cycle at which the data becomes available. The memory is read as
+    // the load is issued, such that stores which complete while the load is
+    // in flight are not forwarded to it.
+    struct LoadRequest {
+      TAddr addr;
+      TData data;
+      uint64_t readyCycle;
+    };
+
+    // Number of cycles from a load address handshake until the data is
+    // available. A latency of 0 implies a combinational memory read. For a
+    // memory with a cache, this is the largest latency of any load.
+    unsigned latency;
+    // Minimum number of cycles between two load address handshakes.
+    unsigned initiationInterval;
+
+    // Loads in flight, in issue order.
+    std::deque<LoadRequest> requests;
+    // The cycle during which the last load was issued.
+    std::optional<uint64_t> lastIssueCycle;
+    // The address of the load which is handshaking in the current cycle.
+    TAddr issueAddr = 0;
+    // Set once the current combinational load has been granted access to the
+    // memory.
+    bool accessed = false;
+
+    bool pipelined() const { return latency != 0; }
+
+    // The number of loads which may be in flight at once to sustain the
+    // initiation interval of the memory.
+    size_t maxInFlight() const { return latency / initiationInterval + 1; }
+
+    bool propagate(HandshakeMemoryInterface &mem) override {
+      return pipelined() ? propagatePipelined(mem) : propagateComb(mem);
+    }
+
     // Load port transaction rules:
     // Whenever the addr.valid, raise addr.ready (transact), and raise
     // data.valid and done.valid. Keep these high until both of the ports
     // transacted. These two ports may transact at different times, so state
     // must be maintained.
-    bool propagate(HandshakeMemoryInterface &mem) override {
+    bool propagateComb(HandshakeMemoryInterface &mem) {
       bool changed = false;
 
       if (this->ready()) {
         changed |= addr->readySig->assign(0);
       }
 
-      if (*(addr->validSig)) {
+      // For a banked memory, the load is only serviced once it has been
+      // granted a port on the bank that is to be read.
+      if (*(addr->validSig) && !accessed) {
+        accessed = this->requestAccess(mem, *(addr->dataSig));
+        if (accessed)
+          mem.streamAccess(*(addr->dataSig), data->name);
+      }
+
+      this->stalling = *(addr->validSig) && !accessed;
+
+      if (*(addr->validSig) && accessed) {
         // It should always be legal to read the memory when the address signal
         // is valid.
         size_t addrValue = *(addr->dataSig);
-        lastReadData = mem.read(addrValue);
+        lastReadData = mem.load(addrValue, data->name);
+        lastReadAddr = addrValue;
       }
 
       if (*(addr->validSig)) {
-        if (!this->hasTransacted(data.get())) {
+        if (accessed && !this->hasTransacted(data.get())) {
           changed |= data->validSig->assign(1);
           *(data->dataSig) = lastReadData;
+          data->validSig->markModelDirty();
         } else
           changed |= data->validSig->assign(0);
 
-        if (!this->hasTransacted(done.get()))
+        if (accessed && !this->hasTransacted(done.get()))
           changed |= done->validSig->assign(1);
         else
           changed |= done->validSig->assign(0);
@@ -349,17 +782,141 @@ class HandshakeMemoryInterface : public SimulatorInPort,
       return changed;
     }
 
+    // Pipelined load port transaction rules:
+    // The address port is decoupled from the data and done ports. An address
+    // is accepted whenever there is room for another load in flight and the
+    // initiation interval since the last load has passed, and the memory is
+    // read. Once the latency of the oldest load has passed, its data is
+    // presented and data.valid and done.valid are raised until both ports
+    // transacted.
+    bool propagatePipelined(HandshakeMemoryInterface &mem) {
+      bool changed = false;
+
+      bool canIssue =
+          requests.size() < maxInFlight() &&
+          (!lastIssueCycle ||
+           mem.cycle - lastIssueCycle.value() >= initiationInterval);
+      // For a banked memory, the load is only issued once it has been granted
+      // a port on the bank that is to be read.
+      if (canIssue && mem.arbitrated())
+        canIssue = *(addr->validSig) &&
+                   this->requestAccess(mem, *(addr->dataSig));
+      changed |= addr->readySig->assign(canIssue);
+      this->stalling = *(addr->validSig) && !canIssue;
+
+      bool respond =
+          !requests.empty() && requests.front().readyCycle <= mem.cycle;
+      if (respond && !this->hasTransacted(data.get())) {
+        changed |= data->validSig->assign(1);
+        *(data->dataSig) = requests.front().data;
+        data->validSig->markModelDirty();
+      } else
+        changed |= data->validSig->assign(0);
+
+      if (respond && !this->hasTransacted(done.get()))
+        changed |= done->validSig->assign(1);
+      else
+        changed |= done->validSig->assign(0);
+
+      return changed;
+    }
+
+    bool eval(bool firstInStep, HandshakeMemoryInterface &mem) {
+      bool changed = false;
+      if (pipelined()) {
+        // The address port is not part of the data/done fork, and is
+        // evaluated separately.
+        changed |= addr->eval(firstInStep);
+        this->stateChanged |= addr->consumeTxStateChanged();
+        if (addr->transacted()) {
+          // The address handshake occured in the previous cycle.
+          uint64_t issueCycle = mem.cycle - 1;
+          requests.push_back(
+              {issueAddr, mem.load(issueAddr, data->name),
+               issueCycle + mem.loadLatency(issueAddr, latency, issueCycle)});
+          lastIssueCycle = issueCycle;
+          mem.streamAccess(issueAddr, data->name);
+          this->stateChanged = true;
+          addr->keepAlive();
+        } else if (addr->txState == TransactableTrait::TransactNext) {
+          // Handshaking; record the address that is to be loaded.
+          issueAddr = *(addr->dataSig);
+        }
+      }
+      return MemoryPortBundle::eval(firstInStep) | changed;
+    }
+
+    void allTransacted() override {
+      accessed = false;
+      // The data of the oldest load has been delivered.
+      if (pipelined()) {
+        assert(!requests.empty() && "Delivered data without a pending load");
+        this->stats->recordAccess(requests.front().addr);
+        requests.pop_front();
+      } else
+        this->stats->recordAccess(lastReadAddr);
+    }
+
+    void setKeepAliveCallback(const KeepAliveFunction &f) override {
+      MemoryPortBundle::setKeepAliveCallback(f);
+      if (pipelined())
+        addr->setKeepAliveCallback(f);
+    }
+
+    void reset() override {
+      MemoryPortBundle::reset();
+      addr->txState = TransactableTrait::Idle;
+      requests.clear();
+      lastIssueCycle.reset();
+      accessed = false;
+    }
+
+    void saveState(std::ostream &os) const override {
+      MemoryPortBundle::saveState(os);
+      if (pipelined())
+        addr->saveState(os);
+      writeState(os, requests.size());
+      for (auto &request : requests)
+        writeState(os, request);
+      writeState(os, lastIssueCycle);
+      writeState(os, issueAddr);
+      writeState(os, accessed);
+      writeState(os, lastReadData);
+      writeState(os, lastReadAddr);
+    }
+    void restoreState(std::istream &is) override {
+      MemoryPortBundle::restoreState(is);
+      if (pipelined())
+        addr->restoreState(is);
+      size_t numRequests = 0;
+      readState(is, numRequests);
+      requests.resize(numRequests);
+      for (auto &request : requests)
+        readState(is, request);
+      readState(is, lastIssueCycle);
+      readState(is, issueAddr);
+      readState(is, accessed);
+      readState(is, lastReadData);
+      readState(is, lastReadAddr);
+    }
+
     // Store the last read data value when the address was valid. It may occur
     // that the address signal handshakes before the data signal, and then
     // changes in value, so we can only the the value that was read by a valid
     // address signal.
     TData lastReadData;
+    size_t lastReadAddr = 0;
   };
 
 public:
   // A memory interface is initialized with a static memory size. This is
   // generated during wrapper generation.
-  HandshakeMemoryInterface(size_t size) : MemoryInterfaceBase<TData>(size) {}
+  // Loads may optionally be given a latency and initiation interval, in
+  // cycles, to model pipelined memories.
+  HandshakeMemoryInterface(size_t size, unsigned latency = 0,
+                           unsigned initiationInterval = 1)
+      : MemoryInterfaceBase<TData>(size), size(size), latency(latency),
+        initiationInterval(initiationInterval) {}
 
   // Forward keepAlive callback to memory ports
   void setKeepAliveCallback(const KeepAliveFunction &f) {
@@ -370,21 +927,114 @@ public:
       port.setKeepAliveCallback(f);
   }
 
-  void dump(std::ostream &os) const {}
+  void dump(std::ostream &os) const {
+    for (size_t i = 0; i < bankConflicts.size(); ++i)
+      os << "bank " << i << " conflicts: " << bankConflicts[i] << "\n";
+  }
+
+  // A memory is busy while the oldest load of any port is in flight, or the
+  // initiation interval since the last load of a port has not yet passed.
+  bool busy() const override {
+    for (auto &port : loadPorts) {
+      if (!port.requests.empty() && port.requests.front().readyCycle > cycle)
+        return true;
+      if (port.lastIssueCycle &&
+          cycle - *port.lastIssueCycle < port.initiationInterval)
+        return true;
+    }
+    // The host is still transferring elements of a stream.
+    if (stream)
+      return stream->pending(toKernel());
+    return false;
+  }
+
+  void dumpStalled(std::ostream &os) const override {
+    for (auto &bundle : storePorts)
+      for (auto *port : bundle.ports)
+        port->dumpStalled(os);
+    for (auto &bundle : loadPorts) {
+      for (auto *port : bundle.ports)
+        port->dumpStalled(os);
+      if (bundle.pipelined())
+        bundle.addr->dumpStalled(os);
+    }
+  }
 
   virtual ~HandshakeMemoryInterface() = default;
 
+  /// Partitions the memory into 'numBanks' banks, each with 'portsPerBank'
+  /// physical ports. At most 'portsPerBank' load and store ports may access a
+  /// bank in the same cycle; conflicting accesses are serialized. The bank of
+  /// an address is given by 'bankFunction'.
+  void setBanking(unsigned numBanks, unsigned portsPerBank,
+                  const std::function<unsigned(size_t)> &bankFunction) {
+    assert(numBanks > 0 && portsPerBank > 0 && "Invalid memory banking");
+    this->numBanks = numBanks;
+    this->portsPerBank = portsPerBank;
+    this->bankFunction = bankFunction;
+    bankUsage.assign(numBanks, 0);
+    bankConflicts.assign(numBanks, 0);
+  }
+
+  void setBanking(unsigned numBanks, unsigned portsPerBank,
+                  BankInterleaving interleaving = BankInterleaving::Cyclic) {
+    std::function<unsigned(size_t)> bankFunction;
+    switch (interleaving) {
+    case BankInterleaving::Cyclic:
+      bankFunction = [numBanks](size_t addr) { return addr % numBanks; };
+      break;
+    case BankInterleaving::Block: {
+      size_t blockSize = (size + numBanks - 1) / numBanks;
+      bankFunction = [blockSize](size_t addr) { return addr / blockSize; };
+      break;
+    }
+    }
+    setBanking(numBanks, portsPerBank, bankFunction);
+  }
+
+  /// Streams the memory between the host and the kernel, rather than serving
+  /// it as a random access memory. Each invocation of the kernel must access
+  /// all elements of the memory in order, through a single load or store port,
+  /// such that the elements of consecutive invocations form a single stream.
+  /// The memory is streamed through an AXI-Stream channel (see
+  /// AxiStreamModel) of a beat every 'interval' cycles, each of 'beatBytes'
+  /// bytes (or a single element, if 0), and a buffer of 'depth' elements.
+  /// Accesses stall while the buffer is empty (for loads) or full (for
+  /// stores), such that the simulation is bound by the I/O rate of the stream.
+  void setStream(unsigned interval = HLT_STREAM_ARG_INTERVAL,
+                 size_t depth = HLT_STREAM_ARG_DEPTH, unsigned beatBytes = 0) {
+    assert(!banked() && !this->axi && "A streamed memory is not addressed");
+    stream.emplace(AxiStreamConfig{beatBytes, interval, depth}, sizeof(TData));
+  }
+  const AxiStreamModel *getStream() const override {
+    return stream ? &*stream : nullptr;
+  }
+
+  /// Returns the number of cycles in which each load or store port was denied
+  /// access to each bank, due to all ports of the bank being in use.
+  const std::vector<uint64_t> &getBankConflicts() const {
+    return bankConflicts;
+  }
+
   void
   addStorePort(const std::shared_ptr<HandshakeDataOutPort<TData>> &dataPort,
                const std::shared_ptr<HandshakeDataOutPort<TAddr>> &addrPort,
                const std::shared_ptr<HandshakeInPort> &donePort) {
     storePorts.push_back(StorePort(dataPort, addrPort, donePort));
+    storePorts.back().stats = this->addStoreStats();
   }
 
   void addLoadPort(const std::shared_ptr<HandshakeDataInPort<TData>> &dataPort,
                    const std::shared_ptr<HandshakeDataOutPort<TAddr>> &addrPort,
                    const std::shared_ptr<HandshakeInPort> &donePort) {
-    loadPorts.push_back(LoadPort(dataPort, addrPort, donePort));
+    // Loads through a cache or an AXI master have a varying latency, and are
+    // always pipelined. These must therefore be set before adding load ports.
+    unsigned portLatency = this->cache ? this->cache->maxLatency() : latency;
+    if (this->axi)
+      portLatency = this->axi->maxLatency();
+    loadPorts.push_back(LoadPort(dataPort, addrPort, donePort, portLatency,
+                                 initiationInterval));
+    loadPorts.back().stats = this->addLoadStats();
   }
 
   void reset() override {
@@ -392,12 +1042,22 @@ public:
       *(port.data->validSig) = !1;
       *(port.addr->validSig) = !1;
       *(port.done->readySig) = !1;
+      port.reset();
     }
     for (auto &port : loadPorts) {
       *(port.data->readySig) = !1;
       *(port.addr->validSig) = !1;
       *(port.done->readySig) = !1;
+      port.reset();
     }
+    txState = Idle;
+    if (clockCycles)
+      lastClockCycles = *clockCycles;
+    // The memory of a subsequent run may be placed at a different address, and
+    // may no longer alias the memories of other arguments.
+    this->clearMemory();
+    owner = nullptr;
+    aliases.clear();
   }
   bool ready() {
     assert(false && "N/A for memory interfaces.");
@@ -408,7 +1068,12 @@ public:
   /// (output)
   // signal of his handshake bundle.
   bool eval(bool firstInStep) override {
+    HLT_PERF_SCOPE(SimPerfComponent::Memory);
     bool changed = false;
+    State prevState = this->txState;
+    // The ports of a shared memory are evaluated by its owner.
+    if (firstInStep && !owner)
+      forEachShared([](HandshakeMemoryInterface &mem) { mem.advance(); });
     switch (this->txState) {
     case TransactableTrait::Idle:
       break;
@@ -420,20 +1085,44 @@ public:
       break;
     }
 
-    // Current cycle transactions:
+    this->txStateChanged |= this->txState != prevState;
+    if (owner)
+      return false;
+
+    // Current cycle transactions. The ports of the memories which share this
+    // memory are evaluated along with its own ports, as if they were ports of
+    // this memory, following those of this memory in each phase.
     // Load ports
-    for (auto &loadPort : loadPorts)
-      changed |= loadPort.propagate(*this);
+    forEachShared([&](HandshakeMemoryInterface &mem) {
+      for (auto &loadPort : mem.loadPorts)
+        changed |= loadPort.propagate(mem);
+    });
 
     // Store ports
-    for (auto &storePort : storePorts)
-      changed |= storePort.propagate(*this);
-
-    // Evaluate the ports
-    for (auto &port : storePorts)
-      changed |= port.eval(firstInStep, *this);
-    for (auto &port : loadPorts)
-      changed |= port.eval(firstInStep);
+    forEachShared([&](HandshakeMemoryInterface &mem) {
+      for (auto &storePort : mem.storePorts)
+        changed |= storePort.propagate(mem);
+    });
+
+    // Evaluate the ports. The stores of all shared memories are thereby
+    // performed before any of their loads are issued.
+    forEachShared([&](HandshakeMemoryInterface &mem) {
+      for (auto &port : mem.storePorts)
+        changed |= port.eval(firstInStep, mem);
+    });
+    forEachShared([&](HandshakeMemoryInterface &mem) {
+      for (auto &port : mem.loadPorts)
+        changed |= port.eval(firstInStep, mem);
+    });
+
+    // Report changes to the state of any of the bundles as a change to the
+    // state of the memory interface.
+    forEachShared([&](HandshakeMemoryInterface &mem) {
+      for (auto &port : mem.storePorts)
+        this->txStateChanged |= std::exchange(port.stateChanged, false);
+      for (auto &port : mem.loadPorts)
+        this->txStateChanged |= std::exchange(port.stateChanged, false);
+    });
 
     return changed;
   }
@@ -443,141 +1132,398 @@ public:
     txState = TransactNext;
   }
 
+  const void *hostMemory() const override { return this->memory_ptr; }
+
+  /// Serves the ports of this memory through the memory model of 'other',
+  /// which is bound to the same host memory. The ports of this memory are then
+  /// evaluated by 'other', after its own ports, and contend for its banks,
+  /// such that the accesses of both within a cycle are ordered as those of a
+  /// single memory. The accesses of each port are still addressed through the
+  /// view, cache and AXI master of its own memory, and are recorded in its
+  /// statistics. The memories are shared until they are reset.
+  bool shareWith(SharedMemoryTrait &other) override {
+    auto *mem = dynamic_cast<HandshakeMemoryInterface *>(&other);
+    if (!mem || mem == this)
+      return false;
+    if (mem->owner)
+      mem = mem->owner;
+    if (owner == mem)
+      return true;
+    assert(!owner && aliases.empty() && "Memory is already shared");
+    owner = mem;
+    mem->aliases.push_back(this);
+    return true;
+  }
+
+  void setClock(const uint64_t *cycles) override {
+    clockCycles = cycles;
+    lastClockCycles = cycles ? *cycles : 0;
+  }
+
+  void saveState(std::ostream &os) const override {
+    writeState(os, txState);
+    writeState(os, cycle);
+    writeState(os, lastClockCycles);
+    if (stream)
+      stream->saveState(os);
+    for (uint64_t conflicts : bankConflicts)
+      writeState(os, conflicts);
+    for (auto &port : storePorts)
+      port.saveState(os);
+    for (auto &port : loadPorts)
+      port.saveState(os);
+    this->saveMemory(os);
+  }
+  void restoreState(std::istream &is) override {
+    readState(is, txState);
+    readState(is, cycle);
+    readState(is, lastClockCycles);
+    if (stream)
+      stream->restoreState(is);
+    for (uint64_t &conflicts : bankConflicts)
+      readState(is, conflicts);
+    for (auto &port : storePorts)
+      port.restoreState(is);
+    for (auto &port : loadPorts)
+      port.restoreState(is);
+    this->restoreMemory(is);
+  }
+
 private:
+  // Memory accesses of the load and store ports, using the check policy of the
+  // memory interface.
+  TData load(unsigned addr, const std::string &port) {
+    return this->template read<TCheckPolicy>(addr, port.c_str());
+  }
+  void store(unsigned addr, const TData &data, const std::string &port) {
+    this->template write<TCheckPolicy>(addr, data, port.c_str());
+#if HLT_STREAM_CHECK
+    if (!expected || !storeMismatch.empty())
+      return;
+    const TData &value = static_cast<const TData *>(expected)[addr];
+    if (std::memcmp(&value, &data, sizeof(TData)) == 0)
+      return;
+    std::stringstream ss;
+    ss << "stored ";
+    dumpData(ss, data);
+    ss << " to address " << addr << " through port '" << port
+       << "', but expected ";
+    dumpData(ss, value);
+    storeMismatch = ss.str();
+#endif
+  }
+
   std::vector<StorePort> storePorts;
   std::vector<LoadPort> loadPorts;
-};
 
-template <typename TInput, typename TOutput, typename TModel>
-class HandshakeSimInterface
-    : public VerilatorSimInterface<TInput, TOutput, TModel> {
-public:
-  using VerilatorSimImpl = VerilatorSimInterface<TInput, TOutput, TModel>;
+  size_t size;
 
-  template <typename T>
-  struct TransactionBuffer {
-    TransactionBuffer(const T &data = T()) : data(data) {
-      for (int i = 0; i < std::tuple_size<T>(); ++i)
-        transacted[i] = false;
-    }
-    T data;
-    // Maintain a mapping between the index of each subtype in data and
-    // whether that subtype has been transacted.
-    std::map<unsigned, bool> transacted;
-    // Flag to indicate if the input control has been transacted for this
-    // buffer.
-    bool transactedControl = false;
-  };
+  // Load latency and initiation interval of the memory.
+  unsigned latency;
+  unsigned initiationInterval;
 
-  struct InputBuffer : public TransactionBuffer<TInput> {
-    InputBuffer(const TInput &data) : TransactionBuffer<TInput>(data) {}
+  // Memory banking. A memory without banks serves all ports in every cycle.
+  bool banked() const { return numBanks != 0; }
+  unsigned bankOf(size_t addr) const {
+    unsigned bank = bankFunction(addr);
+    assert(bank < numBanks && "Bank function returned an invalid bank");
+    return bank;
+  }
+  unsigned numBanks = 0;
+  unsigned portsPerBank = 0;
+  std::function<unsigned(size_t)> bankFunction;
+  // Number of ports of each bank which are in use in the current cycle.
+  std::vector<unsigned> bankUsage;
+  std::vector<uint64_t> bankConflicts;
+
+  // Whether accesses must be granted by the banks or stream of the memory. A
+  // shared memory is arbitrated by the banks of its owner.
+  bool arbitrated() const {
+    return (owner ? owner->banked() : banked()) || stream.has_value();
+  }
 
-    bool done() {
-      return this->transactedControl &&
-             std::all_of(this->transacted.begin(), this->transacted.end(),
-                         [](const auto &pair) { return pair.second; });
+  // The channel through which a streamed memory is transferred (see
+  // setStream). A memory with load ports is streamed towards the kernel.
+  std::optional<AxiStreamModel> stream;
+  bool toKernel() const { return !loadPorts.empty(); }
+
+  // Records an access of the kernel to element 'addr' of the stream.
+  void streamAccess(size_t addr, const std::string &port) {
+    if (!stream)
+      return;
+    if (addr != stream->accessed % size) {
+      std::cerr << "Streamed memory port '" << port << "' accessed element "
+                << addr << ", but expected element " << stream->accessed % size
+                << "\n";
+      std::abort();
     }
-  };
+    stream->access(toKernel());
+  }
 
-  struct OutputBuffer : public TransactionBuffer<TOutput> {
-    OutputBuffer() : TransactionBuffer<TOutput>() {}
+  // The memory which evaluates the ports of this memory, if it shares the
+  // memory model of another memory (see shareWith()), and the memories which
+  // share the memory model of this memory, in the order that they were shared.
+  HandshakeMemoryInterface *owner = nullptr;
+  std::vector<HandshakeMemoryInterface *> aliases;
+
+  // Calls 'f' with this memory and each memory which shares it.
+  template <typename TFunc>
+  void forEachShared(TFunc f) {
+    f(*this);
+    for (auto *alias : aliases)
+      f(*alias);
+  }
 
-    bool valid() {
-      return this->transactedControl &&
-             std::all_of(this->transacted.begin(), this->transacted.end(),
-                         [](const auto &pair) { return pair.second; });
+  // Advances the memory to the current cycle of the kernel.
+  void advance() {
+    // The memory advances by the cycles of its clock which passed since the
+    // last cycle of the kernel; a slower memory serves its banks to several
+    // cycles of the kernel.
+    uint64_t cycles = 1;
+    if (clockCycles)
+      cycles = *clockCycles - std::exchange(lastClockCycles, *clockCycles);
+    if (cycles != 0) {
+      cycle += cycles;
+      std::fill(bankUsage.begin(), bankUsage.end(), 0);
+      if (stream)
+        stream->transfer(toKernel(), cycle);
     }
+    for (auto &port : storePorts)
+      port.recordStall();
+    for (auto &port : loadPorts)
+      port.recordStall();
+  }
+
+  // Number of clock cycles that the memory interface has been evaluated for.
+  uint64_t cycle = 0;
+
+  // The rising edges of the clock of the memory, if not that of the kernel,
+  // as of the last cycle of the kernel; see setClock().
+  const uint64_t *clockCycles = nullptr;
+  uint64_t lastClockCycles = 0;
+};
+
+/// The concrete types of the in- and output ports of a handshake simulator,
+/// given as std::tuple's in the order that the ports are added. If provided to
+/// HandshakeSimInterface, the ports are evaluated without virtual dispatch.
+template <typename TInPorts, typename TOutPorts>
+struct HandshakeStaticPorts {
+  using InPorts = TInPorts;
+  using OutPorts = TOutPorts;
+};
+
+/// 'TModelSim' is the interface of the simulated model: VerilatorSimInterface
+/// for verilated models, or ArcSimInterface for arcilator models.
+template <typename TInput, typename TOutput, typename TModel,
+          typename TStaticPorts = void,
+          template <typename, typename, typename> class TModelSim =
+              VerilatorSimInterface>
+class HandshakeSimInterface : public TModelSim<TInput, TOutput, TModel> {
+public:
+  using VerilatorSimImpl = TModelSim<TInput, TOutput, TModel>;
+
+  /// A fixed-capacity FIFO of the values which are to be written to, or which
+  /// have been read from, a single port of the simulator.
+  template <typename T>
+  struct PortFIFO {
+    bool empty() const { return count == 0; }
+    bool full() const { return count == HLT_PORT_FIFO_DEPTH; }
+    T &front() {
+      assert(!empty() && "Accessing front of an empty port FIFO");
+      return data[head];
+    }
+    void push(const T &v) {
+      assert(!full() && "Pushing to a full port FIFO");
+      data[(head + count++) % HLT_PORT_FIFO_DEPTH] = v;
+    }
+    T pop() {
+      T v = front();
+      head = (head + 1) % HLT_PORT_FIFO_DEPTH;
+      count--;
+      return v;
+    }
+
+    std::array<T, HLT_PORT_FIFO_DEPTH> data;
+    unsigned head = 0;
+    unsigned count = 0;
+  };
+
+  template <typename T>
+  struct PortFIFOs;
+  template <typename... Tp>
+  struct PortFIFOs<std::tuple<Tp...>> {
+    using type = std::tuple<PortFIFO<Tp>...>;
   };
 
+  static constexpr size_t kNumInputs = std::tuple_size<TInput>::value;
+  static constexpr size_t kNumOutputs = std::tuple_size<TOutput>::value;
+
   HandshakeSimInterface() : VerilatorSimImpl() {}
 
-  // The handshake simulator is ready to accept inputs whenever it is not
-  // currently transacting an input buffer.
-  bool inReady() override { return !this->inBuffer.has_value(); }
+  // The handshake simulator is ready to accept inputs whenever there is room in
+  // each of the input port FIFOs.
+  bool inReady() override {
+    return inCtrlPending < HLT_PORT_FIFO_DEPTH &&
+           std::apply([](auto &...f) { return (!f.full() && ...); }, inFIFOs);
+  }
 
-  // The handshake simulator is ready to provide an output whenever it has
-  // a valid output buffer.
-  bool outValid() override { return this->outBuffer.valid(); }
+  // The handshake simulator is ready to provide an output whenever each of the
+  // output port FIFOs holds a value.
+  bool outValid() override {
+    return outCtrlAvailable != 0 &&
+           std::apply([](auto &...f) { return (!f.empty() && ...); },
+                      outFIFOs);
+  }
 
   void evaluate(bool risingEdge) {
-    // Evaluate the ports until no more changes occur.
-    bool changed = true;
+    HLT_PROFILE_SCOPE("evaluate");
+    // Evaluate the ports until a fixed point is reached, i.e. until neither the
+    // signals driven by the ports nor the transaction state of the ports
+    // change. The model is only re-evaluated once the ports changed any of its
+    // inputs; if only the state of some ports changed, just the ports are
+    // re-evaluated. On the rising edge, input signals may have been written
+    // since the model was last evaluated. The falling edge is evaluated right
+    // after the model settled in clock_falling().
+    bool signalsChanged = risingEdge;
+    bool stateChanged = true;
     int changeCount = HLT_TIMEOUT;
-    int finalEval = 2;
-    while (changed || finalEval) {
+    while (signalsChanged || stateChanged) {
       if (changeCount-- == 0) {
         std::cerr << "Evaluated handshake sim interface HLT_TIMEOUT timeout "
                      "times; this probably means that there is a combinational "
                      "loop between the simulator interface logic and the RTL "
                      "simulation.\n";
+        this->closeTrace();
         assert(false);
       }
-      changed = false;
-      this->advanceTime();
+      if (signalsChanged)
+        this->advanceTime();
+      signalsChanged = false;
+      stateChanged = false;
+
       // Transact all I/O ports
-      for (auto &port : llvm::enumerate(this->outPorts)) {
-        changed |= port.value()->eval(risingEdge);
-        auto transactable =
-            dynamic_cast<TransactableTrait *>(port.value().get());
-        assert(transactable);
-        if (transactable->transacted())
-          outBuffer.transacted[port.index()] = true;
-      }
-      for (auto &port : llvm::enumerate(this->inPorts)) {
-        changed |= port.value()->eval(risingEdge);
-        auto transactable =
-            dynamic_cast<TransactableTrait *>(port.value().get());
-        assert(transactable);
-        if (transactable->transacted())
-          inBuffer.value().transacted[port.index()] = true;
+      if constexpr (kStaticPorts) {
+        signalsChanged |=
+            evalStaticPorts(staticOutPorts, outTransacted, risingEdge,
+                            stateChanged,
+                            std::make_index_sequence<kNumOutputs>());
+        signalsChanged |=
+            evalStaticPorts(staticInPorts, inTransacted, risingEdge,
+                            stateChanged,
+                            std::make_index_sequence<kNumInputs>());
+      } else {
+        // Only the ports which may transact, or are amid a transaction, are
+        // evaluated (see HandshakePortMask).
+        outPortMask.forEachActive([&](size_t i) {
+          auto &entry = outPortTable[i];
+          signalsChanged |= entry.port->eval(risingEdge);
+          stateChanged |= entry.transactable->consumeTxStateChanged();
+          if (entry.transactable->transacted())
+            outTransacted[i] = true;
+        });
+        inPortMask.forEachActive([&](size_t i) {
+          auto &entry = inPortTable[i];
+          signalsChanged |= entry.port->eval(risingEdge);
+          stateChanged |= entry.transactable->consumeTxStateChanged();
+          if (entry.transactable->transacted())
+            inTransacted[i] = true;
+        });
       }
 
       // Transact control ports
-      changed |= inCtrl->eval(risingEdge);
+      signalsChanged |= inCtrl->eval(risingEdge);
+      stateChanged |= inCtrl->consumeTxStateChanged();
       if (inCtrl->transacted())
-        inBuffer.value().transactedControl = true;
+        inCtrlTransacted = true;
 
-      changed |= outCtrl->eval(risingEdge);
+      signalsChanged |= outCtrl->eval(risingEdge);
+      stateChanged |= outCtrl->consumeTxStateChanged();
       if (outCtrl->transacted())
-        outBuffer.transactedControl = true;
+        outCtrlTransacted = true;
+      portsChanged |= signalsChanged || stateChanged;
 
       // This can no longer be the rising edge
       risingEdge = false;
-
-      // If no change occured then we run the evaluation one final time, to let
-      // the model react to any sim changes.
-      if (!changed)
-        finalEval--;
-      else
-        finalEval = 2;
     }
   }
 
   void step() override {
+    HLT_PERF_SCOPE(perfTotals, SimPerfComponent::Harness);
+#if HLT_CHANNEL_STATS
+    // Channels transact on the rising edge, based on their current state.
+    channelStats.sample();
+#endif
+#if HLT_OP_STATS
+    opStats.sample();
+#endif
+#if HLT_TOKEN_TRACE
+    tokenTrace.sample(this->m_clockCycles);
+#endif
+
     // Rising edge
     VerilatorSimImpl::clock_rising();
 
     readToOutputBuffer();
     writeFromInputBuffer();
     evaluate(/*risingEdge=*/true);
+    commitTransactions();
 
-    // Set output ports readyness based on which outputs in the current output
-    // buffer have been transacted. This also means that we'll start off with
-    // all outputs ready, and gradually reduce the number of outputs that are
-    // ready until all ports are transacted. When the output buffer is then
-    // ready, all of these ready signals will go high again.
-    for (auto outPort : llvm::enumerate(this->outPorts)) {
-      auto outPortp = dynamic_cast<HandshakeOutPort *>(outPort.value().get());
-      assert(outPortp);
-      *(outPortp->readySig) = !outBuffer.transacted[outPort.index()];
-    }
-    *(outCtrl->readySig) = !outBuffer.transactedControl;
+    // Set output ports readyness based on which output port FIFOs have room
+    // for another value. Each output port is thereby throttled independently
+    // of the other output ports.
+    setOutputReady(std::make_index_sequence<kNumOutputs>());
+    *(outCtrl->readySig) = outCtrlAvailable < HLT_PORT_FIFO_DEPTH;
 
     // Falling edge
     VerilatorSimImpl::clock_falling();
     evaluate(/*risingEdge=*/false);
+    commitTransactions();
     this->advanceTime();
     this->m_clockCycles++;
+#if HLT_DEADLOCK_INTERVAL
+    checkDeadlock();
+#endif
+  }
+
+  bool deadlocked() override { return isDeadlocked; }
+
+#if HLT_STREAM_CHECK
+  void
+  expect(std::shared_ptr<const SimExpectation<TOutput>> expected) override {
+    nextExpectation = std::move(expected);
+  }
+
+  bool mismatched() override {
+    if (!mismatch.empty())
+      return true;
+    for (auto &[memory, arg] : checkedMemories) {
+      if (memory->storeMismatch.empty())
+        continue;
+      std::stringstream ss;
+      ss << "Memory " << arg << " of call " << checkedCalls << " "
+         << memory->storeMismatch << ", at cycle " << this->m_clockCycles;
+      mismatch = ss.str();
+      return true;
+    }
+    return false;
+  }
+
+  void dumpMismatch(std::ostream &out) const override {
+    out << mismatch << "\n";
+  }
+#endif
+
+  void dumpDeadlock(std::ostream &out) const override {
+    out << "Deadlocked at cycle " << this->m_clockCycles
+        << "; ports which are valid but not ready:\n";
+    inCtrl->dumpStalled(out);
+    outCtrl->dumpStalled(out);
+    for (auto &port : this->inPorts)
+      port->dumpStalled(out);
+    for (auto &port : this->outPorts)
+      port->dumpStalled(out);
+    out << "\n";
+    dump(out);
   }
 
   void setup() override {
@@ -588,6 +1534,18 @@ public:
     assert(outCtrl->readySig != nullptr && "Missing out control ready signal");
     assert(outCtrl->validSig != nullptr && "Missing out control valid signal");
 
+    // If HLT_CLOCKS gives a memory clock, the memory interfaces run at that
+    // clock rather than at the clock of the kernel.
+    if (uint64_t period = clockPeriodFromEnv("memory", 0)) {
+      if (!this->getClock("memory"))
+        this->addClock("memory", nullptr, period);
+      memoryClock = this->getClock("memory");
+    }
+    buildPortTables();
+#if VM_TRACE
+    resolveTraceTrigger();
+#endif
+
     // Forward keepAlive callback to ports.
     for (auto &port : this->outPorts)
       port->setKeepAliveCallback(this->keepAlive);
@@ -598,10 +1556,70 @@ public:
 
     // Do verilator initialization; this will reset the circuit
     VerilatorSimImpl::setup();
+#if HLT_CHANNEL_STATS
+    channelStats.discover(this->ctx.get());
+    if (channelStats.size() == 0)
+      std::cerr << "Warning: HLT_CHANNEL_STATS found no handshake channels. "
+                   "Was the model verilated with --public-flat-rw?\n";
+#endif
+#if HLT_OP_STATS
+    opStats.discover(this->ctx.get());
+    if (opStats.size() == 0)
+      std::cerr << "Warning: HLT_OP_STATS found no handshake ops. "
+                   "Was the model verilated with --public-flat-rw?\n";
+#endif
+#if HLT_TOKEN_TRACE
+    tokenTrace.discover(this->ctx.get());
+    if (tokenTrace.size() == 0)
+      std::cerr << "Warning: HLT_TOKEN_TRACE found no handshake channels. "
+                   "Was the model verilated with --public-flat-rw?\n";
+    std::string tracePath =
+        this->instance == 0
+            ? "tokens.bin"
+            : "tokens_" + std::to_string(this->instance) + ".bin";
+    if (!tokenTrace.open(tracePath))
+      std::cerr << "Warning: Could not create token trace '" << tracePath
+                << "'\n";
+#endif
 
     // Run a few cycles to ensure everything works after the model is out of
     // reset and a subset of all ports are ready/valid.
-    for (int i = 0; i < 2; ++i)
+    for (int i = 0; i < HLT_SETTLE_CYCLES; ++i)
+      VerilatorSimImpl::clock();
+  }
+
+  void resetInPlace() override {
+    assert(inCtrlPending == 0 && outCtrlAvailable == 0 &&
+           "Resetting the simulator with inputs in flight");
+    inCtrl->reset();
+    outCtrl->reset();
+    VerilatorSimImpl::resetInPlace();
+
+    // Drop any values left in the port FIFOs by the previous run.
+    auto clear = [](auto &...fifos) { ((fifos.head = fifos.count = 0), ...); };
+    std::apply(clear, inFIFOs);
+    std::apply(clear, outFIFOs);
+    inTransacted.reset();
+    outTransacted.reset();
+    inCtrlTransacted = outCtrlTransacted = false;
+    // The memories were unshared by their reset.
+    for (auto &memory : sharedMemories)
+      memory.bound = nullptr;
+#if HLT_STREAM_CHECK
+    nextExpectation = nullptr;
+    expectations.clear();
+    outTokens.fill(0);
+    checkedCalls = 0;
+    mismatch.clear();
+    for (auto &[memory, arg] : checkedMemories) {
+      memory->expectContents(nullptr);
+      memory->storeMismatch.clear();
+    }
+#endif
+    quietCycles = 0;
+    isDeadlocked = false;
+
+    for (int i = 0; i < HLT_SETTLE_CYCLES; ++i)
       VerilatorSimImpl::clock();
   }
 
@@ -612,118 +1630,661 @@ public:
     VerilatorSimImpl::dump(out);
   }
 
-  template <std::size_t I = 0, typename... Tp>
-  inline typename std::enable_if<I == sizeof...(Tp), void>::type
-  writeInputRec(const std::tuple<Tp...> &) {
-    // End-case, do nothing
+  void saveState(std::ostream &os) const override {
+    VerilatorSimImpl::saveState(os);
+    inCtrl->saveState(os);
+    outCtrl->saveState(os);
+    auto save = [&](const auto &...values) { (writeState(os, values), ...); };
+    std::apply(save, inFIFOs);
+    std::apply(save, outFIFOs);
+    std::apply(save, outStaging);
+    writeState(os, inCtrlPending);
+    writeState(os, outCtrlAvailable);
+  }
+
+  void restoreState(std::istream &is) override {
+    VerilatorSimImpl::restoreState(is);
+    inCtrl->restoreState(is);
+    outCtrl->restoreState(is);
+    auto restore = [&](auto &...values) { (readState(is, values), ...); };
+    std::apply(restore, inFIFOs);
+    std::apply(restore, outFIFOs);
+    std::apply(restore, outStaging);
+    readState(is, inCtrlPending);
+    readState(is, outCtrlAvailable);
+  }
+
+  void finish() override {
+    VerilatorSimImpl::finish();
+    dumpStats();
+#if HLT_OP_STATS
+    opStats.print(std::cerr, this->m_clockCycles);
+#endif
+#if HLT_PERF_COUNTERS
+    perfTotals.print(std::cerr);
+#endif
+  }
+
+  void idle() override {
+    VerilatorSimImpl::idle();
+    // The runner may never finish the simulator, so keep the statistics on
+    // disk up to date whenever the simulation goes idle.
+    if (this->m_clockCycles != statsDumpCycle)
+      dumpStats();
+  }
+
+  // Writes the enabled statistics of the simulation to disk.
+  void dumpStats() {
+    statsDumpCycle = this->m_clockCycles;
+#if HLT_MEMORY_STATS
+    dumpMemoryStats();
+#endif
+#if HLT_CHANNEL_STATS
+    channelStats.dumpJSON(this->instance == 0
+                              ? "channel_stats.json"
+                              : "channel_stats_" +
+                                    std::to_string(this->instance) + ".json",
+                          this->m_clockCycles);
+#endif
+#if HLT_OP_STATS
+    opStats.dumpJSON(this->instance == 0
+                         ? "op_stats.json"
+                         : "op_stats_" + std::to_string(this->instance) +
+                               ".json",
+                     this->m_clockCycles);
+#endif
+#if HLT_TOKEN_TRACE
+    tokenTrace.flush();
+#endif
+#if HLT_PERF_COUNTERS
+    perfTotals.dumpJSON(this->instance == 0
+                            ? "perf_counters.json"
+                            : "perf_counters_" +
+                                  std::to_string(this->instance) + ".json",
+                        this->m_clockCycles);
+#endif
+  }
+
+  // Writes the access statistics of all memory interfaces of the simulator to
+  // mem_stats.json, next to the simulator log.
+  void dumpMemoryStats() {
+    std::vector<std::pair<size_t, MemoryInterfaceStats *>> memories;
+    for (size_t i = 0; i < this->inPorts.size(); ++i)
+      if (auto *stats =
+              dynamic_cast<MemoryInterfaceStats *>(this->inPorts[i].get()))
+        memories.push_back({i, stats});
+    if (memories.empty())
+      return;
+
+    std::ofstream os(this->instance == 0 ? "mem_stats.json"
+                                         : "mem_stats_" +
+                                               std::to_string(this->instance) +
+                                               ".json");
+    os << "{\"cycles\": " << this->m_clockCycles << ", \"memories\": [";
+    for (size_t i = 0; i < memories.size(); ++i) {
+      os << (i == 0 ? "" : ", ");
+      memories[i].second->dumpStatsJSON(
+          os, "in" + std::to_string(memories[i].first));
+    }
+    os << "]}\n";
   }
 
-  template <std::size_t I = 0, typename... Tp>
-      inline
-      typename std::enable_if < I<sizeof...(Tp), void>::type
-                                writeInputRec(const std::tuple<Tp...> &tInput) {
-    auto value = std::get<I>(tInput);
-    auto &inBufferV = inBuffer.value();
+  // Writes the value at the front of each input port FIFO to its port, unless
+  // the port is still transacting its previous value.
+  template <std::size_t I = 0>
+  inline std::enable_if_t<I == kNumInputs> writeInputRec() {
+    // End-case, do nothing
+  }
 
-    // Is this a simple input port?
-    auto p = this->inPorts.at(I).get();
-    if (!inBufferV.transacted[I]) {
+  template <std::size_t I = 0>
+  inline std::enable_if_t<(I < kNumInputs)> writeInputRec() {
+    auto &fifo = std::get<I>(inFIFOs);
+    auto &entry = std::get<I>(inDataPorts);
+
+    if (!fifo.empty()) {
+      auto value = fifo.front();
+      // Memory interface, passed as a memref descriptor?
+      if constexpr (IsMemRefDescriptor<decltype(value)>::value) {
+        assert(entry.memory && "Unsupported input port type");
+        entry.memory->setMemory(value);
+      }
       // Normal port?
-      if (auto inPort = dynamic_cast<HandshakeDataInPort<decltype(value)> *>(p);
-          inPort) {
+      else if (entry.data) {
         // A value can be written to an input port when it is not already
         // trying to transact a value.
-        if (!inPort->valid()) {
-          inPort->writeData(value);
+        if (!entry.data->valid()) {
+          entry.data->writeData(value);
         }
       }
-      // Memory interface?
-      else if (auto inMemPort = dynamic_cast<MemoryInterfaceBase<
-                   std::remove_pointer_t<decltype(value)>> *>(p);
-               inMemPort) {
-        inMemPort->setMemory(reinterpret_cast<void *>(value));
-      } else {
-        assert(false && "Unsupported input port type");
+      // Memory interface? Wide values are only passed to data ports.
+      else {
+        assert(entry.memory && "Unsupported input port type");
+        if constexpr (!IsVlWide<decltype(value)>::value)
+          entry.memory->setMemory(reinterpret_cast<void *>(value));
       }
     }
 
-    writeInputRec<I + 1, Tp...>(tInput);
+    writeInputRec<I + 1>();
   }
 
   void writeFromInputBuffer() {
-    if (!inBuffer.has_value())
-      return; // Nothing to transact.
-
-    auto &inBufferV = inBuffer.value();
-
     // Try writing input data.
-    writeInputRec(inBufferV.data);
+    writeInputRec();
+    if (sharedMemories.size() > 1)
+      shareAliasedMemories();
 
     // Try writing input control.
-    if (!inBufferV.transactedControl)
+    if (inCtrlPending != 0 && !inCtrl->valid())
       inCtrl->write();
-
-    // Finish writing input buffer?
-    if (inBufferV.done())
-      inBuffer = std::nullopt;
   }
 
+  // The elements of an input are copied into the input FIFOs, so moved inputs
+  // are pushed through the copying overload.
+  using SimInterface<TInput, TOutput>::pushInput;
   void pushInput(const TInput &v) override {
-    assert(!inBuffer.has_value() &&
-           "pushing input while already having an input buffer?");
-    inBuffer = {v};
+    assert(inReady() && "pushing input while the input port FIFOs are full?");
+    pushInputImpl(v, std::make_index_sequence<kNumInputs>());
+    inCtrlPending++;
+#if HLT_STREAM_CHECK
+    expectations.push_back(std::move(nextExpectation));
+    nextExpectation = nullptr;
+    expectStores();
+#endif
   }
 
-  template <std::size_t I = 0, typename... Tp>
-  inline typename std::enable_if<I == sizeof...(Tp), void>::type
-  readOutputRec(std::tuple<Tp...> &) {
+  // Reads the value of each output port which is currently transacting.
+  template <std::size_t I = 0>
+  inline typename std::enable_if<I == kNumOutputs, void>::type
+  readOutputRec() {
     // End-case, do nothing
   }
 
-  template <std::size_t I = 0, typename... Tp>
+  template <std::size_t I = 0>
       inline typename std::enable_if <
-      I<sizeof...(Tp), void>::type readOutputRec(std::tuple<Tp...> &tOutput) {
-    using ValueType = std::remove_reference_t<decltype(std::get<I>(tOutput))>;
-    auto outPort = dynamic_cast<HandshakeDataOutPort<ValueType> *>(
-        this->outPorts.at(I).get());
-    assert(outPort);
+      I<kNumOutputs, void>::type readOutputRec() {
+    auto outPort = std::get<I>(outDataPorts);
     if (outPort->valid() && outPort->ready()) {
-      std::get<I>(tOutput) = outPort->readData();
+      std::get<I>(outStaging) = outPort->readData();
     }
-    readOutputRec<I + 1, Tp...>(tOutput);
+    readOutputRec<I + 1>();
   }
 
   void readToOutputBuffer() {
-    if (outBuffer.valid())
-      return; // Nothing to transact.
+    // Try reading output data. Values are moved to the output port FIFOs once
+    // the ports have transacted.
+    readOutputRec();
+  }
 
-    // Try reading output data.
-    readOutputRec(outBuffer.data);
+  TOutput popOutput() override {
+    assert(outValid() && "popping output buffer that is not valid?");
+    outCtrlAvailable--;
+#if HLT_STREAM_CHECK
+    // The tokens of the output ports are counted from the oldest call in
+    // flight.
+    expectations.pop_front();
+    for (auto &tokens : outTokens)
+      tokens--;
+    ++checkedCalls;
+    expectStores();
+#endif
+    return std::apply([](auto &...f) { return TOutput{f.pop()...}; },
+                      outFIFOs);
+  }
+
+private:
+  // Per-port state which is resolved once in setup(), to avoid casting the
+  // generic in- and output ports on each evaluation.
+  struct PortTableEntry {
+    SimulatorPort *port = nullptr;
+    TransactableTrait *transactable = nullptr;
+    // Only set for output ports.
+    HandshakeOutPort *handshakePort = nullptr;
+  };
+
+  // Typed port of each element of TInput. An input port is either a data port
+  // or a memory interface.
+  template <typename T>
+  struct InDataPortEntry {
+    HandshakeDataInPort<T> *data = nullptr;
+    MemoryInterfaceBase<MemoryElementT<T>> *memory = nullptr;
+  };
 
-    // OutBuffer will be cleared by popOutput if all data has been read.
+  // Tuples of pointers to the concrete port types given by TStaticPorts. Empty
+  // if no static port types were provided.
+  template <typename T>
+  struct StaticPortPtrs;
+  template <typename... Tp>
+  struct StaticPortPtrs<std::tuple<Tp...>> {
+    using type = std::tuple<Tp *...>;
+  };
+  template <typename T, typename = void>
+  struct StaticPortTuples {
+    using InPorts = std::tuple<>;
+    using OutPorts = std::tuple<>;
+  };
+  template <typename T>
+  struct StaticPortTuples<T, std::enable_if_t<!std::is_void<T>::value>> {
+    using InPorts = typename StaticPortPtrs<typename T::InPorts>::type;
+    using OutPorts = typename StaticPortPtrs<typename T::OutPorts>::type;
+  };
+  using StaticInPorts = typename StaticPortTuples<TStaticPorts>::InPorts;
+  using StaticOutPorts = typename StaticPortTuples<TStaticPorts>::OutPorts;
+  static constexpr bool kStaticPorts = !std::is_void<TStaticPorts>::value;
+  static_assert(!kStaticPorts ||
+                    (std::tuple_size<StaticInPorts>::value == kNumInputs &&
+                     std::tuple_size<StaticOutPorts>::value == kNumOutputs),
+                "Expected a static port type for each element of TInput and "
+                "TOutput");
+
+  template <typename TPort, std::size_t N>
+  static bool evalStaticPort(TPort *port, std::bitset<N> &transacted,
+                             std::size_t idx, bool risingEdge,
+                             bool &stateChanged) {
+    // Qualified call; the port type is known, so bypass virtual dispatch.
+    bool changed = port->TPort::eval(risingEdge);
+    stateChanged |= port->consumeTxStateChanged();
+    if (port->transacted())
+      transacted[idx] = true;
+    return changed;
   }
 
-  TOutput popOutput() override {
-    assert(outBuffer.valid() && "popping output buffer that is not valid?");
-    auto vOutput = outBuffer.data;
-    outBuffer = OutputBuffer(); // reset
-    return vOutput;
+  template <typename TPorts, std::size_t N, std::size_t... Is>
+  static bool evalStaticPorts(TPorts &ports, std::bitset<N> &transacted,
+                              bool risingEdge, bool &stateChanged,
+                              std::index_sequence<Is...>) {
+    bool changed = false;
+    ((changed |= evalStaticPort(std::get<Is>(ports), transacted, Is,
+                                risingEdge, stateChanged)),
+     ...);
+    return changed;
+  }
+
+  template <typename TPorts, typename TPortList, std::size_t... Is>
+  static void resolveStaticPorts(TPorts &ports, TPortList &portList,
+                                 std::index_sequence<Is...>) {
+    ((std::get<Is>(ports) =
+          dynamic_cast<std::tuple_element_t<Is, TPorts>>(portList.at(Is).get()),
+      assert(std::get<Is>(ports) && "Static port type mismatch")),
+     ...);
+  }
+
+  template <typename T>
+  struct InDataPorts;
+  template <typename... Tp>
+  struct InDataPorts<std::tuple<Tp...>> {
+    using type = std::tuple<InDataPortEntry<Tp>...>;
+  };
+  template <typename T>
+  struct OutDataPorts;
+  template <typename... Tp>
+  struct OutDataPorts<std::tuple<Tp...>> {
+    using type = std::tuple<HandshakeDataOutPort<Tp> *...>;
+  };
+
+  template <std::size_t I>
+  void resolveInDataPort() {
+    auto &inEntry = std::get<I>(inDataPorts);
+    auto *inPort = this->inPorts.at(I).get();
+    inEntry.data = dynamic_cast<decltype(inEntry.data)>(inPort);
+    inEntry.memory = dynamic_cast<decltype(inEntry.memory)>(inPort);
+    assert((inEntry.data || inEntry.memory) && "Unsupported input port type");
+    if (inEntry.memory && memoryClock)
+      inEntry.memory->setClock(&memoryClock->cycles);
   }
 
+  template <std::size_t I>
+  void resolveOutDataPort() {
+    auto &outEntry = std::get<I>(outDataPorts);
+    outEntry = dynamic_cast<std::remove_reference_t<decltype(outEntry)>>(
+        this->outPorts.at(I).get());
+    assert(outEntry && "Unsupported output port type");
+  }
+
+  template <std::size_t... Is, std::size_t... Os>
+  void resolveDataPorts(std::index_sequence<Is...>,
+                        std::index_sequence<Os...>) {
+    (resolveInDataPort<Is>(), ...);
+    (resolveOutDataPort<Os>(), ...);
+  }
+
+  void buildPortTables() {
+    assert(this->inPorts.size() == std::tuple_size<TInput>() &&
+           "Expected an input port for each element of TInput");
+    assert(this->outPorts.size() == std::tuple_size<TOutput>() &&
+           "Expected an output port for each element of TOutput");
+    inPortTable.clear();
+    inPortMask.clear();
+    sharedMemories.clear();
+#if HLT_STREAM_CHECK
+    checkedMemories.clear();
+#endif
+    for (size_t i = 0; i < this->inPorts.size(); ++i) {
+      auto &port = this->inPorts[i];
+      auto transactable = dynamic_cast<TransactableTrait *>(port.get());
+      assert(transactable);
+      inPortTable.push_back({port.get(), transactable, nullptr});
+      inPortMask.add(port.get());
+      if (auto *memory = dynamic_cast<SharedMemoryTrait *>(port.get()))
+        sharedMemories.push_back({memory, nullptr, i});
+#if HLT_STREAM_CHECK
+      // Stores are checked against the final contents of the memories, which
+      // is only valid for memories whose elements are each stored once.
+      auto *checked = dynamic_cast<CheckedMemoryTrait *>(port.get());
+      if (checked && std::getenv("HLT_STREAM_CHECK_STORES"))
+        checkedMemories.push_back({checked, i});
+#endif
+    }
+    outPortTable.clear();
+    outPortMask.clear();
+    for (auto &port : this->outPorts) {
+      auto transactable = dynamic_cast<TransactableTrait *>(port.get());
+      auto handshakePort = dynamic_cast<HandshakeOutPort *>(port.get());
+      assert(transactable && handshakePort);
+      outPortTable.push_back({port.get(), transactable, handshakePort});
+      outPortMask.add(port.get());
+    }
+    resolveDataPorts(std::make_index_sequence<kNumInputs>(),
+                     std::make_index_sequence<kNumOutputs>());
+    if constexpr (kStaticPorts) {
+      resolveStaticPorts(staticInPorts, this->inPorts,
+                         std::make_index_sequence<kNumInputs>());
+      resolveStaticPorts(staticOutPorts, this->outPorts,
+                         std::make_index_sequence<kNumOutputs>());
+    }
+  }
+
+  // Shares the memory model of the first of the memory arguments which are
+  // bound to the same host memory with each of the others, once the memories
+  // have been bound (see SharedMemoryTrait). The accesses of arguments which
+  // alias each other, e.g. of in-place kernels, are thereby ordered and
+  // arbitrated as the accesses of a single memory.
+  void shareAliasedMemories() {
+    bool rebound = false;
+    for (auto &memory : sharedMemories) {
+      const void *host = memory.memory->hostMemory();
+      rebound |= std::exchange(memory.bound, host) != host;
+    }
+    if (!rebound)
+      return;
+    for (size_t i = 0; i < sharedMemories.size(); ++i) {
+      auto &memory = sharedMemories[i];
+      if (!memory.bound)
+        continue;
+      for (size_t j = 0; j < i; ++j) {
+        auto &owner = sharedMemories[j];
+        if (owner.bound != memory.bound)
+          continue;
+        if (!memory.memory->shareWith(*owner.memory))
+          std::cerr << "Warning: the memories of inputs " << owner.arg
+                    << " and " << memory.arg
+                    << " are bound to the same host memory, but are of "
+                       "different types; their accesses are simulated as "
+                       "those of separate memories.\n";
+        break;
+      }
+    }
+  }
+
+  template <std::size_t... Is>
+  void pushInputImpl(const TInput &v, std::index_sequence<Is...>) {
+    (std::get<Is>(inFIFOs).push(std::get<Is>(v)), ...);
+  }
+
+  template <std::size_t... Is>
+  void setOutputReady(std::index_sequence<Is...>) {
+    ((*(std::get<Is>(outDataPorts)->readySig) = !std::get<Is>(outFIFOs).full()),
+     ...);
+  }
+
+  // Retires the values of all ports which transacted during the last
+  // evaluation. A port transacts at most once per evaluation.
+  template <std::size_t... Is, std::size_t... Os>
+  void commitTransactionsImpl(std::index_sequence<Is...>,
+                              std::index_sequence<Os...>) {
+    (
+        [&]() {
+          if (inTransacted[Is])
+            std::get<Is>(inFIFOs).pop();
+        }(),
+        ...);
+    (
+        [&]() {
+          if (outTransacted[Os]) {
+            std::get<Os>(outFIFOs).push(std::get<Os>(outStaging));
+#if HLT_STREAM_CHECK
+            checkOutput<Os>();
+#endif
+          }
+        }(),
+        ...);
+  }
+
+#if HLT_STREAM_CHECK
+  // Checks the token which output port I transacted against the expected
+  // output of its call. The k-th token of a port is that of the k-th call in
+  // flight.
+  template <std::size_t I>
+  void checkOutput() {
+    size_t call = outTokens[I]++;
+    if (!mismatch.empty() || call >= expectations.size() ||
+        !expectations[call])
+      return;
+    const auto &value = std::get<I>(outStaging);
+    const auto &expected = std::get<I>(expectations[call]->output);
+    if (std::memcmp(&value, &expected, sizeof(value)) == 0)
+      return;
+    std::stringstream ss;
+    ss << "Output " << I << " of call " << checkedCalls + call << " is ";
+    dumpData(ss, value);
+    ss << ", but expected ";
+    dumpData(ss, expected);
+    ss << ", at cycle " << this->m_clockCycles;
+    mismatch = ss.str();
+  }
+
+  // Sets the expected contents of the checked memories to those after the call
+  // in flight. Stores are not checked while several calls are in flight, since
+  // they are not attributed to their calls.
+  void expectStores() {
+    const SimExpectation<TOutput> *expected =
+        expectations.size() == 1 ? expectations.front().get() : nullptr;
+    for (auto &[memory, arg] : checkedMemories)
+      memory->expectContents(expected && arg < expected->memories.size()
+                                 ? expected->memories[arg]
+                                 : nullptr);
+  }
+#endif
+
+  void commitTransactions() {
+#if VM_TRACE
+    if (traceTrigger && traceTrigger())
+      this->triggerTrace();
+#endif
+    commitTransactionsImpl(std::make_index_sequence<kNumInputs>(),
+                           std::make_index_sequence<kNumOutputs>());
+    inTransacted.reset();
+    outTransacted.reset();
+    if (inCtrlTransacted) {
+      assert(inCtrlPending != 0 && "Transacted input control without input");
+      inCtrlPending--;
+    }
+    if (outCtrlTransacted)
+      outCtrlAvailable++;
+    inCtrlTransacted = outCtrlTransacted = false;
+  }
+
+  // While none of the ports change or hold work in flight, the simulation is
+  // determined by the state of the model alone. If the model is then in the
+  // same state as HLT_DEADLOCK_INTERVAL cycles before, it repeats the same
+  // states indefinitely, without any port ever transacting again.
+  void checkDeadlock() {
+    auto busy = [this]() {
+      return std::any_of(this->inPorts.begin(), this->inPorts.end(),
+                         [](auto &port) { return port->busy(); });
+    };
+    if (std::exchange(portsChanged, false) || busy()) {
+      quietCycles = 0;
+      isDeadlocked = false;
+      return;
+    }
+    if (++quietCycles % HLT_DEADLOCK_INTERVAL != 0)
+      return;
+    // The first check of a quiet period only takes a snapshot of the model.
+    bool changed = this->modelChanged();
+    isDeadlocked = !changed && quietCycles > HLT_DEADLOCK_INTERVAL;
+  }
+
+#if VM_TRACE
+  // Resolves the port named by the trace trigger, if any. Only the control
+  // ports and the top-level data ports can be used as triggers.
+  void resolveTraceTrigger() {
+    const std::string &name = this->traceConfig.trigger;
+    if (name.empty())
+      return;
+    if (inCtrl->name == name)
+      traceTrigger = [this]() { return inCtrlTransacted; };
+    else if (outCtrl->name == name)
+      traceTrigger = [this]() { return outCtrlTransacted; };
+    for (size_t i = 0; i < this->inPorts.size(); ++i)
+      if (auto *p = dynamic_cast<HandshakeInPort *>(this->inPorts[i].get());
+          p && p->name == name)
+        traceTrigger = [this, i]() { return bool(inTransacted[i]); };
+    for (size_t i = 0; i < this->outPorts.size(); ++i)
+      if (auto *p = dynamic_cast<HandshakeOutPort *>(this->outPorts[i].get());
+          p && p->name == name)
+        traceTrigger = [this, i]() { return bool(outTransacted[i]); };
+    if (!traceTrigger)
+      std::cerr << "Warning: no port named '" << name
+                << "' to trigger tracing on; nothing will be traced.\n";
+  }
+
+  // Returns true if the port which triggers tracing transacted during the
+  // last evaluation.
+  std::function<bool()> traceTrigger;
+#endif
+
+  std::vector<PortTableEntry> inPortTable;
+  std::vector<PortTableEntry> outPortTable;
+  // The packed handshake state of the ports of each table.
+  HandshakePortMask inPortMask;
+  HandshakePortMask outPortMask;
+  typename InDataPorts<TInput>::type inDataPorts;
+  typename OutDataPorts<TOutput>::type outDataPorts;
+  StaticInPorts staticInPorts;
+  StaticOutPorts staticOutPorts;
+
+  // Ports which transacted during the current evaluation, indexed by their
+  // position in TInput/TOutput.
+  std::bitset<kNumInputs> inTransacted;
+  std::bitset<kNumOutputs> outTransacted;
+  bool inCtrlTransacted = false;
+  bool outCtrlTransacted = false;
+
+  // Set whenever the ports changed any signals or transaction state during an
+  // evaluation, and the number of consecutive cycles without such changes.
+  bool portsChanged = false;
+
+  // The clock which the memory interfaces run at, if not that of the kernel.
+  VerilatorClock *memoryClock = nullptr;
+  // The memory interfaces of the inputs which may be shared, in the order of
+  // the inputs, and the host memory which each was last seen bound to.
+  struct SharedMemoryEntry {
+    SharedMemoryTrait *memory;
+    const void *bound;
+    size_t arg;
+  };
+  std::vector<SharedMemoryEntry> sharedMemories;
+
+#if HLT_STREAM_CHECK
+  // The expected outputs of the next pushed input, and of the calls in flight
+  // in the order of the calls. 'outTokens' counts the tokens which each output
+  // port transacted for the calls in flight, and 'checkedCalls' the calls
+  // whose outputs have been popped.
+  std::shared_ptr<const SimExpectation<TOutput>> nextExpectation;
+  std::deque<std::shared_ptr<const SimExpectation<TOutput>>> expectations;
+  std::array<size_t, kNumOutputs> outTokens{};
+  uint64_t checkedCalls = 0;
+  // The memory interfaces whose stores are checked, by input.
+  std::vector<std::pair<CheckedMemoryTrait *, size_t>> checkedMemories;
+  // Describes the first mismatch, if any.
+  std::string mismatch;
+#endif
+  uint64_t quietCycles = 0;
+  bool isDeadlocked = false;
+
+  // Clock cycle at which the statistics were last written.
+  uint64_t statsDumpCycle = 0;
+
+#if HLT_CHANNEL_STATS
+  // Transaction and stall counters of each channel of the model.
+  VerilatorChannelStats channelStats;
+#endif
+
+#if HLT_OP_STATS
+  // Firing counters of each op of the model.
+  VerilatorOpStats opStats;
+#endif
+
+#if HLT_TOKEN_TRACE
+  // The tokens transferred over each channel of the model.
+  VerilatorTokenTrace tokenTrace;
+#endif
+
+#if HLT_PERF_COUNTERS
+  // The host events of each component of the steps of the simulator.
+  SimPerfTotals perfTotals;
+#endif
+
+  // The last value read from each output port. This is pushed onto the output
+  // port FIFO once the port transacts.
+  TOutput outStaging;
+
 protected:
   // Handshake interface signals. Defined as raw pointers since they are owned
   // by VerilatorSimInterface.
   std::unique_ptr<HandshakeInPort> inCtrl;
   std::unique_ptr<HandshakeOutPort> outCtrl;
 
-  // In- and output buffers.
-  // @todo: this could be made into separate buffers for each subtype within
-  // TInput and TOutput, allowing for decoupling of starting the writing of a
-  // new input buffer until all values within an input have been transacted.
-  std::optional<InputBuffer> inBuffer;
-  OutputBuffer outBuffer;
+  // In- and output port FIFOs. Each port transacts the values of its FIFO
+  // independently of the other ports, i.e. a port may start transacting the
+  // next input before all other ports have transacted the current input.
+  typename PortFIFOs<TInput>::type inFIFOs;
+  typename PortFIFOs<TOutput>::type outFIFOs;
+
+  // Number of control tokens which are yet to be written to the input control
+  // port, and which have been read from the output control port.
+  unsigned inCtrlPending = 0;
+  unsigned outCtrlAvailable = 0;
 };
 
+// Explicit instantiations of the prebuilt HLTSimulator library; see
+// HLT_PREBUILT. 'KW' is 'extern' for the declarations of the instantiations,
+// and empty for their definitions.
+#define HLT_INSTANTIATE_MEMORY(KW, TData, TAddr)                               \
+  KW template class HandshakeMemoryInterface<TData, TAddr, MemoryChecked>;     \
+  KW template class HandshakeMemoryInterface<TData, TAddr, MemoryUnchecked>;
+#define HLT_INSTANTIATE_DATA(KW, TData)                                        \
+  KW template class VerilatorSignal<TData>;                                    \
+  KW template struct HandshakeDataPort<TData, HandshakeInPort>;                \
+  KW template struct HandshakeDataPort<TData, HandshakeOutPort>;               \
+  KW template struct HandshakeDataInPort<TData>;                               \
+  KW template struct HandshakeDataOutPort<TData>;                              \
+  HLT_INSTANTIATE_MEMORY(KW, TData, CData)                                     \
+  HLT_INSTANTIATE_MEMORY(KW, TData, SData)                                     \
+  HLT_INSTANTIATE_MEMORY(KW, TData, IData)                                     \
+  HLT_INSTANTIATE_MEMORY(KW, TData, QData)
+#define HLT_INSTANTIATE_HANDSHAKE(KW)                                          \
+  KW template struct HandshakePort<SimulatorInPort>;                           \
+  KW template struct HandshakePort<SimulatorOutPort>;                          \
+  HLT_INSTANTIATE_DATA(KW, CData)                                              \
+  HLT_INSTANTIATE_DATA(KW, SData)                                              \
+  HLT_INSTANTIATE_DATA(KW, IData)                                              \
+  HLT_INSTANTIATE_DATA(KW, QData)
+
+#if HLT_PREBUILT && !defined(HLT_PREBUILT_INSTANTIATE)
+HLT_INSTANTIATE_HANDSHAKE(extern)
+#endif
+
 } // namespace hlt
 } // namespace circt
 
@@ -0,0 +1,117 @@
+#ifndef CIRCT_TOOLS_HLT_HOSTAFFINITY_H
+#define CIRCT_TOOLS_HLT_HOSTAFFINITY_H
+
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Placement of the simulator on the CPUs and NUMA nodes of the host. Runner
+// threads are pinned to the CPUs given by HLT_RUNNER_CPU, a list of CPUs and
+// CPU ranges (e.g. "0-7,16"); the runner of simulator instance 'i' is pinned
+// to the i'th CPU of the list, wrapping around. A runner is pinned before it
+// creates its model, such that the model is allocated on the NUMA node of its
+// CPU. Pinning is only supported on Linux.
+
+namespace circt {
+namespace hlt {
+
+/// Parses a list of CPUs and CPU ranges, as in "0-3,8". Aborts if the list is
+/// malformed.
+inline std::vector<unsigned> parseCpuList(const std::string &str) {
+  std::vector<unsigned> cpus;
+  size_t start = 0;
+  while (start <= str.size()) {
+    size_t end = str.find(',', start);
+    if (end == std::string::npos)
+      end = str.size();
+    std::string range = str.substr(start, end - start);
+    size_t dash = range.find('-');
+    char *rest = nullptr;
+    unsigned first = std::strtoul(range.c_str(), &rest, 10);
+    unsigned last = first;
+    bool ok = !range.empty() && rest != range.c_str();
+    if (ok && dash != std::string::npos) {
+      const char *lastStr = range.c_str() + dash + 1;
+      last = std::strtoul(lastStr, &rest, 10);
+      ok = rest != lastStr && last >= first;
+    }
+    if (!ok || *rest != '\0') {
+      std::cerr << "Malformed CPU list '" << str << "'\n";
+      std::abort();
+    }
+    for (unsigned cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+    start = end + 1;
+  }
+  return cpus;
+}
+
+/// Returns the CPU which the runner of simulator instance 'instance' is
+/// pinned to, if HLT_RUNNER_CPU is set.
+inline std::optional<unsigned> getRunnerCpu(unsigned instance) {
+  static const std::vector<unsigned> cpus = []() {
+    const char *env = std::getenv("HLT_RUNNER_CPU");
+    return env && *env ? parseCpuList(env) : std::vector<unsigned>();
+  }();
+  if (cpus.empty())
+    return std::nullopt;
+  return cpus[instance % cpus.size()];
+}
+
+/// Pins the calling thread to 'cpu'. Returns false if the thread could not be
+/// pinned.
+inline bool pinThread(unsigned cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+/// Returns the NUMA node of 'cpu', if it is known.
+inline std::optional<unsigned> getCpuNode(unsigned cpu) {
+#ifdef __linux__
+  std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+  DIR *dir = opendir(path.c_str());
+  if (!dir)
+    return std::nullopt;
+  std::optional<unsigned> node;
+  while (dirent *entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name.rfind("node", 0) == 0 && name.size() > 4 &&
+        name.find_first_not_of("0123456789", 4) == std::string::npos) {
+      node = std::stoul(name.substr(4));
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+#else
+  return std::nullopt;
+#endif
+}
+
+/// Pins the calling thread to the CPU of the runner of 'instance', if any.
+/// Failing to pin is not fatal, since it only affects performance.
+inline void pinRunnerThread(unsigned instance) {
+  auto cpu = getRunnerCpu(instance);
+  if (cpu && !pinThread(*cpu))
+    std::cerr << "Failed to pin the runner of instance " << instance
+              << " to CPU " << *cpu << "\n";
+}
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_HOSTAFFINITY_H
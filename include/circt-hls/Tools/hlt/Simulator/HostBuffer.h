@@ -0,0 +1,97 @@
+#ifndef CIRCT_TOOLS_HLT_HOSTBUFFER_H
+#define CIRCT_TOOLS_HLT_HOSTBUFFER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "circt-hls/Tools/hlt/Simulator/HostAffinity.h"
+
+// Allocation of the host buffers which testbenches pass to kernels. Buffers
+// are backed by (transparent) huge pages, which cuts the TLB misses of the
+// scattered accesses of a kernel, and are placed on a single NUMA node: the
+// node given by HLT_BUFFER_NODE, or else the node of the CPU which the first
+// runner is pinned to (see HostAffinity.h). Otherwise, pages are placed on
+// the node of the thread which first touches them, which for a testbench
+// filling its buffers need not be the node of the runner accessing them.
+
+namespace circt {
+namespace hlt {
+
+/// Returns the NUMA node which host buffers are placed on, if any.
+inline std::optional<unsigned> getBufferNode() {
+  if (const char *env = std::getenv("HLT_BUFFER_NODE"))
+    return std::strtoul(env, nullptr, 10);
+  if (auto cpu = getRunnerCpu(0))
+    return getCpuNode(*cpu);
+  return std::nullopt;
+}
+
+/// Sizes of the live host buffers, which are needed to unmap them.
+struct HostBuffers {
+  std::mutex lock;
+  std::map<void *, size_t> sizes;
+};
+inline HostBuffers &getHostBuffers() {
+  static HostBuffers buffers;
+  return buffers;
+}
+
+} // namespace hlt
+} // namespace circt
+
+/// Allocates a zero-initialized host buffer of 'bytes' bytes. Returns null if
+/// the allocation failed.
+extern "C" void *hlt_alloc_buffer(int64_t bytes) {
+  constexpr size_t kHugePageBytes = 2 << 20;
+  if (bytes <= 0)
+    return nullptr;
+  size_t size = (bytes + kHugePageBytes - 1) / kHugePageBytes * kHugePageBytes;
+  void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED)
+    return nullptr;
+
+#ifdef __linux__
+  madvise(ptr, size, MADV_HUGEPAGE);
+  if (auto node = circt::hlt::getBufferNode(); node && *node < 64) {
+    // mbind(MPOL_PREFERRED); issued as a system call to avoid depending on
+    // libnuma. The placement is a hint, so failures are ignored.
+    constexpr int kMpolPreferred = 1;
+    unsigned long mask = 1UL << *node;
+    syscall(SYS_mbind, ptr, size, kMpolPreferred, &mask, 64, 0);
+  }
+#endif
+
+  auto &buffers = circt::hlt::getHostBuffers();
+  std::lock_guard<std::mutex> l(buffers.lock);
+  buffers.sizes[ptr] = size;
+  return ptr;
+}
+
+/// Frees a host buffer allocated by hlt_alloc_buffer.
+extern "C" void hlt_free_buffer(void *ptr) {
+  if (!ptr)
+    return;
+  auto &buffers = circt::hlt::getHostBuffers();
+  std::lock_guard<std::mutex> l(buffers.lock);
+  auto it = buffers.sizes.find(ptr);
+  if (it == buffers.sizes.end()) {
+    std::cerr << "Freeing a buffer which was not allocated by "
+                 "hlt_alloc_buffer\n";
+    std::abort();
+  }
+  munmap(ptr, it->second);
+  buffers.sizes.erase(it);
+}
+
+#endif // CIRCT_TOOLS_HLT_HOSTBUFFER_H
@@ -0,0 +1,144 @@
+#ifndef CIRCT_TOOLS_HLT_HOSTLINK_H
+#define CIRCT_TOOLS_HLT_HOSTLINK_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+
+#include "circt-hls/Tools/hlt/Simulator/MemoryInterface.h"
+
+namespace circt {
+namespace hlt {
+
+struct HostLinkConfig {
+  // Number of bytes transferred per cycle, in either direction.
+  double bytesPerCycle = 0;
+  // Number of cycles from the start of a transfer until its data arrives,
+  // beyond the cycles of its bytes (e.g. the setup of a DMA transfer).
+  uint64_t latency = 0;
+  // If set, transfers overlap the computation of other calls. Otherwise, the
+  // inputs of a call are only transferred once the outputs of all earlier
+  // calls have been transferred back.
+  bool overlap = true;
+
+  /// Returns the configuration given by the environment, if any:
+  ///  HLT_HOST_LINK_BANDWIDTH  Bytes per cycle. The link is only modelled if
+  ///                           this is set.
+  ///  HLT_HOST_LINK_LATENCY    Latency of each transfer, in cycles.
+  ///  HLT_HOST_LINK_OVERLAP    0 to serialize transfers and computation.
+  static std::optional<HostLinkConfig> fromEnv() {
+    const char *bandwidth = std::getenv("HLT_HOST_LINK_BANDWIDTH");
+    if (!bandwidth)
+      return std::nullopt;
+    HostLinkConfig config;
+    config.bytesPerCycle = std::strtod(bandwidth, nullptr);
+    if (!(config.bytesPerCycle > 0)) {
+      std::cerr << "Expected HLT_HOST_LINK_BANDWIDTH to be a positive number "
+                   "of bytes per cycle, got '"
+                << bandwidth << "'\n";
+      std::abort();
+    }
+    if (const char *latency = std::getenv("HLT_HOST_LINK_LATENCY"))
+      config.latency = std::strtoull(latency, nullptr, 10);
+    if (const char *overlap = std::getenv("HLT_HOST_LINK_OVERLAP"))
+      config.overlap = std::atoi(overlap) != 0;
+    return config;
+  }
+};
+
+/// A HostLink models the timing of the link (e.g. PCIe and DMA) through which
+/// the host transfers the arguments of each call to the kernel, and the
+/// results and memories of the call back, such that the cycles of a call
+/// cover its transfers as well as its computation. The link transfers one
+/// call at a time in each direction; the bytes of consecutive transfers are
+/// serialized, while their latencies overlap. Only the timing is modelled;
+/// the kernel always accesses the memories of the host in place.
+class HostLink {
+public:
+  HostLink(const HostLinkConfig &config) : config(config) {
+    assert(config.bytesPerCycle > 0 && "Invalid host link configuration");
+  }
+
+  /// Returns the number of bytes transferred to the kernel for the input
+  /// 'in': the bytes spanned by each memref argument, and the value of each
+  /// other argument. Memories passed as bare pointers are of unknown size,
+  /// and are not transferred.
+  template <typename TInput>
+  static uint64_t inputBytes(const TInput &in) {
+    return std::apply(
+        [](const auto &...v) { return (argumentBytes(v) + ... + 0); }, in);
+  }
+
+  /// Returns the number of bytes transferred back to the host for the input
+  /// 'in': the bytes spanned by each memref argument, which the kernel may
+  /// have written, and the results of TOutput.
+  template <typename TOutput, typename TInput>
+  static uint64_t outputBytes(const TInput &in) {
+    uint64_t bytes = std::apply(
+        [](const auto &...v) { return (memoryBytes(v) + ... + 0); }, in);
+    return bytes + resultBytes(static_cast<TOutput *>(nullptr));
+  }
+
+  /// Returns true if the inputs of another call may be transferred, given
+  /// whether any earlier call is still in flight.
+  bool mayTransferIn(bool callsInFlight) const {
+    return config.overlap || !callsInFlight;
+  }
+
+  /// Transfers 'bytes' to the kernel, or back to the host, starting no
+  /// earlier than 'cycle'. Returns the cycle at which the bytes have arrived.
+  uint64_t transferIn(uint64_t bytes, uint64_t cycle) {
+    return transfer(inFree, bytes, cycle);
+  }
+  uint64_t transferOut(uint64_t bytes, uint64_t cycle) {
+    return transfer(outFree, bytes, cycle);
+  }
+
+private:
+  template <typename T>
+  static uint64_t memoryBytes(const T &v) {
+    if constexpr (IsMemRefDescriptor<T>::value)
+      return viewBytes(v);
+    else
+      return 0;
+  }
+
+  template <typename T>
+  static uint64_t argumentBytes(const T &v) {
+    if constexpr (IsMemRefDescriptor<T>::value || std::is_pointer_v<T>)
+      return memoryBytes(v);
+    else
+      return sizeof(T);
+  }
+
+  template <typename... Tp>
+  static uint64_t resultBytes(std::tuple<Tp...> *) {
+    return (sizeof(Tp) + ... + 0);
+  }
+
+  // Transfers 'bytes' over the direction of the link which is free from
+  // 'free' on, starting no earlier than 'cycle'.
+  uint64_t transfer(uint64_t &free, uint64_t bytes, uint64_t cycle) {
+    uint64_t start = std::max(free, cycle);
+    free = start + static_cast<uint64_t>(
+                       std::ceil(static_cast<double>(bytes) /
+                                 config.bytesPerCycle));
+    return free + config.latency;
+  }
+
+  HostLinkConfig config;
+  // The cycles from which each direction of the link is free.
+  uint64_t inFree = 0;
+  uint64_t outFree = 0;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_HOSTLINK_H
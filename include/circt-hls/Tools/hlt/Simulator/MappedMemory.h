@@ -0,0 +1,211 @@
+#ifndef CIRCT_TOOLS_HLT_MAPPEDMEMORY_H
+#define CIRCT_TOOLS_HLT_MAPPEDMEMORY_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Memories which are backed by memory mapped files, rather than by the host
+// memories passed to the kernel. Large datasets are then paged in by the OS as
+// the kernel accesses them, instead of first being filled into host memories
+// by the testbench.
+
+namespace circt {
+namespace hlt {
+
+/// How a mapped file is accessed by the kernel.
+enum class MapMode {
+  // Stores to the memory abort the simulation, or fault if memory checks are
+  // disabled.
+  ReadOnly,
+  // Stores are visible to the simulation only; the file is left untouched.
+  CopyOnWrite,
+  // Stores are written through to the file.
+  ReadWrite
+};
+
+/// Describes the file backing a memory, as given by a string of the form
+///
+///   [<path>][:ro|:cow|:rw][:seq][:out=<result path>]
+///
+/// 'path' is the file holding the initial contents of the memory, as raw
+/// elements in host byte order. 'seq' hints to the OS that the memory is
+/// accessed sequentially. If a result path is given, the memory is backed by
+/// a copy of 'path' at the result path (zero-filled if 'path' is empty), to
+/// which the stores of the kernel are written through; the copy is performed
+/// by the OS, and does not pass through the simulator. The default mode is
+/// copy-on-write.
+struct MappedFileSpec {
+  std::string path;
+  MapMode mode = MapMode::CopyOnWrite;
+  bool sequential = false;
+  std::string resultPath;
+
+  static MappedFileSpec parse(const std::string &str) {
+    MappedFileSpec spec;
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+      size_t end = str.find(':', start);
+      fields.push_back(str.substr(start, end - start));
+      if (end == std::string::npos)
+        break;
+      start = end + 1;
+    }
+
+    for (size_t i = 0; i < fields.size(); ++i) {
+      auto &field = fields[i];
+      if (field.rfind("out=", 0) == 0)
+        spec.resultPath = field.substr(4);
+      else if (i == 0)
+        spec.path = field;
+      else if (field == "ro")
+        spec.mode = MapMode::ReadOnly;
+      else if (field == "cow")
+        spec.mode = MapMode::CopyOnWrite;
+      else if (field == "rw")
+        spec.mode = MapMode::ReadWrite;
+      else if (field == "seq")
+        spec.sequential = true;
+      else {
+        std::cerr << "Unknown option '" << field << "' of mapped file '" << str
+                  << "'\n";
+        std::abort();
+      }
+    }
+    if (spec.path.empty() && spec.resultPath.empty()) {
+      std::cerr << "Mapped file '" << str << "' names no file\n";
+      std::abort();
+    }
+    if (!spec.resultPath.empty())
+      spec.mode = MapMode::ReadWrite;
+    return spec;
+  }
+};
+
+/// A file mapped into the address space of the simulator. Errors are fatal,
+/// since the kernel cannot be simulated without its memory.
+class MappedFile {
+public:
+  /// Maps the first 'bytes' bytes of the file described by 'spec'. If 'bytes'
+  /// is 0, the whole file is mapped.
+  MappedFile(const MappedFileSpec &spec, size_t bytes) : bytes(bytes) {
+    mode = spec.mode;
+    std::string path = spec.resultPath.empty() ? spec.path : spec.resultPath;
+    int fd = spec.resultPath.empty() ? openInput(spec) : createResult(spec);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+      fail("Failed to stat", path);
+    if (this->bytes == 0)
+      this->bytes = st.st_size;
+    if (static_cast<size_t>(st.st_size) < this->bytes) {
+      std::cerr << "Mapped file '" << path << "' holds " << st.st_size
+                << " bytes, but the memory holds " << this->bytes
+                << " bytes\n";
+      std::abort();
+    }
+    if (this->bytes == 0) {
+      std::cerr << "Mapped file '" << path << "' is empty\n";
+      std::abort();
+    }
+
+    int prot = mode == MapMode::ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = mode == MapMode::CopyOnWrite ? MAP_PRIVATE : MAP_SHARED;
+    ptr = mmap(nullptr, this->bytes, prot, flags, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+      fail("Failed to map", path);
+    if (spec.sequential)
+      madvise(ptr, this->bytes, MADV_SEQUENTIAL);
+  }
+
+  ~MappedFile() {
+    if (mode == MapMode::ReadWrite)
+      msync(ptr, bytes, MS_SYNC);
+    munmap(ptr, bytes);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  void *data() const { return ptr; }
+  size_t size() const { return bytes; }
+  bool writable() const { return mode != MapMode::ReadOnly; }
+
+private:
+  [[noreturn]] static void fail(const char *what, const std::string &path) {
+    std::cerr << what << " file '" << path << "': " << std::strerror(errno)
+              << "\n";
+    std::abort();
+  }
+
+  static int openInput(const MappedFileSpec &spec) {
+    int fd = open(spec.path.c_str(),
+                  spec.mode == MapMode::ReadWrite ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+      fail("Failed to open", spec.path);
+    return fd;
+  }
+
+  // Creates the result file of 'spec', holding a copy of its input file.
+  int createResult(const MappedFileSpec &spec) {
+    int fd = open(spec.resultPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      fail("Failed to create", spec.resultPath);
+    if (!spec.path.empty()) {
+      MappedFileSpec inSpec;
+      inSpec.path = spec.path;
+      inSpec.mode = MapMode::ReadOnly;
+      int in = openInput(inSpec);
+      struct stat st;
+      if (fstat(in, &st) != 0)
+        fail("Failed to stat", spec.path);
+      size_t toCopy = st.st_size;
+      if (bytes != 0 && bytes < toCopy)
+        toCopy = bytes;
+      copyFile(in, fd, toCopy, spec.path);
+      close(in);
+    }
+    if (bytes != 0 && ftruncate(fd, bytes) != 0)
+      fail("Failed to resize", spec.resultPath);
+    return fd;
+  }
+
+  static void copyFile(int in, int out, size_t size, const std::string &path) {
+#ifdef __linux__
+    // Copied within the kernel, which may share the extents of the files.
+    while (size > 0) {
+      ssize_t copied = copy_file_range(in, nullptr, out, nullptr, size, 0);
+      if (copied <= 0)
+        break;
+      size -= copied;
+    }
+#endif
+    std::vector<char> buffer(1 << 20);
+    while (size > 0) {
+      ssize_t n = read(in, buffer.data(), std::min(size, buffer.size()));
+      if (n <= 0 || write(out, buffer.data(), n) != n)
+        fail("Failed to copy", path);
+      size -= n;
+    }
+  }
+
+  void *ptr = nullptr;
+  size_t bytes;
+  MapMode mode;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_MAPPEDMEMORY_H
@@ -1,45 +1,586 @@
 #ifndef CIRCT_TOOLS_HLT_MEMORYINTERFACE_H
 #define CIRCT_TOOLS_HLT_MEMORYINTERFACE_H
 
+#include "circt-hls/Tools/hlt/Simulator/AxiModel.h"
+#include "circt-hls/Tools/hlt/Simulator/CacheModel.h"
+#include "circt-hls/Tools/hlt/Simulator/MappedMemory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <memory>
 #include <optional>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifndef HLT_MEMORY_STATS
+// Set to 0 to disable collection of memory access statistics.
+#define HLT_MEMORY_STATS 1
+#endif
+
+#ifndef HLT_MEMORY_CHECKS
+// Set to 0 to disable bounds checking of memory accesses by default. Checks
+// are independent of NDEBUG.
+#define HLT_MEMORY_CHECKS 1
+#endif
+
+/// Memory access policies. Checked accesses verify that the memory has been
+/// set and that the address is within the bounds of the memory, and abort the
+/// simulation otherwise. Unchecked accesses are raw pointer accesses.
+struct MemoryChecked {
+  static constexpr bool enabled = true;
+};
+struct MemoryUnchecked {
+  static constexpr bool enabled = false;
+};
+using DefaultMemoryCheckPolicy =
+    std::conditional_t<HLT_MEMORY_CHECKS, MemoryChecked, MemoryUnchecked>;
+
+/// A host memory as passed by the MLIR calling convention for memrefs: the
+/// allocated and aligned pointers, an offset, and the size and stride of each
+/// dimension (in elements). A kernel addresses the memory through row-major
+/// indices into its shape, which the strides map onto the host buffer. This
+/// allows a subview of a larger host buffer to be accessed in place. A
+/// descriptor with all-zero strides is a flat, contiguous memory.
+template <typename TData, unsigned Rank>
+struct MemRefDescriptor {
+  TData *allocated = nullptr;
+  TData *aligned = nullptr;
+  int64_t offset = 0;
+  int64_t sizes[Rank] = {};
+  int64_t strides[Rank] = {};
+};
+
+/// Returns the view of bank 'bank' of a host memory of shape 'shape', which
+/// has been partitioned into 'factor' banks along dimension 'dim', either
+/// cyclically or in blocks. 'strides' are the strides of the host memory; if
+/// they are all zero, or not of the rank of 'shape', the host memory is a
+/// contiguous, row-major array of 'shape'.
+template <typename TDesc, typename TData>
+TDesc partitionMemRef(TData *allocated, TData *aligned, int64_t offset,
+                      std::initializer_list<int64_t> shape,
+                      std::initializer_list<int64_t> strides, unsigned dim,
+                      int64_t factor, int64_t bank, bool cyclic) {
+  constexpr unsigned rank = std::extent_v<decltype(TDesc::sizes)>;
+  assert(shape.size() == rank && dim < rank && "Unexpected partition rank");
+  assert(shape.begin()[dim] % factor == 0 && bank < factor &&
+         "Unexpected partition factor");
+  bool strided =
+      strides.size() == rank &&
+      std::any_of(strides.begin(), strides.end(), [](int64_t s) { return s; });
+
+  TDesc desc;
+  desc.allocated = allocated;
+  desc.aligned = aligned;
+  int64_t contiguousStride = 1;
+  for (unsigned i = rank; i-- > 0;) {
+    desc.sizes[i] = shape.begin()[i];
+    desc.strides[i] = strided ? strides.begin()[i] : contiguousStride;
+    contiguousStride *= desc.sizes[i];
+  }
+  int64_t bankSize = desc.sizes[dim] / factor;
+  desc.offset = offset + bank * desc.strides[dim] * (cyclic ? 1 : bankSize);
+  desc.sizes[dim] = bankSize;
+  if (cyclic)
+    desc.strides[dim] *= factor;
+  return desc;
+}
+
+/// Returns the view of a host memory of shape 'shape' as a memory of wide
+/// elements, each of which is made of 'factor' consecutive elements of the
+/// innermost dimension. 'strides' are the strides of the host memory; if they
+/// are all zero, or not of the rank of 'shape', the host memory is a
+/// contiguous, row-major array of 'shape'. Aborts if the wide elements are not
+/// contiguous in the host memory.
+template <typename TDesc, typename TData>
+TDesc vectorizeMemRef(TData *allocated, TData *aligned, int64_t offset,
+                      std::initializer_list<int64_t> shape,
+                      std::initializer_list<int64_t> strides, int64_t factor) {
+  using TVector = std::remove_pointer_t<decltype(TDesc::aligned)>;
+  constexpr unsigned rank = std::extent_v<decltype(TDesc::sizes)>;
+  static_assert(sizeof(TVector) % sizeof(TData) == 0,
+                "Expected wide elements to be made of host elements");
+  assert(shape.size() == rank && "Unexpected vector rank");
+  assert(sizeof(TVector) / sizeof(TData) == static_cast<size_t>(factor) &&
+         shape.begin()[rank - 1] % factor == 0 && "Unexpected vector factor");
+  bool strided =
+      strides.size() == rank &&
+      std::any_of(strides.begin(), strides.end(), [](int64_t s) { return s; });
+
+  // The offset is applied to the aligned pointer, such that the view may
+  // start at any element of the host memory.
+  TDesc desc;
+  desc.allocated = reinterpret_cast<TVector *>(allocated);
+  desc.aligned = reinterpret_cast<TVector *>(aligned + offset);
+  int64_t contiguousStride = 1;
+  for (unsigned i = rank; i-- > 0;) {
+    int64_t stride = strided ? strides.begin()[i] : contiguousStride;
+    if (i == rank - 1 ? stride != 1 : stride % factor != 0) {
+      std::cerr << "Cannot access a memory of stride " << stride
+                << " in dimension " << i << " through wide elements of "
+                << factor << " elements\n";
+      std::abort();
+    }
+    desc.sizes[i] = shape.begin()[i] / (i == rank - 1 ? factor : 1);
+    desc.strides[i] = i == rank - 1 ? 1 : stride / factor;
+    contiguousStride *= shape.begin()[i];
+  }
+  return desc;
+}
+
+/// Element type of a memory input, which is either a pointer or a
+/// MemRefDescriptor.
+template <typename T>
+struct MemoryElement {
+  using type = std::remove_pointer_t<T>;
+};
+template <typename TData, unsigned Rank>
+struct MemoryElement<MemRefDescriptor<TData, Rank>> {
+  using type = TData;
+};
+template <typename T>
+using MemoryElementT = typename MemoryElement<T>::type;
+
+template <typename T>
+struct IsMemRefDescriptor : std::false_type {};
+template <typename TData, unsigned Rank>
+struct IsMemRefDescriptor<MemRefDescriptor<TData, Rank>> : std::true_type {};
+
+/// Returns the number of bytes of the host memory spanned by the view 'desc',
+/// starting at its first element. A descriptor with all-zero strides is a
+/// contiguous memory of its sizes.
+template <typename TData, unsigned Rank>
+size_t viewBytes(const MemRefDescriptor<TData, Rank> &desc) {
+  bool strided = false;
+  int64_t elements = 1;
+  for (unsigned i = 0; i < Rank; ++i) {
+    strided |= desc.strides[i] != 0;
+    elements *= desc.sizes[i];
+  }
+  if (elements == 0 || !strided)
+    return elements * sizeof(TData);
+  int64_t last = 0;
+  for (unsigned i = 0; i < Rank; ++i)
+    last += (desc.sizes[i] - 1) * desc.strides[i];
+  return (last + 1) * sizeof(TData);
+}
+
+/// Returns a descriptor of a new, contiguous row-major memory of 'sizes',
+/// which the kernel writes a memref result into in place; see
+/// -hls-memref-results-to-args. The memory is allocated through malloc, such
+/// that the caller may release it through free, as it would a memref which is
+/// allocated by the lowered alloc of the reference.
+template <typename TDesc>
+TDesc allocateMemRef(std::initializer_list<int64_t> sizes) {
+  using TData = std::remove_pointer_t<decltype(TDesc::aligned)>;
+  constexpr unsigned rank = std::extent_v<decltype(TDesc::sizes)>;
+  assert(sizes.size() == rank && "Unexpected memref rank");
+  TDesc desc;
+  int64_t elements = 1;
+  for (unsigned i = rank; i-- > 0;) {
+    desc.sizes[i] = sizes.begin()[i];
+    desc.strides[i] = elements;
+    elements *= sizes.begin()[i];
+  }
+  desc.allocated = static_cast<TData *>(
+      std::malloc(std::max<size_t>(elements * sizeof(TData), 1)));
+  if (!desc.allocated) {
+    std::cerr << "Failed to allocate a memref result of " << elements
+              << " elements\n";
+    std::abort();
+  }
+  desc.aligned = desc.allocated;
+  return desc;
+}
+
+/// Returns the descriptor 'desc' as one of the element type of the host,
+/// whose elements are of the same size; see MemoryElement.
+template <typename THost, typename TDesc>
+THost castMemRef(const TDesc &desc) {
+  using THostData = std::remove_pointer_t<decltype(THost::aligned)>;
+  constexpr unsigned rank = std::extent_v<decltype(TDesc::sizes)>;
+  static_assert(sizeof(THostData) == sizeof(MemoryElementT<TDesc>) &&
+                    std::extent_v<decltype(THost::sizes)> == rank,
+                "Expected the host memref to be of the same layout");
+  THost host;
+  host.allocated = reinterpret_cast<THostData *>(desc.allocated);
+  host.aligned = reinterpret_cast<THostData *>(desc.aligned);
+  host.offset = desc.offset;
+  std::copy(desc.sizes, desc.sizes + rank, host.sizes);
+  std::copy(desc.strides, desc.strides + rank, host.strides);
+  return host;
+}
+
+/// Access statistics of a single port of a memory interface.
+struct MemoryPortStats {
+  MemoryPortStats(const std::string &name) : name(name) {}
+
+  void recordAccess(size_t addr) {
+#if HLT_MEMORY_STATS
+    accesses++;
+    if (lastAddr.has_value())
+      strides[static_cast<int64_t>(addr) -
+              static_cast<int64_t>(lastAddr.value())]++;
+    lastAddr = addr;
+#endif
+  }
+
+  void recordStall() {
+#if HLT_MEMORY_STATS
+    stallCycles++;
+#endif
+  }
+
+  std::string name;
+  // Number of accesses performed through the port.
+  uint64_t accesses = 0;
+  // Number of cycles in which an access was requested through the port, but
+  // the memory was not ready to accept it.
+  uint64_t stallCycles = 0;
+  // Histogram of the address differences between consecutive accesses.
+  std::map<int64_t, uint64_t> strides;
+  std::optional<size_t> lastAddr;
+};
+
+/// Type-agnostic access statistics of a memory interface.
+class MemoryInterfaceStats {
+public:
+  virtual ~MemoryInterfaceStats() = default;
+
+  /// Registers a load or store port of the memory, returning its statistics.
+  MemoryPortStats *addLoadStats() {
+    return &loadStats.emplace_back("ld" + std::to_string(loadStats.size()));
+  }
+  MemoryPortStats *addStoreStats() {
+    return &storeStats.emplace_back("st" + std::to_string(storeStats.size()));
+  }
+
+  // Deques, such that references to the statistics of a port remain valid as
+  // more ports are added.
+  std::deque<MemoryPortStats> loadStats;
+  std::deque<MemoryPortStats> storeStats;
+
+  /// Size of a single element of the memory, in bytes.
+  virtual size_t elementBytes() const = 0;
+
+  /// Returns the cache in front of the memory, if any.
+  virtual const circt::hlt::CacheModel *getCache() const { return nullptr; }
+
+  /// Returns the AXI4 master, or the AXI-Stream channel, through which the
+  /// memory is accessed, if any.
+  virtual const circt::hlt::AxiModel *getAxi() const { return nullptr; }
+  virtual const circt::hlt::AxiStreamModel *getStream() const {
+    return nullptr;
+  }
+
+  /// Writes the statistics of the memory as a JSON object.
+  void dumpStatsJSON(std::ostream &os, const std::string &name) const {
+    uint64_t bytes = 0;
+    for (auto *ports : {&loadStats, &storeStats})
+      for (auto &port : *ports)
+        bytes += port.accesses * elementBytes();
+
+    os << "{\"name\": \"" << name << "\", \"elementBytes\": "
+       << elementBytes() << ", \"bytes\": " << bytes << ", \"loads\": ";
+    dumpPortsJSON(os, loadStats);
+    os << ", \"stores\": ";
+    dumpPortsJSON(os, storeStats);
+    if (auto *cache = getCache()) {
+      os << ", \"cache\": ";
+      cache->dumpStatsJSON(os);
+    }
+    if (auto *axi = getAxi()) {
+      os << ", \"axi\": ";
+      axi->dumpStatsJSON(os);
+    }
+    if (auto *stream = getStream()) {
+      os << ", \"stream\": ";
+      stream->dumpStatsJSON(os);
+    }
+    os << "}";
+  }
+
+private:
+  static void dumpPortsJSON(std::ostream &os,
+                            const std::deque<MemoryPortStats> &ports) {
+    os << "[";
+    for (size_t i = 0; i < ports.size(); ++i) {
+      auto &port = ports[i];
+      os << (i == 0 ? "" : ", ") << "{\"name\": \"" << port.name
+         << "\", \"accesses\": " << port.accesses
+         << ", \"stallCycles\": " << port.stallCycles << ", \"strides\": {";
+      bool first = true;
+      for (auto &it : port.strides) {
+        os << (first ? "" : ", ") << "\"" << it.first << "\": " << it.second;
+        first = false;
+      }
+      os << "}}";
+    }
+    os << "]";
+  }
+};
 
 template <typename TData>
-class MemoryInterfaceBase {
+class MemoryInterfaceBase : public MemoryInterfaceStats {
 protected:
   // The memory pointer is set by the simulation engine during execution.
   TData *memory_ptr = nullptr;
 
 public:
-  MemoryInterfaceBase(std::optional<unsigned> memorySize = std::nullopt) {
-    memorySize = memorySize;
-  }
+  MemoryInterfaceBase(std::optional<unsigned> memorySize = std::nullopt)
+      : memorySize(memorySize) {}
 
   virtual void setMemory(void *memory) {
+    // A mapped file takes the place of the host memories.
+    if (mappedFile)
+      return;
     if (memory_ptr != nullptr)
       assert(memory_ptr == memory &&
              "The memory should always point to the same base address "
              "throughout simulation.");
     memory_ptr = reinterpret_cast<TData *>(memory);
+    viewSizes.clear();
+    viewStrides.clear();
   }
 
-  void write(unsigned addr, const TData &data) {
-    assert(this->memory_ptr != nullptr && "Memory not set.");
-    if (memorySize.has_value())
-      assert(addr < memorySize && "Address out of bounds.");
-    this->memory_ptr[addr] = data;
+  /// Runs the memory at a clock other than that of the kernel, whose rising
+  /// edges are counted by 'clockCycles'. The ports still handshake with the
+  /// kernel on its own clock, while the timing of the memory, such as its
+  /// latencies, is counted in cycles of its clock. Ignored by memory
+  /// interfaces which don't model cycles.
+  virtual void setClock(const uint64_t *clockCycles) {}
+
+  /// Sets the memory to the view described by 'desc'. If the view is not
+  /// contiguous, accesses are mapped through the sizes and strides of the
+  /// view. Each call may pass a different view, e.g. another tile of a larger
+  /// host buffer, so the previous view is forgotten rather than asserted to
+  /// be at the same address.
+  template <unsigned Rank>
+  void setMemory(const MemRefDescriptor<TData, Rank> &desc) {
+    clearMemory();
+    setMemory(reinterpret_cast<void *>(desc.aligned + desc.offset));
+    if (mappedFile)
+      return;
+    int64_t contiguousStride = 1;
+    bool contiguous = true;
+    for (unsigned i = Rank; i-- > 0;) {
+      if (desc.strides[i] != 0 && desc.strides[i] != contiguousStride)
+        contiguous = false;
+      contiguousStride *= desc.sizes[i];
+    }
+    if (contiguous)
+      return;
+    viewSizes.assign(desc.sizes, desc.sizes + Rank);
+    viewStrides.assign(desc.strides, desc.strides + Rank);
   }
 
-  TData read(unsigned addr) {
-    assert(this->memory_ptr != nullptr && "Memory not set.");
-    if (memorySize.has_value())
-      assert(addr < memorySize && "Address out of bounds.");
-    return this->memory_ptr[addr];
+  /// Forgets the host memory, such that a subsequent run may pass a memory at
+  /// a different address. A mapped file is kept.
+  void clearMemory() {
+    if (mappedFile)
+      return;
+    memory_ptr = nullptr;
+    viewSizes.clear();
+    viewStrides.clear();
+  }
+
+  /// Backs the memory by the file described by 'spec' (see MappedFileSpec)
+  /// for the remainder of the simulation. The host memories subsequently
+  /// passed to the kernel are ignored; stores of the kernel are only visible
+  /// through the file.
+  void mapFile(const std::string &spec) {
+    mappedFile = std::make_unique<circt::hlt::MappedFile>(
+        circt::hlt::MappedFileSpec::parse(spec),
+        memorySize.value_or(0) * sizeof(TData));
+    memory_ptr = static_cast<TData *>(mappedFile->data());
+    if (!memorySize.has_value())
+      memorySize = mappedFile->size() / sizeof(TData);
+    viewSizes.clear();
+    viewStrides.clear();
+  }
+
+  /// Maps the file given by HLT_MMAP_ARG<arg>, if set, to the memory of
+  /// kernel argument 'arg'.
+  void mapFileFromEnv(unsigned arg) {
+    std::string var = "HLT_MMAP_ARG" + std::to_string(arg);
+    if (const char *spec = std::getenv(var.c_str()))
+      mapFile(spec);
+  }
+
+  size_t elementBytes() const override { return sizeof(TData); }
+
+  /// Places a cache in front of the memory. The cache only affects the timing
+  /// of accesses, as reported by accessLatency().
+  void setCache(const circt::hlt::CacheConfig &config) {
+    cache = std::make_unique<circt::hlt::CacheModel>(config);
+  }
+  bool hasCache() const { return cache != nullptr; }
+  const circt::hlt::CacheModel *getCache() const override {
+    return cache.get();
+  }
+
+  /// Places an AXI4 master between the kernel and the memory. The master only
+  /// affects the timing of accesses, as reported by loadLatency() and
+  /// canStore(), and may not be combined with a cache.
+  void setAxi(const circt::hlt::AxiConfig &config) {
+    assert(!cache && "A memory may not have both a cache and an AXI master");
+    axi = std::make_unique<circt::hlt::AxiModel>(config);
+  }
+  bool hasAxi() const { return axi != nullptr; }
+  const circt::hlt::AxiModel *getAxi() const override { return axi.get(); }
+
+  /// Returns the latency of a load of the element at 'addr' issued in 'cycle',
+  /// as given by the AXI master of the memory, if any, or else by
+  /// accessLatency().
+  unsigned loadLatency(unsigned addr, unsigned defaultLatency,
+                       uint64_t cycle) {
+    if (!axi)
+      return accessLatency(addr, defaultLatency);
+    return axi->read(static_cast<size_t>(addr) * sizeof(TData), cycle);
+  }
+
+  /// Returns true if a store to the element at 'addr' may be accepted in
+  /// 'cycle', and records the timing of a store which was accepted.
+  bool canStore(unsigned addr, uint64_t cycle) const {
+    return !axi || axi->canWrite(static_cast<size_t>(addr) * sizeof(TData),
+                                 cycle);
+  }
+  void storeAccess(unsigned addr, uint64_t cycle) {
+    if (axi)
+      axi->write(static_cast<size_t>(addr) * sizeof(TData), cycle);
+    else
+      // Stores allocate lines in the cache, but their latency is hidden.
+      accessLatency(addr, 0);
+  }
+
+  /// Performs an access to the element at 'addr' in the cache, if any, and
+  /// returns its latency. Without a cache, all accesses have the latency
+  /// 'defaultLatency'.
+  unsigned accessLatency(unsigned addr, unsigned defaultLatency) {
+    if (!cache)
+      return defaultLatency;
+    return cache->access(static_cast<size_t>(addr) * sizeof(TData));
+  }
+
+  /// Writes the memory pointer, the contents of the memory and the cache
+  /// state to a checkpoint stream. The pointer is restored by value, so a
+  /// checkpoint may only be restored within the same address space layout.
+  void saveMemory(std::ostream &os) const {
+    os.write(reinterpret_cast<const char *>(&memory_ptr), sizeof(memory_ptr));
+    size_t rank = viewSizes.size();
+    os.write(reinterpret_cast<const char *>(&rank), sizeof(rank));
+    os.write(reinterpret_cast<const char *>(viewSizes.data()),
+             rank * sizeof(int64_t));
+    os.write(reinterpret_cast<const char *>(viewStrides.data()),
+             rank * sizeof(int64_t));
+    if (memory_ptr && memorySize.has_value())
+      for (unsigned addr = 0; addr < memorySize.value(); ++addr)
+        os.write(reinterpret_cast<const char *>(&memory_ptr[offsetOf(addr)]),
+                 sizeof(TData));
+    if (cache)
+      cache->saveState(os);
+    if (axi)
+      axi->saveState(os);
+  }
+  void restoreMemory(std::istream &is) {
+    is.read(reinterpret_cast<char *>(&memory_ptr), sizeof(memory_ptr));
+    size_t rank = 0;
+    is.read(reinterpret_cast<char *>(&rank), sizeof(rank));
+    viewSizes.resize(rank);
+    viewStrides.resize(rank);
+    is.read(reinterpret_cast<char *>(viewSizes.data()), rank * sizeof(int64_t));
+    is.read(reinterpret_cast<char *>(viewStrides.data()),
+            rank * sizeof(int64_t));
+    if (memory_ptr && memorySize.has_value())
+      for (unsigned addr = 0; addr < memorySize.value(); ++addr)
+        is.read(reinterpret_cast<char *>(&memory_ptr[offsetOf(addr)]),
+                sizeof(TData));
+    if (cache)
+      cache->restoreState(is);
+    if (axi)
+      axi->restoreState(is);
+  }
+
+  /// Writes 'data' to the element at 'addr'. 'port' names the port which
+  /// performs the access, and is used for error reporting.
+  template <typename TCheckPolicy = DefaultMemoryCheckPolicy>
+  void write(unsigned addr, const TData &data, const char *port = nullptr) {
+    if constexpr (TCheckPolicy::enabled) {
+      checkAccess(addr, "write", port);
+      checkWritable(addr, port);
+    }
+    this->memory_ptr[offsetOf(addr)] = data;
+  }
+
+  /// Reads the element at 'addr'. 'port' names the port which performs the
+  /// access, and is used for error reporting.
+  template <typename TCheckPolicy = DefaultMemoryCheckPolicy>
+  TData read(unsigned addr, const char *port = nullptr) {
+    if constexpr (TCheckPolicy::enabled)
+      checkAccess(addr, "read", port);
+    return this->memory_ptr[offsetOf(addr)];
+  }
+
+private:
+  // Returns the offset of the element at 'addr' from the memory pointer.
+  int64_t offsetOf(unsigned addr) const {
+    if (viewSizes.empty())
+      return addr;
+    int64_t offset = 0;
+    for (size_t i = viewSizes.size(); i-- > 0;) {
+      offset += (addr % viewSizes[i]) * viewStrides[i];
+      addr /= viewSizes[i];
+    }
+    return offset;
+  }
+
+  void checkWritable(unsigned addr, const char *port) const {
+    if (mappedFile && !mappedFile->writable()) {
+      std::cerr << "Memory write through port '" << (port ? port : "?")
+                << "' at address " << addr
+                << " to a memory mapped read-only.\n";
+      std::abort();
+    }
+  }
+
+  void checkAccess(unsigned addr, const char *access, const char *port) const {
+    const char *portName = port ? port : "?";
+    if (this->memory_ptr == nullptr) {
+      std::cerr << "Memory " << access << " through port '" << portName
+                << "' at address " << addr << " before the memory was set.\n";
+      std::abort();
+    }
+    if (memorySize.has_value() && addr >= memorySize.value()) {
+      std::cerr << "Memory " << access << " through port '" << portName
+                << "' at address " << addr
+                << " is out of bounds of the memory of size "
+                << memorySize.value() << ".\n";
+      std::abort();
+    }
   }
 
 protected:
   // A memory may be registered with a size. This is optional, and only applies
   // to statically sized memories.
   std::optional<unsigned> memorySize;
+
+  std::unique_ptr<circt::hlt::CacheModel> cache;
+  std::unique_ptr<circt::hlt::AxiModel> axi;
+
+  // The file backing the memory, if it is mapped.
+  std::unique_ptr<circt::hlt::MappedFile> mappedFile;
+
+  // Sizes and strides of the memory, if it is a non-contiguous view. Empty if
+  // the memory is contiguous.
+  std::vector<int64_t> viewSizes;
+  std::vector<int64_t> viewStrides;
 };
 
 #endif // CIRCT_TOOLS_HLT_MEMORYINTERFACE_H
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef CIRCT_TOOLS_HLT_NATIVECOSIM_H
+#define CIRCT_TOOLS_HLT_NATIVECOSIM_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Cosimulation of natively compiled testbenches, in which each call of the
+// kernel is compared against a call of its reference on copies of the
+// memories of the call (see the native testbench functions of hlt-wrapgen,
+// '--emit-native-tb'). This takes the place of the cosim dialect passes, which
+// instrument testbenches that are lowered through MLIR. Mismatches are
+// reported in the format of cosim-lower-compare, such that either kind of
+// testbench is checked alike:
+//   COSIM: <value>[<index>]: <reference> != <target> (@<ref> vs. @<target>)
+
+namespace circt {
+namespace hlt {
+
+class NativeCosim {
+public:
+  explicit NativeCosim(const std::string &name) : name(name) {}
+
+  /// Returns a copy of the 'n' elements at 'data', which the reference is
+  /// called on. The copy lives as long as this object.
+  template <typename T>
+  T *copy(const void *data, size_t n) {
+    // The words of the copy are aligned like any element type.
+    size_t bytes = n * sizeof(T);
+    buffers.emplace_back((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    std::memcpy(buffers.back().data(), data, bytes);
+    return reinterpret_cast<T *>(buffers.back().data());
+  }
+
+  /// Compares the 'n' elements of the memory 'what' of the reference and the
+  /// target.
+  template <typename T>
+  void compare(const std::string &what, const T *ref, const T *target,
+               size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      if (!match(ref[i], target[i]))
+        report(what + "[" + std::to_string(i) + "]", ref[i], target[i]);
+  }
+
+  /// Compares the value 'what' of the reference and the target.
+  template <typename T>
+  void compare(const std::string &what, T ref, T target) {
+    if (!match(ref, target))
+      report(what, ref, target);
+  }
+
+private:
+  // NaNs match each other, like those of cosim-lower-compare.
+  template <typename T>
+  static bool match(T a, T b) {
+    if constexpr (std::is_floating_point_v<T>)
+      return a == b || (std::isnan(a) && std::isnan(b));
+    else
+      return a == b;
+  }
+
+  template <typename T>
+  void report(const std::string &what, T ref, T target) const {
+    std::ostream &os = std::cout;
+    os << "COSIM: " << what << ": ";
+    if constexpr (std::is_floating_point_v<T>)
+      os << std::setprecision(std::numeric_limits<T>::max_digits10) << ref
+         << " != " << target;
+    else
+      os << +ref << " != " << +target;
+    os << " (@" << name << "_ref vs. @" << name << ")" << std::endl;
+  }
+
+  std::string name;
+  std::vector<std::vector<uint64_t>> buffers;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_NATIVECOSIM_H
@@ -0,0 +1,132 @@
+#ifndef CIRCT_TOOLS_HLT_PYBINDINGS_H
+#define CIRCT_TOOLS_HLT_PYBINDINGS_H
+
+#include <array>
+#include <cstdint>
+#include <future>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+// Support for the Python bindings which 'hlt-wrapgen --python' emits for the
+// kernel classes of a wrapper. NumPy arrays are passed as memref arguments in
+// place: the kernel accesses the buffer of the array, which is kept alive
+// until the result of the call is retrieved. The bindings only include the
+// header of the wrapper, and are built as a module which links against the
+// simulator library.
+
+namespace circt {
+namespace hlt {
+
+namespace py = pybind11;
+
+/// The descriptor of a memref of rank 'Rank' over the buffer of a NumPy
+/// array, in the MLIR calling convention (with a zero offset).
+template <typename T, unsigned Rank>
+struct PyMemRef {
+  T *data = nullptr;
+  std::array<int64_t, Rank> sizes;
+  std::array<int64_t, Rank> strides;
+
+  /// Returns the memref of rank 'Rank - 1' at index 'i' of the outer
+  /// dimension, which is the memref of call 'i' of a batch.
+  PyMemRef<T, Rank - 1> slice(int64_t i) const {
+    PyMemRef<T, Rank - 1> res;
+    res.data = data + i * strides[0];
+    for (unsigned d = 1; d < Rank; ++d) {
+      res.sizes[d - 1] = sizes[d];
+      res.strides[d - 1] = strides[d];
+    }
+    return res;
+  }
+};
+
+/// Returns the memref of 'array', which must be a writeable array of 'Rank'
+/// dimensions of elements of type T, whose strides are a multiple of the
+/// element size. 'name' names the argument in errors.
+template <typename T, unsigned Rank>
+PyMemRef<T, Rank> toMemRef(const py::array &array, const std::string &name) {
+  // The kernel accesses the array in place, so it is never converted.
+  if (!py::isinstance<py::array_t<T>>(array))
+    throw py::type_error("Expected argument '" + name + "' to be an array of " +
+                         py::str(py::dtype::of<T>()).cast<std::string>() +
+                         ", got " + py::str(array.dtype()).cast<std::string>());
+  if (array.ndim() != Rank)
+    throw py::value_error("Expected argument '" + name + "' to have " +
+                          std::to_string(Rank) + " dimensions, got " +
+                          std::to_string(array.ndim()));
+  if (!array.writeable())
+    throw py::value_error("Expected argument '" + name + "' to be writeable");
+  PyMemRef<T, Rank> res;
+  res.data = static_cast<T *>(const_cast<void *>(array.data()));
+  for (unsigned d = 0; d < Rank; ++d) {
+    if (array.strides(d) % static_cast<py::ssize_t>(sizeof(T)) != 0)
+      throw py::value_error("Expected the strides of argument '" + name +
+                            "' to be a multiple of its element size");
+    res.sizes[d] = array.shape(d);
+    res.strides[d] = array.strides(d) / static_cast<py::ssize_t>(sizeof(T));
+  }
+  return res;
+}
+
+/// Returns the number of calls of a batch, which is the size of the outer
+/// dimension of each of 'arrays'.
+inline int64_t getBatchSize(const std::vector<py::array> &arrays) {
+  int64_t n = arrays.empty() ? 0 : arrays.front().shape(0);
+  for (auto &array : arrays)
+    if (array.ndim() == 0 || array.shape(0) != n)
+      throw py::value_error("Expected the arguments of a batch to have an "
+                            "outer dimension of the same size");
+  return n;
+}
+
+/// A call of a kernel class 'Kernel', whose result is of type R. The arrays of
+/// the call are kept alive until its result is retrieved.
+template <typename Kernel, typename R>
+class PyCall {
+public:
+  PyCall(std::future<R> future, std::vector<py::object> arrays)
+      : future(std::move(future)), arrays(std::move(arrays)) {}
+
+  /// Blocking. Returns the result of the call, and None for kernels without
+  /// results. The GIL is released while waiting for the simulator.
+  py::object result() {
+    if (value)
+      return *value;
+    if constexpr (std::is_void_v<R>) {
+      {
+        py::gil_scoped_release release;
+        future.get();
+      }
+      value = py::none();
+    } else {
+      std::optional<R> res;
+      {
+        py::gil_scoped_release release;
+        res = future.get();
+      }
+      value = py::cast(std::move(*res));
+    }
+    arrays.clear();
+    return *value;
+  }
+
+  /// Registers the class of the calls of 'Kernel' as 'name' in module 'm'.
+  static void bind(py::module_ &m, const char *name) {
+    py::class_<PyCall>(m, name).def("result", &PyCall::result);
+  }
+
+private:
+  std::future<R> future;
+  std::vector<py::object> arrays;
+  std::optional<py::object> value;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_PYBINDINGS_H
@@ -0,0 +1,138 @@
+#ifndef CIRCT_TOOLS_HLT_REFCACHE_H
+#define CIRCT_TOOLS_HLT_REFCACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// A cache of the outputs of the calls of a reference function in
+// cosimulation, keyed by a digest of their inputs (see
+// cosim-lower-call{memoize-ref}).
+
+namespace circt {
+namespace hlt {
+
+/// An entry holds the results of a call, followed by the memories written by
+/// the call, in a file named by its key within $HLT_REF_CACHE. Keys only cover
+/// the name and the inputs of the reference, so the cache must be cleared when
+/// the reference changes.
+class RefCache {
+public:
+  static RefCache &get() {
+    static RefCache cache;
+    return cache;
+  }
+
+  /// Looks up the entry of 'key', which is then loaded from. Returns false if
+  /// there is no such entry.
+  bool lookup(uint64_t key) {
+    if (dir.empty())
+      return false;
+    std::ifstream in(path(key), std::ios::binary);
+    if (!in)
+      return false;
+    entry.assign(std::istreambuf_iterator<char>(in),
+                 std::istreambuf_iterator<char>());
+    pos = 0;
+    return true;
+  }
+
+  /// Loads the next 'bytes' bytes of the entry which was looked up.
+  void load(void *data, size_t bytes) {
+    if (pos + bytes > entry.size()) {
+      std::cerr << "Reference cache entry in '" << dir
+                << "' is truncated; clear the cache\n";
+      std::abort();
+    }
+    std::memcpy(data, entry.data() + pos, bytes);
+    pos += bytes;
+  }
+
+  /// Starts a new entry of 'key', which is stored to.
+  void beginStore(uint64_t key) {
+    storeKey = key;
+    entry.clear();
+  }
+
+  /// Appends 'bytes' bytes to the new entry.
+  void store(const void *data, size_t bytes) {
+    const char *bytesPtr = static_cast<const char *>(data);
+    entry.insert(entry.end(), bytesPtr, bytesPtr + bytes);
+  }
+
+  /// Writes the new entry to the cache. Entries are written to a temporary
+  /// file first, such that concurrent runs never read a partial entry.
+  void endStore() {
+    if (dir.empty())
+      return;
+    std::string entryPath = path(storeKey);
+    std::string tmpPath = entryPath + "." + std::to_string(getpid());
+    {
+      std::ofstream out(tmpPath, std::ios::binary);
+      out.write(entry.data(), entry.size());
+      if (!out) {
+        std::cerr << "Failed to write reference cache entry '" << tmpPath
+                  << "'\n";
+        std::remove(tmpPath.c_str());
+        return;
+      }
+    }
+    std::rename(tmpPath.c_str(), entryPath.c_str());
+  }
+
+private:
+  RefCache() {
+    if (const char *env = std::getenv("HLT_REF_CACHE"))
+      dir = env;
+  }
+
+  std::string path(uint64_t key) const {
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx",
+                  static_cast<unsigned long long>(key));
+    return dir + "/" + name + ".ref";
+  }
+
+  std::string dir;
+  // The entry which is loaded from, or stored to.
+  std::vector<char> entry;
+  size_t pos = 0;
+  uint64_t storeKey = 0;
+};
+
+} // namespace hlt
+} // namespace circt
+
+/// Returns 1 if the cache holds an entry of 'key', whose outputs are then
+/// loaded through hlt_ref_cache_load.
+extern "C" int32_t hlt_ref_cache_lookup(uint64_t key) {
+  return circt::hlt::RefCache::get().lookup(key) ? 1 : 0;
+}
+
+extern "C" void hlt_ref_cache_load(void *data, int64_t bytes) {
+  circt::hlt::RefCache::get().load(data, bytes);
+}
+
+/// Stores the outputs of a call, passed through hlt_ref_cache_store, as the
+/// entry of 'key'.
+extern "C" void hlt_ref_cache_store_begin(uint64_t key) {
+  circt::hlt::RefCache::get().beginStore(key);
+}
+
+extern "C" void hlt_ref_cache_store(const void *data, int64_t bytes) {
+  circt::hlt::RefCache::get().store(data, bytes);
+}
+
+extern "C" void hlt_ref_cache_store_end() {
+  circt::hlt::RefCache::get().endStore();
+}
+
+#endif // CIRCT_TOOLS_HLT_REFCACHE_H
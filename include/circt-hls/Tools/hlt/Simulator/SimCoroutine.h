@@ -0,0 +1,201 @@
+#ifndef CIRCT_TOOLS_HLT_SIMCOROUTINE_H
+#define CIRCT_TOOLS_HLT_SIMCOROUTINE_H
+
+// Coroutine testbenches over a simulator driver (SimDriver, or SimDriverPool).
+// A testbench spawns any number of logical testbench threads, each of which is
+// a coroutine returning a SimCoTask, onto a SimCoScheduler, and awaits the
+// calls of its own stimulus sequence:
+//
+//   SimCoTask stimulus(SimCoScheduler<TDriver> &tb, int32_t seed) {
+//     for (int32_t i = 0; i < 100; ++i) {
+//       TOutput out = co_await tb.call(TInput{seed + i});
+//       ...
+//     }
+//   }
+//
+//   SimCoScheduler<TDriver> tb(driver);
+//   for (int32_t seed = 0; seed < 16; ++seed)
+//     tb.spawn(stimulus(tb, seed));
+//   tb.run();
+//
+// The coroutines interleave on the thread which calls run: a coroutine which
+// awaits a call is suspended until the output of the call is available, and
+// every runnable coroutine is resumed before run blocks on an output, such
+// that the calls of all coroutines are in flight at once. Calls are pushed
+// and their outputs retrieved through the futures of the driver (see
+// SimDriver::popAsync). Testbenches using this header must be built as C++20.
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <future>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace circt {
+namespace hlt {
+
+/// A logical testbench thread. The coroutine starts once it is spawned onto a
+/// SimCoScheduler, which owns it from then on.
+class SimCoTask {
+public:
+  struct promise_type {
+    SimCoTask get_return_object() {
+      return SimCoTask(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { exception = std::current_exception(); }
+
+    std::exception_ptr exception;
+  };
+
+  SimCoTask(SimCoTask &&other) noexcept
+      : handle(std::exchange(other.handle, {})) {}
+  SimCoTask(const SimCoTask &) = delete;
+  SimCoTask &operator=(const SimCoTask &) = delete;
+  ~SimCoTask() {
+    if (handle)
+      handle.destroy();
+  }
+
+  /// Releases the coroutine to the caller, which destroys it once done.
+  std::coroutine_handle<promise_type> release() {
+    return std::exchange(handle, {});
+  }
+
+private:
+  explicit SimCoTask(std::coroutine_handle<promise_type> handle)
+      : handle(handle) {}
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+/// Runs the coroutines of a testbench against 'driver'.
+template <typename TDriver>
+class SimCoScheduler {
+  using TOutput =
+      std::decay_t<decltype(std::declval<TDriver &>().popAsync().get())>;
+  using Handle = std::coroutine_handle<SimCoTask::promise_type>;
+
+  // A call whose coroutine awaits its output.
+  struct PendingCall {
+    std::future<TOutput> output;
+    std::coroutine_handle<> waiter;
+    std::optional<TOutput> *result;
+  };
+
+public:
+  /// The awaitable of a call of the kernel, which resumes the awaiting
+  /// coroutine with the output of the call.
+  template <typename... Args>
+  class CallAwaiter {
+  public:
+    CallAwaiter(SimCoScheduler &scheduler, Args &&...args)
+        : scheduler(scheduler), args(std::forward<Args>(args)...) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> waiter) {
+      // The inputs are pushed as the coroutine suspends, such that the calls
+      // of all coroutines in a round of resumptions are pushed before any of
+      // them is awaited.
+      std::apply(
+          [&](auto &&...a) {
+            scheduler.driver.emplace(std::forward<decltype(a)>(a)...);
+          },
+          std::move(args));
+      scheduler.pending.push_back(
+          {scheduler.driver.popAsync(), waiter, &result});
+    }
+
+    TOutput await_resume() { return std::move(*result); }
+
+  private:
+    SimCoScheduler &scheduler;
+    std::tuple<Args...> args;
+    std::optional<TOutput> result;
+  };
+
+  explicit SimCoScheduler(TDriver &driver) : driver(driver) {}
+  SimCoScheduler(const SimCoScheduler &) = delete;
+  SimCoScheduler &operator=(const SimCoScheduler &) = delete;
+  ~SimCoScheduler() {
+    for (Handle task : tasks)
+      task.destroy();
+  }
+
+  /// Returns an awaitable which calls the kernel with an input constructed
+  /// from 'args' (see SimDriver::emplace).
+  template <typename... Args>
+  CallAwaiter<Args...> call(Args &&...args) {
+    return CallAwaiter<Args...>(*this, std::forward<Args>(args)...);
+  }
+
+  /// Spawns 'task', which starts running once run is called.
+  void spawn(SimCoTask task) {
+    Handle handle = task.release();
+    tasks.push_back(handle);
+    ready.push_back(handle);
+  }
+
+  /// Blocking. Runs the spawned coroutines until all of them are done.
+  /// Rethrows the first exception raised by a coroutine, or by the driver.
+  void run() {
+    while (!ready.empty() || !pending.empty()) {
+      // Resume every runnable coroutine, each of which runs until it awaits
+      // its next call, or is done.
+      while (!ready.empty()) {
+        std::coroutine_handle<> handle = ready.front();
+        ready.pop_front();
+        handle.resume();
+      }
+      for (Handle task : tasks)
+        if (task.done() && task.promise().exception)
+          std::rethrow_exception(task.promise().exception);
+      if (pending.empty())
+        break;
+
+      // Block on the oldest call, and resume the coroutines of all calls
+      // which are done by then.
+      pending.front().output.wait();
+      for (auto it = pending.begin(); it != pending.end();) {
+        if (it->output.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+          ++it;
+          continue;
+        }
+        *it->result = it->output.get();
+        ready.push_back(it->waiter);
+        it = pending.erase(it);
+      }
+    }
+  }
+
+private:
+  TDriver &driver;
+
+  // All spawned coroutines, which are destroyed along with the scheduler.
+  std::vector<Handle> tasks;
+
+  // Coroutines which are runnable, in the order that they became runnable.
+  std::deque<std::coroutine_handle<>> ready;
+
+  // Calls which are in flight, in the order that they were pushed.
+  std::deque<PendingCall> pending;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // __cplusplus >= 202002L
+
+#endif // CIRCT_TOOLS_HLT_SIMCOROUTINE_H
@@ -0,0 +1,234 @@
+#ifndef CIRCT_TOOLS_HLT_SIMDEBUGSERVER_H
+#define CIRCT_TOOLS_HLT_SIMDEBUGSERVER_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef HLT_DEBUG_PORT
+// The port which the debug server of the first simulator instance listens to.
+// Instance N listens to HLT_DEBUG_PORT + N. Overridden at runtime through the
+// HLT_DEBUG_PORT environment variable.
+#define HLT_DEBUG_PORT 9901
+#endif
+
+#ifndef HLT_DEBUG_POLL_INTERVAL
+// Number of steps between each time a running simulation checks for commands
+// from the debug client. A paused simulation blocks on the client.
+#define HLT_DEBUG_POLL_INTERVAL 64
+#endif
+
+namespace circt {
+namespace hlt {
+
+/// Serves the signals of a running simulation to a debug client (such as
+/// hsdbg) over a TCP socket on the loopback interface. The protocol is line
+/// based; each command is answered by a single line, except for 'signals':
+///   signals     -> '<name> <width>' for each signal, followed by 'end'.
+///   values      -> '<cycle> <value>...' with each value in hex, in the order
+///                  of 'signals'.
+///   cycle       -> '<cycle>'
+///   pause       -> 'paused <cycle>'
+///   step [n]    -> 'paused <cycle>', once n (default 1) steps have been taken.
+///   resume      -> 'running'
+/// Commands are served between steps of the simulation, so a simulation whose
+/// runner is asleep serves them once it next steps.
+class SimDebugServer {
+  struct DebugSignal {
+    std::string name;
+    const uint8_t *data;
+    unsigned width;
+  };
+
+public:
+  ~SimDebugServer() {
+    closeClient();
+    if (listenFd >= 0)
+      close(listenFd);
+  }
+
+  /// Registers a signal of 'width' bits, whose value is stored little-endian
+  /// at 'data' (as is the case for all verilated signal types).
+  void addSignal(const std::string &name, const void *data, unsigned width) {
+    signals.push_back({name, static_cast<const uint8_t *>(data), width});
+  }
+
+  /// Starts listening for a debug client on 'port'. If 'wait' is set, blocks
+  /// until a client connects, and starts the simulation paused.
+  bool listen(unsigned port, bool wait) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0)
+      return false;
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ||
+        ::listen(listenFd, 1))
+      return false;
+    fcntl(listenFd, F_SETFL, O_NONBLOCK);
+    std::cout << "Debug server listening on port " << port << std::endl;
+    if (wait) {
+      acceptClient(/*block=*/true);
+      paused = true;
+    }
+    return true;
+  }
+
+  /// Called after each step of the simulation, which is now at 'cycle'.
+  /// Serves the client, blocking while the client has paused the simulation.
+  void onStep(uint64_t cycle) {
+    this->cycle = cycle;
+    if (stepsLeft != 0 && --stepsLeft == 0) {
+      paused = true;
+      send("paused " + std::to_string(cycle));
+    }
+    if (!paused && ++pollCntr < HLT_DEBUG_POLL_INTERVAL)
+      return;
+    pollCntr = 0;
+    if (clientFd < 0 && !acceptClient(/*block=*/false))
+      return;
+    std::string line;
+    while (readLine(line, /*block=*/paused))
+      handle(line);
+  }
+
+private:
+  bool acceptClient(bool block) {
+    if (block) {
+      fcntl(listenFd, F_SETFL, 0);
+      clientFd = accept(listenFd, nullptr, nullptr);
+      fcntl(listenFd, F_SETFL, O_NONBLOCK);
+    } else {
+      clientFd = accept(listenFd, nullptr, nullptr);
+    }
+    return clientFd >= 0;
+  }
+
+  // A disconnected client leaves the simulation running.
+  void closeClient() {
+    if (clientFd >= 0)
+      close(clientFd);
+    clientFd = -1;
+    paused = false;
+    stepsLeft = 0;
+    rxBuffer.clear();
+  }
+
+  // Reads a line from the client into 'line'. Returns false if no line is
+  // available without blocking, or if the client disconnected.
+  bool readLine(std::string &line, bool block) {
+    while (true) {
+      size_t end = rxBuffer.find('\n');
+      if (end != std::string::npos) {
+        line = rxBuffer.substr(0, end);
+        rxBuffer.erase(0, end + 1);
+        return true;
+      }
+      if (clientFd < 0)
+        return false;
+      char buf[256];
+      ssize_t n = recv(clientFd, buf, sizeof(buf), block ? 0 : MSG_DONTWAIT);
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return false;
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) {
+        closeClient();
+        return false;
+      }
+      rxBuffer.append(buf, n);
+    }
+  }
+
+  void send(const std::string &line) {
+    std::string msg = line + "\n";
+    size_t sent = 0;
+    while (clientFd >= 0 && sent < msg.size()) {
+      ssize_t n = ::send(clientFd, msg.data() + sent, msg.size() - sent,
+                         MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) {
+        closeClient();
+        return;
+      }
+      sent += n;
+    }
+  }
+
+  void handle(const std::string &line) {
+    std::istringstream is(line);
+    std::string cmd;
+    is >> cmd;
+    if (cmd == "signals") {
+      for (auto &sig : signals)
+        send(sig.name + " " + std::to_string(sig.width));
+      send("end");
+    } else if (cmd == "values") {
+      std::string values = std::to_string(cycle);
+      for (auto &sig : signals)
+        values += " " + toHex(sig);
+      send(values);
+    } else if (cmd == "cycle") {
+      send(std::to_string(cycle));
+    } else if (cmd == "pause") {
+      paused = true;
+      stepsLeft = 0;
+      send("paused " + std::to_string(cycle));
+    } else if (cmd == "step") {
+      uint64_t n = 1;
+      is >> n;
+      stepsLeft = n == 0 ? 1 : n;
+      paused = false;
+    } else if (cmd == "resume") {
+      paused = false;
+      stepsLeft = 0;
+      send("running");
+    } else {
+      send("error unknown command '" + cmd + "'");
+    }
+  }
+
+  static std::string toHex(const DebugSignal &sig) {
+    static const char *digits = "0123456789abcdef";
+    unsigned numDigits = (sig.width + 3) / 4;
+    std::string hex(numDigits, '0');
+    for (unsigned i = 0; i < numDigits; ++i) {
+      unsigned nibble = sig.data[i / 2] >> (4 * (i % 2)) & 0xF;
+      // Mask off the bits above the width of the signal.
+      if (i == numDigits - 1 && sig.width % 4)
+        nibble &= (1 << (sig.width % 4)) - 1;
+      hex[numDigits - 1 - i] = digits[nibble];
+    }
+    return hex;
+  }
+
+  std::vector<DebugSignal> signals;
+  int listenFd = -1;
+  int clientFd = -1;
+  std::string rxBuffer;
+
+  uint64_t cycle = 0;
+  unsigned pollCntr = 0;
+  bool paused = false;
+  // Number of steps left of the current 'step' command.
+  uint64_t stepsLeft = 0;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_SIMDEBUGSERVER_H
@@ -1,17 +1,41 @@
 #ifndef CIRCT_TOOLS_HLT_SIMDRIVER_H
 #define CIRCT_TOOLS_HLT_SIMDRIVER_H
 
+#include <algorithm>
 #include <assert.h>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
 #include <list>
 #include <memory>
+#include <optional>
 #include <thread>
 #include <vector>
 
+#include "circt-hls/Tools/hlt/Simulator/HostBuffer.h"
 #include "circt-hls/Tools/hlt/Simulator/SimInterface.h"
 #include "circt-hls/Tools/hlt/Simulator/SimRunner.h"
 
+#ifndef HLT_FUZZ
+// Set to 1 to export the fuzzer input functions which fuzzing testbenches draw
+// their inputs from; see FuzzInput.h.
+#define HLT_FUZZ 0
+#endif
+
+#if HLT_FUZZ
+#include "circt-hls/Tools/hlt/Simulator/FuzzInput.h"
+#endif
+
+#ifndef HLT_INPUT_WINDOW
+// Default number of inputs pushed to a simulator driver which the simulator
+// may not yet have consumed. Pushing an input blocks while this many inputs
+// are queued, such that a testbench which runs ahead of the simulator does
+// not queue an unbounded number of inputs. At most HLT_QUEUE_CAPACITY.
+#define HLT_INPUT_WINDOW HLT_QUEUE_CAPACITY
+#endif
+
 //===----------------------------------------------------------------------===//
 // Sim driver
 //===----------------------------------------------------------------------===//
@@ -31,47 +55,299 @@ class SimDriver {
                 "TInput must be a tuple");
   static_assert(is_instance_of_template<TOutput, std::tuple>::value,
                 "TOutput must be a tuple");
+  static_assert(HLT_INPUT_WINDOW > 0 && HLT_INPUT_WINDOW <= HLT_QUEUE_CAPACITY,
+                "HLT_INPUT_WINDOW must be within the input queue capacity");
 
 public:
-  SimDriver() { runner = std::make_unique<SimRunnerImpl>(queues); }
+  /// 'instance' identifies this driver when multiple drivers exist within a
+  /// process; see SimDriverPool.
+  SimDriver(unsigned instance = 0) {
+    runner = std::make_unique<SimRunnerImpl>(queues, instance);
+  }
 
-  /// Non-blocking
-  void push(const TInput &in) {
+  /// Sets the number of pushed inputs which the simulator may not yet have
+  /// consumed, past which pushing an input blocks (see HLT_INPUT_WINDOW).
+  void setInputWindow(size_t n) {
+    assert(n > 0 && n <= HLT_QUEUE_CAPACITY &&
+           "Input window must be within the input queue capacity");
+    inputWindow = n;
+  }
+
+  /// Blocking while the input window is full.
+  void push(const TInput &in) { emplace(in); }
+  void push(TInput &&in) { emplace(std::move(in)); }
+
+  /// Non-blocking. Pushes an input, unless the input window is full, in which
+  /// case false is returned.
+  bool tryPush(const TInput &in) { return tryEmplace(in); }
+  bool tryPush(TInput &&in) { return tryEmplace(std::move(in)); }
+
+  /// Blocking while the input window is full. Constructs the input from
+  /// 'args' in place within the input queue.
+  template <typename... Args>
+  void emplace(Args &&...args) {
+    emplaceTagged(0, std::forward<Args>(args)...);
+  }
+
+  /// Non-blocking. Like emplace, but returns false rather than blocking if
+  /// the input window is full.
+  template <typename... Args>
+  bool tryEmplace(Args &&...args) {
     runner->checkError();
-    debugOut << "DRIVER: Pushing input..." << std::endl;
-    queues.in.push(in);
-    runner->wakeup();
+    if (inputWindowFull()) {
+      runner->wakeup();
+      return false;
+    }
+    emplaceTagged(0, std::forward<Args>(args)...);
+    return true;
+  }
+
+  /// Blocking while the input window is full. Like emplace, but tags the
+  /// input with 'tag', which is returned along with its output by popTagged.
+  template <typename... Args>
+  void emplaceTagged(uint64_t tag, Args &&...args) {
+    emplaceImpl(tag, nullptr, std::forward<Args>(args)...);
+  }
+
+  /// Blocking while the input window is full. Like emplace, but pushes the
+  /// input along with the expected output of the call, which simulators built
+  /// with HLT_STREAM_CHECK check the output of the call against as it is
+  /// produced; see SimExpectation.
+  template <typename... Args>
+  void
+  emplaceExpected(std::shared_ptr<const SimExpectation<TOutput>> expected,
+                  Args &&...args) {
+    emplaceImpl(0, std::move(expected), std::forward<Args>(args)...);
+  }
+
+  /// Blocking while the input window is full. Pushes n inputs with a single
+  /// runner wakeup. The runner is only woken up early if the input window
+  /// fills up.
+  void pushBatch(const TInput *in, size_t n) {
+    pushBatchImpl(in, n, [](const TInput &v) -> const TInput & { return v; });
+  }
+  void pushBatch(std::vector<TInput> &&in) {
+    pushBatchImpl(in.data(), in.size(),
+                  [](TInput &v) -> TInput && { return std::move(v); });
+  }
+
+  /// Non-blocking. Returns a future for the output of the oldest pushed input
+  /// whose output has not yet been popped. Unlike the other pop functions,
+  /// this allocates the shared state of the future.
+  std::future<TOutput> popAsync() {
+    runner->checkError();
+    assert(numPending() != 0 && "No pushed input to pop an output for");
+    if (!spilled.empty()) {
+      auto f = std::move(spilled.front().second);
+      spilled.pop_front();
+      return f;
+    }
+    return queues.out.attach(headSeq++);
+  }
+
+  /// Non-blocking. Pops the output of the oldest pushed input, if the
+  /// simulator has produced it.
+  std::optional<TOutput> tryPop() {
+    runner->checkError();
+    if (!oldestReady())
+      return std::nullopt;
+    return popReady();
+  }
+
+  /// Non-blocking. Like tryPop, but also returns the tag of the input.
+  std::optional<std::pair<uint64_t, TOutput>> tryPopTagged() {
+    runner->checkError();
+    if (!oldestReady())
+      return std::nullopt;
+    uint64_t tag = oldestTag();
+    return std::make_pair(tag, popReady());
+  }
+
+  /// Blocking. Like pop, but also returns the tag of the input. A single
+  /// simulator produces outputs in order, so this pops the output of the
+  /// oldest pushed input.
+  std::pair<uint64_t, TOutput> popTagged() {
+    assert(numPending() != 0 && "No pushed input to pop an output for");
+    uint64_t tag = oldestTag();
+    return {tag, pop()};
   }
 
   /// Blocking
   TOutput pop() {
+    HLT_PROFILE_SCOPE("pop");
+    debugOut << "DRIVER: Awaiting output..." << std::endl;
     runner->checkError();
+    assert(numPending() != 0 && "No pushed input to pop an output for");
 
-    debugOut << "DRIVER: Awaiting output..." << std::endl;
-    auto cv = std::make_shared<std::condition_variable>();
-    queues.outReq.push(cv);
-    runner->wakeup();
+    // Spin until the runner has returned the output, as the outputs of a
+    // single simulator are returned in order, before parking on a future of
+    // the output. Only outputs which are awaited past the spin thereby
+    // allocate a future. The runner fails all pending outputs when it errors,
+    // but keep checking the error state in case the error was raised before
+    // this output was pushed.
+    if (spilled.empty() &&
+        popSpin.spinUntil([&]() { return queues.out.isReady(headSeq); })) {
+      debugOut << "DRIVER: Popping output..." << std::endl;
+      return popReady();
+    }
+    auto f = popAsync();
+    while (f.wait_for(std::chrono::milliseconds(10)) !=
+           std::future_status::ready)
+      runner->checkError();
 
-    // Todo: there's a race condition between notifying the runner and this
-    // thread spinning on uslock.
+    debugOut << "DRIVER: Wakeup, popping output..." << std::endl;
+    return f.get();
+  }
+
+  /// Returns the number of pushed inputs whose outputs have not yet been
+  /// popped.
+  size_t numPending() const { return nextSeq - headSeq + spilled.size(); }
+
+  /// Returns the simulated cycles of the last call; see
+  /// SimRunner::lastCallCycles.
+  uint64_t lastCallCycles() const { return runner->lastCallCycles(); }
 
-    // Spin
-    std::mutex lock;
-    std::unique_lock<std::mutex> ulock(lock);
-    cv->wait(ulock);
+  /// Blocking. Pops the outputs of the n oldest pushed inputs.
+  void popBatch(TOutput *out, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      out[i] = pop();
+  }
 
-    // Must check error again in case this thread was awaken due to a simulation
-    // error.
+  /// Blocking. Re-initializes the simulator for a new, independent run,
+  /// without recreating the model or the runner thread. All pushed inputs must
+  /// have been popped.
+  void reset() {
     runner->checkError();
-    debugOut << "DRIVER: Wakeup, popping output..." << std::endl;
+    assert(numPending() == 0 && "Resetting with pending outputs");
+    auto f = runner->requestReset();
+    while (f.wait_for(std::chrono::milliseconds(10)) !=
+           std::future_status::ready)
+      runner->checkError();
+    f.get();
+  }
 
-    // Get output
-    return queues.out.pop();
+  /// Blocking. Suspends the runner thread once the simulator has been set up,
+  /// such that the process can be forked; see SimRunner::suspend. No input
+  /// may have been pushed.
+  void suspend() {
+    assert(numPending() == 0 && "Suspending with pending outputs");
+    runner->suspend();
+    runner->checkError();
   }
 
+  /// Resumes a suspended runner thread, within a forked child if 'forked' is
+  /// set; see SimRunner::resume.
+  void resume(bool forked) { runner->resume(forked); }
+
 private:
+  template <typename... Args>
+  void emplaceImpl(uint64_t tag,
+                   std::shared_ptr<const SimExpectation<TOutput>> expected,
+                   Args &&...args) {
+    HLT_PROFILE_SCOPE("push");
+    runner->checkError();
+    debugOut << "DRIVER: Pushing input..." << std::endl;
+    waitForInputWindow();
+    claimSlot(tag);
+    queues.in.push(typename SimQueuesImpl::InputRequest{
+        TInput(std::forward<Args>(args)...), std::move(expected)});
+    runner->wakeup();
+  }
+
+  // Pushes the n inputs at 'in', passing each through 'forward' to either copy
+  // or move it into the input queue.
+  template <typename T, typename Forward>
+  void pushBatchImpl(T *in, size_t n, Forward forward) {
+    HLT_PROFILE_SCOPE("pushBatch");
+    runner->checkError();
+    debugOut << "DRIVER: Pushing " << n << " inputs..." << std::endl;
+    for (size_t i = 0; i < n; ++i) {
+      waitForInputWindow();
+      claimSlot(0);
+      queues.in.push(
+          typename SimQueuesImpl::InputRequest{forward(in[i]), nullptr});
+    }
+    runner->wakeup();
+  }
+
+  // Claims the result slot of the next pushed input, which is tagged with
+  // 'tag'. The ring holds at most the outputs of as many calls as it has
+  // slots, so the oldest call is first popped into a future if all of its
+  // slots hold outputs which have not been popped. The slot is free once the
+  // runner has returned the output of the call which last held it.
+  void claimSlot(uint64_t tag) {
+    if (nextSeq - headSeq == queues.out.capacity()) {
+      uint64_t oldestTag = tags[headSeq & (queues.out.capacity() - 1)];
+      spilled.emplace_back(oldestTag, queues.out.attach(headSeq++));
+    }
+    while (!queues.out.isFree(nextSeq)) {
+      runner->wakeup();
+      std::this_thread::yield();
+      runner->checkError();
+    }
+    tags[nextSeq & (queues.out.capacity() - 1)] = tag;
+    queues.out.claim(nextSeq++);
+  }
+
+  // Returns true if the output of the oldest pushed input, if any, has been
+  // returned.
+  bool oldestReady() {
+    if (!spilled.empty())
+      return spilled.front().second.wait_for(std::chrono::seconds(0)) ==
+             std::future_status::ready;
+    return numPending() != 0 && queues.out.isReady(headSeq);
+  }
+
+  // Returns the tag of the oldest pushed input whose output has not yet been
+  // popped.
+  uint64_t oldestTag() const {
+    if (!spilled.empty())
+      return spilled.front().first;
+    return tags[headSeq & (queues.out.capacity() - 1)];
+  }
+
+  // Pops the output of the oldest pushed input, which has been returned.
+  TOutput popReady() {
+    if (!spilled.empty()) {
+      TOutput output = spilled.front().second.get();
+      spilled.pop_front();
+      return output;
+    }
+    return queues.out.take(headSeq++);
+  }
+
+  // Returns true if inputWindow pushed inputs have not yet been consumed by
+  // the simulator. Only the runner consumes the input queue, so a window
+  // which is not full cannot fill up other than by pushing.
+  bool inputWindowFull() const { return queues.in.size() >= inputWindow; }
+
+  // Yields the driver until the runner has consumed an input of a full input
+  // window. The runner drains the input queue if it fails, so this returns
+  // once any error has been raised, which is then thrown.
+  void waitForInputWindow() {
+    while (inputWindowFull()) {
+      runner->wakeup();
+      std::this_thread::yield();
+    }
+    runner->checkError();
+  }
+
   SimQueuesImpl queues;
   std::unique_ptr<SimRunnerImpl> runner;
+  size_t inputWindow = HLT_INPUT_WINDOW;
+
+  // Sequence numbers of the next pushed input, and of the oldest pushed input
+  // whose output is held by the result ring; see SimResultRing. 'tags' holds
+  // the tag of each input by its slot.
+  uint64_t nextSeq = 0;
+  uint64_t headSeq = 0;
+  std::unique_ptr<uint64_t[]> tags{new uint64_t[HLT_QUEUE_CAPACITY]};
+
+  // Tags and futures of the outputs of the oldest pushed inputs, which were
+  // popped from the result ring since its slots were needed by subsequent
+  // inputs (see claimSlot).
+  std::deque<std::pair<uint64_t, std::future<TOutput>>> spilled;
+  AdaptiveSpin popSpin;
 };
 
 } // namespace hlt
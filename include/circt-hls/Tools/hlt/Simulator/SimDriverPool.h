@@ -0,0 +1,271 @@
+#ifndef CIRCT_TOOLS_HLT_SIMDRIVERPOOL_H
+#define CIRCT_TOOLS_HLT_SIMDRIVERPOOL_H
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "circt-hls/Tools/hlt/Simulator/SimDriver.h"
+
+#ifndef HLT_POLL_US
+// Microseconds between each poll of the simulator instances for an output
+// when popping outputs out of order.
+#define HLT_POLL_US 50
+#endif
+
+//===----------------------------------------------------------------------===//
+// Sim driver pool
+//===----------------------------------------------------------------------===//
+
+namespace circt {
+namespace hlt {
+
+/// Policy for selecting which simulator instance of a SimDriverPool a pushed
+/// input is dispatched to.
+enum class DispatchPolicy {
+  // Dispatch to each instance in turn.
+  RoundRobin,
+  // Dispatch to the instance with the fewest outputs not yet popped.
+  LeastLoaded
+};
+
+/// A SimDriverPool distributes kernel invocations over a set of independent
+/// simulator instances, each with its own model and runner thread. This is
+/// only valid if invocations are independent of each other, i.e. no
+/// invocation depends on state left in the model by a previous invocation.
+/// Outputs are popped in the order that inputs were pushed, regardless of which
+/// instance executed them. The pool exposes the same interface as SimDriver.
+template <typename TInput, typename TOutput, typename Sim>
+class SimDriverPool {
+  using SimDriverImpl = SimDriver<TInput, TOutput, Sim>;
+
+public:
+  /// Creates a pool of 'size' simulator instances. If 'size' is 0, an instance
+  /// is created for each hardware thread. The instances are numbered from
+  /// 'firstInstance' (see SimDriver).
+  SimDriverPool(unsigned size = 0,
+                DispatchPolicy policy = DispatchPolicy::LeastLoaded,
+                unsigned firstInstance = 0)
+      : policy(policy) {
+    if (size == 0)
+      size = std::max(1U, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < size; ++i)
+      drivers.push_back(std::make_unique<SimDriverImpl>(firstInstance + i));
+  }
+
+  /// Sets the input window of each instance (see SimDriver::setInputWindow).
+  void setInputWindow(size_t n) {
+    for (auto &driver : drivers)
+      driver->setInputWindow(n);
+  }
+
+  /// Blocking while the input window of the selected instance is full.
+  void push(const TInput &in) { emplace(in); }
+  void push(TInput &&in) { emplace(std::move(in)); }
+
+  /// Non-blocking. Pushes an input, unless the input window of the selected
+  /// instance is full, in which case false is returned.
+  bool tryPush(const TInput &in) { return tryEmplace(in); }
+  bool tryPush(TInput &&in) { return tryEmplace(std::move(in)); }
+
+  /// Blocking while the input window of the selected instance is full.
+  /// Constructs the input from 'args' in place within the input queue of the
+  /// selected instance.
+  template <typename... Args>
+  void emplace(Args &&...args) {
+    unsigned idx = nextDriver();
+    drivers[idx]->emplace(std::forward<Args>(args)...);
+    order.push_back(idx);
+  }
+
+  /// Non-blocking. Like emplace, but returns false rather than blocking if
+  /// the input window of the selected instance is full. The instance is then
+  /// selected again by the next push.
+  template <typename... Args>
+  bool tryEmplace(Args &&...args) {
+    unsigned prevNext = rrNext;
+    unsigned idx = nextDriver();
+    if (!drivers[idx]->tryEmplace(std::forward<Args>(args)...)) {
+      rrNext = prevNext;
+      return false;
+    }
+    order.push_back(idx);
+    return true;
+  }
+
+  /// Blocking while the input window of the selected instance is full. Like
+  /// emplace, but tags the input with 'tag', which is returned along with its
+  /// output by popTagged.
+  template <typename... Args>
+  void emplaceTagged(uint64_t tag, Args &&...args) {
+    unsigned idx = nextDriver();
+    drivers[idx]->emplaceTagged(tag, std::forward<Args>(args)...);
+    order.push_back(idx);
+  }
+
+  /// Blocking while the input window of the selected instance is full. Like
+  /// emplace, but pushes the input along with the expected output of the call;
+  /// see SimDriver::emplaceExpected.
+  template <typename... Args>
+  void
+  emplaceExpected(std::shared_ptr<const SimExpectation<TOutput>> expected,
+                  Args &&...args) {
+    unsigned idx = nextDriver();
+    drivers[idx]->emplaceExpected(std::move(expected),
+                                  std::forward<Args>(args)...);
+    order.push_back(idx);
+  }
+
+  /// Blocking while the input windows are full. Pushes n inputs with a single
+  /// wakeup of each runner.
+  void pushBatch(const TInput *in, size_t n) {
+    pushBatch(std::vector<TInput>(in, in + n));
+  }
+  void pushBatch(std::vector<TInput> &&in) {
+    std::vector<std::vector<TInput>> batches(drivers.size());
+    for (auto &v : in) {
+      unsigned idx = nextDriver(batches);
+      batches[idx].push_back(std::move(v));
+      order.push_back(idx);
+    }
+    for (unsigned i = 0; i < drivers.size(); ++i)
+      if (!batches[i].empty())
+        drivers[i]->pushBatch(std::move(batches[i]));
+  }
+
+  /// Non-blocking. Returns a future for the output of the oldest pushed input
+  /// whose output has not yet been popped.
+  std::future<TOutput> popAsync() {
+    assert(!order.empty() && "No pushed input to pop an output for");
+    unsigned idx = order.front();
+    order.pop_front();
+    lastDriver = idx;
+    return drivers[idx]->popAsync();
+  }
+
+  /// Non-blocking. Pops the output of the oldest pushed input, if the
+  /// simulator has produced it.
+  std::optional<TOutput> tryPop() {
+    if (order.empty())
+      return std::nullopt;
+    auto out = drivers[order.front()]->tryPop();
+    if (out) {
+      lastDriver = order.front();
+      order.pop_front();
+    }
+    return out;
+  }
+
+  /// Blocking. Pops the output of any pushed input which an instance has
+  /// produced, along with the tag of the input. Unlike pop, outputs are thus
+  /// not popped in the order that their inputs were pushed, and one slow
+  /// instance does not hold back the outputs of the others.
+  std::pair<uint64_t, TOutput> popTagged() {
+    assert(!order.empty() && "No pushed input to pop an output for");
+    while (true) {
+      for (unsigned i = 0; i < drivers.size(); ++i) {
+        auto out = drivers[i]->tryPopTagged();
+        if (!out)
+          continue;
+        // The output is that of the oldest input pushed to the instance.
+        order.erase(std::find(order.begin(), order.end(), i));
+        lastDriver = i;
+        return std::move(*out);
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(HLT_POLL_US));
+    }
+  }
+
+  /// Blocking
+  TOutput pop() {
+    assert(!order.empty() && "No pushed input to pop an output for");
+    unsigned idx = order.front();
+    order.pop_front();
+    lastDriver = idx;
+    return drivers[idx]->pop();
+  }
+
+  /// Blocking. Pops the outputs of the n oldest pushed inputs.
+  void popBatch(TOutput *out, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      out[i] = pop();
+  }
+
+  /// Blocking. Resets each simulator instance in place; see
+  /// SimDriver::reset.
+  void reset() {
+    assert(order.empty() && "Resetting with pending outputs");
+    for (auto &driver : drivers)
+      driver->reset();
+  }
+
+  /// Blocking. Suspends the runner of each simulator instance; see
+  /// SimDriver::suspend.
+  void suspend() {
+    for (auto &driver : drivers)
+      driver->suspend();
+  }
+
+  /// Resumes the runner of each simulator instance; see SimDriver::resume.
+  void resume(bool forked) {
+    for (auto &driver : drivers)
+      driver->resume(forked);
+  }
+
+  unsigned size() const { return drivers.size(); }
+
+  /// Returns the simulated cycles of the last popped call, on the instance
+  /// which served it.
+  uint64_t lastCallCycles() const {
+    return drivers[lastDriver]->lastCallCycles();
+  }
+
+private:
+  // Returns the index of the driver that the next input should be dispatched
+  // to. 'queued' contains inputs which are yet to be pushed to each driver.
+  unsigned nextDriver(const std::vector<std::vector<TInput>> &queued = {}) {
+    switch (policy) {
+    case DispatchPolicy::RoundRobin: {
+      unsigned idx = rrNext;
+      rrNext = (rrNext + 1) % drivers.size();
+      return idx;
+    }
+    case DispatchPolicy::LeastLoaded: {
+      auto load = [&](unsigned i) {
+        return drivers[i]->numPending() +
+               (queued.empty() ? 0 : queued[i].size());
+      };
+      unsigned best = 0;
+      for (unsigned i = 1; i < drivers.size(); ++i)
+        if (load(i) < load(best))
+          best = i;
+      return best;
+    }
+    }
+    assert(false && "Unhandled dispatch policy");
+    return 0;
+  }
+
+  DispatchPolicy policy;
+  unsigned rrNext = 0;
+  std::vector<std::unique_ptr<SimDriverImpl>> drivers;
+
+  // Indices of the drivers that each pushed input was dispatched to, in the
+  // order the inputs were pushed.
+  std::deque<unsigned> order;
+
+  // Index of the driver of the last popped output.
+  unsigned lastDriver = 0;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_SIMDRIVERPOOL_H
@@ -0,0 +1,170 @@
+#ifndef CIRCT_TOOLS_HLT_SIMFORK_H
+#define CIRCT_TOOLS_HLT_SIMFORK_H
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Fork server of a testbench, for the many short runs of the same model which
+// fuzzing (see FuzzInput.h) and sweeps make. If HLT_FORK_JOBS is set, the
+// testbench sets its simulators up once, when it reaches the fork point (its
+// first draw of a fuzzer input), and then serves jobs, each by forking a child
+// which runs the remainder of the testbench. The child inherits the models and
+// the harness in their post-reset state through copy-on-write, rather than
+// constructing and resetting models of its own; the simulators need not
+// support checkpoints.
+//
+// Jobs are read from stdin, one per line, as NAME=VALUE environment variables
+// which the child is run with, such as the HLT_FUZZ_INPUT of the job.
+// Variables which the simulators read when they are set up keep the values of
+// the server. For each job, the server writes the result of its child to
+// stdout:
+//   HLT_FORK_JOB <status> <bytes>\n<output>
+// where 'status' is the exit code of the child, or 128 plus the signal which
+// killed it, and 'output' holds the <bytes> bytes which the child wrote to
+// stdout and stderr. Jobs are run one at a time, and the server exits at the
+// end of stdin.
+//
+// Only the runner threads of the simulators (see SimRunner::suspend) may be
+// running when the fork point is reached. Traces of the models are shared by
+// all children, and should be disabled.
+
+namespace circt {
+namespace hlt {
+
+class SimForkServer {
+public:
+  /// Returns the fork server of the process.
+  static SimForkServer &get() {
+    static SimForkServer server;
+    return server;
+  }
+
+  /// Registers a simulator of the testbench: 'suspend' sets it up and
+  /// suspends its runners before the server forks, and 'resume' resumes them
+  /// within each child (see SimDriver::suspend). Returns true, such that
+  /// wrappers can register their simulator when they are loaded.
+  bool addTarget(std::function<void()> suspend, std::function<void()> resume) {
+    targets.push_back({std::move(suspend), std::move(resume)});
+    return true;
+  }
+
+  /// The fork point of the testbench. Returns at once unless HLT_FORK_JOBS is
+  /// set, in which case this returns within the child of each job only; the
+  /// server exits once all jobs have been served. Only the first call forks.
+  void forkPoint() {
+    if (reached || !std::getenv("HLT_FORK_JOBS"))
+      return;
+    reached = true;
+    for (auto &target : targets)
+      target.suspend();
+
+    std::string job;
+    while (std::getline(std::cin, job)) {
+      if (job.find_first_not_of(" \t") == std::string::npos)
+        continue;
+      // The buffered output of the server would otherwise be written by the
+      // child as well.
+      std::cout.flush();
+      std::fflush(nullptr);
+      int fds[2];
+      if (pipe(fds) != 0)
+        fail("create the output pipe of");
+      pid_t pid = fork();
+      if (pid < 0)
+        fail("fork");
+      if (pid == 0) {
+        runChild(job, fds);
+        return;
+      }
+      close(fds[1]);
+      reportJob(pid, fds[0]);
+    }
+    std::cout.flush();
+    std::_Exit(0);
+  }
+
+private:
+  struct Target {
+    std::function<void()> suspend;
+    std::function<void()> resume;
+  };
+
+  [[noreturn]] static void fail(const char *what) {
+    std::cerr << "Fork server: failed to " << what
+              << " a job: " << std::strerror(errno) << "\n";
+    std::abort();
+  }
+
+  // Prepares the child of 'job' to run the remainder of the testbench, with
+  // its output redirected to the pipe 'fds'.
+  void runChild(const std::string &job, int fds[2]) {
+    close(fds[0]);
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[1]);
+    // The remaining jobs are the server's.
+    int null = open("/dev/null", O_RDONLY);
+    if (null >= 0) {
+      dup2(null, STDIN_FILENO);
+      close(null);
+    }
+
+    std::istringstream is(job);
+    std::string var;
+    while (is >> var) {
+      size_t eq = var.find('=');
+      if (eq == 0 || eq == std::string::npos) {
+        std::cerr << "Fork server: expected NAME=VALUE in job, got '" << var
+                  << "'\n";
+        std::_Exit(1);
+      }
+      setenv(var.substr(0, eq).c_str(), var.substr(eq + 1).c_str(), 1);
+    }
+    unsetenv("HLT_FORK_JOBS");
+    for (auto &target : targets)
+      target.resume();
+  }
+
+  // Collects the output of the child 'pid' from the pipe 'fd' until the child
+  // exits, and writes the result of its job.
+  static void reportJob(pid_t pid, int fd) {
+    std::string output;
+    char buf[1 << 12];
+    while (true) {
+      ssize_t n = read(fd, buf, sizeof(buf));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      output.append(buf, n);
+    }
+    close(fd);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+      ;
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    std::cout << "HLT_FORK_JOB " << code << " " << output.size() << "\n";
+    std::cout.write(output.data(), output.size());
+    std::cout.flush();
+  }
+
+  std::vector<Target> targets;
+  bool reached = false;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_SIMFORK_H
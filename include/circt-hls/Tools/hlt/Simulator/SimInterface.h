@@ -1,16 +1,59 @@
 #ifndef CIRCT_TOOLS_HLT_SIMINTERFACE_H
 #define CIRCT_TOOLS_HLT_SIMINTERFACE_H
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <condition_variable>
+#include <cstdint>
+#include <exception>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "circt-hls/Tools/hlt/Simulator/SimProfile.h"
+
+#ifndef HLT_QUEUE_CAPACITY
+// Capacity of each of the queues between the simulator driver and the runner
+// thread. Must be a power of two.
+#define HLT_QUEUE_CAPACITY 1024
+#endif
+
+#ifndef HLT_SPIN_ITERATIONS
+// Maximum number of iterations which a thread spins for, waiting on another
+// thread of the simulator (see AdaptiveSpin), before it parks. A value of 0
+// parks immediately.
+#define HLT_SPIN_ITERATIONS 4096
+#endif
+
+#ifndef HLT_DEBUG_SERVER
+// Set to 1 to serve the signals of the simulation to a debug client; see
+// SimDebugServer. Verilated models must be verilated with --public-flat-rw for
+// their internal signals to be visible.
+#define HLT_DEBUG_SERVER 0
+#endif
+
+#ifndef HLT_STREAM_CHECK
+// Set to 1 to check the output tokens and memory stores of calls which are
+// pushed along with their expected outputs as they happen, rather than once
+// their outputs are popped, such that the simulation stops at the first
+// mismatch; see SimExpectation.
+#define HLT_STREAM_CHECK 0
+#endif
 
 namespace circt {
 namespace hlt {
 
+class SimDebugServer;
+
 #ifndef NDEBUG
 #define debugOut std::cout
 #else
@@ -22,18 +65,68 @@ struct is_instance_of_template : std::false_type {};
 template <template <typename...> class Tmpl, typename... Args>
 struct is_instance_of_template<Tmpl<Args...>, Tmpl> : std::true_type {};
 
+/// Hints to the CPU that the calling thread is spinning.
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+/// Spins a waiting thread before it parks. Short waits, such as those of
+/// calls which return within a few hundred cycles, are thereby served without
+/// a context switch. The number of iterations adapts to the waits of the
+/// waiter: it doubles, up to HLT_SPIN_ITERATIONS, whenever a spin succeeds,
+/// and halves whenever it fails, such that waiters whose waits are long mostly
+/// park. Waiters never spin on a single hardware thread, on which the thread
+/// that they wait on cannot run while they spin.
+class AdaptiveSpin {
+public:
+  AdaptiveSpin()
+      : maxIterations(std::thread::hardware_concurrency() > 1
+                          ? HLT_SPIN_ITERATIONS
+                          : 0),
+        minIterations(std::min(16U, maxIterations)),
+        iterations(maxIterations) {}
+
+  /// Spins until 'cond' holds. Returns false if the spin gave up, in which
+  /// case the waiter should park.
+  template <typename Cond>
+  bool spinUntil(Cond cond) {
+    for (unsigned i = 0; i < iterations; ++i) {
+      if (cond()) {
+        iterations = std::min(iterations * 2, maxIterations);
+        return true;
+      }
+      cpuRelax();
+    }
+    iterations = std::max(iterations / 2, minIterations);
+    return cond();
+  }
+
+private:
+  unsigned maxIterations;
+  unsigned minIterations;
+  unsigned iterations;
+};
+
 /// A simple atomic queue implementation.
 template <typename T>
 struct AtomicQueue {
-  void push(const T &v) {
+  void push(const T &v) { emplace(v); }
+  void push(T &&v) { emplace(std::move(v)); }
+
+  template <typename... Args>
+  void emplace(Args &&...args) {
     std::lock_guard<std::mutex> l(lock);
-    list.push_back(v);
+    list.emplace_back(std::forward<Args>(args)...);
   }
 
   T pop() {
     std::lock_guard<std::mutex> l(lock);
     assert(!list.empty() && "Trying to pop an empty queue");
-    auto v = list.front();
+    auto v = std::move(list.front());
     list.pop_front();
     return v;
   }
@@ -50,21 +143,282 @@ struct AtomicQueue {
   std::mutex lock;
 };
 
+/// A bounded, lock-free single-producer/single-consumer ring buffer.
+/// push/tryPush may only be called from a single producer thread, and
+/// pop/tryPop from a single consumer thread. size and empty may be called from
+/// either side. The producer- and consumer-owned indices are kept on separate
+/// cache lines to avoid false sharing between the two threads.
+template <typename T, size_t Capacity = HLT_QUEUE_CAPACITY>
+class SPSCQueue {
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+  static constexpr size_t kMask = Capacity - 1;
+  static constexpr size_t kCacheLineSize = 64;
+  using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+public:
+  SPSCQueue() : buffer(new Storage[Capacity]) {}
+  SPSCQueue(const SPSCQueue &) = delete;
+  SPSCQueue &operator=(const SPSCQueue &) = delete;
+  ~SPSCQueue() {
+    for (size_t i = head.load(), e = tail.load(); i != e; ++i)
+      slotAt(i)->~T();
+  }
+
+  /// Pushes a value onto the queue. Returns false if the queue is full.
+  bool tryPush(const T &v) { return tryEmplace(v); }
+  bool tryPush(T &&v) { return tryEmplace(std::move(v)); }
+
+  /// Pushes a value onto the queue, yielding the producer until there is
+  /// space available.
+  void push(const T &v) {
+    while (!tryPush(v))
+      std::this_thread::yield();
+  }
+  void push(T &&v) {
+    while (!tryPush(std::move(v)))
+      std::this_thread::yield();
+  }
+
+  /// Pops a value from the queue into v. Returns false if the queue is empty.
+  bool tryPop(T &v) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tailCache) {
+      tailCache = tail.load(std::memory_order_acquire);
+      if (h == tailCache)
+        return false;
+    }
+    T *slot = slotAt(h);
+    v = std::move(*slot);
+    slot->~T();
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  T pop() {
+    T v;
+    bool popped = tryPop(v);
+    assert(popped && "Trying to pop an empty queue");
+    (void)popped;
+    return v;
+  }
+
+  unsigned size() const {
+    // Load head before tail; head may never pass tail, so this can never
+    // underflow.
+    size_t h = head.load(std::memory_order_acquire);
+    return tail.load(std::memory_order_acquire) - h;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  static constexpr size_t capacity() { return Capacity; }
+
+private:
+  template <typename TArg>
+  bool tryEmplace(TArg &&v) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - headCache == Capacity) {
+      headCache = head.load(std::memory_order_acquire);
+      if (t - headCache == Capacity)
+        return false;
+    }
+    new (&buffer[t & kMask]) T(std::forward<TArg>(v));
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  T *slotAt(size_t idx) {
+    return reinterpret_cast<T *>(&buffer[idx & kMask]);
+  }
+
+  std::unique_ptr<Storage[]> buffer;
+
+  // Consumer-owned state.
+  alignas(kCacheLineSize) std::atomic<size_t> head{0};
+  size_t tailCache = 0;
+
+  // Producer-owned state.
+  alignas(kCacheLineSize) std::atomic<size_t> tail{0};
+  size_t headCache = 0;
+};
+
+/// A fixed ring of result slots, through which the runner returns the output
+/// of each call to the driver without any allocation per call. The slot of a
+/// call is indexed by the sequence number of its input, which the driver and
+/// the runner both count in the order that the inputs are pushed. The driver
+/// claims the slot of a call before pushing its input, and frees it by taking
+/// the output, or by attaching a promise which the runner fulfils instead.
+/// deliver and fail may only be called from the runner, and all other
+/// functions from the driver.
+template <typename T, size_t Capacity = HLT_QUEUE_CAPACITY>
+class SimResultRing {
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+  static constexpr size_t kMask = Capacity - 1;
+
+  enum State : uint8_t { Free, Pending, Ready, Attached };
+
+  struct Slot {
+    std::atomic<uint8_t> state{Free};
+    std::optional<T> value;
+    std::exception_ptr error;
+    std::optional<std::promise<T>> waiter;
+  };
+
+public:
+  SimResultRing() : slots(new Slot[Capacity]) {}
+  SimResultRing(const SimResultRing &) = delete;
+  SimResultRing &operator=(const SimResultRing &) = delete;
+
+  /// Returns true if the slot of call 'seq' may be claimed, i.e. if the output
+  /// of the call which last held the slot has been taken.
+  bool isFree(uint64_t seq) const {
+    return slotAt(seq).state.load(std::memory_order_acquire) == Free;
+  }
+
+  /// Claims the free slot of call 'seq'. The input of the call is pushed to
+  /// the runner afterwards, which publishes the claim.
+  void claim(uint64_t seq) {
+    assert(isFree(seq) && "Claiming a slot which is in use");
+    slotAt(seq).state.store(Pending, std::memory_order_relaxed);
+  }
+
+  /// Returns true if the runner has returned the output of call 'seq'.
+  bool isReady(uint64_t seq) const {
+    return slotAt(seq).state.load(std::memory_order_acquire) == Ready;
+  }
+
+  /// Takes the returned output of call 'seq' and frees its slot. Rethrows the
+  /// error which the call failed with, if any.
+  T take(uint64_t seq) {
+    Slot &slot = slotAt(seq);
+    assert(isReady(seq) && "Taking an output which was not returned");
+    std::exception_ptr error = std::move(slot.error);
+    std::optional<T> value = std::move(slot.value);
+    slot.error = nullptr;
+    slot.value.reset();
+    slot.state.store(Free, std::memory_order_release);
+    if (error)
+      std::rethrow_exception(error);
+    return std::move(*value);
+  }
+
+  /// Returns a future of the output of call 'seq', whose promise the runner
+  /// fulfils as it returns the output, unless it already has. The slot is
+  /// freed once the promise is fulfilled. Unlike the slot, the shared state of
+  /// the future is allocated.
+  std::future<T> attach(uint64_t seq) {
+    Slot &slot = slotAt(seq);
+    std::future<T> f = slot.waiter.emplace().get_future();
+    uint8_t expected = Pending;
+    if (!slot.state.compare_exchange_strong(expected, Attached,
+                                            std::memory_order_acq_rel))
+      fulfil(slot);
+    return f;
+  }
+
+  /// Returns the output of call 'seq'.
+  void deliver(uint64_t seq, T &&value) {
+    Slot &slot = slotAt(seq);
+    slot.value.emplace(std::move(value));
+    publish(slot);
+  }
+
+  /// Fails call 'seq' with 'error'.
+  void fail(uint64_t seq, std::exception_ptr error) {
+    Slot &slot = slotAt(seq);
+    slot.error = error;
+    publish(slot);
+  }
+
+  static constexpr size_t capacity() { return Capacity; }
+
+private:
+  // Marks the output of 'slot' as returned, and fulfils the promise of the
+  // driver if one was attached before.
+  void publish(Slot &slot) {
+    if (slot.state.exchange(Ready, std::memory_order_acq_rel) == Attached)
+      fulfil(slot);
+  }
+
+  // Fulfils the attached promise of the returned output of 'slot', and frees
+  // the slot.
+  void fulfil(Slot &slot) {
+    if (slot.error)
+      slot.waiter->set_exception(slot.error);
+    else
+      slot.waiter->set_value(std::move(*slot.value));
+    slot.error = nullptr;
+    slot.value.reset();
+    slot.waiter.reset();
+    slot.state.store(Free, std::memory_order_release);
+  }
+
+  Slot &slotAt(uint64_t seq) const { return slots[seq & kMask]; }
+
+  std::unique_ptr<Slot[]> slots;
+};
+
+/// The expected outputs of a call, which simulators built with
+/// HLT_STREAM_CHECK check the output tokens of the call against as the model
+/// transacts them. 'memories' holds, for each element of the input which is a
+/// memory, the contents which the memory is expected to hold after the call,
+/// as a contiguous array of its elements, or null. Stores are only checked if
+/// HLT_STREAM_CHECK_STORES is set at runtime, since each stored value is
+/// expected to be the final value of its element; see HandshakeSimInterface.
+template <typename TOutput>
+struct SimExpectation {
+  TOutput output;
+  std::vector<const void *> memories;
+};
+
+/// The queues between a simulator driver and its runner thread.
 template <typename TInput, typename TOutput>
 struct SimQueues {
-  AtomicQueue<TInput> in;
-  AtomicQueue<TOutput> out;
-  AtomicQueue<std::shared_ptr<std::condition_variable>> outReq;
+  /// An input pushed by the driver, along with the expected output of the
+  /// call, if any.
+  struct InputRequest {
+    TInput input;
+    std::shared_ptr<const SimExpectation<TOutput>> expected;
+  };
+
+  // Driver -> runner.
+  SPSCQueue<InputRequest> in;
+  // Runner -> driver. The runner returns the output of each input in the
+  // order that the inputs were pushed.
+  SimResultRing<TOutput> out;
 };
 
 using KeepAliveFunction = std::function<void()>;
 
+/// Writes the binary representation of 'value' to a checkpoint stream.
+template <typename T>
+void writeState(std::ostream &os, const T &value) {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Only trivially copyable state can be checkpointed");
+  os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/// Reads a value written by writeState from a checkpoint stream.
+template <typename T>
+void readState(std::istream &is, T &value) {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Only trivially copyable state can be checkpointed");
+  is.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
 /// Base class for simulator-related classes.
 class SimBase {
 public:
   /// Dump the state of the object.
   virtual void dump(std::ostream &os) const {}
 
+  /// Save and restore any state of the object which lives outside of the
+  /// simulated model, such that a simulation can be resumed from a checkpoint.
+  virtual void saveState(std::ostream &os) const {}
+  virtual void restoreState(std::istream &is) {}
+
   virtual void setKeepAliveCallback(const KeepAliveFunction &f) {
     assert(keepAlive == nullptr && "keepAlive callback already set!");
     keepAlive = f;
@@ -77,7 +431,7 @@ public:
   KeepAliveFunction keepAlive;
 };
 
-std::ostream &operator<<(std::ostream &out, const SimBase &b) {
+inline std::ostream &operator<<(std::ostream &out, const SimBase &b) {
   b.dump(out);
   return out;
 }
@@ -95,6 +449,15 @@ struct SimulatorPort : SimBase {
   // be seen as the rising edge evaluation. Returns true if the port performed a
   // state change which may require the simulation to update in relation to it.
   virtual bool eval(bool firstInStep) = 0;
+
+  // Returns true if the port holds work in flight which completes in a later
+  // cycle, without any of its signals changing until then (e.g. a pending
+  // memory load).
+  virtual bool busy() const { return false; }
+
+  // Writes each handshake port of this port which is valid but not ready, one
+  // per line.
+  virtual void dumpStalled(std::ostream &os) const {}
 };
 
 // A SimulatorOutPort is the base class of a logical software input port.
@@ -119,6 +482,11 @@ public:
 
   /// Push an input to the simulator.
   virtual void pushInput(const TInput &input) = 0;
+  // Simulators which buffer their input may override this to take ownership
+  // of the input instead of copying it.
+  virtual void pushInput(TInput &&input) {
+    pushInput(static_cast<const TInput &>(input));
+  }
 
   /// Pop an output from the simulator.
   virtual TOutput popOutput() = 0;
@@ -129,9 +497,57 @@ public:
   /// The finish function will be called before deletion of the simulator.
   virtual void finish() = 0;
 
+  /// The idle function will be called whenever the simulator has no more work
+  /// to do and its runner is about to sleep. Simulators may use this to write
+  /// out any collected state.
+  virtual void idle() {}
+
+  /// Re-initializes the model and any simulator state for a new, independent
+  /// run, without recreating the simulator. Must only be called when no inputs
+  /// are in flight.
+  virtual void resetInPlace() {
+    assert(false && "Simulator does not support resetting in place");
+  }
+
+  /// Returns true if the simulator has deadlocked, i.e. no number of further
+  /// steps will change its state unless a new input is pushed. Simulators
+  /// which do not detect deadlocks always return false.
+  virtual bool deadlocked() { return false; }
+
+  /// Writes a diagnosis of a deadlock of the simulator. By default, this
+  /// dumps the state of the simulator.
+  virtual void dumpDeadlock(std::ostream &os) const { dump(os); }
+
+  /// Sets the expected output of the next pushed input, or none if 'expected'
+  /// is null; see HLT_STREAM_CHECK. Simulators which don't check their outputs
+  /// as they are produced ignore this.
+  virtual void
+  expect(std::shared_ptr<const SimExpectation<TOutput>> expected) {}
+
+  /// Returns true if the simulator produced an output token or a store which
+  /// does not match the expected output of its call.
+  virtual bool mismatched() { return false; }
+
+  /// Writes a description of the first mismatch of the simulator.
+  virtual void dumpMismatch(std::ostream &os) const {}
+
   /// Returns the current timestep of the simulator.
   virtual uint64_t time() = 0;
 
+  /// Writes a checkpoint of the complete simulation state to 'path', or
+  /// restores the simulation state from it. Returns false if the simulator
+  /// does not support checkpointing.
+  virtual bool saveCheckpoint(const std::string &path) { return false; }
+  virtual bool restoreCheckpoint(const std::string &path) { return false; }
+
+  /// Registers the signals of the model which a debug server serves to its
+  /// client; see HLT_DEBUG_SERVER.
+  virtual void addDebugSignals(SimDebugServer &server) {}
+
+  /// Sets the index of this simulator instance. Instances other than 0 should
+  /// use this to disambiguate any files they write.
+  void setInstance(unsigned idx) { instance = idx; }
+
   template <typename T, typename... Args>
   T *addInputPort(Args... args) {
     static_assert(std::is_base_of<SimulatorInPort, T>::value,
@@ -158,6 +574,9 @@ protected:
   // There should be exactly as many outPorts as the software interface of this
   // simulator has output arguments.
   std::vector<std::unique_ptr<SimulatorOutPort>> outPorts;
+
+  // Index of this simulator instance within the process.
+  unsigned instance = 0;
 };
 
 } // namespace hlt
@@ -0,0 +1,305 @@
+#ifndef CIRCT_TOOLS_HLT_SIMLOG_H
+#define CIRCT_TOOLS_HLT_SIMLOG_H
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifndef HLT_LOG_BUFFER_SIZE
+// Size in bytes of the in-memory buffer of each simulator event log. The log
+// is written to disk when the buffer is full, and when the log is closed.
+#define HLT_LOG_BUFFER_SIZE (1 << 16)
+#endif
+
+//===----------------------------------------------------------------------===//
+// Simulator event log
+//===----------------------------------------------------------------------===//
+//
+// The event log is a binary file in host byte order, laid out as:
+//   header:  char magic[4] = "HLTL", uint32_t version
+//   records: SimLogRecord, up to and including a record of type End, whose
+//            'id' is the number of calls 'n'
+//   footer:  uint64_t latency[n], SimLogSummary
+// The summary is at a fixed offset from the end of the file, such that readers
+// can find the cycle count without reading the records. eval/hltlog.py reads
+// these logs.
+//
+//===----------------------------------------------------------------------===//
+
+namespace circt {
+namespace hlt {
+
+/// Type of each event in a simulator event log.
+enum class SimLogEvent : uint32_t {
+  // An input was pushed to the simulator. 'id' is the index of the call.
+  PushInput = 0,
+  // An output was popped from the simulator. 'id' is the index of the call.
+  PopOutput = 1,
+  // An output was handed to the host. 'id' is the index of the call.
+  OutToWaiter = 2,
+  // A checkpoint of the simulation state was written.
+  Checkpoint = 3,
+  // The simulation state was restored from a checkpoint.
+  Restored = 4,
+  // The simulator was reset in place.
+  Reset = 5,
+  // The runner timed out.
+  TimedOut = 6,
+  // The runner finished.
+  Finished = 7,
+  // Last record of the log. 'id' is the number of calls in the footer.
+  End = 8,
+  // The input of a call was taken from the host, and is transferred to the
+  // simulator over the host link (see HostLink.h). 'id' is the index of the
+  // call.
+  TransferInput = 9,
+  // The simulation reached its cycle limit (see HLT_MAX_CYCLES), and the
+  // process exits.
+  CycleLimit = 10
+};
+
+struct SimLogRecord {
+  uint64_t cycle;
+  uint32_t event;
+  uint32_t id;
+};
+static_assert(sizeof(SimLogRecord) == 16, "Unexpected log record padding");
+
+struct SimLogSummary {
+  // The cycle at which the output of the last call was handed to the host.
+  uint64_t cycles;
+  uint32_t numCalls;
+  char magic[4];
+};
+static_assert(sizeof(SimLogSummary) == 16, "Unexpected log summary padding");
+
+static constexpr char kSimLogMagic[4] = {'H', 'L', 'T', 'L'};
+static constexpr char kSimLogSummaryMagic[4] = {'H', 'L', 'T', 'F'};
+static constexpr uint32_t kSimLogVersion = 1;
+
+/// Summary statistics of a set of cycle counts.
+struct SimCycleStats {
+  uint64_t min = 0;
+  uint64_t max = 0;
+  uint64_t p99 = 0;
+  double mean = 0;
+
+  static SimCycleStats get(std::vector<uint64_t> samples) {
+    SimCycleStats stats;
+    if (samples.empty())
+      return stats;
+    std::sort(samples.begin(), samples.end());
+    stats.min = samples.front();
+    stats.max = samples.back();
+    // Nearest-rank percentile.
+    stats.p99 = samples[(samples.size() * 99 + 99) / 100 - 1];
+    for (uint64_t sample : samples)
+      stats.mean += sample;
+    stats.mean /= samples.size();
+    return stats;
+  }
+
+  void dumpJSON(std::ostream &os) const {
+    os << "{\"min\": " << min << ", \"mean\": " << mean
+       << ", \"p99\": " << p99 << ", \"max\": " << max << "}";
+  }
+};
+
+/// A buffered writer of a simulator event log. Records are only written to
+/// disk when the buffer fills up, and the footer is written when the log is
+/// closed. Logs which are still open when the process exits are closed at
+/// exit, since simulator drivers are generally never destroyed.
+/// If 'statsPath' is set, the latency and initiation interval statistics of
+/// the logged calls are written to it as JSON when the log is closed.
+class SimLog {
+public:
+  SimLog(const std::string &path, const std::string &statsPath = "")
+      : buffer(HLT_LOG_BUFFER_SIZE), statsPath(statsPath) {
+    os.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    os.open(path, std::ios::binary | std::ios::trunc);
+    os.write(kSimLogMagic, sizeof(kSimLogMagic));
+    os.write(reinterpret_cast<const char *>(&kSimLogVersion),
+             sizeof(kSimLogVersion));
+    registerLog(this);
+  }
+
+  ~SimLog() {
+    close();
+    unregisterLog(this);
+  }
+
+  /// Appends an event to the log. Push and pop events of each call are used
+  /// to compute the latency of the call.
+  void write(uint64_t cycle, SimLogEvent event, uint32_t id = 0) {
+    std::lock_guard<std::mutex> l(lock);
+    if (closed)
+      return;
+    switch (event) {
+    case SimLogEvent::PushInput:
+      assert(id == pushCycles.size() && "Calls must be pushed in order");
+      if (lastPushCycle)
+        intervals.push_back(cycle - *lastPushCycle);
+      lastPushCycle = cycle;
+      pushCycles.push_back(cycle);
+      break;
+    case SimLogEvent::PopOutput:
+      assert(id == latencies.size() && "Calls must be popped in order");
+      latencies.push_back(cycle - pushCycles[id]);
+      break;
+    case SimLogEvent::TransferInput:
+      assert(id == transferCycles.size() &&
+             "Calls must be transferred in order");
+      transferCycles.push_back(cycle);
+      break;
+    case SimLogEvent::OutToWaiter:
+      lastOutputCycle = cycle;
+      // The cycles of a call on the host link are those before it was pushed,
+      // and after it was popped.
+      if (id < transferCycles.size()) {
+        uint64_t popCycle = pushCycles[id] + latencies[id];
+        transfers.push_back(pushCycles[id] - transferCycles[id] + cycle -
+                            popCycle);
+        endToEnd.push_back(cycle - transferCycles[id]);
+      }
+      break;
+    case SimLogEvent::Reset:
+      // Calls on either side of a reset are not issued back to back.
+      lastPushCycle = std::nullopt;
+      break;
+    default:
+      break;
+    }
+    writeRecord(cycle, event, id);
+  }
+
+  /// Writes the footer of the log and closes it. Any subsequent events are
+  /// dropped.
+  void close() {
+    std::lock_guard<std::mutex> l(lock);
+    if (closed)
+      return;
+    closed = true;
+    uint32_t numCalls = latencies.size();
+    writeRecord(lastOutputCycle, SimLogEvent::End, numCalls);
+    os.write(reinterpret_cast<const char *>(latencies.data()),
+             latencies.size() * sizeof(uint64_t));
+    SimLogSummary summary{lastOutputCycle, numCalls, {}};
+    std::memcpy(summary.magic, kSimLogSummaryMagic, sizeof(summary.magic));
+    os.write(reinterpret_cast<const char *>(&summary), sizeof(summary));
+    os.close();
+    if (!statsPath.empty())
+      dumpCallStats();
+  }
+
+  /// Writes the buffered records to disk.
+  void flush() {
+    std::lock_guard<std::mutex> l(lock);
+    if (!closed)
+      os.flush();
+  }
+
+  /// Closes the log without writing its footer or statistics. A process
+  /// forked from the simulator (see SimFork.h) discards the log which it
+  /// shares with its parent, once flushed, and opens one of its own.
+  void discard() {
+    std::lock_guard<std::mutex> l(lock);
+    closed = true;
+    os.close();
+  }
+
+  /// Closes all open logs of the process, such as before the process exits
+  /// without running its exit handlers.
+  static void closeAll() {
+    std::lock_guard<std::mutex> l(registryLock());
+    for (SimLog *log : registry())
+      log->close();
+  }
+
+private:
+  // Writes the number of calls, and the statistics of their latency and of
+  // the initiation interval between consecutive calls, to 'statsPath'.
+  void dumpCallStats() {
+    std::ofstream stats(statsPath);
+    stats << "{\"cycles\": " << lastOutputCycle
+          << ", \"calls\": " << latencies.size() << ", \"latency\": ";
+    SimCycleStats::get(latencies).dumpJSON(stats);
+    stats << ", \"ii\": ";
+    SimCycleStats::get(intervals).dumpJSON(stats);
+    // The latency covers the computation of each call, which the cycles of
+    // its transfers over the host link add to, if the link is modelled.
+    if (!transferCycles.empty()) {
+      stats << ", \"transfer\": ";
+      SimCycleStats::get(transfers).dumpJSON(stats);
+      stats << ", \"endToEnd\": ";
+      SimCycleStats::get(endToEnd).dumpJSON(stats);
+    }
+    stats << "}\n";
+  }
+
+  void writeRecord(uint64_t cycle, SimLogEvent event, uint32_t id) {
+    SimLogRecord record{cycle, static_cast<uint32_t>(event), id};
+    os.write(reinterpret_cast<const char *>(&record), sizeof(record));
+  }
+
+  // Registry of the open logs of the process, which are closed at exit.
+  static std::mutex &registryLock() {
+    static std::mutex l;
+    return l;
+  }
+  static std::set<SimLog *> &registry() {
+    static std::set<SimLog *> logs;
+    return logs;
+  }
+  static void registerLog(SimLog *log) {
+    // The registry is constructed before the exit handler is registered, so
+    // it outlives the handler.
+    static bool registered =
+        (registryLock(), registry(), std::atexit(closeAll), true);
+    (void)registered;
+    std::lock_guard<std::mutex> l(registryLock());
+    registry().insert(log);
+  }
+  static void unregisterLog(SimLog *log) {
+    std::lock_guard<std::mutex> l(registryLock());
+    registry().erase(log);
+  }
+
+  std::mutex lock;
+  std::vector<char> buffer;
+  std::ofstream os;
+  std::string statsPath;
+  bool closed = false;
+
+  // Cycle at which each call was pushed, and the latency of each call which
+  // has been popped, indexed by call.
+  std::vector<uint64_t> pushCycles;
+  std::vector<uint64_t> latencies;
+  uint64_t lastOutputCycle = 0;
+
+  // Cycles between each pair of consecutively pushed calls.
+  std::vector<uint64_t> intervals;
+  std::optional<uint64_t> lastPushCycle;
+
+  // Cycle at which the input of each call was taken from the host, if the
+  // host link is modelled. For each returned call, the cycles which it spent
+  // on the link, and the cycles from when its input was taken from the host
+  // until its output was returned.
+  std::vector<uint64_t> transferCycles;
+  std::vector<uint64_t> transfers;
+  std::vector<uint64_t> endToEnd;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_SIMLOG_H
@@ -0,0 +1,255 @@
+#ifndef CIRCT_TOOLS_HLT_SIMPERFCOUNTERS_H
+#define CIRCT_TOOLS_HLT_SIMPERFCOUNTERS_H
+
+#ifndef HLT_PERF_COUNTERS
+// Set to 1 to count the hardware events (cycles, instructions, cache misses
+// and branch misses) which the host spends in each component of a step of a
+// verilated simulator: the model, the memory interfaces and the rest of the
+// harness. The counts are written to perf_counters.json next to the simulator
+// log, and printed when the simulator finishes. Requires Linux perf events.
+#define HLT_PERF_COUNTERS 0
+#endif
+
+// Counts are exclusive: the events of a component exclude those of the
+// components which it calls, e.g. the harness excludes the evaluations of the
+// model within its convergence loop. Each scope reads the counters of its
+// thread on entry and exit, and each read is a system call, so the counts
+// only break down the host cost; they do not measure the unprofiled
+// simulator. Counting per thread keeps the counts of a simulator correct when
+// its runner moves between the workers of the scheduler (see SimScheduler.h).
+
+#if HLT_PERF_COUNTERS
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace circt {
+namespace hlt {
+
+/// A component of the host cost of a simulator step.
+enum class SimPerfComponent { Harness = 0, Model = 1, Memory = 2 };
+static constexpr unsigned kNumPerfComponents = 3;
+static constexpr const char *kPerfComponentNames[kNumPerfComponents] = {
+    "harness", "model", "memory"};
+
+/// The hardware events which are counted.
+static constexpr unsigned kNumPerfEvents = 4;
+static constexpr const char *kPerfEventNames[kNumPerfEvents] = {
+    "cycles", "instructions", "cache_misses", "branch_misses"};
+
+/// A sample of each of the counted events.
+struct SimPerfCounts {
+  std::array<uint64_t, kNumPerfEvents> values{};
+
+  SimPerfCounts &operator+=(const SimPerfCounts &other) {
+    for (unsigned i = 0; i < kNumPerfEvents; ++i)
+      values[i] += other.values[i];
+    return *this;
+  }
+  SimPerfCounts operator-(const SimPerfCounts &other) const {
+    SimPerfCounts res;
+    for (unsigned i = 0; i < kNumPerfEvents; ++i)
+      res.values[i] = values[i] - other.values[i];
+    return res;
+  }
+};
+
+/// The counters of the calling thread, which count the user space events of
+/// the thread as a single group.
+class SimPerfGroup {
+public:
+  /// Returns the counters of the calling thread, which are opened on first
+  /// use.
+  static SimPerfGroup &get() {
+    static thread_local SimPerfGroup group;
+    return group;
+  }
+
+  ~SimPerfGroup() { closeAll(); }
+
+  /// Returns false if the counters could not be opened, in which case all
+  /// reads return zero.
+  bool valid() const { return fds[0] >= 0; }
+
+  /// Returns true if the counters of any thread could not be opened.
+  static bool anyUnavailable() { return unavailable().load(); }
+
+  SimPerfCounts read() const {
+    SimPerfCounts counts;
+    if (!valid())
+      return counts;
+    struct {
+      uint64_t nr;
+      uint64_t values[kNumPerfEvents];
+    } data;
+    if (::read(fds[0], &data, sizeof(data)) == sizeof(data))
+      std::memcpy(counts.values.data(), data.values, sizeof(data.values));
+    return counts;
+  }
+
+private:
+  SimPerfGroup() {
+    fds.fill(-1);
+    static constexpr uint64_t configs[kNumPerfEvents] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (unsigned i = 0; i < kNumPerfEvents; ++i) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      fds[i] = syscall(SYS_perf_event_open, &attr, /*pid=*/0, /*cpu=*/-1,
+                       /*group_fd=*/i == 0 ? -1 : fds[0], /*flags=*/0);
+      if (fds[i] < 0) {
+        warnUnavailable(kPerfEventNames[i]);
+        closeAll();
+        return;
+      }
+    }
+  }
+
+  void closeAll() {
+    for (int &fd : fds) {
+      if (fd >= 0)
+        close(fd);
+      fd = -1;
+    }
+  }
+
+  static std::atomic<bool> &unavailable() {
+    static std::atomic<bool> flag{false};
+    return flag;
+  }
+
+  static void warnUnavailable(const char *event) {
+    if (unavailable().exchange(true))
+      return;
+    std::cerr << "WARNING: Failed to open the '" << event
+              << "' perf event counter (" << std::strerror(errno)
+              << "); HLT_PERF_COUNTERS counts are zero. Check "
+                 "/proc/sys/kernel/perf_event_paranoid.\n";
+  }
+
+  std::array<int, kNumPerfEvents> fds;
+};
+
+/// The event counts of each component of a simulator.
+class SimPerfTotals {
+public:
+  void add(SimPerfComponent component, const SimPerfCounts &counts) {
+    totals[static_cast<unsigned>(component)] += counts;
+  }
+
+  void dumpJSON(const std::string &path, uint64_t cycles) const {
+    std::ofstream os(path);
+    os << "{\"cycles\": " << cycles
+       << ", \"available\": "
+       << (SimPerfGroup::anyUnavailable() ? "false" : "true")
+       << ", \"components\": {";
+    for (unsigned c = 0; c < kNumPerfComponents; ++c) {
+      os << (c == 0 ? "" : ", ") << "\"" << kPerfComponentNames[c] << "\": {";
+      for (unsigned e = 0; e < kNumPerfEvents; ++e)
+        os << (e == 0 ? "" : ", ") << "\"" << kPerfEventNames[e]
+           << "\": " << totals[c].values[e];
+      os << "}";
+    }
+    os << "}}\n";
+  }
+
+  /// Prints the share of the host cycles and instructions of each component.
+  void print(std::ostream &os) const {
+    SimPerfCounts sum;
+    for (const SimPerfCounts &counts : totals)
+      sum += counts;
+    os << "Host cost of the simulation (HLT_PERF_COUNTERS):\n";
+    for (unsigned c = 0; c < kNumPerfComponents; ++c) {
+      os << "  " << kPerfComponentNames[c] << ":";
+      for (unsigned e = 0; e < kNumPerfEvents; ++e) {
+        uint64_t value = totals[c].values[e];
+        os << " " << kPerfEventNames[e] << "=" << value;
+        if (e < 2 && sum.values[e] != 0)
+          os << " (" << (100 * value / sum.values[e]) << "%)";
+      }
+      os << "\n";
+    }
+  }
+
+private:
+  std::array<SimPerfCounts, kNumPerfComponents> totals;
+};
+
+/// Counts the events of the lifetime of the scope, excluding those of nested
+/// scopes, towards a component of the innermost root scope of the thread. A
+/// root scope names the totals which its nested scopes count towards; nested
+/// scopes outside of a root scope count nothing.
+class SimPerfScope {
+public:
+  SimPerfScope(SimPerfTotals &totals, SimPerfComponent component)
+      : totals(&totals), component(component), parent(current()) {
+    current() = this;
+    begin = SimPerfGroup::get().read();
+  }
+  explicit SimPerfScope(SimPerfComponent component)
+      : totals(current() ? current()->totals : nullptr), component(component),
+        parent(current()) {
+    if (!totals)
+      return;
+    current() = this;
+    begin = SimPerfGroup::get().read();
+  }
+  ~SimPerfScope() {
+    if (!totals)
+      return;
+    SimPerfCounts counts = SimPerfGroup::get().read() - begin;
+    totals->add(component, counts - nested);
+    if (parent)
+      parent->nested += counts;
+    current() = parent;
+  }
+  SimPerfScope(const SimPerfScope &) = delete;
+  SimPerfScope &operator=(const SimPerfScope &) = delete;
+
+private:
+  static SimPerfScope *&current() {
+    static thread_local SimPerfScope *scope = nullptr;
+    return scope;
+  }
+
+  SimPerfTotals *totals;
+  SimPerfComponent component;
+  SimPerfScope *parent;
+  SimPerfCounts begin;
+  // The events of the scopes nested within this one.
+  SimPerfCounts nested;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#define HLT_PERF_CONCAT_IMPL(a, b) a##b
+#define HLT_PERF_CONCAT(a, b) HLT_PERF_CONCAT_IMPL(a, b)
+#define HLT_PERF_SCOPE(...)                                                    \
+  ::circt::hlt::SimPerfScope HLT_PERF_CONCAT(hltPerfScope, __LINE__)(          \
+      __VA_ARGS__)
+
+#else
+
+#define HLT_PERF_SCOPE(...)
+
+#endif // HLT_PERF_COUNTERS
+
+#endif // CIRCT_TOOLS_HLT_SIMPERFCOUNTERS_H
@@ -0,0 +1,348 @@
+#ifndef CIRCT_TOOLS_HLT_SIMPIPELINE_H
+#define CIRCT_TOOLS_HLT_SIMPIPELINE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "circt-hls/Tools/hlt/Simulator/SimInterface.h"
+
+#ifndef HLT_STREAM_DEPTH
+// Number of outputs of a kernel which the channel to the next kernel of a
+// SimPipeline can hold. A kernel whose channel is full is back-pressured,
+// i.e. its outputs are not popped until the next kernel accepts an input.
+#define HLT_STREAM_DEPTH 2
+#endif
+
+//===----------------------------------------------------------------------===//
+// Sim pipeline
+//===----------------------------------------------------------------------===//
+
+namespace circt {
+namespace hlt {
+
+/// The input and output types of a simulator, as deduced from its
+/// SimInterface base.
+template <typename TInput, typename TOutput>
+std::tuple<TInput, TOutput> simInterfaceTypes(SimInterface<TInput, TOutput> *);
+template <typename TSim>
+using SimInputT = std::tuple_element_t<
+    0, decltype(simInterfaceTypes(std::declval<TSim *>()))>;
+template <typename TSim>
+using SimOutputT = std::tuple_element_t<
+    1, decltype(simInterfaceTypes(std::declval<TSim *>()))>;
+
+/// Returns elements [Offset, Offset + sizeof...(Is)) of tuple 't'.
+template <std::size_t Offset, typename T, std::size_t... Is>
+auto tupleSlice(const T &t, std::index_sequence<Is...>) {
+  return std::make_tuple(std::get<Offset + Is>(t)...);
+}
+
+/// The types of a SimPipeline of simulators 'TSims'. Each stage is passed the
+/// outputs of the previous stage as its leading inputs; its remaining inputs
+/// (all inputs of the first stage) are the stage's share of the inputs of the
+/// pipeline.
+template <typename... TSims>
+struct SimPipelineTypes {
+  static constexpr std::size_t kNumStages = sizeof...(TSims);
+  static_assert(kNumStages > 0, "Expected at least one pipeline stage");
+
+  template <std::size_t K>
+  using Stage = std::tuple_element_t<K, std::tuple<TSims...>>;
+
+  // Number of leading inputs of stage K which are outputs of stage K - 1.
+  template <std::size_t K>
+  static constexpr std::size_t numStreamed() {
+    if constexpr (K == 0)
+      return 0;
+    else
+      return std::tuple_size_v<SimOutputT<Stage<K - 1>>>;
+  }
+
+  // The inputs of stage K which are passed with the pipeline input.
+  template <std::size_t K>
+  using HostInput = decltype(tupleSlice<numStreamed<K>()>(
+      std::declval<SimInputT<Stage<K>>>(),
+      std::make_index_sequence<std::tuple_size_v<SimInputT<Stage<K>>> -
+                               numStreamed<K>()>()));
+
+  // Index of the first input of stage K within the pipeline input.
+  template <std::size_t K>
+  static constexpr std::size_t inputOffset() {
+    if constexpr (K == 0)
+      return 0;
+    else
+      return inputOffset<K - 1>() + std::tuple_size_v<HostInput<K - 1>>;
+  }
+
+  template <typename Is>
+  struct InputOf;
+  template <std::size_t... Is>
+  struct InputOf<std::index_sequence<Is...>> {
+    using type = decltype(std::tuple_cat(std::declval<HostInput<Is>>()...));
+  };
+  using Input = typename InputOf<std::make_index_sequence<kNumStages>>::type;
+  using Output = SimOutputT<Stage<kNumStages - 1>>;
+};
+
+/// A SimPipeline simulates a chain of kernels as a single simulator, in which
+/// the outputs of each kernel are streamed to the next kernel through a
+/// bounded channel, rather than through the host. All kernels are stepped in
+/// lock-step by a single runner, so the latency and throughput of the
+/// pipeline, as recorded by the runner, include any back-pressure between the
+/// kernels. Each kernel still accesses its memories through the inputs of the
+/// pipeline. Transfers over the channels are written to stream_stats.json
+/// whenever the simulator goes idle.
+template <typename... TSims>
+class SimPipeline
+    : public SimInterface<typename SimPipelineTypes<TSims...>::Input,
+                          typename SimPipelineTypes<TSims...>::Output> {
+  using Types = SimPipelineTypes<TSims...>;
+  static constexpr std::size_t kNumStages = Types::kNumStages;
+  template <std::size_t K>
+  using Stage = typename Types::template Stage<K>;
+  template <std::size_t K>
+  using HostInput = typename Types::template HostInput<K>;
+
+public:
+  using Input = typename Types::Input;
+  using Output = typename Types::Output;
+
+  SimPipeline() : stages(std::make_unique<TSims>()...) {}
+
+  void setKeepAliveCallback(const KeepAliveFunction &f) override {
+    SimBase::setKeepAliveCallback(f);
+    std::apply([&](auto &...stage) { (stage->setKeepAliveCallback(f), ...); },
+               stages);
+  }
+
+  // Each stage is a simulator instance of its own, such that the files which
+  // the stages write do not clash.
+  void setup() override {
+    setupStages(std::make_index_sequence<kNumStages>());
+  }
+
+  void finish() override {
+    std::apply([](auto &...stage) { (stage->finish(), ...); }, stages);
+    dumpStreamStats();
+  }
+
+  void idle() override {
+    std::apply([](auto &...stage) { (stage->idle(), ...); }, stages);
+    // The runner may never finish the simulator, so keep the statistics on
+    // disk up to date whenever the simulation goes idle.
+    if (steps != statsDumpStep)
+      dumpStreamStats();
+  }
+
+  void resetInPlace() override {
+    std::apply([](auto &...stage) { (stage->resetInPlace(), ...); }, stages);
+    clearChannels(std::make_index_sequence<kNumStages>());
+    inFlight = 0;
+  }
+
+  bool inReady() override { return std::get<0>(stages)->inReady(); }
+  bool outValid() override {
+    return std::get<kNumStages - 1>(stages)->outValid();
+  }
+
+  void pushInput(const Input &input) override {
+    pushInputImpl(input, std::make_index_sequence<kNumStages>());
+    ++inFlight;
+  }
+
+  Output popOutput() override {
+    --inFlight;
+    return std::get<kNumStages - 1>(stages)->popOutput();
+  }
+
+  void step() override {
+    moved = false;
+    // Channels are served from the last to the first, such that a token
+    // advances by at most one stage per step.
+    transferAll(std::make_index_sequence<kNumStages - 1>());
+    std::apply([](auto &...stage) { (stage->step(), ...); }, stages);
+    ++steps;
+  }
+
+  uint64_t time() override { return steps; }
+
+  // The pipeline is deadlocked once no token can be transferred and each of
+  // its stages is deadlocked.
+  bool deadlocked() override {
+    return !moved &&
+           std::apply(
+               [](auto &...stage) { return (stage->deadlocked() && ...); },
+               stages);
+  }
+
+  void dumpDeadlock(std::ostream &os) const override {
+    dumpStages(os, /*deadlock=*/true, std::make_index_sequence<kNumStages>());
+  }
+  void dump(std::ostream &os) const override {
+    dumpStages(os, /*deadlock=*/false, std::make_index_sequence<kNumStages>());
+  }
+
+private:
+  /// A bounded channel from stage K to stage K + 1, holding the outputs of
+  /// stage K along with the host inputs of stage K + 1 of the same pipeline
+  /// input.
+  template <typename TToken>
+  struct Channel {
+    std::deque<TToken> tokens;
+    // Number of tokens transferred to the next stage.
+    uint64_t transfers = 0;
+    // Number of steps in which the previous stage held an output, but the
+    // channel was full.
+    uint64_t fullSteps = 0;
+    // Number of steps in which the next stage was ready for an input while
+    // inputs were in flight, but the channel was empty.
+    uint64_t starvedSteps = 0;
+    std::size_t maxOccupancy = 0;
+  };
+
+  // Host inputs of stage K which wait for the outputs of stage K - 1. The
+  // host inputs of the first stage are pushed to it directly.
+  template <typename Is>
+  struct HostQueues;
+  template <std::size_t... Is>
+  struct HostQueues<std::index_sequence<Is...>> {
+    using type = std::tuple<std::deque<HostInput<Is>>...>;
+  };
+
+  template <std::size_t... Ks>
+  void setupStages(std::index_sequence<Ks...>) {
+    ((std::get<Ks>(stages)->setInstance(this->instance * kNumStages + Ks),
+      std::get<Ks>(stages)->setup()),
+     ...);
+  }
+
+  template <std::size_t... Ks>
+  void clearChannels(std::index_sequence<Ks...>) {
+    ((std::get<Ks>(channels).tokens.clear(), std::get<Ks>(hostQueues).clear()),
+     ...);
+  }
+
+  template <std::size_t... Ks>
+  void pushInputImpl(const Input &input, std::index_sequence<Ks...>) {
+    (pushHostInput<Ks>(input), ...);
+  }
+
+  template <std::size_t K>
+  void pushHostInput(const Input &input) {
+    auto hostInput = tupleSlice<Types::template inputOffset<K>()>(
+        input, std::make_index_sequence<std::tuple_size_v<HostInput<K>>>());
+    if constexpr (K == 0)
+      std::get<0>(stages)->pushInput(std::move(hostInput));
+    else
+      std::get<K>(hostQueues).push_back(std::move(hostInput));
+  }
+
+  template <std::size_t... Is>
+  void transferAll(std::index_sequence<Is...>) {
+    (transfer<kNumStages - 2 - Is>(), ...);
+  }
+
+  // Transfers a token from stage K to stage K + 1 through their channel, and
+  // from stage K into the channel.
+  template <std::size_t K>
+  void transfer() {
+    auto &channel = std::get<K>(channels);
+    auto &producer = *std::get<K>(stages);
+    auto &consumer = *std::get<K + 1>(stages);
+    auto &hostQueue = std::get<K + 1>(hostQueues);
+
+    if (consumer.inReady()) {
+      if (!channel.tokens.empty()) {
+        using TInput = SimInputT<Stage<K + 1>>;
+        static_assert(
+            std::is_same_v<TInput, decltype(std::tuple_cat(
+                                       std::move(channel.tokens.front()),
+                                       std::move(hostQueue.front())))>,
+            "Expected the leading inputs of a pipeline stage to match the "
+            "outputs of the previous stage");
+        assert(!hostQueue.empty() && "Expected host inputs of the token");
+        consumer.pushInput(std::tuple_cat(std::move(channel.tokens.front()),
+                                          std::move(hostQueue.front())));
+        channel.tokens.pop_front();
+        hostQueue.pop_front();
+        channel.transfers++;
+        moved = true;
+      } else if (inFlight != 0) {
+        channel.starvedSteps++;
+      }
+    }
+
+    if (producer.outValid()) {
+      if (channel.tokens.size() < HLT_STREAM_DEPTH) {
+        channel.tokens.push_back(producer.popOutput());
+        channel.maxOccupancy =
+            std::max(channel.maxOccupancy, channel.tokens.size());
+        moved = true;
+      } else {
+        channel.fullSteps++;
+      }
+    }
+  }
+
+  template <std::size_t... Ks>
+  void dumpStages(std::ostream &os, bool deadlock,
+                  std::index_sequence<Ks...>) const {
+    ((os << "Stage " << Ks << ":\n",
+      deadlock ? std::get<Ks>(stages)->dumpDeadlock(os)
+               : std::get<Ks>(stages)->dump(os),
+      os << "Stage " << Ks << " channel holds "
+         << std::get<Ks>(channels).tokens.size() << " tokens\n"),
+     ...);
+  }
+
+  template <std::size_t... Ks>
+  void dumpStreamStatsImpl(std::ostream &os, std::index_sequence<Ks...>) {
+    ((os << (Ks == 0 ? "" : ", ") << "{\"from\": " << Ks
+         << ", \"to\": " << Ks + 1 << ", \"depth\": " << HLT_STREAM_DEPTH
+         << ", \"transfers\": " << std::get<Ks>(channels).transfers
+         << ", \"fullSteps\": " << std::get<Ks>(channels).fullSteps
+         << ", \"starvedSteps\": " << std::get<Ks>(channels).starvedSteps
+         << ", \"maxOccupancy\": " << std::get<Ks>(channels).maxOccupancy
+         << "}"),
+     ...);
+  }
+
+  void dumpStreamStats() {
+    statsDumpStep = steps;
+    std::ofstream os(this->instance == 0
+                         ? "stream_stats.json"
+                         : "stream_stats_" + std::to_string(this->instance) +
+                               ".json");
+    os << "{\"steps\": " << steps << ", \"channels\": [";
+    dumpStreamStatsImpl(os, std::make_index_sequence<kNumStages - 1>());
+    os << "]}\n";
+  }
+
+  std::tuple<std::unique_ptr<TSims>...> stages;
+  // The channel from each stage to the next; the channel of the last stage is
+  // unused.
+  std::tuple<Channel<SimOutputT<TSims>>...> channels;
+  typename HostQueues<std::make_index_sequence<kNumStages>>::type hostQueues;
+
+  // Number of pipeline inputs whose outputs have not yet been popped.
+  uint64_t inFlight = 0;
+  // Set if any token was transferred in the last step.
+  bool moved = false;
+  uint64_t steps = 0;
+  // Step at which the statistics were last written.
+  uint64_t statsDumpStep = ~0ULL;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_SIMPIPELINE_H
@@ -0,0 +1,195 @@
+#ifndef CIRCT_TOOLS_HLT_SIMPROFILE_H
+#define CIRCT_TOOLS_HLT_SIMPROFILE_H
+
+#ifndef HLT_PROFILE
+// Set to 1 to record the time spent in the scopes of the simulator which are
+// marked by HLT_PROFILE_SCOPE, written as a Chrome trace when the process
+// exits. Otherwise, the scopes are compiled out.
+#define HLT_PROFILE 0
+#endif
+
+#ifndef HLT_PROFILE_MAX_EVENTS
+// Maximum number of events recorded by each thread. Events past this are
+// dropped, and counted in the trace.
+#define HLT_PROFILE_MAX_EVENTS (1 << 20)
+#endif
+
+// Profiling of the host side of a simulation. Each scope marked by
+// HLT_PROFILE_SCOPE records an event of its duration on the thread that ran
+// it, such that a trace shows where the time of a slow run goes: the runner
+// steps and polls, the evaluation of the model and its ports, and the calls
+// of the driver and of the generated wrapper functions. The time between the
+// wrapper calls of the testbench thread is spent in the testbench itself,
+// i.e. in the software reference and in its compares. The trace is written to
+// $HLT_PROFILE_FILE (hlt_profile.json by default) in the Chrome trace event
+// format, which chrome://tracing and Perfetto load.
+
+#if HLT_PROFILE
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace circt {
+namespace hlt {
+
+class SimProfiler {
+  struct Event {
+    const char *name;
+    int64_t begin;
+    int64_t duration;
+  };
+
+  // The events of a thread. Only that thread appends to it, and the lock is
+  // only contended while the trace is written.
+  struct Buffer {
+    std::mutex lock;
+    std::string threadName;
+    std::vector<Event> events;
+    uint64_t dropped = 0;
+  };
+
+public:
+  /// Returns the profiler of the process. The profiler is never destroyed,
+  /// since threads may record events while the process exits; the trace is
+  /// written by an exit handler.
+  static SimProfiler &get() {
+    static SimProfiler *profiler = []() {
+      auto *p = new SimProfiler();
+      std::atexit([]() { get().write(); });
+      return p;
+    }();
+    return *profiler;
+  }
+
+  /// Returns the current time, in nanoseconds since the profiler started.
+  int64_t now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - epoch)
+        .count();
+  }
+
+  /// Records an event 'name' which ran from 'begin' until now. 'name' must
+  /// outlive the profiler, i.e. be a string literal.
+  void record(const char *name, int64_t begin) {
+    int64_t end = now();
+    Buffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> l(buffer.lock);
+    if (buffer.events.size() >= HLT_PROFILE_MAX_EVENTS) {
+      ++buffer.dropped;
+      return;
+    }
+    buffer.events.push_back({name, begin, end - begin});
+  }
+
+  /// Names the calling thread in the trace.
+  void setThreadName(const std::string &name) {
+    Buffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> l(buffer.lock);
+    buffer.threadName = name;
+  }
+
+  /// Writes the trace of all events recorded so far.
+  void write() {
+    const char *env = std::getenv("HLT_PROFILE_FILE");
+    std::string path = env && *env ? env : "hlt_profile.json";
+    std::ofstream out(path);
+    if (!out) {
+      std::cerr << "Failed to write simulator profile '" << path << "'\n";
+      return;
+    }
+    int pid = getpid();
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    auto sep = [&]() -> std::ostream & {
+      out << (first ? "\n" : ",\n");
+      first = false;
+      return out;
+    };
+    std::lock_guard<std::mutex> l(buffersLock);
+    for (size_t tid = 0; tid < buffers.size(); ++tid) {
+      Buffer &buffer = *buffers[tid];
+      std::lock_guard<std::mutex> bl(buffer.lock);
+      if (!buffer.threadName.empty())
+        sep() << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+              << ",\"tid\":" << tid << ",\"args\":{\"name\":\""
+              << buffer.threadName << "\"}}";
+      // Timestamps are in microseconds, with nanosecond precision.
+      for (const Event &event : buffer.events)
+        sep() << "{\"ph\":\"X\",\"name\":\"" << event.name
+              << "\",\"pid\":" << pid << ",\"tid\":" << tid
+              << ",\"ts\":" << event.begin / 1000 << "." << pad(event.begin)
+              << ",\"dur\":" << event.duration / 1000 << "."
+              << pad(event.duration) << "}";
+      if (buffer.dropped != 0)
+        sep() << "{\"ph\":\"C\",\"name\":\"dropped events\",\"pid\":" << pid
+              << ",\"tid\":" << tid << ",\"ts\":0,\"args\":{\"dropped\":"
+              << buffer.dropped << "}}";
+    }
+    out << "\n]}\n";
+  }
+
+private:
+  SimProfiler() : epoch(std::chrono::steady_clock::now()) {}
+
+  // Returns the sub-microsecond digits of 'ns'.
+  static std::string pad(int64_t ns) {
+    std::string digits = std::to_string(ns % 1000);
+    return std::string(3 - digits.size(), '0') + digits;
+  }
+
+  Buffer &threadBuffer() {
+    static thread_local Buffer *buffer = nullptr;
+    if (!buffer) {
+      std::lock_guard<std::mutex> l(buffersLock);
+      buffers.push_back(std::make_unique<Buffer>());
+      buffer = buffers.back().get();
+    }
+    return *buffer;
+  }
+
+  std::chrono::steady_clock::time_point epoch;
+  std::mutex buffersLock;
+  std::vector<std::unique_ptr<Buffer>> buffers;
+};
+
+/// Records an event of the lifetime of the scope.
+class SimProfileScope {
+public:
+  explicit SimProfileScope(const char *name)
+      : name(name), begin(SimProfiler::get().now()) {}
+  ~SimProfileScope() { SimProfiler::get().record(name, begin); }
+  SimProfileScope(const SimProfileScope &) = delete;
+  SimProfileScope &operator=(const SimProfileScope &) = delete;
+
+private:
+  const char *name;
+  int64_t begin;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#define HLT_PROFILE_CONCAT_IMPL(a, b) a##b
+#define HLT_PROFILE_CONCAT(a, b) HLT_PROFILE_CONCAT_IMPL(a, b)
+#define HLT_PROFILE_SCOPE(name)                                                \
+  ::circt::hlt::SimProfileScope HLT_PROFILE_CONCAT(hltProfileScope,            \
+                                                   __LINE__)(name)
+#define HLT_PROFILE_THREAD_NAME(name)                                          \
+  ::circt::hlt::SimProfiler::get().setThreadName(name)
+
+#else
+
+#define HLT_PROFILE_SCOPE(name)
+#define HLT_PROFILE_THREAD_NAME(name)
+
+#endif // HLT_PROFILE
+
+#endif // CIRCT_TOOLS_HLT_SIMPROFILE_H
@@ -0,0 +1,218 @@
+#ifndef CIRCT_TOOLS_HLT_SIMRECORD_H
+#define CIRCT_TOOLS_HLT_SIMRECORD_H
+
+#include "circt-hls/Tools/hlt/Simulator/MappedMemory.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Golden records of the calls of a kernel, which are replayed against the
+// simulator of the kernel without running the testbench or the reference.
+//
+// A record file starts with a magic number, followed by a record of each call
+// to the kernel. A record holds the host inputs of the call, in argument
+// order, followed by its results and the contents of its memory arguments
+// after the call. Each of these is a field of a 64-bit byte count and as many
+// bytes, padded to 8 bytes, such that a mapped file is accessed in place.
+// Memories are recorded as contiguous arrays of their elements.
+//
+// Records are taken from the calls of the kernel in a testbench, and so hold
+// the outputs of the kernel. In cosimulation, these are verified against the
+// reference in the same run, such that a record of a run without mismatches
+// holds the reference outputs.
+
+namespace circt {
+namespace hlt {
+
+/// Returns the number of padding bytes which follow a field of 'bytes' bytes.
+static inline size_t recordPadding(size_t bytes) {
+  return (8 - bytes % 8) % 8;
+}
+
+static constexpr char kRecordMagic[8] = {'H', 'L', 'T', 'R',
+                                         'E', 'C', '0', '1'};
+
+/// Records the calls of a kernel to a record file. Inputs are recorded when
+/// the kernel is called, and the record of a call is written once its outputs
+/// are awaited; calls are awaited in the order in which they were issued.
+class SimRecorder {
+  struct Call {
+    // The recorded fields of the inputs.
+    std::vector<char> fields;
+    size_t numFields = 0;
+    // The memory arguments of the call, whose contents are recorded after
+    // the call.
+    std::vector<std::pair<const void *, size_t>> memories;
+  };
+
+public:
+  /// Returns a recorder of the calls of kernel 'name', if the HLT_RECORD
+  /// environment variable names a directory to write the record file
+  /// '<name>.rec' to.
+  static std::unique_ptr<SimRecorder> fromEnv(const std::string &name) {
+    const char *dir = std::getenv("HLT_RECORD");
+    if (!dir || *dir == '\0')
+      return nullptr;
+    return std::make_unique<SimRecorder>(std::string(dir) + "/" + name +
+                                         ".rec");
+  }
+
+  SimRecorder(const std::string &path) : out(path, std::ios::binary) {
+    if (!out) {
+      std::cerr << "Failed to create record file '" << path << "'\n";
+      std::abort();
+    }
+    out.write(kRecordMagic, sizeof(kRecordMagic));
+  }
+
+  /// Records a scalar input of the call being issued.
+  template <typename T>
+  void recordInput(const T &value) {
+    addField(pending.fields, pending.numFields, &value, sizeof(T));
+  }
+
+  /// Records a memory input of the call being issued, of 'numElements'
+  /// elements of 'elementBytes' bytes each, starting at element 'offset' of
+  /// 'aligned'.
+  void recordMemory(const void *aligned, int64_t offset, size_t elementBytes,
+                    size_t numElements) {
+    const char *data =
+        static_cast<const char *>(aligned) + offset * elementBytes;
+    size_t bytes = elementBytes * numElements;
+    addField(pending.fields, pending.numFields, data, bytes);
+    pending.memories.push_back({data, bytes});
+  }
+
+  /// Completes the inputs of the call being issued.
+  void issue() {
+    issued.push_back(std::move(pending));
+    pending = Call();
+  }
+
+  /// Records a result of the oldest call which is awaited.
+  template <typename T>
+  void recordResult(const T &value) {
+    addField(results, numResults, &value, sizeof(T));
+  }
+
+  /// Completes the oldest call which is awaited, and writes its record.
+  void complete() {
+    if (issued.empty()) {
+      std::cerr << "Recorded the outputs of a call which was not issued\n";
+      std::abort();
+    }
+    Call &call = issued.front();
+    for (auto &memory : call.memories)
+      addField(results, numResults, memory.first, memory.second);
+    uint64_t numFields = call.numFields + numResults;
+    out.write(reinterpret_cast<const char *>(&numFields), sizeof(numFields));
+    out.write(call.fields.data(), call.fields.size());
+    out.write(results.data(), results.size());
+    out.flush();
+    issued.pop_front();
+    results.clear();
+    numResults = 0;
+  }
+
+private:
+  static void addField(std::vector<char> &fields, size_t &numFields,
+                       const void *data, size_t bytes) {
+    uint64_t size = bytes;
+    const char *sizeBytes = reinterpret_cast<const char *>(&size);
+    fields.insert(fields.end(), sizeBytes, sizeBytes + sizeof(size));
+    const char *dataBytes = static_cast<const char *>(data);
+    fields.insert(fields.end(), dataBytes, dataBytes + bytes);
+    fields.resize(fields.size() + recordPadding(bytes), 0);
+    numFields++;
+  }
+
+  std::ofstream out;
+  Call pending;
+  std::deque<Call> issued;
+  std::vector<char> results;
+  size_t numResults = 0;
+};
+
+/// Replays a record file. The file is mapped copy-on-write, such that the
+/// recorded inputs are passed to the kernel in place; the memories of a call
+/// are modified by the kernel, but the file is left untouched.
+class SimReplayer {
+public:
+  SimReplayer(const std::string &path)
+      : file(MappedFileSpec{path, MapMode::CopyOnWrite}, 0), path(path) {
+    if (file.size() < sizeof(kRecordMagic) ||
+        std::memcmp(file.data(), kRecordMagic, sizeof(kRecordMagic)) != 0) {
+      std::cerr << "'" << path << "' is not a record file\n";
+      std::abort();
+    }
+    pos = sizeof(kRecordMagic);
+  }
+
+  /// Returns true if all records have been replayed.
+  bool atEnd() const { return pos >= file.size(); }
+
+  /// Starts replaying the next record, which must hold 'numFields' fields.
+  void begin(uint64_t numFields) {
+    uint64_t recorded = *static_cast<uint64_t *>(take(sizeof(uint64_t)));
+    if (recorded != numFields)
+      corrupt("holds a record of " + std::to_string(recorded) +
+              " fields, expected " + std::to_string(numFields));
+  }
+
+  /// Returns the next field of the record, which must hold 'bytes' bytes.
+  template <typename T = void>
+  T *next(size_t bytes = sizeof(T)) {
+    uint64_t recorded = *static_cast<uint64_t *>(take(sizeof(uint64_t)));
+    if (recorded != bytes)
+      corrupt("holds a field of " + std::to_string(recorded) +
+              " bytes, expected " + std::to_string(bytes));
+    void *data = take(bytes);
+    take(recordPadding(bytes));
+    return static_cast<T *>(data);
+  }
+
+  /// Returns the position of the next field, from which fields may be read
+  /// again after a rewind.
+  size_t position() const { return pos; }
+  void rewind(size_t position) { pos = position; }
+
+  /// Returns true if the next field of the record holds the bytes of 'value'.
+  template <typename T>
+  bool matches(const T &value) {
+    return matches(&value, sizeof(T));
+  }
+  bool matches(const void *data, size_t bytes) {
+    return std::memcmp(next(bytes), data, bytes) == 0;
+  }
+
+private:
+  void *take(size_t bytes) {
+    if (pos + bytes > file.size())
+      corrupt("is truncated");
+    void *data = static_cast<char *>(file.data()) + pos;
+    pos += bytes;
+    return data;
+  }
+
+  [[noreturn]] void corrupt(const std::string &what) {
+    std::cerr << "Record file '" << path << "' " << what << " at byte " << pos
+              << "\n";
+    std::abort();
+  }
+
+  MappedFile file;
+  std::string path;
+  size_t pos = 0;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_SIMRECORD_H
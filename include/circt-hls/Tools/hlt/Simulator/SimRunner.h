@@ -2,17 +2,34 @@
 #define CIRCT_TOOLS_HLT_SIMRUNNER_H
 
 #include <assert.h>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
 #include <exception>
 #include <fstream>
+#include <future>
+#include <limits>
 #include <list>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include "circt-hls/Tools/hlt/Simulator/HostAffinity.h"
+#include "circt-hls/Tools/hlt/Simulator/HostLink.h"
 #include "circt-hls/Tools/hlt/Simulator/SimInterface.h"
+#include "circt-hls/Tools/hlt/Simulator/SimLog.h"
+#include "circt-hls/Tools/hlt/Simulator/SimSample.h"
+#include "circt-hls/Tools/hlt/Simulator/SimScheduler.h"
+
+#if HLT_DEBUG_SERVER
+#include "circt-hls/Tools/hlt/Simulator/SimDebugServer.h"
+#endif
 
 #ifndef HLT_TIMEOUT
 // Number of steps without meaningful simulator state changes before exiting
@@ -20,13 +37,47 @@
 #define HLT_TIMEOUT 10000
 #endif
 
+#ifndef HLT_POLL_INTERVAL
+// Number of steps between each time the runner samples the host-side queues.
+// The queues are additionally sampled whenever the model's inReady/outValid
+// state changes, and before the runner goes to sleep. A value of 1 samples the
+// queues on every step.
+#define HLT_POLL_INTERVAL 1
+#endif
+
+#ifndef HLT_FAST_FORWARD
+// Maximum number of steps that the runner takes in a tight loop when the model
+// is busy and there is no pending host-side activity. Fast-forwarding stops
+// early when the model's inReady/outValid state changes or the model signals
+// keepAlive. A value of 1 disables fast-forwarding.
+#define HLT_FAST_FORWARD 1
+#endif
+
+#ifndef HLT_CHECKPOINT_INTERVAL
+// Number of steps between each checkpoint of the simulation state written by
+// the runner. Checkpoints are only written by simulators which support them
+// (see HLT_CHECKPOINTS). A value of 0 disables checkpointing.
+#define HLT_CHECKPOINT_INTERVAL 0
+#endif
+
+#ifndef HLT_CYCLE_LIMIT_EXIT_CODE
+// Exit code of a simulation which reached the cycle limit of HLT_MAX_CYCLES.
+#define HLT_CYCLE_LIMIT_EXIT_CODE 3
+#endif
+
 namespace circt {
 namespace hlt {
 
+/// Steps a simulator, serving the queues of its driver. The runner runs on a
+/// thread of its own, or as a task of the simulator scheduler, if any (see
+/// SimScheduler.h).
 template <typename TInput, typename TOutput, typename Sim>
-class SimRunner {
+class SimRunner : public SimTask {
   using SimQueuesImpl = SimQueues<TInput, TOutput>;
 
+  // The state of the runner after a call to runSteps.
+  enum class RunState { Busy, Idle, Finished };
+
   struct TimeoutCounter {
     int cntr = 0;
     void reset() { cntr = 0; }
@@ -34,106 +85,511 @@ class SimRunner {
     bool timedOut() const { return cntr >= HLT_TIMEOUT; }
   };
 
-  std::unique_ptr<std::ofstream> m_logFile;
+  std::unique_ptr<SimLog> m_log;
 
-  void writeToLog(const std::string &msg) {
-    if (m_logFile) {
-      (*m_logFile) << sim->time() << " @ " << msg << std::endl;
-      m_logFile->flush();
-    }
+  void writeToLog(SimLogEvent event, uint32_t id = 0) {
+    if (m_log)
+      m_log->write(sim->time(), event, id);
   }
 
 public:
-  SimRunner(SimQueuesImpl &queues) : queues(queues) {
-    thread = std::thread(&SimRunner::run, this);
+  SimRunner(SimQueuesImpl &queues, unsigned instance = 0)
+      : queues(queues), instance(instance),
+        scheduler(SimScheduler::get()) {
+    if (scheduler) {
+      finishedFuture = finished.get_future();
+      scheduled = true;
+      scheduler->submit(this);
+    } else {
+      thread = std::thread(&SimRunner::run, this);
+    }
   }
 
-  void wakeup() { notifier.notify_all(); }
+  /// Stops the runner once all pushed inputs have been served, and finishes
+  /// the simulator.
+  ~SimRunner() {
+    stopRequested = true;
+    wakeup();
+    if (scheduler)
+      finishedFuture.wait();
+    else
+      thread.join();
+  }
+
+  /// Wakes up the runner. The runner spins on the wakeup epoch before it
+  /// parks, so the sleep lock is only taken to wake up a parked runner.
+  void wakeup() {
+    // Both the epoch and the parked flag are sequentially consistent, such
+    // that either the runner sees the new epoch before it parks, or this sees
+    // the runner parked, and notifies it under the sleep lock. Likewise, an
+    // idle runner task is resubmitted by either this or the task itself.
+    wakeupEpoch.fetch_add(1);
+    if (scheduler) {
+      if (!scheduled.exchange(true))
+        scheduler->submit(this);
+      return;
+    }
+    if (parked.load()) {
+      std::lock_guard<std::mutex> l(sleepLock);
+      notifier.notify_all();
+    }
+  }
+
+  /// Returns the simulated cycles of the call whose output was returned last,
+  /// from when its input was taken from the driver, until its output was
+  /// returned. The cycles are stored before the output is returned, so a
+  /// caller which got the output of a call sees the cycles of that call, or of
+  /// a later one.
+  uint64_t lastCallCycles() const {
+    return lastCycles.load(std::memory_order_relaxed);
+  }
+
+  /// Requests the runner to reset the simulator in place between independent
+  /// runs; see SimInterface::resetInPlace. The returned future is fulfilled
+  /// once the simulator has been reset.
+  std::future<void> requestReset() {
+    std::future<void> f;
+    {
+      std::lock_guard<std::mutex> l(resetLock);
+      resetPromise = std::promise<void>();
+      f = resetPromise.get_future();
+      resetRequested = true;
+    }
+    wakeup();
+    return f;
+  }
+
+  /// Blocking. Suspends the runner once the simulator has been set up and is
+  /// idle, and joins its thread, without finishing the simulator, such that
+  /// the process can be forked (see SimFork.h). Runners of the simulator
+  /// scheduler cannot be suspended, since the scheduler owns their threads.
+  void suspend() {
+    if (scheduler)
+      throw std::runtime_error(
+          "Runners of the simulator scheduler cannot be suspended");
+    suspendRequested = true;
+    wakeup();
+    thread.join();
+    // The buffered records would otherwise be written by each forked child.
+    if (m_log)
+      m_log->flush();
+  }
+
+  /// Restarts the thread of a suspended runner. A runner resumed within a
+  /// forked child opens an event log of its own, since the log of the parent
+  /// is shared with the other children.
+  void resume(bool forked) {
+    if (forked && m_log) {
+      m_log->discard();
+      openLog();
+    }
+    suspendRequested = false;
+    thread = std::thread(&SimRunner::run, this);
+  }
 
   // Runner - simulation executer in separate thread
   void run() {
+    // Pin the runner before creating the model, such that the model is
+    // allocated on the NUMA node of the runner's CPU.
+    pinRunnerThread(instance);
+    HLT_PROFILE_THREAD_NAME("runner " + std::to_string(instance));
+    // A resumed runner continues with the simulator of the suspended one.
+    if (!sim)
+      start();
+    while (runSteps(std::numeric_limits<uint64_t>::max()) !=
+           RunState::Finished) {
+      if (suspendRequested)
+        return;
+      debugOut << "RUNNER: Sleeping..." << std::endl;
+      sim->idle();
+      // Wake up on any wakeup() call made since the last time the runner
+      // woke up, including ones made while the runner was stepping.
+      auto woken = [this]() { return wakeupEpoch.load() != seenEpoch; };
+      if (!sleepSpin.spinUntil(woken)) {
+        parked = true;
+        std::unique_lock<std::mutex> ul(sleepLock);
+        notifier.wait(ul, woken);
+        parked = false;
+      }
+      seenEpoch = wakeupEpoch.load();
+      debugOut << "RUNNER: Woke up..." << std::endl;
+      // The runner was likely woken up due to a host-side queue change.
+      pollCntr = HLT_POLL_INTERVAL;
+    }
+  }
+
+  // Runs a quantum of the runner as a task of the scheduler. An idle runner
+  // leaves the scheduler until it is woken up.
+  void runTask() override {
+    if (!sim)
+      start();
+    // Wakeups from here on are either served by this quantum, or resubmit
+    // the runner once it is idle.
+    seenEpoch = wakeupEpoch.load();
+    switch (runSteps(HLT_SCHEDULER_QUANTUM)) {
+    case RunState::Busy:
+      scheduler->submit(this);
+      return;
+    case RunState::Finished:
+      // The runner stays scheduled, such that it is never resubmitted. The
+      // runner may be destroyed as soon as it is finished.
+      finished.set_value();
+      return;
+    case RunState::Idle:
+      debugOut << "RUNNER: Yielding..." << std::endl;
+      sim->idle();
+      pollCntr = HLT_POLL_INTERVAL;
+      scheduled = false;
+      if (wakeupEpoch.load() != seenEpoch && !scheduled.exchange(true))
+        scheduler->submit(this);
+      return;
+    }
+  }
+
+  // Returns true if the model should continue evaluating.
+  bool preStep() {
+    HLT_PROFILE_SCOPE("preStep");
+    bool inReady = sim->inReady();
+    bool outValid = sim->outValid();
+    bool polled = false;
+    if (++pollCntr >= HLT_POLL_INTERVAL || inReady != lastInReady ||
+        outValid != lastOutValid) {
+      pollHost();
+      polled = true;
+    }
+    lastInReady = inReady;
+    lastOutValid = outValid;
+
+    bool cont = applyRules(inReady, outValid);
+    if (!cont && !polled) {
+      // The runner is about to sleep; make sure that this isn't based on stale
+      // host state.
+      pollHost();
+      cont = applyRules(inReady, outValid);
+    }
+    return cont;
+  }
+
+  /// Checks the current exception pointer of the runner, and rethrows, if any.
+  void checkError() {
+    epLock.lock();
+    std::exception_ptr epCopy = ep;
+    epLock.unlock();
+    if (epCopy)
+      std::rethrow_exception(epCopy);
+  }
+
+private:
+  // Creates and sets up the simulator.
+  void start() {
     sim = std::make_unique<Sim>();
     // Define the keepAlive callback which the simulator can use to notify
     // the runner that it is still alive.
-    sim->setKeepAliveCallback([this]() { to.reset(); });
+    sim->setKeepAliveCallback([this]() {
+      to.reset();
+      keepAliveFired = true;
+    });
+    sim->setInstance(instance);
     sim->setup();
+    openLog();
+    if (const char *env = std::getenv("HLT_MAX_CYCLES"))
+      maxCycles = std::strtoull(env, nullptr, 10);
+    if (auto config = HostLinkConfig::fromEnv())
+      link.emplace(*config);
 
-    m_logFile = std::make_unique<std::ofstream>("sim.log");
+    // Resume the simulation from a checkpoint, if requested.
+    if (const char *path = std::getenv("HLT_RESTORE_CHECKPOINT")) {
+      if (!sim->restoreCheckpoint(path)) {
+        std::cerr << "Failed to restore simulation checkpoint '" << path
+                  << "'.\n";
+        std::abort();
+      }
+      writeToLog(SimLogEvent::Restored);
+    }
+    startDebugServer();
+    debugOut << "RUNNER: Runner started" << std::endl;
+  }
 
-    debugOut << "RUNNER: Runner thread started" << std::endl;
-    std::mutex lock;
-    std::unique_lock<std::mutex> ul(lock);
-    while (true) { // todo: fix this
+  // Opens the event log of the runner. Call statistics are written next to
+  // the log when it is closed.
+  void openLog() {
+    std::string suffix = instance == 0 ? "" : "_" + std::to_string(instance);
+    m_log = std::make_unique<SimLog>("sim" + suffix + ".log",
+                                     "call_stats" + suffix + ".json");
+  }
+
+  // Steps the simulator until it is idle, or for at most 'maxSteps' steps.
+  // The simulator is finished once the runner stops, which it does due to an
+  // error, or once it is idle after the destructor was called.
+  RunState runSteps(uint64_t maxSteps) {
+    HLT_PROFILE_SCOPE("runSteps");
+    for (uint64_t i = 0; i < maxSteps; ++i) {
+      if (resetRequested)
+        resetSim();
       if (to.timedOut()) {
         raiseTimeoutError();
-        break;
+        return finish();
       }
-      if (preStep()) {
-        sim->step();
-        to.inc();
-        debugOut << "+" << std::endl;
-      } else {
-        debugOut << "RUNNER: Sleeping..." << std::endl;
-        notifier.wait(ul);
-        debugOut << "RUNNER: Woke up..." << std::endl;
+      if (!preStep())
+        return stopRequested ? finish() : RunState::Idle;
+      sim->step();
+      to.inc();
+      checkCycleLimit();
+      checkpoint();
+      debugStep();
+      debugOut << "+" << std::endl;
+      if (!hostActivity)
+        fastForward();
+      // A deadlocked simulator only recovers once an output is popped or
+      // another input is pushed. The simulator idles while the host link
+      // transfers a call.
+      if (sim->deadlocked() && !sim->outValid() &&
+          !(hostHasInput && sim->inReady()) && !linkBusy()) {
+        raiseDeadlockError();
+        return finish();
       }
+#if HLT_STREAM_CHECK
+      if (sim->mismatched()) {
+        raiseMismatchError();
+        return finish();
+      }
+#endif
     }
-    if (to.timedOut())
-      writeToLog("TIMED OUT");
+    return RunState::Busy;
+  }
+
+  // Finishes the simulator.
+  RunState finish() {
+    if (to.timedOut() || deadlocked)
+      writeToLog(SimLogEvent::TimedOut);
     else
-      writeToLog("FINISHED");
+      writeToLog(SimLogEvent::Finished);
     sim->finish();
-    m_logFile->close();
+    m_log->close();
+    return RunState::Finished;
   }
 
-  // Todo(mortbopet): This can/should be optimized to not check atomic queues on
-  // each step - way too much locking.
-  // Returns true if the model should continue evaluating.
-  bool preStep() {
+  // Samples the host-side queues. The runner is the only consumer of the
+  // input queue, so a cached non-empty state can never be stale; a cached
+  // empty state is at most HLT_POLL_INTERVAL steps old.
+  void pollHost() {
+    pollCntr = 0;
+    hostHasInput = !queues.in.empty();
+  }
+
+  // Applies the runner rules based on the current model state and the cached
+  // host state. Returns true if the model should continue evaluating.
+  bool applyRules(bool inReady, bool outValid) {
     bool cont = false;
-    // Rule 1: If has input transaction and sim is ready to accept input
-    if (sim->inReady() && !queues.in.empty()) {
-      writeToLog("PUSH INPUT");
-      sim->pushInput(queues.in.pop());
+    hostActivity = false;
+    if (link)
+      cont |= applyLinkRules();
+    // Rule 1: If has input transaction and sim is ready to accept input. With
+    // a host link, inputs are pushed once they have been transferred.
+    bool hasInput = link ? !inTransfers.empty() &&
+                               inTransfers.front().first <= sim->time()
+                         : hostHasInput;
+    if (inReady && hasInput) {
+      HLT_PROFILE_SCOPE("popInput");
+      writeToLog(SimLogEvent::PushInput, numPushed++);
+      typename SimQueuesImpl::InputRequest req;
+      if (link) {
+        req = std::move(inTransfers.front().second);
+        inTransfers.pop_front();
+        outBytes.push_back(HostLink::outputBytes<TOutput>(req.input));
+      } else {
+        req = queues.in.pop();
+        hostHasInput = !queues.in.empty();
+        callStarts.push_back(sim->time());
+      }
+#if HLT_STREAM_CHECK
+      sim->expect(std::move(req.expected));
+#endif
+      sim->pushInput(std::move(req.input));
+      ++pendingOutputs;
       to.reset();
+      hostActivity = true;
       cont |= true;
     }
-    // Rule 2: If popping an output from the simulator
-    if (sim->outValid()) {
-      writeToLog("POP OUTPUT");
-      queues.out.push(sim->popOutput());
+    // Rule 2: If popping an output from the simulator. With a host link,
+    // outputs are returned once they have been transferred.
+    if (outValid) {
+      HLT_PROFILE_SCOPE("returnOutput");
+      writeToLog(SimLogEvent::PopOutput, numPopped++);
+      assert(pendingOutputs != 0 &&
+             "Simulator produced an output without a pending input");
+      if (link) {
+        uint64_t arrival = link->transferOut(outBytes.front(), sim->time());
+        outTransfers.push_back({arrival, sim->popOutput()});
+        outBytes.pop_front();
+      } else
+        returnOutput(sim->popOutput());
       to.reset();
+      hostActivity = true;
       cont |= true;
     }
 
-    // Rule 3: If someone is awaiting output then always step
-    if (!queues.outReq.empty()) {
-      if (!queues.out.empty()) {
-        writeToLog("OUT TO WAITER");
-        queues.outReq.pop().get()->notify_all();
-      }
+    // Rule 3: If an input is queued or in-flight then always step
+    if (hostHasInput || pendingOutputs != 0 || linkBusy())
       cont |= true;
-    }
 
     return cont;
   }
 
-  /// Checks the current exception pointer of the runner, and rethrows, if any.
-  void checkError() {
-    epLock.lock();
-    std::exception_ptr epCopy = ep;
-    epLock.unlock();
-    if (epCopy)
-      std::rethrow_exception(epCopy);
+  // Applies the rules of the host link: inputs are taken from the host as
+  // soon as the link may transfer them, and transferred outputs are returned.
+  // Returns true if any input or output was transferred.
+  bool applyLinkRules() {
+    bool transferred = false;
+    if (hostHasInput &&
+        link->mayTransferIn(!inTransfers.empty() || pendingOutputs != 0)) {
+      auto req = queues.in.pop();
+      hostHasInput = !queues.in.empty();
+      callStarts.push_back(sim->time());
+      writeToLog(SimLogEvent::TransferInput, numPushed + inTransfers.size());
+      uint64_t arrival =
+          link->transferIn(HostLink::inputBytes(req.input), sim->time());
+      inTransfers.push_back({arrival, std::move(req)});
+      transferred = true;
+    }
+    if (!outTransfers.empty() && outTransfers.front().first <= sim->time()) {
+      returnOutput(std::move(outTransfers.front().second));
+      outTransfers.pop_front();
+      transferred = true;
+    }
+    // Waiting for a transfer is progress of the simulation, as long as the
+    // simulator advances in time.
+    if (linkBusy() && sim->time() != lastLinkTime)
+      to.reset();
+    lastLinkTime = sim->time();
+    hostActivity |= transferred;
+    return transferred;
   }
 
-private:
-  // Awakes anyone currently waiting for an output.
-  void awakenAll() {
-    queues.outReq.lock.lock();
-    for (auto &l : queues.outReq.list)
-      l->notify_all();
-    queues.outReq.lock.unlock();
+  // Returns the output of the oldest pending input to the driver.
+  void returnOutput(TOutput &&output) {
+    uint64_t latency = sim->time() - callStarts.front();
+    lastCycles.store(latency, std::memory_order_relaxed);
+    SimSampler::get().record(instance, latency, sim->time());
+    callStarts.pop_front();
+    uint64_t seq = nextOutput++;
+    queues.out.deliver(seq, std::move(output));
+    --pendingOutputs;
+    writeToLog(SimLogEvent::OutToWaiter, seq);
+  }
+
+  // Returns true if the host link is transferring any call.
+  bool linkBusy() const {
+    return !inTransfers.empty() || !outTransfers.empty();
+  }
+
+  // Steps the model in a tight loop while it is busy with an internal
+  // computation, bypassing preStep.
+  void fastForward() {
+    if (HLT_FAST_FORWARD <= 1 || hostHasInput || linkBusy())
+      return;
+    keepAliveFired = false;
+    for (unsigned i = 1; i < HLT_FAST_FORWARD && !to.timedOut(); ++i) {
+      if (keepAliveFired || sim->outValid() || sim->inReady() != lastInReady ||
+          sim->deadlocked())
+        break;
+      sim->step();
+      to.inc();
+      checkCycleLimit();
+      checkpoint();
+      debugStep();
+    }
+  }
+
+  // Exits the process once the simulation reaches the cycle limit of
+  // HLT_MAX_CYCLES, if any, with HLT_CYCLE_LIMIT_EXIT_CODE. Design-space
+  // exploration limits the simulation of a design point to the cycles within
+  // which it could still beat the best point known (see
+  // eval/ExperimentRunner.py); the simulation is then of no further use, so
+  // the process exits from the runner rather than unwinding the testbench.
+  // The event logs of the process are closed first.
+  void checkCycleLimit() {
+    if (maxCycles == 0 || sim->time() < maxCycles)
+      return;
+    writeToLog(SimLogEvent::CycleLimit);
+    SimLog::closeAll();
+    std::cerr << "Cycle limit of " << maxCycles << " cycles reached.\n";
+    std::cerr.flush();
+    std::fflush(nullptr);
+    std::_Exit(HLT_CYCLE_LIMIT_EXIT_CODE);
+  }
+
+  // Writes a checkpoint of the simulation state every HLT_CHECKPOINT_INTERVAL
+  // steps.
+  void checkpoint() {
+    if (HLT_CHECKPOINT_INTERVAL == 0 ||
+        sim->time() % HLT_CHECKPOINT_INTERVAL != 0)
+      return;
+    std::string path = "checkpoint_";
+    if (instance != 0)
+      path += std::to_string(instance) + "_";
+    path += std::to_string(sim->time()) + ".ckpt";
+    if (sim->saveCheckpoint(path))
+      writeToLog(SimLogEvent::Checkpoint);
+  }
+
+  // Starts the debug server of the simulator, listening on HLT_DEBUG_PORT
+  // (offset by the instance index). If HLT_DEBUG_WAIT is set, waits for a
+  // client to connect and starts the simulation paused.
+  void startDebugServer() {
+#if HLT_DEBUG_SERVER
+    unsigned port = HLT_DEBUG_PORT;
+    if (const char *env = std::getenv("HLT_DEBUG_PORT"))
+      port = std::atoi(env);
+    port += instance;
+    debugServer = std::make_unique<SimDebugServer>();
+    sim->addDebugSignals(*debugServer);
+    if (!debugServer->listen(port, std::getenv("HLT_DEBUG_WAIT") != nullptr)) {
+      std::cerr << "Failed to start the debug server on port " << port
+                << ".\n";
+      std::abort();
+    }
+#endif
+  }
+
+  // Serves the debug client after each step of the simulation.
+  void debugStep() {
+#if HLT_DEBUG_SERVER
+    debugServer->onStep(sim->time());
+#endif
+  }
+
+  // Resets the simulator in place, as requested through requestReset.
+  void resetSim() {
+    std::lock_guard<std::mutex> l(resetLock);
+    assert(pendingOutputs == 0 && queues.in.empty() &&
+           inTransfers.empty() &&
+           "Resetting the simulator with inputs in flight");
+    sim->resetInPlace();
+    writeToLog(SimLogEvent::Reset);
+    to.reset();
+    lastInReady = lastOutValid = false;
+    resetRequested = false;
+    resetPromise.set_value();
+  }
+
+  // Fails the outputs of all in-flight and queued inputs with the current
+  // exception pointer. The runner is the sole consumer of the input queue, so
+  // this drains the queue. The inputs in the simulator were pushed before
+  // those which the host link transfers, which were pushed before the queued
+  // ones, so the failed outputs follow the returned ones in order.
+  void failPending() {
+    uint64_t numFailed = pendingOutputs + inTransfers.size();
+    pendingOutputs = 0;
+    callStarts.clear();
+    inTransfers.clear();
+    outTransfers.clear();
+    outBytes.clear();
+    typename SimQueuesImpl::InputRequest req;
+    while (queues.in.tryPop(req))
+      ++numFailed;
+    for (; numFailed != 0; --numFailed)
+      queues.out.fail(nextOutput++, ep);
   }
 
   // Sets the exception pointer due to a timeout error.
@@ -147,22 +603,137 @@ private:
     } catch (...) {
       ep = std::current_exception();
     }
+    failPending();
     epLock.unlock();
-    awakenAll();
   }
 
+  // Sets the exception pointer due to a deadlock of the simulator, with the
+  // simulator's diagnosis of the deadlock.
+  void raiseDeadlockError() {
+    epLock.lock();
+    try {
+      std::stringstream ss;
+      ss << "Deadlock detected after " << sim->time()
+         << " steps, with calls in flight!\n";
+      sim->dumpDeadlock(ss);
+      throw std::runtime_error(ss.str());
+    } catch (...) {
+      ep = std::current_exception();
+    }
+    deadlocked = true;
+    failPending();
+    epLock.unlock();
+  }
+
+#if HLT_STREAM_CHECK
+  // Sets the exception pointer due to an output of the simulator which does
+  // not match the expected output of its call.
+  void raiseMismatchError() {
+    epLock.lock();
+    try {
+      std::stringstream ss;
+      ss << "Mismatch detected after " << sim->time() << " steps!\n";
+      sim->dumpMismatch(ss);
+      throw std::runtime_error(ss.str());
+    } catch (...) {
+      ep = std::current_exception();
+    }
+    failPending();
+    epLock.unlock();
+  }
+#endif
+
   std::thread thread;
 
-  // A condition variable which we use to sleep/awake the runner.
+  // A condition variable which we use to sleep/awake the runner, once it
+  // has spun on the wakeup epoch without being woken up. The epoch is
+  // incremented by each wakeup() call, and seenEpoch is its value when the
+  // runner last woke up.
   std::condition_variable notifier;
+  std::mutex sleepLock;
+  std::atomic<uint64_t> wakeupEpoch{0};
+  uint64_t seenEpoch = 0;
+  std::atomic<bool> parked{false};
+  AdaptiveSpin sleepSpin;
+
   std::unique_ptr<Sim> sim;
   SimQueuesImpl &queues;
+  unsigned instance;
+
+  // The scheduler which runs the runner as a task, if any. 'scheduled' is set
+  // while the task is queued or running, and 'finished' is fulfilled once the
+  // task has finished the simulator.
+  SimScheduler *scheduler;
+  std::atomic<bool> scheduled{false};
+  std::promise<void> finished;
+  std::future<void> finishedFuture;
 
   std::mutex epLock;
   std::exception_ptr ep;
 
+  // Set by requestReset; the promise is fulfilled once the runner has reset
+  // the simulator.
+  std::atomic<bool> resetRequested{false};
+
+  // Set by the destructor; the runner stops the next time that it is idle.
+  std::atomic<bool> stopRequested{false};
+  // Set by suspend; the runner thread exits the next time that it is idle.
+  std::atomic<bool> suspendRequested{false};
+  std::mutex resetLock;
+  std::promise<void> resetPromise;
+
   // A counter to manage timeout'ing this simulation thread.
   TimeoutCounter to;
+
+  // The cycle limit of HLT_MAX_CYCLES, or 0 if the simulation is unlimited.
+  uint64_t maxCycles = 0;
+
+  // Number of inputs which have been pushed to the simulator, whose outputs
+  // have not yet been returned, and the sequence number of the next returned
+  // or failed output (see SimResultRing).
+  uint64_t pendingOutputs = 0;
+  uint64_t nextOutput = 0;
+
+  // The cycles at which the inputs of the calls in flight were taken from the
+  // driver, and the cycles of the last returned call; see lastCallCycles.
+  std::deque<uint64_t> callStarts;
+  std::atomic<uint64_t> lastCycles{0};
+
+  // Cached host-side queue state, and the model state at the previous step;
+  // see pollHost.
+  unsigned pollCntr = 0;
+  bool hostHasInput = false;
+  bool lastInReady = false;
+  bool lastOutValid = false;
+
+  // Number of inputs pushed to, and outputs popped from, the simulator. These
+  // identify the calls in the event log.
+  uint32_t numPushed = 0;
+  uint32_t numPopped = 0;
+
+  // The host link, if modelled (see HostLink.h). Inputs which are being
+  // transferred to the simulator and outputs which are being transferred back
+  // are held along with the cycle at which their transfer arrives. 'outBytes'
+  // holds the bytes which each call in the simulator transfers back.
+  std::optional<HostLink> link;
+  std::deque<std::pair<uint64_t, typename SimQueuesImpl::InputRequest>>
+      inTransfers;
+  std::deque<std::pair<uint64_t, TOutput>> outTransfers;
+  std::deque<uint64_t> outBytes;
+  uint64_t lastLinkTime = 0;
+
+  // Set if the last call to applyRules pushed or popped a value.
+  bool hostActivity = false;
+
+  // Set whenever the model signals keepAlive.
+  bool keepAliveFired = false;
+
+  // Set if the runner stopped due to a deadlock of the simulator.
+  bool deadlocked = false;
+
+#if HLT_DEBUG_SERVER
+  std::unique_ptr<SimDebugServer> debugServer;
+#endif
 };
 
 } // namespace hlt
@@ -0,0 +1,198 @@
+#ifndef CIRCT_TOOLS_HLT_SIMSAMPLE_H
+#define CIRCT_TOOLS_HLT_SIMSAMPLE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <ostream>
+
+// Sampled simulation of testbenches with many kernel calls, which only
+// simulate calls until their latency and interval have reached a steady state
+// (see cosim-lower-call{steady-state}).
+
+namespace circt {
+namespace hlt {
+
+/// Once HLT_SAMPLE is set, measures the calls of each simulator after its
+/// first HLT_SAMPLE_WARMUP calls (100 by default). The steady state is reached
+/// once HLT_SAMPLE_MIN_CALLS calls (30) have been measured, and the 95%
+/// confidence intervals of their means are within HLT_SAMPLE_PRECISION (0.02)
+/// of the means. The extrapolated cycles of the workload are written to
+/// $HLT_SAMPLE_REPORT (sample_report.json) when the process exits.
+class SimSampler {
+  // Running mean and variance of a metric (Welford's algorithm).
+  struct Moments {
+    uint64_t n = 0;
+    double mean = 0;
+    double m2 = 0;
+
+    void add(double x) {
+      ++n;
+      double delta = x - mean;
+      mean += delta / n;
+      m2 += delta * (x - mean);
+    }
+
+    /// Returns the half-width of the 95% confidence interval of the mean.
+    double halfWidth() const {
+      return n > 1 ? 1.96 * std::sqrt(m2 / (n - 1) / n) : 0;
+    }
+  };
+
+  struct Instance {
+    uint64_t calls = 0;
+    uint64_t lastOutput = 0;
+  };
+
+public:
+  /// Returns the sampler of the process. The sampler is never destroyed; the
+  /// report is written by an exit handler.
+  static SimSampler &get() {
+    static SimSampler *sampler = []() {
+      auto *s = new SimSampler();
+      if (s->enabled)
+        std::atexit([]() { get().report(); });
+      return s;
+    }();
+    return *sampler;
+  }
+
+  /// Records the output of a call of the simulator 'instance', which had a
+  /// latency of 'latency' cycles and was returned at cycle 'time'.
+  void record(unsigned instance, uint64_t latency, uint64_t time) {
+    if (!enabled)
+      return;
+    std::lock_guard<std::mutex> l(lock);
+    Instance &inst = instances[instance];
+    // The interval of the first measured call is that since the last call of
+    // the warm-up.
+    if (inst.calls++ >= warmup) {
+      latencies.add(latency);
+      intervals.add(time - inst.lastOutput);
+      if (!steady && latencies.n >= minCalls && isPrecise(latencies) &&
+          isPrecise(intervals)) {
+        steady = true;
+        steadyCalls = simulatedCalls();
+      }
+    }
+    inst.lastOutput = time;
+  }
+
+  /// Returns true if the next call should be skipped, i.e. once the steady
+  /// state has been reached, and counts it as skipped.
+  bool skip() {
+    if (!enabled)
+      return false;
+    std::lock_guard<std::mutex> l(lock);
+    if (!steady)
+      return false;
+    ++skipped;
+    return true;
+  }
+
+private:
+  SimSampler() {
+    enabled = std::getenv("HLT_SAMPLE") != nullptr;
+    if (const char *env = std::getenv("HLT_SAMPLE_WARMUP"))
+      warmup = std::strtoull(env, nullptr, 10);
+    if (const char *env = std::getenv("HLT_SAMPLE_MIN_CALLS"))
+      minCalls = std::max<uint64_t>(2, std::strtoull(env, nullptr, 10));
+    if (const char *env = std::getenv("HLT_SAMPLE_PRECISION"))
+      precision = std::strtod(env, nullptr);
+  }
+
+  bool isPrecise(const Moments &m) const {
+    return m.halfWidth() <= precision * std::abs(m.mean);
+  }
+
+  uint64_t simulatedCalls() const {
+    uint64_t calls = 0;
+    for (auto &it : instances)
+      calls += it.second.calls;
+    return calls;
+  }
+
+  // Prints the extrapolated cycles of the workload, and writes the report. The
+  // skipped calls are assumed to be issued back to back, as the measured ones
+  // were, and to be spread evenly over the simulators.
+  void report() {
+    std::lock_guard<std::mutex> l(lock);
+    uint64_t simCycles = 0;
+    for (auto &it : instances)
+      simCycles = std::max(simCycles, it.second.lastOutput);
+    double perInstance =
+        instances.empty() ? 0 : double(skipped) / instances.size();
+    double estimate = simCycles + perInstance * intervals.mean;
+    double bound = perInstance * intervals.halfWidth();
+
+    std::printf("HLT sampling: ");
+    if (steady)
+      std::printf("reached the steady state after %llu calls; ",
+                  static_cast<unsigned long long>(steadyCalls));
+    else
+      std::printf("did not reach the steady state; ");
+    std::printf("simulated %llu calls in %llu cycles, and skipped %llu calls."
+                "\n",
+                static_cast<unsigned long long>(simulatedCalls()),
+                static_cast<unsigned long long>(simCycles),
+                static_cast<unsigned long long>(skipped));
+    std::printf("HLT sampling: mean latency %.2f +- %.2f cycles, mean "
+                "interval %.2f +- %.2f cycles; extrapolated %.0f +- %.0f "
+                "cycles.\n",
+                latencies.mean, latencies.halfWidth(), intervals.mean,
+                intervals.halfWidth(), estimate, bound);
+    std::fflush(stdout);
+
+    const char *env = std::getenv("HLT_SAMPLE_REPORT");
+    std::ofstream os(env ? env : "sample_report.json");
+    os << "{\"steady\": " << (steady ? "true" : "false")
+       << ", \"steadyCalls\": " << steadyCalls
+       << ", \"simulatedCalls\": " << simulatedCalls()
+       << ", \"skippedCalls\": " << skipped
+       << ", \"simulatedCycles\": " << simCycles << ", \"latency\": ";
+    dumpMoments(os, latencies);
+    os << ", \"ii\": ";
+    dumpMoments(os, intervals);
+    auto cycles = [](double c) { return std::llround(std::max(0.0, c)); };
+    os << ", \"cycles\": {\"estimate\": " << cycles(estimate)
+       << ", \"low\": " << cycles(estimate - bound)
+       << ", \"high\": " << cycles(estimate + bound) << "}}\n";
+  }
+
+  static void dumpMoments(std::ostream &os, const Moments &m) {
+    os << "{\"samples\": " << m.n << ", \"mean\": " << m.mean
+       << ", \"ci95\": " << m.halfWidth() << "}";
+  }
+
+  bool enabled = false;
+  uint64_t warmup = 100;
+  uint64_t minCalls = 30;
+  double precision = 0.02;
+
+  std::mutex lock;
+  std::map<unsigned, Instance> instances;
+  Moments latencies;
+  Moments intervals;
+  bool steady = false;
+  // Number of calls which had been simulated when the steady state was
+  // reached.
+  uint64_t steadyCalls = 0;
+  uint64_t skipped = 0;
+};
+
+} // namespace hlt
+} // namespace circt
+
+/// Returns nonzero if the next call of the testbench should only run the
+/// reference, since the simulation has reached its steady state; see
+/// SimSampler.
+extern "C" int32_t hlt_sample_skip() {
+  return circt::hlt::SimSampler::get().skip() ? 1 : 0;
+}
+
+#endif // CIRCT_TOOLS_HLT_SIMSAMPLE_H
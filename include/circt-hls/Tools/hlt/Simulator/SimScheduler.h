@@ -0,0 +1,166 @@
+#ifndef CIRCT_TOOLS_HLT_SIMSCHEDULER_H
+#define CIRCT_TOOLS_HLT_SIMSCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "circt-hls/Tools/hlt/Simulator/HostAffinity.h"
+#include "circt-hls/Tools/hlt/Simulator/SimInterface.h"
+
+#ifndef HLT_SCHEDULER_QUANTUM
+// Maximum number of steps which a runner takes each time that a worker of the
+// simulator scheduler runs it, before the worker runs other runners.
+#define HLT_SCHEDULER_QUANTUM 1024
+#endif
+
+// Cooperative scheduling of the simulators of a process onto a pool of worker
+// threads. By default, each runner steps its simulator on a thread of its own,
+// which mostly sleeps for small kernels; a process which simulates many
+// kernels, or many instances of a kernel, then spawns as many threads. If
+// HLT_SIM_WORKERS is set, runners are instead tasks of a pool of that many
+// workers (or one per hardware thread, if 0). A runner task steps its
+// simulator for a quantum of steps, after which it is rescheduled, and leaves
+// the pool while it is idle, until it is woken up by its driver. Each worker
+// runs the tasks of its own queue in order, and steals tasks from the queues
+// of other workers when its queue is empty. Worker 'i' is pinned as the runner
+// of instance 'i' would be (see HostAffinity.h).
+
+namespace circt {
+namespace hlt {
+
+/// A task of the simulator scheduler.
+class SimTask {
+public:
+  virtual ~SimTask() = default;
+
+  /// Runs a quantum of the task. A task which should run again resubmits
+  /// itself to the scheduler.
+  virtual void runTask() = 0;
+};
+
+class SimScheduler {
+  struct Worker {
+    std::mutex lock;
+    std::deque<SimTask *> tasks;
+    std::thread thread;
+  };
+
+public:
+  /// Returns the scheduler of the process, or nullptr if HLT_SIM_WORKERS is
+  /// not set, in which case each runner runs on its own thread.
+  static SimScheduler *get() {
+    // The scheduler is never destroyed, since the runners of simulators which
+    // outlive it would be stranded.
+    static SimScheduler *scheduler = []() -> SimScheduler * {
+      const char *env = std::getenv("HLT_SIM_WORKERS");
+      if (!env || !*env)
+        return nullptr;
+      unsigned size = std::atoi(env);
+      if (size == 0)
+        size = std::max(1U, std::thread::hardware_concurrency());
+      return new SimScheduler(size);
+    }();
+    return scheduler;
+  }
+
+  explicit SimScheduler(unsigned size) : workers(size) {
+    for (unsigned i = 0; i < size; ++i)
+      workers[i].thread = std::thread(&SimScheduler::work, this, i);
+  }
+  SimScheduler(const SimScheduler &) = delete;
+  SimScheduler &operator=(const SimScheduler &) = delete;
+
+  /// Queues 'task' to be run by a worker. Tasks submitted by a worker are
+  /// queued on that worker, and other tasks are spread over the workers.
+  void submit(SimTask *task) {
+    unsigned idx = currentWorker() != kNoWorker
+                       ? currentWorker()
+                       : nextWorker.fetch_add(1) % workers.size();
+    // Both counters are sequentially consistent, such that either a parking
+    // worker sees the queued task, or this sees the worker parked. The task
+    // is counted before it is queued, such that the count never underflows.
+    numQueued.fetch_add(1);
+    {
+      std::lock_guard<std::mutex> l(workers[idx].lock);
+      workers[idx].tasks.push_back(task);
+    }
+    if (numParked.load() != 0) {
+      std::lock_guard<std::mutex> l(parkLock);
+      parkNotifier.notify_one();
+    }
+  }
+
+  unsigned size() const { return workers.size(); }
+
+private:
+  static constexpr unsigned kNoWorker = ~0U;
+
+  // Returns the index of the worker of the calling thread, or kNoWorker.
+  static unsigned &currentWorker() {
+    static thread_local unsigned idx = kNoWorker;
+    return idx;
+  }
+
+  void work(unsigned idx) {
+    currentWorker() = idx;
+    pinRunnerThread(idx);
+    HLT_PROFILE_THREAD_NAME("worker " + std::to_string(idx));
+    AdaptiveSpin spin;
+    while (true) {
+      if (SimTask *task = take(idx)) {
+        task->runTask();
+        continue;
+      }
+      auto queued = [this]() { return numQueued.load() != 0; };
+      if (spin.spinUntil(queued))
+        continue;
+      std::unique_lock<std::mutex> ul(parkLock);
+      ++numParked;
+      parkNotifier.wait(ul, queued);
+      --numParked;
+    }
+  }
+
+  // Takes the oldest task of the queue of worker 'idx', or steals the newest
+  // task of another worker. Returns nullptr if all queues are empty.
+  SimTask *take(unsigned idx) {
+    for (unsigned i = 0; i < workers.size(); ++i) {
+      Worker &worker = workers[(idx + i) % workers.size()];
+      std::lock_guard<std::mutex> l(worker.lock);
+      if (worker.tasks.empty())
+        continue;
+      SimTask *task;
+      if (i == 0) {
+        task = worker.tasks.front();
+        worker.tasks.pop_front();
+      } else {
+        task = worker.tasks.back();
+        worker.tasks.pop_back();
+      }
+      numQueued.fetch_sub(1);
+      return task;
+    }
+    return nullptr;
+  }
+
+  std::vector<Worker> workers;
+  std::atomic<unsigned> nextWorker{0};
+
+  // Number of queued tasks, and of workers parked on parkNotifier.
+  std::atomic<size_t> numQueued{0};
+  std::atomic<unsigned> numParked{0};
+  std::mutex parkLock;
+  std::condition_variable parkNotifier;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_SIMSCHEDULER_H
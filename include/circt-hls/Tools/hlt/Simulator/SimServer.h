@@ -0,0 +1,792 @@
+#ifndef CIRCT_TOOLS_HLT_SIMSERVER_H
+#define CIRCT_TOOLS_HLT_SIMSERVER_H
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "circt-hls/Tools/hlt/Simulator/MemoryInterface.h"
+#include "circt-hls/Tools/hlt/Simulator/SimInterface.h"
+
+#ifndef HLT_SIM_SERVER_TIMEOUT
+// Number of seconds that a simulation server waits for a testbench to connect
+// before exiting. Overridden at runtime through the HLT_SIM_SERVER_TIMEOUT
+// environment variable; 0 waits indefinitely.
+#define HLT_SIM_SERVER_TIMEOUT 600
+#endif
+
+//===----------------------------------------------------------------------===//
+// Simulation server
+//===----------------------------------------------------------------------===//
+//
+// A simulation server is a long-lived process which owns the model of a kernel,
+// and which serves the calls of testbenches that connect to it over a Unix
+// socket. The model is reset in place between testbenches, such that each
+// testbench skips loading and starting the model.
+//
+// Testbenches live in a separate process from the model, so memories are not
+// shared. The host memory which a memref argument views is copied to the
+// server when a call is made, unless a call which views the same host memory
+// is still in flight, and copied back to the testbench when the call is
+// awaited. Memories are thus synchronized at call boundaries only. All views
+// of a host memory within a run must lie within the region viewed by the
+// first call of the run.
+//
+// Messages are exchanged in the native layout of the host, since both ends
+// run on the same machine:
+//   call:    'C', u64 tag, u32 #regions, region..., input...
+//            region: u64 key, u64 addr, u64 bytes, u8 has data, [data]
+//            input:  the bytes of a scalar, or for a memref: u64 key,
+//                    u64 addr, i64 sizes[rank], i64 strides[rank].
+//   await:   'P' (in order) or 'T' (in any order), answered by
+//            'O', u64 tag, output..., u32 #regions, (u64 key, u64 addr,
+//            u64 bytes, data)...
+//            or 'E', u32 length, error message.
+// A region is a contiguous range of a host memory, identified by 'key', the
+// aligned pointer of the memref.
+
+namespace circt {
+namespace hlt {
+
+/// A stream socket connection, which buffers writes until flushed. Any failed
+/// read or write closes the connection; the reads thereafter return zeros.
+class SimServerConnection {
+public:
+  explicit SimServerConnection(int fd = -1) : fd(fd) {}
+  ~SimServerConnection() { close(); }
+  SimServerConnection(const SimServerConnection &) = delete;
+  SimServerConnection &operator=(const SimServerConnection &) = delete;
+
+  bool connected() const { return fd >= 0; }
+
+  void close() {
+    if (fd >= 0)
+      ::close(fd);
+    fd = -1;
+    tx.clear();
+    rx.clear();
+    rxPos = 0;
+  }
+
+  void write(const void *data, size_t n) {
+    auto *bytes = static_cast<const char *>(data);
+    tx.insert(tx.end(), bytes, bytes + n);
+  }
+  template <typename T>
+  void write(const T &value) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Only trivially copyable values can be sent");
+    write(&value, sizeof(T));
+  }
+
+  bool flush() {
+    size_t sent = 0;
+    while (fd >= 0 && sent < tx.size()) {
+      ssize_t n = ::send(fd, tx.data() + sent, tx.size() - sent, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        close();
+      else
+        sent += n;
+    }
+    tx.clear();
+    return connected();
+  }
+
+  bool read(void *data, size_t n) {
+    auto *bytes = static_cast<char *>(data);
+    while (n != 0) {
+      if (rxPos == rx.size()) {
+        rx.resize(kReadChunk);
+        rxPos = 0;
+        ssize_t got = fd >= 0 ? ::recv(fd, rx.data(), rx.size(), 0) : 0;
+        if (got < 0 && errno == EINTR) {
+          rx.clear();
+          continue;
+        }
+        if (got <= 0) {
+          close();
+          std::memset(bytes, 0, n);
+          return false;
+        }
+        rx.resize(got);
+      }
+      size_t chunk = std::min(n, rx.size() - rxPos);
+      std::memcpy(bytes, rx.data() + rxPos, chunk);
+      rxPos += chunk;
+      bytes += chunk;
+      n -= chunk;
+    }
+    return true;
+  }
+  template <typename T>
+  T read() {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Only trivially copyable values can be received");
+    T value;
+    read(&value, sizeof(T));
+    return value;
+  }
+
+private:
+  static constexpr size_t kReadChunk = 1 << 16;
+  int fd;
+  std::vector<char> tx;
+  std::vector<char> rx;
+  size_t rxPos = 0;
+};
+
+namespace detail {
+
+inline bool makeSockAddr(const std::string &path, sockaddr_un &addr) {
+  addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+    return false;
+  std::strcpy(addr.sun_path, path.c_str());
+  return true;
+}
+
+// Returns a socket connected to the server at 'path', or -1.
+inline int connectToServer(const std::string &path) {
+  sockaddr_un addr;
+  if (!makeSockAddr(path, addr))
+    return -1;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+} // namespace detail
+
+/// The testbench end of a simulation server. Calls are forwarded to the server
+/// at 'path', which must be running.
+template <typename TInput, typename TOutput>
+class SimClient {
+public:
+  SimClient(const std::string &path) : path(path) {
+    int fd = detail::connectToServer(path);
+    if (fd < 0)
+      fail("could not connect: " + std::string(std::strerror(errno)));
+    conn = std::make_unique<SimServerConnection>(fd);
+  }
+
+  /// Non-blocking. Sends the call to the server, which starts simulating it
+  /// once the call has been decoded.
+  void push(uint64_t tag, const TInput &in) {
+    writeCall(tag, in);
+    if (!conn->flush())
+      fail("lost connection");
+  }
+
+  /// Non-blocking. Sends all calls of the batch at once.
+  void pushBatch(const std::vector<TInput> &in) {
+    for (auto &v : in)
+      writeCall(0, v);
+    if (!conn->flush())
+      fail("lost connection");
+  }
+
+  /// Blocking. Awaits the output of the oldest call if 'inOrder' is set, or of
+  /// any call otherwise, and copies the memories of the call back to the
+  /// testbench.
+  std::pair<uint64_t, TOutput> pop(bool inOrder) {
+    requestOutput(inOrder);
+    return readOutput();
+  }
+
+  /// Non-blocking. Requests the output of the oldest call if 'inOrder' is
+  /// set, or of any call otherwise, which is then read by readOutput. A
+  /// thread may read an output while others push calls and request outputs,
+  /// as long as pushes and requests are serialized.
+  void requestOutput(bool inOrder) {
+    conn->write<uint8_t>(inOrder ? 'P' : 'T');
+    if (!conn->flush())
+      fail("lost connection");
+  }
+
+  /// Blocking. Reads the output of a call requested by requestOutput, and
+  /// copies the memories of the call back to the testbench.
+  std::pair<uint64_t, TOutput> readOutput() {
+    auto kind = conn->read<uint8_t>();
+    if (kind == 'E') {
+      std::string msg(conn->read<uint32_t>(), '\0');
+      conn->read(msg.data(), msg.size());
+      fail(msg);
+    }
+    if (kind != 'O' || !conn->connected())
+      fail("lost connection");
+    auto tag = conn->read<uint64_t>();
+    TOutput out;
+    std::apply([&](auto &...value) { (readOutputValue(value), ...); }, out);
+    auto numRegions = conn->read<uint32_t>();
+    for (uint32_t i = 0; i < numRegions; ++i) {
+      auto key = conn->read<uint64_t>();
+      auto addr = conn->read<uint64_t>();
+      auto bytes = conn->read<uint64_t>();
+      conn->read(reinterpret_cast<void *>(addr), bytes);
+      std::lock_guard<std::mutex> l(inFlightLock);
+      --inFlight[key];
+    }
+    if (!conn->connected())
+      fail("lost connection");
+    return {tag, out};
+  }
+
+  /// Blocking. Awaits the outputs of the n oldest calls.
+  void popBatch(TOutput *out, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      conn->write<uint8_t>('P');
+    if (!conn->flush())
+      fail("lost connection");
+    for (size_t i = 0; i < n; ++i)
+      out[i] = readOutput().second;
+  }
+
+private:
+  struct Region {
+    uintptr_t begin;
+    uintptr_t end;
+  };
+
+  [[noreturn]] void fail(const std::string &msg) {
+    std::cerr << "Simulation server '" << path << "': " << msg << "\n";
+    std::abort();
+  }
+
+  void writeCall(uint64_t tag, const TInput &in) {
+    // Merge the views of each host memory into a single region.
+    std::map<uintptr_t, Region> regions;
+    std::apply([&](const auto &...value) { (addRegion(regions, value), ...); },
+               in);
+
+    conn->write<uint8_t>('C');
+    conn->write(tag);
+    conn->write<uint32_t>(regions.size());
+    for (auto &[key, region] : regions) {
+      // Memories of calls in flight are owned by the server until the calls
+      // are awaited.
+      bool hasData;
+      {
+        std::lock_guard<std::mutex> l(inFlightLock);
+        hasData = inFlight[key]++ == 0;
+      }
+      conn->write<uint64_t>(key);
+      conn->write<uint64_t>(region.begin);
+      conn->write<uint64_t>(region.end - region.begin);
+      conn->write<uint8_t>(hasData);
+      if (hasData)
+        conn->write(reinterpret_cast<const void *>(region.begin),
+                    region.end - region.begin);
+    }
+    std::apply([&](const auto &...value) { (writeInput(value), ...); }, in);
+  }
+
+  template <typename T>
+  void addRegion(std::map<uintptr_t, Region> &regions, const T &value) {
+    if constexpr (IsMemRefDescriptor<T>::value) {
+      size_t bytes = viewBytes(value);
+      if (bytes == 0)
+        fail("memref arguments of unknown size cannot be simulated remotely");
+      auto key = reinterpret_cast<uintptr_t>(value.aligned);
+      auto begin = reinterpret_cast<uintptr_t>(value.aligned + value.offset);
+      Region region{begin, begin + bytes};
+      auto it = regions.try_emplace(key, region).first;
+      it->second.begin = std::min(it->second.begin, region.begin);
+      it->second.end = std::max(it->second.end, region.end);
+    }
+  }
+
+  template <typename T>
+  void writeInput(const T &value) {
+    if constexpr (IsMemRefDescriptor<T>::value) {
+      conn->write<uint64_t>(reinterpret_cast<uintptr_t>(value.aligned));
+      conn->write<uint64_t>(
+          reinterpret_cast<uintptr_t>(value.aligned + value.offset));
+      conn->write(value.sizes);
+      conn->write(value.strides);
+    } else if constexpr (std::is_trivially_copyable_v<T> &&
+                         !std::is_pointer_v<T>) {
+      conn->write(value);
+    } else {
+      fail("unsupported input type");
+    }
+  }
+
+  template <typename T>
+  void readOutputValue(T &value) {
+    if constexpr (std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>)
+      value = conn->read<T>();
+    else
+      fail("unsupported output type");
+  }
+
+  std::string path;
+  std::unique_ptr<SimServerConnection> conn;
+  // Number of calls in flight which view each host memory. Outputs may be
+  // read while calls are pushed, so the counts are guarded.
+  std::map<uintptr_t, unsigned> inFlight;
+  std::mutex inFlightLock;
+};
+
+/// The server end of a simulation server, which simulates the calls of each
+/// connected testbench through 'driver' (a SimDriver or SimDriverPool).
+template <typename TInput, typename TOutput, typename TDriver>
+class SimServer {
+public:
+  SimServer(TDriver &driver) : driver(driver) {}
+
+  /// Serves testbenches at the Unix socket 'path', one at a time, until no
+  /// testbench has connected for HLT_SIM_SERVER_TIMEOUT seconds. Returns
+  /// non-zero if the socket could not be created or the simulation failed.
+  int serve(const std::string &path) {
+    sockaddr_un addr;
+    if (!detail::makeSockAddr(path, addr)) {
+      std::cerr << "Simulation server socket path too long: " << path << "\n";
+      return 1;
+    }
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0)
+      return 1;
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) {
+      // Another server may have been started for the same model concurrently,
+      // or a stale socket was left behind by a server which was killed.
+      int fd = detail::connectToServer(path);
+      if (fd >= 0) {
+        close(fd);
+        close(listenFd);
+        std::cout << "Simulation server already running at " << path
+                  << std::endl;
+        return 0;
+      }
+      unlink(path.c_str());
+      if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) {
+        std::cerr << "Could not bind simulation server to " << path << ": "
+                  << std::strerror(errno) << "\n";
+        close(listenFd);
+        return 1;
+      }
+    }
+    listen(listenFd, 16);
+    std::cout << "Simulation server listening at " << path << std::endl;
+
+    int timeout = HLT_SIM_SERVER_TIMEOUT;
+    if (const char *env = std::getenv("HLT_SIM_SERVER_TIMEOUT"))
+      timeout = std::atoi(env);
+
+    int res = 0;
+    while (true) {
+      pollfd pfd{listenFd, POLLIN, 0};
+      int ready = poll(&pfd, 1, timeout > 0 ? timeout * 1000 : -1);
+      if (ready < 0 && errno == EINTR)
+        continue;
+      if (ready <= 0)
+        break;
+      int fd = accept(listenFd, nullptr, nullptr);
+      if (fd < 0)
+        continue;
+      SimServerConnection conn(fd);
+      debugOut << "SERVER: Testbench connected" << std::endl;
+      if (!serveConnection(conn)) {
+        res = 1;
+        break;
+      }
+      debugOut << "SERVER: Testbench disconnected, resetting" << std::endl;
+      driver.reset();
+      mirrors.clear();
+    }
+    close(listenFd);
+    unlink(path.c_str());
+    return res;
+  }
+
+private:
+  // The server-side copy of a region of a host memory of the testbench.
+  struct Mirror {
+    uint64_t addr;
+    uint64_t bytes;
+    std::unique_ptr<uint64_t[]> data;
+
+    char *at(uint64_t clientAddr) {
+      return reinterpret_cast<char *>(data.get()) + (clientAddr - addr);
+    }
+  };
+
+  struct RegionRef {
+    uint64_t key;
+    uint64_t addr;
+    uint64_t bytes;
+  };
+
+  // Tag and memory regions of a call in flight.
+  struct Call {
+    uint64_t tag;
+    std::vector<RegionRef> regions;
+  };
+
+  // Serves the testbench on 'conn' until it disconnects. All of its calls
+  // have been awaited on return, such that the simulator can be reset.
+  // Returns false if the simulation failed.
+  bool serveConnection(SimServerConnection &conn) {
+    try {
+      while (true) {
+        auto kind = conn.read<uint8_t>();
+        if (!conn.connected())
+          break;
+        switch (kind) {
+        case 'C':
+          if (!readCall(conn))
+            return false;
+          break;
+        case 'P': {
+          TOutput out = driver.pop();
+          uint64_t id = order.front();
+          order.pop_front();
+          writeOutput(conn, id, out);
+          break;
+        }
+        case 'T': {
+          auto [id, out] = driver.popTagged();
+          order.erase(std::find(order.begin(), order.end(), id));
+          writeOutput(conn, id, out);
+          break;
+        }
+        default:
+          return fail(conn, "unknown request");
+        }
+      }
+      // Drain the calls which the testbench did not await.
+      while (!order.empty()) {
+        driver.pop();
+        calls.erase(order.front());
+        order.pop_front();
+      }
+    } catch (std::exception &e) {
+      return fail(conn, e.what());
+    }
+    return true;
+  }
+
+  bool fail(SimServerConnection &conn, const std::string &msg) {
+    std::cerr << "Simulation server: " << msg << "\n";
+    conn.write<uint8_t>('E');
+    conn.write<uint32_t>(msg.size());
+    conn.write(msg.data(), msg.size());
+    conn.flush();
+    return false;
+  }
+
+  bool readCall(SimServerConnection &conn) {
+    Call call;
+    call.tag = conn.read<uint64_t>();
+    auto numRegions = conn.read<uint32_t>();
+    for (uint32_t i = 0; i < numRegions; ++i) {
+      RegionRef ref;
+      ref.key = conn.read<uint64_t>();
+      ref.addr = conn.read<uint64_t>();
+      ref.bytes = conn.read<uint64_t>();
+      bool hasData = conn.read<uint8_t>();
+      auto it = mirrors.find(ref.key);
+      if (it == mirrors.end()) {
+        Mirror mirror{ref.addr, ref.bytes,
+                      std::make_unique<uint64_t[]>((ref.bytes + 7) / 8)};
+        it = mirrors.emplace(ref.key, std::move(mirror)).first;
+      }
+      Mirror &mirror = it->second;
+      if (ref.addr < mirror.addr ||
+          ref.addr + ref.bytes > mirror.addr + mirror.bytes)
+        return fail(conn, "a memory is accessed beyond the region accessed by "
+                          "the first call of the testbench");
+      if (hasData)
+        conn.read(mirror.at(ref.addr), ref.bytes);
+      call.regions.push_back(ref);
+    }
+    TInput in;
+    std::apply([&](auto &...value) { (readInput(conn, value), ...); }, in);
+    if (!conn.connected())
+      return true;
+
+    uint64_t id = nextId++;
+    calls.emplace(id, std::move(call));
+    order.push_back(id);
+    driver.emplaceTagged(id, std::move(in));
+    return true;
+  }
+
+  template <typename T>
+  void readInput(SimServerConnection &conn, T &value) {
+    if constexpr (IsMemRefDescriptor<T>::value) {
+      auto key = conn.read<uint64_t>();
+      auto addr = conn.read<uint64_t>();
+      conn.read(value.sizes, sizeof(value.sizes));
+      conn.read(value.strides, sizeof(value.strides));
+      auto it = mirrors.find(key);
+      if (it == mirrors.end())
+        return;
+      value.allocated = value.aligned =
+          reinterpret_cast<MemoryElementT<T> *>(it->second.at(addr));
+      value.offset = 0;
+    } else if constexpr (std::is_trivially_copyable_v<T> &&
+                         !std::is_pointer_v<T>) {
+      value = conn.read<T>();
+    }
+  }
+
+  void writeOutput(SimServerConnection &conn, uint64_t id, const TOutput &out) {
+    auto it = calls.find(id);
+    assert(it != calls.end() && "Output of an unknown call");
+    conn.write<uint8_t>('O');
+    conn.write(it->second.tag);
+    std::apply(
+        [&](const auto &...value) {
+          (writeOutputValue(conn, value), ...);
+        },
+        out);
+    conn.write<uint32_t>(it->second.regions.size());
+    for (auto &ref : it->second.regions) {
+      conn.write(ref.key);
+      conn.write(ref.addr);
+      conn.write(ref.bytes);
+      conn.write(mirrors.at(ref.key).at(ref.addr), ref.bytes);
+    }
+    calls.erase(it);
+    conn.flush();
+  }
+
+  template <typename T>
+  void writeOutputValue(SimServerConnection &conn, const T &value) {
+    if constexpr (std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>)
+      conn.write(value);
+  }
+
+  TDriver &driver;
+  // Copies of the host memories of the connected testbench, keyed by the
+  // aligned pointers of the memrefs which view them.
+  std::map<uint64_t, Mirror> mirrors;
+  // Calls in flight, keyed by the tag which they were pushed to the driver
+  // with, and these tags in the order that the calls were pushed.
+  std::map<uint64_t, Call> calls;
+  std::deque<uint64_t> order;
+  uint64_t nextId = 0;
+};
+
+/// Drives the simulator through TDriver (a SimDriver or SimDriverPool)
+/// in-process, or, if the HLT_SIM_SERVER environment variable is set, through
+/// the simulation server at '$HLT_SIM_SERVER/<name>.sock'. This exposes the
+/// part of the SimDriver interface which hlt-wrapgen wrappers use.
+template <typename TInput, typename TOutput, typename TDriver>
+class SimServerDriver {
+public:
+  /// 'args' are forwarded to the constructor of TDriver.
+  template <typename... Args>
+  SimServerDriver(const std::string &name, Args &&...args) {
+    if (const char *dir = std::getenv("HLT_SIM_SERVER")) {
+      client = std::make_unique<SimClient<TInput, TOutput>>(
+          std::string(dir) + "/" + name + ".sock");
+      return;
+    }
+    driver = std::make_unique<TDriver>(std::forward<Args>(args)...);
+  }
+
+  /// Blocking. Serves testbenches at the Unix socket 'path'; see SimServer.
+  /// 'args' are forwarded to the constructor of TDriver.
+  template <typename... Args>
+  static int serve(const std::string &path, Args &&...args) {
+    // Drivers are never destroyed, since their runner thread is never joined.
+    auto *driver = new TDriver(std::forward<Args>(args)...);
+    return SimServer<TInput, TOutput, TDriver>(*driver).serve(path);
+  }
+
+  template <typename... Args>
+  void emplace(Args &&...args) {
+    if (client)
+      client->push(0, TInput(std::forward<Args>(args)...));
+    else
+      driver->emplace(std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  void emplaceTagged(uint64_t tag, Args &&...args) {
+    if (client)
+      client->push(tag, TInput(std::forward<Args>(args)...));
+    else
+      driver->emplaceTagged(tag, std::forward<Args>(args)...);
+  }
+
+  /// The outputs of calls which are simulated by a server are only checked
+  /// once they are popped, so the expected output is dropped.
+  template <typename... Args>
+  void
+  emplaceExpected(std::shared_ptr<const SimExpectation<TOutput>> expected,
+                  Args &&...args) {
+    if (client)
+      client->push(0, TInput(std::forward<Args>(args)...));
+    else
+      driver->emplaceExpected(std::move(expected),
+                              std::forward<Args>(args)...);
+  }
+
+  void pushBatch(std::vector<TInput> &&in) {
+    if (client)
+      client->pushBatch(in);
+    else
+      driver->pushBatch(std::move(in));
+  }
+
+  TOutput pop() { return client ? client->pop(true).second : driver->pop(); }
+
+  std::pair<uint64_t, TOutput> popTagged() {
+    return client ? client->pop(false) : driver->popTagged();
+  }
+
+  void popBatch(TOutput *out, size_t n) {
+    if (client)
+      client->popBatch(out, n);
+    else
+      driver->popBatch(out, n);
+  }
+
+  /// Blocking while the input window is full. Pushes an input and returns a
+  /// ticket, through which awaitTicket returns the output of the call. Unlike
+  /// the other functions of the driver, submit and awaitTicket may be called
+  /// concurrently by multiple threads, e.g. by the threads of a parallel
+  /// testbench which each call the kernel. Calls submitted through tickets
+  /// must not be interleaved with calls that are popped in order.
+  template <typename... Args>
+  uint64_t submit(Args &&...args) {
+    // Calls are pushed in the order of their tickets. Only other submitting
+    // threads wait while the input window is full; awaiting threads do not.
+    std::unique_lock<std::mutex> p(pushLock);
+    uint64_t ticket = nextTicket++;
+    if (client) {
+      client->push(ticket, TInput(std::forward<Args>(args)...));
+      return ticket;
+    }
+    // The future of the output is taken right away, such that a call may be
+    // awaited in any order, without popping the calls submitted before it.
+    driver->emplace(std::forward<Args>(args)...);
+    std::future<TOutput> f = driver->popAsync();
+    p.unlock();
+    std::lock_guard<std::mutex> l(ticketLock);
+    tickets.emplace(ticket, std::move(f));
+    return ticket;
+  }
+
+  /// Blocking. Returns the output of the call of 'ticket'; see submit. Each
+  /// ticket is awaited once.
+  TOutput awaitTicket(uint64_t ticket) {
+    std::unique_lock<std::mutex> l(ticketLock);
+    if (client) {
+      // The outputs of a server are read from a single connection by one
+      // awaiting thread at a time, which keeps the outputs of the other
+      // threads until they are awaited. The others wait for their output to
+      // be read, or to take over reading. Neither holds the lock while an
+      // output is read, so calls are submitted and collected meanwhile.
+      while (true) {
+        auto it = completed.find(ticket);
+        if (it != completed.end()) {
+          TOutput output = std::move(it->second);
+          completed.erase(it);
+          return output;
+        }
+        if (reading) {
+          completedCv.wait(l);
+          continue;
+        }
+        reading = true;
+        l.unlock();
+        {
+          std::lock_guard<std::mutex> p(pushLock);
+          client->requestOutput(false);
+        }
+        auto [tag, output] = client->readOutput();
+        l.lock();
+        reading = false;
+        completed.emplace(tag, std::move(output));
+        completedCv.notify_all();
+      }
+    }
+    auto it = tickets.find(ticket);
+    if (it == tickets.end())
+      throw std::runtime_error("No call was submitted for ticket " +
+                               std::to_string(ticket));
+    std::future<TOutput> f = std::move(it->second);
+    tickets.erase(it);
+    // Other threads submit and await their calls while this one waits.
+    l.unlock();
+    return f.get();
+  }
+
+  /// Suspends and resumes the runners of an in-process driver around a fork;
+  /// see SimDriver::suspend. The connection to a server cannot be shared by
+  /// forked testbenches.
+  void suspend() {
+    if (client)
+      throw std::runtime_error(
+          "Testbenches of a simulation server cannot be forked");
+    driver->suspend();
+  }
+  void resume(bool forked) {
+    if (driver)
+      driver->resume(forked);
+  }
+
+  /// Returns the simulated cycles of the last call, or 0 if the kernel is
+  /// simulated by a server, which doesn't report them.
+  uint64_t lastCallCycles() const {
+    return client ? 0 : driver->lastCallCycles();
+  }
+
+private:
+  std::unique_ptr<TDriver> driver;
+  std::unique_ptr<SimClient<TInput, TOutput>> client;
+
+  // Serializes the calls which are submitted through tickets, and the
+  // requests of their outputs from a server.
+  std::mutex pushLock;
+  uint64_t nextTicket = 0;
+  // Guards the tickets and outputs below while calls are awaited.
+  std::mutex ticketLock;
+  // Futures of the outputs of the submitted calls of an in-process driver, by
+  // ticket.
+  std::map<uint64_t, std::future<TOutput>> tickets;
+  // Outputs popped from a server which have not yet been awaited, by ticket.
+  std::map<uint64_t, TOutput> completed;
+  // Set while an awaiting thread reads an output from the server, and
+  // signalled once it has been added to 'completed'.
+  bool reading = false;
+  std::condition_variable completedCv;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_SIMSERVER_H
@@ -0,0 +1,96 @@
+#ifndef CIRCT_TOOLS_HLT_SIMSTREAM_H
+#define CIRCT_TOOLS_HLT_SIMSTREAM_H
+
+#include "circt-hls/Tools/hlt/Simulator/MappedMemory.h"
+#include "circt-hls/Tools/hlt/Simulator/SimRecord.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Streams of the calls of a kernel, which drive the simulator of the kernel
+// without a testbench (see the <kernel>_stream function of the HLT wrapper).
+//
+// An input stream holds the host inputs of each call, in argument order, and
+// an output stream the results of each call, followed by the contents of its
+// memory arguments after the call. Each of these is a field of as many bytes
+// as its C type, padded to 8 bytes; unlike record files (see SimRecord.h),
+// streams have no header and no field sizes, so each call of an input stream
+// has the same size, and a stream is written by any program which knows the
+// signature of the kernel. Memories are held as contiguous arrays of their
+// elements.
+
+namespace circt {
+namespace hlt {
+
+/// Reads an input stream. The file is mapped copy-on-write, such that the
+/// inputs are passed to the kernel in place; the memories of a call are
+/// modified by the kernel, but the file is left untouched.
+class SimStreamReader {
+public:
+  /// 'callBytes' is the size of the inputs of a call.
+  SimStreamReader(const std::string &path, size_t callBytes)
+      : file(MappedFileSpec{path, MapMode::CopyOnWrite}, 0),
+        callBytes(callBytes), path(path) {
+    if (file.size() % callBytes != 0) {
+      std::cerr << "Input stream '" << path << "' of " << file.size()
+                << " bytes does not hold a whole number of calls of "
+                << callBytes << " bytes\n";
+      std::abort();
+    }
+  }
+
+  /// Returns the number of calls of the stream.
+  size_t size() const { return file.size() / callBytes; }
+
+  /// Starts reading the inputs of call 'idx'.
+  void begin(size_t idx) { pos = idx * callBytes; }
+
+  /// Returns the next field of the call, of 'bytes' bytes.
+  template <typename T = void>
+  T *next(size_t bytes = sizeof(T)) {
+    void *data = static_cast<char *>(file.data()) + pos;
+    pos += bytes + recordPadding(bytes);
+    return static_cast<T *>(data);
+  }
+
+private:
+  MappedFile file;
+  size_t callBytes;
+  std::string path;
+  size_t pos = 0;
+};
+
+/// Writes an output stream.
+class SimStreamWriter {
+public:
+  SimStreamWriter(const std::string &path) : out(path, std::ios::binary) {
+    if (!out) {
+      std::cerr << "Failed to create output stream '" << path << "'\n";
+      std::abort();
+    }
+  }
+
+  /// Writes a result of a call.
+  template <typename T>
+  void write(const T &value) {
+    write(&value, sizeof(T));
+  }
+
+  /// Writes a field of 'bytes' bytes at 'data'.
+  void write(const void *data, size_t bytes) {
+    static constexpr char padding[8] = {};
+    out.write(static_cast<const char *>(data), bytes);
+    out.write(padding, recordPadding(bytes));
+  }
+
+private:
+  std::ofstream out;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_SIMSTREAM_H
@@ -0,0 +1,186 @@
+#ifndef CIRCT_TOOLS_HLT_STDJIT_H
+#define CIRCT_TOOLS_HLT_STDJIT_H
+
+#ifndef HLT_JIT
+// If set, the std simulator JIT compiles the LLVM IR of the kernel when it is
+// first called, instead of linking against a natively compiled kernel.
+#define HLT_JIT 0
+#endif
+
+#if HLT_JIT
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#ifndef HLT_JIT_MODULE
+// Path of the LLVM IR file containing the kernel. Can be overridden at runtime
+// through the HLT_JIT_MODULE environment variable.
+#define HLT_JIT_MODULE "kernel.ll"
+#endif
+
+#ifndef HLT_JIT_CACHE_DIR
+// Directory in which compiled kernels are cached, keyed by a hash of their IR.
+// Can be overridden at runtime through the HLT_JIT_CACHE_DIR environment
+// variable; an empty directory disables the cache.
+#define HLT_JIT_CACHE_DIR ".hlt_jit_cache"
+#endif
+
+namespace circt {
+namespace hlt {
+
+/// An object cache which stores a single compiled object on disk. The object
+/// is only reused if its file exists, so the file name must identify the IR
+/// that it was compiled from.
+class StdJITObjectCache : public llvm::ObjectCache {
+public:
+  StdJITObjectCache(std::string path) : path(std::move(path)) {}
+
+  void notifyObjectCompiled(const llvm::Module * /*m*/,
+                            llvm::MemoryBufferRef obj) override {
+    std::error_code ec;
+    llvm::raw_fd_ostream os(path, ec);
+    // Failing to cache an object is not fatal; it'll be recompiled next time.
+    if (!ec)
+      os << obj.getBuffer();
+  }
+
+  std::unique_ptr<llvm::MemoryBuffer>
+  getObject(const llvm::Module * /*m*/) override {
+    auto buf = llvm::MemoryBuffer::getFile(path);
+    if (!buf)
+      return nullptr;
+    return std::move(buf.get());
+  }
+
+private:
+  std::string path;
+};
+
+/// StdJIT JIT compiles the LLVM IR of a std kernel within the simulator, which
+/// removes the native compilation of the kernel from the edit-run loop. The
+/// compiled object is cached on disk by the hash of the IR, such that it is
+/// only recompiled when the kernel changes.
+class StdJIT {
+public:
+  /// Returns the JIT of the process, compiling the kernel on first use.
+  static StdJIT &get() {
+    static StdJIT jit;
+    return jit;
+  }
+
+  /// Returns a pointer to the function named 'name' in the kernel, of type
+  /// 'F'.
+  template <typename F>
+  F *lookup(const std::string &name) {
+    auto sym = jit->lookup(name);
+    if (!sym)
+      fatal("Could not find '" + name + "' in the JIT compiled kernel",
+            sym.takeError());
+#if LLVM_VERSION_MAJOR >= 15
+    return sym->template toPtr<F *>();
+#else
+    return reinterpret_cast<F *>(sym->getAddress());
+#endif
+  }
+
+private:
+  StdJIT() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    std::string modulePath = HLT_JIT_MODULE;
+    if (const char *v = std::getenv("HLT_JIT_MODULE"))
+      modulePath = v;
+    std::string cacheDir = HLT_JIT_CACHE_DIR;
+    if (const char *v = std::getenv("HLT_JIT_CACHE_DIR"))
+      cacheDir = v;
+
+    auto buf = llvm::MemoryBuffer::getFile(modulePath);
+    if (!buf) {
+      std::cerr << "Failed to read JIT kernel '" << modulePath
+                << "': " << buf.getError().message() << "\n";
+      std::abort();
+    }
+
+    auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!jtmb)
+      fatal("Failed to detect the host target", jtmb.takeError());
+
+    // The object is keyed by the IR and the target it is compiled for.
+    if (!cacheDir.empty() && !llvm::sys::fs::create_directories(cacheDir)) {
+      uint64_t hash = llvm::xxHash64((*buf)->getBuffer()) ^
+                      llvm::xxHash64(jtmb->getTargetTriple().str());
+      cache = std::make_unique<StdJITObjectCache>(
+          cacheDir + "/" + llvm::utohexstr(hash) + ".o");
+    }
+
+    auto builder = llvm::orc::LLJITBuilder();
+    builder.setJITTargetMachineBuilder(*jtmb);
+    builder.setCompileFunctionCreator(
+        [this](llvm::orc::JITTargetMachineBuilder jtmb)
+            -> llvm::Expected<
+                std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+          auto tm = jtmb.createTargetMachine();
+          if (!tm)
+            return tm.takeError();
+          return std::make_unique<llvm::orc::TMOwningSimpleCompiler>(
+              std::move(*tm), cache.get());
+        });
+    auto j = builder.create();
+    if (!j)
+      fatal("Failed to create the JIT", j.takeError());
+    jit = std::move(*j);
+
+    // Resolve calls from the kernel to the C library through the process.
+    auto gen = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        jit->getDataLayout().getGlobalPrefix());
+    if (!gen)
+      fatal("Failed to expose process symbols to the JIT", gen.takeError());
+    jit->getMainJITDylib().addGenerator(std::move(*gen));
+
+    auto ctx = std::make_unique<llvm::LLVMContext>();
+    llvm::SMDiagnostic diag;
+    auto module = llvm::parseIR((*buf)->getMemBufferRef(), diag, *ctx);
+    if (!module) {
+      std::string msg;
+      llvm::raw_string_ostream os(msg);
+      diag.print(modulePath.c_str(), os);
+      std::cerr << "Failed to parse JIT kernel: " << os.str();
+      std::abort();
+    }
+    if (auto err = jit->addIRModule(
+            llvm::orc::ThreadSafeModule(std::move(module), std::move(ctx))))
+      fatal("Failed to add kernel to the JIT", std::move(err));
+  }
+
+  [[noreturn]] static void fatal(const std::string &msg, llvm::Error err) {
+    std::cerr << msg << ": " << llvm::toString(std::move(err)) << "\n";
+    std::abort();
+  }
+
+  std::unique_ptr<StdJITObjectCache> cache;
+  std::unique_ptr<llvm::orc::LLJIT> jit;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // HLT_JIT
+
+#endif // CIRCT_TOOLS_HLT_STDJIT_H
@@ -1,36 +1,79 @@
 #ifndef CIRCT_TOOLS_HLT_STDSIMINTERFACE_H
 #define CIRCT_TOOLS_HLT_STDSIMINTERFACE_H
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
 #include <optional>
+#include <thread>
+#include <vector>
 
 #include "circt-hls/Tools/hlt/Simulator/SimInterface.h"
 
+#ifndef HLT_STD_POLL_US
+// Time, in microseconds, that a StdPoolSimInterface step waits for the oldest
+// in-flight call to finish before returning control to the runner.
+#define HLT_STD_POLL_US 100
+#endif
+
+#ifndef HLT_STD_BATCH
+// Maximum number of calls that a StdSimInterface accumulates before running
+// them as a single batch; see StdSimInterface::callBatch.
+#define HLT_STD_BATCH 64
+#endif
+
 namespace circt {
 namespace hlt {
 
+/// A StdSimInterface runs kernel calls on the runner thread. Inputs which are
+/// pushed in consecutive steps are accumulated, and run as a single batch
+/// once no further input arrives or HLT_STD_BATCH inputs are pending, such
+/// that cheap kernels are not dominated by the overhead of each call.
 template <typename TInput, typename TOutput>
 class StdSimInterface : public SimInterface<TInput, TOutput> {
 public:
   void step() override {
-    if (!inBuffer.has_value())
+    if (inputs.empty())
       return;
-    outBuffer = call(inBuffer.value());
-    inBuffer.reset();
-    ++iterations;
+    // Keep accepting inputs for as long as they arrive.
+    if (pushed) {
+      pushed = false;
+      if (inputs.size() < HLT_STD_BATCH)
+        return;
+    }
+    // Outputs are appended behind those which have not been popped yet.
+    outputs.erase(outputs.begin(), outputs.begin() + outHead);
+    outHead = 0;
+    size_t first = outputs.size();
+    outputs.resize(first + inputs.size());
+    callBatch(inputs.data(), outputs.data() + first, inputs.size());
+    iterations += inputs.size();
+    inputs.clear();
   }
 
-  // The simulator is ready to accept a new input if there isn't an output
-  // value in the output buffer that needs to be popped.
-  bool inReady() override { return !outBuffer.has_value(); }
+  // The simulator is ready to accept a new input as long as neither the
+  // pending batch nor the outputs which remain to be popped are full.
+  bool inReady() override {
+    return inputs.size() < HLT_STD_BATCH &&
+           outputs.size() - outHead < HLT_STD_BATCH;
+  }
 
-  // The simulator output is valid whenever the output buffer has a value.
-  bool outValid() override { return outBuffer.has_value(); }
-  void pushInput(const TInput &input) override { inBuffer = input; }
+  // The simulator output is valid whenever an output remains to be popped.
+  bool outValid() override { return outHead < outputs.size(); }
+  void pushInput(const TInput &input) override {
+    inputs.push_back(input);
+    pushed = true;
+  }
+  void pushInput(TInput &&input) override {
+    inputs.push_back(std::move(input));
+    pushed = true;
+  }
   TOutput popOutput() {
-    assert(outBuffer.has_value());
-    TOutput v = outBuffer.value();
-    outBuffer.reset();
-    return v;
+    assert(outValid());
+    return std::move(outputs[outHead++]);
   }
   void setup() override {}
   void finish() override {}
@@ -43,16 +86,151 @@ protected:
   // LLVMIR.
   virtual TOutput call(const TInput &input) = 0;
 
+  // Runs the calls of the 'n' contiguous 'inputs', and writes their results to
+  // 'outputs'. The generated simulator overrides this with a loop over the
+  // kernel, which the kernel can be inlined into and vectorized across.
+  virtual void callBatch(const TInput *inputs, TOutput *outputs, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      outputs[i] = call(inputs[i]);
+  }
+
 private:
-  // Nullable in- and output buffers.
-  std::optional<TInput> inBuffer;
-  std::optional<TOutput> outBuffer;
+  // Inputs of the pending batch, and outputs of the batches which have run;
+  // the outputs before 'outHead' have been popped.
+  std::vector<TInput> inputs;
+  std::vector<TOutput> outputs;
+  size_t outHead = 0;
+  // Whether an input was pushed since the last step.
+  bool pushed = false;
 
   // The std simulator defines its timestep as # of times a function has been
   // invoked.
   unsigned iterations = 0;
 };
 
+/// A StdPoolSimInterface runs kernel calls concurrently on a pool of worker
+/// threads. Outputs are still produced in the order that inputs were pushed.
+/// This is only valid if calls are independent of each other, i.e. 'call' must
+/// be safe to invoke from multiple threads at once. If 'NThreads' is 0, a
+/// worker is created for each hardware thread.
+template <typename TInput, typename TOutput, unsigned NThreads = 0>
+class StdPoolSimInterface : public SimInterface<TInput, TOutput> {
+public:
+  ~StdPoolSimInterface() { stopWorkers(); }
+
+  void step() override {
+    if (inFlight.empty())
+      return;
+    // Keep accepting inputs for as long as they arrive, such that all workers
+    // are kept busy.
+    if (pushed) {
+      pushed = false;
+      if (inFlight.size() < capacity)
+        return;
+    }
+    // The workers are busy; wait for the oldest call, but return to the
+    // runner regularly such that it may service the host side.
+    auto status = inFlight.front().wait_for(
+        std::chrono::microseconds(HLT_STD_POLL_US));
+    if (status != std::future_status::ready && this->keepAlive)
+      this->keepAlive();
+  }
+
+  // The simulator is ready to accept a new input as long as the number of
+  // in-flight calls is below the capacity of the pool.
+  bool inReady() override { return inFlight.size() < capacity; }
+
+  // The simulator output is valid when the oldest in-flight call has finished.
+  bool outValid() override {
+    return !inFlight.empty() &&
+           inFlight.front().wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready;
+  }
+
+  void pushInput(const TInput &input) override { pushInput(TInput(input)); }
+  void pushInput(TInput &&input) override {
+    std::packaged_task<TOutput()> task(
+        [this, input = std::move(input)]() { return call(input); });
+    inFlight.push_back(task.get_future());
+    {
+      std::lock_guard<std::mutex> l(tasksLock);
+      tasks.push_back(std::move(task));
+    }
+    tasksCV.notify_one();
+    pushed = true;
+  }
+
+  TOutput popOutput() override {
+    assert(!inFlight.empty());
+    TOutput v = inFlight.front().get();
+    inFlight.pop_front();
+    ++iterations;
+    return v;
+  }
+
+  void setup() override {
+    unsigned n = NThreads;
+    if (n == 0)
+      n = std::max(1U, std::thread::hardware_concurrency());
+    // Allow a call to be queued behind each running call, such that a worker
+    // never waits for the runner to push its next input.
+    capacity = 2 * n;
+    for (unsigned i = 0; i < n; ++i)
+      workers.emplace_back(&StdPoolSimInterface::work, this);
+  }
+  void finish() override { stopWorkers(); }
+  uint64_t time() override { return iterations; }
+  void dump(std::ostream & /*os*/) const override {}
+
+protected:
+  // Function which must be overwritten by the generated simulator; see
+  // StdSimInterface::call. Invoked concurrently by the workers.
+  virtual TOutput call(const TInput &input) = 0;
+
+private:
+  void work() {
+    while (true) {
+      std::packaged_task<TOutput()> task;
+      {
+        std::unique_lock<std::mutex> l(tasksLock);
+        tasksCV.wait(l, [this]() { return stop || !tasks.empty(); });
+        if (tasks.empty())
+          return;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  // Stops the workers once all queued calls have been executed.
+  void stopWorkers() {
+    {
+      std::lock_guard<std::mutex> l(tasksLock);
+      stop = true;
+    }
+    tasksCV.notify_all();
+    for (auto &worker : workers)
+      worker.join();
+    workers.clear();
+  }
+
+  std::vector<std::thread> workers;
+  std::mutex tasksLock;
+  std::condition_variable tasksCV;
+  std::deque<std::packaged_task<TOutput()>> tasks;
+  bool stop = false;
+
+  // Futures of in-flight calls, in the order that their inputs were pushed.
+  std::deque<std::future<TOutput>> inFlight;
+  size_t capacity = 1;
+  // Whether an input was pushed since the last step.
+  bool pushed = false;
+
+  // Number of calls whose outputs have been popped.
+  unsigned iterations = 0;
+};
+
 } // namespace hlt
 } // namespace circt
 
@@ -0,0 +1,107 @@
+#ifndef CIRCT_TOOLS_HLT_VERILATORCHANNELSTATS_H
+#define CIRCT_TOOLS_HLT_VERILATORCHANNELSTATS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "verilated.h"
+#include "verilated_syms.h"
+
+namespace circt {
+namespace hlt {
+
+/// Counts, for each handshake channel within a verilated model, the cycles in
+/// which the channel transacted (valid && ready) and stalled (valid && !ready).
+/// Channels are found as pairs of '<name>_valid' and '<name>_ready' signals
+/// within each scope of the model. Internal signals are only visible if the
+/// model was verilated with --public-flat-rw.
+class VerilatorChannelStats {
+  struct Channel {
+    std::string name;
+    const CData *valid;
+    const CData *ready;
+    uint64_t fire = 0;
+    uint64_t stall = 0;
+  };
+
+public:
+  /// Finds the channels within all scopes of the model of 'ctx'.
+  void discover(VerilatedContext *ctx) {
+    static const std::string kValid = "_valid";
+    channels.clear();
+    for (auto &scopeIt : *ctx->scopeNameMap()) {
+      const VerilatedScope *scope = scopeIt.second;
+      VerilatedVarNameMap *vars = scope->varsp();
+      if (!vars)
+        continue;
+
+      // Channels are named after the scope that they're in, without the name
+      // of the top-level wrapper, such that top-level channels are named after
+      // the handshake ops which they connect.
+      std::string scopeName = scope->name();
+      if (scopeName.rfind("TOP.", 0) == 0)
+        scopeName = scopeName.substr(4);
+
+      for (auto &varIt : *vars) {
+        std::string name = varIt.first;
+        if (name.size() <= kValid.size() ||
+            name.compare(name.size() - kValid.size(), kValid.size(), kValid))
+          continue;
+        std::string prefix = name.substr(0, name.size() - kValid.size());
+        auto readyIt = vars->find((prefix + "_ready").c_str());
+        if (readyIt == vars->end() || !isBit(varIt.second) ||
+            !isBit(readyIt->second))
+          continue;
+        channels.push_back(
+            {scopeName + "." + prefix,
+             static_cast<const CData *>(varIt.second.datap()),
+             static_cast<const CData *>(readyIt->second.datap())});
+      }
+    }
+    std::sort(channels.begin(), channels.end(),
+              [](auto &lhs, auto &rhs) { return lhs.name < rhs.name; });
+  }
+
+  /// Samples the state of each channel. This should be called once per cycle,
+  /// before the rising clock edge.
+  void sample() {
+    for (auto &channel : channels) {
+      if (!*channel.valid)
+        continue;
+      if (*channel.ready)
+        channel.fire++;
+      else
+        channel.stall++;
+    }
+  }
+
+  /// Writes the counters of each channel to 'path' as JSON.
+  void dumpJSON(const std::string &path, uint64_t cycles) const {
+    std::ofstream os(path);
+    os << "{\"cycles\": " << cycles << ", \"channels\": [";
+    for (size_t i = 0; i < channels.size(); ++i) {
+      auto &channel = channels[i];
+      os << (i == 0 ? "" : ", ") << "{\"name\": \"" << channel.name
+         << "\", \"fire\": " << channel.fire
+         << ", \"stall\": " << channel.stall << "}";
+    }
+    os << "]}\n";
+  }
+
+  size_t size() const { return channels.size(); }
+
+private:
+  static bool isBit(const VerilatedVar &var) {
+    return var.vltype() == VLVT_UINT8 && var.udims() == 0;
+  }
+
+  std::vector<Channel> channels;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_VERILATORCHANNELSTATS_H
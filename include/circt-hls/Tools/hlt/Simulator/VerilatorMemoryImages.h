@@ -0,0 +1,274 @@
+#ifndef CIRCT_TOOLS_HLT_VERILATORMEMORYIMAGES_H
+#define CIRCT_TOOLS_HLT_VERILATORMEMORYIMAGES_H
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "verilated.h"
+#include "verilated_syms.h"
+
+namespace circt {
+namespace hlt {
+
+/// Initializes and reads back the memories within a verilated model, such as
+/// those of handshake.memory ops, directly through the public signals of the
+/// model rather than through transactions of the kernel. Each memory is named
+/// by the scope of the op which it is a part of (e.g. 'handshake_memory3', see
+/// the 'handshake_id' of the op), and is the one unpacked array within that
+/// scope and its children. Images are $readmemh-style files: whitespace
+/// separated hex words, '@<hex address>' directives, and comments. Memories
+/// are only visible if the model was verilated with --public-flat-rw.
+///
+/// In addition to the images given by the wrapper, images are given by the
+/// environment, as comma-separated lists of <name>=<file>:
+///  HLT_MEMORY_INIT    Images which memories are initialized from at reset.
+///  HLT_MEMORY_DUMP    Files which memories are written to when the
+///                     simulation finishes.
+class VerilatorMemoryImages {
+  struct Image {
+    std::string name;
+    std::string init;
+    std::string dump;
+  };
+
+  struct Memory {
+    std::string scope;
+    uint8_t *data;
+    size_t bytes;
+    size_t depth;
+    unsigned width;
+  };
+
+public:
+  /// Initializes memory 'name' from 'init' at reset, and writes it to 'dump'
+  /// when the simulation finishes. Either file may be empty.
+  void add(const std::string &name, const std::string &init,
+           const std::string &dump) {
+    for (auto &image : images) {
+      if (image.name != name)
+        continue;
+      if (!init.empty())
+        image.init = init;
+      if (!dump.empty())
+        image.dump = dump;
+      return;
+    }
+    images.push_back({name, init, dump});
+  }
+
+  /// Adds the images given by HLT_MEMORY_INIT and HLT_MEMORY_DUMP.
+  void addFromEnv() {
+    auto parse = [&](const char *var, bool isInit) {
+      const char *v = std::getenv(var);
+      if (!v)
+        return;
+      std::stringstream ss(v);
+      std::string entry;
+      while (std::getline(ss, entry, ',')) {
+        size_t eq = entry.find('=');
+        if (eq == std::string::npos) {
+          std::cerr << "Expected " << var << " entries of the form "
+                    << "<name>=<file>, got '" << entry << "'\n";
+          std::abort();
+        }
+        std::string name = entry.substr(0, eq), file = entry.substr(eq + 1);
+        add(name, isInit ? file : "", isInit ? "" : file);
+      }
+    };
+    parse("HLT_MEMORY_INIT", true);
+    parse("HLT_MEMORY_DUMP", false);
+  }
+
+  /// Finds the memories of the images within the model of 'ctx'. Aborts if a
+  /// memory is not found.
+  void discover(VerilatedContext *ctx) {
+    memories.assign(images.size(), {});
+    std::vector<unsigned> found(images.size(), 0);
+    for (auto &scopeIt : *ctx->scopeNameMap()) {
+      const VerilatedScope *scope = scopeIt.second;
+      VerilatedVarNameMap *vars = scope->varsp();
+      if (!vars)
+        continue;
+      std::string scopeName = scope->name();
+      for (size_t i = 0; i < images.size(); ++i) {
+        if (!inScope(scopeName, images[i].name))
+          continue;
+        for (auto &varIt : *vars) {
+          const VerilatedVar &var = varIt.second;
+          size_t bytes = getBytes(var);
+          if (var.udims() != 1 || bytes == 0)
+            continue;
+          memories[i] = {scopeName + "." + varIt.first,
+                         static_cast<uint8_t *>(var.datap()), bytes,
+                         static_cast<size_t>(var.unpacked().elements()),
+                         static_cast<unsigned>(var.packed().elements())};
+          found[i]++;
+        }
+      }
+    }
+    for (size_t i = 0; i < images.size(); ++i) {
+      if (found[i] == 1)
+        continue;
+      std::cerr << (found[i] == 0 ? "Found no" : "Found more than one")
+                << " memory named " << images[i].name
+                << " within the model. Was the model verilated with "
+                   "--public-flat-rw?\n";
+      std::abort();
+    }
+  }
+
+  /// Initializes the memories from their images. Words beyond those of an
+  /// image are zeroed.
+  void preload() {
+    for (size_t i = 0; i < images.size(); ++i) {
+      if (images[i].init.empty())
+        continue;
+      Memory &memory = memories[i];
+      std::memset(memory.data, 0, memory.depth * memory.bytes);
+      std::ifstream is(images[i].init);
+      if (!is) {
+        std::cerr << "Could not read the image of memory " << images[i].name
+                  << " (" << images[i].init << ")\n";
+        std::abort();
+      }
+      std::string text((std::istreambuf_iterator<char>(is)),
+                       std::istreambuf_iterator<char>());
+      if (!readImage(text, memory)) {
+        std::cerr << "Image " << images[i].init << " exceeds the "
+                  << memory.depth << " words of memory " << images[i].name
+                  << "\n";
+        std::abort();
+      }
+    }
+  }
+
+  /// Writes the memories to their dump files, one hex word per line. 'suffix'
+  /// is inserted before the extension of each file.
+  bool dump(const std::string &suffix = "") const {
+    bool success = true;
+    for (size_t i = 0; i < images.size(); ++i) {
+      if (images[i].dump.empty())
+        continue;
+      const Memory &memory = memories[i];
+      std::string path = images[i].dump;
+      size_t ext = path.find_last_of('.');
+      if (ext == std::string::npos || path.find('/', ext) != std::string::npos)
+        ext = path.size();
+      path.insert(ext, suffix);
+      std::ofstream os(path);
+      if (!os) {
+        success = false;
+        continue;
+      }
+      os << "// " << memory.scope << "\n" << std::hex << std::setfill('0');
+      for (size_t addr = 0; addr < memory.depth; ++addr)
+        os << std::setw((memory.width + 3) / 4) << readWord(memory, addr)
+           << "\n";
+    }
+    return success;
+  }
+
+  size_t size() const { return images.size(); }
+
+private:
+  // Returns true if 'scope' is, or is within, the scope of op 'name'.
+  static bool inScope(const std::string &scope, const std::string &name) {
+    std::string dotted = "." + scope + ".";
+    return dotted.find("." + name + ".") != std::string::npos;
+  }
+
+  // Returns the number of bytes of each element of 'var', or 0 if its elements
+  // are not bit vectors of at most 64 bits.
+  static size_t getBytes(const VerilatedVar &var) {
+    switch (var.vltype()) {
+    case VLVT_UINT8:
+      return sizeof(CData);
+    case VLVT_UINT16:
+      return sizeof(SData);
+    case VLVT_UINT32:
+      return sizeof(IData);
+    case VLVT_UINT64:
+      return sizeof(QData);
+    default:
+      return 0;
+    }
+  }
+
+  static uint64_t readWord(const Memory &memory, size_t addr) {
+    uint64_t word = 0;
+    std::memcpy(&word, memory.data + addr * memory.bytes, memory.bytes);
+    return word;
+  }
+
+  static void writeWord(Memory &memory, size_t addr, uint64_t word) {
+    if (memory.width < 64)
+      word &= (uint64_t(1) << memory.width) - 1;
+    std::memcpy(memory.data + addr * memory.bytes, &word, memory.bytes);
+  }
+
+  // Writes the words of the $readmemh-style 'text' to 'memory'. Returns false
+  // if the words exceed the memory.
+  static bool readImage(const std::string &text, Memory &memory) {
+    size_t addr = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+      char c = text[pos];
+      if (std::isspace(static_cast<unsigned char>(c))) {
+        ++pos;
+        continue;
+      }
+      if (text.compare(pos, 2, "//") == 0) {
+        pos = text.find('\n', pos);
+        continue;
+      }
+      if (text.compare(pos, 2, "/*") == 0) {
+        pos = text.find("*/", pos);
+        pos = pos == std::string::npos ? pos : pos + 2;
+        continue;
+      }
+      size_t end = pos;
+      while (end < text.size() &&
+             !std::isspace(static_cast<unsigned char>(text[end])))
+        ++end;
+      std::string token = text.substr(pos, end - pos);
+      pos = end;
+
+      bool isAddr = token[0] == '@';
+      uint64_t value = 0;
+      for (char d : token.substr(isAddr ? 1 : 0)) {
+        if (d == '_')
+          continue;
+        // Unknown and high-impedance digits are read as 0.
+        value = value * 16 +
+                (std::isxdigit(static_cast<unsigned char>(d))
+                     ? std::stoul(std::string(1, d), nullptr, 16)
+                     : 0);
+      }
+      if (isAddr) {
+        addr = value;
+        continue;
+      }
+      if (addr >= memory.depth)
+        return false;
+      writeWord(memory, addr++, value);
+    }
+    return true;
+  }
+
+  std::vector<Image> images;
+  // The memory of each image, once discovered.
+  std::vector<Memory> memories;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_VERILATORMEMORYIMAGES_H
@@ -0,0 +1,158 @@
+#ifndef CIRCT_TOOLS_HLT_VERILATOROPSTATS_H
+#define CIRCT_TOOLS_HLT_VERILATOROPSTATS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "verilated.h"
+#include "verilated_syms.h"
+
+namespace circt {
+namespace hlt {
+
+/// Counts, for each handshake op within a verilated model, the cycles in which
+/// the op fired, i.e. in which any of its output channels transacted. Each op
+/// is lowered to an instance of its own module, whose scope is named after the
+/// op and its 'handshake_id' (e.g. 'kernel.arith_muli0'), and whose channels
+/// are its ports: 'in<N>' and 'out<N>'. Ops without output ports (e.g. sinks)
+/// fire when any of their input ports transact, and ops with other ports (e.g.
+/// the load and store ports of memories) when any of those transact. Internal
+/// signals are only visible if the model was verilated with --public-flat-rw.
+class VerilatorOpStats {
+  struct Port {
+    const CData *valid;
+    const CData *ready;
+  };
+
+  struct Op {
+    std::string name;
+    std::vector<Port> ports;
+    uint64_t fire = 0;
+  };
+
+public:
+  /// Finds the ops within all scopes of the model of 'ctx'.
+  void discover(VerilatedContext *ctx) {
+    ops.clear();
+    for (auto &scopeIt : *ctx->scopeNameMap()) {
+      const VerilatedScope *scope = scopeIt.second;
+      VerilatedVarNameMap *vars = scope->varsp();
+      if (!vars)
+        continue;
+
+      // The top-level module and the kernel module are not ops.
+      std::string scopeName = scope->name();
+      if (scopeName.rfind("TOP.", 0) == 0)
+        scopeName = scopeName.substr(4);
+      if (scopeName == "TOP" || scopeName.find('.') == std::string::npos)
+        continue;
+
+      std::vector<Port> outs, ins, others;
+      for (auto &varIt : *vars) {
+        std::string prefix;
+        if (!isValid(varIt.first, prefix))
+          continue;
+        auto readyIt = vars->find((prefix + "_ready").c_str());
+        if (readyIt == vars->end() || !isBit(varIt.second) ||
+            !isBit(readyIt->second))
+          continue;
+        Port port{static_cast<const CData *>(varIt.second.datap()),
+                  static_cast<const CData *>(readyIt->second.datap())};
+        if (isPort(prefix, "out"))
+          outs.push_back(port);
+        else if (isPort(prefix, "in"))
+          ins.push_back(port);
+        else
+          others.push_back(port);
+      }
+      if (outs.empty() && others.empty())
+        outs = std::move(ins);
+      else if (outs.empty())
+        outs = std::move(others);
+      if (!outs.empty())
+        ops.push_back({scopeName, std::move(outs)});
+    }
+    std::sort(ops.begin(), ops.end(),
+              [](auto &lhs, auto &rhs) { return lhs.name < rhs.name; });
+  }
+
+  /// Samples whether each op fires. This should be called once per cycle,
+  /// before the rising clock edge.
+  void sample() {
+    for (auto &op : ops) {
+      for (auto &port : op.ports) {
+        if (*port.valid && *port.ready) {
+          op.fire++;
+          break;
+        }
+      }
+    }
+  }
+
+  /// Writes the firing counter of each op to 'path' as JSON.
+  void dumpJSON(const std::string &path, uint64_t cycles) const {
+    std::ofstream os(path);
+    os << "{\"cycles\": " << cycles << ", \"ops\": [";
+    for (size_t i = 0; i < ops.size(); ++i)
+      os << (i == 0 ? "" : ", ") << "{\"name\": \"" << ops[i].name
+         << "\", \"fire\": " << ops[i].fire << "}";
+    os << "]}\n";
+  }
+
+  /// Prints the utilization of each op, i.e. the share of the 'cycles' of the
+  /// simulation in which it fired, most utilized first.
+  void print(std::ostream &os, uint64_t cycles) const {
+    std::vector<const Op *> sorted;
+    for (auto &op : ops)
+      sorted.push_back(&op);
+    std::stable_sort(sorted.begin(), sorted.end(), [](auto *lhs, auto *rhs) {
+      return lhs->fire > rhs->fire;
+    });
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << "Op utilization over " << cycles << " cycles (HLT_OP_STATS):\n";
+    for (auto *op : sorted) {
+      double utilization = cycles == 0 ? 0.0 : 100.0 * op->fire / cycles;
+      os << "  " << op->name << ": " << op->fire << " firings ("
+         << std::fixed << std::setprecision(1) << utilization << "%)\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+  }
+
+  size_t size() const { return ops.size(); }
+
+private:
+  static bool isBit(const VerilatedVar &var) {
+    return var.vltype() == VLVT_UINT8 && var.udims() == 0;
+  }
+
+  // Returns true if 'name' is a '<prefix>_valid' signal.
+  static bool isValid(const std::string &name, std::string &prefix) {
+    static const std::string kValid = "_valid";
+    if (name.size() <= kValid.size() ||
+        name.compare(name.size() - kValid.size(), kValid.size(), kValid))
+      return false;
+    prefix = name.substr(0, name.size() - kValid.size());
+    return true;
+  }
+
+  // Returns true if 'name' is '<kind><N>'.
+  static bool isPort(const std::string &name, const std::string &kind) {
+    return name.size() > kind.size() && name.rfind(kind, 0) == 0 &&
+           std::all_of(name.begin() + kind.size(), name.end(),
+                       [](char c) { return c >= '0' && c <= '9'; });
+  }
+
+  std::vector<Op> ops;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_VERILATOROPSTATS_H
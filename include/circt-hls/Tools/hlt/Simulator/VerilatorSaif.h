@@ -0,0 +1,304 @@
+#ifndef CIRCT_TOOLS_HLT_VERILATORSAIF_H
+#define CIRCT_TOOLS_HLT_VERILATORSAIF_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "verilated.h"
+#include "verilated_syms.h"
+
+namespace circt {
+namespace hlt {
+
+/// Runtime configuration of the switching activity which is recorded. The
+/// configuration is read from the environment:
+///  HLT_SAIF_START=<cycle>     Do not record cycles before <cycle>.
+///  HLT_SAIF_END=<cycle>       Do not record cycles from <cycle> onwards.
+///  HLT_SAIF_PERIOD_PS=<ps>    Clock period that the activity is scaled by,
+///                             10000 (100 MHz) by default.
+///  HLT_SAIF_FILE=<path>       File to write the activity to, activity.saif
+///                             by default.
+struct SaifConfig {
+  uint64_t start = 0;
+  std::optional<uint64_t> end;
+  uint64_t periodPs = 10000;
+  std::string file;
+
+  static SaifConfig fromEnv() {
+    SaifConfig config;
+    if (const char *v = std::getenv("HLT_SAIF_START"))
+      config.start = std::strtoull(v, nullptr, 10);
+    if (const char *v = std::getenv("HLT_SAIF_END"))
+      config.end = std::strtoull(v, nullptr, 10);
+    if (const char *v = std::getenv("HLT_SAIF_PERIOD_PS"))
+      config.periodPs = std::max<uint64_t>(std::strtoull(v, nullptr, 10), 1);
+    if (const char *v = std::getenv("HLT_SAIF_FILE"))
+      config.file = v;
+    return config;
+  }
+
+  /// Returns true if the activity of 'cycle' should be recorded.
+  bool inWindow(uint64_t cycle) const {
+    return cycle >= start && (!end || cycle < end.value());
+  }
+};
+
+/// Records the switching activity of each bit of the signals within a
+/// verilated model, and writes it as a SAIF (Switching Activity Interchange
+/// Format) file, which e.g. Vivado's report_power reads in place of its
+/// vectorless estimates. Signals are sampled once per cycle, before the rising
+/// clock edge, so glitches within a cycle are not counted, and the clock
+/// itself, which the constraints of the design define, is never seen to
+/// toggle. Sampling compares the value of each signal to its last sample, and
+/// only the bits which changed are visited, such that recording is much
+/// cheaper than tracing. Internal signals are only visible if the model was
+/// verilated with --public-flat-rw; arrays (such as memories) are not recorded.
+class VerilatorSaif {
+  struct Signal {
+    std::string scope;
+    std::string name;
+    const uint8_t *data;
+    size_t bytes;
+    unsigned width;
+    // Index of the first bit of the signal within the per-bit counters.
+    size_t firstBit;
+    // Offset of the last sampled value of the signal.
+    size_t offset;
+  };
+
+public:
+  explicit VerilatorSaif(const SaifConfig &config) : config(config) {}
+
+  /// Finds the signals within all scopes of the model of 'ctx'.
+  void discover(VerilatedContext *ctx) {
+    signals.clear();
+    size_t numBits = 0, numBytes = 0;
+    for (auto &scopeIt : *ctx->scopeNameMap()) {
+      const VerilatedScope *scope = scopeIt.second;
+      VerilatedVarNameMap *vars = scope->varsp();
+      if (!vars)
+        continue;
+      // The ports of the top-level wrapper are those of the design.
+      std::string scopeName = scope->name();
+      if (scopeName == "TOP")
+        continue;
+      if (scopeName.rfind("TOP.", 0) == 0)
+        scopeName = scopeName.substr(4);
+
+      for (auto &varIt : *vars) {
+        const VerilatedVar &var = varIt.second;
+        size_t bytes = getBytes(var);
+        if (bytes == 0 || var.udims() != 0)
+          continue;
+        unsigned width = var.packed().elements();
+        signals.push_back({scopeName, varIt.first,
+                           static_cast<const uint8_t *>(var.datap()), bytes,
+                           width, numBits, numBytes});
+        numBits += width;
+        numBytes += bytes;
+      }
+    }
+    last.clear();
+    for (auto &signal : signals)
+      last.insert(last.end(), signal.data, signal.data + signal.bytes);
+    toggles.assign(numBits, 0);
+    high.assign(numBits, 0);
+    lastChange.assign(numBits, 0);
+  }
+
+  /// Samples the signals of the model in 'cycle'. This should be called once
+  /// per cycle, before the rising clock edge.
+  void sample(uint64_t cycle) {
+    if (!config.inWindow(cycle)) {
+      // Close the window, such that the activity past its end is dropped.
+      if (started && !ended) {
+        flush();
+        ended = true;
+      }
+      return;
+    }
+    if (ended)
+      return;
+    if (!started) {
+      // The activity starts from the values at the start of the window.
+      started = true;
+      for (auto &signal : signals)
+        std::memcpy(&last[signal.offset], signal.data, signal.bytes);
+      lastChange.assign(lastChange.size(), 0);
+    }
+
+    for (auto &signal : signals) {
+      uint8_t *prev = &last[signal.offset];
+      if (std::memcmp(prev, signal.data, signal.bytes) == 0)
+        continue;
+      for (size_t byte = 0; byte < signal.bytes; ++byte) {
+        uint8_t changed = prev[byte] ^ signal.data[byte];
+        for (unsigned bit = 0; changed; ++bit, changed >>= 1) {
+          unsigned idx = byte * 8 + bit;
+          if (!(changed & 1) || idx >= signal.width)
+            continue;
+          size_t counter = signal.firstBit + idx;
+          if ((prev[byte] >> bit) & 1)
+            high[counter] += sampled - lastChange[counter];
+          lastChange[counter] = sampled;
+          toggles[counter]++;
+        }
+        prev[byte] = signal.data[byte];
+      }
+    }
+    sampled++;
+  }
+
+  /// Writes the activity recorded so far to the SAIF file. 'suffix' is
+  /// appended to the default file name.
+  bool write(const std::string &suffix = "") {
+    if (!ended)
+      flush();
+    std::string path =
+        config.file.empty() ? "activity" + suffix + ".saif" : config.file;
+    std::ofstream os(path);
+    if (!os)
+      return false;
+
+    // Signals are grouped into the instances of their scopes. The design is
+    // the module which the top-level wrapper instantiates.
+    Instance root;
+    for (auto &signal : signals) {
+      Instance *inst = &root;
+      size_t begin = 0;
+      while (begin <= signal.scope.size()) {
+        size_t end = signal.scope.find('.', begin);
+        if (end == std::string::npos)
+          end = signal.scope.size();
+        auto &child = inst->children[signal.scope.substr(begin, end - begin)];
+        if (!child)
+          child = std::make_unique<Instance>();
+        inst = child.get();
+        begin = end + 1;
+      }
+      inst->signals.push_back(&signal);
+    }
+    std::string design =
+        root.children.size() == 1 ? root.children.begin()->first : "TOP";
+
+    // Durations are in picoseconds of the clock period.
+    uint64_t duration = window * config.periodPs;
+    os << "(SAIFILE\n(SAIFVERSION \"2.0\")\n(DIRECTION \"backward\")\n"
+       << "(DESIGN \"" << design << "\")\n(VENDOR \"circt-hls\")\n"
+       << "(PROGRAM_NAME \"hlt\")\n(DIVIDER / )\n(TIMESCALE 1 ps)\n"
+       << "(DURATION " << duration << ")\n";
+    for (auto &child : root.children)
+      writeInstance(os, child.first, *child.second, 0);
+    os << ")\n";
+    return true;
+  }
+
+  size_t size() const { return signals.size(); }
+
+private:
+  struct Instance {
+    std::map<std::string, std::unique_ptr<Instance>> children;
+    std::vector<const Signal *> signals;
+  };
+
+  // Returns the number of bytes of the value of 'var', or 0 if it is not a
+  // bit vector.
+  static size_t getBytes(const VerilatedVar &var) {
+    switch (var.vltype()) {
+    case VLVT_UINT8:
+      return sizeof(CData);
+    case VLVT_UINT16:
+      return sizeof(SData);
+    case VLVT_UINT32:
+      return sizeof(IData);
+    case VLVT_UINT64:
+      return sizeof(QData);
+    case VLVT_WDATA:
+      return ((var.packed().elements() + 31) / 32) * sizeof(EData);
+    default:
+      return 0;
+    }
+  }
+
+  // Escapes the characters of 'name' which are special in SAIF identifiers.
+  static std::string escape(const std::string &name) {
+    std::string res;
+    for (char c : name) {
+      if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+        res += '\\';
+      res += c;
+    }
+    return res;
+  }
+
+  // Accounts the time since the last change of each bit which is high, up to
+  // the end of the recorded window.
+  void flush() {
+    for (auto &signal : signals) {
+      const uint8_t *value = &last[signal.offset];
+      for (unsigned idx = 0; idx < signal.width; ++idx) {
+        size_t counter = signal.firstBit + idx;
+        if ((value[idx / 8] >> (idx % 8)) & 1)
+          high[counter] += sampled - lastChange[counter];
+        lastChange[counter] = sampled;
+      }
+    }
+    window = sampled;
+  }
+
+  void writeInstance(std::ostream &os, const std::string &name,
+                     const Instance &inst, unsigned depth) {
+    std::string indent(depth * 2, ' ');
+    os << indent << "(INSTANCE " << escape(name) << "\n";
+    if (!inst.signals.empty()) {
+      os << indent << "  (NET\n";
+      for (const Signal *signal : inst.signals) {
+        for (unsigned idx = 0; idx < signal->width; ++idx) {
+          size_t counter = signal->firstBit + idx;
+          uint64_t t1 = high[counter] * config.periodPs;
+          uint64_t t0 = window * config.periodPs - t1;
+          os << indent << "    (" << escape(signal->name);
+          if (signal->width > 1)
+            os << "\\[" << idx << "\\]";
+          os << "\n"
+             << indent << "      (T0 " << t0 << ") (T1 " << t1
+             << ") (TX 0) (TC " << toggles[counter] << ") (IG 0)\n"
+             << indent << "    )\n";
+        }
+      }
+      os << indent << "  )\n";
+    }
+    for (auto &child : inst.children)
+      writeInstance(os, child.first, *child.second, depth + 1);
+    os << indent << ")\n";
+  }
+
+  SaifConfig config;
+  std::vector<Signal> signals;
+  // The value of each signal as of its last sample.
+  std::vector<uint8_t> last;
+  // The toggles of each bit, the number of sampled cycles in which it was
+  // high up to its last change, and the cycle of its last change.
+  std::vector<uint64_t> toggles;
+  std::vector<uint64_t> high;
+  std::vector<uint64_t> lastChange;
+  // Number of cycles sampled within the window, and as of the last flush.
+  uint64_t sampled = 0;
+  uint64_t window = 0;
+  bool started = false;
+  bool ended = false;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_VERILATORSAIF_H
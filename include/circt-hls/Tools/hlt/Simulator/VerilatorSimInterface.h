@@ -1,33 +1,124 @@
 #ifndef CIRCT_TOOLS_HLT_VERILATORSIMINTERFACE_H
 #define CIRCT_TOOLS_HLT_VERILATORSIMINTERFACE_H
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 #include "circt-hls/Tools/hlt/Simulator/SimDriver.h"
+#include "circt-hls/Tools/hlt/Simulator/SimPerfCounters.h"
 
 #include "verilated.h"
 
 #if VM_TRACE
-#include "verilated_vcd_c.h"
+#include "circt-hls/Tools/hlt/Simulator/VerilatorTrace.h"
 #endif
 
-// Legacy function required only so linking works on Cygwin and MSVC++
+#if VM_COVERAGE
+#include "verilated_cov.h"
+#endif
+
+#ifndef HLT_RESET_CYCLES
+// Number of clock cycles that the model is held in reset for during setup.
+#define HLT_RESET_CYCLES 2
+#endif
+
+#ifndef HLT_EVAL_ON_CHANGE
+// Set to 0 to evaluate the model whenever time advances. By default, the model
+// is only evaluated once its inputs were written (see VerilatorSignal), or
+// its clock changed, since the last evaluation.
+#define HLT_EVAL_ON_CHANGE 1
+#endif
+
+#ifndef HLT_CHECKPOINTS
+// Set to 1 to enable checkpointing of the simulation state. This requires the
+// model to be verilated with --savable.
+#define HLT_CHECKPOINTS 0
+#endif
+
+#if HLT_CHECKPOINTS
+#include "verilated_save.h"
+#endif
+
+#ifndef HLT_SAIF
+// Set to 1 to record the switching activity of the signals of the model, which
+// is written to activity.saif when the simulator finishes or goes idle (see
+// VerilatorSaif.h). This requires the model to be verilated with
+// --public-flat-rw.
+#define HLT_SAIF 0
+#endif
+
+#if HLT_SAIF
+#include "circt-hls/Tools/hlt/Simulator/VerilatorSaif.h"
+#endif
+
+#ifndef HLT_MEMORY_IMAGES
+// Set to 1 to initialize the memories within the model from images at reset,
+// and to write them out when the simulator finishes (see
+// VerilatorMemoryImages.h). This requires the model to be verilated with
+// --public-flat-rw.
+#define HLT_MEMORY_IMAGES 0
+#endif
+
+#if HLT_MEMORY_IMAGES
+#include "circt-hls/Tools/hlt/Simulator/VerilatorMemoryImages.h"
+#endif
+
+#if HLT_DEBUG_SERVER
+#include "circt-hls/Tools/hlt/Simulator/SimDebugServer.h"
+#include "verilated_syms.h"
+#endif
+
+#ifndef HLT_PREBUILT
+// Set to 1 if the simulator is linked against the prebuilt HLTSimulator
+// library, which holds explicit instantiations of the handshake ports and
+// memory interfaces for each Verilator data type. Wrappers then skip
+// instantiating these. The library is built with the default value of each of
+// the HLT_* macros.
+#define HLT_PREBUILT 0
+#endif
+
+// Legacy function required only so linking works on Cygwin and MSVC++. The
+// prebuilt library (HLT_PREBUILT_INSTANTIATE) leaves this to the simulator.
+#ifndef HLT_PREBUILT_INSTANTIATE
 double sc_time_stamp() { return 0; }
+#endif
 
 namespace circt {
 namespace hlt {
 
+/// Returns the flag which the signals of the verilated simulator that is
+/// being constructed on this thread set whenever they are written; see
+/// VerilatorSimInterface::advanceTime. The flag is set from the construction
+/// of the simulator until its setup, such that the signals of its ports are
+/// constructed with it.
+inline bool *&constructingModelDirty() {
+  static thread_local bool *dirty = nullptr;
+  return dirty;
+}
+
 template <typename TSigType>
 class VerilatorSignal {
   // This class encapsulates a top-level verilator signal. We override the
   // assignment operator to be able to track modifications to the top-level
   // I/O of a verilated model.
 public:
-  VerilatorSignal(TSigType *sig) : m_sig(sig) {}
+  VerilatorSignal(TSigType *sig)
+      : m_sig(sig), m_modelDirty(constructingModelDirty()) {}
 
   VerilatorSignal &operator=(const TSigType &rhs) {
     assert(m_sig && "VerilatorSignal: null signal");
     *m_sig = rhs;
+    markModelDirty();
     return *this;
   }
 
@@ -42,17 +133,81 @@ public:
     assert(m_sig && "VerilatorSignal: null signal");
     if (*m_sig != rhs) {
       *m_sig = rhs;
+      markModelDirty();
       return true;
     }
     return false;
   }
 
+  /// Returns the signal of the verilated model.
+  TSigType *get() const { return m_sig; }
+
+  /// Marks the model of this signal to be evaluated, e.g. after writing
+  /// another input of the model in place.
+  void markModelDirty() {
+    if (m_modelDirty)
+      *m_modelDirty = true;
+  }
+
 private:
   /// Pointer to a member variable of a verilated model that represents an I/O
   /// signal.
   TSigType *m_sig = nullptr;
+
+  /// The flag of the simulator of the model, which is set whenever the signal
+  /// is written.
+  bool *m_modelDirty = nullptr;
 };
 
+// Verilator represents signals wider than 64 bits as arrays of 32-bit words
+// (VlWide), least significant word first. Scalar values of up to 128 bits are
+// passed to and from the host as 128-bit integers, following the MLIR calling
+// convention, and are converted by the wrappers through fromHost and toHost.
+// Elements of memories are accessed in place, since the words of a signal
+// match the layout of the element in host memory.
+template <typename T>
+struct IsVlWide : std::false_type {};
+template <std::size_t N>
+struct IsVlWide<VlWide<N>> : std::true_type {};
+
+/// Converts a host value to the wide signal type 'TSig'.
+template <typename TSig>
+TSig fromHost(unsigned __int128 value) {
+  static_assert(IsVlWide<TSig>::value && sizeof(TSig) <= sizeof(value),
+                "Only wide signals of up to 128 bits are passed by value");
+  TSig sig;
+  for (std::size_t i = 0; i < sizeof(TSig) / sizeof(EData); ++i)
+    sig.data()[i] = static_cast<EData>(value >> (32 * i));
+  return sig;
+}
+
+/// Converts a wide signal to a host value.
+template <std::size_t N>
+unsigned __int128 toHost(const VlWide<N> &sig) {
+  static_assert(N <= 4, "Only wide signals of up to 128 bits are passed by "
+                        "value");
+  unsigned __int128 value = 0;
+  for (std::size_t i = N; i-- > 0;)
+    value = (value << 32) | sig.data()[i];
+  return value;
+}
+
+/// Writes the value of a data signal, as in port dumps.
+template <typename TData>
+void dumpData(std::ostream &out, const TData &data) {
+  out << static_cast<int>(data);
+}
+template <std::size_t N>
+void dumpData(std::ostream &out, const VlWide<N> &data) {
+  std::ios_base::fmtflags flags = out.flags();
+  char fill = out.fill('0');
+  out << "0x" << std::hex;
+  for (std::size_t i = N; i-- > 0;)
+    out << std::setw(8) << data.data()[i];
+  out.flags(flags);
+  out.fill(fill);
+}
+
 /// Generic interface to access various parts of the verilated model. This is
 /// needed due to verilator models themselves not inheriting from some form of
 /// interface.
@@ -62,22 +217,82 @@ struct VerilatorGenericInterface {
   CData *nReset = nullptr;
 };
 
+// Period of the interface clock, in ps, unless given by HLT_CLOCKS.
+static constexpr uint64_t kDefaultClockPeriod = 10000;
+
+/// Returns the period, in ps, of the clock 'name' as given by HLT_CLOCKS, or
+/// 'period' if it isn't listed. HLT_CLOCKS lists the frequency of each clock
+/// in MHz, e.g. "clock=200,memory=100"; the interface clock is named "clock".
+inline uint64_t clockPeriodFromEnv(const std::string &name, uint64_t period) {
+  const char *env = std::getenv("HLT_CLOCKS");
+  if (!env)
+    return period;
+  std::istringstream clocks(env);
+  std::string entry;
+  while (std::getline(clocks, entry, ',')) {
+    size_t eq = entry.find('=');
+    if (eq == std::string::npos || entry.substr(0, eq) != name)
+      continue;
+    double mhz = std::atof(entry.c_str() + eq + 1);
+    if (mhz <= 0) {
+      std::cerr << "Warning: Ignoring the frequency of clock '" << name
+                << "' in HLT_CLOCKS: '" << entry << "'\n";
+      return period;
+    }
+    return std::max<uint64_t>(static_cast<uint64_t>(1e6 / mhz + 0.5), 2);
+  }
+  return period;
+}
+
+/// A clock domain of the model other than that of the interface clock. Each
+/// clock toggles every half of its own period, and drives a clock signal of
+/// the model, if any, and the software ports which are bound to it, such as
+/// a memory model which runs at a different clock than the kernel.
+struct VerilatorClock {
+  std::string name;
+  // Clock signal of the model, or nullptr for a clock of software ports only.
+  CData *signal = nullptr;
+  // Period of the clock, and time of its next edge, in ps.
+  uint64_t period = 0;
+  uint64_t nextEdge = 0;
+  bool nextRising = true;
+  // Number of rising edges of the clock.
+  uint64_t cycles = 0;
+  // Evaluates the ports of the domain after each edge of the clock, given
+  // whether this is the first evaluation after a rising edge. Returns true if
+  // the ports changed an input of the model, or their own state.
+  std::vector<std::function<bool(bool)>> ports;
+};
+
 template <typename TInput, typename TOutput, typename TModel>
 class VerilatorSimInterface : public SimInterface<TInput, TOutput> {
 public:
   VerilatorSimInterface() : SimInterface<TInput, TOutput>() {
+    // The signals of the ports which the simulator constructs mark the model
+    // to be evaluated.
+    constructingModelDirty() = &modelDirty;
+
     // Instantiate the verilated model
     ctx = std::make_unique<VerilatedContext>();
     dut = std::make_unique<TModel>(ctx.get());
 
 #if VM_TRACE
     ctx->traceEverOn(true);
-    trace = std::make_unique<VerilatedVcdC>();
+    traceConfig = TraceConfig::fromEnv();
+#if VM_TRACE_FST
+    if (traceConfig.ringCycles != 0) {
+      std::cerr << "Warning: HLT_TRACE_RING is not supported for FST traces, "
+                   "and is ignored.\n";
+      traceConfig.ringCycles = 0;
+    }
+    trace = std::make_unique<TraceWriter>();
+#else
+    if (traceConfig.ringCycles != 0)
+      ringFile = std::make_unique<VcdRingFile>(traceConfig.ringCycles);
+    trace = std::make_unique<TraceWriter>(ringFile.get());
+#endif
     // Log 99 levels of hierarchy
     dut->trace(trace.get(), 99);
-    // Create logging output directory
-    Verilated::mkdir("logs");
-    trace->open("logs/vlt_dump.vcd");
 #endif
   }
 
@@ -102,17 +317,250 @@ public:
   }
 
   void setup() override {
+    if (constructingModelDirty() == &modelDirty)
+      constructingModelDirty() = nullptr;
+#if VM_TRACE
+    // Create logging output directory. The trace is opened here rather than
+    // in the constructor, since the file name depends on the instance index.
+    Verilated::mkdir("logs");
+    std::string traceFile = "logs/vlt_dump";
+    if (this->instance != 0)
+      traceFile += "_" + std::to_string(this->instance);
+    trace->open((traceFile + kTraceExtension).c_str());
+#endif
+#if HLT_SAIF
+    saif.discover(ctx.get());
+    if (saif.size() == 0)
+      std::cerr << "Warning: HLT_SAIF found no signals. Was the model "
+                   "verilated with --public-flat-rw?\n";
+#endif
+#if HLT_MEMORY_IMAGES
+    memoryImages.addFromEnv();
+    memoryImages.discover(ctx.get());
+#endif
+
     // Verify generic interface
     assert(interface.clock != nullptr && "Must set pointer to clock signal");
     assert((static_cast<bool>(interface.reset) ^
             static_cast<bool>(interface.nReset)) &&
            "Must set pointer to either reset or nReset");
 
+    clockPeriod = clockPeriodFromEnv("clock", clockPeriod);
+    for (auto &clock : clocks)
+      clock.period = clockPeriodFromEnv(clock.name, clock.period);
+    resetModel();
+  }
+
+  void resetInPlace() override { resetModel(); }
+
+  /// Sets the period of the interface clock, in ps. HLT_CLOCKS takes
+  /// precedence. Must be called before setup().
+  void setClockPeriod(uint64_t period) { clockPeriod = period; }
+
+  /// Adds a clock domain 'name' of 'period' ps, which drives 'signal' of the
+  /// model, if not nullptr. HLT_CLOCKS takes precedence over 'period'. Must be
+  /// called before setup().
+  void addClock(const std::string &name, CData *signal, uint64_t period) {
+    assert(period >= 2 && "Expected a clock period of at least 2 ps");
+    assert(!getClock(name) && "Clock added twice");
+    VerilatorClock &clock = clocks.emplace_back();
+    clock.name = name;
+    clock.signal = signal;
+    clock.period = period;
+  }
+
+  /// Evaluates 'port' after each edge of clock 'name', rather than along with
+  /// the interface clock; see VerilatorClock::ports. Must be called before
+  /// setup().
+  void bindToClock(const std::string &name, std::function<bool(bool)> port) {
+    VerilatorClock *clock = getClock(name);
+    assert(clock && "Binding a port to an unknown clock");
+    clock->ports.push_back(std::move(port));
+  }
+
+  /// Returns the clock domain 'name', or nullptr if there is none.
+  VerilatorClock *getClock(const std::string &name) {
+    auto it = std::find_if(clocks.begin(), clocks.end(),
+                           [&](auto &clock) { return clock.name == name; });
+    return it == clocks.end() ? nullptr : &*it;
+  }
+
+  /// Initializes the memory within the model of op instance 'name' (e.g.
+  /// 'handshake_memory3') from the image 'init' at reset, and writes it to
+  /// 'dump' when the simulator finishes; see VerilatorMemoryImages. Either file
+  /// may be empty. Requires HLT_MEMORY_IMAGES.
+  void addMemoryImage(const std::string &name, const std::string &init,
+                      const std::string &dump) {
+#if HLT_MEMORY_IMAGES
+    memoryImages.add(name, init, dump);
+#else
+    std::cerr << "The image of memory " << name
+              << " requires a model built with HLT_MEMORY_IMAGES\n";
+    std::abort();
+#endif
+  }
+
+  bool saveCheckpoint(const std::string &path) override {
+#if HLT_CHECKPOINTS
+    // The state of the ports and any other harness state is appended to the
+    // state of the verilated model, prefixed by its size.
+    std::ostringstream state;
+    saveState(state);
+    std::string stateStr = state.str();
+    uint64_t stateSize = stateStr.size();
+
+    VerilatedSave os;
+    os.open(path.c_str());
+    if (!os.isOpen())
+      return false;
+    os << *dut;
+    os.write(&stateSize, sizeof(stateSize));
+    os.write(stateStr.data(), stateSize);
+    os.close();
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  bool restoreCheckpoint(const std::string &path) override {
+#if HLT_CHECKPOINTS
+    VerilatedRestore is;
+    is.open(path.c_str());
+    if (!is.isOpen())
+      return false;
+    is >> *dut;
+    uint64_t stateSize = 0;
+    is.read(&stateSize, sizeof(stateSize));
+    std::string stateStr(stateSize, '\0');
+    is.read(stateStr.data(), stateSize);
+    is.close();
+
+    std::istringstream state(stateStr);
+    restoreState(state);
+    modelDirty = true;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+#if HLT_DEBUG_SERVER
+  /// Serves the handshake signals ('*_valid', '*_ready' and '*_data') within
+  /// all scopes of the model. Signals are named by their scope, as in a trace
+  /// of the model.
+  void addDebugSignals(SimDebugServer &server) override {
+    static const std::vector<std::string> kSuffixes = {"_valid", "_ready",
+                                                       "_data"};
+    for (auto &scopeIt : *ctx->scopeNameMap()) {
+      const VerilatedScope *scope = scopeIt.second;
+      VerilatedVarNameMap *vars = scope->varsp();
+      if (!vars)
+        continue;
+      for (auto &varIt : *vars) {
+        std::string name = varIt.first;
+        const VerilatedVar &var = varIt.second;
+        bool isHandshake = std::any_of(
+            kSuffixes.begin(), kSuffixes.end(), [&](auto &suffix) {
+              return name.size() > suffix.size() &&
+                     name.compare(name.size() - suffix.size(), suffix.size(),
+                                  suffix) == 0;
+            });
+        if (!isHandshake || var.udims() != 0)
+          continue;
+        server.addSignal(std::string(scope->name()) + "." + name, var.datap(),
+                         var.packed().elements());
+      }
+    }
+  }
+#endif
+
+  void saveState(std::ostream &os) const override {
+    writeState(os, m_clockCycles);
+    writeState(os, ctx->time());
+    writeState(os, nextClockEdge);
+    for (auto &clock : clocks) {
+      writeState(os, clock.nextEdge);
+      writeState(os, clock.nextRising);
+      writeState(os, clock.cycles);
+    }
+    for (auto &inPort : this->inPorts)
+      inPort->saveState(os);
+    for (auto &outPort : this->outPorts)
+      outPort->saveState(os);
+  }
+
+  void restoreState(std::istream &is) override {
+    readState(is, m_clockCycles);
+    uint64_t time = 0;
+    readState(is, time);
+    ctx->time(time);
+    readState(is, nextClockEdge);
+    for (auto &clock : clocks) {
+      readState(is, clock.nextEdge);
+      readState(is, clock.nextRising);
+      readState(is, clock.cycles);
+      if (clock.signal)
+        *clock.signal = !clock.nextRising;
+    }
+    for (auto &inPort : this->inPorts)
+      inPort->restoreState(is);
+    for (auto &outPort : this->outPorts)
+      outPort->restoreState(is);
+  }
+
+  void finish() override {
+    dut->final();
+
+    closeTrace();
+#if VM_COVERAGE
+    writeCoverage();
+#endif
+#if HLT_SAIF
+    writeSaif();
+#endif
+#if HLT_MEMORY_IMAGES
+    writeMemoryImages();
+#endif
+  }
+
+  void idle() override {
+#if VM_TRACE
+    // The runner may never finish the simulator, so write out the trace
+    // whenever the simulation goes idle.
+    if (trace->isOpen())
+      trace->flush();
+#endif
+#if VM_COVERAGE
+    writeCoverage();
+#endif
+#if HLT_SAIF
+    writeSaif();
+#endif
+#if HLT_MEMORY_IMAGES
+    writeMemoryImages();
+#endif
+  }
+
+  /// Closes the trace, writing out any buffered trace. Simulators should call
+  /// this before failing, such that a ring buffered trace is written to disk.
+  void closeTrace() {
+#if VM_TRACE
+    if (trace->isOpen())
+      trace->close();
+#endif
+  }
+
+protected:
+  // Holds the model in reset for HLT_RESET_CYCLES cycles, and resets the in-
+  // and output ports.
+  void resetModel() {
     // Reset top-level model
     if (interface.reset)
       *interface.reset = !0;
     else
       *interface.nReset = !1;
+    modelDirty = true;
 
     // Reset in- and output ports
     for (auto &port : this->inPorts)
@@ -121,7 +569,7 @@ public:
       port->reset();
 
     // Run for a few cycles with reset.
-    for (int i = 0; i < 2; ++i)
+    for (int i = 0; i < HLT_RESET_CYCLES; ++i)
       this->clock();
 
     // Disassert reset
@@ -129,46 +577,256 @@ public:
       *interface.reset = !1;
     else
       *interface.nReset = !0;
+#if HLT_MEMORY_IMAGES
+    // Memories are not reset, so their images are loaded in place of the
+    // stores which would otherwise initialize them.
+    memoryImages.preload();
+#endif
+    modelDirty = true;
     this->clock();
   }
 
-  void finish() override {
-    dut->final();
+#if VM_COVERAGE
+  // Writes the coverage counters of the model (verilated with --coverage) to
+  // coverage.dat, or to the file named by HLT_COVERAGE_FILE. The counters
+  // accumulate over all calls of the simulation.
+  void writeCoverage() {
+    if (coverageCycle == m_clockCycles)
+      return;
+    coverageCycle = m_clockCycles;
+    std::string path = "coverage.dat";
+    if (const char *file = std::getenv("HLT_COVERAGE_FILE"))
+      path = file;
+    else if (this->instance != 0)
+      path = "coverage_" + std::to_string(this->instance) + ".dat";
+    ctx->coveragep()->write(path.c_str());
+  }
+#endif
 
-#if VM_TRACE
-    // Close trace if opened.
-    trace->close();
+#if HLT_SAIF
+  // Writes the switching activity recorded so far to activity.saif.
+  void writeSaif() {
+    if (saifCycle == m_clockCycles)
+      return;
+    saifCycle = m_clockCycles;
+    std::string suffix =
+        this->instance == 0 ? "" : "_" + std::to_string(this->instance);
+    if (!saif.write(suffix))
+      std::cerr << "Warning: Could not write the switching activity of the "
+                   "model\n";
+  }
 #endif
+
+#if HLT_MEMORY_IMAGES
+  // Writes the memories which have dump files.
+  void writeMemoryImages() {
+    if (memoryImagesCycle == m_clockCycles)
+      return;
+    memoryImagesCycle = m_clockCycles;
+    std::string suffix =
+        this->instance == 0 ? "" : "_" + std::to_string(this->instance);
+    if (!memoryImages.dump(suffix))
+      std::cerr << "Warning: Could not write the memories of the model\n";
   }
+#endif
 
-protected:
   void advanceTime() {
 #if VM_TRACE
-    trace->dump(ctx->time());
-    // If tracing, flush after each cycle so we can immediately see the output.
-    trace->flush();
+    traceTime();
 #endif
     ctx->timeInc(1);
+    // The outputs of the model only change once its inputs change, so the
+    // model is only evaluated if its inputs were written since it was last
+    // evaluated.
+    if (HLT_EVAL_ON_CHANGE && !modelDirty)
+      return;
+    HLT_PROFILE_SCOPE("eval");
+    HLT_PERF_SCOPE(SimPerfComponent::Model);
     dut->eval();
+    modelDirty = false;
+  }
+
+#if VM_TRACE
+  // Dumps the current time step to the trace, if the current cycle is to be
+  // traced.
+  void traceTime() {
+    if (!traceConfig.trigger.empty() && !traceTriggered)
+      return;
+    if (!traceConfig.inWindow(m_clockCycles)) {
+      // Write out the trace once the end of the window has been passed.
+      if (lastTraceCycle && !traceConfig.ringCycles) {
+        trace->flush();
+        lastTraceCycle.reset();
+      }
+      return;
+    }
+    if (lastTraceCycle != m_clockCycles) {
+      if (traceConfig.ringCycles != 0)
+        nextRingCycle();
+      else if (m_clockCycles % HLT_TRACE_FLUSH_INTERVAL == 0)
+        trace->flush();
+      lastTraceCycle = m_clockCycles;
+    }
+    trace->dump(ctx->time());
+  }
+
+  // Moves the trace of the last cycle into the ring buffer.
+  void nextRingCycle() {
+#if !VM_TRACE_FST
+    trace->flush();
+    ringFile->nextCycle();
+#endif
   }
 
+  // Starts tracing, if tracing is waiting for a trigger.
+  void triggerTrace() { traceTriggered = true; }
+#endif
+
   // Clocks the model a half phase (rising or falling edge)
   void clock_half(bool rising) {
+    // The edges of the other clocks which precede this edge of the interface
+    // clock are simulated first, in order of time.
+    while (!clocks.empty()) {
+      uint64_t time = nextOtherEdge();
+      if (time >= nextClockEdge)
+        break;
+      // Clocks which drive neither the model nor any ports, such as a memory
+      // clock whose cycles are only counted, just toggle.
+      bool active = std::any_of(clocks.begin(), clocks.end(), [&](auto &c) {
+        return c.nextEdge == time && (c.signal || !c.ports.empty());
+      });
+      if (!active) {
+        toggleClocksAt(time);
+        toggledClocks.clear();
+        continue;
+      }
+      advanceTime();
+      toggleClocksAt(time);
+      {
+        HLT_PERF_SCOPE(SimPerfComponent::Model);
+        dut->eval();
+      }
+      modelDirty = false;
+      evalClockedPorts();
+      advanceTime();
+    }
+
     // Ensure combinational logic is settled, if input pins changed.
     advanceTime();
+#if HLT_SAIF
+    // Signals are sampled as they settled before the rising edge.
+    if (rising)
+      saif.sample(m_clockCycles);
+#endif
     *interface.clock = rising;
-    dut->eval();
+    // Other clocks with an edge at the same time toggle along with the
+    // interface clock.
+    if (!clocks.empty())
+      toggleClocksAt(nextClockEdge);
+    {
+      HLT_PERF_SCOPE(SimPerfComponent::Model);
+      dut->eval();
+    }
+    modelDirty = false;
+    evalClockedPorts();
     advanceTime();
+    nextClockEdge += rising ? clockPeriod / 2 : clockPeriod - clockPeriod / 2;
   }
 
   void clock_rising() { clock_half(true); }
   void clock_falling() { clock_half(false); }
   void clock_flip() { clock_half(!*interface.clock); }
   void clock() {
+    // Ports aren't evaluated while the model is held in reset or settles, so
+    // neither are those of the other clock domains.
+    bool enabled = std::exchange(clockedPortsEnabled, false);
     clock_rising();
     clock_falling();
+    clockedPortsEnabled = enabled;
+  }
+
+  // Returns the time of the next edge of the clocks other than the interface
+  // clock.
+  uint64_t nextOtherEdge() const {
+    uint64_t time = UINT64_MAX;
+    for (auto &clock : clocks)
+      time = std::min(time, clock.nextEdge);
+    return time;
+  }
+
+  // Toggles the clocks which have an edge at 'time'. Their ports are then
+  // evaluated by evalClockedPorts(), once the model was evaluated.
+  void toggleClocksAt(uint64_t time) {
+    for (auto &clock : clocks) {
+      if (clock.nextEdge != time)
+        continue;
+      bool rising = clock.nextRising;
+      if (clock.signal)
+        *clock.signal = rising;
+      if (rising)
+        clock.cycles++;
+      clock.nextEdge += rising ? clock.period / 2
+                               : clock.period - clock.period / 2;
+      clock.nextRising = !rising;
+      toggledClocks.push_back({&clock, rising});
+    }
   }
 
+  // Evaluates the ports of the clocks toggled by toggleClocksAt(), until
+  // neither the ports nor the model change.
+  void evalClockedPorts() {
+    for (auto [clock, rising] : toggledClocks) {
+      if (!clockedPortsEnabled || clock->ports.empty())
+        continue;
+      bool first = rising;
+      int changeCount = HLT_TIMEOUT;
+      bool changed = true;
+      while (changed) {
+        if (changeCount-- == 0) {
+          std::cerr << "Evaluated the ports of clock '" << clock->name
+                    << "' HLT_TIMEOUT times; this probably means that there "
+                       "is a combinational loop between the ports and the "
+                       "RTL simulation.\n";
+          closeTrace();
+          std::abort();
+        }
+        changed = false;
+        for (auto &port : clock->ports)
+          changed |= port(first);
+        first = false;
+        if (changed)
+          advanceTime();
+      }
+    }
+    toggledClocks.clear();
+  }
+
+  // Returns true if the state of the model changed since the last call. The
+  // state is compared by the bytes of the root module of the model, which
+  // holds all signals of a model without dynamically sized variables (such as
+  // strings or queues), as is the case for the RTL of HLS kernels. Models
+  // without a root module (Verilator < 4.210) are always considered changed.
+  bool modelChanged() {
+    if constexpr (HasRootModule<TModel>::value) {
+      const char *root = reinterpret_cast<const char *>(dut->rootp);
+      size_t size = sizeof(*dut->rootp);
+      if (modelSnapshot.size() == size &&
+          std::memcmp(modelSnapshot.data(), root, size) == 0)
+        return false;
+      modelSnapshot.assign(root, root + size);
+    }
+    return true;
+  }
+
+  template <typename T, typename = void>
+  struct HasRootModule : std::false_type {};
+  template <typename T>
+  struct HasRootModule<T, std::void_t<decltype(std::declval<T>().rootp)>>
+      : std::true_type {};
+
+  // Snapshot of the root module, as of the last call to modelChanged().
+  std::vector<char> modelSnapshot;
+
   // Pointer to the verilated model.
   std::unique_ptr<TModel> dut;
   std::unique_ptr<VerilatedContext> ctx;
@@ -177,8 +835,48 @@ protected:
   // Number of clock-cycles executed.
   uint64_t m_clockCycles = 0;
 
+  // Period of the interface clock, and time of its next edge, in ps.
+  uint64_t clockPeriod = kDefaultClockPeriod;
+  uint64_t nextClockEdge = 0;
+
+  // The clock domains other than that of the interface clock, the clocks
+  // which toggled at the current edge, and whether their ports are evaluated.
+  std::deque<VerilatorClock> clocks;
+  std::vector<std::pair<VerilatorClock *, bool>> toggledClocks;
+  bool clockedPortsEnabled = true;
+
+  // Set whenever an input of the model was written since the model was last
+  // evaluated; see advanceTime.
+  bool modelDirty = true;
+
+#if VM_COVERAGE
+  // Clock cycle at which the coverage counters were last written.
+  std::optional<uint64_t> coverageCycle;
+#endif
+
+#if HLT_SAIF
+  // The switching activity of the model, and the clock cycle at which it was
+  // last written.
+  VerilatorSaif saif{SaifConfig::fromEnv()};
+  std::optional<uint64_t> saifCycle;
+#endif
+
+#if HLT_MEMORY_IMAGES
+  // The images of the memories of the model, and the clock cycle at which the
+  // memories were last written out.
+  VerilatorMemoryImages memoryImages;
+  std::optional<uint64_t> memoryImagesCycle;
+#endif
+
 #if VM_TRACE
-  std::unique_ptr<VerilatedVcdC> trace;
+  TraceConfig traceConfig;
+  bool traceTriggered = false;
+  std::optional<uint64_t> lastTraceCycle;
+#if !VM_TRACE_FST
+  // Must outlive the trace which writes to it.
+  std::unique_ptr<VcdRingFile> ringFile;
+#endif
+  std::unique_ptr<TraceWriter> trace;
 #endif
 };
 
@@ -0,0 +1,207 @@
+#ifndef CIRCT_TOOLS_HLT_VERILATORTOKENTRACE_H
+#define CIRCT_TOOLS_HLT_VERILATORTOKENTRACE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "verilated.h"
+#include "verilated_syms.h"
+
+namespace circt {
+namespace hlt {
+
+/// Records the tokens transferred over each handshake channel within a
+/// verilated model, i.e. the cycle, channel and data value of each transaction
+/// (valid && ready). Channels are found as in VerilatorChannelStats, with the
+/// optional '<name>_data' signal of each channel being recorded if it is at
+/// most 64 bits wide.
+///
+/// Tokens are written to a compact columnar binary file, which is a fraction
+/// of the size of a VCD trace of the same simulation. All integers are little
+/// endian, and varints are unsigned LEB128:
+///
+///   header:  "HLTTOKEN", u32 version, u32 #channels
+///            per channel: u32 name length, name, u32 data width (0: no data)
+///   chunks:  u32 #tokens, u64 cycle of the first token,
+///            u32 byte size of each of the below columns,
+///            cycles:   varint cycle delta to the previous token of the chunk,
+///            channels: varint channel index of each token,
+///            data:     varint data value of each token of a channel with data.
+///
+/// Chunks are appended whenever enough tokens are buffered, or on flush(),
+/// such that the file can be read while the simulation is running.
+class VerilatorTokenTrace {
+  struct Channel {
+    std::string name;
+    const CData *valid;
+    const CData *ready;
+    const void *data = nullptr;
+    VerilatedVarType dataType = VLVT_UNKNOWN;
+    uint32_t width = 0;
+  };
+
+public:
+  static constexpr uint32_t kVersion = 1;
+  // Number of tokens which are buffered before a chunk is written.
+  static constexpr size_t kChunkSize = 1 << 16;
+
+  ~VerilatorTokenTrace() { flush(); }
+
+  /// Finds the channels within all scopes of the model of 'ctx'.
+  void discover(VerilatedContext *ctx) {
+    static const std::string kValid = "_valid";
+    channels.clear();
+    for (auto &scopeIt : *ctx->scopeNameMap()) {
+      const VerilatedScope *scope = scopeIt.second;
+      VerilatedVarNameMap *vars = scope->varsp();
+      if (!vars)
+        continue;
+
+      std::string scopeName = scope->name();
+      if (scopeName.rfind("TOP.", 0) == 0)
+        scopeName = scopeName.substr(4);
+
+      for (auto &varIt : *vars) {
+        std::string name = varIt.first;
+        if (name.size() <= kValid.size() ||
+            name.compare(name.size() - kValid.size(), kValid.size(), kValid))
+          continue;
+        std::string prefix = name.substr(0, name.size() - kValid.size());
+        auto readyIt = vars->find((prefix + "_ready").c_str());
+        if (readyIt == vars->end() || !isBit(varIt.second) ||
+            !isBit(readyIt->second))
+          continue;
+        Channel channel{scopeName + "." + prefix,
+                        static_cast<const CData *>(varIt.second.datap()),
+                        static_cast<const CData *>(readyIt->second.datap())};
+        auto dataIt = vars->find((prefix + "_data").c_str());
+        if (dataIt != vars->end() && isScalar(dataIt->second)) {
+          channel.data = dataIt->second.datap();
+          channel.dataType = dataIt->second.vltype();
+          channel.width = dataIt->second.packed().elements();
+        }
+        channels.push_back(channel);
+      }
+    }
+    std::sort(channels.begin(), channels.end(),
+              [](auto &lhs, auto &rhs) { return lhs.name < rhs.name; });
+  }
+
+  /// Creates the trace file at 'path' and writes the channel table to it.
+  /// Returns false if the file could not be created.
+  bool open(const std::string &path) {
+    os.open(path, std::ios::binary | std::ios::trunc);
+    if (!os)
+      return false;
+    os.write("HLTTOKEN", 8);
+    writeFixed(os, kVersion, 4);
+    writeFixed(os, channels.size(), 4);
+    for (auto &channel : channels) {
+      writeFixed(os, channel.name.size(), 4);
+      os.write(channel.name.data(), channel.name.size());
+      writeFixed(os, channel.width, 4);
+    }
+    os.flush();
+    return true;
+  }
+
+  /// Records the tokens transferred at 'cycle'. This should be called once
+  /// per cycle, before the rising clock edge.
+  void sample(uint64_t cycle) {
+    if (!os.is_open())
+      return;
+    for (size_t i = 0; i < channels.size(); ++i) {
+      auto &channel = channels[i];
+      if (!*channel.valid || !*channel.ready)
+        continue;
+      if (numTokens == 0)
+        firstCycle = lastCycle = cycle;
+      writeVarint(cycles, cycle - lastCycle);
+      writeVarint(ids, i);
+      if (channel.data)
+        writeVarint(data, readData(channel));
+      lastCycle = cycle;
+      if (++numTokens == kChunkSize)
+        flush();
+    }
+  }
+
+  /// Appends the buffered tokens to the trace file as a chunk.
+  void flush() {
+    if (numTokens == 0 || !os.is_open())
+      return;
+    writeFixed(os, numTokens, 4);
+    writeFixed(os, firstCycle, 8);
+    for (auto *column : {&cycles, &ids, &data})
+      writeFixed(os, column->size(), 4);
+    for (auto *column : {&cycles, &ids, &data}) {
+      os.write(column->data(), column->size());
+      column->clear();
+    }
+    os.flush();
+    numTokens = 0;
+  }
+
+  size_t size() const { return channels.size(); }
+
+private:
+  static bool isBit(const VerilatedVar &var) {
+    return var.vltype() == VLVT_UINT8 && var.udims() == 0;
+  }
+
+  // Whether 'var' is held in a single integer, rather than in words.
+  static bool isScalar(const VerilatedVar &var) {
+    switch (var.vltype()) {
+    case VLVT_UINT8:
+    case VLVT_UINT16:
+    case VLVT_UINT32:
+    case VLVT_UINT64:
+      return var.udims() == 0;
+    default:
+      return false;
+    }
+  }
+
+  static uint64_t readData(const Channel &channel) {
+    switch (channel.dataType) {
+    case VLVT_UINT8:
+      return *static_cast<const CData *>(channel.data);
+    case VLVT_UINT16:
+      return *static_cast<const SData *>(channel.data);
+    case VLVT_UINT32:
+      return *static_cast<const IData *>(channel.data);
+    default:
+      return *static_cast<const QData *>(channel.data);
+    }
+  }
+
+  static void writeFixed(std::ostream &out, uint64_t value, unsigned bytes) {
+    for (unsigned i = 0; i < bytes; ++i)
+      out.put(static_cast<char>(value >> (8 * i)));
+  }
+
+  static void writeVarint(std::vector<char> &column, uint64_t value) {
+    do {
+      char byte = value & 0x7f;
+      value >>= 7;
+      column.push_back(value ? byte | 0x80 : byte);
+    } while (value);
+  }
+
+  std::vector<Channel> channels;
+  std::ofstream os;
+
+  // The columns of the chunk being buffered.
+  std::vector<char> cycles, ids, data;
+  size_t numTokens = 0;
+  uint64_t firstCycle = 0;
+  uint64_t lastCycle = 0;
+};
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_VERILATORTOKENTRACE_H
@@ -0,0 +1,119 @@
+#ifndef CIRCT_TOOLS_HLT_VERILATORTRACE_H
+#define CIRCT_TOOLS_HLT_VERILATORTRACE_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <string>
+
+#if VM_TRACE_FST
+#include "verilated_fst_c.h"
+#else
+#include "verilated_vcd_c.h"
+#endif
+
+#ifndef HLT_TRACE_FLUSH_INTERVAL
+// Number of cycles between each flush of the trace file to disk. The trace is
+// always flushed when it is closed.
+#define HLT_TRACE_FLUSH_INTERVAL 1000
+#endif
+
+namespace circt {
+namespace hlt {
+
+// The trace writer of the verilated model. FST traces are written through a
+// separate thread if the model was verilated with --trace-threads.
+#if VM_TRACE_FST
+using TraceWriter = VerilatedFstC;
+static constexpr const char *kTraceExtension = ".fst";
+#else
+using TraceWriter = VerilatedVcdC;
+static constexpr const char *kTraceExtension = ".vcd";
+#endif
+
+/// Runtime configuration of which parts of a simulation are traced. The
+/// configuration is read from the environment:
+///  HLT_TRACE_START=<cycle>   Do not trace cycles before <cycle>.
+///  HLT_TRACE_END=<cycle>     Do not trace cycles from <cycle> onwards.
+///  HLT_TRACE_TRIGGER=<port>  Do not trace until the handshake port named
+///                            <port> has transacted.
+///  HLT_TRACE_RING=<n>        Only keep the last <n> traced cycles in memory,
+///                            and write them to disk when the simulation times
+///                            out or fails. Only supported for VCD traces.
+struct TraceConfig {
+  uint64_t start = 0;
+  std::optional<uint64_t> end;
+  std::string trigger;
+  uint64_t ringCycles = 0;
+
+  static TraceConfig fromEnv() {
+    TraceConfig config;
+    if (const char *v = std::getenv("HLT_TRACE_START"))
+      config.start = std::strtoull(v, nullptr, 10);
+    if (const char *v = std::getenv("HLT_TRACE_END"))
+      config.end = std::strtoull(v, nullptr, 10);
+    if (const char *v = std::getenv("HLT_TRACE_TRIGGER"))
+      config.trigger = v;
+    if (const char *v = std::getenv("HLT_TRACE_RING"))
+      config.ringCycles = std::strtoull(v, nullptr, 10);
+    return config;
+  }
+
+  /// Returns true if 'cycle' should be traced.
+  bool inWindow(uint64_t cycle) const {
+    return cycle >= start && (!end || cycle < end.value());
+  }
+};
+
+#if !VM_TRACE_FST
+/// A VCD file which keeps the trace of the most recent cycles in memory, and
+/// only writes it to disk when closed. Each cycle must be started through
+/// nextCycle(), after flushing the trace of the last cycle. Signals which did
+/// not change within the retained cycles are reported as unknown until their
+/// first change.
+class VcdRingFile : public VerilatedVcdFile {
+public:
+  VcdRingFile(uint64_t numCycles) : numCycles(numCycles) {}
+
+  bool open(const std::string &name) override {
+    this->name = name;
+    header.clear();
+    cycles.clear();
+    return true;
+  }
+
+  void close() override {
+    std::ofstream os(name);
+    os << header;
+    for (auto &cycle : cycles)
+      os << cycle;
+  }
+
+  ssize_t write(const char *bufp, ssize_t len) override {
+    // Anything written before the first cycle is the VCD header.
+    (cycles.empty() ? header : cycles.back()).append(bufp, len);
+    return len;
+  }
+
+  /// Starts buffering the trace of a new cycle, discarding the oldest cycle
+  /// once the buffer is full.
+  void nextCycle() {
+    cycles.emplace_back();
+    if (cycles.size() > numCycles)
+      cycles.pop_front();
+  }
+
+private:
+  uint64_t numCycles;
+  std::string name;
+  std::string header;
+  std::deque<std::string> cycles;
+};
+#endif
+
+} // namespace hlt
+} // namespace circt
+
+#endif // CIRCT_TOOLS_HLT_VERILATORTRACE_H
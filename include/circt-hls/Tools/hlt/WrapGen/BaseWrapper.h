@@ -24,6 +24,49 @@ using namespace mlir;
 
 namespace circt_hls {
 
+/// A kernel to wrap; see BaseWrapper::wrap.
+struct WrapTarget {
+  mlir::func::FuncOp funcOp;
+  Operation *refOp = nullptr;
+  Operation *kernelOp = nullptr;
+};
+
+/// A memref argument of a kernel which is a bank of a partitioned memref; see
+/// -affine-partition-memrefs. The host passes the partitioned memref as a
+/// single argument, from which the view of each bank is derived.
+struct MemRefPartition {
+  // Index of the partitioned memref in the host signature.
+  unsigned arg;
+  unsigned dim;
+  int64_t factor;
+  int64_t bank;
+  bool cyclic;
+  // Shape of the partitioned memref.
+  SmallVector<int64_t> shape;
+};
+
+/// A memref argument of a kernel whose elements each combine 'factor'
+/// consecutive elements of the innermost dimension of a host memref; see
+/// -affine-vectorize-memrefs. The host passes the memref of narrow elements,
+/// which is accessed in place through the wide elements.
+struct MemRefVector {
+  int64_t factor;
+  // Shape of the host memref.
+  SmallVector<int64_t> shape;
+  // Element type of the host memref, if not an integer of the width of the
+  // lanes of the wide elements.
+  Type element;
+};
+
+/// A scalar argument of a kernel which is element 'elem' of a small host
+/// memref, in row-major order; see -hls-scalarize-memrefs. The host passes the
+/// memref as a single argument, from which each element is read at the call.
+struct MemRefScalar {
+  int64_t elem;
+  // Shape of the host memref.
+  SmallVector<int64_t> shape;
+};
+
 class BaseWrapper {
 public:
   BaseWrapper(StringRef outDir) : outDir(outDir) {}
@@ -40,14 +83,156 @@ public:
   LogicalResult wrap(mlir::func::FuncOp funcOp, Operation *refOp,
                      Operation *kernelOp);
 
+  /// Wraps a set of kernels into a single wrapper, written to
+  /// 'wrapperName'.cpp/.h. Each kernel is simulated by its own driver, and is
+  /// called through its own set of call and await functions. Each kernel is
+  /// additionally exposed as a C++ class (see emitKernelClass), of which each
+  /// object owns a driver of its own.
+  LogicalResult wrap(ArrayRef<WrapTarget> targets, StringRef wrapperName);
+
   std::string getOutputFileName() { return outputFilename; }
 
+  /// Returns the paths of the files which the wrapper has generated, whether
+  /// or not they were rewritten (see writeOutputFile).
+  ArrayRef<std::string> getOutputFiles() { return outputFiles; }
+
+  /// Sets the number of simulator instances that kernel calls are distributed
+  /// over. If different from 1, a SimDriverPool is emitted in place of a
+  /// SimDriver; 0 creates an instance per hardware thread.
+  void setPoolSize(unsigned size) { poolSize = size; }
+
+  /// If set, wrappers which support it will emit the simulator ports as a
+  /// tuple of concrete port types, evaluated without virtual dispatch.
+  void setStaticPorts(bool enable) { staticPorts = enable; }
+
+  /// Sets the number of threads that wrappers which support it run kernel
+  /// calls on concurrently, within a single simulator instance. 0 creates a
+  /// thread per hardware thread.
+  void setCallThreads(unsigned threads) { callThreads = threads; }
+
+  /// Sets the kernel arguments whose memories, in wrappers which support it,
+  /// may be backed by a memory mapped file at runtime, as given by the
+  /// HLT_MMAP_ARG<idx> environment variable of the simulation.
+  void setMappedArgs(ArrayRef<unsigned> args) {
+    mappedArgs.assign(args.begin(), args.end());
+  }
+
+  /// If set, wrappers which support it will serve the kernel memories from
+  /// within the simulated model, through DPI-C calls into the simulator.
+  void setDpiMemories(bool enable) { dpiMemories = enable; }
+
+  /// If set, wrappers which support it will simulate the kernel on a model
+  /// compiled by arcilator (see ArcSimInterface.h), rather than on a verilated
+  /// model.
+  void setArcilator(bool enable) { arcilator = enable; }
+
+  /// Sets the Calyx program which the Calyx interpreter wrapper runs the
+  /// kernel from (see CalyxInterpSimInterface.h).
+  void setCalyxProgram(StringRef path) { calyxProgram = path.str(); }
+
+  /// Sets the kernel arguments whose memories, in wrappers which support it,
+  /// are streamed between the host and the kernel rather than served as random
+  /// access memories.
+  void setStreamArgs(ArrayRef<unsigned> args) {
+    streamArgs.assign(args.begin(), args.end());
+  }
+
+  /// If set, the wrapped kernels are additionally chained into a pipeline of
+  /// this name, in which the results of each kernel are streamed to the
+  /// leading arguments of the next kernel (see SimPipeline.h). The pipeline is
+  /// called through its own set of call and await functions.
+  void setChainName(StringRef name) { chainName = name.str(); }
+
+  /// If set, Python bindings of the class of each kernel are additionally
+  /// emitted to 'wrapperName'_py.cpp, as a module of that name (see
+  /// PyBindings.h).
+  void setPython(bool enable) { python = enable; }
+
+  /// If set, a main function is additionally emitted to main.cpp, which
+  /// streams the calls of an input stream through the wrapped function of
+  /// this name, with no other testbench (see SimStream.h).
+  void setMainName(StringRef name) { mainName = name.str(); }
+
+  /// If set, the functions which a natively compiled testbench calls the
+  /// kernels through are additionally emitted to 'wrapperName'_tb.cpp.
+  void setNativeTb(bool enable) { nativeTb = enable; }
+
 protected:
   virtual SmallVector<std::string> getNamespaces() = 0;
   virtual SmallVector<std::string> getIncludes() = 0;
 
   virtual void emitAsyncCall();
   virtual void emitAsyncAwait();
+  virtual void emitAsyncCallBatch();
+  virtual void emitAsyncAwaitBatch();
+  virtual void emitAsyncCallTagged();
+  virtual void emitAsyncAwaitTagged();
+  virtual void emitAsyncSubmit();
+  virtual void emitAsyncAwaitTicket();
+
+  /// Emits the call arguments as a comma-separated list, from which a TInput
+  /// is constructed. 'argSuffix' is appended to each argument name.
+  void emitInputArgs(StringRef argSuffix);
+
+  /// Emits the value returned by the await functions for the TOutput
+  /// 'output': its only result, or a tuple of all of its results.
+  void emitOutput(StringRef output);
+
+  /// Emits result 'idx' of the TOutput 'output', as a host value.
+  void emitResult(StringRef output, unsigned idx);
+
+  /// Returns true if the calls of the kernel may be recorded and replayed
+  /// (see SimRecord.h), which requires all host memrefs to be statically
+  /// shaped.
+  bool canReplay();
+
+  /// Emits the recording of the host inputs of a call, and of the TOutput
+  /// 'output' of an awaited call, if the calls are recorded.
+  void emitRecordInputs();
+  void emitRecordOutputs(StringRef output);
+
+  /// Returns the partition that kernel argument 'idx' is a bank of, if any.
+  Optional<MemRefPartition> getPartition(unsigned idx);
+
+  /// Returns the vectorization of kernel argument 'idx', if any.
+  Optional<MemRefVector> getVector(unsigned idx);
+
+  /// Returns the host memref element which kernel argument 'idx' is, if any.
+  Optional<MemRefScalar> getScalar(unsigned idx);
+
+  /// Returns the index of the memref result which kernel argument 'idx' holds,
+  /// if any; see -hls-memref-results-to-args. The wrapper allocates the memory
+  /// of each such argument at the call, and returns it from the await.
+  Optional<unsigned> getResultArg(unsigned idx);
+
+  /// Returns the index of the first kernel argument which holds a memref
+  /// result, if any.
+  Optional<unsigned> getMemRefResultArg();
+
+  /// Returns the types of the arguments of the call signatures, which are
+  /// those of the kernel, less the banks of each partitioned memref and the
+  /// elements of each scalarized memref, which the host passes as a single
+  /// memref, and less the memref results, with the narrow elements of each
+  /// vectorized memref.
+  SmallVector<Type> getHostInputs();
+
+  /// Returns the index of the host argument which each kernel argument is
+  /// derived from.
+  SmallVector<unsigned> getHostArgIndices();
+
+  /// Emits the C type of a kernel argument in the call signatures. This must
+  /// match the corresponding TArg type, such that the arguments are packed into
+  /// a TInput without any conversions, unless the type is converted (see
+  /// isHostConverted).
+  virtual LogicalResult emitArgType(llvm::raw_ostream &os, Location loc,
+                                    Type type,
+                                    Optional<StringRef> varName = {});
+
+  /// Returns true if values of 'type' differ between the call signatures and
+  /// the TArg and TRes types. Such values are converted through fromHost and
+  /// toHost, and the elements of such memrefs are accessed in place through
+  /// the element type of the TArg.
+  virtual bool isHostConverted(Type /*type*/) { return false; }
 
   virtual LogicalResult emitPreamble(Operation * /*kernelOp*/) {
     return success();
@@ -57,23 +242,106 @@ protected:
                                                   Type, Optional<StringRef>)>;
   LogicalResult emitIOTypes(const TypeEmitter &emitter);
 
-  llvm::raw_fd_ostream &os() { return *outputFile; }
+  llvm::raw_ostream &os() { return *outputFile; }
   raw_indented_ostream &osi() { return *outputFileIndented; }
 
-  std::unique_ptr<llvm::raw_fd_ostream> outputFile;
+  /// Writes 'contents' to the generated file 'fn', unless the file already
+  /// holds them, such that builds which depend on the file are not rerun when
+  /// the wrapper is regenerated without changes.
+  LogicalResult writeOutputFile(Location loc, StringRef fn, StringRef contents);
+
+  // The contents of the output file, which are written once the next file is
+  // created, or the wrapper is finished.
+  std::string outputContents;
+  std::unique_ptr<llvm::raw_string_ostream> outputFile;
   std::unique_ptr<raw_indented_ostream> outputFileIndented;
   std::string outputFilename;
+  Optional<Location> outputLoc;
+  SmallVector<std::string> outputFiles;
   StringRef outDir;
   func::FuncOp funcOp;
+  unsigned poolSize = 1;
+  bool staticPorts = false;
+  unsigned callThreads = 1;
+  SmallVector<unsigned> mappedArgs;
+  bool dpiMemories = false;
+  bool arcilator = false;
+  std::string calyxProgram;
+  SmallVector<unsigned> streamArgs;
+  std::string chainName;
+  bool python = false;
+  std::string mainName;
+  bool nativeTb = false;
+  // Set once a kernel with a memref result has been wrapped, whose await
+  // function returns a MemRefDescriptor.
+  bool memRefResults = false;
 
 private:
   /// Creates an output file with filename fn, and associates os() and osi()
-  /// with this file.
+  /// with this file. The previous output file is closed.
   LogicalResult createFile(Location loc, Twine fn);
 
-  /// Function signatures of the call and await functions. These will be written
-  /// to a separate header file.
-  std::string callSignature, awaitSignature;
+  /// Writes the output file, if any; see writeOutputFile.
+  LogicalResult closeFile();
+
+  /// Emits the files of the wrapper; see wrap.
+  LogicalResult emitWrapper(ArrayRef<WrapTarget> targets,
+                            StringRef wrapperName);
+
+  /// Emits the simulator, driver, and call and await functions of a single
+  /// kernel. funcOp must be set to the function of the kernel.
+  LogicalResult emitKernel(const WrapTarget &target);
+
+  /// Emits the function which replays a record file against the kernel.
+  LogicalResult emitReplay();
+
+  /// Emits the function which streams the calls of an input stream through
+  /// the kernel, and writes their outputs to an output stream.
+  LogicalResult emitStream();
+
+  /// Emits the driver, and call and await functions of the simulator TSim,
+  /// with types TInput and TOutput, of funcOp.
+  LogicalResult emitDriver();
+
+  /// Emits the pipeline of the kernels of 'targets', and its driver, as the
+  /// simulator of a function named chainName.
+  LogicalResult emitChain(ArrayRef<WrapTarget> targets);
+
+  /// Emits main.cpp, which streams the calls of an input stream through the
+  /// function of 'targets' named mainName.
+  LogicalResult emitMain(ArrayRef<WrapTarget> targets, StringRef wrapperName);
+
+  /// Emits 'wrapperName'_tb.cpp, which defines each function of 'targets'
+  /// with the C signature that a natively compiled testbench calls it by.
+  /// Each call is simulated synchronously, and is compared against the
+  /// reference '<function>_ref' if HLT_NATIVE_COSIM is defined (see
+  /// NativeCosim.h).
+  LogicalResult emitNativeTb(ArrayRef<WrapTarget> targets,
+                             StringRef wrapperName);
+
+  /// Emits the definition of the class of funcOp, whose declaration is added
+  /// to the header. Objects of the class are called through typed methods,
+  /// each on a TKernelDriver of its own, rather than on the global driver of
+  /// the call and await functions. 'ns' is the namespace of the types of the
+  /// kernel, if any. The class is emitted outside of that namespace, since it
+  /// is declared in the global namespace of the header.
+  LogicalResult emitKernelClass(StringRef ns);
+
+  /// Emits the Python binding of 'className', the class of funcOp, whose call
+  /// method returns a future of 'resultType'. Memref arguments are passed as
+  /// NumPy arrays, which the kernel accesses in place.
+  LogicalResult emitPythonBinding(StringRef className, StringRef resultType);
+
+  /// Function signatures of the (batched) call and await functions of each
+  /// wrapped kernel. These will be written to a separate header file.
+  SmallVector<std::string> signatures;
+
+  /// Declarations of the class of each wrapped kernel, which are written to
+  /// the header file after the signatures.
+  SmallVector<std::string> classDecls;
+
+  /// Python bindings of the class of each wrapped kernel, if python is set.
+  SmallVector<std::string> pyBindings;
 };
 
 } // namespace circt_hls
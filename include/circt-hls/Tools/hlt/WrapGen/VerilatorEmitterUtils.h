@@ -21,12 +21,22 @@ using namespace mlir;
 
 namespace circt_hls {
 
-/// Outputs Verilator types based on MLIR integer types.
+/// Outputs Verilator types based on MLIR integer types. Integers wider than 64
+/// bits are emitted as VlWide signals.
 LogicalResult emitVerilatorType(llvm::raw_ostream &os, Location loc, Type type,
                                 Optional<StringRef> varName = {});
 LogicalResult emitVerilatorTypeFromWidth(llvm::raw_ostream &os, Location loc,
                                 unsigned width);
 
+/// Returns 'type' with its integers (and the elements of memrefs) mapped to
+/// unsigned integers, matching the signedness of Verilator port types.
+Type getVerilatorSignedness(Type type);
+
+/// Checks that the integers of 'type' (and the elements of memrefs) are at
+/// most 64 bits wide. Arcilator models have no counterpart of the VlWide
+/// signals of wider ports.
+LogicalResult verifyArcilatorType(Location loc, Type type);
+
 } // namespace circt_hls
 
 #endif // CIRCT_TOOLS_HLT_WRAPGEN_VERILATOREMITTERUTILS_H
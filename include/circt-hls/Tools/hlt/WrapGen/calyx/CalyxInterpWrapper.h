@@ -0,0 +1,55 @@
+//===- CalyxInterpWrapper.h - Calyx interpreter wrapper ---------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the definition of the CalyxInterpWrapper class, an HLT
+// wrapper for wrapping Calyx based kernels simulated by the Calyx interpreter.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_TOOLS_HLT_WRAPGEN_CALYX_CALYXINTERPWRAPPER_H
+#define CIRCT_TOOLS_HLT_WRAPGEN_CALYX_CALYXINTERPWRAPPER_H
+
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/MLIRContext.h"
+
+#include "circt/Dialect/Calyx/CalyxOps.h"
+
+#include "circt-hls/Tools/hlt/WrapGen/BaseWrapper.h"
+#include "circt-hls/Tools/hlt/WrapGen/CEmitterUtils.h"
+
+using namespace mlir;
+using namespace circt;
+
+namespace circt_hls {
+
+class CalyxInterpWrapper : public BaseWrapper {
+public:
+  using BaseWrapper::BaseWrapper;
+  LogicalResult init(Operation *refOp, Operation *kernelOp) override;
+  LogicalResult emitPreamble(Operation *kernelOp) override;
+
+protected:
+  SmallVector<std::string> getIncludes() override;
+  SmallVector<std::string> getNamespaces() override { return {"circt", "hlt"}; }
+  LogicalResult emitArgType(llvm::raw_ostream &os, Location loc, Type type,
+                            Optional<StringRef> varName = {}) override;
+
+private:
+  LogicalResult emitSimulator();
+
+  // Emits the CalyxInterpPort of the in- or output port 'idx' of the
+  // component.
+  void emitPort(unsigned idx, bool isInput);
+
+  // Operation representing the reference module of the kernel.
+  calyx::ComponentOp compOp;
+};
+
+} // namespace circt_hls
+
+#endif // CIRCT_TOOLS_HLT_WRAPGEN_CALYX_CALYXINTERPWRAPPER_H
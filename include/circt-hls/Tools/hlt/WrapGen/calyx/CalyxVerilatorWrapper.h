@@ -45,6 +45,8 @@ public:
 protected:
   SmallVector<std::string> getIncludes() override;
   SmallVector<std::string> getNamespaces() override { return {"circt", "hlt"}; }
+  LogicalResult emitArgType(llvm::raw_ostream &os, Location loc, Type type,
+                            Optional<StringRef> varName = {}) override;
 
 private:
   LogicalResult emitSimulator();
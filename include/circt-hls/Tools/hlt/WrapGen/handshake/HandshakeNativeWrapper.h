@@ -0,0 +1,78 @@
+//===- HandshakeNativeWrapper.h - Native handshake wrapper ----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the definition of the HandshakeNativeWrapper class, an
+// HLT wrapper for wrapping handshake.funcop based kernels, simulated by a C++
+// dataflow model of the handshake function rather than by Verilator.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_TOOLS_HLT_WRAPGEN_HANDSHAKE_HANDSHAKENATIVEWRAPPER_H
+#define CIRCT_TOOLS_HLT_WRAPGEN_HANDSHAKE_HANDSHAKENATIVEWRAPPER_H
+
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/MLIRContext.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include "circt/Dialect/Handshake/HandshakeOps.h"
+
+#include "circt-hls/Tools/hlt/WrapGen/BaseWrapper.h"
+#include "circt-hls/Tools/hlt/WrapGen/CEmitterUtils.h"
+
+using namespace mlir;
+using namespace circt;
+
+namespace circt_hls {
+
+class HandshakeNativeWrapper : public BaseWrapper {
+public:
+  using BaseWrapper::BaseWrapper;
+  LogicalResult init(Operation *refOp, Operation *kernelOp) override;
+  LogicalResult emitPreamble(Operation *kernelOp) override;
+
+protected:
+  SmallVector<std::string> getIncludes() override;
+  SmallVector<std::string> getNamespaces() override {
+    return {"circt", "hlt", "native"};
+  }
+  LogicalResult emitArgType(llvm::raw_ostream &os, Location loc, Type type,
+                            Optional<StringRef> varName = {}) override;
+
+private:
+  LogicalResult emitSimulator();
+
+  // Emits the node which models 'op'.
+  LogicalResult emitNode(Operation *op);
+
+  // Emits the node of a handshake.memory or handshake.extmemory operation.
+  // 'inputs' are the store and load operands of the memory. 'arg' is the index
+  // of the memref argument accessed by an external memory.
+  LogicalResult emitMemory(Operation *op, MemRefType type, ValueRange inputs,
+                           unsigned ldCount, unsigned stCount,
+                           Optional<unsigned> arg);
+
+  // Returns the expression of the channel of 'v', or a Channels list of the
+  // channels of 'values'.
+  std::string ch(Value v);
+  std::string chs(ValueRange values);
+
+  // Operation representing the reference module of the kernel.
+  handshake::FuncOp hsOp;
+
+  // Index of the channel of each value of the handshake function.
+  llvm::DenseMap<Value, unsigned> channelIds;
+
+  // Type and name of each memory node, and the name of the memory node which
+  // accesses each memref argument.
+  SmallVector<std::pair<std::string, std::string>> memories;
+  llvm::DenseMap<unsigned, std::string> argMemories;
+};
+
+} // namespace circt_hls
+
+#endif // CIRCT_TOOLS_HLT_WRAPGEN_HANDSHAKE_HANDSHAKENATIVEWRAPPER_H
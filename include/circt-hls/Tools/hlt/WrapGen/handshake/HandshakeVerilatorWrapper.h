@@ -30,6 +30,12 @@ using namespace circt;
 
 namespace circt_hls {
 
+// Attributes on handshake.extmemory operations specifying the load latency and
+// initiation interval, in cycles, of the simulated memory. These are shared
+// with the native simulator (see HandshakeNativeWrapper).
+static constexpr StringLiteral kMemLatencyAttr = "hlt.latency";
+static constexpr StringLiteral kMemIIAttr = "hlt.ii";
+
 class HandshakeVerilatorWrapper : public BaseWrapper {
 public:
   using BaseWrapper::BaseWrapper;
@@ -39,6 +45,9 @@ public:
 protected:
   SmallVector<std::string> getIncludes() override;
   SmallVector<std::string> getNamespaces() override { return {"circt", "hlt"}; }
+  LogicalResult emitArgType(llvm::raw_ostream &os, Location loc, Type type,
+                            Optional<StringRef> varName = {}) override;
+  bool isHostConverted(Type type) override;
 
 private:
   // Returns the index in the firrtl port argument list of the input control
@@ -50,6 +59,37 @@ private:
   LogicalResult emitOutputPort(Type t, unsigned idx);
   LogicalResult emitExtMemPort(MemRefType t, unsigned idx);
 
+  // Emits the TInPorts and TOutPorts tuples of concrete port types, used for
+  // evaluating the ports of the simulator without virtual dispatch.
+  LogicalResult emitStaticPortTypes();
+
+  // Emits the concrete simulator port type of the respective in- or output.
+  LogicalResult emitInputPortType(llvm::raw_ostream &os, Type t, unsigned idx);
+  void emitOutputPortType(llvm::raw_ostream &os, unsigned idx);
+
+  // Returns the address width of the memory interface of a memref input.
+  unsigned getMemAddrWidth(unsigned idx);
+
+  // Returns the external memory operation of a memref input.
+  handshake::ExternalMemoryOp getExtMemOp(unsigned idx);
+
+  // Returns true if the memory of input 'idx' is streamed between the host
+  // and the kernel, through --stream-args or an 'hlt.stream' attribute.
+  bool isStreamArg(unsigned idx);
+
+  // Returns true if the memory of input 'idx' is served by the DPI-C adapter
+  // of the model, rather than by a HandshakeMemoryInterface.
+  bool isDpiMemory(unsigned idx);
+
+  // Emits <kernel>_dpi.sv, the top-level module of the model when memories
+  // are served through DPI-C. It wraps the kernel, and connects each DPI
+  // memory to an adapter which performs its accesses by DPI-C calls.
+  LogicalResult emitDpiAdapter();
+
+  // Emits the images of the handshake.memory operations of the kernel which
+  // the simulator initializes or writes out (see kMemInitAttr).
+  LogicalResult emitMemoryImages();
+
   // Returns the port names for the respective in- or output index.
   std::string getResName(unsigned idx);
   std::string getInputName(unsigned idx);
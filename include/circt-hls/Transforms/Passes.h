@@ -23,8 +23,27 @@ namespace circt_hls {
 //===----------------------------------------------------------------------===//
 std::unique_ptr<mlir::Pass> createAffineScalRepPass();
 std::unique_ptr<mlir::Pass> createPushConstantsPass();
+std::unique_ptr<mlir::Pass> createProfileBuffersPass();
+std::unique_ptr<mlir::Pass> createImportBuffersPass();
+std::unique_ptr<mlir::Pass> createShareUnitsPass();
+std::unique_ptr<mlir::Pass> createThroughputBoundPass();
+std::unique_ptr<mlir::Pass> createEstimateResourcesPass();
+std::unique_ptr<mlir::Pass> createPartitionMemrefsPass();
+std::unique_ptr<mlir::Pass> createVectorizeMemrefsPass();
+std::unique_ptr<mlir::Pass> createInferStreamsPass();
+std::unique_ptr<mlir::Pass> createPartitionTasksPass();
+std::unique_ptr<mlir::Pass> createScalarizeMemRefsPass();
+std::unique_ptr<mlir::Pass> createMemRefResultsToArgsPass();
+std::unique_ptr<mlir::Pass> createUnrollLoopsPass();
+std::unique_ptr<mlir::Pass> createApplyLoopPragmasPass();
 std::unique_ptr<mlir::Pass> createAsyncifyCallsPass();
 std::unique_ptr<mlir::Pass> createMaxSSAFormPass();
+std::unique_ptr<mlir::Pass> createNarrowBitwidthsPass();
+std::unique_ptr<mlir::Pass> createStrengthReducePass();
+std::unique_ptr<mlir::Pass> createAnnotateIndependencePass();
+std::unique_ptr<mlir::Pass> createIfConvertPass();
+std::unique_ptr<mlir::Pass> createFuseLoopsPass();
+std::unique_ptr<mlir::Pass> createTileScratchpadsPass();
 std::unique_ptr<mlir::Pass> createRenameFunctionPass();
 std::unique_ptr<mlir::Pass> createCleanUnregisteredAttrsPass();
 
@@ -26,6 +26,9 @@ class SCFDialect;
 namespace LLVM {
 class LLVMDialect;
 }
+namespace memref {
+class MemRefDialect;
+}
 
 namespace func {
 class FuncOp;
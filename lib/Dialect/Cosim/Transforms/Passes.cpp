@@ -9,6 +9,8 @@
 #include "PassDetails.h"
 #include "circt-hls/Dialect/Cosim/CosimOps.h"
 #include "circt-hls/Dialect/Cosim/CosimPasses.h"
+#include "mlir/Conversion/LLVMCommon/MemRefBuilder.h"
+#include "mlir/Conversion/LLVMCommon/TypeConverter.h"
 #include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/ControlFlow/IR/ControlFlow.h"
 #include "mlir/Dialect/ControlFlow/IR/ControlFlowOps.h"
@@ -19,9 +21,17 @@
 #include "mlir/IR/BuiltinDialect.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
 #include "mlir/IR/PatternMatch.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Interfaces/ViewLikeInterface.h"
 #include "mlir/Rewrite/FrozenRewritePatternSet.h"
 #include "mlir/Transforms/DialectConversion.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/Sequence.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/xxhash.h"
 
 using namespace mlir;
 using namespace circt_hls;
@@ -46,8 +56,18 @@ static int opPosDiff(Operation *op1, Operation *op2) {
              std::distance(entryOp.getIterator(), op1->getIterator()));
 }
 
-static Value copyAtLastMutationBefore(Value v, Operation *beforeOp,
-                                      PatternRewriter &rewriter) {
+static Value copyMemRef(Value v, PatternRewriter &rewriter) {
+  auto memrefCopy = rewriter.create<memref::AllocOp>(
+      v.getLoc(), v.getType().cast<MemRefType>());
+  rewriter.create<memref::CopyOp>(v.getLoc(), v, memrefCopy.getResult());
+  return memrefCopy;
+}
+
+/// Copies 'v' through 'copy' after the last mutation of 'v' before
+/// 'beforeOp'.
+static Value copyAtLastMutationBefore(
+    Value v, Operation *beforeOp, PatternRewriter &rewriter,
+    llvm::function_ref<Value(Value, PatternRewriter &)> copy = copyMemRef) {
   auto ip = rewriter.saveInsertionPoint();
 
   MemRefType memrefType = v.getType().dyn_cast<MemRefType>();
@@ -78,13 +98,80 @@ static Value copyAtLastMutationBefore(Value v, Operation *beforeOp,
     rewriter.setInsertionPointAfter(lastMutation);
 
   // Copy the value (again, memref only supported for now)
-  auto memrefCopy = rewriter.create<memref::AllocOp>(v.getLoc(), memrefType);
-  rewriter.create<memref::CopyOp>(v.getLoc(), v, memrefCopy.getResult());
+  Value memrefCopy = copy(v, rewriter);
 
   rewriter.restoreInsertionPoint(ip);
   return memrefCopy;
 }
 
+/// Returns true if 'v' is only ever read through, with 'visited' holding the
+/// function arguments which are already being analyzed.
+static bool isOnlyRead(Value v, llvm::DenseSet<Value> &visited);
+
+/// Returns true if argument 'idx' of 'funcOp' is never written through. The
+/// argument of an external function is only known to be read-only if it has
+/// the 'llvm.readonly' argument attribute.
+static bool isReadOnlyArg(mlir::func::FuncOp funcOp, unsigned idx,
+                          llvm::DenseSet<Value> &visited) {
+  if (funcOp.getArgAttr(idx, LLVM::LLVMDialect::getReadonlyAttrName()))
+    return true;
+  if (funcOp.isExternal())
+    return false;
+  // Assume that recursive calls don't write the argument; any write is
+  // caught in the outermost analysis of the function.
+  Value arg = funcOp.getArgument(idx);
+  if (!visited.insert(arg).second)
+    return true;
+  return isOnlyRead(arg, visited);
+}
+
+static bool isOnlyRead(Value v, llvm::DenseSet<Value> &visited) {
+  for (auto &use : v.getUses()) {
+    Operation *user = use.getOwner();
+    if (auto callOp = dyn_cast<mlir::func::CallOp>(user)) {
+      auto callee = SymbolTable::lookupNearestSymbolFrom<mlir::func::FuncOp>(
+          callOp, callOp.getCalleeAttr());
+      if (!callee || !isReadOnlyArg(callee, use.getOperandNumber(), visited))
+        return false;
+      continue;
+    }
+
+    // Views alias the value; check the view as well.
+    if (auto viewOp = dyn_cast<ViewLikeOpInterface>(user)) {
+      if (!isOnlyRead(viewOp->getResult(0), visited))
+        return false;
+      continue;
+    }
+
+    // Anything which doesn't specify its effects, or which may let the value
+    // escape, is assumed to write it.
+    auto effectOp = dyn_cast<MemoryEffectOpInterface>(user);
+    if (!effectOp || isa<mlir::func::ReturnOp>(user))
+      return false;
+    SmallVector<MemoryEffects::EffectInstance> effects;
+    effectOp.getEffectsOnValue(v, effects);
+    if (llvm::any_of(effects, [](auto &effect) {
+          return !isa<MemoryEffects::Read>(effect.getEffect());
+        }))
+      return false;
+    if (!effects.empty() || isa<memref::DimOp, memref::RankOp>(user))
+      continue;
+
+    // An op which neither reads nor writes the value may still pass it on,
+    // such as a cast. Its memref results alias the value, and are checked as
+    // well; any other result, such as an extracted pointer, may be written
+    // through.
+    if (!isMemoryEffectFree(user) ||
+        llvm::any_of(user->getResultTypes(),
+                     [](Type type) { return !type.isa<BaseMemRefType>(); }))
+      return false;
+    for (Value result : user->getResults())
+      if (!isOnlyRead(result, visited))
+        return false;
+  }
+  return true;
+}
+
 static void compareToRefAfterOp(Value ref, Value cosim, Operation *op,
                                 PatternRewriter &rewriter,
                                 Operation *refSrcOp = nullptr,
@@ -106,10 +193,461 @@ static void compareToRefAfterOp(Value ref, Value cosim, Operation *op,
   rewriter.restoreInsertionPoint(ip);
 }
 
+/// Returns the number of bytes of each element of a memref, if the memref is
+/// statically shaped and laid out contiguously.
+static Optional<int64_t> getContiguousElementBytes(MemRefType memrefType) {
+  if (!memrefType.hasStaticShape() || !memrefType.getLayout().isIdentity())
+    return {};
+  Type elemType = memrefType.getElementType();
+  if (elemType.isIndex())
+    return IndexType::kInternalStorageBitWidth / 8;
+  if (elemType.isIntOrFloat())
+    return llvm::divideCeil(elemType.getIntOrFloatBitWidth(), 8);
+  return {};
+}
+
+/// Returns the number of bits of the values of 'type'.
+static unsigned getElementBits(Type type) {
+  if (type.isIndex())
+    return IndexType::kInternalStorageBitWidth;
+  return type.getIntOrFloatBitWidth();
+}
+
+static Value insertI64Constant(Location loc, PatternRewriter &rewriter,
+                               uint64_t value) {
+  return rewriter.create<arith::ConstantOp>(
+      loc, rewriter.getI64IntegerAttr(static_cast<int64_t>(value)));
+}
+
+/// Returns the splitmix64 finalizer of the i64 'x', which mixes every bit of
+/// 'x' into every bit of the result.
+static Value insertMix(Location loc, PatternRewriter &rewriter, Value x) {
+  auto xorShift = [&](unsigned shift) {
+    x = rewriter.create<arith::XOrIOp>(
+        loc, x,
+        rewriter.create<arith::ShRUIOp>(
+            loc, x, insertI64Constant(loc, rewriter, shift)));
+  };
+  auto multiply = [&](uint64_t factor) {
+    x = rewriter.create<arith::MulIOp>(
+        loc, x, insertI64Constant(loc, rewriter, factor));
+  };
+  xorShift(30);
+  multiply(0xbf58476d1ce4e5b9ULL);
+  xorShift(27);
+  multiply(0x94d049bb133111ebULL);
+  xorShift(31);
+  return x;
+}
+
+/// Returns the bits of the integer, index or float 'v' of at most 64 bits,
+/// zero-extended to an i64.
+static Value insertBits(Location loc, PatternRewriter &rewriter, Value v) {
+  auto i64Type = rewriter.getI64Type();
+  Type type = v.getType();
+  if (type.isIndex())
+    return rewriter.create<arith::IndexCastOp>(loc, i64Type, v);
+  if (type.isa<FloatType>())
+    v = rewriter.create<arith::BitcastOp>(
+        loc, rewriter.getIntegerType(type.getIntOrFloatBitWidth()), v);
+  if (type.getIntOrFloatBitWidth() < 64)
+    v = rewriter.create<arith::ExtUIOp>(loc, i64Type, v);
+  return v;
+}
+
+/// Returns the hash of the i64 'bits' at position 'index'.
+static Value insertPositionHash(Location loc, PatternRewriter &rewriter,
+                                Value bits, Value index) {
+  Value position = rewriter.create<arith::MulIOp>(
+      loc, index, insertI64Constant(loc, rewriter, 0x9e3779b97f4a7c15ULL));
+  return insertMix(loc, rewriter,
+                   rewriter.create<arith::AddIOp>(
+                       loc, bits, insertMix(loc, rewriter, position)));
+}
+
+/// Returns an i64 digest of the statically shaped memory 'memref'. Each
+/// element is hashed along with its linear index, and the hashes of all
+/// elements are summed; chunks of the memory thus hash independently of each
+/// other, which lets the loops be vectorized. Equal memories have equal
+/// digests, and a mismatch of the digests implies a mismatch of the bits of
+/// some element.
+static Value insertDigest(Location loc, PatternRewriter &rewriter,
+                          Value memref) {
+  auto memrefType = memref.getType().cast<MemRefType>();
+  auto zero =
+      rewriter.create<arith::ConstantOp>(loc, rewriter.getIndexAttr(0));
+  auto one = rewriter.create<arith::ConstantOp>(loc, rewriter.getIndexAttr(1));
+  Value digest = insertI64Constant(loc, rewriter, 0);
+  Value linear = zero;
+  llvm::SmallVector<Value> indices;
+  llvm::SmallVector<scf::ForOp> loops;
+  for (auto dim : memrefType.getShape()) {
+    auto ub =
+        rewriter.create<arith::ConstantOp>(loc, rewriter.getIndexAttr(dim));
+    auto loop = rewriter.create<scf::ForOp>(loc, zero, ub, one, digest);
+    rewriter.setInsertionPointToStart(loop.getBody());
+    linear = rewriter.create<arith::AddIOp>(
+        loc, rewriter.create<arith::MulIOp>(loc, linear, ub.getResult()),
+        loop.getInductionVar());
+    indices.push_back(loop.getInductionVar());
+    digest = loop.getRegionIterArgs()[0];
+    loops.push_back(loop);
+  }
+
+  Value bits = insertBits(
+      loc, rewriter, rewriter.create<memref::LoadOp>(loc, memref, indices));
+  Value index = rewriter.create<arith::IndexCastOp>(
+      loc, rewriter.getI64Type(), linear);
+  digest = rewriter.create<arith::AddIOp>(
+      loc, digest, insertPositionHash(loc, rewriter, bits, index));
+
+  // Yield the digest through the loop nest.
+  for (auto loop : llvm::reverse(loops)) {
+    rewriter.setInsertionPointToEnd(loop.getBody());
+    rewriter.create<scf::YieldOp>(loc, digest);
+    digest = loop.getResult(0);
+    rewriter.setInsertionPointAfter(loop);
+  }
+  return digest;
+}
+
+/// Returns an i8 pointer to the aligned data of 'memref'.
+static Value insertAlignedPtr(Location loc, PatternRewriter &rewriter,
+                              Value memref) {
+  Value ptr =
+      rewriter.create<memref::ExtractAlignedPointerAsIndexOp>(loc, memref);
+  ptr = rewriter.create<arith::IndexCastOp>(loc, rewriter.getI64Type(), ptr);
+  return rewriter.create<LLVM::IntToPtrOp>(
+      loc, LLVM::LLVMPointerType::get(rewriter.getI8Type()), ptr);
+}
+
+/// Returns the function 'name' of the HLT runtime (see RefCache.h,
+/// CosimRuntime.h, CosimSnapshot.h, CosimProfile.h and SimSample.h), declaring
+/// it in the module if necessary.
+static LLVM::LLVMFuncOp getOrInsertRefCacheFunc(PatternRewriter &rewriter,
+                                                ModuleOp module,
+                                                StringRef name, Type result,
+                                                ArrayRef<Type> params) {
+  if (auto funcOp = module.lookupSymbol<LLVM::LLVMFuncOp>(name))
+    return funcOp;
+  PatternRewriter::InsertionGuard insertGuard(rewriter);
+  rewriter.setInsertionPointToStart(module.getBody());
+  return rewriter.create<LLVM::LLVMFuncOp>(
+      module.getLoc(), name, LLVM::LLVMFunctionType::get(result, params));
+}
+
+/// Returns the number of bytes of a memref which can be snapshotted (see
+/// CosimSnapshot.h), or 0 if it can't: the memref must be a non-empty,
+/// statically shaped and contiguous memory of elements which are laid out in
+/// as many bytes by the LLVM lowering.
+static int64_t getSnapshotBytes(MemRefType memrefType) {
+  auto elemBytes = getContiguousElementBytes(memrefType);
+  if (!elemBytes || *elemBytes > 8 || !llvm::isPowerOf2_64(*elemBytes))
+    return 0;
+  return *elemBytes * memrefType.getNumElements();
+}
+
+/// Returns a snapshot of the contents of the memref 'v', from which the
+/// copy-on-write views of each target are created.
+static Value emitSnapshot(Value v, PatternRewriter &rewriter) {
+  Location loc = v.getLoc();
+  Type i8PtrType = LLVM::LLVMPointerType::get(rewriter.getI8Type());
+  auto funcOp = getOrInsertRefCacheFunc(
+      rewriter, v.getParentRegion()->getParentOfType<ModuleOp>(),
+      "hlt_cosim_snapshot", i8PtrType, {i8PtrType, rewriter.getI64Type()});
+  int64_t bytes = getSnapshotBytes(v.getType().cast<MemRefType>());
+  return rewriter
+      .create<LLVM::CallOp>(loc, funcOp,
+                            ValueRange{insertAlignedPtr(loc, rewriter, v),
+                                       insertI64Constant(loc, rewriter, bytes)})
+      ->getResult(0);
+}
+
+/// Returns a private, copy-on-write view of 'snapshot' as a memref of
+/// 'memrefType', along with the pointer to the mapping of the view.
+static std::pair<Value, Value> emitSnapshotView(Location loc, ModuleOp module,
+                                                Value snapshot,
+                                                MemRefType memrefType,
+                                                PatternRewriter &rewriter) {
+  Type i8PtrType = LLVM::LLVMPointerType::get(rewriter.getI8Type());
+  auto funcOp = getOrInsertRefCacheFunc(
+      rewriter, module, "hlt_cosim_snapshot_view", i8PtrType, {i8PtrType});
+  Value view =
+      rewriter.create<LLVM::CallOp>(loc, funcOp, snapshot)->getResult(0);
+
+  // The mapping is wrapped in a memref descriptor, which the LLVM lowering of
+  // the testbench reconciles with the memref.
+  LLVMTypeConverter converter(rewriter.getContext());
+  Value data = rewriter.create<LLVM::BitcastOp>(
+      loc,
+      LLVM::LLVMPointerType::get(
+          converter.convertType(memrefType.getElementType())),
+      view);
+  Value desc = MemRefDescriptor::fromStaticShape(rewriter, loc, converter,
+                                                 memrefType, data);
+  Value memref =
+      rewriter.create<UnrealizedConversionCastOp>(loc, memrefType, desc)
+          .getResult(0);
+  return {memref, view};
+}
+
+/// Returns true if the outputs of the reference of 'op' can be memoized: all
+/// operands and results must be integers, indices or floats of at most 64
+/// bits, or contiguous memories of such elements.
+static bool canMemoize(cosim::CallOp op) {
+  auto isScalar = [](Type type) {
+    return type.isIntOrIndexOrFloat() && getElementBits(type) <= 64;
+  };
+  for (Type type : op.getOperandTypes()) {
+    auto memrefType = type.dyn_cast<MemRefType>();
+    if (memrefType ? !getContiguousElementBytes(memrefType) ||
+                         !isScalar(memrefType.getElementType())
+                   : !isScalar(type))
+      return false;
+  }
+  return llvm::all_of(op.getResultTypes(), isScalar);
+}
+
+/// Emits the call of the reference of 'op' through the reference cache. The
+/// key of the call hashes the name of the reference and each of its inputs,
+/// with the digest standing in for the contents of memories. On a hit, the
+/// results and the memories written by the reference are loaded from the
+/// cache; on a miss, the reference is called into 'refCall', and its outputs
+/// are stored to the cache. Returns the results of the call.
+static ValueRange emitMemoizedRefCall(cosim::CallOp op,
+                                      mlir::func::FuncOp refFunc,
+                                      mlir::func::CallOp &refCall,
+                                      PatternRewriter &rewriter) {
+  auto module = op->getParentOfType<ModuleOp>();
+  Location loc = op.getLoc();
+  auto *ctx = rewriter.getContext();
+  auto i64Type = rewriter.getI64Type();
+  auto i8PtrType = LLVM::LLVMPointerType::get(rewriter.getI8Type());
+  auto voidType = LLVM::LLVMVoidType::get(ctx);
+
+  // The key must be stable across compilations, so the name is hashed through
+  // xxHash rather than llvm::hash_value.
+  Value key = insertI64Constant(loc, rewriter, llvm::xxHash64(op.getRef()));
+  for (auto it : llvm::enumerate(op.getOperands())) {
+    Value operand = it.value();
+    Value bits = operand.getType().isa<MemRefType>()
+                     ? insertDigest(loc, rewriter, operand)
+                     : insertBits(loc, rewriter, operand);
+    key = rewriter.create<arith::AddIOp>(
+        loc, key,
+        insertPositionHash(loc, rewriter, bits,
+                           insertI64Constant(loc, rewriter, it.index())));
+  }
+
+  // The memories which the reference may write are part of its outputs.
+  llvm::SmallVector<Value> outputs;
+  for (auto it : llvm::enumerate(op.getOperands())) {
+    llvm::DenseSet<Value> visited;
+    if (it.value().getType().isa<MemRefType>() &&
+        !isReadOnlyArg(refFunc, it.index(), visited))
+      outputs.push_back(it.value());
+  }
+
+  // Transfers the contents of 'memref' from or to the entry of the call.
+  auto transfer = [&](StringRef name, Value memref) {
+    auto memrefType = memref.getType().cast<MemRefType>();
+    int64_t bytes =
+        *getContiguousElementBytes(memrefType) * memrefType.getNumElements();
+    auto funcOp = getOrInsertRefCacheFunc(rewriter, module, name, voidType,
+                                          {i8PtrType, i64Type});
+    rewriter.create<LLVM::CallOp>(
+        loc, funcOp,
+        ValueRange{insertAlignedPtr(loc, rewriter, memref),
+                   insertI64Constant(loc, rewriter, bytes)});
+  };
+
+  auto lookup = getOrInsertRefCacheFunc(rewriter, module,
+                                        "hlt_ref_cache_lookup",
+                                        rewriter.getI32Type(), {i64Type});
+  Value found = rewriter.create<arith::CmpIOp>(
+      loc, arith::CmpIPredicate::ne,
+      rewriter.create<LLVM::CallOp>(loc, lookup, key)->getResult(0),
+      rewriter.create<arith::ConstantOp>(loc, rewriter.getI32IntegerAttr(0)));
+  auto cacheIf = rewriter.create<scf::IfOp>(loc, op.getResultTypes(), found,
+                                            /*withElseRegion=*/true);
+
+  // An entry holds the results of the call, followed by the contents of the
+  // written memories. Results are transferred through stack slots.
+  rewriter.setInsertionPointToStart(cacheIf.thenBlock());
+  llvm::SmallVector<Value> cached;
+  for (Type type : op.getResultTypes()) {
+    Value slot =
+        rewriter.create<memref::AllocaOp>(loc, MemRefType::get({}, type));
+    transfer("hlt_ref_cache_load", slot);
+    cached.push_back(rewriter.create<memref::LoadOp>(loc, slot));
+  }
+  for (Value output : outputs)
+    transfer("hlt_ref_cache_load", output);
+  if (!cached.empty())
+    rewriter.create<scf::YieldOp>(loc, cached);
+
+  rewriter.setInsertionPointToStart(cacheIf.elseBlock());
+  refCall = rewriter.create<mlir::func::CallOp>(loc, refFunc, op.getOperands());
+  rewriter.create<LLVM::CallOp>(
+      loc,
+      getOrInsertRefCacheFunc(rewriter, module, "hlt_ref_cache_store_begin",
+                              voidType, {i64Type}),
+      key);
+  for (Value result : refCall.getResults()) {
+    Value slot = rewriter.create<memref::AllocaOp>(
+        loc, MemRefType::get({}, result.getType()));
+    rewriter.create<memref::StoreOp>(loc, result, slot);
+    transfer("hlt_ref_cache_store", slot);
+  }
+  for (Value output : outputs)
+    transfer("hlt_ref_cache_store", output);
+  rewriter.create<LLVM::CallOp>(
+      loc,
+      getOrInsertRefCacheFunc(rewriter, module, "hlt_ref_cache_store_end",
+                              voidType, {}),
+      ValueRange());
+  if (refCall.getNumResults() != 0)
+    rewriter.create<scf::YieldOp>(loc, refCall.getResults());
+
+  rewriter.setInsertionPointAfter(cacheIf);
+  return cacheIf.getResults();
+}
+
+/// Emits the condition under which the call 'op' is verified, when only one in
+/// 'sample' calls is. Calls are counted in a global for each call site; with a
+/// nonzero 'seed', the global instead holds the state of a linear congruential
+/// generator, such that a pseudo-random, but reproducible, subset of calls is
+/// verified.
+static Value emitSampleCondition(cosim::CallOp op, unsigned sample,
+                                 unsigned seed, PatternRewriter &rewriter) {
+  auto module = op->getParentOfType<ModuleOp>();
+  Location loc = op.getLoc();
+  auto i64Type = rewriter.getI64Type();
+  auto stateType = MemRefType::get({}, i64Type);
+
+  // Function passes run in parallel, so the name of the global is unique
+  // through the name of the calling function.
+  auto funcName = op->getParentOfType<mlir::func::FuncOp>().getName();
+  std::string name;
+  for (unsigned idx = 0; name.empty() || module.lookupSymbol(name); ++idx)
+    name = llvm::formatv("__cosim_sample_{0}_{1}", funcName, idx).str();
+  {
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    rewriter.setInsertionPointToStart(module.getBody());
+    Attribute init = rewriter.getI64IntegerAttr(seed);
+    rewriter.create<memref::GlobalOp>(
+        loc, name, rewriter.getStringAttr("private"), stateType,
+        DenseElementsAttr::get(RankedTensorType::get({}, i64Type), init),
+        /*constant=*/false, /*alignment=*/IntegerAttr());
+  }
+
+  auto constant = [&](int64_t value) -> Value {
+    return rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getI64IntegerAttr(value));
+  };
+  Value global = rewriter.create<memref::GetGlobalOp>(loc, stateType, name);
+  Value state = rewriter.create<memref::LoadOp>(loc, global);
+  Value next, sampled;
+  if (seed == 0) {
+    next = rewriter.create<arith::AddIOp>(loc, state, constant(1));
+    sampled = state;
+  } else {
+    // The multiplier and increment of Knuth's MMIX generator. The low bits of
+    // the state have short periods, so the sample is drawn from its high bits.
+    next = rewriter.create<arith::AddIOp>(
+        loc,
+        rewriter.create<arith::MulIOp>(loc, state,
+                                       constant(6364136223846793005)),
+        constant(1442695040888963407));
+    sampled = rewriter.create<arith::ShRUIOp>(loc, next, constant(33));
+  }
+  rewriter.create<memref::StoreOp>(loc, next, global);
+  Value rem = rewriter.create<arith::RemUIOp>(loc, sampled, constant(sample));
+  return rewriter.create<arith::CmpIOp>(loc, arith::CmpIPredicate::eq, rem,
+                                        constant(0));
+}
+
+/// Emits the condition under which the call 'op' only runs the reference,
+/// i.e. once the HLT runtime reports that the simulation has reached its
+/// steady state (see SimSample.h).
+static Value emitSteadyStateCondition(cosim::CallOp op,
+                                      PatternRewriter &rewriter) {
+  auto module = op->getParentOfType<ModuleOp>();
+  Location loc = op.getLoc();
+  auto funcOp = getOrInsertRefCacheFunc(rewriter, module, "hlt_sample_skip",
+                                        rewriter.getI32Type(), {});
+  Value skip =
+      rewriter.create<LLVM::CallOp>(loc, funcOp, ValueRange())->getResult(0);
+  Value zero =
+      rewriter.create<arith::ConstantOp>(loc, rewriter.getI32IntegerAttr(0));
+  return rewriter.create<arith::CmpIOp>(loc, arith::CmpIPredicate::ne, skip,
+                                        zero);
+}
+
+static Value getOrCreateFormatString(Location loc, OpBuilder &builder,
+                                     StringRef name, StringRef fmt,
+                                     ModuleOp module);
+
+/// Returns the label of the call site of 'op' in the cosim profile: the
+/// called function, its caller, and the source line of the call, if known.
+static std::string getProfileSite(cosim::CallOp op) {
+  std::string site;
+  llvm::raw_string_ostream os(site);
+  os << "@" << op.getFunc() << " in @"
+     << op->getParentOfType<mlir::func::FuncOp>().getName();
+  if (auto loc = op.getLoc().dyn_cast<FileLineColLoc>())
+    os << " (" << loc.getFilename().getValue() << ":" << loc.getLine() << ")";
+  return os.str();
+}
+
+/// Returns the host time at which a profiled call starts (see
+/// CosimProfile.h).
+static Value emitProfileNow(Location loc, ModuleOp module,
+                            PatternRewriter &rewriter) {
+  auto funcOp = getOrInsertRefCacheFunc(
+      rewriter, module, "hlt_cosim_profile_now", rewriter.getI64Type(), {});
+  return rewriter.create<LLVM::CallOp>(loc, funcOp, ValueRange())
+      ->getResult(0);
+}
+
+/// Records the call of 'name' at the call site of 'op', which started at
+/// 'begin', in the cosim profile. Returns the recording operation.
+static Operation *emitProfileRecord(cosim::CallOp op, StringRef name,
+                                    Value begin, bool isRef,
+                                    PatternRewriter &rewriter) {
+  auto module = op->getParentOfType<ModuleOp>();
+  Location loc = op.getLoc();
+  Type i8PtrType = LLVM::LLVMPointerType::get(rewriter.getI8Type());
+  auto funcOp = getOrInsertRefCacheFunc(
+      rewriter, module, "hlt_cosim_profile_record",
+      LLVM::LLVMVoidType::get(rewriter.getContext()),
+      {i8PtrType, i8PtrType, rewriter.getI64Type(), rewriter.getI32Type()});
+  // Null terminate the strings, which the runtime holds on to.
+  std::string site = getProfileSite(op);
+  site.push_back('\0');
+  std::string str = name.str();
+  str.push_back('\0');
+  Value isRefValue = rewriter.create<arith::ConstantOp>(
+      loc, rewriter.getI32IntegerAttr(isRef ? 1 : 0));
+  return rewriter.create<LLVM::CallOp>(
+      loc, funcOp,
+      ValueRange{
+          getOrCreateFormatString(loc, rewriter, "cosimProfileSite", site,
+                                  module),
+          getOrCreateFormatString(loc, rewriter, "cosimProfileName", str,
+                                  module),
+          begin, isRefValue});
+}
+
 namespace {
 
 struct ConvertCallPattern : OpRewritePattern<cosim::CallOp> {
-  using OpRewritePattern::OpRewritePattern;
+  ConvertCallPattern(MLIRContext *ctx, bool asyncTargets, unsigned sample,
+                     unsigned sampleSeed, bool steadyState, bool memoizeRef,
+                     bool cowSnapshots, bool profile)
+      : OpRewritePattern(ctx), asyncTargets(asyncTargets), sample(sample),
+        sampleSeed(sampleSeed), steadyState(steadyState),
+        memoizeRef(memoizeRef), cowSnapshots(cowSnapshots), profile(profile) {}
 
   LogicalResult matchAndRewrite(cosim::CallOp op,
                                 PatternRewriter &rewriter) const override {
@@ -132,61 +670,286 @@ struct ConvertCallPattern : OpRewritePattern<cosim::CallOp> {
     assert(refFunc && "expected all functions to be declared in the module");
     targetFunctions[refName] = refFunc;
 
+    // Determine which mutable inputs are only read by the reference and all of
+    // the targets. These can be passed to all functions without copying, and
+    // need not be compared. An operand which is passed through several
+    // arguments is copied once for each target if any of the arguments may be
+    // written, and the copy is passed through all of them, such that the
+    // targets observe the aliasing of the call.
+    llvm::SmallVector<bool> needsCopy;
+    llvm::DenseSet<Value> copiedOperands;
+    for (unsigned idx = 0; idx < op.getNumOperands(); ++idx) {
+      Value operand = op.getOperand(idx);
+      if (isMutable(operand.getType()) &&
+          llvm::any_of(targetFunctions, [&](auto &it) {
+            llvm::DenseSet<Value> visited;
+            return !isReadOnlyArg(it.second, idx, visited);
+          }))
+        copiedOperands.insert(operand);
+    }
+    for (Value operand : op.getOperands())
+      needsCopy.push_back(copiedOperands.contains(operand));
+
+    // The first argument through which each operand is passed. Aliased
+    // operands are copied, snapshotted and compared through their first
+    // argument only.
+    llvm::SmallVector<unsigned> firstUse;
+    for (Value operand : op.getOperands())
+      firstUse.push_back(llvm::find(op.getOperands(), operand) -
+                         op.getOperands().begin());
+
+    // Once the simulation has reached its steady state, calls only run the
+    // reference, on the inputs of the call itself. Calls before it are lowered
+    // as usual within the other branch, where the inputs are copied on entry.
+    scf::IfOp steadyIf;
+    if (steadyState) {
+      Value skip = emitSteadyStateCondition(op, rewriter);
+      steadyIf = rewriter.create<scf::IfOp>(op.getLoc(), op.getResultTypes(),
+                                            skip, /*withElseRegion=*/true);
+      rewriter.setInsertionPointToStart(steadyIf.thenBlock());
+      ValueRange results;
+      mlir::func::CallOp memoizedCall;
+      if (memoizeRef && canMemoize(op))
+        results = emitMemoizedRefCall(op, refFunc, memoizedCall, rewriter);
+      else
+        results = rewriter
+                      .create<mlir::func::CallOp>(op.getLoc(), refFunc,
+                                                  op.getOperands())
+                      .getResults();
+      if (!results.empty())
+        rewriter.create<scf::YieldOp>(op.getLoc(), results);
+      rewriter.setInsertionPointToStart(steadyIf.elseBlock());
+    }
+
+    // When sampling, calls which are not verified only run the first target,
+    // on the inputs of the call itself. Verified calls are lowered as usual
+    // within the other branch, where the inputs are copied on entry.
+    scf::IfOp sampleIf;
+    bool inBranch = static_cast<bool>(steadyIf);
+    if (sample > 1) {
+      Value verify = emitSampleCondition(op, sample, sampleSeed, rewriter);
+      sampleIf = rewriter.create<scf::IfOp>(op.getLoc(), op.getResultTypes(),
+                                            verify, /*withElseRegion=*/true);
+      rewriter.setInsertionPointToStart(sampleIf.elseBlock());
+      auto firstTarget = op.getTargets()[0].cast<StringAttr>().str();
+      ValueRange results;
+      if (asyncTargets) {
+        rewriter.create<mlir::func::CallOp>(
+            op.getLoc(),
+            module.lookupSymbol<mlir::func::FuncOp>(firstTarget + "_call"),
+            op.getOperands());
+        results = rewriter
+                      .create<mlir::func::CallOp>(
+                          op.getLoc(),
+                          module.lookupSymbol<mlir::func::FuncOp>(
+                              firstTarget + "_await"),
+                          ValueRange())
+                      .getResults();
+      } else {
+        results = rewriter
+                      .create<mlir::func::CallOp>(
+                          op.getLoc(), targetFunctions.at(firstTarget),
+                          op.getOperands())
+                      .getResults();
+      }
+      if (!results.empty())
+        rewriter.create<scf::YieldOp>(op.getLoc(), results);
+      rewriter.setInsertionPointToStart(sampleIf.thenBlock());
+      inBranch = true;
+    }
+
     std::map<std::string, SmallVector<Value>> targetOperands;
 
+    // With 'cowSnapshots', mutable inputs which can be snapshotted are copied
+    // once, into a snapshot from which each target receives a copy-on-write
+    // view.
+    llvm::SmallVector<Value> snapshots;
+    for (auto [idx, operand, copy] :
+         llvm::zip(llvm::seq(0u, op.getNumOperands()), op.getOperands(),
+                   needsCopy)) {
+      Value snapshot;
+      if (copy && cowSnapshots && firstUse[idx] == idx &&
+          getSnapshotBytes(operand.getType().cast<MemRefType>()))
+        snapshot = inBranch ? emitSnapshot(operand, rewriter)
+                            : copyAtLastMutationBefore(operand, op, rewriter,
+                                                       emitSnapshot);
+      snapshots.push_back(snapshot);
+    }
+
     // Create copies for any mutable inputs to the target functions
+    llvm::SmallVector<std::pair<Value, int64_t>> views;
     for (auto target : op.getTargets()) {
       auto targetStr = target.cast<StringAttr>().strref().str();
-      for (auto operand : op.getOperands()) {
-        if (isMutable(operand.getType()))
-          targetOperands[targetStr].push_back(
-              copyAtLastMutationBefore(operand, op, rewriter));
+      auto &operands = targetOperands[targetStr];
+      for (auto [idx, operand, copy, snapshot] :
+           llvm::zip(llvm::seq(0u, op.getNumOperands()), op.getOperands(),
+                     needsCopy, snapshots)) {
+        if (copy && firstUse[idx] != idx) {
+          operands.push_back(operands[firstUse[idx]]);
+        } else if (snapshot) {
+          auto memrefType = operand.getType().cast<MemRefType>();
+          auto [memref, view] = emitSnapshotView(op.getLoc(), module, snapshot,
+                                                 memrefType, rewriter);
+          views.push_back({view, getSnapshotBytes(memrefType)});
+          operands.push_back(memref);
+        } else if (copy)
+          operands.push_back(inBranch ? copyMemRef(operand, rewriter)
+                                      : copyAtLastMutationBefore(operand, op,
+                                                                 rewriter));
         else
-          targetOperands[targetStr].push_back(operand);
+          operands.push_back(operand);
       }
     }
 
+    // The views outlive their snapshots, which are released once all views
+    // have been created.
+    Type voidType = LLVM::LLVMVoidType::get(rewriter.getContext());
+    Type i8PtrType = LLVM::LLVMPointerType::get(rewriter.getI8Type());
+    for (Value snapshot : snapshots)
+      if (snapshot)
+        rewriter.create<LLVM::CallOp>(
+            op.getLoc(),
+            getOrInsertRefCacheFunc(rewriter, module,
+                                    "hlt_cosim_snapshot_release", voidType,
+                                    {i8PtrType}),
+            snapshot);
+
     std::map<std::string, mlir::func::CallOp> targetCalls;
     auto emitCall = [&](StringRef callee, ValueRange operands) {
       targetCalls[callee.str()] = rewriter.create<mlir::func::CallOp>(
           op.getLoc(), targetFunctions.at(callee.str()), operands);
     };
 
-    // Call the reference
-    emitCall(op.getRef(), op.getOperands());
-
-    // Create calls to the targets
-    for (auto target : targetOperands)
-      emitCall(target.first, target.second);
+    // When profiled, the reference and each target are timed on the host,
+    // and the comparisons of each target are emitted after its record, such
+    // that they aren't timed along with it. Async targets are timed from when
+    // they are all started, until each is awaited.
+    bool profileCall = profile || op.getProfile();
+    std::map<std::string, Operation *> compareAfter;
+    Value targetsBegin;
+    if (profileCall && asyncTargets)
+      targetsBegin = emitProfileNow(op.getLoc(), module, rewriter);
+
+    // With async targets, the targets are started through their _call
+    // functions before the reference is called, such that the reference
+    // executes while the targets are simulated.
+    if (asyncTargets)
+      for (auto target : targetOperands)
+        rewriter.create<mlir::func::CallOp>(
+            op.getLoc(),
+            module.lookupSymbol<mlir::func::FuncOp>(target.first + "_call"),
+            target.second);
+
+    // Call the reference. When memoized, the outputs of the reference are
+    // looked up in the reference cache first.
+    mlir::func::CallOp refCall;
+    ValueRange refResults;
+    Value refBegin;
+    if (profileCall)
+      refBegin = emitProfileNow(op.getLoc(), module, rewriter);
+    if (memoizeRef && canMemoize(op)) {
+      refResults = emitMemoizedRefCall(op, refFunc, refCall, rewriter);
+    } else {
+      emitCall(op.getRef(), op.getOperands());
+      refCall = targetCalls[op.getRef().str()];
+      refResults = refCall.getResults();
+    }
+    if (profileCall)
+      emitProfileRecord(op, op.getRef(), refBegin, /*isRef=*/true, rewriter);
+
+    // Create calls to the targets, or await the async targets.
+    std::map<std::string, mlir::func::CallOp> targetAwaits;
+    for (auto target : targetOperands) {
+      Value begin = targetsBegin;
+      if (profileCall && !asyncTargets)
+        begin = emitProfileNow(op.getLoc(), module, rewriter);
+      if (!asyncTargets) {
+        emitCall(target.first, target.second);
+        compareAfter[target.first] = targetCalls.at(target.first);
+      } else {
+        targetAwaits[target.first] = rewriter.create<mlir::func::CallOp>(
+            op.getLoc(),
+            module.lookupSymbol<mlir::func::FuncOp>(target.first + "_await"),
+            ValueRange());
+        compareAfter[target.first] = targetAwaits.at(target.first);
+      }
+      if (profileCall)
+        compareAfter[target.first] = emitProfileRecord(
+            op, target.first, begin, /*isRef=*/false, rewriter);
+    }
 
     // Emit cosim comparison between the reference function and the target
-    // functions.
-    mlir::func::CallOp refCall = targetCalls[op.getRef().str()];
-    for (auto &call : targetCalls) {
-      // Ignore the reference call; all other target calls will compare against
-      // this call.
-      if (call.second == refCall)
-        continue;
+    // functions. Each target is compared once its results are available.
+    for (auto &target : targetOperands) {
+      mlir::func::CallOp resultCall = asyncTargets
+                                          ? targetAwaits.at(target.first)
+                                          : targetCalls.at(target.first);
+      Operation *after = compareAfter.at(target.first);
 
       // Emit comparison operations on mutable inputs
-      for (auto [refOperand, targetOperand] :
-           llvm::zip(refCall.getOperands(), call.second.getOperands())) {
-        if (isMutable(refOperand.getType()))
-          compareToRefAfterOp(refOperand, targetOperand, call.second, rewriter,
-                              refCall, call.second);
+      for (auto [idx, refOperand, targetOperand, copy] :
+           llvm::zip(llvm::seq(0u, op.getNumOperands()), refCall.getOperands(),
+                     target.second, needsCopy)) {
+        if (copy && firstUse[idx] == idx)
+          compareToRefAfterOp(refOperand, targetOperand, after, rewriter,
+                              refCall, resultCall);
       }
 
       // Emit comparison operations on results
       for (auto [refRes, targetRes] :
-           llvm::zip(refCall.getResults(), call.second.getResults()))
-        compareToRefAfterOp(refRes, targetRes, call.second, rewriter);
+           llvm::zip(refResults, resultCall.getResults()))
+        compareToRefAfterOp(refRes, targetRes, after, rewriter);
     }
 
+    // Unmap the views of the snapshots once all comparisons are done.
+    for (auto [view, bytes] : views)
+      rewriter.create<LLVM::CallOp>(
+          op.getLoc(),
+          getOrInsertRefCacheFunc(rewriter, module, "hlt_cosim_snapshot_unmap",
+                                  voidType,
+                                  {i8PtrType, rewriter.getI64Type()}),
+          ValueRange{view, insertI64Constant(op.getLoc(), rewriter, bytes)});
+
     // Erase the cosim.call operation
-    rewriter.replaceOp(op, refCall.getResults());
+    ValueRange results = refResults;
+    if (sampleIf) {
+      if (!results.empty()) {
+        rewriter.setInsertionPointToEnd(sampleIf.thenBlock());
+        rewriter.create<scf::YieldOp>(op.getLoc(), results);
+      }
+      results = sampleIf.getResults();
+    }
+    if (steadyIf) {
+      if (!results.empty()) {
+        rewriter.setInsertionPointToEnd(steadyIf.elseBlock());
+        rewriter.create<scf::YieldOp>(op.getLoc(), results);
+      }
+      results = steadyIf.getResults();
+    }
+    rewriter.replaceOp(op, results);
 
     return success();
   }
+
+  // If set, targets are called through their asynchronous _call/_await
+  // interface.
+  bool asyncTargets;
+  // If larger than 1, only one in 'sample' calls is verified, selected through
+  // 'sampleSeed' (see emitSampleCondition).
+  unsigned sample;
+  unsigned sampleSeed;
+  // If set, calls only run the reference once the simulation has reached its
+  // steady state (see emitSteadyStateCondition).
+  bool steadyState;
+  // If set, the outputs of the reference are memoized in the reference cache
+  // (see emitMemoizedRefCall).
+  bool memoizeRef;
+  // If set, the targets receive copy-on-write views of a single snapshot of
+  // each mutable input, rather than copies (see CosimSnapshot.h).
+  bool cowSnapshots;
+  // If set, all calls are profiled, rather than only those with the
+  // 'profile' attribute (see CosimProfile.h).
+  bool profile;
 };
 
 struct CosimLowerCallPass : public CosimLowerCallBase<CosimLowerCallPass> {
@@ -197,7 +960,9 @@ struct CosimLowerCallPass : public CosimLowerCallBase<CosimLowerCallPass> {
 
     auto *ctx = &getContext();
     RewritePatternSet patterns(ctx);
-    patterns.insert<ConvertCallPattern>(ctx);
+    patterns.insert<ConvertCallPattern>(ctx, asyncTargets, sample, sampleSeed,
+                                        steadyState, memoizeRef, cowSnapshots,
+                                        profile);
     ConversionTarget target(*ctx);
     target.addIllegalOp<cosim::CallOp>();
     target.addLegalDialect<memref::MemRefDialect>();
@@ -206,6 +971,8 @@ struct CosimLowerCallPass : public CosimLowerCallBase<CosimLowerCallPass> {
     target.addLegalDialect<arith::ArithDialect>();
     target.addLegalDialect<cosim::CosimDialect>();
     target.addLegalDialect<func::FuncDialect>();
+    target.addLegalDialect<scf::SCFDialect>();
+    target.addLegalDialect<LLVM::LLVMDialect>();
 
     if (failed(applyPartialConversion(getOperation(), target,
                                       std::move(patterns))))
@@ -220,21 +987,31 @@ struct CosimLowerCallPass : public CosimLowerCallBase<CosimLowerCallPass> {
     ImplicitLocOpBuilder builder(module.getLoc(), op.getContext());
     builder.setInsertionPointAfter(funcOp);
 
-    auto createFunc = [&](StringRef name) {
+    auto createFunc = [&](StringRef name, FunctionType type) {
       mlir::func::FuncOp targetFunc =
           module.lookupSymbol<mlir::func::FuncOp>(name);
       if (!targetFunc) {
         // Function doesn't exist in module; create private definition.
         builder.setInsertionPoint(funcOp);
         targetFunc =
-            builder.create<mlir::func::FuncOp>(op.getLoc(), name, opFuncType);
+            builder.create<mlir::func::FuncOp>(op.getLoc(), name, type);
         targetFunc.setPrivate();
       }
     };
 
-    for (auto target : op.getTargets())
-      createFunc(target.cast<StringAttr>().str());
-    createFunc(op.getRef());
+    for (auto target : op.getTargets()) {
+      auto targetName = target.cast<StringAttr>().str();
+      createFunc(targetName, opFuncType);
+      if (asyncTargets) {
+        createFunc(targetName + "_call",
+                   FunctionType::get(op.getContext(), op.getOperandTypes(),
+                                     TypeRange()));
+        createFunc(targetName + "_await",
+                   FunctionType::get(op.getContext(), TypeRange(),
+                                     op.getResultTypes()));
+      }
+    }
+    createFunc(op.getRef(), opFuncType);
   }
 };
 
@@ -262,6 +1039,29 @@ static FlatSymbolRefAttr getOrInsertPrintf(PatternRewriter &rewriter,
   return SymbolRefAttr::get(context, "printf");
 }
 
+/// Return a symbol reference to the memcmp function, inserting it into the
+/// module if necessary.
+static FlatSymbolRefAttr getOrInsertMemcmp(PatternRewriter &rewriter,
+                                           ModuleOp module) {
+  auto *context = module.getContext();
+  if (module.lookupSymbol<LLVM::LLVMFuncOp>("memcmp"))
+    return SymbolRefAttr::get(context, "memcmp");
+
+  // Create a function declaration for memcmp, the signature is:
+  //   * `i32 (i8*, i8*, i64)`
+  auto llvmI32Ty = IntegerType::get(context, 32);
+  auto llvmI64Ty = IntegerType::get(context, 64);
+  auto llvmI8PtrTy = LLVM::LLVMPointerType::get(IntegerType::get(context, 8));
+  auto llvmFnType = LLVM::LLVMFunctionType::get(
+      llvmI32Ty, {llvmI8PtrTy, llvmI8PtrTy, llvmI64Ty});
+
+  // Insert the memcmp function into the body of the parent module.
+  PatternRewriter::InsertionGuard insertGuard(rewriter);
+  rewriter.setInsertionPointToStart(module.getBody());
+  rewriter.create<LLVM::LLVMFuncOp>(module.getLoc(), "memcmp", llvmFnType);
+  return SymbolRefAttr::get(context, "memcmp");
+}
+
 static void insertPrintfCall(Location loc, ModuleOp module,
                              PatternRewriter &rewriter, ValueRange operands) {
   auto printf = getOrInsertPrintf(rewriter, module);
@@ -301,22 +1101,199 @@ static Value getOrCreateGlobalString(Location loc, OpBuilder &builder,
       globalPtr, ArrayRef<Value>({cst0, cst0}));
 }
 
+/// Returns the suffix of cosim messages which names the sources of the
+/// compared values, if they are known.
+static std::string getCosimSites(cosim::CompareOp op) {
+  auto refSrc = op.getRefSrcAttr();
+  auto targetSrc = op.getTargetSrcAttr();
+  if (!refSrc && !targetSrc)
+    return "";
+  return (" (" + (refSrc ? "@" + refSrc.getValue() : "?").str() + " vs. " +
+          (targetSrc ? "@" + targetSrc.getValue() : "?").str() + ")");
+}
+
+/// Returns a format string of a cosim message, which names the sources of the
+/// compared values if they are known.
+static std::string getCosimFormatString(cosim::CompareOp op, StringRef msg) {
+  std::string str = ("COSIM: " + msg).str();
+  str += getCosimSites(op);
+  str += "\n";
+  // Null terminate, for printf.
+  str.push_back('\0');
+  return str;
+}
+
+/// Returns a value pointing to the format string 'fmt', creating it if
+/// necessary. The global is named by 'name' and a hash of the string, such
+/// that equal format strings are shared.
+static Value getOrCreateFormatString(Location loc, OpBuilder &builder,
+                                     StringRef name, StringRef fmt,
+                                     ModuleOp module) {
+  std::string globalName =
+      (name + "_" + llvm::utohexstr(llvm::hash_value(fmt))).str();
+  return getOrCreateGlobalString(loc, builder, globalName, fmt, module);
+}
+
+/// Prints a report of the mismatch between 'a' and 'b', found at 'indices' of
+/// the compared values (if these are memories).
+static void insertMismatchReport(Location loc, ModuleOp module,
+                                 PatternRewriter &rewriter,
+                                 cosim::CompareOp op, Value a, Value b,
+                                 ValueRange indices = {}) {
+  std::string msg;
+  for (size_t i = 0; i < indices.size(); ++i)
+    msg += "[%ld]";
+  msg += indices.empty() ? "" : ": ";
+
+  // Floats are passed to printf as doubles, and printed with enough digits to
+  // tell apart any two values of their type.
+  StringRef name = "cosimIntCmpErrStr";
+  if (auto floatType = a.getType().dyn_cast<FloatType>()) {
+    name = "cosimFloatCmpErrStr";
+    msg += floatType.getWidth() > 32 ? "%.17g != %.17g" : "%.9g != %.9g";
+    if (floatType.getWidth() < 64) {
+      a = rewriter.create<arith::ExtFOp>(loc, rewriter.getF64Type(), a);
+      b = rewriter.create<arith::ExtFOp>(loc, rewriter.getF64Type(), b);
+    }
+  } else
+    msg += "%d != %d";
+
+  llvm::SmallVector<Value> printfArgs;
+  printfArgs.push_back(getOrCreateFormatString(
+      loc, rewriter, name, getCosimFormatString(op, msg), module));
+  for (auto index : indices)
+    printfArgs.push_back(rewriter.create<arith::IndexCastOp>(
+        loc, rewriter.getI64Type(), index));
+  printfArgs.push_back(a);
+  printfArgs.push_back(b);
+  insertPrintfCall(loc, module, rewriter, printfArgs);
+}
+
+/// Tolerances of floating-point comparisons. Two floats match if they are
+/// equal, if they differ by no more than 'absTolerance', or if they are no more
+/// than 'ulpTolerance' representable values apart. NaNs match each other if
+/// 'nanEqual' is set, and never match a number.
+struct FloatTolerance {
+  double absTolerance = 0.0;
+  unsigned ulpTolerance = 0;
+  bool nanEqual = true;
+};
+
+/// Returns the absolute value of 'v'.
+static Value insertAbsF(Location loc, PatternRewriter &rewriter, Value v) {
+  auto zero = rewriter.create<arith::ConstantOp>(
+      loc, rewriter.getFloatAttr(v.getType(), 0.0));
+  auto isNeg =
+      rewriter.create<arith::CmpFOp>(loc, arith::CmpFPredicate::OLT, v, zero);
+  return rewriter.create<arith::SelectOp>(
+      loc, isNeg, rewriter.create<arith::NegFOp>(loc, v), v);
+}
+
+/// Returns an i1 value which is set if the floats 'a' and 'b' do not match
+/// within 'tolerance'.
+static Value insertFloatMismatch(Location loc, PatternRewriter &rewriter,
+                                 Value a, Value b,
+                                 const FloatTolerance &tolerance) {
+  auto floatType = a.getType().cast<FloatType>();
+  Value match =
+      rewriter.create<arith::CmpFOp>(loc, arith::CmpFPredicate::OEQ, a, b);
+  auto orMatch = [&](Value v) {
+    match = rewriter.create<arith::OrIOp>(loc, match, v);
+  };
+
+  if (tolerance.nanEqual) {
+    auto aNaN =
+        rewriter.create<arith::CmpFOp>(loc, arith::CmpFPredicate::UNO, a, a);
+    auto bNaN =
+        rewriter.create<arith::CmpFOp>(loc, arith::CmpFPredicate::UNO, b, b);
+    orMatch(rewriter.create<arith::AndIOp>(loc, aNaN, bNaN));
+  }
+
+  // Comparisons which involve a NaN are unordered, so NaNs never match within
+  // a tolerance.
+  if (tolerance.absTolerance != 0.0) {
+    auto diff = insertAbsF(loc, rewriter,
+                           rewriter.create<arith::SubFOp>(loc, a, b));
+    auto absTolerance = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getFloatAttr(floatType, tolerance.absTolerance));
+    orMatch(rewriter.create<arith::CmpFOp>(loc, arith::CmpFPredicate::OLE,
+                                           diff, absTolerance));
+  }
+
+  // Floats of the same sign are ordered as their bit patterns, so the distance
+  // between these is the number of representable values in between. Floats of
+  // different signs only match if both are zero, which is an exact match.
+  if (tolerance.ulpTolerance != 0) {
+    auto intType = rewriter.getIntegerType(floatType.getWidth());
+    Value aBits = rewriter.create<arith::BitcastOp>(loc, intType, a);
+    Value bBits = rewriter.create<arith::BitcastOp>(loc, intType, b);
+    auto intZero = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getIntegerAttr(intType, 0));
+    auto sameSign = rewriter.create<arith::CmpIOp>(
+        loc, arith::CmpIPredicate::sge,
+        rewriter.create<arith::XOrIOp>(loc, aBits, bBits), intZero);
+    Value ulps = rewriter.create<arith::SubIOp>(loc, aBits, bBits);
+    auto isNeg = rewriter.create<arith::CmpIOp>(
+        loc, arith::CmpIPredicate::slt, ulps, intZero);
+    ulps = rewriter.create<arith::SelectOp>(
+        loc, isNeg, rewriter.create<arith::SubIOp>(loc, intZero, ulps), ulps);
+    auto ulpTolerance = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getIntegerAttr(intType, tolerance.ulpTolerance));
+    auto withinUlps = rewriter.create<arith::CmpIOp>(
+        loc, arith::CmpIPredicate::ule, ulps, ulpTolerance);
+    auto notNaN =
+        rewriter.create<arith::CmpFOp>(loc, arith::CmpFPredicate::ORD, a, b);
+    auto withinTolerance =
+        rewriter.create<arith::AndIOp>(loc, sameSign, withinUlps);
+    orMatch(rewriter.create<arith::AndIOp>(loc, notNaN, withinTolerance));
+  }
+
+  auto one = rewriter.create<arith::ConstantOp>(
+      loc, rewriter.getIntegerAttr(rewriter.getI1Type(), 1));
+  return rewriter.create<arith::XOrIOp>(loc, match, one);
+}
+
+/// Returns an i1 value which is set if 'a' and 'b' do not match.
+static Value insertMismatch(Location loc, PatternRewriter &rewriter, Value a,
+                            Value b, const FloatTolerance &tolerance) {
+  if (a.getType().isa<FloatType>())
+    return insertFloatMismatch(loc, rewriter, a, b, tolerance);
+  return rewriter.create<arith::CmpIOp>(loc, arith::CmpIPredicate::ne, a, b);
+}
+
 static void insertIntegerLikeComparison(Location loc, ModuleOp module,
-                                        PatternRewriter &rewriter, Value a,
+                                        PatternRewriter &rewriter,
+                                        cosim::CompareOp op, Value a,
                                         Value b) {
   auto cmp =
       rewriter.create<arith::CmpIOp>(loc, arith::CmpIPredicate::ne, a, b);
   auto ifOp = rewriter.create<scf::IfOp>(loc, cmp);
   rewriter.setInsertionPointToStart(ifOp.getBody());
-
-  llvm::SmallVector<Value> printfArgs;
-  printfArgs.push_back(getOrCreateGlobalString(
-      loc, rewriter, "cosimIntCmpErrStr", "COSIM: %d != %d", module));
-  printfArgs.push_back(a);
-  printfArgs.push_back(b);
-  insertPrintfCall(loc, module, rewriter, printfArgs);
+  insertMismatchReport(loc, module, rewriter, op, a, b);
 }
 
+struct ConvertCompareFloat : OpRewritePattern<cosim::CompareOp> {
+  ConvertCompareFloat(MLIRContext *ctx, const FloatTolerance &tolerance)
+      : OpRewritePattern(ctx), tolerance(tolerance) {}
+
+  LogicalResult matchAndRewrite(cosim::CompareOp op,
+                                PatternRewriter &rewriter) const override {
+    if (!op.type().isa<FloatType>())
+      return failure();
+
+    auto mismatch = insertFloatMismatch(op.getLoc(), rewriter, op.getRef(),
+                                        op.getTarget(), tolerance);
+    auto ifOp = rewriter.create<scf::IfOp>(op.getLoc(), mismatch);
+    rewriter.setInsertionPointToStart(ifOp.getBody());
+    insertMismatchReport(op.getLoc(), op->getParentOfType<ModuleOp>(),
+                         rewriter, op, op.getRef(), op.getTarget());
+    rewriter.eraseOp(op);
+    return success();
+  }
+
+  FloatTolerance tolerance;
+};
+
 struct ConvertCompareIntegerLike : OpRewritePattern<cosim::CompareOp> {
   using OpRewritePattern::OpRewritePattern;
 
@@ -326,20 +1303,65 @@ struct ConvertCompareIntegerLike : OpRewritePattern<cosim::CompareOp> {
       return failure();
 
     insertIntegerLikeComparison(op.getLoc(), op->getParentOfType<ModuleOp>(),
-                                rewriter, op.getRef(), op.getTarget());
+                                rewriter, op, op.getRef(), op.getTarget());
     rewriter.eraseOp(op);
     return success();
   }
 };
 
 struct ConvertCompareMemref : OpRewritePattern<cosim::CompareOp> {
-  using OpRewritePattern::OpRewritePattern;
+  ConvertCompareMemref(MLIRContext *ctx, unsigned maxReports, bool earlyExit,
+                       const FloatTolerance &tolerance, bool hash,
+                       bool printDigests, bool runtime)
+      : OpRewritePattern(ctx), maxReports(maxReports), earlyExit(earlyExit),
+        tolerance(tolerance), hash(hash), printDigests(printDigests),
+        runtime(runtime) {}
 
   LogicalResult matchAndRewrite(cosim::CompareOp op,
                                 PatternRewriter &rewriter) const override {
     MemRefType memrefType = op.type().dyn_cast<MemRefType>();
     if (!memrefType)
       return failure();
+    auto floatType = memrefType.getElementType().dyn_cast<FloatType>();
+    if (runtime && canCompareAtRuntime(memrefType)) {
+      insertRuntimeCompare(op, rewriter);
+      rewriter.eraseOp(op);
+      return success();
+    }
+
+    // Contiguous memories are first compared as a whole, and are only compared
+    // element-wise to report the mismatching elements. Equal bytes are equal
+    // floats, unless NaNs never match.
+    auto module = op->getParentOfType<ModuleOp>();
+    auto elemBytes = getContiguousElementBytes(memrefType);
+    bool bitwiseMatch = !floatType || tolerance.nanEqual;
+    Type elemType = memrefType.getElementType();
+    if (hash && memrefType.hasStaticShape() && elemType.isIntOrIndexOrFloat() &&
+        getElementBits(elemType) <= 64) {
+      // With hashing, the memories are compared through their digests, which
+      // may also be printed to compare the memories across runs.
+      Value refDigest = insertDigest(op.getLoc(), rewriter, op.getRef());
+      Value targetDigest = insertDigest(op.getLoc(), rewriter, op.getTarget());
+      if (printDigests)
+        insertPrintfCall(
+            op.getLoc(), module, rewriter,
+            {getOrCreateFormatString(
+                 op.getLoc(), rewriter, "cosimMemrefDigestStr",
+                 getCosimFormatString(op, "digests %016lx, %016lx"), module),
+             refDigest, targetDigest});
+      if (bitwiseMatch) {
+        Value mismatch = rewriter.create<arith::CmpIOp>(
+            op.getLoc(), arith::CmpIPredicate::ne, refDigest, targetDigest);
+        auto ifOp = rewriter.create<scf::IfOp>(op.getLoc(), mismatch);
+        rewriter.setInsertionPointToStart(ifOp.getBody());
+      }
+    } else if (elemBytes && bitwiseMatch) {
+      Value mismatch = insertMemcmp(op.getLoc(), module, rewriter, op.getRef(),
+                                    op.getTarget(),
+                                    *elemBytes * memrefType.getNumElements());
+      auto ifOp = rewriter.create<scf::IfOp>(op.getLoc(), mismatch);
+      rewriter.setInsertionPointToStart(ifOp.getBody());
+    }
 
     // Create a loop wherein we load each value in each memory, and compare
     // them.
@@ -348,6 +1370,25 @@ struct ConvertCompareMemref : OpRewritePattern<cosim::CompareOp> {
     auto one = rewriter.create<arith::ConstantOp>(op.getLoc(),
                                                   rewriter.getIndexAttr(1));
 
+    // The number of mismatching elements found so far.
+    Value count = rewriter.create<memref::AllocaOp>(
+        op.getLoc(), MemRefType::get({}, rewriter.getIndexType()));
+    rewriter.create<memref::StoreOp>(op.getLoc(), zero, count);
+
+    // The maximum absolute error of the mismatching float elements found so
+    // far.
+    Value maxError;
+    if (floatType && !earlyExit) {
+      maxError = rewriter.create<memref::AllocaOp>(
+          op.getLoc(), MemRefType::get({}, rewriter.getF64Type()));
+      rewriter.create<memref::StoreOp>(
+          op.getLoc(),
+          rewriter.create<arith::ConstantOp>(op.getLoc(),
+                                             rewriter.getF64FloatAttr(0.0)),
+          maxError);
+    }
+    auto afterLoops = rewriter.saveInsertionPoint();
+
     llvm::SmallVector<Value> indices;
     scf::ForOp innerLoop = nullptr;
     for (auto dim : memrefType.getShape()) {
@@ -358,18 +1399,192 @@ struct ConvertCompareMemref : OpRewritePattern<cosim::CompareOp> {
       rewriter.setInsertionPointToStart(innerLoop.getBody());
     }
 
+    // With early exit, no elements are compared after the first mismatch.
+    if (earlyExit) {
+      Value found = rewriter.create<memref::LoadOp>(op.getLoc(), count);
+      auto none = rewriter.create<arith::CmpIOp>(
+          op.getLoc(), arith::CmpIPredicate::eq, found, zero);
+      auto ifOp = rewriter.create<scf::IfOp>(op.getLoc(), none);
+      rewriter.setInsertionPointToStart(ifOp.getBody());
+    }
+
     // Load values from the two compared memories
     auto loadRef =
         rewriter.create<memref::LoadOp>(op.getLoc(), op.getRef(), indices);
     auto targetRef =
         rewriter.create<memref::LoadOp>(op.getLoc(), op.getTarget(), indices);
 
-    // Insert integer comparison
-    insertIntegerLikeComparison(op.getLoc(), op->getParentOfType<ModuleOp>(),
-                                rewriter, loadRef, targetRef);
+    // Insert element comparison. Each mismatch is counted, but only the first
+    // maxReports mismatches are reported.
+    auto mismatch =
+        insertMismatch(op.getLoc(), rewriter, loadRef, targetRef, tolerance);
+    auto ifMismatch = rewriter.create<scf::IfOp>(op.getLoc(), mismatch);
+    rewriter.setInsertionPointToStart(ifMismatch.getBody());
+    Value found = rewriter.create<memref::LoadOp>(op.getLoc(), count);
+    rewriter.create<memref::StoreOp>(
+        op.getLoc(), rewriter.create<arith::AddIOp>(op.getLoc(), found, one),
+        count);
+    if (maxError)
+      insertMaxErrorUpdate(op.getLoc(), rewriter, loadRef, targetRef, maxError);
+    if (maxReports != 0 && !earlyExit) {
+      auto max = rewriter.create<arith::ConstantOp>(
+          op.getLoc(), rewriter.getIndexAttr(maxReports));
+      auto report = rewriter.create<arith::CmpIOp>(
+          op.getLoc(), arith::CmpIPredicate::ult, found, max);
+      auto ifReport = rewriter.create<scf::IfOp>(op.getLoc(), report);
+      rewriter.setInsertionPointToStart(ifReport.getBody());
+    }
+    insertMismatchReport(op.getLoc(), module, rewriter, op, loadRef, targetRef,
+                         indices);
+
+    // Report the total number of mismatches after comparing all elements.
+    rewriter.restoreInsertionPoint(afterLoops);
+    Value total = rewriter.create<memref::LoadOp>(op.getLoc(), count);
+    auto anyMismatch = rewriter.create<arith::CmpIOp>(
+        op.getLoc(), arith::CmpIPredicate::ne, total, zero);
+    auto ifAny = rewriter.create<scf::IfOp>(op.getLoc(), anyMismatch);
+    rewriter.setInsertionPointToStart(ifAny.getBody());
+    std::string msg = earlyExit ? "mismatch found, stopped comparing"
+                                : "%ld mismatching elements";
+    if (maxError)
+      msg += ", max. abs. error %.17g";
+    llvm::SmallVector<Value> printfArgs;
+    printfArgs.push_back(
+        getOrCreateFormatString(op.getLoc(), rewriter, "cosimMemrefCmpCountStr",
+                                getCosimFormatString(op, msg), module));
+    if (!earlyExit)
+      printfArgs.push_back(rewriter.create<arith::IndexCastOp>(
+          op.getLoc(), rewriter.getI64Type(), total));
+    if (maxError)
+      printfArgs.push_back(
+          rewriter.create<memref::LoadOp>(op.getLoc(), maxError));
+    insertPrintfCall(op.getLoc(), module, rewriter, printfArgs);
+
     rewriter.eraseOp(op);
     return success();
   }
+
+private:
+  // Returns true if memories of 'memrefType' can be compared by the HLT cosim
+  // runtime: they must be contiguous, of elements of 1, 2, 4 or 8 bytes, and
+  // float elements must be f32 or f64.
+  static bool canCompareAtRuntime(MemRefType memrefType) {
+    auto elemBytes = getContiguousElementBytes(memrefType);
+    if (!elemBytes || !llvm::isPowerOf2_64(*elemBytes) || *elemBytes > 8)
+      return false;
+    auto floatType = memrefType.getElementType().dyn_cast<FloatType>();
+    return !floatType || floatType.isF32() || floatType.isF64();
+  }
+
+  // Compares the memories of 'op' through a call of hlt_cosim_compare_memref
+  // (see CosimRuntime.h). The shape of the memories is passed through a stack
+  // slot.
+  void insertRuntimeCompare(cosim::CompareOp op,
+                            PatternRewriter &rewriter) const {
+    Location loc = op.getLoc();
+    auto module = op->getParentOfType<ModuleOp>();
+    auto memrefType = op.type().cast<MemRefType>();
+    Type elemType = memrefType.getElementType();
+    auto i32Type = rewriter.getI32Type();
+    auto i64Type = rewriter.getI64Type();
+    auto f64Type = rewriter.getF64Type();
+    auto i8PtrType = LLVM::LLVMPointerType::get(rewriter.getI8Type());
+
+    int64_t rank = memrefType.getRank();
+    Value shape = rewriter.create<memref::AllocaOp>(
+        loc, MemRefType::get({std::max<int64_t>(rank, 1)}, i64Type));
+    for (auto it : llvm::enumerate(memrefType.getShape()))
+      rewriter.create<memref::StoreOp>(
+          loc, insertI64Constant(loc, rewriter, it.value()), shape,
+          ValueRange{rewriter.create<arith::ConstantOp>(
+              loc, rewriter.getIndexAttr(it.index()))});
+
+    // See CosimRuntime::Flags and CosimRuntime::Kind.
+    int32_t flags = (earlyExit ? 1 : 0) | (tolerance.nanEqual ? 2 : 0) |
+                    (hash ? 4 : 0) | (hash && printDigests ? 8 : 0);
+    int32_t kind = elemType.isa<FloatType>() ? 1 : 0;
+    auto i32Constant = [&](int32_t value) -> Value {
+      return rewriter.create<arith::ConstantOp>(
+          loc, rewriter.getI32IntegerAttr(value));
+    };
+    std::string sites = getCosimSites(op);
+    sites.push_back('\0');
+
+    auto funcOp = getOrInsertRefCacheFunc(
+        rewriter, module, "hlt_cosim_compare_memref",
+        LLVM::LLVMVoidType::get(rewriter.getContext()),
+        {i8PtrType, i8PtrType, i64Type, i8PtrType, i32Type, i32Type, i64Type,
+         i32Type, f64Type, i64Type, i8PtrType});
+    rewriter.create<LLVM::CallOp>(
+        loc, funcOp,
+        ValueRange{
+            insertAlignedPtr(loc, rewriter, op.getRef()),
+            insertAlignedPtr(loc, rewriter, op.getTarget()),
+            insertI64Constant(loc, rewriter, rank),
+            insertAlignedPtr(loc, rewriter, shape), i32Constant(kind),
+            i32Constant(getElementBits(elemType)),
+            insertI64Constant(loc, rewriter, maxReports), i32Constant(flags),
+            rewriter.create<arith::ConstantOp>(
+                loc, rewriter.getF64FloatAttr(tolerance.absTolerance)),
+            insertI64Constant(loc, rewriter, tolerance.ulpTolerance),
+            getOrCreateFormatString(loc, rewriter, "cosimSitesStr", sites,
+                                    module)});
+  }
+
+  // Compares 'bytes' bytes of the memories 'a' and 'b' through memcmp, and
+  // returns an i1 value which is set if they differ. Any padding bits of non
+  // byte-sized elements are included; this may report a mismatch which the
+  // element-wise comparison does not, but never the inverse.
+  static Value insertMemcmp(Location loc, ModuleOp module,
+                            PatternRewriter &rewriter, Value a, Value b,
+                            int64_t bytes) {
+    auto i64Type = rewriter.getI64Type();
+    Value size = rewriter.create<LLVM::ConstantOp>(
+        loc, i64Type, rewriter.getI64IntegerAttr(bytes));
+
+    auto memcmp = module.lookupSymbol<LLVM::LLVMFuncOp>(
+        getOrInsertMemcmp(rewriter, module));
+    auto call = rewriter.create<LLVM::CallOp>(
+        loc, memcmp,
+        ValueRange{insertAlignedPtr(loc, rewriter, a),
+                   insertAlignedPtr(loc, rewriter, b), size});
+    auto zero = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getI32IntegerAttr(0));
+    return rewriter.create<arith::CmpIOp>(loc, arith::CmpIPredicate::ne,
+                                          call->getResult(0), zero);
+  }
+
+  // Raises the maximum absolute error in 'maxError' to that of the float
+  // elements 'a' and 'b', which is NaN if either is NaN.
+  static void insertMaxErrorUpdate(Location loc, PatternRewriter &rewriter,
+                                   Value a, Value b, Value maxError) {
+    auto f64Type = rewriter.getF64Type();
+    if (a.getType() != f64Type) {
+      a = rewriter.create<arith::ExtFOp>(loc, f64Type, a);
+      b = rewriter.create<arith::ExtFOp>(loc, f64Type, b);
+    }
+    auto error =
+        insertAbsF(loc, rewriter, rewriter.create<arith::SubFOp>(loc, a, b));
+    Value max = rewriter.create<memref::LoadOp>(loc, maxError);
+    auto raise = rewriter.create<arith::CmpFOp>(
+        loc, arith::CmpFPredicate::UGT, error, max);
+    rewriter.create<memref::StoreOp>(
+        loc, rewriter.create<arith::SelectOp>(loc, raise, error, max),
+        maxError);
+  }
+
+  // Maximum number of mismatching elements to report; 0 reports all.
+  unsigned maxReports;
+  // If set, stop comparing after the first mismatch.
+  bool earlyExit;
+  // Tolerances of float element comparisons.
+  FloatTolerance tolerance;
+  // If set, memories are compared through their digests, which are printed
+  // if 'printDigests' is set.
+  bool hash;
+  bool printDigests;
+  // If set, contiguous memories are compared by the HLT cosim runtime.
+  bool runtime;
 };
 
 struct CosimLowerComparePass
@@ -377,7 +1592,15 @@ struct CosimLowerComparePass
   void runOnOperation() override {
     auto *ctx = &getContext();
     RewritePatternSet patterns(ctx);
-    patterns.insert<ConvertCompareIntegerLike, ConvertCompareMemref>(ctx);
+    FloatTolerance tolerance;
+    tolerance.absTolerance = absTolerance;
+    tolerance.ulpTolerance = ulpTolerance;
+    tolerance.nanEqual = nanEqual;
+    patterns.insert<ConvertCompareIntegerLike>(ctx);
+    patterns.insert<ConvertCompareFloat>(ctx, tolerance);
+    patterns.insert<ConvertCompareMemref>(ctx, maxReports, earlyExit,
+                                          tolerance, hash, printDigests,
+                                          runtime);
     ConversionTarget target(*ctx);
     target.addIllegalOp<cosim::CallOp>();
     target.addIllegalOp<cosim::CompareOp>();
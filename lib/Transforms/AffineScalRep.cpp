@@ -11,7 +11,9 @@
 //===----------------------------------------------------------------------===//
 
 #include "PassDetail.h"
+#include "mlir/Dialect/Affine/Analysis/LoopAnalysis.h"
 #include "mlir/Dialect/Affine/IR/AffineMemoryOpInterfaces.h"
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
 #include "mlir/Dialect/ControlFlow/IR/ControlFlowOps.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
@@ -31,14 +33,141 @@ private:
                             SmallVectorImpl<Operation *> &storeOpsToErase,
                             SmallPtrSetImpl<Value> &memrefsToErase,
                             DominanceInfo &domInfo);
+
+  /// Promotes memref accumulators which are loaded from and stored to in each
+  /// iteration of 'forOp' into iter_args of the loop. Returns the resulting
+  /// loop, which replaces 'forOp' if any accumulator was promoted.
+  AffineForOp promoteLoopCarriedAccumulators(AffineForOp forOp);
 };
 } // namespace
 
+/// Returns true if 'a' and 'b' access the same element of the same memref.
+static bool isSameAccess(AffineReadOpInterface a, AffineWriteOpInterface b) {
+  return a.getMemRef() == b.getMemRef() &&
+         a.getAffineMap() == b.getAffineMap() &&
+         llvm::equal(a.getMapOperands(), b.getMapOperands());
+}
+
+/// Returns true if any op within 'forOp', other than 'loadOp' and 'storeOp',
+/// may access 'memref', or has unknown memory effects. Distinct memrefs are
+/// assumed not to alias, since each memref is given its own memory when
+/// lowered to hardware.
+static bool hasInterveningAccess(AffineForOp forOp, Value memref,
+                                 Operation *loadOp, Operation *storeOp) {
+  auto walkRes = forOp.getBody()->walk([&](Operation *op) {
+    if (op == loadOp || op == storeOp)
+      return WalkResult::advance();
+    if (op->hasTrait<OpTrait::HasRecursiveMemoryEffects>())
+      return WalkResult::advance();
+    auto effectOp = dyn_cast<MemoryEffectOpInterface>(op);
+    if (!effectOp)
+      return WalkResult::interrupt();
+    SmallVector<MemoryEffects::EffectInstance> effects;
+    effectOp.getEffects(effects);
+    for (auto &effect : effects)
+      if (!effect.getValue() || effect.getValue() == memref)
+        return WalkResult::interrupt();
+    return WalkResult::advance();
+  });
+  return walkRes.wasInterrupted();
+}
+
+/// Promotes memref accumulators of 'forOp' into iter_args. An accumulator is
+/// an element of a memref which is loaded from and subsequently stored to in
+/// every iteration of the loop, at an index which is invariant in the loop,
+/// with no other accesses to the memref within the loop. The element is
+/// instead loaded once before the loop, carried through the iterations as an
+/// iter_arg, and stored once after the loop. Since these accesses happen even
+/// if the loop does not iterate, only loops which provably run at least once
+/// are considered.
+AffineForOp
+AffineScalRepPass::promoteLoopCarriedAccumulators(AffineForOp forOp) {
+  Optional<uint64_t> tripCount = getConstantTripCount(forOp);
+  if (!tripCount || *tripCount == 0)
+    return forOp;
+
+  while (true) {
+    // Find a load and store pair within the body of the loop, which is thus
+    // executed in every iteration.
+    AffineReadOpInterface loadOp;
+    AffineWriteOpInterface storeOp;
+    for (auto candidate : forOp.getBody()->getOps<AffineWriteOpInterface>()) {
+      Value memref = candidate.getMemRef();
+      if (candidate.getValueToStore().getType() !=
+              memref.getType().cast<MemRefType>().getElementType() ||
+          !llvm::all_of(candidate.getMapOperands(), [&](Value v) {
+            return forOp.isDefinedOutsideOfLoop(v);
+          }))
+        continue;
+      auto loads = forOp.getBody()->getOps<AffineReadOpInterface>();
+      auto loadIt = llvm::find_if(loads, [&](AffineReadOpInterface load) {
+        return isSameAccess(load, candidate) &&
+               load->isBeforeInBlock(candidate);
+      });
+      if (loadIt == loads.end() ||
+          (*loadIt).getValue().getType() !=
+              candidate.getValueToStore().getType() ||
+          hasInterveningAccess(forOp, memref, *loadIt, candidate))
+        continue;
+      loadOp = *loadIt;
+      storeOp = candidate;
+      break;
+    }
+    if (!loadOp)
+      return forOp;
+
+    // Load the initial value of the accumulator before the loop.
+    OpBuilder builder(forOp);
+    Location loc = loadOp.getLoc();
+    Value memref = storeOp.getMemRef();
+    AffineMap map = storeOp.getAffineMap();
+    SmallVector<Value> mapOperands(storeOp.getMapOperands());
+    Value init = builder.create<AffineLoadOp>(loc, memref, map, mapOperands);
+
+    // Create a new loop with an additional iter_arg for the accumulator, and
+    // move the body of the old loop into it.
+    SmallVector<Value> iterOperands(forOp.getIterOperands());
+    iterOperands.push_back(init);
+    auto newForOp = builder.create<AffineForOp>(
+        forOp.getLoc(), forOp.getLowerBoundOperands(),
+        forOp.getLowerBoundMap(), forOp.getUpperBoundOperands(),
+        forOp.getUpperBoundMap(), forOp.getStep(), iterOperands);
+    Block *newBody = newForOp.getBody();
+    if (!newBody->empty())
+      newBody->back().erase();
+    newBody->getOperations().splice(newBody->end(),
+                                    forOp.getBody()->getOperations());
+    forOp.getInductionVar().replaceAllUsesWith(newForOp.getInductionVar());
+    for (auto it : llvm::zip(forOp.getRegionIterArgs(),
+                             newForOp.getRegionIterArgs()))
+      std::get<0>(it).replaceAllUsesWith(std::get<1>(it));
+
+    // Uses of the loaded value are replaced by the value carried from the
+    // previous iteration, and the stored value is carried to the next.
+    loadOp.getValue().replaceAllUsesWith(newForOp.getRegionIterArgs().back());
+    Operation *yieldOp = newBody->getTerminator();
+    yieldOp->insertOperands(yieldOp->getNumOperands(),
+                            storeOp.getValueToStore());
+    loadOp->erase();
+    storeOp->erase();
+
+    // Store the final value of the accumulator after the loop.
+    for (auto it : llvm::zip(forOp.getResults(), newForOp.getResults()))
+      std::get<0>(it).replaceAllUsesWith(std::get<1>(it));
+    builder.setInsertionPointAfter(newForOp);
+    builder.create<AffineStoreOp>(loc, newForOp.getResults().back(), memref,
+                                  map, mapOperands);
+    forOp.erase();
+    forOp = newForOp;
+  }
+}
+
 /// Attempt to replace the operands to returnOp with values stored into memory
 /// which is returned. This check involves three components: 1) The store and
 /// return must be on the same location 2) The store must dominate (and
 /// therefore must always occur prior to) the return 3) No other operations will
-/// overwrite the memory loaded between the given store and return.  If such a
+/// overwrite the memory loaded between the given store and return. Only rank-0
+/// memrefs which are not read from are considered. If such a
 /// value exists, the replaced value will be used in the `returnOp` operands and
 /// its memref will be added to `memrefsToErase`.
 void AffineScalRepPass::forwardStoreToReturn(
@@ -54,27 +183,37 @@ void AffineScalRepPass::forwardStoreToReturn(
     if (!memRefType)
       continue;
 
-    Operation *definingOp = opOperand.get().getDefiningOp();
-    if (!definingOp)
+    // Only scalar memories are forwarded, since the store of an element does
+    // not define the rest of the memory.
+    Value memref = opOperand.get();
+    if (memRefType.getRank() != 0)
       continue;
 
-    for (auto *user : definingOp->getUsers()) {
+    // The memory must not be read, nor escape, other than through the return.
+    if (llvm::any_of(memref.getUsers(), [&](Operation *user) {
+          return user != returnOp &&
+                 !isa<AffineWriteOpInterface, memref::DeallocOp>(user);
+        }))
+      continue;
+
+    for (auto *user : memref.getUsers()) {
       auto storeOp = dyn_cast<AffineWriteOpInterface>(user);
       if (!storeOp)
         continue;
-
-      if (lastWriteStoreOp && !domInfo.dominates(lastWriteStoreOp, storeOp)) {
-        storeOpsToErase.push_back(storeOp);
-        continue;
-      }
-
-      // TODO: check intervening.
-
-      lastWriteStoreOp = storeOp;
+      if (!lastWriteStoreOp || domInfo.dominates(lastWriteStoreOp, storeOp))
+        lastWriteStoreOp = storeOp;
     }
 
-    if (!lastWriteStoreOp)
-      return;
+    // The forwarded store must be the last write on every path to the return,
+    // such that no other store may overwrite the memory after it.
+    if (!lastWriteStoreOp || !domInfo.dominates(lastWriteStoreOp, returnOp))
+      continue;
+    if (llvm::any_of(memref.getUsers(), [&](Operation *user) {
+          return user != lastWriteStoreOp &&
+                 isa<AffineWriteOpInterface>(user) &&
+                 !domInfo.dominates(user, lastWriteStoreOp);
+        }))
+      continue;
 
     // Perform the actual store to load forwarding.
     Value storeVal =
@@ -82,11 +221,11 @@ void AffineScalRepPass::forwardStoreToReturn(
     // Check if 2 values have the same shape. This is needed for affine vector
     // loads and stores.
     if (storeVal.getType() != memRefType.getElementType())
-      return;
+      continue;
 
     // Record the store and memref for a later sweep to optimize away.
     storeOpsToErase.push_back(lastWriteStoreOp);
-    memrefsToErase.insert(opOperand.get());
+    memrefsToErase.insert(memref);
 
     // Update the operand to the stored value.
     opOperand.set(storeVal);
@@ -113,6 +252,13 @@ void AffineScalRepPass::runOnOperation() {
   // A list of memref's that are potentially dead / could be eliminated.
   SmallPtrSet<Value, 4> memrefsToErase;
 
+  // Promote loop-carried accumulators, innermost loops first, such that an
+  // accumulator of an inner loop may be promoted through the outer loops.
+  SmallVector<AffineForOp> loops;
+  f.walk([&](AffineForOp forOp) { loops.push_back(forOp); });
+  for (auto forOp : loops)
+    promoteLoopCarriedAccumulators(forOp);
+
   auto &domInfo = getAnalysis<DominanceInfo>();
 
   // Perform store to return forwarding.
@@ -127,7 +273,6 @@ void AffineScalRepPass::runOnOperation() {
   // thus be completely deleted. Note: the canonicalize pass should be able
   // to do this as well, but we'll do it here since we collected these anyway.
   for (auto memref : memrefsToErase) {
-    memref.dump();
     // If the memref hasn't been alloc'ed in this function, skip.
     Operation *defOp = memref.getDefiningOp();
     if (!defOp || !isa<memref::AllocOp, memref::AllocaOp>(defOp))
@@ -0,0 +1,112 @@
+//===- AnnotateIndependence.cpp - Memory access independence -----*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Annotates the pairs of affine accesses to the same memref which are proven
+// to never access the same element, such that the lowering to handshake need
+// not order them with respect to each other.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Dialect/Affine/Analysis/AffineAnalysis.h"
+#include "mlir/Dialect/Affine/Analysis/Utils.h"
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/IR/Builders.h"
+#include "llvm/ADT/MapVector.h"
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+// Integer attribute which identifies each annotated access within its
+// function, and array attribute of the identifiers of the accesses which an
+// access is independent of.
+static constexpr StringLiteral kAccessIdAttr = "hls.access_id";
+static constexpr StringLiteral kIndependentAttr = "hls.independent";
+
+/// Returns true if 'src' and 'dst' are proven to never access the same
+/// element of their memref, in any order, within the same or across any
+/// iteration of their common loops.
+static bool isIndependent(Operation *src, Operation *dst) {
+  MemRefAccess srcAccess(src), dstAccess(dst);
+  unsigned numCommonLoops = getNumCommonSurroundingLoops(*src, *dst);
+  for (unsigned depth = 1; depth <= numCommonLoops + 1; ++depth) {
+    if (checkMemrefAccessDependence(srcAccess, dstAccess, depth).value !=
+            DependenceResult::NoDependence ||
+        checkMemrefAccessDependence(dstAccess, srcAccess, depth).value !=
+            DependenceResult::NoDependence)
+      return false;
+  }
+  return true;
+}
+
+namespace {
+
+struct AnnotateIndependencePass
+    : public AnnotateIndependenceBase<AnnotateIndependencePass> {
+public:
+  void runOnOperation() override {
+    // Group the affine accesses of the function by their memref, in program
+    // order.
+    llvm::MapVector<Value, SmallVector<Operation *>> accesses;
+    getOperation().walk([&](Operation *op) {
+      if (isa<AffineReadOpInterface, AffineWriteOpInterface>(op))
+        accesses[MemRefAccess(op).memref].push_back(op);
+    });
+
+    int64_t nextId = 0;
+    for (auto &it : accesses)
+      annotate(it.second, nextId);
+  }
+
+private:
+  /// Annotates each access of 'ops', which access the same memref, with the
+  /// accesses of 'ops' which it is independent of. Accesses are identified
+  /// from 'nextId' onwards.
+  void annotate(ArrayRef<Operation *> ops, int64_t &nextId);
+};
+
+void AnnotateIndependencePass::annotate(ArrayRef<Operation *> ops,
+                                        int64_t &nextId) {
+  // Loads are never ordered with respect to each other.
+  SmallVector<SmallVector<int64_t>> independent(ops.size());
+  bool anyIndependent = false;
+  for (unsigned i = 0; i < ops.size(); ++i) {
+    for (unsigned j = i + 1; j < ops.size(); ++j) {
+      if ((isa<AffineReadOpInterface>(ops[i]) &&
+           isa<AffineReadOpInterface>(ops[j])) ||
+          !isIndependent(ops[i], ops[j]))
+        continue;
+      independent[i].push_back(nextId + j);
+      independent[j].push_back(nextId + i);
+      anyIndependent = true;
+      ++numPairs;
+    }
+  }
+  if (!anyIndependent)
+    return;
+
+  OpBuilder builder(&getContext());
+  for (auto it : llvm::enumerate(ops)) {
+    it.value()->setAttr(kAccessIdAttr,
+                        builder.getI64IntegerAttr(nextId + it.index()));
+    if (!independent[it.index()].empty())
+      it.value()->setAttr(kIndependentAttr,
+                          builder.getI64ArrayAttr(independent[it.index()]));
+  }
+  nextId += ops.size();
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createAnnotateIndependencePass() {
+  return std::make_unique<AnnotateIndependencePass>();
+}
+} // namespace circt_hls
@@ -0,0 +1,163 @@
+//===- ApplyLoopPragmas.cpp - HLS loop pragma annotation ---------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Annotates the loops of a kernel with the HLS pipeline and unroll pragmas of
+// its C source, which Polygeist does not carry into the IR.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/IR/Builders.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+// The initiation interval which a pipeline pragma requests of a loop, and the
+// factor which an unroll pragma unrolls it by; 0 unrolls the loop fully.
+static constexpr StringLiteral kPipelineIIAttr = "hls.pipeline_ii";
+static constexpr StringLiteral kUnrollAttr = "hls.unroll";
+
+namespace {
+
+/// The pragmas of a loop of the C source. The loop is identified by its
+/// function, its index among the loops of the function in source order, and
+/// the file and line of its statement.
+struct LoopPragma {
+  std::string function;
+  int64_t loop;
+  std::string file;
+  Optional<int64_t> line;
+  Optional<int64_t> pipelineII;
+  Optional<int64_t> unroll;
+};
+
+struct ApplyLoopPragmasPass
+    : public ApplyLoopPragmasBase<ApplyLoopPragmasPass> {
+public:
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+    SmallVector<LoopPragma> loopPragmas;
+    if (failed(readPragmas(module, loopPragmas)))
+      return signalPassFailure();
+
+    OpBuilder builder(&getContext());
+    for (auto &pragma : loopPragmas) {
+      auto f = module.lookupSymbol<FuncOp>(pragma.function);
+      Operation *loop = f ? getLoop(f, pragma) : nullptr;
+      if (!loop) {
+        module.emitWarning() << "no loop of '" << pragma.function
+                             << "' matches the pragmas of loop "
+                             << pragma.loop;
+        ++numUnmatched;
+        continue;
+      }
+
+      if (pragma.pipelineII) {
+        if (*pragma.pipelineII < 1) {
+          loop->emitError() << "expected a pipeline II of at least 1, got "
+                            << *pragma.pipelineII;
+          return signalPassFailure();
+        }
+        loop->setAttr(kPipelineIIAttr,
+                      builder.getI64IntegerAttr(*pragma.pipelineII));
+      }
+      if (pragma.unroll) {
+        if (isa<scf::WhileOp>(loop))
+          loop->emitWarning() << "cannot unroll a while loop; the unroll "
+                                 "pragma is ignored";
+        else
+          loop->setAttr(kUnrollAttr, builder.getI64IntegerAttr(*pragma.unroll));
+      }
+      ++numApplied;
+    }
+  }
+
+private:
+  /// Reads the loop pragmas written by hlstool from the 'pragmas' file.
+  LogicalResult readPragmas(ModuleOp module,
+                            SmallVectorImpl<LoopPragma> &loopPragmas);
+
+  /// Returns the loop of 'f' which 'pragma' applies to: the loop whose source
+  /// location is on the line of the pragma, if the IR holds the locations of
+  /// the C source, or else the loop at the index of the pragma, in pre-order.
+  /// Locations of other files, such as those which the parser gives to IR
+  /// without locations, are not matched.
+  Operation *getLoop(FuncOp f, const LoopPragma &pragma);
+};
+
+Operation *ApplyLoopPragmasPass::getLoop(FuncOp f, const LoopPragma &pragma) {
+  SmallVector<Operation *> loops;
+  f.walk<WalkOrder::PreOrder>([&](Operation *op) {
+    if (isa<AffineForOp, scf::ForOp, scf::WhileOp>(op))
+      loops.push_back(op);
+  });
+
+  if (pragma.line && !pragma.file.empty())
+    for (Operation *loop : loops) {
+      auto loc = loop->getLoc()->findInstanceOf<FileLineColLoc>();
+      if (loc && loc.getLine() == *pragma.line &&
+          llvm::sys::path::filename(loc.getFilename()) ==
+              llvm::sys::path::filename(pragma.file))
+        return loop;
+    }
+  if (pragma.loop < 0 || pragma.loop >= static_cast<int64_t>(loops.size()))
+    return nullptr;
+  return loops[pragma.loop];
+}
+
+LogicalResult
+ApplyLoopPragmasPass::readPragmas(ModuleOp module,
+                                  SmallVectorImpl<LoopPragma> &loopPragmas) {
+  auto buf = llvm::MemoryBuffer::getFile(pragmas);
+  if (!buf)
+    return module.emitError() << "could not read loop pragmas '" << pragmas
+                              << "': " << buf.getError().message();
+
+  auto json = llvm::json::parse((*buf)->getBuffer());
+  if (!json)
+    return module.emitError() << "could not parse loop pragmas '" << pragmas
+                              << "': " << llvm::toString(json.takeError());
+
+  auto *root = json->getAsObject();
+  if (!root || !root->getArray("loops"))
+    return module.emitError()
+           << "expected loop pragmas '" << pragmas << "' to contain 'loops'";
+
+  for (auto &loopValue : *root->getArray("loops")) {
+    auto *loop = loopValue.getAsObject();
+    auto function = loop ? loop->getString("function") : None;
+    auto index = loop ? loop->getInteger("loop") : None;
+    if (!function || !index)
+      return module.emitError() << "expected each loop of pragmas '" << pragmas
+                                << "' to have a 'function' and a 'loop'";
+    LoopPragma &pragma = loopPragmas.emplace_back();
+    pragma.function = function->str();
+    pragma.loop = *index;
+    if (auto file = loop->getString("file"))
+      pragma.file = file->str();
+    pragma.line = loop->getInteger("line");
+    pragma.pipelineII = loop->getInteger("pipeline_ii");
+    pragma.unroll = loop->getInteger("unroll");
+  }
+  return success();
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createApplyLoopPragmasPass() {
+  return std::make_unique<ApplyLoopPragmasPass>();
+}
+} // namespace circt_hls
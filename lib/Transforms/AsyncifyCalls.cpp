@@ -20,6 +20,7 @@
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/SCF/Utils/Utils.h"
 #include "mlir/IR/BlockAndValueMapping.h"
 #include "mlir/IR/BuiltinDialect.h"
 #include "mlir/IR/BuiltinTypes.h"
@@ -65,7 +66,7 @@ static void recurseCloneUpstream(ConversionPatternRewriter &rewriter,
     if (mapping.contains(operand))
       continue;
     auto producerOp = operand.getDefiningOp();
-    if (producerOp->getParentRegion() != op->getParentRegion())
+    if (!producerOp || producerOp->getParentRegion() != op->getParentRegion())
       continue;
 
     // Recursively ensure that all operands of the producerOp are available in
@@ -84,12 +85,40 @@ static void recurseCloneUpstream(ConversionPatternRewriter &rewriter,
   LLVM_DEBUG(llvm::dbgs() << "Finished upstream cloning: " << *op << "\n");
 }
 
+// Returns the operations which are downstream of the results of op, in
+// topological order. Each operation is visited once, such that the traversal
+// is linear in the size of the dataflow graph even if it fans out and
+// reconverges. Users are visited in reverse order, such that the order of a
+// tree-shaped graph is its pre-order.
+static SmallVector<Operation *> getDownstreamOps(Operation *op) {
+  SmallVector<Operation *> postOrder;
+  llvm::SmallPtrSet<Operation *, 16> visited;
+  visited.insert(op);
+  using UserList = SmallVector<Operation *>;
+  SmallVector<std::pair<Operation *, UserList>> worklist;
+  worklist.push_back({op, UserList(op->getUsers())});
+  while (!worklist.empty()) {
+    auto &users = worklist.back().second;
+    if (users.empty()) {
+      postOrder.push_back(worklist.pop_back_val().first);
+      continue;
+    }
+    Operation *userOp = users.pop_back_val();
+    if (visited.insert(userOp).second)
+      worklist.push_back({userOp, UserList(userOp->getUsers())});
+  }
+  // Drop op itself, which is the last operation of the post-order.
+  postOrder.pop_back();
+  return llvm::to_vector(llvm::reverse(postOrder));
+}
+
 // Like recurseCloneUpstream, but clones based on the dataflow graph following
-// the result of operations.
-static void recurseCloneDownstream(ConversionPatternRewriter &rewriter,
-                                   BlockAndValueMapping &mapping, Operation *op,
-                                   bool cloneOp = true,
-                                   bool cloneUpstream = true) {
+// the result of operations. Downstream operations are cloned in topological
+// order, such that the operands of each downstream operation which are
+// themselves downstream of op are already in the mapping.
+static void cloneDownstream(ConversionPatternRewriter &rewriter,
+                            BlockAndValueMapping &mapping, Operation *op,
+                            bool cloneOp = true, bool cloneUpstream = true) {
   LLVM_DEBUG(llvm::dbgs() << "Downstream cloning: " << *op << "\n");
 
   if (cloneUpstream) {
@@ -103,28 +132,24 @@ static void recurseCloneDownstream(ConversionPatternRewriter &rewriter,
     // Clone operation into insertion point
     auto clonedOp = rewriter.clone(*op, mapping);
 
-    // Extend mapping with the results of the cloned user.
+    // Extend mapping with the results of the cloned op.
     mapAllResults(mapping, op, clonedOp);
   }
 
-  // Recursively ensure that all downstream users of this op are cloned as well.
-  for (auto operand : op->getResults()) {
-    for (auto userOp : operand.getUsers()) {
-      recurseCloneDownstream(rewriter, mapping, userOp);
-    }
+  // Ensure that all downstream users of this op are cloned as well, along
+  // with the operands which are not downstream of op.
+  for (auto userOp : getDownstreamOps(op)) {
+    recurseCloneUpstream(rewriter, mapping, userOp, false);
+    mapAllResults(mapping, userOp, rewriter.clone(*userOp, mapping));
   }
   LLVM_DEBUG(llvm::dbgs() << "Finished downstream cloning: " << *op << "\n");
 }
 
-// Recursively erases all downstream users of the results of op, and finally the
-// op itself.
-static void recurseCleanDownstream(ConversionPatternRewriter &rewriter,
-                                   Operation *op, bool eraseOp = true) {
-  for (auto res : op->getResults()) {
-    for (auto user : res.getUsers()) {
-      recurseCleanDownstream(rewriter, user);
-    }
-  }
+// Erases all downstream users of the results of op, and finally the op itself.
+static void cleanDownstream(ConversionPatternRewriter &rewriter, Operation *op,
+                            bool eraseOp = true) {
+  for (auto userOp : llvm::reverse(getDownstreamOps(op)))
+    rewriter.eraseOp(userOp);
   if (eraseOp)
     rewriter.eraseOp(op);
 }
@@ -140,8 +165,28 @@ struct AsyncConversionPattern : public OpConversionPattern<TOp> {
   StringRef targetName;
 };
 
+// Collects the operations which are downstream of the results of op, as well
+// as the operations of 'block' which contain them.
+static void collectDownstream(Operation *op, Block *block,
+                              llvm::SmallPtrSetImpl<Operation *> &downstream) {
+  for (auto res : op->getResults()) {
+    for (auto user : res.getUsers()) {
+      if (!downstream.insert(user).second)
+        continue;
+      if (auto *ancestor = block->findAncestorOpInBlock(*user))
+        downstream.insert(ancestor);
+      collectDownstream(user, block, downstream);
+    }
+  }
+}
+
 struct ForOpConversion : public AsyncConversionPattern<scf::ForOp> {
-  using AsyncConversionPattern::AsyncConversionPattern;
+  ForOpConversion(MLIRContext *ctx, FuncOp callFunc, FuncOp awaitFunc,
+                  StringRef targetName, unsigned window,
+                  FuncOp callTaggedFunc = {}, FuncOp awaitTaggedFunc = {})
+      : AsyncConversionPattern(ctx, callFunc, awaitFunc, targetName),
+        window(window), callTaggedFunc(callTaggedFunc),
+        awaitTaggedFunc(awaitTaggedFunc) {}
 
   LogicalResult
   matchAndRewrite(scf::ForOp op, OpAdaptor adaptor,
@@ -162,11 +207,33 @@ struct ForOpConversion : public AsyncConversionPattern<scf::ForOp> {
       return op.emitOpError() << "Cannot transform a for loop with multiple "
                                  "calls to the target function";
 
-    if (!op.getIterOperands().empty())
+    CallOp sourceCallOp = *callOps.begin();
+
+    // Loop-carried values are only supported as reductions of the results of
+    // the call, which can be moved to the await loop in their entirety.
+    llvm::SmallPtrSet<Operation *, 8> downstream;
+    collectDownstream(sourceCallOp, op.getBody(), downstream);
+    if (!op.getIterOperands().empty()) {
+      bool isReduction =
+          downstream.contains(op.getBody()->getTerminator()) &&
+          llvm::all_of(op.getRegionIterArgs(), [&](Value arg) {
+            return llvm::all_of(arg.getUsers(), [&](Operation *user) {
+              return downstream.contains(user);
+            });
+          });
+      if (!isReduction)
+        return op.emitOpError()
+               << "Cannot transform a for loop with iter arguments which are "
+                  "not reductions of the results of the target function";
+    }
+
+    bool outOfOrder = callTaggedFunc && awaitTaggedFunc;
+    if (outOfOrder && !op.getIterOperands().empty())
       return op.emitOpError()
-             << "Cannot transform a for loop with iter arguments";
+             << "Cannot transform a for loop with iter arguments out of order";
 
-    CallOp sourceCallOp = *callOps.begin();
+    if (window != 0 || outOfOrder || !op.getIterOperands().empty())
+      return rewriteDecoupled(op, sourceCallOp, downstream, rewriter);
 
     rewriter.startRootUpdate(op);
 
@@ -192,18 +259,167 @@ struct ForOpConversion : public AsyncConversionPattern<scf::ForOp> {
     mapAllResults(mapping, sourceCallOp, clonedAwaitOp);
     // We recurse clone from the source call op since the SSA value replacements
     // have yet to be materialized.
-    recurseCloneDownstream(rewriter, mapping, sourceCallOp, /*cloneOp=*/false,
-                           /*cloneUpstream=*/false);
+    cloneDownstream(rewriter, mapping, sourceCallOp, /*cloneOp=*/false,
+                    /*cloneUpstream=*/false);
 
     // Cleanup by erasing everything that is downstream from the sourceCallOp in
     // the call loop. eraseOp is false due to sourceCallOp already being
     // replaced by replaceOpWithNewOp.
-    recurseCleanDownstream(rewriter, sourceCallOp, /*eraseOp=*/false);
+    cleanDownstream(rewriter, sourceCallOp, /*eraseOp=*/false);
     // erase the temporary await op.
     rewriter.eraseOp(awaitOp);
     rewriter.finalizeRootUpdate(op);
     return success();
   }
+
+private:
+  // Replaces the loop by new loops which issue and await the calls. Without a
+  // window, a loop which issues all calls is followed by a loop which awaits
+  // all calls and carries any reductions of their results. With a window, the
+  // loop is software pipelined such that iteration i awaits the call of
+  // iteration i - window and then issues the call of iteration i, keeping at
+  // most 'window' calls in flight. The loop runs for 'window' additional
+  // iterations to await the last calls:
+  //
+  //   scf.for %i = %lb to %ub + window * %step step %step {
+  //     %j = %i - window * %step
+  //     scf.if %j >= %lb { await body(%j) }
+  //     scf.if %i < %ub { call body(%i) }
+  //   }
+  LogicalResult
+  rewriteDecoupled(scf::ForOp op, CallOp sourceCallOp,
+                   const llvm::SmallPtrSetImpl<Operation *> &downstream,
+                   ConversionPatternRewriter &rewriter) const {
+    Location loc = op.getLoc();
+    bool hasIterArgs = !op.getIterOperands().empty();
+
+    // Out of order, each call is tagged with its induction variable, and the
+    // results of each await are written to the iteration of their tag. The tag
+    // of each await is returned through a memref.
+    bool outOfOrder = callTaggedFunc && awaitTaggedFunc;
+    Value tagMemref, zero;
+    rewriter.setInsertionPoint(op);
+    if (outOfOrder) {
+      tagMemref = rewriter.create<memref::AllocaOp>(
+          loc, MemRefType::get({1}, rewriter.getI64Type()));
+      zero = rewriter.create<arith::ConstantOp>(loc, rewriter.getIndexAttr(0));
+    }
+
+    // Issues the call of iteration 'iv', along with everything in the loop body
+    // which does not depend on its results.
+    auto emitCall = [&](Value iv) {
+      BlockAndValueMapping mapping;
+      mapping.map(op.getInductionVar(), iv);
+      for (auto &bodyOp : op.getBody()->without_terminator()) {
+        if (downstream.contains(&bodyOp))
+          continue;
+        if (&bodyOp == sourceCallOp.getOperation()) {
+          SmallVector<Value> operands;
+          if (outOfOrder)
+            operands.push_back(rewriter.create<arith::IndexCastOp>(
+                loc, rewriter.getI64Type(), iv));
+          for (auto operand : sourceCallOp.getOperands())
+            operands.push_back(mapping.lookupOrDefault(operand));
+          rewriter.create<CallOp>(loc, outOfOrder ? callTaggedFunc : callFunc,
+                                  operands);
+          continue;
+        }
+        mapAllResults(mapping, &bodyOp, rewriter.clone(bodyOp, mapping));
+      }
+    };
+
+    // Awaits the call of iteration 'iv', along with everything in the loop body
+    // which depends on its results. Any reduction is carried through
+    // 'iterArgs', and yielded at the end of the insertion block.
+    auto emitAwait = [&](Value iv, ValueRange iterArgs) {
+      BlockAndValueMapping mapping;
+      mapping.map(op.getRegionIterArgs(), iterArgs);
+      CallOp awaitCall;
+      if (outOfOrder) {
+        awaitCall = rewriter.create<CallOp>(loc, awaitTaggedFunc, tagMemref);
+        Value tag = rewriter.create<memref::LoadOp>(loc, tagMemref, zero);
+        iv = rewriter.create<arith::IndexCastOp>(loc, rewriter.getIndexType(),
+                                                 tag);
+      } else
+        awaitCall = rewriter.create<CallOp>(loc, awaitFunc, ValueRange());
+      mapping.map(op.getInductionVar(), iv);
+      mapAllResults(mapping, sourceCallOp, awaitCall);
+      cloneDownstream(rewriter, mapping, sourceCallOp, /*cloneOp=*/false,
+                      /*cloneUpstream=*/false);
+      // The yield of the reduction may be cloned before other downstream
+      // operations.
+      Block *block = rewriter.getInsertionBlock();
+      if (hasIterArgs)
+        for (auto yield :
+             llvm::make_early_inc_range(block->getOps<scf::YieldOp>()))
+          yield->moveBefore(block, block->end());
+    };
+
+    scf::ForOp resultLoop;
+    if (window == 0) {
+      auto callLoop = rewriter.create<scf::ForOp>(
+          loc, op.getLowerBound(), op.getUpperBound(), op.getStep());
+      rewriter.setInsertionPointToStart(callLoop.getBody());
+      emitCall(callLoop.getInductionVar());
+
+      rewriter.setInsertionPointAfter(callLoop);
+      resultLoop = rewriter.create<scf::ForOp>(
+          loc, op.getLowerBound(), op.getUpperBound(), op.getStep(),
+          op.getIterOperands());
+      rewriter.setInsertionPointToStart(resultLoop.getBody());
+      emitAwait(resultLoop.getInductionVar(), resultLoop.getRegionIterArgs());
+    } else {
+      auto windowCst = rewriter.create<arith::ConstantOp>(
+          loc, rewriter.getIndexAttr(window));
+      Value windowSteps =
+          rewriter.create<arith::MulIOp>(loc, windowCst, op.getStep());
+      Value pipelinedUb =
+          rewriter.create<arith::AddIOp>(loc, op.getUpperBound(), windowSteps);
+      resultLoop = rewriter.create<scf::ForOp>(loc, op.getLowerBound(),
+                                               pipelinedUb, op.getStep(),
+                                               op.getIterOperands());
+      Value iv = resultLoop.getInductionVar();
+      rewriter.setInsertionPointToStart(resultLoop.getBody());
+
+      // Await the call issued 'window' iterations ago. Reductions are carried
+      // unmodified through the iterations which do not await a call.
+      Value awaitIv = rewriter.create<arith::SubIOp>(loc, iv, windowSteps);
+      auto hasAwait = rewriter.create<arith::CmpIOp>(
+          loc, arith::CmpIPredicate::sge, awaitIv, op.getLowerBound());
+      auto awaitIf = rewriter.create<scf::IfOp>(
+          loc, resultLoop.getResultTypes(), hasAwait,
+          /*withElseRegion=*/hasIterArgs);
+      rewriter.setInsertionPointToStart(awaitIf.thenBlock());
+      emitAwait(awaitIv, resultLoop.getRegionIterArgs());
+      if (hasIterArgs) {
+        rewriter.setInsertionPointToStart(awaitIf.elseBlock());
+        rewriter.create<scf::YieldOp>(loc, resultLoop.getRegionIterArgs());
+      }
+
+      // Issue the call of this iteration.
+      rewriter.setInsertionPointAfter(awaitIf);
+      auto hasCall = rewriter.create<arith::CmpIOp>(
+          loc, arith::CmpIPredicate::slt, iv, op.getUpperBound());
+      auto callIf = rewriter.create<scf::IfOp>(loc, hasCall);
+      rewriter.setInsertionPointToStart(callIf.thenBlock());
+      emitCall(iv);
+
+      if (hasIterArgs) {
+        rewriter.setInsertionPointAfter(callIf);
+        rewriter.create<scf::YieldOp>(loc, awaitIf.getResults());
+      }
+    }
+
+    rewriter.replaceOp(op, resultLoop.getResults());
+    return success();
+  }
+
+  // The maximum number of calls in flight; 0 decouples all calls from all
+  // awaits.
+  unsigned window;
+  // The tagged call and await functions, if calls are awaited out of order.
+  FuncOp callTaggedFunc;
+  FuncOp awaitTaggedFunc;
 };
 
 struct CallOpConversion : public AsyncConversionPattern<mlir::func::CallOp> {
@@ -265,9 +481,19 @@ public:
     // Create external symbols for the asyncify calls.
     createExternalSymbols(source);
 
+    // Out of order, parallel loops around calls to the target function are
+    // asyncified as sequential loops.
+    if (outOfOrder)
+      sequentializeParallelLoops();
+
+    // Collapse loop nests around calls to the target function into single
+    // loops, such that the calls of a nest are issued as a single stream.
+    collapseLoopNests();
+
     RewritePatternSet patterns(ctx);
-    patterns.insert<ForOpConversion, CallOpConversion>(ctx, callOp, awaitOp,
-                                                       functionName);
+    patterns.insert<ForOpConversion>(ctx, callOp, awaitOp, functionName,
+                                     window, callTaggedOp, awaitTaggedOp);
+    patterns.insert<CallOpConversion>(ctx, callOp, awaitOp, functionName);
 
     ConversionTarget target(*ctx);
     addTargetLegalizations(target);
@@ -278,10 +504,14 @@ public:
 
   void createExternalSymbols(FuncOp sourceOp);
   void addTargetLegalizations(ConversionTarget &target);
+  void collapseLoopNests();
+  void sequentializeParallelLoops();
 
 private:
   FuncOp callOp;
   FuncOp awaitOp;
+  FuncOp callTaggedOp;
+  FuncOp awaitTaggedOp;
 };
 
 void AsyncifyCallsPass::addTargetLegalizations(ConversionTarget &target) {
@@ -329,6 +559,75 @@ void AsyncifyCallsPass::addTargetLegalizations(ConversionTarget &target) {
   });
 }
 
+void AsyncifyCallsPass::collapseLoopNests() {
+  // Gather the perfect loop nests which directly surround a call to the target
+  // function. A nest may not carry values across iterations, and the bounds of
+  // its loops must be defined outside of the nest.
+  SmallVector<SmallVector<scf::ForOp>> nests;
+  getOperation().walk([&](CallOp callOp) {
+    if (callOp.getCallee() != functionName)
+      return;
+    auto innermost = dyn_cast<scf::ForOp>(callOp->getParentOp());
+    if (!innermost || !innermost.getIterOperands().empty())
+      return;
+
+    SmallVector<scf::ForOp> nest = {innermost};
+    while (auto parent = dyn_cast<scf::ForOp>(nest.front()->getParentOp())) {
+      Block *body = parent.getBody();
+      bool isPerfect = parent.getIterOperands().empty() &&
+                       body->getOperations().size() == 2 &&
+                       &body->front() == nest.front().getOperation();
+      bool hasInvariantBounds = llvm::all_of(nest, [&](scf::ForOp loop) {
+        return llvm::all_of(loop->getOperands(), [&](Value v) {
+          return parent.isDefinedOutsideOfLoop(v);
+        });
+      });
+      if (!isPerfect || !hasInvariantBounds)
+        break;
+      nest.insert(nest.begin(), parent);
+    }
+    if (nest.size() > 1)
+      nests.push_back(nest);
+  });
+
+  for (auto &nest : nests)
+    (void)coalesceLoops(nest);
+}
+
+void AsyncifyCallsPass::sequentializeParallelLoops() {
+  // Gather the parallel loops without reductions which directly surround a
+  // call to the target function.
+  SmallVector<scf::ParallelOp> loops;
+  getOperation().walk([&](CallOp callOp) {
+    if (callOp.getCallee() != functionName)
+      return;
+    auto parallelOp = dyn_cast<scf::ParallelOp>(callOp->getParentOp());
+    if (parallelOp && parallelOp.getInitVals().empty())
+      loops.push_back(parallelOp);
+  });
+
+  // Replace each parallel loop by a nest of for loops, which is collapsed
+  // later on.
+  for (auto parallelOp : loops) {
+    OpBuilder builder(parallelOp);
+    for (auto [lb, ub, step, iv] :
+         llvm::zip(parallelOp.getLowerBound(), parallelOp.getUpperBound(),
+                   parallelOp.getStep(), parallelOp.getInductionVars())) {
+      auto forOp =
+          builder.create<scf::ForOp>(parallelOp.getLoc(), lb, ub, step);
+      iv.replaceAllUsesWith(forOp.getInductionVar());
+      builder.setInsertionPointToStart(forOp.getBody());
+    }
+    Block *body = builder.getInsertionBlock();
+    Block *parallelBody = parallelOp.getBody();
+    body->getOperations().splice(body->getTerminator()->getIterator(),
+                                 parallelBody->getOperations(),
+                                 parallelBody->begin(),
+                                 parallelBody->getTerminator()->getIterator());
+    parallelOp.erase();
+  }
+}
+
 void AsyncifyCallsPass::createExternalSymbols(FuncOp sourceOp) {
   auto *ctx = &getContext();
   auto module = getOperation();
@@ -344,6 +643,20 @@ void AsyncifyCallsPass::createExternalSymbols(FuncOp sourceOp) {
       FunctionType::get(ctx, TypeRange(), type.getResults()));
   callOp.setPrivate();
   awaitOp.setPrivate();
+
+  if (!outOfOrder)
+    return;
+  SmallVector<Type> callTaggedInputs = {builder.getI64Type()};
+  llvm::append_range(callTaggedInputs, type.getInputs());
+  callTaggedOp = builder.create<FuncOp>(
+      (sourceOp.getName() + "_call_tagged").str(),
+      FunctionType::get(ctx, callTaggedInputs, TypeRange()));
+  awaitTaggedOp = builder.create<FuncOp>(
+      (sourceOp.getName() + "_await_tagged").str(),
+      FunctionType::get(ctx, MemRefType::get({1}, builder.getI64Type()),
+                        type.getResults()));
+  callTaggedOp.setPrivate();
+  awaitTaggedOp.setPrivate();
 }
 
 } // namespace
@@ -0,0 +1,408 @@
+//===- EstimateResources.cpp - Handshake resource estimation -----*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Estimates the LUTs, registers and DSPs that a handshake function is
+// synthesized to, and the delay of its critical combinational path, from a
+// table of the cost of each op, without running synthesis.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "circt/Dialect/Handshake/HandshakeOps.h"
+#include "mlir/Support/FileUtilities.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ToolOutputFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+using namespace mlir;
+using namespace circt;
+using namespace circt_hls;
+
+namespace {
+
+/// The cost of an op of 'bits' bits wide (the widest of its operands and
+/// results), which is replicated 'n' times (e.g. for each result of a fork or
+/// each slot of a buffer): 'n * (lut + lutPerBit * bits)' LUTs and likewise
+/// registers, 'dsp + dspPerTile * tiles' DSPs, where 'tiles' is the number of
+/// 27x18 multiplier tiles of a 'bits' by 'bits' product, and a combinational
+/// delay of 'delay + delayPerBit * bits' ns from its operands to its results.
+struct Cost {
+  double lut = 0;
+  double lutPerBit = 0;
+  double ff = 0;
+  double ffPerBit = 0;
+  double dsp = 0;
+  double dspPerTile = 0;
+  double delay = 0;
+  double delayPerBit = 0;
+};
+
+/// The estimated resources of a set of ops.
+struct Estimate {
+  double luts = 0;
+  double ffs = 0;
+  double dsps = 0;
+};
+
+} // namespace
+
+/// The default cost of each op, roughly those of a 7-series or UltraScale
+/// device at the default synthesis settings of hlstool. Ops which are not
+/// listed are costed as "*". Handshake ops include the logic of their valid
+/// and ready signals.
+static const std::pair<const char *, Cost> kDefaultCosts[] = {
+    // Handshake ops.
+    {"handshake.buffer", {2, 0, 2, 1, 0, 0, 0.1, 0}},
+    {"handshake.buffer.fifo", {4, 0.5, 2, 0, 0, 0, 0.4, 0}},
+    {"handshake.fork", {1, 0, 1, 0, 0, 0, 0.3, 0}},
+    {"handshake.lazy_fork", {1, 0, 0, 0, 0, 0, 0.3, 0}},
+    {"handshake.merge", {1, 0.5, 0, 0, 0, 0, 0.4, 0}},
+    {"handshake.mux", {1, 0.5, 0, 0, 0, 0, 0.4, 0}},
+    {"handshake.control_merge", {2, 0.5, 1, 0, 0, 0, 0.5, 0}},
+    {"handshake.cond_br", {2, 0, 0, 0, 0, 0, 0.3, 0}},
+    {"handshake.join", {1, 0, 0, 0, 0, 0, 0.3, 0}},
+    {"handshake.sync", {1, 0, 0, 0, 0, 0, 0.3, 0}},
+    {"handshake.sink", {0, 0, 0, 0, 0, 0, 0, 0}},
+    {"handshake.source", {0, 0, 0, 0, 0, 0, 0, 0}},
+    {"handshake.never", {0, 0, 0, 0, 0, 0, 0, 0}},
+    {"handshake.constant", {1, 0, 0, 0, 0, 0, 0.1, 0}},
+    {"handshake.load", {2, 0, 1, 0, 0, 0, 0.3, 0}},
+    {"handshake.store", {2, 0, 1, 0, 0, 0, 0.3, 0}},
+    {"handshake.memory", {10, 1, 4, 0, 0, 0, 0.5, 0}},
+    {"handshake.extmemory", {4, 0, 2, 0, 0, 0, 0.3, 0}},
+    {"handshake.return", {1, 0, 0, 0, 0, 0, 0.2, 0}},
+    // Integer ops.
+    {"arith.addi", {1, 1, 0, 0, 0, 0, 0.3, 0.02}},
+    {"arith.subi", {1, 1, 0, 0, 0, 0, 0.3, 0.02}},
+    {"arith.cmpi", {1, 0.5, 0, 0, 0, 0, 0.3, 0.02}},
+    {"arith.andi", {0, 0.5, 0, 0, 0, 0, 0.1, 0}},
+    {"arith.ori", {0, 0.5, 0, 0, 0, 0, 0.1, 0}},
+    {"arith.xori", {0, 0.5, 0, 0, 0, 0, 0.1, 0}},
+    {"arith.select", {1, 1, 0, 0, 0, 0, 0.2, 0}},
+    {"arith.shli", {1, 3, 0, 0, 0, 0, 0.6, 0.01}},
+    {"arith.shrsi", {1, 3, 0, 0, 0, 0, 0.6, 0.01}},
+    {"arith.shrui", {1, 3, 0, 0, 0, 0, 0.6, 0.01}},
+    {"arith.muli", {1, 0.5, 0, 0, 0, 1, 1.5, 0.05}},
+    {"arith.divsi", {1, 32, 0, 0, 0, 0, 1, 0.5}},
+    {"arith.divui", {1, 32, 0, 0, 0, 0, 1, 0.5}},
+    {"arith.remsi", {1, 32, 0, 0, 0, 0, 1, 0.5}},
+    {"arith.remui", {1, 32, 0, 0, 0, 0, 1, 0.5}},
+    {"arith.extsi", {0, 0, 0, 0, 0, 0, 0, 0}},
+    {"arith.extui", {0, 0, 0, 0, 0, 0, 0, 0}},
+    {"arith.trunci", {0, 0, 0, 0, 0, 0, 0, 0}},
+    {"arith.index_cast", {0, 0, 0, 0, 0, 0, 0, 0}},
+    {"arith.bitcast", {0, 0, 0, 0, 0, 0, 0, 0}},
+    // Floating-point ops.
+    {"arith.addf", {400, 0, 500, 0, 2, 0, 4, 0}},
+    {"arith.subf", {400, 0, 500, 0, 2, 0, 4, 0}},
+    {"arith.mulf", {100, 0, 150, 0, 3, 0, 4, 0}},
+    {"arith.divf", {800, 0, 1400, 0, 0, 0, 6, 0}},
+    {"arith.cmpf", {50, 0, 0, 0, 0, 0, 1, 0}},
+    {"*", {1, 1, 0, 0, 0, 0, 0.5, 0}},
+};
+
+/// Returns the key of the cost of 'op': its name, and for fifo buffers, which
+/// are lowered to memories rather than to registers, "handshake.buffer.fifo".
+static std::string getCostKey(Operation *op) {
+  std::string key = op->getName().getStringRef().str();
+  if (auto bufferOp = dyn_cast<handshake::BufferOp>(op))
+    if (bufferOp.getBufferType() == handshake::BufferTypeEnum::fifo)
+      key += ".fifo";
+  return key;
+}
+
+/// Returns the number of bits of a value of 'type'. Index values are lowered
+/// to 64 bits, and control values carry no data.
+static unsigned getBitWidth(Type type) {
+  if (type.isIndex())
+    return 64;
+  if (type.isIntOrFloat())
+    return type.getIntOrFloatBitWidth();
+  return 0;
+}
+
+/// Returns the number of bits of the widest operand or result of 'op'.
+static unsigned getBitWidth(Operation *op) {
+  unsigned bits = 0;
+  for (Type type : op->getOperandTypes())
+    bits = std::max(bits, getBitWidth(type));
+  for (Type type : op->getResultTypes())
+    bits = std::max(bits, getBitWidth(type));
+  return bits;
+}
+
+/// Returns the number of times that the logic of 'op' is replicated: once per
+/// result of a fork, per input of a merge or join, per slot of a buffer and
+/// per port of a memory.
+static unsigned getReplication(Operation *op) {
+  if (isa<handshake::ForkOp, handshake::LazyForkOp>(op))
+    return op->getNumResults();
+  if (isa<handshake::MergeOp, handshake::ControlMergeOp, handshake::JoinOp,
+          handshake::SyncOp>(op))
+    return op->getNumOperands();
+  if (isa<handshake::MuxOp>(op))
+    return op->getNumOperands() - 1;
+  if (auto bufferOp = dyn_cast<handshake::BufferOp>(op))
+    return bufferOp.getNumSlots();
+  if (auto memOp = dyn_cast<handshake::MemoryOp>(op))
+    return memOp.getLdCount() + memOp.getStCount();
+  if (auto extMemOp = dyn_cast<handshake::ExternalMemoryOp>(op))
+    return extMemOp.getLdCount() + extMemOp.getStCount();
+  return 1;
+}
+
+/// Returns true if the results of 'op' are registered, such that a
+/// combinational path ends at the op: sequential buffers, memories, and
+/// pipelined ops with a 'latency' attribute.
+static bool isSequential(Operation *op) {
+  if (auto latencyAttr = op->getAttrOfType<IntegerAttr>("latency"))
+    return latencyAttr.getInt() > 0;
+  if (auto bufferOp = dyn_cast<handshake::BufferOp>(op))
+    return bufferOp.getBufferType() == handshake::BufferTypeEnum::seq;
+  return isa<handshake::MemoryOp, handshake::ExternalMemoryOp>(op);
+}
+
+/// Returns the name of the instance that 'op' is lowered to, if it has a
+/// 'handshake_id', and otherwise its op name and its index within the
+/// function.
+static std::string getOpName(Operation *op, unsigned idx) {
+  std::string name = op->getName().getStringRef().str();
+  if (auto idAttr = op->getAttrOfType<IntegerAttr>("handshake_id")) {
+    std::replace(name.begin(), name.end(), '.', '_');
+    return name + std::to_string(idAttr.getInt());
+  }
+  return name + "#" + std::to_string(idx);
+}
+
+namespace {
+
+struct EstimateResourcesPass
+    : public EstimateResourcesBase<EstimateResourcesPass> {
+public:
+  void runOnOperation() override {
+    handshake::FuncOp f = getOperation();
+
+    costs.clear();
+    for (auto &it : kDefaultCosts)
+      costs[it.first] = it.second;
+    if (!costsFile.empty() && failed(readCosts(f)))
+      return signalPassFailure();
+
+    SmallVector<Operation *> ops;
+    DenseMap<Operation *, unsigned> nodes;
+    for (Operation &op : f.getOps()) {
+      nodes[&op] = ops.size();
+      ops.push_back(&op);
+    }
+
+    // Resources of the function, and of the ops of each kind.
+    Estimate total;
+    std::map<std::string, std::pair<unsigned, Estimate>> byKind;
+    for (Operation *op : ops) {
+      std::string key = getCostKey(op);
+      const Cost &cost = getCost(key);
+      unsigned bits = getBitWidth(op);
+      unsigned n = getReplication(op);
+      double tiles = std::ceil(bits / 27.0) * std::ceil(bits / 18.0);
+      Estimate est{n * (cost.lut + cost.lutPerBit * bits),
+                   n * (cost.ff + cost.ffPerBit * bits),
+                   cost.dsp + cost.dspPerTile * tiles};
+      total.luts += est.luts;
+      total.ffs += est.ffs;
+      total.dsps += est.dsps;
+      auto &kind = byKind[key];
+      ++kind.first;
+      kind.second.luts += est.luts;
+      kind.second.ffs += est.ffs;
+      kind.second.dsps += est.dsps;
+    }
+
+    // The arrival time of the results of each op is the latest arrival of
+    // its operands, plus its delay. Sequential ops start a new path, and a
+    // cycle without any sequential op, as in unbuffered IR, is cut where it is
+    // found.
+    enum class Visit { New, Active, Done };
+    SmallVector<Visit> state(ops.size(), Visit::New);
+    SmallVector<double> arrival(ops.size(), 0.0);
+    SmallVector<int64_t> pred(ops.size(), -1);
+    for (unsigned root = 0; root < ops.size(); ++root) {
+      if (state[root] != Visit::New)
+        continue;
+      SmallVector<std::pair<unsigned, unsigned>> stack = {{root, 0}};
+      state[root] = Visit::Active;
+      while (!stack.empty()) {
+        unsigned node = stack.back().first;
+        Operation *op = ops[node];
+        unsigned next = stack.back().second++;
+        if (next < op->getNumOperands()) {
+          Operation *def = op->getOperand(next).getDefiningOp();
+          auto it = def ? nodes.find(def) : nodes.end();
+          if (it != nodes.end() && !isSequential(def) &&
+              state[it->second] == Visit::New) {
+            state[it->second] = Visit::Active;
+            stack.push_back({it->second, 0});
+          }
+          continue;
+        }
+        stack.pop_back();
+        state[node] = Visit::Done;
+        double in = 0;
+        for (Value operand : op->getOperands()) {
+          Operation *def = operand.getDefiningOp();
+          auto it = def ? nodes.find(def) : nodes.end();
+          if (it == nodes.end() || state[it->second] != Visit::Done ||
+              isSequential(def))
+            continue;
+          if (arrival[it->second] > in) {
+            in = arrival[it->second];
+            pred[node] = it->second;
+          }
+        }
+        const Cost &cost = getCost(getCostKey(op));
+        arrival[node] = in + cost.delay + cost.delayPerBit * getBitWidth(op);
+      }
+    }
+
+    // The critical path ends at the op of the latest arrival.
+    double delay = 0;
+    SmallVector<std::string> path;
+    if (!ops.empty()) {
+      unsigned end = std::max_element(arrival.begin(), arrival.end()) -
+                     arrival.begin();
+      delay = arrival[end];
+      for (int64_t node = end; node >= 0; node = pred[node])
+        path.push_back(getOpName(ops[node], node));
+      std::reverse(path.begin(), path.end());
+    }
+
+    if (reportFile.empty()) {
+      std::string names;
+      llvm::raw_string_ostream os(names);
+      llvm::interleaveComma(path, os);
+      f.emitRemark() << "estimated " << std::lround(total.luts) << " LUTs, "
+                     << std::lround(total.ffs) << " registers, "
+                     << std::lround(total.dsps) << " DSPs and a critical path "
+                     << llvm::formatv("of {0:f2} ns", delay).str()
+                     << ", through: " << os.str();
+      return;
+    }
+    if (failed(writeReport(f, total, delay, path, byKind)))
+      signalPassFailure();
+  }
+
+private:
+  /// Returns the cost of ops of 'key'.
+  const Cost &getCost(StringRef key) {
+    auto it = costs.find(key);
+    return it != costs.end() ? it->second : costs["*"];
+  }
+
+  /// Reads the costs of the 'costs' file, which override the default costs,
+  /// as a JSON object of the cost of each op key (see Cost).
+  LogicalResult readCosts(handshake::FuncOp f);
+
+  /// Writes the estimate of 'f' to the 'report' file.
+  LogicalResult
+  writeReport(handshake::FuncOp f, const Estimate &total, double delay,
+              ArrayRef<std::string> path,
+              const std::map<std::string, std::pair<unsigned, Estimate>> &ops);
+
+  llvm::StringMap<Cost> costs;
+};
+
+LogicalResult EstimateResourcesPass::readCosts(handshake::FuncOp f) {
+  auto buf = llvm::MemoryBuffer::getFile(costsFile);
+  if (!buf)
+    return f.emitError() << "could not read cost table '" << costsFile
+                         << "': " << buf.getError().message();
+
+  auto json = llvm::json::parse((*buf)->getBuffer());
+  if (!json)
+    return f.emitError() << "could not parse cost table '" << costsFile
+                         << "': " << llvm::toString(json.takeError());
+
+  auto *root = json->getAsObject();
+  if (!root)
+    return f.emitError() << "expected cost table '" << costsFile
+                         << "' to be an object of the cost of each op";
+  for (auto &entry : *root) {
+    auto *fields = entry.second.getAsObject();
+    if (!fields)
+      return f.emitError() << "expected the cost of '" << entry.first
+                           << "' in '" << costsFile << "' to be an object";
+    // Fields which are not given are 0.
+    Cost cost;
+    std::pair<const char *, double *> names[] = {
+        {"lut", &cost.lut},
+        {"lutPerBit", &cost.lutPerBit},
+        {"ff", &cost.ff},
+        {"ffPerBit", &cost.ffPerBit},
+        {"dsp", &cost.dsp},
+        {"dspPerTile", &cost.dspPerTile},
+        {"delay", &cost.delay},
+        {"delayPerBit", &cost.delayPerBit}};
+    for (auto &field : *fields) {
+      auto *it = llvm::find_if(
+          names, [&](auto &name) { return field.first == name.first; });
+      auto value = field.second.getAsNumber();
+      if (it == std::end(names) || !value)
+        return f.emitError() << "unexpected field '" << field.first
+                             << "' in the cost of '" << entry.first
+                             << "' in '" << costsFile << "'";
+      *it->second = *value;
+    }
+    costs[entry.first.str()] = cost;
+  }
+  return success();
+}
+
+LogicalResult EstimateResourcesPass::writeReport(
+    handshake::FuncOp f, const Estimate &total, double delay,
+    ArrayRef<std::string> path,
+    const std::map<std::string, std::pair<unsigned, Estimate>> &ops) {
+  std::string error;
+  auto output = openOutputFile(reportFile, &error);
+  if (!output)
+    return f.emitError() << "could not write estimate to '" << reportFile
+                         << "': " << error;
+
+  llvm::json::Object byKind;
+  for (auto &it : ops)
+    byKind[it.first] = llvm::json::Object{{"count", it.second.first},
+                                          {"luts", it.second.second.luts},
+                                          {"ffs", it.second.second.ffs},
+                                          {"dsps", it.second.second.dsps}};
+  llvm::json::Object report{
+      {"function", f.getName()},
+      {"luts", total.luts},
+      {"ffs", total.ffs},
+      {"dsps", total.dsps},
+      {"delay", delay},
+      {"path", llvm::json::Array(path)},
+      {"ops", std::move(byKind)}};
+  output->os() << llvm::formatv("{0:2}",
+                                llvm::json::Value(std::move(report)))
+               << "\n";
+  output->keep();
+  return success();
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createEstimateResourcesPass() {
+  return std::make_unique<EstimateResourcesPass>();
+}
+} // namespace circt_hls
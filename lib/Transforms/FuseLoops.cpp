@@ -0,0 +1,237 @@
+//===- FuseLoops.cpp - Producer/consumer loop fusion -------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Fuses the top-level affine loop nests of a kernel which produce a memref
+// into the nests which consume it, such that the kernel computes the phases
+// of the consumer and producer in a single dataflow, and shrinks the local
+// memrefs which are then only accessed within a slice of the fused nest.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Dialect/Affine/Analysis/Utils.h"
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Affine/LoopFusionUtils.h"
+#include "mlir/Dialect/Affine/LoopUtils.h"
+#include "mlir/Dialect/Affine/Utils.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/IR/Builders.h"
+#include "llvm/ADT/SetVector.h"
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+/// Returns true if 'op', or any op nested within it, has any of 'memrefs' as
+/// an operand.
+static bool usesAnyMemRef(Operation *op,
+                          const SmallPtrSetImpl<Value> &memrefs) {
+  auto walkRes = op->walk([&](Operation *nested) {
+    if (llvm::any_of(nested->getOperands(),
+                     [&](Value v) { return memrefs.contains(v); }))
+      return WalkResult::interrupt();
+    return WalkResult::advance();
+  });
+  return walkRes.wasInterrupted();
+}
+
+namespace {
+
+struct FuseLoopsPass : public FuseLoopsBase<FuseLoopsPass> {
+public:
+  void runOnOperation() override {
+    FuncOp f = getOperation();
+    if (f.isExternal())
+      return;
+
+    // Fuse each consumer with its nearest producer first, and restart after
+    // each fusion, since the fused nest may in turn consume an earlier nest.
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      SmallVector<AffineForOp> nests(
+          f.getBody().front().getOps<AffineForOp>());
+      for (unsigned dst = 1; dst < nests.size() && !changed; ++dst)
+        for (unsigned src = dst; src-- > 0 && !changed;)
+          changed = fuse(nests[src], nests[dst]);
+    }
+  }
+
+private:
+  /// Fuses 'srcForOp' into 'dstForOp', which reads a memref written by
+  /// 'srcForOp', and erases 'srcForOp'. Returns true if the nests were fused.
+  bool fuse(AffineForOp srcForOp, AffineForOp dstForOp);
+
+  /// Shrinks each local memref of 'memrefs' which is only accessed within the
+  /// slice of 'forOp' at 'depth' to the elements which each iteration of the
+  /// slice accesses.
+  void privatize(AffineForOp forOp, unsigned depth, ArrayRef<Value> memrefs);
+};
+
+bool FuseLoopsPass::fuse(AffineForOp srcForOp, AffineForOp dstForOp) {
+  if (srcForOp.getNumResults() != 0)
+    return false;
+  // The memrefs which 'srcForOp' writes to, and which outlive it.
+  llvm::SetVector<Value> writtenMemRefs;
+  SmallPtrSet<Value, 4> srcMemRefs;
+  srcForOp.walk([&](Operation *op) {
+    if (auto writeOp = dyn_cast<AffineWriteOpInterface>(op))
+      if (!srcForOp.getRegion().isAncestor(
+              writeOp.getMemRef().getParentRegion()))
+        writtenMemRefs.insert(writeOp.getMemRef());
+    for (Value operand : op->getOperands())
+      if (operand.getType().isa<MemRefType>())
+        srcMemRefs.insert(operand);
+  });
+  bool consumes = false;
+  dstForOp.walk([&](AffineReadOpInterface readOp) {
+    consumes |= writtenMemRefs.contains(readOp.getMemRef());
+  });
+  if (!consumes)
+    return false;
+
+  // 'srcForOp' is moved past the ops in between the nests, which may thus not
+  // access any of its memrefs.
+  for (Operation *op = srcForOp->getNextNode(); op != dstForOp;
+       op = op->getNextNode())
+    if (usesAnyMemRef(op, srcMemRefs))
+      return false;
+
+  LoopNestStats srcStats, dstStats;
+  if (!getLoopNestStats(srcForOp, &srcStats) ||
+      !getLoopNestStats(dstForOp, &dstStats))
+    return false;
+  int64_t unfusedCost = getComputeCost(srcForOp, srcStats) +
+                        getComputeCost(dstForOp, dstStats);
+
+  // Fuse at the deepest depth at which the slice of 'srcForOp' covers all of
+  // its iterations, such that 'srcForOp' can be erased, and computes each of
+  // them only once.
+  SmallVector<AffineForOp> dstLoops;
+  getPerfectlyNestedLoops(dstLoops, dstForOp);
+  for (unsigned depth = dstLoops.size(); depth > 0; --depth) {
+    ComputationSliceState slice;
+    if (canFuseLoops(srcForOp, dstForOp, depth, &slice,
+                     FusionStrategy::ProducerConsumer)
+            .value != FusionResult::Success)
+      continue;
+    Optional<bool> isMaximal = slice.isMaximal();
+    int64_t fusedCost;
+    if (!isMaximal || !*isMaximal ||
+        !getFusionComputeCost(srcForOp, srcStats, dstForOp, dstStats, slice,
+                              &fusedCost) ||
+        fusedCost > unfusedCost)
+      continue;
+    fuseLoops(srcForOp, dstForOp, slice);
+    srcForOp.erase();
+    ++numFused;
+    privatize(dstForOp, depth, writtenMemRefs.getArrayRef());
+    return true;
+  }
+  return false;
+}
+
+void FuseLoopsPass::privatize(AffineForOp forOp, unsigned depth,
+                              ArrayRef<Value> memrefs) {
+  for (Value memref : memrefs) {
+    Operation *allocOp = memref.getDefiningOp();
+    if (!allocOp || !isa<memref::AllocOp, memref::AllocaOp>(allocOp))
+      continue;
+
+    // Each access must be an affine access within 'forOp'.
+    SmallVector<Operation *> accesses;
+    bool isPrivatizable = true;
+    for (Operation *user : memref.getUsers()) {
+      if (isa<memref::DeallocOp>(user))
+        continue;
+      if (!isa<AffineReadOpInterface, AffineWriteOpInterface>(user) ||
+          MemRefAccess(user).memref != memref ||
+          !forOp->isProperAncestor(user)) {
+        isPrivatizable = false;
+        break;
+      }
+      accesses.push_back(user);
+    }
+    if (!isPrivatizable || accesses.empty())
+      continue;
+
+    // Bound the elements accessed within an iteration of the outer 'depth'
+    // loops of 'forOp', which the bounds are symbolic in.
+    MemRefRegion region(allocOp->getLoc());
+    if (failed(region.compute(accesses.front(), depth)))
+      continue;
+    for (Operation *access : llvm::drop_begin(accesses)) {
+      MemRefRegion accessRegion(allocOp->getLoc());
+      if (failed(accessRegion.compute(access, depth)) ||
+          failed(region.unionBoundingBox(accessRegion))) {
+        isPrivatizable = false;
+        break;
+      }
+    }
+    if (!isPrivatizable)
+      continue;
+    auto memrefType = memref.getType().cast<MemRefType>();
+    SmallVector<int64_t> shape;
+    std::vector<SmallVector<int64_t, 4>> lbs;
+    SmallVector<int64_t> lbDivisors;
+    Optional<int64_t> numElements =
+        region.getConstantBoundingSizeAndShape(&shape, &lbs, &lbDivisors);
+    if (!numElements || !memrefType.hasStaticShape() ||
+        *numElements >= memrefType.getNumElements())
+      continue;
+
+    // Offset each index by the lower bound of its dimension, in terms of the
+    // outer induction variables.
+    const FlatAffineValueConstraints *cst = region.getConstraints();
+    unsigned rank = memrefType.getRank();
+    SmallVector<Value> outerIVs;
+    cst->getValues(rank, cst->getNumVars(), &outerIVs);
+    OpBuilder builder(allocOp);
+    SmallVector<AffineExpr> remapExprs;
+    for (unsigned d = 0; d < rank; ++d) {
+      AffineExpr offset = builder.getAffineConstantExpr(0);
+      for (unsigned j = 0, e = cst->getNumCols() - rank - 1; j < e; ++j)
+        offset = offset + lbs[d][j] * builder.getAffineDimExpr(j);
+      offset = (offset + lbs[d][cst->getNumCols() - 1 - rank])
+                   .floorDiv(lbDivisors[d]);
+      remapExprs.push_back(simplifyAffineExpr(
+          builder.getAffineDimExpr(outerIVs.size() + d) - offset,
+          outerIVs.size() + rank, 0));
+    }
+    auto indexRemap = AffineMap::get(outerIVs.size() + rank, 0, remapExprs,
+                                     &getContext());
+
+    auto privateType = MemRefType::get(shape, memrefType.getElementType());
+    Value privateMemRef =
+        isa<memref::AllocOp>(allocOp)
+            ? builder.create<memref::AllocOp>(allocOp->getLoc(), privateType)
+                  .getResult()
+            : builder.create<memref::AllocaOp>(allocOp->getLoc(), privateType)
+                  .getResult();
+    if (failed(replaceAllMemRefUsesWith(
+            memref, privateMemRef, /*extraIndices=*/{}, indexRemap,
+            /*extraOperands=*/outerIVs, /*symbolOperands=*/{},
+            /*domOpFilter=*/nullptr, /*postDomOpFilter=*/nullptr,
+            /*allowNonDereferencingOps=*/false,
+            /*replaceInDeallocOp=*/true))) {
+      privateMemRef.getDefiningOp()->erase();
+      continue;
+    }
+    allocOp->erase();
+    ++numPrivatized;
+  }
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createFuseLoopsPass() {
+  return std::make_unique<FuseLoopsPass>();
+}
+} // namespace circt_hls
@@ -0,0 +1,161 @@
+//===- IfConvert.cpp - If-conversion of short branches -----------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Converts the diamonds and triangles of a CFG whose branches are short and
+// free of side effects into straight-line code, which computes both branches
+// and selects between their values.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/ControlFlow/IR/ControlFlowOps.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+/// Returns the number of operations of 'block', except for its terminator, if
+/// all of them may be executed unconditionally: they must be free of memory
+/// effects, and may not trap.
+static Optional<unsigned> getNumSpeculatedOps(Block *block) {
+  unsigned numOps = 0;
+  for (Operation &op : block->without_terminator()) {
+    if (op.getNumRegions() != 0 || !isMemoryEffectFree(&op) ||
+        !isSpeculatable(&op))
+      return {};
+    ++numOps;
+  }
+  return numOps;
+}
+
+namespace {
+
+struct IfConvertPass : public IfConvertBase<IfConvertPass> {
+public:
+  void runOnOperation() override {
+    // Converting an inner diamond may make an enclosing one convertible;
+    // iterate until no diamond is converted.
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (Block &block : getOperation().getBody()) {
+        if (convert(&block)) {
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+
+private:
+  /// Returns the block which 'dest', a successor of 'block', branches to, if
+  /// 'dest' is a side of a diamond which may be speculated. Accumulates the
+  /// number of speculated operations in 'numOps'.
+  Block *getSideSuccessor(Block *block, Block *dest, unsigned &numOps);
+
+  /// If-converts the diamond or triangle which the conditional branch of
+  /// 'block' starts. Returns true if the CFG was changed.
+  bool convert(Block *block);
+};
+
+Block *IfConvertPass::getSideSuccessor(Block *block, Block *dest,
+                                       unsigned &numOps) {
+  if (dest == block || dest->getSinglePredecessor() != block)
+    return nullptr;
+  auto brOp = dyn_cast<cf::BranchOp>(dest->getTerminator());
+  if (!brOp)
+    return nullptr;
+  auto destOps = getNumSpeculatedOps(dest);
+  if (!destOps)
+    return nullptr;
+  numOps += *destOps;
+  return brOp.getDest();
+}
+
+bool IfConvertPass::convert(Block *block) {
+  auto condBrOp = dyn_cast<cf::CondBranchOp>(block->getTerminator());
+  if (!condBrOp)
+    return false;
+  Block *trueDest = condBrOp.getTrueDest();
+  Block *falseDest = condBrOp.getFalseDest();
+  if (trueDest == falseDest)
+    return false;
+
+  // Find the block which both sides merge into; a side is either a block of
+  // its own, or the edge from 'block' to the merge block (a triangle).
+  unsigned numOps = 0;
+  Block *trueSucc = getSideSuccessor(block, trueDest, numOps);
+  Block *falseSucc = getSideSuccessor(block, falseDest, numOps);
+  Block *merge;
+  if (trueSucc && trueSucc == falseSucc)
+    merge = trueSucc;
+  else if (trueSucc && trueSucc == falseDest)
+    merge = falseDest;
+  else if (falseSucc && falseSucc == trueDest)
+    merge = trueDest;
+  else
+    return false;
+  if (merge == block || numOps > maxOps ||
+      std::distance(merge->pred_begin(), merge->pred_end()) != 2)
+    return false;
+
+  // Move the operations of each side before the branch, and collect the
+  // values which it forwards to the merge block.
+  auto speculate = [&](Block *dest, OperandRange destOperands) {
+    if (dest == merge)
+      return SmallVector<Value>(destOperands);
+    for (auto [arg, operand] : llvm::zip(dest->getArguments(), destOperands))
+      arg.replaceAllUsesWith(operand);
+    auto brOp = cast<cf::BranchOp>(dest->getTerminator());
+    SmallVector<Value> values(brOp.getDestOperands());
+    block->getOperations().splice(Block::iterator(condBrOp),
+                                  dest->getOperations(), dest->begin(),
+                                  Block::iterator(brOp));
+    return values;
+  };
+  SmallVector<Value> trueValues =
+      speculate(trueDest, condBrOp.getTrueDestOperands());
+  SmallVector<Value> falseValues =
+      speculate(falseDest, condBrOp.getFalseDestOperands());
+
+  OpBuilder builder(condBrOp);
+  Value cond = condBrOp.getCondition();
+  SmallVector<Value> mergeValues;
+  for (auto [trueValue, falseValue] : llvm::zip(trueValues, falseValues)) {
+    if (trueValue == falseValue)
+      mergeValues.push_back(trueValue);
+    else
+      mergeValues.push_back(builder.create<arith::SelectOp>(
+          condBrOp.getLoc(), cond, trueValue, falseValue));
+  }
+
+  // Erase the sides, and merge the merge block into 'block', of which it is
+  // now the only successor.
+  condBrOp.erase();
+  for (Block *dest : {trueDest, falseDest})
+    if (dest != merge)
+      dest->erase();
+  for (auto [arg, value] : llvm::zip(merge->getArguments(), mergeValues))
+    arg.replaceAllUsesWith(value);
+  block->getOperations().splice(block->end(), merge->getOperations());
+  merge->erase();
+  ++numConverted;
+  return true;
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createIfConvertPass() {
+  return std::make_unique<IfConvertPass>();
+}
+} // namespace circt_hls
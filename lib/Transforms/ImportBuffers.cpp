@@ -0,0 +1,270 @@
+//===- ImportBuffers.cpp - Dynamatic buffer placement import -----*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Places buffers in a handshake function following the buffer placement of a
+// Dynamatic circuit of the same kernel, by matching the channels of both
+// circuits through their structure.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "circt/Dialect/Handshake/HandshakeOps.h"
+#include "mlir/IR/Builders.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <algorithm>
+
+using namespace mlir;
+using namespace circt;
+using namespace circt_hls;
+
+namespace {
+
+/// The structural keys of a channel of a Dynamatic buffer, from the shallowest,
+/// and the number of channels of the Dynamatic circuit which share each.
+struct PlacedChannel {
+  SmallVector<std::pair<std::string, int64_t>> keys;
+};
+
+struct PlacedBuffer {
+  int64_t slots;
+  bool transparent;
+  SmallVector<PlacedChannel> channels;
+};
+
+/// The buffer of a channel of the function, which merges the Dynamatic
+/// buffers that were matched to the channel.
+struct ChannelBuffer {
+  int64_t slots = 0;
+  bool transparent = true;
+};
+
+/// Computes the structural keys of the channels of a handshake function, as
+/// DynamaticParser.py does for the channels of a Dynamatic circuit (see
+/// getChannelKeys). A channel runs from the result of a source op to the
+/// operand of a sink op, through any forks and buffers. Its key at depth 'd'
+/// names the source op and its producers up to depth 'd', the source result,
+/// and the sink op and operand.
+class ChannelKeys {
+public:
+  static bool isThrough(Operation *op) {
+    return isa_and_nonnull<handshake::ForkOp, handshake::BufferOp>(op);
+  }
+
+  /// Returns the source value of the channel which drives 'v'.
+  static Value getSource(Value v) {
+    while (isThrough(v.getDefiningOp()))
+      v = v.getDefiningOp()->getOperand(0);
+    return v;
+  }
+
+  std::string getKey(Operation *sink, unsigned operand, unsigned depth) {
+    Value source = getSource(sink->getOperand(operand));
+    unsigned result = 0;
+    if (auto res = source.dyn_cast<OpResult>())
+      result = res.getResultNumber();
+    return getSignature(source, depth) + "#" + std::to_string(result) + "->" +
+           sink->getName().getStringRef().str() + "#" +
+           std::to_string(operand);
+  }
+
+private:
+  std::string getSignature(Value source, unsigned depth) {
+    Operation *op = source.getDefiningOp();
+    std::pair<const void *, unsigned> key = {
+        op ? static_cast<const void *>(op) : source.getAsOpaquePointer(),
+        depth};
+    auto it = signatures.find(key);
+    if (it != signatures.end())
+      return it->second;
+    std::string result =
+        op ? op->getName().getStringRef().str() : std::string("arg");
+    if (depth > 0) {
+      result += "(";
+      if (op)
+        llvm::interleave(
+            op->getOperands(),
+            [&](Value v) { result += getSignature(getSource(v), depth - 1); },
+            [&]() { result += ","; });
+      result += ")";
+    }
+    signatures[key] = result;
+    return result;
+  }
+
+  DenseMap<std::pair<const void *, unsigned>, std::string> signatures;
+};
+
+struct ImportBuffersPass : public ImportBuffersBase<ImportBuffersPass> {
+public:
+  void runOnOperation() override {
+    handshake::FuncOp f = getOperation();
+
+    SmallVector<PlacedBuffer> buffers;
+    if (failed(readPlacement(f, buffers)))
+      return signalPassFailure();
+    unsigned maxDepth = 0;
+    for (auto &buffer : buffers)
+      for (auto &channel : buffer.channels)
+        maxDepth = std::max<unsigned>(maxDepth, channel.keys.size());
+
+    // The keys of each channel of the function, at each depth.
+    ChannelKeys channelKeys;
+    SmallVector<llvm::StringMap<SmallVector<OpOperand *, 1>>> channels(
+        maxDepth);
+    f.walk([&](Operation *op) {
+      if (ChannelKeys::isThrough(op))
+        return;
+      for (OpOperand &operand : op->getOpOperands())
+        for (unsigned d = 0; d < maxDepth; ++d)
+          channels[d][channelKeys.getKey(op, operand.getOperandNumber(), d)]
+              .push_back(&operand);
+    });
+
+    // Each channel of a Dynamatic buffer is matched at the shallowest depth at
+    // which its key is unique in both circuits. The buffers of a channel are
+    // merged into a single buffer of all their slots, which is transparent
+    // only if all of them are.
+    llvm::MapVector<OpOperand *, ChannelBuffer> placed;
+    for (auto &buffer : buffers) {
+      bool imported = false;
+      for (auto &channel : buffer.channels) {
+        OpOperand *match = nullptr;
+        for (auto it : llvm::enumerate(channel.keys)) {
+          auto [key, count] = it.value();
+          if (count != 1)
+            continue;
+          auto found = channels[it.index()].find(key);
+          if (found != channels[it.index()].end() &&
+              found->second.size() == 1) {
+            match = found->second.front();
+            break;
+          }
+        }
+        if (!match) {
+          ++numUnmatched;
+          continue;
+        }
+        ChannelBuffer &channelBuffer = placed[match];
+        channelBuffer.slots += buffer.slots;
+        channelBuffer.transparent &= buffer.transparent;
+        imported = true;
+      }
+      if (imported)
+        ++numImported;
+    }
+
+    // Buffers which are created are given IDs following those of the existing
+    // buffers, such that instance names remain unique.
+    int64_t nextBufferId = 0;
+    bool hasIds = false;
+    f.walk([&](handshake::BufferOp bufferOp) {
+      if (auto idAttr = bufferOp->getAttrOfType<IntegerAttr>("handshake_id")) {
+        nextBufferId = std::max(nextBufferId, idAttr.getInt() + 1);
+        hasIds = true;
+      }
+    });
+
+    OpBuilder builder(f.getContext());
+    for (auto &[operand, channelBuffer] : placed) {
+      Value value = operand->get();
+      unsigned slots = std::max<int64_t>(channelBuffer.slots, 1);
+
+      // A channel which is already buffered keeps its buffer, which is grown
+      // to the slots of the Dynamatic buffers.
+      auto bufferOp = value.getDefiningOp<handshake::BufferOp>();
+      if (bufferOp && value.hasOneUse()) {
+        slots = std::max<unsigned>(bufferOp.getNumSlots(), slots);
+        bufferOp->setAttr("slots", builder.getI32IntegerAttr(slots));
+        continue;
+      }
+
+      auto bufferType = channelBuffer.transparent
+                            ? handshake::BufferTypeEnum::fifo
+                            : handshake::BufferTypeEnum::seq;
+      builder.setInsertionPointAfterValue(value);
+      bufferOp = builder.create<handshake::BufferOp>(value.getLoc(), value,
+                                                     slots, bufferType);
+      if (hasIds)
+        bufferOp->setAttr("handshake_id",
+                          builder.getI64IntegerAttr(nextBufferId++));
+      operand->set(bufferOp.getResult());
+    }
+  }
+
+private:
+  /// Reads the buffer placement written by DynamaticParser.py --buffers from
+  /// the 'placement' file.
+  LogicalResult readPlacement(handshake::FuncOp f,
+                              SmallVectorImpl<PlacedBuffer> &buffers);
+};
+
+LogicalResult
+ImportBuffersPass::readPlacement(handshake::FuncOp f,
+                                 SmallVectorImpl<PlacedBuffer> &buffers) {
+  auto buf = llvm::MemoryBuffer::getFile(placement);
+  if (!buf)
+    return f.emitError() << "could not read buffer placement '" << placement
+                         << "': " << buf.getError().message();
+
+  auto json = llvm::json::parse((*buf)->getBuffer());
+  if (!json)
+    return f.emitError() << "could not parse buffer placement '" << placement
+                         << "': " << llvm::toString(json.takeError());
+
+  auto *root = json->getAsObject();
+  if (!root || !root->getArray("buffers"))
+    return f.emitError() << "expected buffer placement '" << placement
+                         << "' to contain 'buffers'";
+
+  auto malformed = [&]() {
+    return f.emitError() << "expected each buffer of placement '" << placement
+                         << "' to have 'slots', 'transparent' and 'channels' "
+                            "of [key, count] pairs";
+  };
+  for (auto &bufferValue : *root->getArray("buffers")) {
+    auto *buffer = bufferValue.getAsObject();
+    if (!buffer)
+      return malformed();
+    auto slots = buffer->getInteger("slots");
+    auto transparent = buffer->getBoolean("transparent");
+    auto *channels = buffer->getArray("channels");
+    if (!slots || !transparent || !channels)
+      return malformed();
+    PlacedBuffer &placed = buffers.emplace_back();
+    placed.slots = *slots;
+    placed.transparent = *transparent;
+    for (auto &channelValue : *channels) {
+      auto *channel = channelValue.getAsObject();
+      auto *keys = channel ? channel->getArray("keys") : nullptr;
+      if (!keys)
+        return malformed();
+      PlacedChannel &placedChannel = placed.channels.emplace_back();
+      for (auto &keyValue : *keys) {
+        auto *pair = keyValue.getAsArray();
+        if (!pair || pair->size() != 2 || !(*pair)[0].getAsString() ||
+            !(*pair)[1].getAsInteger())
+          return malformed();
+        placedChannel.keys.emplace_back((*pair)[0].getAsString()->str(),
+                                        *(*pair)[1].getAsInteger());
+      }
+    }
+  }
+  return success();
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createImportBuffersPass() {
+  return std::make_unique<ImportBuffersPass>();
+}
+} // namespace circt_hls
@@ -0,0 +1,124 @@
+//===- InferStreams.cpp - Streamed memref inference --------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Marks the memref arguments of kernel functions which are accessed in a
+// single, sequential pass, such that the HLT wrapper streams them between the
+// host and the kernel rather than serving them as random access memories.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/BuiltinTypes.h"
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+// Unit attribute on each memref argument which is streamed (see
+// HandshakeVerilatorWrapper).
+static constexpr StringLiteral kStreamAttr = "hlt.stream";
+
+/// Returns the loops which enclose 'op' within its function, outermost first,
+/// if all of them are affine.for loops which execute their iterations
+/// unconditionally.
+static Optional<SmallVector<AffineForOp>> getEnclosingLoops(Operation *op) {
+  SmallVector<AffineForOp> loops;
+  for (Operation *parent = op->getParentOp(); !isa<FuncOp>(parent);
+       parent = parent->getParentOp()) {
+    auto forOp = dyn_cast<AffineForOp>(parent);
+    if (!forOp)
+      return {};
+    loops.push_back(forOp);
+  }
+  std::reverse(loops.begin(), loops.end());
+  return loops;
+}
+
+/// Returns true if 'access' visits every element of its memref exactly once,
+/// in row-major order: it must be enclosed by exactly one loop for each
+/// dimension of the memref, from 0 to the size of the dimension in unit steps,
+/// and index each dimension by the induction variable of its loop.
+static bool isSequentialAccess(Operation *access, AffineMap map,
+                               ValueRange mapOperands, MemRefType memrefType) {
+  auto loops = getEnclosingLoops(access);
+  if (!loops || loops->size() != static_cast<size_t>(memrefType.getRank()))
+    return false;
+  for (auto it : llvm::enumerate(*loops)) {
+    AffineForOp forOp = it.value();
+    if (!forOp.hasConstantBounds() || forOp.getConstantLowerBound() != 0 ||
+        forOp.getConstantUpperBound() != memrefType.getDimSize(it.index()) ||
+        forOp.getStep() != 1)
+      return false;
+    auto dimExpr = map.getResult(it.index()).dyn_cast<AffineDimExpr>();
+    if (!dimExpr ||
+        mapOperands[dimExpr.getPosition()] != forOp.getInductionVar())
+      return false;
+  }
+  return true;
+}
+
+namespace {
+
+struct InferStreamsPass : public InferStreamsBase<InferStreamsPass> {
+public:
+  void runOnOperation() override {
+    // Only kernel functions are called by the host, which streams their
+    // arguments.
+    for (auto f : getOperation().getOps<FuncOp>()) {
+      if (f.isExternal() ||
+          !SymbolTable::symbolKnownUseEmpty(f, getOperation()))
+        continue;
+      for (unsigned i = 0; i < f.getNumArguments(); ++i) {
+        if (isStreamable(f, i)) {
+          f.setArgAttr(i, kStreamAttr, UnitAttr::get(&getContext()));
+          ++numStreams;
+        }
+      }
+    }
+  }
+
+private:
+  /// Returns true if the memref argument 'argIdx' of 'f' is accessed in a
+  /// single, sequential pass, through a single affine load or store.
+  /// Partitioned and vectorized memrefs are served by their own memories, and
+  /// are not streamed.
+  bool isStreamable(FuncOp f, unsigned argIdx);
+};
+
+bool InferStreamsPass::isStreamable(FuncOp f, unsigned argIdx) {
+  Value memref = f.getArgument(argIdx);
+  auto memrefType = memref.getType().dyn_cast<MemRefType>();
+  if (!memrefType || !memrefType.hasStaticShape() ||
+      !memrefType.getLayout().isIdentity() || memrefType.getRank() == 0 ||
+      !memref.hasOneUse() || f.getArgAttr(argIdx, "hlt.partition") ||
+      f.getArgAttr(argIdx, "hlt.vector"))
+    return false;
+
+  // Vector loads and stores access multiple elements at once, and are not
+  // streamed.
+  Operation *user = *memref.getUsers().begin();
+  if (auto loadOp = dyn_cast<AffineLoadOp>(user))
+    return isSequentialAccess(user, loadOp.getAffineMap(),
+                              loadOp.getMapOperands(), memrefType);
+  if (auto storeOp = dyn_cast<AffineStoreOp>(user))
+    return storeOp.getMemRef() == memref &&
+           isSequentialAccess(user, storeOp.getAffineMap(),
+                              storeOp.getMapOperands(), memrefType);
+  return false;
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createInferStreamsPass() {
+  return std::make_unique<InferStreamsPass>();
+}
+} // namespace circt_hls
@@ -11,6 +11,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "PassDetail.h"
+#include "mlir/Analysis/Liveness.h"
 #include "mlir/Dialect/ControlFlow/IR/ControlFlowOps.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
@@ -112,11 +113,17 @@ namespace {
 struct MaxSSAFormConverter {
 public:
   /// An optional filterFn may be provided to dynamically filter out values
-  /// from being converted.
-  MaxSSAFormConverter(ValueFilterCallbackFn filterFn = nullptr)
-      : filterFn(filterFn) {}
+  /// from being converted. If 'useLiveness' is set, functions are converted
+  /// based on the liveness of values rather than by backtracking from each
+  /// use.
+  MaxSSAFormConverter(ValueFilterCallbackFn filterFn = nullptr,
+                      bool useLiveness = false)
+      : filterFn(filterFn), useLiveness(useLiveness) {}
 
   LogicalResult convertFunction(FuncOp function) {
+    if (useLiveness)
+      return convertFunctionWithLiveness(function);
+
     auto walkRes = function.walk([&](Operation *op) {
       // Run on operation results.
       SetVector<Value> visited;
@@ -162,6 +169,12 @@ private:
   /// within their defining block.
   LogicalResult verifyFunction(FuncOp f) const;
 
+  /// Converts 'f' by adding a block argument to each block for each value
+  /// which is live-in to the block. All blocks are rewritten at once, after
+  /// the liveness of the function has been computed, instead of backtracking
+  /// through the CFG for each value.
+  LogicalResult convertFunctionWithLiveness(FuncOp f);
+
   /// Driver which will run backtrackAndConvert on values referenced outside
   /// their defining block. Returns failure in case the pass failed to apply.
   /// This may happen when nested regions exist within the FuncOp which this
@@ -180,6 +193,9 @@ private:
   /// An optional filter function to dynamically determine whether a value
   /// should be considered for SSA maximization.
   ValueFilterCallbackFn filterFn;
+
+  /// Whether to convert functions based on liveness.
+  bool useLiveness;
 };
 
 LogicalResult MaxSSAFormConverter::verifyFunction(FuncOp f) const {
@@ -197,6 +213,88 @@ LogicalResult MaxSSAFormConverter::verifyFunction(FuncOp f) const {
   return success();
 }
 
+LogicalResult MaxSSAFormConverter::convertFunctionWithLiveness(FuncOp f) {
+  Region &body = f.getBody();
+
+  // Number the values of the function by their definition, such that block
+  // arguments are added in a deterministic order.
+  DenseMap<Value, unsigned> valueOrder;
+  for (Block &block : body) {
+    for (Value barg : block.getArguments())
+      valueOrder.try_emplace(barg, valueOrder.size());
+    for (Operation &op : block)
+      for (Value res : op.getResults())
+        valueOrder.try_emplace(res, valueOrder.size());
+  }
+
+  // Gather the values which are live-in to each block before any block
+  // arguments are added.
+  Liveness liveness(f);
+  DenseMap<Block *, SmallVector<Value>> blockLiveIns;
+  for (Block &block : body) {
+    if (block.isEntryBlock())
+      continue;
+    SmallVector<Value> liveIns;
+    for (Value v : liveness.getLiveIn(&block))
+      if (!filterFn || !filterFn(v))
+        liveIns.push_back(v);
+    if (liveIns.empty())
+      continue;
+    llvm::sort(liveIns, [&](Value lhs, Value rhs) {
+      return valueOrder.lookup(lhs) < valueOrder.lookup(rhs);
+    });
+    blockLiveIns[&block] = std::move(liveIns);
+  }
+
+  // Add a block argument for each live-in value, and rewrite the uses of the
+  // value within the block, including those within nested regions.
+  DenseMap<Block *, DenseMap<Value, Value>> blockMappings;
+  for (Block &block : body) {
+    auto liveIns = blockLiveIns.find(&block);
+    if (liveIns == blockLiveIns.end())
+      continue;
+    DenseMap<Value, Value> &mapping = blockMappings[&block];
+    for (Value v : liveIns->second)
+      mapping[v] = block.addArgument(v.getType(), v.getLoc());
+    block.walk([&](Operation *op) {
+      for (OpOperand &operand : op->getOpOperands())
+        if (Value newV = mapping.lookup(operand.get()))
+          operand.set(newV);
+    });
+  }
+
+  // Pass the live-in values of each successor through the terminator. A value
+  // which is live-in to a successor is either defined in, or live-in to, the
+  // predecessor.
+  for (Block &block : body) {
+    Operation *termOp = block.getTerminator();
+    auto mapping = blockMappings.find(&block);
+    for (auto succ : llvm::enumerate(termOp->getSuccessors())) {
+      auto liveIns = blockLiveIns.find(succ.value());
+      if (liveIns == blockLiveIns.end())
+        continue;
+
+      auto branchOp = dyn_cast<BranchOpInterface>(termOp);
+      if (!branchOp)
+        return termOp->emitOpError() << "expected terminator op within "
+                                        "control flow to be a branch-like op";
+
+      SmallVector<Value> operands;
+      for (Value v : liveIns->second) {
+        Value newV;
+        if (mapping != blockMappings.end())
+          newV = mapping->second.lookup(v);
+        operands.push_back(newV ? newV : v);
+      }
+      branchOp.getSuccessorOperands(succ.index()).append(operands);
+    }
+  }
+
+  assert(succeeded(verifyFunction(f)) &&
+         "Some values were still referenced outside of their defining block!");
+  return success();
+}
+
 LogicalResult MaxSSAFormConverter::runOnValue(Value v) {
   if (filterFn && filterFn(v))
     return success();
@@ -224,8 +322,9 @@ LogicalResult MaxSSAFormConverter::runOnValue(Value v) {
 } // namespace
 
 LogicalResult convertToMaximalSSA(FuncOp func,
-                                  ValueFilterCallbackFn filterFn = nullptr) {
-  return MaxSSAFormConverter(filterFn).convertFunction(func);
+                                  ValueFilterCallbackFn filterFn = nullptr,
+                                  bool useLiveness = false) {
+  return MaxSSAFormConverter(filterFn, useLiveness).convertFunction(func);
 }
 
 LogicalResult convertToMaximalSSA(Value value) {
@@ -243,7 +342,7 @@ public:
     if (ignoreMemref)
       filterFn = [&](Value v) { return v.getType().isa<MemRefType>(); };
 
-    if (convertToMaximalSSA(func, filterFn).failed())
+    if (convertToMaximalSSA(func, filterFn, liveness).failed())
       return signalPassFailure();
   }
 };
@@ -0,0 +1,116 @@
+//===- MemRefResultsToArgs.cpp - Memref result conversion --------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Replaces the memref results of kernel functions which are allocated within
+// the kernel by arguments, through which the host provides the memories that
+// the kernel writes its results to.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/BuiltinTypes.h"
+#include "llvm/ADT/BitVector.h"
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+// Dictionary attribute on each result argument, which records the index of
+// the result which it is (see BaseWrapper::getResultArg).
+static constexpr StringLiteral kResultAttr = "hlt.result";
+
+namespace {
+
+struct MemRefResultsToArgsPass
+    : public MemRefResultsToArgsBase<MemRefResultsToArgsPass> {
+public:
+  void runOnOperation() override {
+    // Only kernel functions are called by the host, which provides the
+    // memories of their results.
+    for (auto f : getOperation().getOps<FuncOp>()) {
+      if (f.isExternal() ||
+          !SymbolTable::symbolKnownUseEmpty(f, getOperation()))
+        continue;
+      convert(f);
+    }
+  }
+
+private:
+  /// Returns the allocation of result 'resultIdx' of 'f', if the result is a
+  /// statically shaped, contiguous memref which each return of 'f' returns
+  /// from the same allocation, which is neither deallocated nor returned as
+  /// any other result.
+  memref::AllocOp getResultAlloc(FuncOp f, unsigned resultIdx);
+
+  /// Replaces each memref result of 'f' for which getResultAlloc succeeds by
+  /// an argument, which replaces the allocation.
+  void convert(FuncOp f);
+};
+
+memref::AllocOp MemRefResultsToArgsPass::getResultAlloc(FuncOp f,
+                                                        unsigned resultIdx) {
+  auto memrefType =
+      f.getFunctionType().getResult(resultIdx).dyn_cast<MemRefType>();
+  if (!memrefType || !memrefType.hasStaticShape() ||
+      !memrefType.getLayout().isIdentity())
+    return {};
+
+  memref::AllocOp allocOp;
+  for (auto returnOp : f.getOps<ReturnOp>()) {
+    auto returnedAlloc =
+        returnOp.getOperand(resultIdx).getDefiningOp<memref::AllocOp>();
+    if (!returnedAlloc || (allocOp && returnedAlloc != allocOp))
+      return {};
+    allocOp = returnedAlloc;
+    for (auto it : llvm::enumerate(returnOp.getOperands()))
+      if (it.index() != resultIdx && it.value() == allocOp.getResult())
+        return {};
+  }
+  if (!allocOp || allocOp.getType() != memrefType ||
+      llvm::any_of(allocOp->getUsers(), [](Operation *user) {
+        return isa<memref::DeallocOp>(user);
+      }))
+    return {};
+  return allocOp;
+}
+
+void MemRefResultsToArgsPass::convert(FuncOp f) {
+  OpBuilder builder(&getContext());
+  llvm::BitVector converted(f.getNumResults());
+  for (unsigned i = 0; i < f.getNumResults(); ++i) {
+    memref::AllocOp allocOp = getResultAlloc(f, i);
+    if (!allocOp)
+      continue;
+    auto resultAttr = builder.getDictionaryAttr(
+        builder.getNamedAttr("index", builder.getI64IntegerAttr(i)));
+    auto argAttrs = builder.getDictionaryAttr(
+        builder.getNamedAttr(kResultAttr, resultAttr));
+    unsigned argIdx = f.getNumArguments();
+    f.insertArgument(argIdx, allocOp.getType(), argAttrs, allocOp.getLoc());
+    allocOp.getResult().replaceAllUsesWith(f.getArgument(argIdx));
+    allocOp.erase();
+    converted.set(i);
+    ++numConverted;
+  }
+  if (converted.none())
+    return;
+  for (auto returnOp : f.getOps<ReturnOp>())
+    returnOp->eraseOperands(converted);
+  f.eraseResults(converted);
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createMemRefResultsToArgsPass() {
+  return std::make_unique<MemRefResultsToArgsPass>();
+}
+} // namespace circt_hls
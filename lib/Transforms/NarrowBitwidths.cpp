@@ -0,0 +1,367 @@
+//===- NarrowBitwidths.cpp - Range-based bitwidth narrowing ------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Narrows integer and index arithmetic, loops with constant bounds and block
+// arguments to the smallest width which holds all of their values, as given by
+// the integer range analysis.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Analysis/DataFlow/DeadCodeAnalysis.h"
+#include "mlir/Analysis/DataFlow/IntegerRangeAnalysis.h"
+#include "mlir/Analysis/DataFlowFramework.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Interfaces/ControlFlowInterfaces.h"
+#include "llvm/ADT/SetVector.h"
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+namespace {
+
+/// A narrowing of a value to 'width' bits, from which the value is recovered
+/// through zero- or sign-extension.
+struct Narrowing {
+  unsigned width;
+  bool isSigned;
+};
+
+} // namespace
+
+/// Returns the number of bits of the integer or index type 'type'.
+static unsigned getWidth(Type type) {
+  if (type.isIndex())
+    return IndexType::kInternalStorageBitWidth;
+  return type.getIntOrFloatBitWidth();
+}
+
+/// Returns the number of bits which hold all values of 'range' as signed, or
+/// as unsigned, values.
+static unsigned getSignedWidth(const ConstantIntRanges &range) {
+  return std::max(range.smin().getMinSignedBits(),
+                  range.smax().getMinSignedBits());
+}
+static unsigned getUnsignedWidth(const ConstantIntRanges &range) {
+  return std::max(range.umax().getActiveBits(), 1U);
+}
+
+/// Returns the range of 'v', if the analysis inferred one.
+static Optional<ConstantIntRanges> getRange(DataFlowSolver &solver, Value v) {
+  if (!v.getType().isSignlessIntOrIndex())
+    return {};
+  auto *lattice = solver.lookupState<dataflow::IntegerValueRangeLattice>(v);
+  if (!lattice || lattice->getValue().isUninitialized())
+    return {};
+  return lattice->getValue().getValue();
+}
+
+/// Returns the narrowing of 'v' to the smallest width which holds all of its
+/// values, if that width is smaller than the width of 'v'. Index values are
+/// recovered through index_cast, and are thus always sign-extended.
+static Optional<Narrowing> getNarrowing(DataFlowSolver &solver, Value v) {
+  auto range = getRange(solver, v);
+  if (!range)
+    return {};
+  unsigned signedWidth = getSignedWidth(*range);
+  unsigned unsignedWidth = getUnsignedWidth(*range);
+  Narrowing narrowing{signedWidth, true};
+  if (!v.getType().isIndex() && unsignedWidth < signedWidth)
+    narrowing = {unsignedWidth, false};
+  if (narrowing.width >= getWidth(v.getType()))
+    return {};
+  return narrowing;
+}
+
+/// Returns the narrowing of the operands of 'cmpOp', if both operands are
+/// narrowed to a smaller width without changing the result of the comparison.
+/// Signed predicates require both operands to fit as signed values, and
+/// unsigned predicates as unsigned values; equality holds for either. Index
+/// operands are truncated just like integers, so their signedness is free.
+static Optional<Narrowing> getCmpNarrowing(DataFlowSolver &solver,
+                                           arith::CmpIOp cmpOp) {
+  auto lhs = getRange(solver, cmpOp.getLhs());
+  auto rhs = getRange(solver, cmpOp.getRhs());
+  if (!lhs || !rhs)
+    return {};
+  unsigned signedWidth = std::max(getSignedWidth(*lhs), getSignedWidth(*rhs));
+  unsigned unsignedWidth =
+      std::max(getUnsignedWidth(*lhs), getUnsignedWidth(*rhs));
+  Narrowing narrowing;
+  switch (cmpOp.getPredicate()) {
+  case arith::CmpIPredicate::eq:
+  case arith::CmpIPredicate::ne:
+    narrowing = unsignedWidth < signedWidth ? Narrowing{unsignedWidth, false}
+                                            : Narrowing{signedWidth, true};
+    break;
+  case arith::CmpIPredicate::slt:
+  case arith::CmpIPredicate::sle:
+  case arith::CmpIPredicate::sgt:
+  case arith::CmpIPredicate::sge:
+    narrowing = {signedWidth, true};
+    break;
+  default:
+    narrowing = {unsignedWidth, false};
+    break;
+  }
+  if (narrowing.width >= getWidth(cmpOp.getLhs().getType()))
+    return {};
+  return narrowing;
+}
+
+/// Returns true if the low bits of the result of 'op' only depend on the low
+/// bits of its operands, such that 'op' may be computed at a smaller width.
+static bool isNarrowable(Operation *op) {
+  return isa<arith::AddIOp, arith::SubIOp, arith::MulIOp, arith::AndIOp,
+             arith::OrIOp, arith::XOrIOp, arith::SelectOp>(op) &&
+         op->getResult(0).getType().isSignlessIntOrIndex();
+}
+
+namespace {
+
+struct NarrowBitwidthsPass : public NarrowBitwidthsBase<NarrowBitwidthsPass> {
+public:
+  void runOnOperation() override;
+
+private:
+  /// Narrows the induction variable of 'forOp' if its bounds and step are
+  /// constant, such that its increment never exceeds the narrowed type.
+  void narrowLoop(scf::ForOp forOp);
+
+  /// Returns 'v', truncated to 'type'. Constants are truncated in place, and
+  /// extensions from 'type' are looked through.
+  Value truncate(OpBuilder &builder, Location loc, Value v, Type type);
+
+  /// Returns 'v', extended to 'type'.
+  Value extend(OpBuilder &builder, Location loc, Value v, Type type,
+               bool isSigned);
+
+  // Casts and constants which may have become unused.
+  llvm::SetVector<Operation *> maybeDead;
+};
+
+void NarrowBitwidthsPass::narrowLoop(scf::ForOp forOp) {
+  if (!forOp.getInductionVar().getType().isIndex())
+    return;
+  auto lb = getConstantIntValue(forOp.getLowerBound());
+  auto ub = getConstantIntValue(forOp.getUpperBound());
+  auto step = getConstantIntValue(forOp.getStep());
+  if (!lb || !ub || !step || *lb < 0 || *step <= 0 || *ub <= *lb)
+    return;
+  // The loop compares values of up to ub - 1 + step to the upper bound.
+  unsigned width =
+      APInt(64, *ub - 1 + *step, /*isSigned=*/true).getMinSignedBits();
+  if (width >= IndexType::kInternalStorageBitWidth)
+    return;
+
+  OpBuilder builder(forOp);
+  Location loc = forOp.getLoc();
+  Type type = builder.getIntegerType(width);
+  auto constant = [&](int64_t value) -> Value {
+    return builder.create<arith::ConstantOp>(
+        loc, builder.getIntegerAttr(type, value));
+  };
+  Value newLb = constant(*lb);
+  Value newUb = constant(*ub);
+  Value newStep = constant(*step);
+  auto newFor = builder.create<scf::ForOp>(loc, newLb, newUb, newStep,
+                                           forOp.getInitArgs());
+  Block *newBody = newFor.getBody();
+  if (!newBody->empty())
+    newBody->back().erase();
+
+  builder.setInsertionPointToStart(newBody);
+  SmallVector<Value> args = {builder.create<arith::IndexCastOp>(
+      loc, forOp.getInductionVar().getType(), newFor.getInductionVar())};
+  llvm::append_range(args, newFor.getRegionIterArgs());
+  newBody->getOperations().splice(newBody->end(),
+                                  forOp.getBody()->getOperations());
+  for (auto [oldArg, newArg] :
+       llvm::zip(forOp.getBody()->getArguments(), args))
+    oldArg.replaceAllUsesWith(newArg);
+  forOp.replaceAllUsesWith(newFor.getResults());
+  for (Value bound :
+       {forOp.getLowerBound(), forOp.getUpperBound(), forOp.getStep()})
+    if (Operation *def = bound.getDefiningOp())
+      maybeDead.insert(def);
+  forOp.erase();
+  ++numLoops;
+}
+
+Value NarrowBitwidthsPass::truncate(OpBuilder &builder, Location loc, Value v,
+                                    Type type) {
+  if (auto constOp = v.getDefiningOp<arith::ConstantOp>()) {
+    maybeDead.insert(constOp);
+    APInt value = constOp.getValue().cast<IntegerAttr>().getValue();
+    return builder.create<arith::ConstantOp>(
+        loc, builder.getIntegerAttr(type, value.trunc(getWidth(type))));
+  }
+  if (Operation *def = v.getDefiningOp()) {
+    if (isa<arith::ExtUIOp, arith::ExtSIOp, arith::IndexCastOp>(def) &&
+        def->getOperand(0).getType() == type) {
+      maybeDead.insert(def);
+      return def->getOperand(0);
+    }
+  }
+  if (v.getType().isIndex())
+    return builder.create<arith::IndexCastOp>(loc, type, v);
+  return builder.create<arith::TruncIOp>(loc, type, v);
+}
+
+Value NarrowBitwidthsPass::extend(OpBuilder &builder, Location loc, Value v,
+                                  Type type, bool isSigned) {
+  Operation *extOp;
+  if (type.isIndex())
+    extOp = builder.create<arith::IndexCastOp>(loc, type, v);
+  else if (isSigned)
+    extOp = builder.create<arith::ExtSIOp>(loc, type, v);
+  else
+    extOp = builder.create<arith::ExtUIOp>(loc, type, v);
+  maybeDead.insert(extOp);
+  return extOp->getResult(0);
+}
+
+void NarrowBitwidthsPass::runOnOperation() {
+  FuncOp f = getOperation();
+  maybeDead.clear();
+
+  // Loops are narrowed first, such that the ranges of their induction
+  // variables are inferred at the narrowed width.
+  SmallVector<scf::ForOp> loops;
+  f.walk([&](scf::ForOp forOp) { loops.push_back(forOp); });
+  for (auto forOp : loops)
+    narrowLoop(forOp);
+
+  DataFlowSolver solver;
+  solver.load<dataflow::DeadCodeAnalysis>();
+  solver.load<dataflow::IntegerRangeAnalysis>();
+  if (failed(solver.initializeAndRun(f)))
+    return signalPassFailure();
+
+  // All narrowings are determined before the IR is modified, since the
+  // analysis refers to the original values.
+  SmallVector<std::pair<Operation *, Narrowing>> ops;
+  f.walk([&](Operation *op) {
+    if (auto cmpOp = dyn_cast<arith::CmpIOp>(op)) {
+      if (auto narrowing = getCmpNarrowing(solver, cmpOp))
+        ops.push_back({op, *narrowing});
+    } else if (isNarrowable(op)) {
+      if (auto narrowing = getNarrowing(solver, op->getResult(0)))
+        ops.push_back({op, *narrowing});
+    }
+  });
+
+  // Block arguments are narrowed if each predecessor forwards a value to
+  // them through a branch.
+  SmallVector<std::pair<BlockArgument, Narrowing>> args;
+  for (Block &block : llvm::drop_begin(f.getBody())) {
+    bool forwarded = llvm::all_of(block.getPredecessors(), [&](Block *pred) {
+      auto branchOp = dyn_cast<BranchOpInterface>(pred->getTerminator());
+      if (!branchOp)
+        return false;
+      for (unsigned i = 0; i < branchOp->getNumSuccessors(); ++i)
+        if (branchOp->getSuccessor(i) == &block &&
+            branchOp.getSuccessorOperands(i).getProducedOperandCount() != 0)
+          return false;
+      return true;
+    });
+    if (!forwarded)
+      continue;
+    for (BlockArgument arg : block.getArguments())
+      if (auto narrowing = getNarrowing(solver, arg))
+        args.push_back({arg, *narrowing});
+  }
+
+  OpBuilder builder(&getContext());
+
+  // Narrow the block arguments, and recover their values at the start of
+  // their blocks. The forwarded values are truncated last, such that they
+  // look through the extensions of narrowed operations.
+  for (auto [arg, narrowing] : args) {
+    Type type = arg.getType();
+    arg.setType(builder.getIntegerType(narrowing.width));
+    builder.setInsertionPointToStart(arg.getOwner());
+    Value ext = extend(builder, arg.getLoc(), arg, type, narrowing.isSigned);
+    arg.replaceAllUsesExcept(ext, ext.getDefiningOp());
+  }
+
+  // Compute the operations at the narrowed width, and recover their results.
+  for (auto [op, narrowing] : ops) {
+    builder.setInsertionPoint(op);
+    Location loc = op->getLoc();
+    Type type = builder.getIntegerType(narrowing.width);
+    SmallVector<Value> operands;
+    for (Value operand : op->getOperands())
+      operands.push_back(operand.getType() == builder.getI1Type()
+                             ? operand
+                             : truncate(builder, loc, operand, type));
+    OperationState state(loc, op->getName());
+    state.addOperands(operands);
+    state.addAttributes(op->getAttrs());
+    Type resultType = op->getResult(0).getType();
+    if (isa<arith::CmpIOp>(op)) {
+      state.addTypes(resultType);
+      op->replaceAllUsesWith(builder.create(state));
+    } else {
+      state.addTypes(type);
+      Value result = builder.create(state)->getResult(0);
+      op->getResult(0).replaceAllUsesWith(
+          extend(builder, loc, result, resultType, narrowing.isSigned));
+    }
+    op->erase();
+    ++numOps;
+  }
+
+  for (auto [arg, narrowing] : args) {
+    for (Block *pred : arg.getOwner()->getPredecessors()) {
+      auto branchOp = cast<BranchOpInterface>(pred->getTerminator());
+      builder.setInsertionPoint(branchOp);
+      for (unsigned i = 0; i < branchOp->getNumSuccessors(); ++i) {
+        if (branchOp->getSuccessor(i) != arg.getOwner())
+          continue;
+        // A predecessor which branches to the block along multiple edges is
+        // visited once per edge.
+        SuccessorOperands operands = branchOp.getSuccessorOperands(i);
+        Value forwarded = operands[arg.getArgNumber()];
+        if (forwarded.getType() == arg.getType())
+          continue;
+        operands.slice(arg.getArgNumber(), 1)
+            .getMutableForwardedOperands()
+            .assign(truncate(builder, branchOp.getLoc(), forwarded,
+                             arg.getType()));
+      }
+    }
+    ++numArgs;
+  }
+
+  // Erase the casts and constants which were looked through.
+  while (!maybeDead.empty()) {
+    Operation *op = maybeDead.pop_back_val();
+    if (!op->use_empty())
+      continue;
+    for (Value operand : op->getOperands())
+      if (Operation *def = operand.getDefiningOp())
+        if (isa<arith::ExtUIOp, arith::ExtSIOp, arith::IndexCastOp,
+                arith::TruncIOp, arith::ConstantOp>(def))
+          maybeDead.insert(def);
+    op->erase();
+  }
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createNarrowBitwidthsPass() {
+  return std::make_unique<NarrowBitwidthsPass>();
+}
+} // namespace circt_hls
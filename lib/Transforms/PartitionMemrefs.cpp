@@ -0,0 +1,624 @@
+//===- PartitionMemrefs.cpp - Memref partitioning ----------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Partitions the memref arguments of kernel functions into multiple memrefs,
+// or vectorizes them and local memrefs into memrefs of wide elements, based on
+// the affine accesses to the memrefs.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/BuiltinTypes.h"
+#include "mlir/Support/MathExtras.h"
+#include "llvm/ADT/SmallBitVector.h"
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+// Attribute on each memref argument resulting from a partitioning. It records
+// how the argument maps onto the memref that it was partitioned from
+// (see BaseWrapper::getPartition and BaseWrapper::getHostArgIndices).
+static constexpr StringLiteral kPartitionAttr = "hlt.partition";
+
+// Attribute on each memref argument resulting from a vectorization. It records
+// the number of elements of the original memref which each element of the
+// argument is made of, and the shape of the original memref.
+static constexpr StringLiteral kVectorAttr = "hlt.vector";
+
+// Attribute on each memref argument which passes a result of the kernel (see
+// MemRefResultsToArgs). The HLT wrapper returns the memory of such an
+// argument to the host as is, so it is neither partitioned nor vectorized.
+static constexpr StringLiteral kResultAttr = "hlt.result";
+
+namespace {
+
+/// A partitioning of dimension 'dim' of a memref into 'factor' banks.
+struct Partitioning {
+  unsigned dim = 0;
+  int64_t factor = 1;
+  bool cyclic = true;
+};
+
+/// The range of values of an operand of an affine access. An operand with an
+/// unknown range may take any value.
+struct OperandRange {
+  bool known = false;
+  int64_t lb = 0;
+  int64_t ub = 0;
+  int64_t step = 1;
+};
+
+/// An affine access to a memref, whose index along the partitioned dimension
+/// is 'cst' + sum(coeffs[i] * operand[i]).
+struct LinearAccess {
+  Operation *op;
+  SmallVector<int64_t> coeffs;
+  SmallVector<OperandRange> ranges;
+  int64_t cst = 0;
+};
+
+} // namespace
+
+/// Accumulates 'scale' * 'expr' into 'coeffs' and 'cst'. Returns failure if
+/// 'expr' is not linear in the dimensions and symbols of its map.
+static LogicalResult getLinearForm(AffineExpr expr, unsigned numDims,
+                                   int64_t scale,
+                                   SmallVectorImpl<int64_t> &coeffs,
+                                   int64_t &cst) {
+  if (auto constExpr = expr.dyn_cast<AffineConstantExpr>()) {
+    cst += scale * constExpr.getValue();
+    return success();
+  }
+  if (auto dimExpr = expr.dyn_cast<AffineDimExpr>()) {
+    coeffs[dimExpr.getPosition()] += scale;
+    return success();
+  }
+  if (auto symExpr = expr.dyn_cast<AffineSymbolExpr>()) {
+    coeffs[numDims + symExpr.getPosition()] += scale;
+    return success();
+  }
+  auto binExpr = expr.cast<AffineBinaryOpExpr>();
+  if (expr.getKind() == AffineExprKind::Add)
+    return success(succeeded(getLinearForm(binExpr.getLHS(), numDims, scale,
+                                           coeffs, cst)) &&
+                   succeeded(getLinearForm(binExpr.getRHS(), numDims, scale,
+                                           coeffs, cst)));
+  if (expr.getKind() == AffineExprKind::Mul) {
+    // Multiplications are canonicalized to have any constant on the RHS.
+    auto rhs = binExpr.getRHS().dyn_cast<AffineConstantExpr>();
+    if (!rhs)
+      return failure();
+    return getLinearForm(binExpr.getLHS(), numDims, scale * rhs.getValue(),
+                         coeffs, cst);
+  }
+  return failure();
+}
+
+/// Returns the range of values which 'v' takes. Constants and the induction
+/// variables of affine loops with constant bounds have known ranges.
+static OperandRange getOperandRange(Value v) {
+  OperandRange range;
+  if (auto cst = getConstantIntValue(v)) {
+    range.known = true;
+    range.lb = range.ub = *cst;
+    return range;
+  }
+  AffineForOp forOp = getForInductionVarOwner(v);
+  if (!forOp || !forOp.hasConstantBounds())
+    return range;
+  range.lb = forOp.getConstantLowerBound();
+  range.step = forOp.getStep();
+  // A loop which doesn't iterate never accesses the memref.
+  int64_t ub = forOp.getConstantUpperBound();
+  if (ub <= range.lb)
+    return range;
+  range.known = true;
+  range.ub = range.lb + (ub - 1 - range.lb) / range.step * range.step;
+  return range;
+}
+
+/// Returns the bank of 'partitioning' which 'access' always accesses, if
+/// any. 'dimSize' is the size of the partitioned dimension.
+static Optional<int64_t> getBank(const LinearAccess &access,
+                                 const Partitioning &partitioning,
+                                 int64_t dimSize) {
+  int64_t factor = partitioning.factor;
+  if (partitioning.cyclic) {
+    // The index modulo the factor must be invariant in each operand: each
+    // operand must change the index by a multiple of the factor.
+    int64_t bank = access.cst;
+    for (auto it : llvm::zip(access.coeffs, access.ranges)) {
+      int64_t coeff = std::get<0>(it);
+      const OperandRange &range = std::get<1>(it);
+      if (coeff == 0)
+        continue;
+      if (range.known && range.lb == range.ub) {
+        bank += coeff * range.lb;
+        continue;
+      }
+      if ((coeff * (range.known ? range.step : 1)) % factor != 0)
+        return {};
+      if (range.known)
+        bank += coeff * range.lb;
+    }
+    return mod(bank, factor);
+  }
+
+  // The index must stay within a single block.
+  int64_t blockSize = dimSize / factor;
+  int64_t min = access.cst, max = access.cst;
+  for (auto it : llvm::zip(access.coeffs, access.ranges)) {
+    int64_t coeff = std::get<0>(it);
+    const OperandRange &range = std::get<1>(it);
+    if (coeff == 0)
+      continue;
+    if (!range.known)
+      return {};
+    min += std::min(coeff * range.lb, coeff * range.ub);
+    max += std::max(coeff * range.lb, coeff * range.ub);
+  }
+  int64_t bank = floorDiv(min, blockSize);
+  if (bank != floorDiv(max, blockSize) || bank < 0 || bank >= factor)
+    return {};
+  return bank;
+}
+
+/// Returns the index along dimension 'dim' of 'map' into bank 'bank' of
+/// 'partitioning'.
+static AffineMap getBankMap(AffineMap map, const Partitioning &partitioning,
+                            int64_t bank, int64_t dimSize) {
+  SmallVector<AffineExpr> results(map.getResults());
+  AffineExpr &index = results[partitioning.dim];
+  if (partitioning.cyclic)
+    index = (index - bank).floorDiv(partitioning.factor);
+  else
+    index = index - bank * (dimSize / partitioning.factor);
+  index = simplifyAffineExpr(index, map.getNumDims(), map.getNumSymbols());
+  return AffineMap::get(map.getNumDims(), map.getNumSymbols(), results,
+                        map.getContext());
+}
+
+/// Returns the linear accesses to 'memref' along 'dim', if all users of
+/// 'memref' are affine accesses with linear indices, or deallocations if
+/// 'allowDeallocs' is set.
+static Optional<SmallVector<LinearAccess>>
+getAccesses(Value memref, unsigned dim, bool allowDeallocs = false) {
+  SmallVector<LinearAccess> accesses;
+  for (Operation *user : memref.getUsers()) {
+    if (allowDeallocs && isa<memref::DeallocOp>(user))
+      continue;
+    AffineMap map;
+    SmallVector<Value> operands;
+    if (auto loadOp = dyn_cast<AffineLoadOp>(user)) {
+      map = loadOp.getAffineMap();
+      operands = loadOp.getMapOperands();
+    } else if (auto storeOp = dyn_cast<AffineStoreOp>(user)) {
+      if (storeOp.getValueToStore() == memref)
+        return {};
+      map = storeOp.getAffineMap();
+      operands = storeOp.getMapOperands();
+    } else {
+      return {};
+    }
+
+    LinearAccess access;
+    access.op = user;
+    access.coeffs.resize(operands.size(), 0);
+    if (failed(getLinearForm(map.getResult(dim), map.getNumDims(), 1,
+                             access.coeffs, access.cst)))
+      return {};
+    for (Value operand : operands)
+      access.ranges.push_back(getOperandRange(operand));
+    accesses.push_back(std::move(access));
+  }
+  return accesses;
+}
+
+namespace {
+
+struct PartitionMemrefsPass
+    : public PartitionMemrefsBase<PartitionMemrefsPass> {
+public:
+  void runOnOperation() override {
+    if (kind != "cyclic" && kind != "block") {
+      getOperation().emitError()
+          << "expected partitioning kind to be \"cyclic\" or \"block\"";
+      return signalPassFailure();
+    }
+
+    // Kernel functions are called by the host rather than from within the
+    // module, so their signatures can be freely changed.
+    for (auto f : getOperation().getOps<FuncOp>()) {
+      if (f.isExternal() ||
+          !SymbolTable::symbolKnownUseEmpty(f, getOperation()))
+        continue;
+      for (unsigned i = f.getNumArguments(); i-- > 0;)
+        partitionArgument(f, i);
+    }
+  }
+
+private:
+  /// Partitions the memref argument 'argIdx' of 'f', if it is only accessed
+  /// through affine loads and stores, each of which can be mapped onto a
+  /// single bank.
+  void partitionArgument(FuncOp f, unsigned argIdx);
+};
+
+void PartitionMemrefsPass::partitionArgument(FuncOp f, unsigned argIdx) {
+  Value memref = f.getArgument(argIdx);
+  auto memrefType = memref.getType().dyn_cast<MemRefType>();
+  if (!memrefType || !memrefType.hasStaticShape() ||
+      !memrefType.getLayout().isIdentity() || memrefType.getRank() == 0 ||
+      memref.use_empty() || f.getArgAttr(argIdx, kVectorAttr) ||
+      f.getArgAttr(argIdx, kResultAttr))
+    return;
+
+  // Select the partitioning with the most banks, for which each access maps
+  // onto a single bank, and every bank is accessed. Inner dimensions are
+  // preferred, since they are typically the ones accessed by unrolled loops.
+  Partitioning best;
+  SmallVector<std::pair<Operation *, int64_t>> bestBanks;
+  for (unsigned dim = memrefType.getRank(); dim-- > 0;) {
+    int64_t dimSize = memrefType.getDimSize(dim);
+    auto accesses = getAccesses(memref, dim);
+    if (!accesses)
+      return;
+    for (int64_t factor = std::min<int64_t>(maxFactor, dimSize);
+         factor > best.factor; --factor) {
+      if (dimSize % factor != 0)
+        continue;
+      Partitioning partitioning{dim, factor, kind == "cyclic"};
+      SmallVector<std::pair<Operation *, int64_t>> banks;
+      llvm::SmallBitVector accessed(factor);
+      for (auto &access : *accesses) {
+        auto bank = getBank(access, partitioning, dimSize);
+        if (!bank)
+          break;
+        banks.push_back({access.op, *bank});
+        accessed.set(*bank);
+      }
+      if (banks.size() != accesses->size() || !accessed.all())
+        continue;
+      best = partitioning;
+      bestBanks = std::move(banks);
+      break;
+    }
+  }
+  if (best.factor < 2)
+    return;
+
+  // Add an argument for each bank, following the partitioned argument.
+  OpBuilder builder(f.getContext());
+  SmallVector<int64_t> bankShape(memrefType.getShape());
+  int64_t dimSize = bankShape[best.dim];
+  bankShape[best.dim] /= best.factor;
+  auto bankType = MemRefType::get(bankShape, memrefType.getElementType());
+  SmallVector<Value> bankArgs;
+  for (int64_t bank = 0; bank < best.factor; ++bank) {
+    unsigned bankIdx = argIdx + 1 + bank;
+    f.insertArgument(bankIdx, bankType, {}, memref.getLoc());
+    f.setArgAttr(
+        bankIdx, kPartitionAttr,
+        builder.getDictionaryAttr({
+            builder.getNamedAttr("arg", builder.getI64IntegerAttr(argIdx)),
+            builder.getNamedAttr("bank", builder.getI64IntegerAttr(bank)),
+            builder.getNamedAttr("dim", builder.getI64IntegerAttr(best.dim)),
+            builder.getNamedAttr("factor",
+                                 builder.getI64IntegerAttr(best.factor)),
+            builder.getNamedAttr("kind", builder.getStringAttr(kind)),
+            builder.getNamedAttr(
+                "shape", builder.getI64ArrayAttr(memrefType.getShape())),
+        }));
+    bankArgs.push_back(f.getArgument(bankIdx));
+  }
+
+  // Redirect each access to its bank.
+  for (auto [op, bank] : bestBanks) {
+    builder.setInsertionPoint(op);
+    if (auto loadOp = dyn_cast<AffineLoadOp>(op)) {
+      auto newLoadOp = builder.create<AffineLoadOp>(
+          loadOp.getLoc(), bankArgs[bank],
+          getBankMap(loadOp.getAffineMap(), best, bank, dimSize),
+          loadOp.getMapOperands());
+      loadOp.replaceAllUsesWith(newLoadOp.getResult());
+    } else {
+      auto storeOp = cast<AffineStoreOp>(op);
+      builder.create<AffineStoreOp>(
+          storeOp.getLoc(), storeOp.getValueToStore(), bankArgs[bank],
+          getBankMap(storeOp.getAffineMap(), best, bank, dimSize),
+          storeOp.getMapOperands());
+    }
+    op->erase();
+  }
+  f.eraseArgument(argIdx);
+}
+
+/// A group of affine accesses to the consecutive elements of a memref, which
+/// make up a single element of the vectorized memref. 'lanes' holds the access
+/// to each of the elements.
+struct VectorAccess {
+  bool isLoad;
+  Block *block;
+  AffineMap map;
+  SmallVector<Value> operands;
+  SmallVector<Operation *> lanes;
+};
+
+struct VectorizeMemrefsPass
+    : public VectorizeMemrefsBase<VectorizeMemrefsPass> {
+public:
+  void runOnOperation() override {
+    for (auto f : getOperation().getOps<FuncOp>()) {
+      if (f.isExternal())
+        continue;
+      // Kernel functions are called by the host rather than from within the
+      // module, so their signatures can be freely changed.
+      if (SymbolTable::symbolKnownUseEmpty(f, getOperation()))
+        for (unsigned i = 0; i < f.getNumArguments(); ++i)
+          vectorizeArgument(f, i);
+      // Local memories are invisible to the host, and are vectorized in any
+      // function.
+      SmallVector<Operation *> allocs;
+      f.walk([&](Operation *op) {
+        if (isa<memref::AllocOp, memref::AllocaOp>(op))
+          allocs.push_back(op);
+      });
+      for (Operation *alloc : allocs)
+        vectorizeAlloc(alloc);
+    }
+  }
+
+private:
+  /// Vectorizes the memref argument 'argIdx' of 'f', if its accesses can be
+  /// grouped into accesses to wide elements.
+  void vectorizeArgument(FuncOp f, unsigned argIdx);
+
+  /// Vectorizes the memref allocated by 'alloc', if its accesses can be
+  /// grouped into accesses to wide elements.
+  void vectorizeAlloc(Operation *alloc);
+
+  /// Rewrites the accesses to 'memref' into accesses to a memref of wide
+  /// elements, which 'createVector' creates given its type and factor.
+  /// Returns false, and leaves 'memref' as is, if the accesses cannot be
+  /// grouped into fewer accesses to wide elements.
+  bool vectorize(Value memref,
+                 function_ref<Value(MemRefType, int64_t)> createVector);
+
+  /// Groups 'accesses' into accesses to the elements of a memref which is
+  /// vectorized by 'factor' along 'dim'. Fails if any wide element is only
+  /// partially stored by a group, or if a group is interleaved with other
+  /// accesses. Wide elements may be partially loaded.
+  Optional<SmallVector<VectorAccess>>
+  getVectorAccesses(ArrayRef<LinearAccess> accesses, unsigned dim,
+                    int64_t factor);
+};
+
+Optional<SmallVector<VectorAccess>>
+VectorizeMemrefsPass::getVectorAccesses(ArrayRef<LinearAccess> accesses,
+                                        unsigned dim, int64_t factor) {
+  // The lane of an access within its wide element is its bank under a
+  // cyclic partitioning by the factor.
+  Partitioning lanes{dim, factor, /*cyclic=*/true};
+  SmallVector<VectorAccess> groups;
+  for (auto &access : accesses) {
+    auto lane = getBank(access, lanes, /*dimSize=*/0);
+    if (!lane)
+      return {};
+    auto loadOp = dyn_cast<AffineLoadOp>(access.op);
+    auto storeOp = dyn_cast<AffineStoreOp>(access.op);
+    AffineMap map = getBankMap(loadOp ? loadOp.getAffineMap()
+                                      : storeOp.getAffineMap(),
+                               lanes, *lane, /*dimSize=*/0);
+    SmallVector<Value> operands(loadOp ? loadOp.getMapOperands()
+                                       : storeOp.getMapOperands());
+    auto *group = llvm::find_if(groups, [&](const VectorAccess &group) {
+      return group.isLoad == static_cast<bool>(loadOp) &&
+             group.block == access.op->getBlock() && group.map == map &&
+             group.operands == operands;
+    });
+    if (group == groups.end()) {
+      groups.push_back({static_cast<bool>(loadOp), access.op->getBlock(), map,
+                        operands, SmallVector<Operation *>(factor, nullptr)});
+      group = std::prev(groups.end());
+    }
+    if (group->lanes[*lane])
+      return {};
+    group->lanes[*lane] = access.op;
+  }
+
+  for (auto &group : groups) {
+    // A partial store would have to load the rest of the wide element first.
+    if (!group.isLoad && llvm::is_contained(group.lanes, nullptr))
+      return {};
+    // Other accesses may not be reordered across the accesses of the group.
+    Operation *first = nullptr, *last = nullptr;
+    for (Operation *op : group.lanes) {
+      if (!op)
+        continue;
+      if (!first || op->isBeforeInBlock(first))
+        first = op;
+      if (!last || last->isBeforeInBlock(op))
+        last = op;
+    }
+    for (auto &access : accesses) {
+      Operation *op = group.block->findAncestorOpInBlock(*access.op);
+      if (op && !llvm::is_contained(group.lanes, access.op) &&
+          first->isBeforeInBlock(op) && op->isBeforeInBlock(last))
+        return {};
+    }
+  }
+  return groups;
+}
+
+void VectorizeMemrefsPass::vectorizeArgument(FuncOp f, unsigned argIdx) {
+  if (f.getArgAttr(argIdx, kPartitionAttr) ||
+      f.getArgAttr(argIdx, kResultAttr))
+    return;
+  Value memref = f.getArgument(argIdx);
+  bool vectorized = vectorize(memref, [&](MemRefType type, int64_t factor) {
+    OpBuilder builder(f.getContext());
+    auto memrefType = memref.getType().cast<MemRefType>();
+    unsigned vectorIdx = argIdx + 1;
+    f.insertArgument(vectorIdx, type, {}, memref.getLoc());
+    SmallVector<NamedAttribute> attrs = {
+        builder.getNamedAttr("factor", builder.getI64IntegerAttr(factor)),
+        builder.getNamedAttr("shape",
+                             builder.getI64ArrayAttr(memrefType.getShape())),
+    };
+    // The host elements are integers of the width of the lanes, unless
+    // recorded otherwise.
+    if (!memrefType.getElementType().isa<IntegerType>())
+      attrs.push_back(builder.getNamedAttr(
+          "element", TypeAttr::get(memrefType.getElementType())));
+    f.setArgAttr(vectorIdx, kVectorAttr, builder.getDictionaryAttr(attrs));
+    return f.getArgument(vectorIdx);
+  });
+  if (vectorized)
+    f.eraseArgument(argIdx);
+}
+
+void VectorizeMemrefsPass::vectorizeAlloc(Operation *alloc) {
+  Value vectorAlloc;
+  bool vectorized =
+      vectorize(alloc->getResult(0), [&](MemRefType type, int64_t) {
+        OpBuilder builder(alloc);
+        vectorAlloc = builder.clone(*alloc)->getResult(0);
+        vectorAlloc.setType(type);
+        return vectorAlloc;
+      });
+  if (!vectorized)
+    return;
+  // Only the deallocations are left.
+  alloc->getResult(0).replaceAllUsesWith(vectorAlloc);
+  alloc->erase();
+}
+
+bool VectorizeMemrefsPass::vectorize(
+    Value memref, function_ref<Value(MemRefType, int64_t)> createVector) {
+  auto memrefType = memref.getType().dyn_cast<MemRefType>();
+  if (!memrefType || !memrefType.hasStaticShape() ||
+      !memrefType.getLayout().isIdentity() || memrefType.getRank() == 0 ||
+      !memrefType.getElementType().isIntOrFloat() ||
+      (memrefType.getElementType().isa<IntegerType>() &&
+       !memrefType.getElementType().isSignlessInteger()) ||
+      memref.use_empty())
+    return false;
+
+  // Select the factor which groups all accesses into the fewest accesses to
+  // wide elements, preferring the smallest such factor.
+  unsigned dim = memrefType.getRank() - 1;
+  int64_t dimSize = memrefType.getDimSize(dim);
+  bool isAlloc = memref.getDefiningOp() != nullptr;
+  auto accesses = getAccesses(memref, dim, /*allowDeallocs=*/isAlloc);
+  if (!accesses)
+    return false;
+  int64_t factor = 0;
+  Optional<SmallVector<VectorAccess>> groups;
+  for (int64_t candidate = 2;
+       candidate <= std::min<int64_t>(maxFactor, dimSize); candidate *= 2) {
+    if (dimSize % candidate != 0)
+      continue;
+    auto candidateGroups = getVectorAccesses(*accesses, dim, candidate);
+    if (candidateGroups && candidateGroups->size() < accesses->size() &&
+        (!groups || candidateGroups->size() < groups->size())) {
+      factor = candidate;
+      groups = std::move(candidateGroups);
+    }
+  }
+  if (!groups)
+    return false;
+
+  OpBuilder builder(memref.getContext());
+  Type elemType = memrefType.getElementType();
+  unsigned width = elemType.getIntOrFloatBitWidth();
+  auto laneType = builder.getIntegerType(width);
+  auto vectorElemType = builder.getIntegerType(width * factor);
+  SmallVector<int64_t> vectorShape(memrefType.getShape());
+  vectorShape[dim] /= factor;
+  Value vectorMemRef =
+      createVector(MemRefType::get(vectorShape, vectorElemType), factor);
+
+  for (auto &group : *groups) {
+    Operation *first = *llvm::find_if(group.lanes, [](Operation *op) {
+      return op != nullptr;
+    });
+    Location loc = first->getLoc();
+    auto laneShift = [&](unsigned lane) -> Value {
+      return builder.create<arith::ConstantIntOp>(loc, lane * width,
+                                                  vectorElemType);
+    };
+
+    if (group.isLoad) {
+      // Load the wide element in place of the first load, and extract the
+      // loaded elements from it.
+      for (Operation *op : group.lanes)
+        if (op && op->isBeforeInBlock(first))
+          first = op;
+      builder.setInsertionPoint(first);
+      Value vector = builder.create<AffineLoadOp>(loc, vectorMemRef,
+                                                  group.map, group.operands);
+      for (auto it : llvm::enumerate(group.lanes)) {
+        if (!it.value())
+          continue;
+        Value elem = vector;
+        if (it.index() != 0)
+          elem = builder.create<arith::ShRUIOp>(loc, elem,
+                                                laneShift(it.index()));
+        elem = builder.create<arith::TruncIOp>(loc, laneType, elem);
+        if (elem.getType() != elemType)
+          elem = builder.create<arith::BitcastOp>(loc, elemType, elem);
+        it.value()->getResult(0).replaceAllUsesWith(elem);
+        it.value()->erase();
+      }
+      continue;
+    }
+
+    // Insert the elements into a wide element, which is stored in place of
+    // the last store.
+    Operation *last = first;
+    for (Operation *op : group.lanes)
+      if (last->isBeforeInBlock(op))
+        last = op;
+    builder.setInsertionPoint(last);
+    Value vector;
+    for (auto it : llvm::enumerate(group.lanes)) {
+      Value elem = cast<AffineStoreOp>(it.value()).getValueToStore();
+      if (elem.getType() != laneType)
+        elem = builder.create<arith::BitcastOp>(loc, laneType, elem);
+      elem = builder.create<arith::ExtUIOp>(loc, vectorElemType, elem);
+      if (it.index() != 0) {
+        elem = builder.create<arith::ShLIOp>(loc, elem, laneShift(it.index()));
+        elem = builder.create<arith::OrIOp>(loc, vector, elem);
+      }
+      vector = elem;
+    }
+    builder.create<AffineStoreOp>(loc, vector, vectorMemRef, group.map,
+                                  group.operands);
+    for (Operation *op : group.lanes)
+      op->erase();
+  }
+  return true;
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createPartitionMemrefsPass() {
+  return std::make_unique<PartitionMemrefsPass>();
+}
+std::unique_ptr<mlir::Pass> createVectorizeMemrefsPass() {
+  return std::make_unique<VectorizeMemrefsPass>();
+}
+} // namespace circt_hls
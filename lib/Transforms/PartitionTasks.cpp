@@ -0,0 +1,241 @@
+//===- PartitionTasks.cpp - Task-level partitioning of kernels ---*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Splits kernels of sequential phases at the boundaries of their top-level
+// affine loop nests into a chain of task functions, such that the tasks of
+// consecutive calls of the kernel can be simulated concurrently.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/IR/BlockAndValueMapping.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/SymbolTable.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Transforms/RegionUtils.h"
+#include "llvm/ADT/SetVector.h"
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+// Attributes of each task function: its index within the chain of tasks of
+// its kernel, and the indices of the earlier tasks which it depends on.
+static constexpr StringLiteral kTaskAttr = "hlt.task";
+static constexpr StringLiteral kTaskDepsAttr = "hlt.task_deps";
+
+/// Collects the memrefs which 'op' reads and writes. Memrefs which are used by
+/// ops other than affine and memref loads and stores, such as calls, are
+/// taken to be both read and written.
+static void getAccessedMemRefs(Operation *op, SmallPtrSetImpl<Value> &reads,
+                               SmallPtrSetImpl<Value> &writes) {
+  op->walk([&](Operation *nested) {
+    if (auto readOp = dyn_cast<AffineReadOpInterface>(nested))
+      reads.insert(readOp.getMemRef());
+    else if (auto writeOp = dyn_cast<AffineWriteOpInterface>(nested))
+      writes.insert(writeOp.getMemRef());
+    else if (auto loadOp = dyn_cast<memref::LoadOp>(nested))
+      reads.insert(loadOp.getMemRef());
+    else if (auto storeOp = dyn_cast<memref::StoreOp>(nested))
+      writes.insert(storeOp.getMemRef());
+    else
+      for (Value operand : nested->getOperands())
+        if (operand.getType().isa<MemRefType>()) {
+          reads.insert(operand);
+          writes.insert(operand);
+        }
+  });
+}
+
+/// Returns true if any of 'a' is in 'b'.
+static bool intersects(const SmallPtrSetImpl<Value> &a,
+                       const SmallPtrSetImpl<Value> &b) {
+  return llvm::any_of(a, [&](Value v) { return b.contains(v); });
+}
+
+namespace {
+
+struct PartitionTasksPass : public PartitionTasksBase<PartitionTasksPass> {
+public:
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+    // Only kernel functions are called by the host, which can overlap their
+    // consecutive calls.
+    SmallVector<std::pair<FuncOp, SmallVector<AffineForOp>>> kernels;
+    for (auto f : module.getOps<FuncOp>()) {
+      if (f.isExternal() || !SymbolTable::symbolKnownUseEmpty(f, module))
+        continue;
+      SmallVector<AffineForOp> nests;
+      if (canPartition(f, nests))
+        kernels.push_back({f, std::move(nests)});
+    }
+
+    SymbolTable symbolTable(module);
+    for (auto &[f, nests] : kernels) {
+      partition(f, nests, symbolTable);
+      ++numPartitioned;
+    }
+  }
+
+private:
+  /// Returns true if the body of 'f' consists of at least two top-level
+  /// affine loop nests, along with memref allocations and ops without regions
+  /// or memory effects, such as constants, which are cloned into the tasks.
+  /// 'nests' is set to the top-level nests.
+  bool canPartition(FuncOp f, SmallVectorImpl<AffineForOp> &nests);
+
+  /// Splits each of 'nests' of 'f' into a task function, and replaces it by a
+  /// call to the task.
+  void partition(FuncOp f, ArrayRef<AffineForOp> nests,
+                 SymbolTable &symbolTable);
+};
+
+bool PartitionTasksPass::canPartition(FuncOp f,
+                                      SmallVectorImpl<AffineForOp> &nests) {
+  if (f.getNumResults() != 0)
+    return false;
+  for (Operation &op : f.getBody().front().without_terminator()) {
+    if (auto forOp = dyn_cast<AffineForOp>(op)) {
+      if (forOp.getNumResults() != 0)
+        return false;
+      nests.push_back(forOp);
+    } else if (!isa<memref::AllocOp, memref::AllocaOp>(op) &&
+               (op.getNumRegions() != 0 || !isMemoryEffectFree(&op)))
+      return false;
+  }
+  return nests.size() >= 2;
+}
+
+void PartitionTasksPass::partition(FuncOp f, ArrayRef<AffineForOp> nests,
+                                   SymbolTable &symbolTable) {
+  MLIRContext *ctx = &getContext();
+  OpBuilder builder(ctx);
+  Type tokenType = builder.getI1Type();
+
+  // The memrefs which each task reads and writes. A task depends on each
+  // earlier task which writes a memref that it accesses, or which reads a
+  // memref that it writes.
+  SmallVector<SmallPtrSet<Value, 4>> reads(nests.size()), writes(nests.size());
+  for (auto it : llvm::enumerate(nests))
+    getAccessedMemRefs(it.value(), reads[it.index()], writes[it.index()]);
+
+  Block::iterator insertPt = std::next(f->getIterator());
+  Value token;
+  for (auto it : llvm::enumerate(nests)) {
+    unsigned idx = it.index();
+    AffineForOp nest = it.value();
+    bool first = idx == 0;
+    bool last = idx + 1 == nests.size();
+
+    // Values defined outside of the nest are passed to the task, unless they
+    // are defined by ops which can be cloned into the task, i.e. all
+    // top-level ops but the allocations.
+    llvm::SetVector<Value> captured;
+    getUsedValuesDefinedAbove(nest->getRegions(), captured);
+    captured.insert(nest->operand_begin(), nest->operand_end());
+    SmallPtrSet<Value, 8> passed;
+    SmallPtrSet<Operation *, 8> cloned;
+    SmallVector<Value> worklist(captured.begin(), captured.end());
+    while (!worklist.empty()) {
+      Value v = worklist.pop_back_val();
+      Operation *def = v.getDefiningOp();
+      if (!def || isa<memref::AllocOp, memref::AllocaOp>(def)) {
+        passed.insert(v);
+        continue;
+      }
+      if (cloned.insert(def).second)
+        worklist.append(def->operand_begin(), def->operand_end());
+    }
+
+    // The arguments of the task are those of the kernel, followed by the
+    // allocations, in order.
+    Block &body = f.getBody().front();
+    SmallVector<Value> args;
+    llvm::copy_if(body.getArguments(), std::back_inserter(args),
+                  [&](Value v) { return passed.contains(v); });
+    for (Operation &op : body)
+      llvm::copy_if(op.getResults(), std::back_inserter(args),
+                    [&](Value v) { return passed.contains(v); });
+
+    SmallVector<Type> inputs;
+    if (!first)
+      inputs.push_back(tokenType);
+    for (Value arg : args)
+      inputs.push_back(arg.getType());
+    SmallVector<Type> results;
+    if (!last)
+      results.push_back(tokenType);
+
+    // The task receives the token of the previous task as its leading
+    // argument, and returns its own token, such that the tasks form a chain
+    // in their original order.
+    std::string name = (f.getName() + "_task" + Twine(idx)).str();
+    auto task = FuncOp::create(nest.getLoc(), name,
+                               builder.getFunctionType(inputs, results));
+    symbolTable.insert(task, insertPt);
+    insertPt = std::next(task->getIterator());
+    Block *entry = task.addEntryBlock();
+    unsigned argOffset = first ? 0 : 1;
+    BlockAndValueMapping mapping;
+    for (auto argIt : llvm::enumerate(args)) {
+      Value arg = argIt.value();
+      mapping.map(arg, entry->getArgument(argIt.index() + argOffset));
+      if (auto blockArg = arg.dyn_cast<BlockArgument>())
+        if (auto attrs = f.getArgAttrDict(blockArg.getArgNumber()))
+          task.setArgAttrs(argIt.index() + argOffset, attrs);
+    }
+    builder.setInsertionPointToStart(entry);
+    for (Operation &op : body)
+      if (cloned.contains(&op))
+        builder.clone(op, mapping);
+    builder.clone(*nest, mapping);
+    SmallVector<Value> taskResults;
+    if (!last)
+      taskResults.push_back(builder.create<arith::ConstantOp>(
+          nest.getLoc(), builder.getBoolAttr(true)));
+    builder.create<ReturnOp>(nest.getLoc(), taskResults);
+
+    SmallVector<int64_t> deps;
+    for (unsigned prev = 0; prev < idx; ++prev)
+      if (intersects(writes[prev], reads[idx]) ||
+          intersects(writes[prev], writes[idx]) ||
+          intersects(reads[prev], writes[idx]))
+        deps.push_back(prev);
+    task->setAttr(kTaskAttr, builder.getI64IntegerAttr(idx));
+    task->setAttr(kTaskDepsAttr, builder.getI64ArrayAttr(deps));
+    ++numTasks;
+
+    // Replace the nest by a call to the task.
+    builder.setInsertionPoint(nest);
+    SmallVector<Value> operands;
+    if (!first)
+      operands.push_back(token);
+    operands.append(args.begin(), args.end());
+    auto call = builder.create<CallOp>(nest.getLoc(), task, operands);
+    token = last ? Value() : call.getResult(0);
+    nest.erase();
+  }
+
+  // The ops which were cloned into the tasks are left unused in the kernel.
+  for (Operation &op : llvm::make_early_inc_range(
+           llvm::reverse(f.getBody().front().without_terminator())))
+    if (op.use_empty() && isMemoryEffectFree(&op) && op.getNumRegions() == 0)
+      op.erase();
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createPartitionTasksPass() {
+  return std::make_unique<PartitionTasksPass>();
+}
+} // namespace circt_hls
@@ -15,7 +15,14 @@
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/Passes.h"
 
+namespace circt {
+namespace handshake {
+class FuncOp;
+} // namespace handshake
+} // namespace circt
+
 namespace mlir {
+class AffineDialect;
 class MemrefDialect;
 
 // Forward declaration from Dialect.h
@@ -30,6 +37,10 @@ namespace scf {
 class SCFDialect;
 }
 
+namespace arith {
+class ArithDialect;
+} // namespace arith
+
 namespace func {
 class FuncDialect;
 class FuncOp;
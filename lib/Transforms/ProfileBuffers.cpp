@@ -0,0 +1,210 @@
+//===- ProfileBuffers.cpp - Profile-guided buffer insertion ------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Inserts and resizes buffers in a handshake function based on the channel
+// stall profile of a simulation of the function.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "circt/Dialect/Handshake/HandshakeOps.h"
+#include "mlir/IR/Builders.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <algorithm>
+
+using namespace mlir;
+using namespace circt;
+using namespace circt_hls;
+
+namespace {
+
+struct ChannelProfile {
+  int64_t fire = 0;
+  int64_t stall = 0;
+};
+
+/// A back-pressured channel, driven by 'value'.
+struct StalledChannel {
+  Value value;
+  ChannelProfile profile;
+};
+
+} // namespace
+
+/// Returns the name of the instance that 'op' is lowered to, which is the name
+/// of the op followed by its 'handshake_id'. Returns an empty string if the op
+/// has no ID.
+static std::string getInstanceName(Operation *op) {
+  auto idAttr = op->getAttrOfType<IntegerAttr>("handshake_id");
+  if (!idAttr)
+    return "";
+  std::string name = op->getName().getStringRef().str();
+  std::replace(name.begin(), name.end(), '.', '_');
+  return name + std::to_string(idAttr.getInt());
+}
+
+/// Returns true if 'v' lies on a cycle in the dataflow graph, i.e. if the
+/// defining op of 'v' is reachable from its users.
+static bool isOnCycle(Value v) {
+  Operation *defOp = v.getDefiningOp();
+  if (!defOp)
+    return false;
+  SmallVector<Operation *> worklist(v.getUsers().begin(), v.getUsers().end());
+  DenseSet<Operation *> visited;
+  while (!worklist.empty()) {
+    Operation *op = worklist.pop_back_val();
+    if (op == defOp)
+      return true;
+    if (!visited.insert(op).second)
+      continue;
+    for (Value res : op->getResults())
+      llvm::append_range(worklist, res.getUsers());
+  }
+  return false;
+}
+
+namespace {
+
+struct ProfileBuffersPass : public ProfileBuffersBase<ProfileBuffersPass> {
+public:
+  void runOnOperation() override {
+    handshake::FuncOp f = getOperation();
+
+    llvm::StringMap<ChannelProfile> channels;
+    int64_t cycles = 0;
+    if (failed(readProfile(f, channels, cycles)))
+      return signalPassFailure();
+    if (cycles == 0)
+      return;
+
+    // Gather the channels which stalled for more than the threshold, most
+    // stalled first.
+    SmallVector<StalledChannel> stalled;
+    f.walk([&](Operation *op) {
+      std::string instName = getInstanceName(op);
+      if (instName.empty())
+        return;
+      for (auto res : llvm::enumerate(op->getResults())) {
+        auto it = channels.find(instName + "_out" +
+                                std::to_string(res.index()));
+        if (it == channels.end() ||
+            double(it->second.stall) / cycles < stallThreshold)
+          continue;
+        stalled.push_back({res.value(), it->second});
+      }
+    });
+    llvm::stable_sort(stalled, [](auto &lhs, auto &rhs) {
+      return lhs.profile.stall > rhs.profile.stall;
+    });
+    if (maxBuffers != 0 && stalled.size() > maxBuffers)
+      stalled.resize(maxBuffers);
+
+    // Buffers which are created are given IDs following those of the existing
+    // buffers, such that instance names remain unique.
+    int64_t nextBufferId = 0;
+    f.walk([&](handshake::BufferOp bufferOp) {
+      if (auto idAttr = bufferOp->getAttrOfType<IntegerAttr>("handshake_id"))
+        nextBufferId = std::max(nextBufferId, idAttr.getInt() + 1);
+    });
+
+    OpBuilder builder(f.getContext());
+    unsigned slotLimit = std::max(maxSlots.getValue(), 1U);
+    for (auto &channel : stalled) {
+      // Each slot absorbs a value which the consumer of the channel was not
+      // ready to accept, so size the buffer by the average number of cycles
+      // that each transaction stalled for.
+      int64_t fire = std::max<int64_t>(channel.profile.fire, 1);
+      unsigned extraSlots = (channel.profile.stall + fire - 1) / fire;
+
+      // A channel driven by a buffer is back-pressured because the buffer is
+      // full, so grow the buffer.
+      if (auto bufferOp = channel.value.getDefiningOp<handshake::BufferOp>()) {
+        unsigned slots =
+            std::min<unsigned>(bufferOp.getNumSlots() + extraSlots, slotLimit);
+        bufferOp->setAttr("slots", builder.getI32IntegerAttr(slots));
+        continue;
+      }
+
+      // Buffers on cycles are transparent, such that they don't add latency to
+      // the cycle.
+      auto bufferType = isOnCycle(channel.value)
+                            ? handshake::BufferTypeEnum::fifo
+                            : handshake::BufferTypeEnum::seq;
+      unsigned slots = std::min(std::max(extraSlots, 1U), slotLimit);
+      builder.setInsertionPointAfterValue(channel.value);
+      auto bufferOp = builder.create<handshake::BufferOp>(
+          channel.value.getLoc(), channel.value, slots, bufferType);
+      bufferOp->setAttr("handshake_id",
+                        builder.getI64IntegerAttr(nextBufferId++));
+      channel.value.replaceAllUsesExcept(bufferOp.getResult(), bufferOp);
+    }
+  }
+
+private:
+  /// Reads the channel stall profile of 'f' from the 'profile' file. Only the
+  /// channels within the top-level scope of 'f' are read, keyed by their name
+  /// within the scope.
+  LogicalResult readProfile(handshake::FuncOp f,
+                            llvm::StringMap<ChannelProfile> &channels,
+                            int64_t &cycles);
+};
+
+LogicalResult
+ProfileBuffersPass::readProfile(handshake::FuncOp f,
+                                llvm::StringMap<ChannelProfile> &channels,
+                                int64_t &cycles) {
+  auto buf = llvm::MemoryBuffer::getFile(profile);
+  if (!buf)
+    return f.emitError() << "could not read channel profile '" << profile
+                         << "': " << buf.getError().message();
+
+  auto json = llvm::json::parse((*buf)->getBuffer());
+  if (!json)
+    return f.emitError() << "could not parse channel profile '" << profile
+                         << "': " << llvm::toString(json.takeError());
+
+  auto *root = json->getAsObject();
+  if (!root || !root->getArray("channels") || !root->getInteger("cycles"))
+    return f.emitError() << "expected channel profile '" << profile
+                         << "' to contain 'cycles' and 'channels'";
+  cycles = *root->getInteger("cycles");
+
+  std::string scope = (f.getName() + ".").str();
+  for (auto &channelValue : *root->getArray("channels")) {
+    auto *channel = channelValue.getAsObject();
+    if (!channel)
+      continue;
+    auto name = channel->getString("name");
+    auto fire = channel->getInteger("fire");
+    auto stall = channel->getInteger("stall");
+    if (!name || !fire || !stall)
+      return f.emitError() << "expected each channel of profile '" << profile
+                           << "' to have a 'name', 'fire' and 'stall'";
+
+    // Only consider channels which connect the instances of 'f'.
+    if (!name->startswith(scope))
+      continue;
+    StringRef channelName = name->drop_front(scope.size());
+    if (channelName.contains('.'))
+      continue;
+    channels[channelName] = {*fire, *stall};
+  }
+  return success();
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createProfileBuffersPass() {
+  return std::make_unique<ProfileBuffersPass>();
+}
+} // namespace circt_hls
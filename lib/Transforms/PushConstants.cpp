@@ -18,11 +18,25 @@
 #include "mlir/IR/BuiltinTypes.h"
 #include "llvm/ADT/TypeSwitch.h"
 
+#include <limits>
 #include <set>
 
 using namespace mlir;
 using namespace circt_hls;
 
+/// Returns the number of bits of the value of a constant of type 'type'.
+static unsigned getConstantWidth(Type type) {
+  if (type.isIndex())
+    return IndexType::kInternalStorageBitWidth;
+  if (type.isIntOrFloat())
+    return type.getIntOrFloatBitWidth();
+  if (auto shapedType = type.dyn_cast<ShapedType>();
+      shapedType && shapedType.hasStaticShape())
+    return getConstantWidth(shapedType.getElementType()) *
+           shapedType.getNumElements();
+  return std::numeric_limits<unsigned>::max();
+}
+
 namespace {
 
 // We assume that the IR has been canonicalized beforehand, which has merged
@@ -46,8 +60,20 @@ public:
       // llvm::make_early_inc_range doesn't seem to work, so we manually create
       // a set.
       llvm::SetVector<Operation *> users;
-      for (auto user : constantOp->getUsers())
+      llvm::SmallPtrSet<Block *, 8> userBlocks;
+      for (auto user : constantOp->getUsers()) {
         users.insert(user);
+        if (user->getBlock() != constantBlock)
+          userBlocks.insert(user->getBlock());
+      }
+
+      // Wide constants with a large fanout are cheaper to share than to copy.
+      if (getConstantWidth(constantOp.getType()) > maxWidth &&
+          userBlocks.size() > maxCopies) {
+        ++numShared;
+        continue;
+      }
+
       for (auto user : users) {
         auto userBlock = user->getBlock();
         if (userBlock == constantBlock) {
@@ -64,6 +90,7 @@ public:
           builder.setInsertionPointToStart(userBlock);
           newConstantOp = builder.create<arith::ConstantOp>(
               constantOp.getLoc(), constantOp.getValue());
+          ++numCopies;
         }
 
         user->replaceUsesOfWith(constantOp, newConstantOp->getResult(0));
@@ -0,0 +1,134 @@
+//===- ScalarizeMemRefs.cpp - Small memref scalarization ---------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Replaces the small memref arguments of kernel functions which are only read
+// at constant indices by a scalar argument for each of their elements, such
+// that the kernel receives them as values rather than through memories.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/BuiltinTypes.h"
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+// Dictionary attribute on each scalar argument, which records the element of
+// the host memref which it is (see BaseWrapper::getScalar).
+static constexpr StringLiteral kScalarAttr = "hlt.scalar";
+
+/// Returns the row-major index of the element of the memref of 'type' which
+/// 'op' loads, if 'op' is a load of a constant, in bounds element.
+static Optional<int64_t> getConstantElement(Operation *op, MemRefType type) {
+  SmallVector<int64_t> indices;
+  if (auto loadOp = dyn_cast<AffineLoadOp>(op)) {
+    AffineMap map = loadOp.getAffineMap();
+    if (!map.isConstant())
+      return {};
+    indices = map.getConstantResults();
+  } else if (auto loadOp = dyn_cast<memref::LoadOp>(op)) {
+    for (Value index : loadOp.getIndices()) {
+      auto constIndex = getConstantIntValue(index);
+      if (!constIndex)
+        return {};
+      indices.push_back(*constIndex);
+    }
+  } else {
+    return {};
+  }
+
+  int64_t elem = 0;
+  for (auto [index, dim] : llvm::zip(indices, type.getShape())) {
+    if (index < 0 || index >= dim)
+      return {};
+    elem = elem * dim + index;
+  }
+  return elem;
+}
+
+namespace {
+
+struct ScalarizeMemRefsPass
+    : public ScalarizeMemRefsBase<ScalarizeMemRefsPass> {
+public:
+  void runOnOperation() override {
+    // Only kernel functions are called by the host, which reads the elements
+    // of their scalarized arguments.
+    for (auto f : getOperation().getOps<FuncOp>()) {
+      if (f.isExternal() ||
+          !SymbolTable::symbolKnownUseEmpty(f, getOperation()))
+        continue;
+      for (unsigned i = 0; i < f.getNumArguments(); ++i)
+        if (scalarize(f, i))
+          ++numScalarized;
+    }
+  }
+
+private:
+  /// Replaces the memref argument 'argIdx' of 'f' by a scalar argument for
+  /// each of its elements, if it has at most 'maxElements' elements, and each
+  /// of its uses loads a constant element. Returns true if the argument was
+  /// scalarized.
+  bool scalarize(FuncOp f, unsigned argIdx);
+};
+
+bool ScalarizeMemRefsPass::scalarize(FuncOp f, unsigned argIdx) {
+  Value memref = f.getArgument(argIdx);
+  auto memrefType = memref.getType().dyn_cast<MemRefType>();
+  if (!memrefType || !memrefType.hasStaticShape() ||
+      !memrefType.getLayout().isIdentity() ||
+      memrefType.getNumElements() == 0 ||
+      memrefType.getNumElements() > maxElements || memref.use_empty() ||
+      f.getArgAttr(argIdx, "hlt.partition") ||
+      f.getArgAttr(argIdx, "hlt.vector") || f.getArgAttr(argIdx, "hlt.stream"))
+    return false;
+  Type elemType = memrefType.getElementType();
+  if (!elemType.isIntOrFloat() || elemType.getIntOrFloatBitWidth() > 64)
+    return false;
+
+  // Memrefs which are stored to are left as is, since the host would have to
+  // write their elements back after the call.
+  SmallVector<std::pair<Operation *, int64_t>> loads;
+  for (Operation *user : memref.getUsers()) {
+    auto elem = getConstantElement(user, memrefType);
+    if (!elem)
+      return false;
+    loads.push_back({user, *elem});
+  }
+
+  OpBuilder builder(&getContext());
+  auto shapeAttr = builder.getI64ArrayAttr(memrefType.getShape());
+  for (int64_t elem = 0; elem < memrefType.getNumElements(); ++elem) {
+    auto scalarAttr = builder.getDictionaryAttr(
+        {builder.getNamedAttr("elem", builder.getI64IntegerAttr(elem)),
+         builder.getNamedAttr("shape", shapeAttr)});
+    auto argAttrs = builder.getDictionaryAttr(
+        builder.getNamedAttr(kScalarAttr, scalarAttr));
+    f.insertArgument(argIdx + 1 + elem, elemType, argAttrs, memref.getLoc());
+  }
+  for (auto [loadOp, elem] : loads) {
+    loadOp->getResult(0).replaceAllUsesWith(f.getArgument(argIdx + 1 + elem));
+    loadOp->erase();
+  }
+  f.eraseArgument(argIdx);
+  return true;
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createScalarizeMemRefsPass() {
+  return std::make_unique<ScalarizeMemRefsPass>();
+}
+} // namespace circt_hls
@@ -0,0 +1,353 @@
+//===- ShareUnits.cpp - Functional unit sharing ------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Shares the expensive functional units of a handshake function, such as
+// multipliers and dividers, between ops which rarely fire in the same cycle.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "circt/Dialect/Handshake/HandshakeOps.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/IR/Builders.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <algorithm>
+#include <map>
+
+using namespace mlir;
+using namespace circt;
+using namespace circt_hls;
+
+namespace {
+
+/// A functional unit of the function, which is either an op of the function
+/// or a unit which is shared by 'numOps' ops. 'fire' is the number of cycles
+/// that the unit fired in.
+struct Unit {
+  Operation *op;
+  int64_t fire;
+  unsigned numOps;
+};
+
+} // namespace
+
+/// Returns true if 'op' is lowered to an expensive functional unit, such as a
+/// multiplier or a divider, which is worth sharing.
+static bool isExpensive(Operation *op) {
+  return isa<arith::MulIOp, arith::DivSIOp, arith::DivUIOp, arith::RemSIOp,
+             arith::RemUIOp, arith::MulFOp, arith::DivFOp, arith::AddFOp,
+             arith::SubFOp>(op) &&
+         op->getNumResults() == 1;
+}
+
+/// Returns a key which is equal for ops which can share a functional unit:
+/// ops of the same name, types and attributes, besides their IDs.
+static std::string getUnitKey(Operation *op) {
+  std::string key;
+  llvm::raw_string_ostream os(key);
+  os << op->getName() << "(";
+  llvm::interleaveComma(op->getOperandTypes(), os);
+  os << ")->" << op->getResult(0).getType();
+  for (NamedAttribute attr : op->getAttrs())
+    if (attr.getName() != "handshake_id")
+      os << " " << attr.getName() << "=" << attr.getValue();
+  return os.str();
+}
+
+/// Returns the name of the instance that 'op' is lowered to, which is the name
+/// of the op followed by its 'handshake_id'. Returns an empty string if the op
+/// has no ID.
+static std::string getInstanceName(Operation *op) {
+  auto idAttr = op->getAttrOfType<IntegerAttr>("handshake_id");
+  if (!idAttr)
+    return "";
+  std::string name = op->getName().getStringRef().str();
+  std::replace(name.begin(), name.end(), '.', '_');
+  return name + std::to_string(idAttr.getInt());
+}
+
+/// Returns true if 'op' lies on a cycle of the dataflow graph, i.e. if it is
+/// reachable from its users.
+static bool isOnCycle(Operation *op) {
+  SmallVector<Operation *> worklist;
+  for (Value res : op->getResults())
+    llvm::append_range(worklist, res.getUsers());
+  DenseSet<Operation *> visited;
+  while (!worklist.empty()) {
+    Operation *user = worklist.pop_back_val();
+    if (user == op)
+      return true;
+    if (!visited.insert(user).second)
+      continue;
+    for (Value res : user->getResults())
+      llvm::append_range(worklist, res.getUsers());
+  }
+  return false;
+}
+
+namespace {
+
+struct ShareUnitsPass : public ShareUnitsBase<ShareUnitsPass> {
+public:
+  void runOnOperation() override {
+    handshake::FuncOp f = getOperation();
+
+    llvm::StringMap<int64_t> fires;
+    int64_t cycles = 0;
+    if (!profile.empty() && failed(readProfile(f, fires, cycles)))
+      return signalPassFailure();
+    if (!profile.empty() && cycles == 0)
+      return;
+
+    // The units which may be shared, by the ops that they can be shared with.
+    // Without a profile, the activity of the ops is unknown, and only ops
+    // outside of loops are shared: they fire once per invocation of the
+    // function.
+    std::map<std::string, SmallVector<Unit>> pools;
+    f.walk([&](Operation *op) {
+      if (!isExpensive(op))
+        return;
+      int64_t fire = 0;
+      if (!profile.empty()) {
+        auto it = fires.find(getInstanceName(op));
+        if (it == fires.end())
+          return;
+        fire = it->second;
+      } else if (isOnCycle(op)) {
+        return;
+      }
+      pools[getUnitKey(op)].push_back({op, fire, 1});
+    });
+
+    initIds(f);
+
+    // Units are shared greedily, least active first, for as long as the
+    // estimated throughput loss of all shared units stays within the bound.
+    // Two units which fire in 'fa' and 'fb' of 'c' cycles, independently of
+    // each other, both fire in an expected 'fa * fb / c' cycles, each of
+    // which delays one of them by a cycle.
+    double totalLoss = 0;
+    while (true) {
+      SmallVector<Unit> *bestPool = nullptr;
+      unsigned bestA = 0, bestB = 0;
+      double bestLoss = 0;
+      for (auto &it : pools) {
+        unsigned a, b;
+        double loss;
+        if (getCandidates(it.second, cycles, a, b, loss) &&
+            totalLoss + loss <= maxLoss && (!bestPool || loss < bestLoss)) {
+          bestPool = &it.second;
+          bestA = a;
+          bestB = b;
+          bestLoss = loss;
+        }
+      }
+      if (!bestPool)
+        break;
+
+      SmallVector<Unit> &pool = *bestPool;
+      Unit shared = share(pool[bestA], pool[bestB]);
+      totalLoss += bestLoss;
+      pool.erase(pool.begin() + bestB);
+      pool[bestA] = shared;
+      ++numUnits;
+    }
+  }
+
+private:
+  /// Reads the op profile written by an HLT simulation with HLT_OP_STATS
+  /// (op_stats.json) from the 'profile' file. Only the ops within the
+  /// top-level scope of 'f' are read, keyed by their instance name.
+  LogicalResult readProfile(handshake::FuncOp f,
+                            llvm::StringMap<int64_t> &fires, int64_t &cycles);
+
+  /// Finds the two least active units 'a' and 'b' of 'pool' which can share a
+  /// unit, and the estimated fraction of the 'cycles' that sharing them loses.
+  /// Returns false if no units can be shared.
+  bool getCandidates(SmallVectorImpl<Unit> &pool, int64_t cycles, unsigned &a,
+                     unsigned &b, double &loss);
+
+  /// Replaces the units 'a' and 'b' by a single unit, which they share
+  /// through an arbiter, and returns the shared unit.
+  Unit share(const Unit &a, const Unit &b);
+
+  /// Creates an op of type 'OpTy', which is given an ID if the ops of the
+  /// function have IDs.
+  template <typename OpTy, typename... Args>
+  OpTy create(OpBuilder &builder, Location loc, Args &&...args) {
+    auto op = builder.create<OpTy>(loc, std::forward<Args>(args)...);
+    assignId(op);
+    return op;
+  }
+
+  /// Records the next free ID of each op name of 'f'.
+  void initIds(handshake::FuncOp f);
+
+  /// Gives 'op' the next free ID of its name, if the function has IDs.
+  void assignId(Operation *op);
+
+  bool hasIds = false;
+  llvm::StringMap<int64_t> nextIds;
+};
+
+bool ShareUnitsPass::getCandidates(SmallVectorImpl<Unit> &pool, int64_t cycles,
+                                   unsigned &a, unsigned &b, double &loss) {
+  llvm::stable_sort(pool, [](const Unit &lhs, const Unit &rhs) {
+    return lhs.fire < rhs.fire;
+  });
+  for (a = 0; a < pool.size(); ++a)
+    for (b = a + 1; b < pool.size(); ++b) {
+      if (pool[a].numOps + pool[b].numOps > maxShare)
+        continue;
+      // A unit fires at most once per cycle.
+      if (!profile.empty() && pool[a].fire + pool[b].fire > cycles)
+        return false;
+      double c = std::max<int64_t>(cycles, 1);
+      loss = pool[a].fire * (pool[b].fire / c) / c;
+      return true;
+    }
+  return false;
+}
+
+void ShareUnitsPass::initIds(handshake::FuncOp f) {
+  f.walk([&](Operation *op) {
+    if (auto idAttr = op->getAttrOfType<IntegerAttr>("handshake_id")) {
+      int64_t &next = nextIds[op->getName().getStringRef()];
+      next = std::max(next, idAttr.getInt() + 1);
+      hasIds = true;
+    }
+  });
+}
+
+void ShareUnitsPass::assignId(Operation *op) {
+  if (!hasIds)
+    return;
+  int64_t &next = nextIds[op->getName().getStringRef()];
+  op->setAttr("handshake_id",
+              IntegerAttr::get(IntegerType::get(op->getContext(), 64), next++));
+}
+
+Unit ShareUnitsPass::share(const Unit &a, const Unit &b) {
+  Operation *opA = a.op, *opB = b.op;
+  Operation *ops[] = {opA, opB};
+  Location loc = opA->getLoc();
+  OpBuilder builder(opA);
+
+  // Each op requests the unit once all of its operands are available. The
+  // operands are forked to the request and to the muxes which select the
+  // operands of the granted op.
+  SmallVector<SmallVector<Value>> muxInputs(opA->getNumOperands());
+  SmallVector<Value> requests;
+  for (Operation *op : ops) {
+    SmallVector<Value> requestOperands;
+    for (auto operand : llvm::enumerate(op->getOperands())) {
+      auto forkOp =
+          create<handshake::ForkOp>(builder, loc, operand.value(), 2);
+      requestOperands.push_back(forkOp.getResult(0));
+      muxInputs[operand.index()].push_back(forkOp.getResult(1));
+    }
+    requests.push_back(
+        create<handshake::JoinOp>(builder, loc, requestOperands).getResult());
+  }
+
+  // The arbiter grants the unit to one requesting op per cycle. Its index
+  // selects the operands of the op, and steers the result back to the users
+  // of the op.
+  auto arbiter = create<handshake::ControlMergeOp>(builder, loc, requests);
+  create<handshake::SinkOp>(builder, loc, arbiter.getResult(0));
+  unsigned numSelects = opA->getNumOperands() + 1;
+  auto indexFork =
+      create<handshake::ForkOp>(builder, loc, arbiter.getResult(1), numSelects);
+
+  SmallVector<Value> operands;
+  for (auto inputs : llvm::enumerate(muxInputs)) {
+    Value select = indexFork.getResult(inputs.index());
+    auto muxOp =
+        create<handshake::MuxOp>(builder, loc, select, inputs.value());
+    operands.push_back(muxOp.getResult());
+  }
+  Operation *sharedOp = builder.clone(*opA);
+  sharedOp->setOperands(operands);
+  assignId(sharedOp);
+
+  auto cond = create<arith::IndexCastOp>(
+      builder, loc, builder.getI1Type(),
+      indexFork.getResult(opA->getNumOperands()));
+  auto demux = create<handshake::ConditionalBranchOp>(
+      builder, loc, cond.getResult(), sharedOp->getResult(0));
+
+  // The result of each op is buffered, such that the unit is not held by an
+  // op whose users are not ready, while the other op requests it. The buffers
+  // are sequential, since the users of one op may lead to the operands of
+  // the other, which would otherwise close a combinational cycle.
+  unsigned slots = std::max(outputSlots.getValue(), 1U);
+  for (auto it : llvm::enumerate(ops)) {
+    // The demux steers the result of index 1 (opB) to its true result.
+    Value result = demux.getResult(it.index() == 0 ? 1 : 0);
+    auto bufferOp = create<handshake::BufferOp>(
+        builder, loc, result, slots, handshake::BufferTypeEnum::seq);
+    it.value()->getResult(0).replaceAllUsesWith(bufferOp.getResult());
+  }
+  opA->erase();
+  opB->erase();
+  // Units which are already shared were counted when they were created.
+  numShared += (a.numOps == 1) + (b.numOps == 1);
+  return {sharedOp, a.fire + b.fire, a.numOps + b.numOps};
+}
+
+LogicalResult ShareUnitsPass::readProfile(handshake::FuncOp f,
+                                          llvm::StringMap<int64_t> &fires,
+                                          int64_t &cycles) {
+  auto buf = llvm::MemoryBuffer::getFile(profile);
+  if (!buf)
+    return f.emitError() << "could not read op profile '" << profile
+                         << "': " << buf.getError().message();
+
+  auto json = llvm::json::parse((*buf)->getBuffer());
+  if (!json)
+    return f.emitError() << "could not parse op profile '" << profile
+                         << "': " << llvm::toString(json.takeError());
+
+  auto *root = json->getAsObject();
+  if (!root || !root->getArray("ops") || !root->getInteger("cycles"))
+    return f.emitError() << "expected op profile '" << profile
+                         << "' to contain 'cycles' and 'ops'";
+  cycles = *root->getInteger("cycles");
+
+  std::string scope = (f.getName() + ".").str();
+  for (auto &opValue : *root->getArray("ops")) {
+    auto *op = opValue.getAsObject();
+    if (!op)
+      continue;
+    auto name = op->getString("name");
+    auto fire = op->getInteger("fire");
+    if (!name || !fire)
+      return f.emitError() << "expected each op of profile '" << profile
+                           << "' to have a 'name' and 'fire'";
+
+    // Only consider the instances of 'f'.
+    if (!name->startswith(scope))
+      continue;
+    StringRef instName = name->drop_front(scope.size());
+    if (instName.contains('.'))
+      continue;
+    fires[instName] = *fire;
+  }
+  return success();
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createShareUnitsPass() {
+  return std::make_unique<ShareUnitsPass>();
+}
+} // namespace circt_hls
@@ -0,0 +1,206 @@
+//===- StrengthReduce.cpp - Induction variable strength reduction ---------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Replaces the multiplications of induction variables by constants, such as
+// those of linearized memref indices, by induction variables which are
+// incremented by the scaled step of the original induction variable.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/Matchers.h"
+#include "mlir/Interfaces/ControlFlowInterfaces.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SetVector.h"
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+namespace {
+
+/// An edge into the block of an induction variable, which either enters the
+/// loop, is a back edge that increments the induction variable by 'step', or
+/// passes the induction variable on unchanged.
+struct InductionEdge {
+  BranchOpInterface branchOp;
+  unsigned succIdx;
+  Optional<APInt> step;
+  bool identity;
+};
+
+} // namespace
+
+/// Returns the constant by which 'v' increments 'arg', if 'v' is the sum of
+/// 'arg' and a constant.
+static Optional<APInt> getStep(Value v, BlockArgument arg) {
+  auto addOp = v.getDefiningOp<arith::AddIOp>();
+  if (!addOp)
+    return {};
+  APInt step;
+  if ((addOp.getLhs() == arg &&
+       matchPattern(addOp.getRhs(), m_ConstantInt(&step))) ||
+      (addOp.getRhs() == arg &&
+       matchPattern(addOp.getLhs(), m_ConstantInt(&step))))
+    return step;
+  return {};
+}
+
+/// Returns the constant by which 'op' scales 'arg', if 'op' multiplies 'arg'
+/// by a constant, or shifts it left by a constant.
+static Optional<APInt> getScale(Operation *op, BlockArgument arg) {
+  APInt value;
+  if (auto mulOp = dyn_cast<arith::MulIOp>(op)) {
+    Value other = mulOp.getLhs() == arg ? mulOp.getRhs() : mulOp.getLhs();
+    if (matchPattern(other, m_ConstantInt(&value)))
+      return value;
+  } else if (auto shlOp = dyn_cast<arith::ShLIOp>(op)) {
+    if (shlOp.getLhs() == arg &&
+        matchPattern(shlOp.getRhs(), m_ConstantInt(&value)) &&
+        value.ult(value.getBitWidth()))
+      return APInt::getOneBitSet(value.getBitWidth(), value.getZExtValue());
+  }
+  return {};
+}
+
+/// Returns the edges into the block of 'arg', if 'arg' is an induction
+/// variable: each edge must forward a value to it through a branch, and at
+/// least one of them must be a back edge.
+static Optional<SmallVector<InductionEdge>>
+getInductionEdges(BlockArgument arg) {
+  Block *block = arg.getOwner();
+  SmallVector<InductionEdge> edges;
+  bool hasBackEdge = false;
+  for (Block *pred : llvm::SetVector<Block *>(block->pred_begin(),
+                                              block->pred_end())) {
+    auto branchOp = dyn_cast<BranchOpInterface>(pred->getTerminator());
+    if (!branchOp)
+      return {};
+    for (unsigned i = 0; i < branchOp->getNumSuccessors(); ++i) {
+      if (branchOp->getSuccessor(i) != block)
+        continue;
+      SuccessorOperands operands = branchOp.getSuccessorOperands(i);
+      if (operands.getProducedOperandCount() != 0)
+        return {};
+      Value operand = operands[arg.getArgNumber()];
+      auto step = getStep(operand, arg);
+      hasBackEdge |= step.has_value();
+      edges.push_back({branchOp, i, step, operand == arg});
+    }
+  }
+  if (!hasBackEdge)
+    return {};
+  return edges;
+}
+
+namespace {
+
+struct StrengthReducePass : public StrengthReduceBase<StrengthReducePass> {
+public:
+  void runOnOperation() override {
+    // Reduced induction variables may themselves be scaled, such as by the
+    // successive multiplications of an index by the sizes of the inner
+    // dimensions of a memref; iterate until no induction variable is scaled.
+    created.clear();
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (Block &block : llvm::drop_begin(getOperation().getBody()))
+        for (unsigned i = 0; i < block.getNumArguments(); ++i)
+          changed |= reduce(block.getArgument(i));
+    }
+  }
+
+private:
+  /// Replaces each multiplication of the induction variable 'arg' by a
+  /// constant with a new induction variable of the same block. Returns true
+  /// if any multiplication was replaced.
+  bool reduce(BlockArgument arg);
+
+  /// The multiplications which the pass created on the edges into loops.
+  /// These are not reduced in turn: the headers of a loop nest may pass their
+  /// induction variables to each other, such that reducing the argument which
+  /// one of them scales would scale the first argument again.
+  DenseSet<Operation *> created;
+};
+
+bool StrengthReducePass::reduce(BlockArgument arg) {
+  if (!arg.getType().isSignlessIntOrIndex())
+    return false;
+
+  // Group the scaling users of 'arg' by their scale.
+  SmallVector<std::pair<APInt, SmallVector<Operation *>>> scaled;
+  for (Operation *user : arg.getUsers()) {
+    if (created.contains(user))
+      continue;
+    auto scale = getScale(user, arg);
+    if (!scale)
+      continue;
+    auto it = llvm::find_if(scaled, [&](auto &s) { return s.first == *scale; });
+    if (it == scaled.end())
+      scaled.push_back({*scale, {user}});
+    else
+      it->second.push_back(user);
+  }
+  if (scaled.empty())
+    return false;
+  auto edges = getInductionEdges(arg);
+  if (!edges)
+    return false;
+
+  Type type = arg.getType();
+  OpBuilder builder(&getContext());
+  auto constant = [&](Location loc, const APInt &value) -> Value {
+    return builder.create<arith::ConstantOp>(
+        loc, builder.getIntegerAttr(type, value));
+  };
+  for (auto &[scale, users] : scaled) {
+    // The scaled induction variable enters the loop with the scaled value of
+    // 'arg', and is incremented by the scaled step along each back edge.
+    BlockArgument scaledArg = arg.getOwner()->addArgument(type, arg.getLoc());
+    for (auto &edge : *edges) {
+      builder.setInsertionPoint(edge.branchOp);
+      Location loc = edge.branchOp.getLoc();
+      SuccessorOperands operands =
+          edge.branchOp.getSuccessorOperands(edge.succIdx);
+      Value next;
+      APInt init;
+      if (edge.identity) {
+        next = scaledArg;
+      } else if (edge.step) {
+        next = builder.create<arith::AddIOp>(loc, scaledArg,
+                                             constant(loc, *edge.step * scale));
+      } else if (matchPattern(operands[arg.getArgNumber()],
+                              m_ConstantInt(&init))) {
+        next = constant(loc, init * scale);
+      } else {
+        next = builder.create<arith::MulIOp>(loc, operands[arg.getArgNumber()],
+                                             constant(loc, scale));
+        created.insert(next.getDefiningOp());
+      }
+      operands.append(next);
+    }
+    for (Operation *user : users) {
+      user->getResult(0).replaceAllUsesWith(scaledArg);
+      user->erase();
+      ++numReduced;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createStrengthReducePass() {
+  return std::make_unique<StrengthReducePass>();
+}
+} // namespace circt_hls
@@ -0,0 +1,330 @@
+//===- ThroughputBound.cpp - Static handshake throughput bound ---*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Computes the throughput bound of each loop of a handshake function, by
+// modeling the function as a marked graph and finding the cycle of the
+// maximum ratio of latency to tokens.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "circt/Dialect/Handshake/HandshakeOps.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace mlir;
+using namespace circt;
+using namespace circt_hls;
+
+namespace {
+
+/// A channel of the marked graph, from the op at node 'src' to the op at node
+/// 'dst'. A token takes 'latency' cycles to cross the channel, which holds
+/// 'tokens' tokens initially.
+struct Channel {
+  unsigned src;
+  unsigned dst;
+  int64_t latency;
+  int64_t tokens;
+};
+
+/// The marked graph of a handshake function, whose nodes are the ops of the
+/// function.
+struct MarkedGraph {
+  SmallVector<Operation *> ops;
+  SmallVector<Channel> channels;
+  // Indices of the channels leaving each node.
+  SmallVector<SmallVector<unsigned>> succs;
+};
+
+/// A cycle of the marked graph, as the channels along the cycle.
+struct Cycle {
+  SmallVector<unsigned> channels;
+  int64_t latency = 0;
+  int64_t tokens = 0;
+};
+
+} // namespace
+
+/// Returns the number of cycles that the results of 'op' take to be produced
+/// after its operands were accepted. Sequential buffers register each slot,
+/// memories answer a load in the next cycle, and all other ops are
+/// combinational, unless the op has an integer 'latency' attribute.
+static int64_t getLatency(Operation *op) {
+  if (auto latencyAttr = op->getAttrOfType<IntegerAttr>("latency"))
+    return latencyAttr.getInt();
+  if (auto bufferOp = dyn_cast<handshake::BufferOp>(op))
+    return bufferOp.getBufferType() == handshake::BufferTypeEnum::seq
+               ? bufferOp.getNumSlots()
+               : 0;
+  if (isa<handshake::MemoryOp, handshake::ExternalMemoryOp>(op))
+    return 1;
+  return 0;
+}
+
+/// Returns the number of tokens which 'op' holds initially.
+static int64_t getInitialTokens(Operation *op) {
+  if (auto initAttr = op->getAttrOfType<ArrayAttr>("initValues"))
+    return initAttr.size();
+  return 0;
+}
+
+/// Returns the name of 'op' in a critical cycle: the name of the instance that
+/// it is lowered to, if it has a 'handshake_id', and otherwise its op name and
+/// its index within the function.
+static std::string getOpName(Operation *op, unsigned idx) {
+  std::string name = op->getName().getStringRef().str();
+  if (auto idAttr = op->getAttrOfType<IntegerAttr>("handshake_id")) {
+    std::replace(name.begin(), name.end(), '.', '_');
+    return name + std::to_string(idAttr.getInt());
+  }
+  return name + "#" + std::to_string(idx);
+}
+
+/// Builds the marked graph of 'f'. Every cycle of a handshake function passes
+/// through a back edge of a depth-first traversal of its ops, which is where a
+/// loop admits its next iteration once the current one has come around, so
+/// each back edge carries a token, unless its source initially holds tokens.
+static MarkedGraph buildGraph(handshake::FuncOp f) {
+  MarkedGraph graph;
+  DenseMap<Operation *, unsigned> nodes;
+  for (Operation &op : f.getOps()) {
+    nodes[&op] = graph.ops.size();
+    graph.ops.push_back(&op);
+  }
+  graph.succs.resize(graph.ops.size());
+  for (unsigned idx = 0; idx < graph.ops.size(); ++idx) {
+    Operation *op = graph.ops[idx];
+    for (Value res : op->getResults()) {
+      for (Operation *user : res.getUsers()) {
+        auto it = nodes.find(user);
+        if (it == nodes.end())
+          continue;
+        graph.succs[idx].push_back(graph.channels.size());
+        graph.channels.push_back(
+            {idx, it->second, getLatency(op), getInitialTokens(op)});
+      }
+    }
+  }
+
+  // Depth-first traversal from each op in order, to find the back edges.
+  enum class Visit { New, Active, Done };
+  SmallVector<Visit> state(graph.ops.size(), Visit::New);
+  for (unsigned root = 0; root < graph.ops.size(); ++root) {
+    if (state[root] != Visit::New)
+      continue;
+    // Stack of nodes, and of the next successor of each to visit.
+    SmallVector<std::pair<unsigned, unsigned>> stack = {{root, 0}};
+    state[root] = Visit::Active;
+    while (!stack.empty()) {
+      unsigned node = stack.back().first;
+      unsigned next = stack.back().second++;
+      if (next == graph.succs[node].size()) {
+        state[node] = Visit::Done;
+        stack.pop_back();
+        continue;
+      }
+      Channel &channel = graph.channels[graph.succs[node][next]];
+      if (state[channel.dst] == Visit::Active) {
+        if (channel.tokens == 0)
+          channel.tokens = 1;
+      } else if (state[channel.dst] == Visit::New) {
+        state[channel.dst] = Visit::Active;
+        stack.push_back({channel.dst, 0});
+      }
+    }
+  }
+  return graph;
+}
+
+/// Returns the strongly connected components of 'graph' with more than one
+/// node, or with a channel to itself, i.e. its loops, by Tarjan's algorithm.
+static SmallVector<SmallVector<unsigned>> getLoops(const MarkedGraph &graph) {
+  SmallVector<SmallVector<unsigned>> loops;
+  unsigned numNodes = graph.ops.size();
+  SmallVector<int64_t> index(numNodes, -1), lowLink(numNodes, 0);
+  SmallVector<bool> onStack(numNodes, false);
+  SmallVector<unsigned> sccStack;
+  int64_t nextIndex = 0;
+  for (unsigned root = 0; root < numNodes; ++root) {
+    if (index[root] >= 0)
+      continue;
+    SmallVector<std::pair<unsigned, unsigned>> stack = {{root, 0}};
+    while (!stack.empty()) {
+      unsigned node = stack.back().first;
+      unsigned next = stack.back().second++;
+      if (next == 0) {
+        index[node] = lowLink[node] = nextIndex++;
+        sccStack.push_back(node);
+        onStack[node] = true;
+      }
+      if (next < graph.succs[node].size()) {
+        unsigned dst = graph.channels[graph.succs[node][next]].dst;
+        if (index[dst] < 0)
+          stack.push_back({dst, 0});
+        else if (onStack[dst])
+          lowLink[node] = std::min(lowLink[node], index[dst]);
+        continue;
+      }
+      stack.pop_back();
+      if (!stack.empty()) {
+        unsigned parent = stack.back().first;
+        lowLink[parent] = std::min(lowLink[parent], lowLink[node]);
+      }
+      if (lowLink[node] != index[node])
+        continue;
+      SmallVector<unsigned> scc;
+      unsigned member;
+      do {
+        member = sccStack.pop_back_val();
+        onStack[member] = false;
+        scc.push_back(member);
+      } while (member != node);
+      bool selfLoop = llvm::any_of(graph.succs[node], [&](unsigned c) {
+        return graph.channels[c].dst == node;
+      });
+      if (scc.size() > 1 || selfLoop) {
+        llvm::sort(scc);
+        loops.push_back(std::move(scc));
+      }
+    }
+  }
+  return loops;
+}
+
+/// Returns a cycle within the nodes 'scc' of 'graph' whose ratio of latency to
+/// tokens exceeds 'ratio', if there is one. The cycle is found as a positive
+/// cycle of the channel weights 'latency - ratio * tokens' by Bellman-Ford.
+static Optional<Cycle> findCycleAbove(const MarkedGraph &graph,
+                                      ArrayRef<unsigned> scc,
+                                      const DenseMap<unsigned, unsigned> &inScc,
+                                      double ratio) {
+  SmallVector<double> dist(scc.size(), 0.0);
+  SmallVector<int64_t> pred(scc.size(), -1);
+  int64_t relaxed = -1;
+  for (unsigned iter = 0; iter <= scc.size(); ++iter) {
+    relaxed = -1;
+    for (unsigned i = 0; i < scc.size(); ++i) {
+      for (unsigned c : graph.succs[scc[i]]) {
+        const Channel &channel = graph.channels[c];
+        auto it = inScc.find(channel.dst);
+        if (it == inScc.end())
+          continue;
+        double weight = channel.latency - ratio * channel.tokens;
+        if (dist[i] + weight > dist[it->second] + 1e-9) {
+          dist[it->second] = dist[i] + weight;
+          pred[it->second] = c;
+          relaxed = it->second;
+        }
+      }
+    }
+    if (relaxed < 0)
+      return {};
+  }
+
+  // A node which was still relaxed after as many iterations as there are
+  // nodes reaches a positive cycle through its predecessors; walk back into
+  // the cycle, and then around it.
+  unsigned node = relaxed;
+  for (unsigned i = 0; i < scc.size(); ++i)
+    node = inScc.lookup(graph.channels[pred[node]].src);
+  Cycle cycle;
+  unsigned start = node;
+  do {
+    const Channel &channel = graph.channels[pred[node]];
+    cycle.channels.push_back(pred[node]);
+    cycle.latency += channel.latency;
+    cycle.tokens += channel.tokens;
+    node = inScc.lookup(channel.src);
+  } while (node != start);
+  std::reverse(cycle.channels.begin(), cycle.channels.end());
+
+  // Start the cycle at its first op, for a stable report.
+  auto first = llvm::min_element(cycle.channels, [&](unsigned a, unsigned b) {
+    return graph.channels[a].src < graph.channels[b].src;
+  });
+  std::rotate(cycle.channels.begin(), first, cycle.channels.end());
+  return cycle;
+}
+
+/// Returns the cycle of the maximum ratio of latency to tokens within the
+/// nodes 'scc' of 'graph', or None if no cycle has any latency.
+static Optional<Cycle> findCriticalCycle(const MarkedGraph &graph,
+                                         ArrayRef<unsigned> scc) {
+  DenseMap<unsigned, unsigned> inScc;
+  for (unsigned i = 0; i < scc.size(); ++i)
+    inScc[scc[i]] = i;
+
+  // Improve on the best cycle found so far until no cycle of a higher ratio is
+  // left. Each search finds a cycle of a strictly higher ratio, and there are
+  // finitely many cycles, so the search terminates.
+  Optional<Cycle> best = findCycleAbove(graph, scc, inScc, 0.0);
+  while (best) {
+    double ratio = double(best->latency) / best->tokens;
+    Optional<Cycle> next = findCycleAbove(graph, scc, inScc, ratio);
+    if (!next)
+      break;
+    best = std::move(next);
+  }
+  return best;
+}
+
+namespace {
+
+struct ThroughputBoundPass : public ThroughputBoundBase<ThroughputBoundPass> {
+public:
+  void runOnOperation() override {
+    handshake::FuncOp f = getOperation();
+    MarkedGraph graph = buildGraph(f);
+
+    // Each loop of the function is bounded by its critical cycle. Loops
+    // without latency, e.g. between the ops of a combinational handshake, do
+    // not bound the throughput.
+    bool failed = false;
+    for (ArrayRef<unsigned> scc : getLoops(graph)) {
+      Optional<Cycle> cycle = findCriticalCycle(graph, scc);
+      if (!cycle)
+        continue;
+      int64_t gcd = std::gcd(cycle->latency, cycle->tokens);
+      std::string ii = std::to_string(cycle->latency / gcd);
+      if (cycle->tokens != gcd)
+        ii += "/" + std::to_string(cycle->tokens / gcd);
+
+      std::string names;
+      for (unsigned c : cycle->channels) {
+        unsigned src = graph.channels[c].src;
+        if (!names.empty())
+          names += ", ";
+        names += getOpName(graph.ops[src], src);
+      }
+
+      Operation *loopOp = graph.ops[scc.front()];
+      bool exceeds = maxII != 0 && cycle->latency > maxII * cycle->tokens;
+      auto diag = exceeds ? loopOp->emitError() : loopOp->emitRemark();
+      diag << "loop of " << scc.size()
+           << " ops is bounded by an initiation interval of " << ii
+           << " cycles, on the critical cycle: " << names;
+      if (exceeds)
+        diag << " (exceeds the maximum of " << maxII << ")";
+      failed |= exceeds;
+    }
+    if (failed)
+      signalPassFailure();
+  }
+};
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createThroughputBoundPass() {
+  return std::make_unique<ThroughputBoundPass>();
+}
+} // namespace circt_hls
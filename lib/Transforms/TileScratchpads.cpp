@@ -0,0 +1,114 @@
+//===- TileScratchpads.cpp - Loop tiling with scratchpads --------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Tiles the loop nests of a kernel, and copies the tile of each memref
+// argument which a tile of iterations accesses into a local scratchpad
+// memref, such that the kernel accesses the host memories in bulk copies
+// only.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Dialect/Affine/Analysis/LoopAnalysis.h"
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Affine/LoopUtils.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/IR/Builders.h"
+#include "llvm/ADT/DenseSet.h"
+
+#include <limits>
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+namespace {
+
+struct TileScratchpadsPass : public TileScratchpadsBase<TileScratchpadsPass> {
+public:
+  void runOnOperation() override {
+    FuncOp f = getOperation();
+    if (f.isExternal() || tileSize == 0)
+      return;
+
+    // Allocations which exist before the pass are left in place.
+    DenseSet<Operation *> allocOps;
+    f.walk([&](memref::AllocOp allocOp) { allocOps.insert(allocOp); });
+
+    std::vector<SmallVector<AffineForOp, 6>> bands;
+    getTileableBands(f, &bands);
+    for (auto &band : bands)
+      tile(band);
+
+    // Scratchpads of a constant shape are allocated once for the kernel, and
+    // reused by each tile, since the handshake lowering only serves the
+    // allocations at the top level of the kernel by internal memories.
+    Block &entryBlock = f.getBody().front();
+    SmallVector<memref::AllocOp> scratchpads;
+    f.walk([&](memref::AllocOp allocOp) {
+      if (!allocOps.contains(allocOp) && allocOp->getNumOperands() == 0)
+        scratchpads.push_back(allocOp);
+    });
+    for (memref::AllocOp allocOp : llvm::reverse(scratchpads)) {
+      for (Operation *user : llvm::make_early_inc_range(allocOp->getUsers()))
+        if (isa<memref::DeallocOp>(user))
+          user->erase();
+      allocOp->moveBefore(&entryBlock, entryBlock.begin());
+    }
+  }
+
+private:
+  /// Tiles the perfectly nested loops of 'band', and generates the copies of
+  /// the memref arguments of the kernel around the intra-tile loops.
+  void tile(MutableArrayRef<AffineForOp> band);
+};
+
+void TileScratchpadsPass::tile(MutableArrayRef<AffineForOp> band) {
+  // Loops which are no longer than a tile are not tiled.
+  SmallVector<unsigned> tileSizes;
+  bool isTiled = false;
+  for (AffineForOp forOp : band) {
+    Optional<uint64_t> tripCount = getConstantTripCount(forOp);
+    if (!tripCount)
+      return;
+    tileSizes.push_back(std::min<uint64_t>(*tripCount, tileSize));
+    isTiled |= *tripCount > tileSize;
+  }
+  SmallVector<AffineForOp, 6> tiledNest;
+  if (!isTiled || failed(tilePerfectlyNested(band, tileSizes, &tiledNest)))
+    return;
+  ++numTiled;
+
+  // The kernel arguments are copied into scratchpads in the innermost
+  // inter-tile loop. Local memrefs are already served by internal memories.
+  AffineForOp intraTileForOp = tiledNest[band.size()];
+  Block::iterator begin(intraTileForOp);
+  AffineCopyOptions copyOptions = {
+      /*generateDma=*/false, /*slowMemorySpace=*/0, /*fastMemorySpace=*/0,
+      /*tagMemorySpace=*/0,
+      /*fastMemCapacityBytes=*/std::numeric_limits<uint64_t>::max()};
+  auto f = intraTileForOp->getParentOfType<FuncOp>();
+  for (BlockArgument arg : f.getArguments()) {
+    if (!arg.getType().isa<MemRefType>())
+      continue;
+    DenseSet<Operation *> copyNests;
+    if (succeeded(affineDataCopyGenerate(begin, std::next(begin), copyOptions,
+                                         arg, copyNests)) &&
+        !copyNests.empty())
+      ++numScratchpads;
+  }
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createTileScratchpadsPass() {
+  return std::make_unique<TileScratchpadsPass>();
+}
+} // namespace circt_hls
@@ -0,0 +1,230 @@
+//===- UnrollLoops.cpp - Cost-model driven loop unrolling --------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Unrolls, or unrolls and jams, innermost loops by a factor chosen from the
+// memory bandwidth which the handshake lowering of the loop can exploit.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetail.h"
+#include "mlir/Dialect/Affine/Analysis/AffineAnalysis.h"
+#include "mlir/Dialect/Affine/Analysis/LoopAnalysis.h"
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Affine/LoopUtils.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/SCF/Utils/Utils.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "llvm/ADT/MapVector.h"
+
+using namespace mlir;
+using namespace func;
+using namespace circt_hls;
+
+namespace {
+
+/// The cost of a single iteration of a loop: the number of ops in its body,
+/// and the number of accesses to each memref.
+struct LoopCost {
+  unsigned numOps = 0;
+  llvm::MapVector<Value, unsigned> accesses;
+};
+
+} // namespace
+
+static bool isLoop(Operation *op) { return isa<AffineForOp, scf::ForOp>(op); }
+
+/// Returns the number of loops nested within 'op'.
+static unsigned getNumNestedLoops(Operation *op) {
+  unsigned numLoops = 0;
+  op->getRegion(0).walk([&](Operation *nested) {
+    if (isLoop(nested))
+      ++numLoops;
+  });
+  return numLoops;
+}
+
+/// Returns the cost of an iteration of 'loop'.
+static LoopCost getLoopCost(Operation *loop) {
+  LoopCost cost;
+  loop->getRegion(0).walk([&](Operation *op) {
+    if (op->hasTrait<OpTrait::IsTerminator>())
+      return;
+    ++cost.numOps;
+    Value memref;
+    if (auto readOp = dyn_cast<AffineReadOpInterface>(op))
+      memref = readOp.getMemRef();
+    else if (auto writeOp = dyn_cast<AffineWriteOpInterface>(op))
+      memref = writeOp.getMemRef();
+    else if (auto loadOp = dyn_cast<memref::LoadOp>(op))
+      memref = loadOp.getMemRef();
+    else if (auto storeOp = dyn_cast<memref::StoreOp>(op))
+      memref = storeOp.getMemRef();
+    if (memref)
+      ++cost.accesses[memref];
+  });
+  return cost;
+}
+
+/// Returns the trip count of 'loop', if it is constant.
+static Optional<uint64_t> getTripCount(Operation *loop) {
+  if (auto forOp = dyn_cast<AffineForOp>(loop))
+    return getConstantTripCount(forOp);
+  auto forOp = cast<scf::ForOp>(loop);
+  auto lb = getConstantIntValue(forOp.getLowerBound());
+  auto ub = getConstantIntValue(forOp.getUpperBound());
+  auto step = getConstantIntValue(forOp.getStep());
+  if (!lb || !ub || !step || *step <= 0)
+    return {};
+  if (*ub <= *lb)
+    return 0;
+  return llvm::divideCeil(*ub - *lb, *step);
+}
+
+/// Returns true if 'memref' is a bank of a memref partitioned by
+/// -affine-partition-memrefs.
+static bool isPartitionBank(Value memref) {
+  auto arg = memref.dyn_cast<BlockArgument>();
+  if (!arg)
+    return false;
+  auto f = dyn_cast<FuncOp>(arg.getOwner()->getParentOp());
+  return f && f.getArgAttr(arg.getArgNumber(), "hlt.partition");
+}
+
+// The unroll factor which a pragma requests of a loop (see
+// -hls-apply-loop-pragmas); 0 unrolls the loop fully.
+static constexpr StringLiteral kUnrollAttr = "hls.unroll";
+
+namespace {
+
+struct UnrollLoopsPass : public UnrollLoopsBase<UnrollLoopsPass> {
+public:
+  void runOnOperation() override {
+    // Loops with a pragma are unrolled as requested, innermost first, after
+    // the cost model has unrolled the others.
+    SmallVector<Operation *> loops, pragmaLoops;
+    getOperation().walk([&](Operation *op) {
+      if (!isLoop(op))
+        return;
+      if (op->hasAttr(kUnrollAttr))
+        pragmaLoops.push_back(op);
+      else if (getNumNestedLoops(op) == 0)
+        loops.push_back(op);
+    });
+    for (Operation *loop : loops)
+      unrollLoop(loop);
+    for (Operation *loop : pragmaLoops)
+      unrollPragmaLoop(loop);
+  }
+
+private:
+  /// Unrolls 'loop', or unrolls its parent loop and jams it into 'loop'.
+  void unrollLoop(Operation *loop);
+
+  /// Unrolls 'loop' by the factor of its unroll pragma.
+  void unrollPragmaLoop(Operation *loop);
+
+  /// Returns the unroll factor of a loop with cost 'cost' and trip count
+  /// 'tripCount'.
+  unsigned getUnrollFactor(const LoopCost &cost, Optional<uint64_t> tripCount);
+};
+
+unsigned UnrollLoopsPass::getUnrollFactor(const LoopCost &cost,
+                                          Optional<uint64_t> tripCount) {
+  // Each unrolled iteration adds to the size of the circuit.
+  unsigned factor = maxFactor;
+  if (cost.numOps != 0)
+    factor = std::min(factor, maxOps / cost.numOps);
+
+  // A loop of a circuit executes an iteration every 'iteration-latency'
+  // cycles, in which each memory may serve 'ports' accesses; unrolling past
+  // this only adds contention on the memory. Memrefs which are yet to be
+  // partitioned are expected to be split into 'partition-factor' memories.
+  for (auto &it : cost.accesses) {
+    unsigned banks = isPartitionBank(it.first) ? 1 : partitionFactor;
+    factor = std::min(factor, iterationLatency * ports * banks / it.second);
+  }
+
+  // Prefer factors which divide the trip count, such that no epilogue loop is
+  // needed.
+  if (tripCount) {
+    factor = std::min<uint64_t>(factor, *tripCount);
+    while (factor > 1 && *tripCount % factor != 0)
+      --factor;
+  }
+  return factor;
+}
+
+void UnrollLoopsPass::unrollLoop(Operation *loop) {
+  // Iterations of a loop which carries a value (e.g. a reduction) are
+  // serialized through the value, so unrolling the loop adds little
+  // parallelism. Instead, independent iterations of a parallel parent loop
+  // are jammed into the loop.
+  auto innerOp = dyn_cast<AffineForOp>(loop);
+  auto outerOp = dyn_cast_or_null<AffineForOp>(loop->getParentOp());
+  if (innerOp && outerOp && !outerOp->hasAttr(kUnrollAttr) &&
+      innerOp.getNumIterOperands() != 0 &&
+      getNumNestedLoops(outerOp) == 1 && isLoopParallel(outerOp)) {
+    unsigned factor =
+        getUnrollFactor(getLoopCost(outerOp), getConstantTripCount(outerOp));
+    if (factor > 1 && succeeded(loopUnrollJamByFactor(outerOp, factor))) {
+      ++numJammed;
+      return;
+    }
+  }
+
+  unsigned factor = getUnrollFactor(getLoopCost(loop), getTripCount(loop));
+  if (factor < 2)
+    return;
+  LogicalResult res = failure();
+  if (auto forOp = dyn_cast<AffineForOp>(loop))
+    res = loopUnrollByFactor(forOp, factor);
+  else
+    res = loopUnrollByFactor(cast<scf::ForOp>(loop), factor);
+  if (succeeded(res))
+    ++numUnrolled;
+}
+
+void UnrollLoopsPass::unrollPragmaLoop(Operation *loop) {
+  int64_t factor = loop->getAttrOfType<IntegerAttr>(kUnrollAttr).getInt();
+  loop->removeAttr(kUnrollAttr);
+  if (factor == 1)
+    return;
+
+  // A full unroll unrolls the loop by its trip count.
+  Optional<uint64_t> tripCount = getTripCount(loop);
+  if (factor == 0) {
+    if (!tripCount) {
+      loop->emitWarning() << "cannot fully unroll a loop with a trip count "
+                             "that is not constant";
+      return;
+    }
+    factor = *tripCount;
+  }
+  if (factor < 2)
+    return;
+
+  LogicalResult res = failure();
+  if (auto forOp = dyn_cast<AffineForOp>(loop))
+    res = loopUnrollByFactor(forOp, factor);
+  else
+    res = loopUnrollByFactor(cast<scf::ForOp>(loop), factor);
+  if (succeeded(res))
+    ++numUnrolled;
+  else
+    loop->emitWarning() << "could not unroll the loop by " << factor;
+}
+
+} // namespace
+
+namespace circt_hls {
+std::unique_ptr<mlir::Pass> createUnrollLoopsPass() {
+  return std::make_unique<UnrollLoopsPass>();
+}
+} // namespace circt_hls
@@ -5,6 +5,11 @@ import os
 from fud.stages import SourceType, Stage
 from fud.utils import shell
 
+# Tools which parse and print MLIR, and which can print it as bytecode instead
+# when 'stages.circt.bytecode' is set. Bytecode is cheaper for the next stage
+# to parse than the textual format.
+BYTECODE_TOOLS = ["circt-opt", "hls-opt"]
+
 
 class CIRCTStageBase(Stage):
     """
@@ -28,10 +33,17 @@ class CIRCTStageBase(Stage):
             config,
             description
         )
+        self.src = src
+        self.dst = dst
+        self.tool = executable
         self.executable = os.path.join(
             self.config["stages", "circt", "bin_dir"],
             executable)
+        self.passFlags = flags
         self.flags = flags
+        if executable in BYTECODE_TOOLS and \
+                self.config.get(["stages", "circt", "bytecode"]):
+            self.flags += " --emit-bytecode"
         self.setup()
 
     @staticmethod
@@ -60,6 +72,29 @@ class CIRCTStageBase(Stage):
         return compile_with_circt(input_file)
 
 
+class CIRCTFusedStage(CIRCTStageBase):
+    """
+    Runs a chain of consecutive stages of the same tool as a single
+    invocation of the tool, such that the module is parsed and printed once,
+    rather than at each boundary between the stages. The passes of the stages
+    run in order within the pass manager of the tool.
+    """
+
+    def __init__(self, config, stages, description):
+        stages = [stage(config) for stage in stages]
+        for prev, next in zip(stages, stages[1:]):
+            assert prev.dst == next.src and prev.tool == next.tool, \
+                "Only consecutive stages of the same tool can be fused"
+        super().__init__(
+            stages[0].src,
+            stages[-1].dst,
+            stages[0].tool,
+            config,
+            description,
+            " ".join(stage.passFlags for stage in stages)
+        )
+
+
 class CIRCTFlattenMemRefs(CIRCTStageBase):
     def __init__(self, config):
         super().__init__(
@@ -143,6 +178,20 @@ class CIRCTFIRRTLToVerilog(CIRCTStageBase):
         )
 
 
+class CIRCTStdToFIRRTL(CIRCTFusedStage):
+    def __init__(self, config):
+        super().__init__(
+            config,
+            [
+                CIRCTFlattenMemRefs,
+                CIRCTSCFToDataflow,
+                CIRCTHandshakeBufferize,
+                CIRCTHandshakeToFIRRTL
+            ],
+            "Lower MLIR standard to MLIR FIRRTL in one circt-opt invocation"
+        )
+
+
 __STAGES__ = [
     CIRCTSCFToCalyxStage,
     CIRCTEmitCalyxStage,
@@ -150,5 +199,6 @@ __STAGES__ = [
     CIRCTSCFToDataflow,
     CIRCTFlattenMemRefs,
     CIRCTFIRRTLToVerilog,
-    CIRCTHandshakeBufferize
+    CIRCTHandshakeBufferize,
+    CIRCTStdToFIRRTL
 ]
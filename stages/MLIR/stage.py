@@ -31,6 +31,8 @@ class MLIRStageBase(Stage):
         self.executable = os.path.join(
             self.config["stages", "mlir", "bin_dir"],
             executable)
+        self.tool = executable
+        self.passFlags = flags
         self.flags = flags
         self.setup()
 
@@ -0,0 +1,155 @@
+"""
+Runs a CIRCT or MLIR fud stage over many inputs, with a single invocation of
+the tool of the stage, such that the startup of the tool and the registration
+of its dialects are paid once rather than once per input. The inputs are
+concatenated as the chunks of a single '--split-input-file' input, and the
+printed chunks are written back to the outputs of the inputs.
+
+    python3 stages/batch.py <stage> <manifest>
+
+The manifest holds an input and an output path per line; blank lines and
+lines starting with '#' are ignored. <stage> is the class name of a stage of
+stages/CIRCT/stage.py or stages/MLIR/stage.py, e.g. CIRCTStdToFIRRTL.
+"""
+
+import argparse
+import importlib.util
+import os
+import subprocess
+import sys
+
+from fud.config import Configuration
+
+# The marker between the chunks of a split input, and between the printed
+# results of the chunks.
+SPLIT_MARKER = "// -----"
+
+# Tools which support '--split-input-file', and print the result of each chunk.
+SPLIT_TOOLS = ["mlir-opt", "circt-opt", "hls-opt", "circt-translate"]
+
+STAGE_FILES = ["CIRCT/stage.py", "MLIR/stage.py"]
+
+
+def readManifest(manifest):
+    """ Returns the (input, output) pairs of 'manifest'. """
+    entries = []
+    with open(manifest, "r") as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            paths = line.split()
+            if len(paths) != 2:
+                raise ValueError(
+                    f"{manifest}:{lineno}: expected an input and an output path")
+            base = os.path.dirname(os.path.abspath(manifest))
+            entries.append(tuple(os.path.join(base, p) for p in paths))
+    return entries
+
+
+def runTool(cmd, source):
+    # Returns the output of 'cmd' on 'source', or None if the tool failed.
+    res = subprocess.run(cmd, input=source, shell=True, text=True,
+                         stdout=subprocess.PIPE)
+    return res.stdout if res.returncode == 0 else None
+
+
+def splitOutput(output, count):
+    # Returns the printed results of the 'count' chunks of 'output', or None if
+    # they cannot be told apart.
+    chunks = []
+    current = []
+    for line in output.splitlines(keepends=True):
+        if line.strip() == SPLIT_MARKER:
+            chunks.append("".join(current))
+            current = []
+        else:
+            current.append(line)
+    chunks.append("".join(current))
+    return chunks if len(chunks) == count else None
+
+
+def runBatch(stage, entries):
+    """ Runs 'stage' over each (input, output) pair of 'entries', and returns
+    the inputs for which the stage failed.
+    """
+    cmd = " ".join([stage.executable, stage.passFlags])
+    sources = []
+    for input, _ in entries:
+        with open(input, "r") as f:
+            sources.append(f.read())
+
+    # Inputs which are split themselves would not map back to their outputs,
+    # and are run on their own.
+    batched = [i for i, s in enumerate(sources)
+               if not any(l.strip() == SPLIT_MARKER for l in s.splitlines())]
+    single = sorted(set(range(len(entries))) - set(batched))
+    results = {}
+    if batched:
+        source = f"\n{SPLIT_MARKER}\n".join(sources[i] for i in batched)
+        output = runTool(f"{cmd} --split-input-file", source)
+        chunks = splitOutput(output, len(batched)) if output is not None \
+            else None
+        if chunks is None:
+            # The tool fails the whole batch if any input fails; each input is
+            # rerun on its own to find those which failed.
+            single = list(range(len(entries)))
+        else:
+            results = dict(zip(batched, chunks))
+    for i in single:
+        results[i] = runTool(cmd, sources[i])
+
+    failed = []
+    for i, (input, output) in enumerate(entries):
+        if results[i] is None:
+            failed.append(input)
+            continue
+        os.makedirs(os.path.dirname(output) or ".", exist_ok=True)
+        with open(output, "w") as f:
+            f.write(results[i])
+    return failed
+
+
+def loadStage(name):
+    # Returns the stage class 'name' of the CIRCT and MLIR stages.
+    stagesDir = os.path.dirname(os.path.abspath(__file__))
+    for stageFile in STAGE_FILES:
+        path = os.path.join(stagesDir, stageFile)
+        spec = importlib.util.spec_from_file_location(
+            os.path.splitext(stageFile)[0].replace("/", "."), path)
+        module = importlib.util.module_from_spec(spec)
+        spec.loader.exec_module(module)
+        for stage in module.__STAGES__:
+            if stage.__name__ == name:
+                return stage
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Run a fud stage over the inputs of a manifest with a "
+        "single invocation of its tool.")
+    parser.add_argument("stage", help="Class name of the stage to run.")
+    parser.add_argument("manifest",
+                        help="File of an input and an output path per line.")
+    args = parser.parse_args()
+
+    stageClass = loadStage(args.stage)
+    if stageClass is None:
+        sys.exit(f"Unknown stage '{args.stage}'")
+    stage = stageClass(Configuration())
+    if stage.tool not in SPLIT_TOOLS:
+        sys.exit(f"Stage '{args.stage}' runs '{stage.tool}', which cannot "
+                 "process split inputs")
+
+    entries = readManifest(args.manifest)
+    failed = runBatch(stage, entries)
+    print(f"Ran {args.stage} over {len(entries) - len(failed)} of "
+          f"{len(entries)} inputs")
+    for input in failed:
+        print(f"Failed: {input}", file=sys.stderr)
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,4 +1,9 @@
 // RUN: hls-opt --split-input-file --cosim-lower-call %s | FileCheck %s
+// RUN: hls-opt --split-input-file --cosim-lower-call="async-targets" %s | FileCheck %s --check-prefix=ASYNC
+// RUN: hls-opt --split-input-file --cosim-lower-call="sample=4" %s | FileCheck %s --check-prefix=SAMPLE
+// RUN: hls-opt --split-input-file --cosim-lower-call="steady-state" %s | FileCheck %s --check-prefix=STEADY
+// RUN: hls-opt --split-input-file --cosim-lower-call="memoize-ref" %s | FileCheck %s --check-prefix=MEMO
+// RUN: hls-opt --split-input-file --cosim-lower-call="cow-snapshots" %s | FileCheck %s --check-prefix=COW
 
 // CHECK-LABEL:   func.func @wrap_simple() {
 // CHECK:           %[[VAL_0:.*]] = arith.constant 0 : i32
@@ -156,3 +161,367 @@ module {
   }
   func.func private @foo(i32, i32) -> i32
 }
+
+// -----
+
+// Memrefs which are only read by the reference and all targets are passed
+// without copying, and are not compared.
+
+// CHECK-LABEL:   func.func @wrap_readonly_memref(
+// CHECK-SAME:                                    %[[VAL_0:.*]]: memref<100xi32>, %[[VAL_1:.*]]: memref<100xi32>) {
+// CHECK:           %[[VAL_2:.*]] = memref.alloc() : memref<100xi32>
+// CHECK:           memref.copy %[[VAL_1]], %[[VAL_2]] : memref<100xi32> to memref<100xi32>
+// CHECK-NOT:       memref.copy %[[VAL_0]]
+// CHECK:           call @foo(%[[VAL_0]], %[[VAL_1]]) : (memref<100xi32>, memref<100xi32>) -> ()
+// CHECK:           call @foo_hlt(%[[VAL_0]], %[[VAL_2]]) : (memref<100xi32>, memref<100xi32>) -> ()
+// CHECK-NOT:       cosim.compare %[[VAL_0]]
+// CHECK:           cosim.compare %[[VAL_1]], %[[VAL_2]] : memref<100xi32>
+// CHECK:           return
+// CHECK:         }
+module {
+  func.func @wrap_readonly_memref(%a : memref<100xi32>, %b : memref<100xi32>) {
+    cosim.call @foo(%a, %b) : (memref<100xi32>, memref<100xi32>) -> ()
+    {
+      targets = ["foo_hlt"],
+      ref = "foo"
+    }
+    return
+  }
+  func.func @foo(%a : memref<100xi32>, %b : memref<100xi32>) {
+    %c0 = arith.constant 0 : index
+    %0 = memref.load %a[%c0] : memref<100xi32>
+    memref.store %0, %b[%c0] : memref<100xi32>
+    return
+  }
+  func.func private @foo_hlt(memref<100xi32> {llvm.readonly}, memref<100xi32>)
+}
+
+// -----
+
+// The reference passes the pointer of a memref on, through which it may be
+// written, so the memref is copied although it is read-only for the target.
+
+// CHECK-LABEL:   func.func @wrap_escaping_memref(
+// CHECK-SAME:                                    %[[VAL_0:.*]]: memref<100xi32>) {
+// CHECK:           %[[VAL_1:.*]] = memref.alloc() : memref<100xi32>
+// CHECK:           memref.copy %[[VAL_0]], %[[VAL_1]] : memref<100xi32> to memref<100xi32>
+// CHECK:           call @foo(%[[VAL_0]]) : (memref<100xi32>) -> ()
+// CHECK:           call @foo_hlt(%[[VAL_1]]) : (memref<100xi32>) -> ()
+// CHECK:           cosim.compare %[[VAL_0]], %[[VAL_1]] : memref<100xi32>
+// CHECK:           return
+// CHECK:         }
+module {
+  func.func @wrap_escaping_memref(%a : memref<100xi32>) {
+    cosim.call @foo(%a) : (memref<100xi32>) -> ()
+    {
+      targets = ["foo_hlt"],
+      ref = "foo"
+    }
+    return
+  }
+  func.func @foo(%a : memref<100xi32>) {
+    %0 = memref.extract_aligned_pointer_as_index %a : memref<100xi32> -> index
+    call @bar(%0) : (index) -> ()
+    return
+  }
+  func.func private @bar(index)
+  func.func private @foo_hlt(memref<100xi32> {llvm.readonly})
+}
+
+// -----
+
+// A memref which is passed through several arguments, of which one may be
+// written, is copied once, and the copy is passed through all of them.
+
+// CHECK-LABEL:   func.func @wrap_aliased_memref(
+// CHECK-SAME:                                   %[[VAL_0:.*]]: memref<100xi32>) {
+// CHECK:           %[[VAL_1:.*]] = memref.alloc() : memref<100xi32>
+// CHECK:           memref.copy %[[VAL_0]], %[[VAL_1]] : memref<100xi32> to memref<100xi32>
+// CHECK-NOT:       memref.alloc
+// CHECK:           call @foo(%[[VAL_0]], %[[VAL_0]]) : (memref<100xi32>, memref<100xi32>) -> ()
+// CHECK:           call @foo_hlt(%[[VAL_1]], %[[VAL_1]]) : (memref<100xi32>, memref<100xi32>) -> ()
+// CHECK:           cosim.compare %[[VAL_0]], %[[VAL_1]] : memref<100xi32>
+// CHECK-NOT:       cosim.compare
+// CHECK:           return
+// CHECK:         }
+module {
+  func.func @wrap_aliased_memref(%a : memref<100xi32>) {
+    cosim.call @foo(%a, %a) : (memref<100xi32>, memref<100xi32>) -> ()
+    {
+      targets = ["foo_hlt"],
+      ref = "foo"
+    }
+    return
+  }
+  func.func @foo(%a : memref<100xi32>, %b : memref<100xi32>) {
+    %c0 = arith.constant 0 : index
+    %0 = memref.load %a[%c0] : memref<100xi32>
+    memref.store %0, %b[%c0] : memref<100xi32>
+    return
+  }
+  func.func private @foo_hlt(memref<100xi32> {llvm.readonly}, memref<100xi32>)
+}
+
+// -----
+
+// ASYNC-LABEL:   func.func private @foo_hlt(memref<100xi32>) -> i32
+// ASYNC:         func.func private @foo_hlt_call(memref<100xi32>)
+// ASYNC:         func.func private @foo_hlt_await() -> i32
+// ASYNC-LABEL:   func.func @wrap_async(
+// ASYNC-SAME:                          %[[VAL_0:.*]]: memref<100xi32>) {
+// ASYNC:           %[[VAL_1:.*]] = memref.alloc() : memref<100xi32>
+// ASYNC:           memref.copy %[[VAL_0]], %[[VAL_1]] : memref<100xi32> to memref<100xi32>
+// ASYNC:           call @foo_hlt_call(%[[VAL_1]]) : (memref<100xi32>) -> ()
+// ASYNC:           %[[VAL_2:.*]] = call @foo(%[[VAL_0]]) : (memref<100xi32>) -> i32
+// ASYNC:           %[[VAL_3:.*]] = call @foo_hlt_await() : () -> i32
+// ASYNC:           cosim.compare %[[VAL_2]], %[[VAL_3]] : i32
+// ASYNC:           cosim.compare %[[VAL_0]], %[[VAL_1]] : memref<100xi32>
+// ASYNC:           return
+// ASYNC:         }
+module {
+  func.func @wrap_async(%a : memref<100xi32>) {
+    %0 = cosim.call @foo(%a) : (memref<100xi32>) -> (i32)
+    {
+      targets = ["foo_hlt"],
+      ref = "foo"
+    }
+    return
+  }
+  func.func private @foo(memref<100xi32>) -> i32
+}
+
+// -----
+
+// SAMPLE:         memref.global "private" @__cosim_sample_wrap_sampled_0 : memref<i64> = dense<0>
+// SAMPLE-LABEL:   func.func @wrap_sampled(
+// SAMPLE-SAME:                            %[[VAL_0:.*]]: memref<100xi32>) -> i32 {
+// SAMPLE:           %[[VAL_1:.*]] = memref.get_global @__cosim_sample_wrap_sampled_0 : memref<i64>
+// SAMPLE:           %[[VAL_2:.*]] = memref.load %[[VAL_1]][] : memref<i64>
+// SAMPLE:           %[[VAL_3:.*]] = arith.constant 1 : i64
+// SAMPLE:           %[[VAL_4:.*]] = arith.addi %[[VAL_2]], %[[VAL_3]] : i64
+// SAMPLE:           memref.store %[[VAL_4]], %[[VAL_1]][] : memref<i64>
+// SAMPLE:           %[[VAL_5:.*]] = arith.constant 4 : i64
+// SAMPLE:           %[[VAL_6:.*]] = arith.remui %[[VAL_2]], %[[VAL_5]] : i64
+// SAMPLE:           %[[VAL_7:.*]] = arith.constant 0 : i64
+// SAMPLE:           %[[VAL_8:.*]] = arith.cmpi eq, %[[VAL_6]], %[[VAL_7]] : i64
+// SAMPLE:           %[[VAL_9:.*]] = scf.if %[[VAL_8]] -> (i32) {
+// SAMPLE:             %[[VAL_10:.*]] = memref.alloc() : memref<100xi32>
+// SAMPLE:             memref.copy %[[VAL_0]], %[[VAL_10]] : memref<100xi32> to memref<100xi32>
+// SAMPLE:             %[[VAL_11:.*]] = func.call @foo(%[[VAL_0]]) : (memref<100xi32>) -> i32
+// SAMPLE:             %[[VAL_12:.*]] = func.call @foo_hlt(%[[VAL_10]]) : (memref<100xi32>) -> i32
+// SAMPLE:             cosim.compare %[[VAL_11]], %[[VAL_12]] : i32
+// SAMPLE:             cosim.compare %[[VAL_0]], %[[VAL_10]] : memref<100xi32>
+// SAMPLE:             scf.yield %[[VAL_11]] : i32
+// SAMPLE:           } else {
+// SAMPLE:             %[[VAL_13:.*]] = func.call @foo_hlt(%[[VAL_0]]) : (memref<100xi32>) -> i32
+// SAMPLE:             scf.yield %[[VAL_13]] : i32
+// SAMPLE:           }
+// SAMPLE:           return %[[VAL_9]] : i32
+// SAMPLE:         }
+module {
+  func.func @wrap_sampled(%a : memref<100xi32>) -> i32 {
+    %0 = cosim.call @foo(%a) : (memref<100xi32>) -> (i32)
+    {
+      targets = ["foo_hlt"],
+      ref = "foo"
+    }
+    return %0 : i32
+  }
+  func.func private @foo(memref<100xi32>) -> i32
+}
+
+// -----
+
+// Once the simulation has reached its steady state, only the reference is
+// called, on the inputs of the call.
+
+// STEADY:         llvm.func @hlt_sample_skip() -> i32
+// STEADY-LABEL:   func.func @wrap_steady(
+// STEADY-SAME:                           %[[VAL_0:.*]]: memref<100xi32>) -> i32 {
+// STEADY:           %[[VAL_1:.*]] = llvm.call @hlt_sample_skip() : () -> i32
+// STEADY:           %[[VAL_2:.*]] = arith.constant 0 : i32
+// STEADY:           %[[VAL_3:.*]] = arith.cmpi ne, %[[VAL_1]], %[[VAL_2]] : i32
+// STEADY:           %[[VAL_4:.*]] = scf.if %[[VAL_3]] -> (i32) {
+// STEADY:             %[[VAL_5:.*]] = func.call @foo(%[[VAL_0]]) : (memref<100xi32>) -> i32
+// STEADY:             scf.yield %[[VAL_5]] : i32
+// STEADY:           } else {
+// STEADY:             %[[VAL_6:.*]] = memref.alloc() : memref<100xi32>
+// STEADY:             memref.copy %[[VAL_0]], %[[VAL_6]] : memref<100xi32> to memref<100xi32>
+// STEADY:             %[[VAL_7:.*]] = func.call @foo(%[[VAL_0]]) : (memref<100xi32>) -> i32
+// STEADY:             %[[VAL_8:.*]] = func.call @foo_hlt(%[[VAL_6]]) : (memref<100xi32>) -> i32
+// STEADY:             cosim.compare %[[VAL_7]], %[[VAL_8]] : i32
+// STEADY:             cosim.compare %[[VAL_0]], %[[VAL_6]] : memref<100xi32>
+// STEADY:             scf.yield %[[VAL_7]] : i32
+// STEADY:           }
+// STEADY:           return %[[VAL_4]] : i32
+// STEADY:         }
+module {
+  func.func @wrap_steady(%a : memref<100xi32>) -> i32 {
+    %0 = cosim.call @foo(%a) : (memref<100xi32>) -> (i32)
+    {
+      targets = ["foo_hlt"],
+      ref = "foo"
+    }
+    return %0 : i32
+  }
+  func.func private @foo(memref<100xi32>) -> i32
+}
+
+// -----
+
+// All targets are started before any of them is awaited, such that their
+// simulations execute concurrently. Each target is compared once awaited,
+// while the remaining targets are still simulated.
+
+// ASYNC-LABEL:   func.func @wrap_async_targets(
+// ASYNC-SAME:                                  %[[VAL_0:.*]]: memref<100xi32>) {
+// ASYNC:           %[[VAL_1:.*]] = memref.alloc() : memref<100xi32>
+// ASYNC:           memref.copy %[[VAL_0]], %[[VAL_1]] : memref<100xi32> to memref<100xi32>
+// ASYNC:           %[[VAL_2:.*]] = memref.alloc() : memref<100xi32>
+// ASYNC:           memref.copy %[[VAL_0]], %[[VAL_2]] : memref<100xi32> to memref<100xi32>
+// ASYNC:           call @foo_calyx_call(%[[VAL_1]]) : (memref<100xi32>) -> ()
+// ASYNC:           call @foo_hs_call(%[[VAL_2]]) : (memref<100xi32>) -> ()
+// ASYNC:           call @foo(%[[VAL_0]]) : (memref<100xi32>) -> ()
+// ASYNC:           call @foo_calyx_await() : () -> ()
+// ASYNC:           cosim.compare %[[VAL_0]], %[[VAL_1]] : memref<100xi32>
+// ASYNC:           call @foo_hs_await() : () -> ()
+// ASYNC:           cosim.compare %[[VAL_0]], %[[VAL_2]] : memref<100xi32>
+// ASYNC:           return
+// ASYNC:         }
+module {
+  func.func @wrap_async_targets(%a : memref<100xi32>) {
+    cosim.call @foo(%a) : (memref<100xi32>) -> ()
+    {
+      targets = ["foo_hs", "foo_calyx"],
+      ref = "foo"
+    }
+    return
+  }
+  func.func private @foo(memref<100xi32>) -> ()
+}
+
+// -----
+
+// The reference call is looked up in the reference cache through a key of its
+// inputs. On a hit, its result and the memref which it writes are loaded from
+// the cache; on a miss, the reference is called, and its outputs are stored.
+
+// MEMO-DAG:       llvm.func @hlt_ref_cache_lookup(i64) -> i32
+// MEMO-DAG:       llvm.func @hlt_ref_cache_load(!llvm.ptr<i8>, i64)
+// MEMO-DAG:       llvm.func @hlt_ref_cache_store_begin(i64)
+// MEMO-DAG:       llvm.func @hlt_ref_cache_store(!llvm.ptr<i8>, i64)
+// MEMO-DAG:       llvm.func @hlt_ref_cache_store_end()
+// MEMO-LABEL:     func.func @wrap_memoized(
+// MEMO-SAME:                               %[[VAL_0:.*]]: memref<4xi32>,
+// MEMO-SAME:                               %[[VAL_1:.*]]: i32) -> i32 {
+// MEMO:             %[[COPY:.*]] = memref.alloc() : memref<4xi32>
+// MEMO:             memref.copy %[[VAL_0]], %[[COPY]]
+// MEMO:             scf.for
+// MEMO:               memref.load %[[VAL_0]]
+// MEMO:             arith.extui %[[VAL_1]] : i32 to i64
+// MEMO:             %[[KEY:.*]] = arith.addi
+// MEMO:             %[[FOUND:.*]] = llvm.call @hlt_ref_cache_lookup(%[[KEY]]) : (i64) -> i32
+// MEMO:             %[[HIT:.*]] = arith.cmpi ne, %[[FOUND]]
+// MEMO:             %[[REF:.*]] = scf.if %[[HIT]] -> (i32) {
+// MEMO:               %[[SLOT:.*]] = memref.alloca() : memref<i32>
+// MEMO:               llvm.call @hlt_ref_cache_load({{.*}}) : (!llvm.ptr<i8>, i64) -> ()
+// MEMO:               %[[CACHED:.*]] = memref.load %[[SLOT]][] : memref<i32>
+// MEMO:               memref.extract_aligned_pointer_as_index %[[VAL_0]]
+// MEMO:               llvm.call @hlt_ref_cache_load({{.*}}) : (!llvm.ptr<i8>, i64) -> ()
+// MEMO:               scf.yield %[[CACHED]] : i32
+// MEMO:             } else {
+// MEMO:               %[[RES:.*]] = func.call @foo(%[[VAL_0]], %[[VAL_1]])
+// MEMO:               llvm.call @hlt_ref_cache_store_begin(%[[KEY]]) : (i64) -> ()
+// MEMO:               memref.store %[[RES]]
+// MEMO:               llvm.call @hlt_ref_cache_store({{.*}}) : (!llvm.ptr<i8>, i64) -> ()
+// MEMO:               llvm.call @hlt_ref_cache_store({{.*}}) : (!llvm.ptr<i8>, i64) -> ()
+// MEMO:               llvm.call @hlt_ref_cache_store_end() : () -> ()
+// MEMO:               scf.yield %[[RES]] : i32
+// MEMO:             }
+// MEMO:             %[[TGT:.*]] = call @foo_hlt(%[[COPY]], %[[VAL_1]])
+// MEMO:             cosim.compare %[[REF]], %[[TGT]] : i32
+// MEMO:             cosim.compare %[[VAL_0]], %[[COPY]] : memref<4xi32>
+// MEMO:             return %[[REF]] : i32
+module {
+  func.func @wrap_memoized(%a : memref<4xi32>, %b : i32) -> i32 {
+    %0 = cosim.call @foo(%a, %b) : (memref<4xi32>, i32) -> (i32)
+    {
+      targets = ["foo_hlt"],
+      ref = "foo"
+    }
+    return %0 : i32
+  }
+  func.func private @foo(memref<4xi32>, i32) -> i32
+}
+
+// -----
+
+// The memref is snapshotted once, and each target receives a copy-on-write
+// view of the snapshot. The views are unmapped after the comparisons.
+
+// COW-DAG:        llvm.func @hlt_cosim_snapshot(!llvm.ptr<i8>, i64) -> !llvm.ptr<i8>
+// COW-DAG:        llvm.func @hlt_cosim_snapshot_view(!llvm.ptr<i8>) -> !llvm.ptr<i8>
+// COW-DAG:        llvm.func @hlt_cosim_snapshot_release(!llvm.ptr<i8>)
+// COW-DAG:        llvm.func @hlt_cosim_snapshot_unmap(!llvm.ptr<i8>, i64)
+// COW-LABEL:      func.func @wrap_cow_snapshots(
+// COW-SAME:                                     %[[VAL_0:.*]]: memref<100xi32>) {
+// COW:              %[[BYTES:.*]] = arith.constant 400 : i64
+// COW:              %[[SNAP:.*]] = llvm.call @hlt_cosim_snapshot(%{{.*}}, %[[BYTES]])
+// COW:              %[[PTR_A:.*]] = llvm.call @hlt_cosim_snapshot_view(%[[SNAP]])
+// COW:              llvm.bitcast %[[PTR_A]] : !llvm.ptr<i8> to !llvm.ptr<i32>
+// COW:              %[[VIEW_A:.*]] = builtin.unrealized_conversion_cast %{{.*}} : !llvm.struct<(ptr<i32>, ptr<i32>, i64, array<1 x i64>, array<1 x i64>)> to memref<100xi32>
+// COW:              %[[PTR_B:.*]] = llvm.call @hlt_cosim_snapshot_view(%[[SNAP]])
+// COW:              %[[VIEW_B:.*]] = builtin.unrealized_conversion_cast
+// COW:              llvm.call @hlt_cosim_snapshot_release(%[[SNAP]])
+// COW-NOT:          memref.copy
+// COW:              call @foo(%[[VAL_0]]) : (memref<100xi32>) -> ()
+// COW:              call @foo_a(%[[VIEW_A]]) : (memref<100xi32>) -> ()
+// COW:              cosim.compare %[[VAL_0]], %[[VIEW_A]] : memref<100xi32>
+// COW:              call @foo_b(%[[VIEW_B]]) : (memref<100xi32>) -> ()
+// COW:              cosim.compare %[[VAL_0]], %[[VIEW_B]] : memref<100xi32>
+// COW:              llvm.call @hlt_cosim_snapshot_unmap(%[[PTR_A]], %{{.*}})
+// COW:              llvm.call @hlt_cosim_snapshot_unmap(%[[PTR_B]], %{{.*}})
+// COW:              return
+module {
+  func.func @wrap_cow_snapshots(%a : memref<100xi32>) {
+    cosim.call @foo(%a) : (memref<100xi32>) -> ()
+    {
+      targets = ["foo_a", "foo_b"],
+      ref = "foo"
+    }
+    return
+  }
+  func.func private @foo(memref<100xi32>) -> ()
+}
+
+// -----
+
+// The reference and the target are timed, and the comparison follows the
+// record of the target.
+
+// CHECK-DAG:      llvm.mlir.global internal constant @cosimProfileSite_{{.*}}("@foo in @wrap_profiled ({{.*}}:{{[0-9]+}})\00")
+// CHECK-DAG:      llvm.mlir.global internal constant @cosimProfileName_{{.*}}("foo_hlt\00")
+// CHECK-DAG:      llvm.func @hlt_cosim_profile_now() -> i64
+// CHECK-DAG:      llvm.func @hlt_cosim_profile_record(!llvm.ptr<i8>, !llvm.ptr<i8>, i64, i32)
+// CHECK-LABEL:    func.func @wrap_profiled(
+// CHECK-SAME:                              %[[VAL_0:.*]]: i32) -> i32 {
+// CHECK:            %[[REF_BEGIN:.*]] = llvm.call @hlt_cosim_profile_now() : () -> i64
+// CHECK:            %[[REF:.*]] = call @foo(%[[VAL_0]]) : (i32) -> i32
+// CHECK:            llvm.call @hlt_cosim_profile_record(%{{.*}}, %{{.*}}, %[[REF_BEGIN]], %{{.*}})
+// CHECK:            %[[HLT_BEGIN:.*]] = llvm.call @hlt_cosim_profile_now() : () -> i64
+// CHECK:            %[[HLT:.*]] = call @foo_hlt(%[[VAL_0]]) : (i32) -> i32
+// CHECK:            llvm.call @hlt_cosim_profile_record(%{{.*}}, %{{.*}}, %[[HLT_BEGIN]], %{{.*}})
+// CHECK:            cosim.compare %[[REF]], %[[HLT]] : i32
+// CHECK:            return %[[REF]] : i32
+module {
+  func.func @wrap_profiled(%a : i32) -> i32 {
+    %0 = cosim.call @foo(%a) : (i32) -> (i32)
+    {
+      targets = ["foo_hlt"],
+      ref = "foo",
+      profile
+    }
+    return %0 : i32
+  }
+  func.func private @foo(i32) -> i32
+}
@@ -1,20 +1,52 @@
 // RUN: hls-opt --split-input-file --cosim-lower-compare %s | FileCheck %s
+// RUN: hls-opt --split-input-file --cosim-lower-compare="max-reports=10" %s | FileCheck %s --check-prefix=MAX
+// RUN: hls-opt --split-input-file --cosim-lower-compare="early-exit" %s | FileCheck %s --check-prefix=EXIT
+// RUN: hls-opt --split-input-file --cosim-lower-compare="abs-tolerance=1e-6 ulp-tolerance=4 nan-equal=false" %s | FileCheck %s --check-prefix=TOL
+// RUN: hls-opt --split-input-file --cosim-lower-compare="hash print-digests" %s | FileCheck %s --check-prefix=HASH
+// RUN: hls-opt --split-input-file --cosim-lower-compare="runtime" %s | FileCheck %s --check-prefix=RT
 
 // CHECK-LABEL:   func.func @compare_memref() {
 // CHECK:           %[[VAL_0:.*]] = memref.alloca() : memref<100xi32>
 // CHECK:           %[[VAL_1:.*]] = memref.alloca() : memref<100xi32>
-// CHECK:           %[[VAL_2:.*]] = arith.constant 0 : index
-// CHECK:           %[[VAL_3:.*]] = arith.constant 1 : index
-// CHECK:           %[[VAL_4:.*]] = arith.constant 100 : index
-// CHECK:           scf.for %[[VAL_5:.*]] = %[[VAL_2]] to %[[VAL_4]] step %[[VAL_3]] {
-// CHECK:             %[[VAL_6:.*]] = memref.load %[[VAL_0]]{{\[}}%[[VAL_5]]] : memref<100xi32>
-// CHECK:             %[[VAL_7:.*]] = memref.load %[[VAL_1]]{{\[}}%[[VAL_5]]] : memref<100xi32>
-// CHECK:             %[[VAL_8:.*]] = arith.cmpi ne, %[[VAL_6]], %[[VAL_7]] : i32
-// CHECK:             scf.if %[[VAL_8]] {
-// CHECK:               %[[VAL_9:.*]] = llvm.mlir.addressof @cosimIntCmpErrStr : !llvm.ptr<array<15 x i8>>
-// CHECK:               %[[VAL_10:.*]] = llvm.mlir.constant(0 : index) : i64
-// CHECK:               %[[VAL_11:.*]] = llvm.getelementptr %[[VAL_9]]{{\[}}%[[VAL_10]], %[[VAL_10]]] : (!llvm.ptr<array<15 x i8>>, i64, i64) -> !llvm.ptr<i8>
-// CHECK:               %[[VAL_12:.*]] = llvm.call @printf(%[[VAL_11]], %[[VAL_6]], %[[VAL_7]]) : (!llvm.ptr<i8>, i32, i32) -> i32
+// CHECK:           %[[VAL_2:.*]] = llvm.mlir.constant(400 : i64) : i64
+// CHECK:           %[[VAL_3:.*]] = memref.extract_aligned_pointer_as_index %[[VAL_0]] : memref<100xi32> -> index
+// CHECK:           %[[VAL_4:.*]] = arith.index_cast %[[VAL_3]] : index to i64
+// CHECK:           %[[VAL_5:.*]] = llvm.inttoptr %[[VAL_4]] : i64 to !llvm.ptr<i8>
+// CHECK:           %[[VAL_6:.*]] = memref.extract_aligned_pointer_as_index %[[VAL_1]] : memref<100xi32> -> index
+// CHECK:           %[[VAL_7:.*]] = arith.index_cast %[[VAL_6]] : index to i64
+// CHECK:           %[[VAL_8:.*]] = llvm.inttoptr %[[VAL_7]] : i64 to !llvm.ptr<i8>
+// CHECK:           %[[VAL_9:.*]] = llvm.call @memcmp(%[[VAL_5]], %[[VAL_8]], %[[VAL_2]]) : (!llvm.ptr<i8>, !llvm.ptr<i8>, i64) -> i32
+// CHECK:           %[[VAL_10:.*]] = arith.constant 0 : i32
+// CHECK:           %[[VAL_11:.*]] = arith.cmpi ne, %[[VAL_9]], %[[VAL_10]] : i32
+// CHECK:           scf.if %[[VAL_11]] {
+// CHECK:             %[[VAL_12:.*]] = arith.constant 0 : index
+// CHECK:             %[[VAL_13:.*]] = arith.constant 1 : index
+// CHECK:             %[[VAL_14:.*]] = memref.alloca() : memref<index>
+// CHECK:             memref.store %[[VAL_12]], %[[VAL_14]][] : memref<index>
+// CHECK:             %[[VAL_15:.*]] = arith.constant 100 : index
+// CHECK:             scf.for %[[VAL_16:.*]] = %[[VAL_12]] to %[[VAL_15]] step %[[VAL_13]] {
+// CHECK:               %[[VAL_17:.*]] = memref.load %[[VAL_0]]{{\[}}%[[VAL_16]]] : memref<100xi32>
+// CHECK:               %[[VAL_18:.*]] = memref.load %[[VAL_1]]{{\[}}%[[VAL_16]]] : memref<100xi32>
+// CHECK:               %[[VAL_19:.*]] = arith.cmpi ne, %[[VAL_17]], %[[VAL_18]] : i32
+// CHECK:               scf.if %[[VAL_19]] {
+// CHECK:                 %[[VAL_20:.*]] = memref.load %[[VAL_14]][] : memref<index>
+// CHECK:                 %[[VAL_21:.*]] = arith.addi %[[VAL_20]], %[[VAL_13]] : index
+// CHECK:                 memref.store %[[VAL_21]], %[[VAL_14]][] : memref<index>
+// CHECK:                 %[[VAL_22:.*]] = llvm.mlir.addressof @cosimIntCmpErrStr_{{.*}} : !llvm.ptr<array<{{[0-9]+}} x i8>>
+// CHECK:                 %[[VAL_23:.*]] = llvm.mlir.constant(0 : index) : i64
+// CHECK:                 %[[VAL_24:.*]] = llvm.getelementptr %[[VAL_22]]{{\[}}%[[VAL_23]], %[[VAL_23]]] : (!llvm.ptr<array<{{[0-9]+}} x i8>>, i64, i64) -> !llvm.ptr<i8>
+// CHECK:                 %[[VAL_25:.*]] = arith.index_cast %[[VAL_16]] : index to i64
+// CHECK:                 %[[VAL_26:.*]] = llvm.call @printf(%[[VAL_24]], %[[VAL_25]], %[[VAL_17]], %[[VAL_18]]) : (!llvm.ptr<i8>, i64, i32, i32) -> i32
+// CHECK:               }
+// CHECK:             }
+// CHECK:             %[[VAL_27:.*]] = memref.load %[[VAL_14]][] : memref<index>
+// CHECK:             %[[VAL_28:.*]] = arith.cmpi ne, %[[VAL_27]], %[[VAL_12]] : index
+// CHECK:             scf.if %[[VAL_28]] {
+// CHECK:               %[[VAL_29:.*]] = llvm.mlir.addressof @cosimMemrefCmpCountStr_{{.*}} : !llvm.ptr<array<{{[0-9]+}} x i8>>
+// CHECK:               %[[VAL_30:.*]] = llvm.mlir.constant(0 : index) : i64
+// CHECK:               %[[VAL_31:.*]] = llvm.getelementptr %[[VAL_29]]{{\[}}%[[VAL_30]], %[[VAL_30]]] : (!llvm.ptr<array<{{[0-9]+}} x i8>>, i64, i64) -> !llvm.ptr<i8>
+// CHECK:               %[[VAL_32:.*]] = arith.index_cast %[[VAL_27]] : index to i64
+// CHECK:               %[[VAL_33:.*]] = llvm.call @printf(%[[VAL_31]], %[[VAL_32]]) : (!llvm.ptr<i8>, i64) -> i32
 // CHECK:             }
 // CHECK:           }
 // CHECK:           return
@@ -31,20 +63,26 @@ func.func @compare_arith() {
 // CHECK-LABEL:   func.func @compare_multidim_memref() {
 // CHECK:           %[[VAL_0:.*]] = memref.alloca() : memref<100x64xi32>
 // CHECK:           %[[VAL_1:.*]] = memref.alloca() : memref<100x64xi32>
-// CHECK:           %[[VAL_2:.*]] = arith.constant 0 : index
-// CHECK:           %[[VAL_3:.*]] = arith.constant 1 : index
-// CHECK:           %[[VAL_4:.*]] = arith.constant 100 : index
-// CHECK:           scf.for %[[VAL_5:.*]] = %[[VAL_2]] to %[[VAL_4]] step %[[VAL_3]] {
-// CHECK:             %[[VAL_6:.*]] = arith.constant 64 : index
-// CHECK:             scf.for %[[VAL_7:.*]] = %[[VAL_2]] to %[[VAL_6]] step %[[VAL_3]] {
-// CHECK:               %[[VAL_8:.*]] = memref.load %[[VAL_0]]{{\[}}%[[VAL_5]], %[[VAL_7]]] : memref<100x64xi32>
-// CHECK:               %[[VAL_9:.*]] = memref.load %[[VAL_1]]{{\[}}%[[VAL_5]], %[[VAL_7]]] : memref<100x64xi32>
-// CHECK:               %[[VAL_10:.*]] = arith.cmpi ne, %[[VAL_8]], %[[VAL_9]] : i32
-// CHECK:               scf.if %[[VAL_10]] {
-// CHECK:                 %[[VAL_11:.*]] = llvm.mlir.addressof @cosimIntCmpErrStr : !llvm.ptr<array<15 x i8>>
-// CHECK:                 %[[VAL_12:.*]] = llvm.mlir.constant(0 : index) : i64
-// CHECK:                 %[[VAL_13:.*]] = llvm.getelementptr %[[VAL_11]]{{\[}}%[[VAL_12]], %[[VAL_12]]] : (!llvm.ptr<array<15 x i8>>, i64, i64) -> !llvm.ptr<i8>
-// CHECK:                 %[[VAL_14:.*]] = llvm.call @printf(%[[VAL_13]], %[[VAL_8]], %[[VAL_9]]) : (!llvm.ptr<i8>, i32, i32) -> i32
+// CHECK:           %[[VAL_2:.*]] = llvm.mlir.constant(25600 : i64) : i64
+// CHECK:           %[[VAL_3:.*]] = llvm.call @memcmp(%{{.*}}, %{{.*}}, %[[VAL_2]]) : (!llvm.ptr<i8>, !llvm.ptr<i8>, i64) -> i32
+// CHECK:           %[[VAL_4:.*]] = arith.constant 0 : i32
+// CHECK:           %[[VAL_5:.*]] = arith.cmpi ne, %[[VAL_3]], %[[VAL_4]] : i32
+// CHECK:           scf.if %[[VAL_5]] {
+// CHECK:             %[[VAL_6:.*]] = arith.constant 0 : index
+// CHECK:             %[[VAL_7:.*]] = arith.constant 1 : index
+// CHECK:             %[[VAL_8:.*]] = memref.alloca() : memref<index>
+// CHECK:             %[[VAL_9:.*]] = arith.constant 100 : index
+// CHECK:             scf.for %[[VAL_10:.*]] = %[[VAL_6]] to %[[VAL_9]] step %[[VAL_7]] {
+// CHECK:               %[[VAL_11:.*]] = arith.constant 64 : index
+// CHECK:               scf.for %[[VAL_12:.*]] = %[[VAL_6]] to %[[VAL_11]] step %[[VAL_7]] {
+// CHECK:                 %[[VAL_13:.*]] = memref.load %[[VAL_0]]{{\[}}%[[VAL_10]], %[[VAL_12]]] : memref<100x64xi32>
+// CHECK:                 %[[VAL_14:.*]] = memref.load %[[VAL_1]]{{\[}}%[[VAL_10]], %[[VAL_12]]] : memref<100x64xi32>
+// CHECK:                 %[[VAL_15:.*]] = arith.cmpi ne, %[[VAL_13]], %[[VAL_14]] : i32
+// CHECK:                 scf.if %[[VAL_15]] {
+// CHECK:                   %[[VAL_16:.*]] = arith.index_cast %[[VAL_10]] : index to i64
+// CHECK:                   %[[VAL_17:.*]] = arith.index_cast %[[VAL_12]] : index to i64
+// CHECK:                   llvm.call @printf(%{{.*}}, %[[VAL_16]], %[[VAL_17]], %[[VAL_13]], %[[VAL_14]]) : (!llvm.ptr<i8>, i64, i64, i32, i32) -> i32
+// CHECK:                 }
 // CHECK:               }
 // CHECK:             }
 // CHECK:           }
@@ -59,9 +97,166 @@ func.func @compare_memref() {
 
 // -----
 
+// RT:           llvm.func @hlt_cosim_compare_memref(!llvm.ptr<i8>, !llvm.ptr<i8>, i64, !llvm.ptr<i8>, i32, i32, i64, i32, f64, i64, !llvm.ptr<i8>)
+// RT-LABEL:      func.func @compare_multidim_memref() {
+// RT:              %[[A:.*]] = memref.alloca() : memref<100x64xi32>
+// RT:              %[[B:.*]] = memref.alloca() : memref<100x64xi32>
+// RT:              %[[SHAPE:.*]] = memref.alloca() : memref<2xi64>
+// RT:              %[[ROWS:.*]] = arith.constant 100 : i64
+// RT:              memref.store %[[ROWS]], %[[SHAPE]]
+// RT:              %[[COLS:.*]] = arith.constant 64 : i64
+// RT:              memref.store %[[COLS]], %[[SHAPE]]
+// RT-NOT:          scf.for
+// RT:              llvm.call @hlt_cosim_compare_memref({{.*}}) : (!llvm.ptr<i8>, !llvm.ptr<i8>, i64, !llvm.ptr<i8>, i32, i32, i64, i32, f64, i64, !llvm.ptr<i8>) -> ()
+// RT-NOT:          scf.for
+// RT:              return
 func.func @compare_multidim_memref() {
     %0 = memref.alloca() : memref<100x64xi32>
     %1 = memref.alloca() : memref<100x64xi32>
     cosim.compare %0, %1 : memref<100x64xi32>
     return
 }
+
+// -----
+
+// CHECK-LABEL:   // RT-LABEL:      func.func @compare_strided_memref(
+// RT-NOT:          @hlt_cosim_compare_memref
+// RT:              scf.for
+func.func @compare_strided_memref(
+// CHECK-NOT:       llvm.call @memcmp
+// CHECK:           scf.for
+// CHECK:             memref.load
+// CHECK:             memref.load
+// CHECK:             arith.cmpi ne
+// RT-LABEL:      func.func @compare_strided_memref(
+// RT-NOT:          @hlt_cosim_compare_memref
+// RT:              scf.for
+func.func @compare_strided_memref(%0 : memref<4xi32, affine_map<(d0) -> (d0 * 2)>>, %1 : memref<4xi32, affine_map<(d0) -> (d0 * 2)>>) {
+    cosim.compare %0, %1 : memref<4xi32, affine_map<(d0) -> (d0 * 2)>>
+    return
+}
+
+// -----
+
+// CHECK:       llvm.mlir.global internal constant @cosimIntCmpErrStr_{{.*}}("COSIM: %d != %d (@foo vs. @bar)\0A\00")
+// CHECK-LABEL:   func.func @compare_src(
+// CHECK:           llvm.mlir.addressof @cosimIntCmpErrStr_{{.*}} : !llvm.ptr<array<{{[0-9]+}} x i8>>
+func.func @compare_src(%0 : i32, %1 : i32) {
+    cosim.compare %0, %1 : i32 {ref_src = @foo, target_src = @bar}
+    return
+}
+
+// -----
+
+// MAX-LABEL:     func.func @compare_reports(
+// MAX:             %[[ONE:.*]] = arith.constant 1 : index
+// MAX:             %[[COUNT:.*]] = memref.alloca() : memref<index>
+// MAX:             scf.for
+// MAX:               scf.if
+// MAX:                 %[[FOUND:.*]] = memref.load %[[COUNT]][] : memref<index>
+// MAX:                 arith.addi %[[FOUND]], %[[ONE]] : index
+// MAX:                 %[[MAX:.*]] = arith.constant 10 : index
+// MAX:                 %[[REPORT:.*]] = arith.cmpi ult, %[[FOUND]], %[[MAX]] : index
+// MAX:                 scf.if %[[REPORT]] {
+// MAX:                   llvm.call @printf
+
+// EXIT-LABEL:    func.func @compare_reports(
+// EXIT:            %[[ZERO:.*]] = arith.constant 0 : index
+// EXIT:            %[[COUNT:.*]] = memref.alloca() : memref<index>
+// EXIT:            scf.for
+// EXIT:              %[[FOUND:.*]] = memref.load %[[COUNT]][] : memref<index>
+// EXIT:              %[[NONE:.*]] = arith.cmpi eq, %[[FOUND]], %[[ZERO]] : index
+// EXIT:              scf.if %[[NONE]] {
+// EXIT:                memref.load
+// EXIT:                memref.load
+// EXIT-NOT:            arith.cmpi ult
+// EXIT:                llvm.call @printf
+func.func @compare_reports(%0 : memref<4xi32, affine_map<(d0) -> (d0 * 2)>>, %1 : memref<4xi32, affine_map<(d0) -> (d0 * 2)>>) {
+    cosim.compare %0, %1 : memref<4xi32, affine_map<(d0) -> (d0 * 2)>>
+    return
+}
+
+// -----
+
+// CHECK:         llvm.mlir.global internal constant @cosimFloatCmpErrStr_{{.*}}("COSIM: %.9g != %.9g\0A\00")
+// CHECK-LABEL:   func.func @compare_float(
+// CHECK-SAME:                             %[[VAL_0:.*]]: f32, %[[VAL_1:.*]]: f32) {
+// CHECK:           %[[VAL_2:.*]] = arith.cmpf oeq, %[[VAL_0]], %[[VAL_1]] : f32
+// CHECK:           %[[VAL_3:.*]] = arith.cmpf uno, %[[VAL_0]], %[[VAL_0]] : f32
+// CHECK:           %[[VAL_4:.*]] = arith.cmpf uno, %[[VAL_1]], %[[VAL_1]] : f32
+// CHECK:           %[[VAL_5:.*]] = arith.andi %[[VAL_3]], %[[VAL_4]] : i1
+// CHECK:           %[[VAL_6:.*]] = arith.ori %[[VAL_2]], %[[VAL_5]] : i1
+// CHECK:           %[[VAL_7:.*]] = arith.constant true
+// CHECK:           %[[VAL_8:.*]] = arith.xori %[[VAL_6]], %[[VAL_7]] : i1
+// CHECK:           scf.if %[[VAL_8]] {
+// CHECK:             %[[VAL_9:.*]] = arith.extf %[[VAL_0]] : f32 to f64
+// CHECK:             %[[VAL_10:.*]] = arith.extf %[[VAL_1]] : f32 to f64
+// CHECK:             llvm.call @printf(%{{.*}}, %[[VAL_9]], %[[VAL_10]]) : (!llvm.ptr<i8>, f64, f64) -> i32
+// CHECK:           }
+func.func @compare_float(%0 : f32, %1 : f32) {
+    cosim.compare %0, %1 : f32
+    return
+}
+
+// -----
+
+// CHECK-LABEL:   func.func @compare_float_memref(
+// CHECK:           llvm.call @memcmp
+// CHECK:           scf.if
+// CHECK:             %[[MAX:.*]] = memref.alloca() : memref<f64>
+// CHECK:             scf.for
+// CHECK:               %[[REF:.*]] = memref.load {{.*}} : memref<16xf64>
+// CHECK:               %[[TARGET:.*]] = memref.load {{.*}} : memref<16xf64>
+// CHECK:               arith.cmpf oeq, %[[REF]], %[[TARGET]] : f64
+// CHECK:               scf.if
+// CHECK:                 %[[DIFF:.*]] = arith.subf %[[REF]], %[[TARGET]] : f64
+// CHECK:                 %[[CUR:.*]] = memref.load %[[MAX]][] : memref<f64>
+// CHECK:                 %[[RAISE:.*]] = arith.cmpf ugt, %{{.*}}, %[[CUR]] : f64
+// CHECK:                 %[[NEW:.*]] = arith.select %[[RAISE]], %{{.*}}, %[[CUR]] : f64
+// CHECK:                 memref.store %[[NEW]], %[[MAX]][] : memref<f64>
+// CHECK:                 llvm.call @printf(%{{.*}}, %{{.*}}, %[[REF]], %[[TARGET]]) : (!llvm.ptr<i8>, i64, f64, f64) -> i32
+// CHECK:             %[[TOTAL:.*]] = memref.load {{.*}} : memref<index>
+// CHECK:             scf.if
+// CHECK:               %[[ERR:.*]] = memref.load %[[MAX]][] : memref<f64>
+// CHECK:               llvm.call @printf(%{{.*}}, %{{.*}}, %[[ERR]]) : (!llvm.ptr<i8>, i64, f64) -> i32
+
+// TOL-LABEL:     func.func @compare_float_memref(
+// TOL:             %[[REF:.*]] = memref.load {{.*}} : memref<16xf64>
+// TOL:             %[[TARGET:.*]] = memref.load {{.*}} : memref<16xf64>
+// TOL:             arith.cmpf oeq, %[[REF]], %[[TARGET]] : f64
+// TOL:             %[[DIFF:.*]] = arith.subf %[[REF]], %[[TARGET]] : f64
+// TOL:             arith.constant 1.000000e-06 : f64
+// TOL:             arith.cmpf ole
+// TOL:             arith.bitcast %[[REF]] : f64 to i64
+// TOL:             arith.bitcast %[[TARGET]] : f64 to i64
+// TOL:             arith.constant 4 : i64
+// TOL:             arith.cmpi ule
+func.func @compare_float_memref(%0 : memref<16xf64>, %1 : memref<16xf64>) {
+    cosim.compare %0, %1 : memref<16xf64>
+    return
+}
+
+// -----
+
+// HASH-LABEL:    func.func @compare_hashed_memref(
+// HASH-SAME:                                      %[[A:.*]]: memref<4x8xi16>, %[[B:.*]]: memref<4x8xi16>) {
+// HASH:            %[[A_DIGEST:.*]] = scf.for %{{.*}} iter_args(%{{.*}} = %{{.*}}) -> (i64) {
+// HASH:              %[[A_INNER:.*]] = scf.for %{{.*}} iter_args(%{{.*}} = %{{.*}}) -> (i64) {
+// HASH:                %[[A_ELEM:.*]] = memref.load %[[A]]
+// HASH:                arith.extui %[[A_ELEM]] : i16 to i64
+// HASH:                scf.yield
+// HASH:              }
+// HASH:              scf.yield %[[A_INNER]] : i64
+// HASH:            }
+// HASH:            %[[B_DIGEST:.*]] = scf.for
+// HASH:              scf.for
+// HASH:                memref.load %[[B]]
+// HASH:            llvm.call @printf(%{{.*}}, %[[A_DIGEST]], %[[B_DIGEST]]) : (!llvm.ptr<i8>, i64, i64) -> i32
+// HASH:            %[[MISMATCH:.*]] = arith.cmpi ne, %[[A_DIGEST]], %[[B_DIGEST]] : i64
+// HASH:            scf.if %[[MISMATCH]] {
+// HASH-NOT:          @memcmp
+// HASH:              arith.cmpi ne, %{{.*}}, %{{.*}} : i16
+func.func @compare_hashed_memref(%0 : memref<4x8xi16>, %1 : memref<4x8xi16>) {
+    cosim.compare %0, %1 : memref<4x8xi16>
+    return
+}
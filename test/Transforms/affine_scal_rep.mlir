@@ -21,3 +21,81 @@ func.func @dead_reduction_buffer(%arg0: memref<64xi32>,
   affine.store %1, %0[] : memref<i32>
   return %0 : memref<i32>
 }
+
+// -----
+
+// CHECK-LABEL: func.func @loop_accumulator
+// CHECK:         %[[INIT:.+]] = affine.load %arg1[0] : memref<4xi32>
+// CHECK:         %[[RES:.+]] = affine.for %[[I:.+]] = 0 to 64 iter_args(%[[ACC:.+]] = %[[INIT]]) -> (i32) {
+// CHECK-NEXT:      %[[VAL:.+]] = affine.load %arg0[%[[I]]] : memref<64xi32>
+// CHECK-NEXT:      %[[SUM:.+]] = arith.addi %[[ACC]], %[[VAL]] : i32
+// CHECK-NEXT:      affine.yield %[[SUM]] : i32
+// CHECK-NEXT:    }
+// CHECK-NEXT:    affine.store %[[RES]], %arg1[0] : memref<4xi32>
+func.func @loop_accumulator(%arg0: memref<64xi32>, %arg1: memref<4xi32>) {
+  affine.for %arg2 = 0 to 64 {
+    %0 = affine.load %arg1[0] : memref<4xi32>
+    %1 = affine.load %arg0[%arg2] : memref<64xi32>
+    %2 = arith.addi %0, %1 : i32
+    affine.store %2, %arg1[0] : memref<4xi32>
+  }
+  return
+}
+
+// -----
+
+// CHECK-LABEL: func.func @intervening_load
+// CHECK:         affine.for
+// CHECK-NOT:       iter_args
+// CHECK:           affine.load %arg1[0]
+// CHECK:           affine.load %arg1[1]
+// CHECK:           affine.store
+func.func @intervening_load(%arg0: memref<64xi32>, %arg1: memref<4xi32>) {
+  affine.for %arg2 = 0 to 64 {
+    %0 = affine.load %arg1[0] : memref<4xi32>
+    %1 = affine.load %arg1[1] : memref<4xi32>
+    %2 = arith.addi %0, %1 : i32
+    affine.store %2, %arg1[0] : memref<4xi32>
+  }
+  return
+}
+
+// -----
+
+// A loop which may not iterate does not access its accumulator, so the
+// accumulator is not promoted.
+
+// CHECK-LABEL: func.func @zero_trip_accumulator
+// CHECK-NEXT:    affine.for %[[I:.+]] = 0 to 0 {
+// CHECK-NEXT:      affine.load %arg1[0]
+// CHECK:           affine.store %{{.+}}, %arg1[0]
+// CHECK-NEXT:    }
+// CHECK-NEXT:    return
+func.func @zero_trip_accumulator(%arg0: memref<64xi32>, %arg1: memref<4xi32>) {
+  affine.for %arg2 = 0 to 0 {
+    %0 = affine.load %arg1[0] : memref<4xi32>
+    %1 = affine.load %arg0[%arg2] : memref<64xi32>
+    %2 = arith.addi %0, %1 : i32
+    affine.store %2, %arg1[0] : memref<4xi32>
+  }
+  return
+}
+
+// -----
+
+// CHECK-LABEL: func.func @dynamic_trip_accumulator
+// CHECK-NEXT:    affine.for %[[I:.+]] = 0 to %arg2 {
+// CHECK-NEXT:      affine.load %arg1[0]
+// CHECK:           affine.store %{{.+}}, %arg1[0]
+// CHECK-NEXT:    }
+// CHECK-NEXT:    return
+func.func @dynamic_trip_accumulator(%arg0: memref<64xi32>,
+                                    %arg1: memref<4xi32>, %arg2: index) {
+  affine.for %arg3 = 0 to %arg2 {
+    %0 = affine.load %arg1[0] : memref<4xi32>
+    %1 = affine.load %arg0[%arg3] : memref<64xi32>
+    %2 = arith.addi %0, %1 : i32
+    affine.store %2, %arg1[0] : memref<4xi32>
+  }
+  return
+}
@@ -0,0 +1,57 @@
+// RUN: hls-opt -split-input-file -affine-annotate-independence %s | FileCheck %s
+
+// The even elements stored to are never loaded from.
+
+// CHECK-LABEL: func.func @disjoint(
+// CHECK:         affine.load %{{.+}}[%{{.+}} * 2 + 1] {hls.access_id = 0 : i64, hls.independent = [1]} : memref<32xi32>
+// CHECK:         affine.store %{{.+}}, %{{.+}}[%{{.+}} * 2] {hls.access_id = 1 : i64, hls.independent = [0]} : memref<32xi32>
+func.func @disjoint(%arg0: memref<32xi32>) {
+  affine.for %i = 0 to 16 {
+    %0 = affine.load %arg0[%i * 2 + 1] : memref<32xi32>
+    affine.store %0, %arg0[%i * 2] : memref<32xi32>
+  }
+  return
+}
+
+// -----
+
+// Loads are not paired with each other. Only the store to the lower half is
+// independent of the load from the upper half.
+
+// CHECK-LABEL: func.func @partial(
+// CHECK:         affine.load %{{.+}}[%{{.+}}] {hls.access_id = 0 : i64} : memref<16xi32>
+// CHECK:         affine.load %{{.+}}[%{{.+}} + 8] {hls.access_id = 1 : i64, hls.independent = [2]} : memref<16xi32>
+// CHECK:         affine.store %{{.+}}, %{{.+}}[%{{.+}}] {hls.access_id = 2 : i64, hls.independent = [1]} : memref<16xi32>
+// CHECK:         affine.store %{{.+}}, %{{.+}}[%{{.+}} + 4] {hls.access_id = 3 : i64} : memref<16xi32>
+func.func @partial(%arg0: memref<16xi32>) {
+  affine.for %i = 0 to 8 {
+    %0 = affine.load %arg0[%i] : memref<16xi32>
+    %1 = affine.load %arg0[%i + 8] : memref<16xi32>
+    %2 = arith.addi %0, %1 : i32
+    affine.store %2, %arg0[%i] : memref<16xi32>
+    affine.store %2, %arg0[%i + 4] : memref<16xi32>
+  }
+  return
+}
+
+// -----
+
+// Accesses which are dependent across iterations, or whose indices are not
+// affine, are not annotated.
+
+// CHECK-LABEL: func.func @dependent(
+// CHECK-NOT:     hls.independent
+func.func @dependent(%arg0: memref<16xi32>, %arg1: memref<16xindex>,
+                     %arg2: memref<16xi32>) {
+  affine.for %i = 0 to 15 {
+    %0 = affine.load %arg0[%i] : memref<16xi32>
+    affine.store %0, %arg0[%i + 1] : memref<16xi32>
+  }
+  affine.for %i = 0 to 16 {
+    %1 = affine.load %arg1[%i] : memref<16xindex>
+    %2 = memref.load %arg2[%1] : memref<16xi32>
+    %3 = arith.addi %2, %2 : i32
+    memref.store %3, %arg2[%1] : memref<16xi32>
+  }
+  return
+}
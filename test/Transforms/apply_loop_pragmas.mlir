@@ -0,0 +1,67 @@
+// RUN: echo '{"loops": [                                                     \
+// RUN:   {"function": "kernel", "loop": 0, "unroll": 2},                     \
+// RUN:   {"function": "kernel", "loop": 2, "pipeline_ii": 1},                \
+// RUN:   {"function": "kernel", "loop": 3, "unroll": 0},                     \
+// RUN:   {"function": "located", "loop": 0, "file": "src/kernel.c",          \
+// RUN:    "line": 12, "pipeline_ii": 2},                                     \
+// RUN:   {"function": "missing", "loop": 0, "pipeline_ii": 2}]}'             \
+// RUN:   > %t.json
+// RUN: hls-opt -hls-apply-loop-pragmas="pragmas=%t.json" %s -verify-diagnostics | FileCheck %s
+
+// Loops are matched by their index among the loops of the function, in
+// pre-order. The while loop cannot be unrolled.
+
+// CHECK-LABEL: func.func @kernel(
+// CHECK:           affine.for
+// CHECK:           }
+// CHECK-NEXT:    } {hls.unroll = 2 : i64}
+// CHECK:         } {hls.pipeline_ii = 1 : i64}
+// CHECK:         scf.while
+// CHECK-NOT:     hls.unroll
+
+// Loops with the locations of the C source are matched by their line.
+
+// CHECK-LABEL: func.func @located(
+// CHECK:         affine.for
+// CHECK:         }{{$}}
+// CHECK:         } {hls.pipeline_ii = 2 : i64}
+
+// expected-warning @+1 {{no loop of 'missing' matches the pragmas of loop 0}}
+module {
+func.func @kernel(%arg0: memref<8x8xi32>, %arg1: memref<8xi32>, %arg2: i32) {
+  affine.for %i = 0 to 8 {
+    affine.for %j = 0 to 8 {
+      %0 = affine.load %arg0[%i, %j] : memref<8x8xi32>
+      affine.store %0, %arg1[%j] : memref<8xi32>
+    }
+  }
+  affine.for %i = 0 to 8 {
+    %0 = affine.load %arg1[%i] : memref<8xi32>
+    affine.store %0, %arg1[%i] : memref<8xi32>
+  }
+  // expected-warning @+1 {{cannot unroll a while loop; the unroll pragma is ignored}}
+  %1 = scf.while (%arg3 = %arg2) : (i32) -> i32 {
+    %c0 = arith.constant 0 : i32
+    %2 = arith.cmpi sgt, %arg3, %c0 : i32
+    scf.condition(%2) %arg3 : i32
+  } do {
+  ^bb0(%arg3: i32):
+    %c1 = arith.constant 1 : i32
+    %2 = arith.subi %arg3, %c1 : i32
+    scf.yield %2 : i32
+  }
+  return
+}
+
+func.func @located(%arg0: memref<8xi32>) {
+  affine.for %i = 0 to 8 {
+    %0 = affine.load %arg0[%i] : memref<8xi32>
+    affine.store %0, %arg0[%i] : memref<8xi32>
+  } loc("kernel.c":5:3)
+  affine.for %i = 0 to 8 {
+    %0 = affine.load %arg0[%i] : memref<8xi32>
+    affine.store %0, %arg0[%i] : memref<8xi32>
+  } loc("kernel.c":12:3)
+  return
+}
+}
@@ -1,4 +1,5 @@
 // RUN: hls-opt -split-input-file -asyncify-calls %s | FileCheck %s
+// RUN: hls-opt -split-input-file -asyncify-calls="window=4" %s | FileCheck %s --check-prefix=WINDOW
 
 
 func.func private @bar()
@@ -105,3 +106,160 @@ func.func @simple_loop_up_and_downstream_dep(%0 : i32) {
   }
   return
 }
+
+// -----
+
+func.func private @bar(i32) -> (i32)
+
+// WINDOW-LABEL:   func.func @windowed_loop(
+// WINDOW-SAME:                             %[[VAL_0:.*]]: memref<10xi32>) {
+// WINDOW:           %[[VAL_1:.*]] = arith.constant 0 : index
+// WINDOW:           %[[VAL_2:.*]] = arith.constant 10 : index
+// WINDOW:           %[[VAL_3:.*]] = arith.constant 1 : index
+// WINDOW:           %[[VAL_4:.*]] = arith.constant 4 : index
+// WINDOW:           %[[VAL_5:.*]] = arith.muli %[[VAL_4]], %[[VAL_3]] : index
+// WINDOW:           %[[VAL_6:.*]] = arith.addi %[[VAL_2]], %[[VAL_5]] : index
+// WINDOW:           scf.for %[[VAL_7:.*]] = %[[VAL_1]] to %[[VAL_6]] step %[[VAL_3]] {
+// WINDOW:             %[[VAL_8:.*]] = arith.subi %[[VAL_7]], %[[VAL_5]] : index
+// WINDOW:             %[[VAL_9:.*]] = arith.cmpi sge, %[[VAL_8]], %[[VAL_1]] : index
+// WINDOW:             scf.if %[[VAL_9]] {
+// WINDOW:               %[[VAL_10:.*]] = func.call @bar_await() : () -> i32
+// WINDOW:               memref.store %[[VAL_10]], %[[VAL_0]]{{\[}}%[[VAL_8]]] : memref<10xi32>
+// WINDOW:             }
+// WINDOW:             %[[VAL_11:.*]] = arith.cmpi slt, %[[VAL_7]], %[[VAL_2]] : index
+// WINDOW:             scf.if %[[VAL_11]] {
+// WINDOW:               %[[VAL_12:.*]] = arith.index_cast %[[VAL_7]] : index to i32
+// WINDOW:               func.call @bar_call(%[[VAL_12]]) : (i32) -> ()
+// WINDOW:             }
+// WINDOW:           }
+// WINDOW:           return
+// WINDOW:         }
+func.func @windowed_loop(%mem : memref<10xi32>) {
+  %lb = arith.constant 0 : index
+  %ub = arith.constant 10 : index
+  %step = arith.constant 1 : index
+  scf.for %i = %lb to %ub step %step {
+    %i_i32 = arith.index_cast %i : index to i32
+    %res = func.call @bar(%i_i32) : (i32) -> (i32)
+    memref.store %res, %mem[%i] : memref<10xi32>
+  }
+  return
+}
+
+// -----
+
+func.func private @bar(i32) -> (i32)
+
+// CHECK-LABEL:   func.func @loop_reduction() -> i32 {
+// CHECK:           %[[VAL_0:.*]] = arith.constant 0 : index
+// CHECK:           %[[VAL_1:.*]] = arith.constant 10 : index
+// CHECK:           %[[VAL_2:.*]] = arith.constant 1 : index
+// CHECK:           %[[VAL_3:.*]] = arith.constant 0 : i32
+// CHECK:           scf.for %[[VAL_4:.*]] = %[[VAL_0]] to %[[VAL_1]] step %[[VAL_2]] {
+// CHECK:             %[[VAL_5:.*]] = arith.index_cast %[[VAL_4]] : index to i32
+// CHECK:             func.call @bar_call(%[[VAL_5]]) : (i32) -> ()
+// CHECK:           }
+// CHECK:           %[[VAL_6:.*]] = scf.for %[[VAL_7:.*]] = %[[VAL_0]] to %[[VAL_1]] step %[[VAL_2]] iter_args(%[[VAL_8:.*]] = %[[VAL_3]]) -> (i32) {
+// CHECK:             %[[VAL_9:.*]] = func.call @bar_await() : () -> i32
+// CHECK:             %[[VAL_10:.*]] = arith.addi %[[VAL_8]], %[[VAL_9]] : i32
+// CHECK:             scf.yield %[[VAL_10]] : i32
+// CHECK:           }
+// CHECK:           return %[[VAL_6]] : i32
+// CHECK:         }
+
+// WINDOW-LABEL:   func.func @loop_reduction() -> i32 {
+// WINDOW:           %[[VAL_0:.*]] = arith.constant 0 : index
+// WINDOW:           %[[VAL_3:.*]] = arith.constant 0 : i32
+// WINDOW:           %[[VAL_4:.*]] = scf.for %[[VAL_5:.*]] = %{{.*}} to %{{.*}} step %{{.*}} iter_args(%[[VAL_6:.*]] = %[[VAL_3]]) -> (i32) {
+// WINDOW:             %[[VAL_7:.*]] = arith.subi %[[VAL_5]], %{{.*}} : index
+// WINDOW:             %[[VAL_8:.*]] = arith.cmpi sge, %[[VAL_7]], %[[VAL_0]] : index
+// WINDOW:             %[[VAL_9:.*]] = scf.if %[[VAL_8]] -> (i32) {
+// WINDOW:               %[[VAL_10:.*]] = func.call @bar_await() : () -> i32
+// WINDOW:               %[[VAL_11:.*]] = arith.addi %[[VAL_6]], %[[VAL_10]] : i32
+// WINDOW:               scf.yield %[[VAL_11]] : i32
+// WINDOW:             } else {
+// WINDOW:               scf.yield %[[VAL_6]] : i32
+// WINDOW:             }
+// WINDOW:             scf.if
+// WINDOW:               func.call @bar_call
+// WINDOW:             }
+// WINDOW:             scf.yield %[[VAL_9]] : i32
+// WINDOW:           }
+// WINDOW:           return %[[VAL_4]] : i32
+func.func @loop_reduction() -> i32 {
+  %lb = arith.constant 0 : index
+  %ub = arith.constant 10 : index
+  %step = arith.constant 1 : index
+  %init = arith.constant 0 : i32
+  %sum = scf.for %i = %lb to %ub step %step iter_args(%acc = %init) -> (i32) {
+    %i_i32 = arith.index_cast %i : index to i32
+    %res = func.call @bar(%i_i32) : (i32) -> (i32)
+    %next = arith.addi %acc, %res : i32
+    scf.yield %next : i32
+  }
+  return %sum : i32
+}
+
+// -----
+
+func.func private @bar(index, index) -> ()
+
+// The loop nest is collapsed into a single loop before asyncification.
+// CHECK-LABEL:   func.func @nested_loops() {
+// CHECK:           scf.for %[[VAL_0:.*]] = {{.*}} {
+// CHECK-NOT:         scf.for
+// CHECK:             func.call @bar_call(%{{.*}}, %{{.*}}) : (index, index) -> ()
+// CHECK:           }
+// CHECK:           scf.for %[[VAL_1:.*]] = {{.*}} {
+// CHECK-NOT:         scf.for
+// CHECK:             func.call @bar_await() : () -> ()
+// CHECK:           }
+// CHECK:           return
+// CHECK:         }
+func.func @nested_loops() {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %c8 = arith.constant 8 : index
+  scf.for %i = %c0 to %c4 step %c1 {
+    scf.for %j = %c0 to %c8 step %c1 {
+      func.call @bar(%i, %j) : (index, index) -> ()
+    }
+  }
+  return
+}
+
+// -----
+
+func.func private @bar(i32) -> (i32)
+
+// The results of the call fan out and reconverge; each downstream operation is
+// cloned into the await loop once.
+// CHECK-LABEL:   func.func @diamond_downstream(
+// CHECK-SAME:                                  %[[VAL_0:.*]]: memref<10xi32>) {
+// CHECK:           scf.for
+// CHECK:             func.call @bar_call
+// CHECK:           }
+// CHECK:           scf.for %[[VAL_1:.*]] = {{.*}} {
+// CHECK:             %[[VAL_2:.*]] = func.call @bar_await() : () -> i32
+// CHECK-DAG:         %[[VAL_3:.*]] = arith.addi %[[VAL_2]], %[[VAL_2]] : i32
+// CHECK-DAG:         %[[VAL_4:.*]] = arith.muli %[[VAL_2]], %[[VAL_2]] : i32
+// CHECK:             %[[VAL_5:.*]] = arith.subi %[[VAL_3]], %[[VAL_4]] : i32
+// CHECK-NOT:         arith.
+// CHECK:             memref.store %[[VAL_5]], %[[VAL_0]]{{\[}}%[[VAL_1]]] : memref<10xi32>
+// CHECK-NEXT:      }
+// CHECK:           return
+func.func @diamond_downstream(%mem : memref<10xi32>) {
+  %lb = arith.constant 0 : index
+  %ub = arith.constant 10 : index
+  %step = arith.constant 1 : index
+  scf.for %i = %lb to %ub step %step {
+    %i_i32 = arith.index_cast %i : index to i32
+    %res = func.call @bar(%i_i32) : (i32) -> (i32)
+    %0 = arith.addi %res, %res : i32
+    %1 = arith.muli %res, %res : i32
+    %2 = arith.subi %0, %1 : i32
+    memref.store %2, %mem[%i] : memref<10xi32>
+  }
+  return
+}
@@ -0,0 +1,37 @@
+// RUN: hls-opt -split-input-file -asyncify-calls="out-of-order" %s | FileCheck %s
+
+func.func private @bar(i32) -> (i32)
+
+// CHECK-LABEL:   func.func private @bar_call_tagged(i64, i32)
+// CHECK:         func.func private @bar_await_tagged(memref<1xi64>) -> i32
+// CHECK-LABEL:   func.func @parallel_loop(
+// CHECK-SAME:                             %[[VAL_0:.*]]: memref<10xi32>) {
+// CHECK:           %[[VAL_1:.*]] = arith.constant 0 : index
+// CHECK:           %[[VAL_2:.*]] = arith.constant 10 : index
+// CHECK:           %[[VAL_3:.*]] = arith.constant 1 : index
+// CHECK:           %[[VAL_4:.*]] = memref.alloca() : memref<1xi64>
+// CHECK:           %[[VAL_5:.*]] = arith.constant 0 : index
+// CHECK:           scf.for %[[VAL_6:.*]] = %[[VAL_1]] to %[[VAL_2]] step %[[VAL_3]] {
+// CHECK:             %[[VAL_7:.*]] = arith.index_cast %[[VAL_6]] : index to i32
+// CHECK:             %[[VAL_8:.*]] = arith.index_cast %[[VAL_6]] : index to i64
+// CHECK:             func.call @bar_call_tagged(%[[VAL_8]], %[[VAL_7]]) : (i64, i32) -> ()
+// CHECK:           }
+// CHECK:           scf.for %[[VAL_9:.*]] = %[[VAL_1]] to %[[VAL_2]] step %[[VAL_3]] {
+// CHECK:             %[[VAL_10:.*]] = func.call @bar_await_tagged(%[[VAL_4]]) : (memref<1xi64>) -> i32
+// CHECK:             %[[VAL_11:.*]] = memref.load %[[VAL_4]]{{\[}}%[[VAL_5]]] : memref<1xi64>
+// CHECK:             %[[VAL_12:.*]] = arith.index_cast %[[VAL_11]] : i64 to index
+// CHECK:             memref.store %[[VAL_10]], %[[VAL_0]]{{\[}}%[[VAL_12]]] : memref<10xi32>
+// CHECK:           }
+// CHECK:           return
+// CHECK:         }
+func.func @parallel_loop(%mem : memref<10xi32>) {
+  %lb = arith.constant 0 : index
+  %ub = arith.constant 10 : index
+  %step = arith.constant 1 : index
+  scf.parallel (%i) = (%lb) to (%ub) step (%step) {
+    %i_i32 = arith.index_cast %i : index to i32
+    %res = func.call @bar(%i_i32) : (i32) -> (i32)
+    memref.store %res, %mem[%i] : memref<10xi32>
+  }
+  return
+}
@@ -0,0 +1,35 @@
+// RUN: hls-opt -split-input-file -handshake-estimate-resources %s -verify-diagnostics
+
+// A sequential buffer registers each slot, and ends the critical path. The
+// return is on a path of its own, from the buffer.
+
+// expected-remark @+1 {{estimated 38 LUTs, 68 registers, 0 DSPs and a critical path of 1.04 ns, through: arith_addi0, handshake_buffer0}}
+handshake.func @buffered(%arg0: i32, %arg1: i32, %ctrl: none) -> (i32, none) {
+  %0 = arith.addi %arg0, %arg1 {handshake_id = 0 : i64} : i32
+  %1 = buffer [2] seq %0 {handshake_id = 0 : i64} : i32
+  return %1, %ctrl : i32, none
+}
+
+// -----
+
+// Multipliers are mapped to DSPs. Ops without a 'handshake_id' are named by
+// their index within the function.
+
+// expected-remark @+1 {{estimated 10 LUTs, 0 registers, 1 DSPs and a critical path of 2.50 ns, through: arith.muli#0, handshake.return#1}}
+handshake.func @multiply(%arg0: i16, %arg1: i16, %ctrl: none) -> (i16, none) {
+  %0 = arith.muli %arg0, %arg1 : i16
+  return %0, %ctrl : i16, none
+}
+
+// -----
+
+// A loop without a sequential buffer is cut where it closes, and each result
+// of a fork is costed.
+
+// expected-remark @+1 {{estimated 70 LUTs, 2 registers, 0 DSPs and a critical path of 1.64 ns, through: handshake.fork#1, arith.addi#2, handshake.merge#0}}
+handshake.func @unbuffered(%arg0: i32, %arg1: i32, %ctrl: none) -> (i32, none) {
+  %0 = merge %arg0, %2 : i32
+  %1:2 = fork [2] %0 : i32
+  %2 = arith.addi %1#0, %arg1 : i32
+  return %1#1, %ctrl : i32, none
+}
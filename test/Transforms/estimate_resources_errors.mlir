@@ -0,0 +1,8 @@
+// RUN: echo '{"arith.muli": {"luts": 50}}' > %t.json
+// RUN: hls-opt -handshake-estimate-resources="costs=%t.json" %s -verify-diagnostics
+
+// expected-error @+1 {{unexpected field 'luts' in the cost of 'arith.muli'}}
+handshake.func @kernel(%arg0: i16, %arg1: i16, %ctrl: none) -> (i16, none) {
+  %0 = arith.muli %arg0, %arg1 : i16
+  return %0, %ctrl : i16, none
+}
@@ -0,0 +1,35 @@
+// RUN: echo '{"arith.muli": {"lut": 50, "delay": 3}}' > %t.json
+// RUN: hls-opt -handshake-estimate-resources="costs=%t.json report=%t.report.json" %s -o /dev/null
+// RUN: FileCheck %s < %t.report.json
+
+// The costs of the cost table replace the built-in costs of the ops that it
+// lists. The report lists the resources of the ops of each kind.
+
+// CHECK:      "delay": 3.2{{[0-9]*}},
+// CHECK-NEXT: "dsps": 0,
+// CHECK-NEXT: "ffs": 0,
+// CHECK-NEXT: "function": "kernel",
+// CHECK-NEXT: "luts": 51,
+// CHECK-NEXT: "ops": {
+// CHECK-NEXT:   "arith.muli": {
+// CHECK-NEXT:     "count": 1,
+// CHECK-NEXT:     "dsps": 0,
+// CHECK-NEXT:     "ffs": 0,
+// CHECK-NEXT:     "luts": 50
+// CHECK-NEXT:   },
+// CHECK-NEXT:   "handshake.return": {
+// CHECK-NEXT:     "count": 1,
+// CHECK-NEXT:     "dsps": 0,
+// CHECK-NEXT:     "ffs": 0,
+// CHECK-NEXT:     "luts": 1
+// CHECK-NEXT:   }
+// CHECK-NEXT: },
+// CHECK-NEXT: "path": [
+// CHECK-NEXT:   "arith.muli#0",
+// CHECK-NEXT:   "handshake.return#1"
+// CHECK-NEXT: ]
+
+handshake.func @kernel(%arg0: i16, %arg1: i16, %ctrl: none) -> (i16, none) {
+  %0 = arith.muli %arg0, %arg1 : i16
+  return %0, %ctrl : i16, none
+}
@@ -0,0 +1,101 @@
+// RUN: hls-opt -split-input-file -affine-fuse-loops %s | FileCheck %s
+
+// The local memref passed between the nests is shrunk to the single element
+// of each iteration.
+
+// CHECK-LABEL: func.func @local(
+// CHECK-SAME:      %[[IN:.+]]: memref<16xi32>, %[[OUT:.+]]: memref<16xi32>) {
+// CHECK:         %[[BUF:.+]] = memref.alloca() : memref<1xi32>
+// CHECK:         affine.for %[[I:.+]] = 0 to 16 {
+// CHECK:           affine.load %[[IN]][%[[I]]] : memref<16xi32>
+// CHECK:           affine.store %{{.+}}, %[[BUF]][0] : memref<1xi32>
+// CHECK:           affine.load %[[BUF]][0] : memref<1xi32>
+// CHECK:           affine.store %{{.+}}, %[[OUT]][%[[I]]] : memref<16xi32>
+// CHECK-NEXT:    }
+// CHECK-NEXT:    return
+func.func @local(%arg0: memref<16xi32>, %arg1: memref<16xi32>) {
+  %buf = memref.alloca() : memref<16xi32>
+  affine.for %i = 0 to 16 {
+    %0 = affine.load %arg0[%i] : memref<16xi32>
+    %1 = arith.addi %0, %0 : i32
+    affine.store %1, %buf[%i] : memref<16xi32>
+  }
+  affine.for %i = 0 to 16 {
+    %2 = affine.load %buf[%i] : memref<16xi32>
+    %3 = arith.muli %2, %2 : i32
+    affine.store %3, %arg1[%i] : memref<16xi32>
+  }
+  return
+}
+
+// -----
+
+// A chained matrix product is fused row by row. The intermediate matrix is an
+// argument, and is thus not shrunk.
+
+// CHECK-LABEL: func.func @chained(
+// CHECK-SAME:      %[[TMP:.+]]: memref<4x4xi32>,
+// CHECK:         affine.for %[[I:.+]] = 0 to 4 {
+// CHECK:           affine.store %{{.+}}, %[[TMP]][%[[I]], %{{.+}}] : memref<4x4xi32>
+// CHECK:           affine.load %[[TMP]][%[[I]], %{{.+}}] : memref<4x4xi32>
+// CHECK:         }
+// CHECK-NOT:     affine.for
+// CHECK:         return
+func.func @chained(%tmp: memref<4x4xi32>, %A: memref<4x4xi32>,
+                   %B: memref<4x4xi32>, %C: memref<4x4xi32>,
+                   %D: memref<4x4xi32>) {
+  %c0 = arith.constant 0 : i32
+  affine.for %i = 0 to 4 {
+    affine.for %j = 0 to 4 {
+      affine.store %c0, %tmp[%i, %j] : memref<4x4xi32>
+      affine.for %k = 0 to 4 {
+        %0 = affine.load %A[%i, %k] : memref<4x4xi32>
+        %1 = affine.load %B[%k, %j] : memref<4x4xi32>
+        %2 = arith.muli %0, %1 : i32
+        %3 = affine.load %tmp[%i, %j] : memref<4x4xi32>
+        %4 = arith.addi %3, %2 : i32
+        affine.store %4, %tmp[%i, %j] : memref<4x4xi32>
+      }
+    }
+  }
+  affine.for %i = 0 to 4 {
+    affine.for %j = 0 to 4 {
+      affine.store %c0, %D[%i, %j] : memref<4x4xi32>
+      affine.for %k = 0 to 4 {
+        %5 = affine.load %tmp[%i, %k] : memref<4x4xi32>
+        %6 = affine.load %C[%k, %j] : memref<4x4xi32>
+        %7 = arith.muli %5, %6 : i32
+        %8 = affine.load %D[%i, %j] : memref<4x4xi32>
+        %9 = arith.addi %8, %7 : i32
+        affine.store %9, %D[%i, %j] : memref<4x4xi32>
+      }
+    }
+  }
+  return
+}
+
+// -----
+
+// A consumer which reads the whole output of the producer in each iteration
+// would recompute the producer, and is not fused.
+
+// CHECK-LABEL: func.func @redundant(
+// CHECK:         memref.alloca() : memref<4xi32>
+// CHECK:         affine.for
+// CHECK:           affine.store %{{.+}}, %{{.+}}[%{{.+}}] : memref<4xi32>
+// CHECK-NEXT:    }
+// CHECK:         affine.for
+func.func @redundant(%arg0: memref<4xi32>, %arg1: memref<4x4xi32>) {
+  %buf = memref.alloca() : memref<4xi32>
+  affine.for %i = 0 to 4 {
+    %0 = affine.load %arg0[%i] : memref<4xi32>
+    affine.store %0, %buf[%i] : memref<4xi32>
+  }
+  affine.for %i = 0 to 4 {
+    affine.for %j = 0 to 4 {
+      %1 = affine.load %buf[%j] : memref<4xi32>
+      affine.store %1, %arg1[%i, %j] : memref<4x4xi32>
+    }
+  }
+  return
+}
@@ -0,0 +1,89 @@
+// RUN: hls-opt -split-input-file -hls-if-convert %s | FileCheck %s
+
+// CHECK-LABEL: func.func @diamond(
+// CHECK-SAME:      %[[A:.+]]: i32, %[[B:.+]]: i32) -> i32 {
+// CHECK:         %[[C0:.+]] = arith.constant 0 : i32
+// CHECK:         %[[COND:.+]] = arith.cmpi slt, %[[A]], %[[C0]] : i32
+// CHECK:         %[[NEG:.+]] = arith.subi %[[C0]], %[[A]] : i32
+// CHECK:         %[[SUM:.+]] = arith.addi %[[A]], %[[B]] : i32
+// CHECK:         %[[SEL:.+]] = arith.select %[[COND]], %[[NEG]], %[[SUM]] : i32
+// CHECK-NOT:     cf.
+// CHECK:         return %[[SEL]] : i32
+func.func @diamond(%arg0: i32, %arg1: i32) -> i32 {
+  %c0 = arith.constant 0 : i32
+  %0 = arith.cmpi slt, %arg0, %c0 : i32
+  cf.cond_br %0, ^bb1, ^bb2
+^bb1:
+  %1 = arith.subi %c0, %arg0 : i32
+  cf.br ^bb3(%1 : i32)
+^bb2:
+  %2 = arith.addi %arg0, %arg1 : i32
+  cf.br ^bb3(%2 : i32)
+^bb3(%3: i32):
+  return %3 : i32
+}
+
+// -----
+
+// A conditional update of a loop-carried value is selected within the loop
+// body.
+
+// CHECK-LABEL: func.func @triangle(
+// CHECK:       ^bb1(%{{.+}}: index, %[[ACC:.+]]: i32):
+// CHECK:       ^bb2:
+// CHECK:         %[[V:.+]] = memref.load
+// CHECK:         %[[COND:.+]] = arith.cmpi sgt, %[[V]], %{{.+}} : i32
+// CHECK:         %[[SUM:.+]] = arith.addi %[[ACC]], %[[V]] : i32
+// CHECK:         %[[SEL:.+]] = arith.select %[[COND]], %[[SUM]], %[[ACC]] : i32
+// CHECK-NOT:     ^bb
+// CHECK:         cf.br ^bb1(%{{.+}}, %[[SEL]] : index, i32)
+// CHECK:       ^bb3:
+// CHECK:         return %[[ACC]] : i32
+func.func @triangle(%arg0: memref<16xi32>) -> i32 {
+  %c0 = arith.constant 0 : index
+  %c0_i32 = arith.constant 0 : i32
+  cf.br ^bb1(%c0, %c0_i32 : index, i32)
+^bb1(%i: index, %acc: i32):
+  %c16 = arith.constant 16 : index
+  %cond = arith.cmpi slt, %i, %c16 : index
+  cf.cond_br %cond, ^bb2, ^bb5
+^bb2:
+  %0 = memref.load %arg0[%i] : memref<16xi32>
+  %c10 = arith.constant 10 : i32
+  %1 = arith.cmpi sgt, %0, %c10 : i32
+  cf.cond_br %1, ^bb3, ^bb4(%acc : i32)
+^bb3:
+  %2 = arith.addi %acc, %0 : i32
+  cf.br ^bb4(%2 : i32)
+^bb4(%3: i32):
+  %c1 = arith.constant 1 : index
+  %next = arith.addi %i, %c1 : index
+  cf.br ^bb1(%next, %3 : index, i32)
+^bb5:
+  return %acc : i32
+}
+
+// -----
+
+// Branches which access memory or may trap are not speculated.
+
+// CHECK-LABEL: func.func @not_converted(
+// CHECK:         cf.cond_br
+// CHECK:         memref.store
+// CHECK:         cf.cond_br
+// CHECK:         arith.divsi
+func.func @not_converted(%arg0: memref<16xi32>, %arg1: i1, %arg2: i32,
+                         %arg3: i32) -> i32 {
+  cf.cond_br %arg1, ^bb1, ^bb2
+^bb1:
+  %c0 = arith.constant 0 : index
+  memref.store %arg2, %arg0[%c0] : memref<16xi32>
+  cf.br ^bb2
+^bb2:
+  cf.cond_br %arg1, ^bb3, ^bb4(%arg2 : i32)
+^bb3:
+  %0 = arith.divsi %arg2, %arg3 : i32
+  cf.br ^bb4(%0 : i32)
+^bb4(%1: i32):
+  return %1 : i32
+}
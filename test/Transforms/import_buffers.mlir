@@ -0,0 +1,61 @@
+// RUN: echo '{"buffers": [                                                    \
+// RUN:   {"name": "Buffer_1", "slots": 2, "transparent": true, "channels": [  \
+// RUN:     {"keys": [["arith.subi#0->handshake.return#0", 1]]}]},             \
+// RUN:   {"name": "Buffer_2", "slots": 3, "transparent": false, "channels": [ \
+// RUN:     {"keys": [["arith.subi#0->handshake.return#0", 1]]}]},             \
+// RUN:   {"name": "Buffer_3", "slots": 2, "transparent": true, "channels": [  \
+// RUN:     {"keys": [["arith.muli#0->arith.xori#0", 2],                       \
+// RUN:               ["arith.muli(arith.addi,arg)#0->arith.xori#0", 1]]}]},   \
+// RUN:   {"name": "Buffer_4", "slots": 4, "transparent": false, "channels": [ \
+// RUN:     {"keys": [["arg#0->arith.andi#0", 1]]}]}]}'                        \
+// RUN:   > %t.json
+// RUN: hls-opt -split-input-file -handshake-import-buffers="placement=%t.json" %s | FileCheck %s
+
+// The buffers placed on a channel are merged into a single buffer of all their
+// slots, which is sequential since one of them is not transparent.
+
+// CHECK-LABEL:   handshake.func @merged(
+// CHECK:           %[[SUB:.+]] = arith.subi
+// CHECK:           %[[BUF:.+]] = buffer [5] seq %[[SUB]] : i32
+// CHECK:           return %[[BUF]], %{{.+}} : i32, none
+handshake.func @merged(%arg0: i32, %arg1: i32, %ctrl: none) -> (i32, none) {
+  %0 = arith.subi %arg0, %arg1 : i32
+  return %0, %ctrl : i32, none
+}
+
+// -----
+
+// Both multipliers drive the first operand of an xor, so the channel is only
+// matched by the producers of the multiplier.
+
+// CHECK-LABEL:   handshake.func @deeper(
+// CHECK:           %[[MUL0:.+]] = arith.muli
+// CHECK:           %[[BUF:.+]] = buffer [2] fifo %[[MUL0]] : i32
+// CHECK:           %[[MUL1:.+]] = arith.muli
+// CHECK-NOT:       buffer
+// CHECK:           arith.xori %[[BUF]], %{{.+}} : i32
+// CHECK:           arith.xori %[[MUL1]], %{{.+}} : i32
+handshake.func @deeper(%arg0: i32, %arg1: i32, %ctrl: none) -> (i32, i32, none) {
+  %0 = arith.addi %arg0, %arg1 : i32
+  %1 = arith.muli %0, %arg1 : i32
+  %2 = arith.muli %arg0, %arg1 : i32
+  %3 = arith.xori %1, %arg0 : i32
+  %4 = arith.xori %2, %arg0 : i32
+  return %3, %4, %ctrl : i32, i32, none
+}
+
+// -----
+
+// A channel which is already buffered has its buffer grown, which keeps its
+// type.
+
+// CHECK-LABEL:   handshake.func @grown(
+// CHECK-SAME:                          %[[ARG0:[a-z0-9_]+]]: i32,
+// CHECK:           %[[BUF:.+]] = buffer [4] fifo %[[ARG0]] : i32
+// CHECK-NOT:       buffer
+// CHECK:           arith.andi %[[BUF]], %{{.+}} : i32
+handshake.func @grown(%arg0: i32, %arg1: i32, %ctrl: none) -> (i32, none) {
+  %0 = buffer [2] fifo %arg0 : i32
+  %1 = arith.andi %0, %arg1 : i32
+  return %1, %ctrl : i32, none
+}
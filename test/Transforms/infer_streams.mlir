@@ -0,0 +1,93 @@
+// RUN: hls-opt -split-input-file -affine-infer-streams %s | FileCheck %s
+
+// CHECK-LABEL: func.func @vector_rescale(
+// CHECK-SAME:      %{{.+}}: memref<16xi32> {hlt.stream},
+// CHECK-SAME:      %{{.+}}: memref<16xi32> {hlt.stream}, %{{.+}}: i32)
+func.func @vector_rescale(%arg0: memref<16xi32>, %arg1: memref<16xi32>, %arg2: i32) {
+  affine.for %i = 0 to 16 {
+    %0 = affine.load %arg0[%i] : memref<16xi32>
+    %1 = arith.muli %0, %arg2 : i32
+    affine.store %1, %arg1[%i] : memref<16xi32>
+  }
+  return
+}
+
+// -----
+
+// Each dimension is indexed by the induction variable of its own loop, in
+// row-major order.
+
+// CHECK-LABEL: func.func @rows(
+// CHECK-SAME:      %{{.+}}: memref<4x8xi32> {hlt.stream}) -> i32
+func.func @rows(%arg0: memref<4x8xi32>) -> i32 {
+  %c0 = arith.constant 0 : i32
+  %0 = affine.for %i = 0 to 4 iter_args(%acc = %c0) -> (i32) {
+    %1 = affine.for %j = 0 to 8 iter_args(%acc1 = %acc) -> (i32) {
+      %2 = affine.load %arg0[%i, %j] : memref<4x8xi32>
+      %3 = arith.addi %acc1, %2 : i32
+      affine.yield %3 : i32
+    }
+    affine.yield %1 : i32
+  }
+  return %0 : i32
+}
+
+// -----
+
+// Memrefs which are accessed through multiple ops, out of order, in multiple
+// passes, partially, or conditionally are not streamed.
+
+// CHECK-LABEL: func.func @not_streamed(
+// CHECK-NOT:     hlt.stream
+func.func @not_streamed(%arg0: memref<16xi32>, %arg1: memref<4x4xi32>,
+                        %arg2: memref<16xi32>, %arg3: memref<16xi32>,
+                        %arg4: memref<16xi32>) {
+  %buf = memref.alloca() : memref<16xi32>
+  affine.for %i = 0 to 16 {
+    %0 = affine.load %arg0[%i] : memref<16xi32>
+    affine.store %0, %arg0[%i] : memref<16xi32>
+  }
+  affine.for %i = 0 to 4 {
+    affine.for %j = 0 to 4 {
+      %1 = affine.load %arg1[%j, %i] : memref<4x4xi32>
+      affine.store %1, %buf[%i * 4 + %j] : memref<16xi32>
+    }
+  }
+  affine.for %k = 0 to 2 {
+    affine.for %i = 0 to 16 {
+      %2 = affine.load %arg2[%i] : memref<16xi32>
+      affine.store %2, %buf[%i] : memref<16xi32>
+    }
+  }
+  affine.for %i = 0 to 8 {
+    %3 = affine.load %arg3[%i] : memref<16xi32>
+    affine.store %3, %buf[%i] : memref<16xi32>
+  }
+  affine.for %i = 0 to 16 {
+    affine.if affine_set<(d0) : (d0 - 8 >= 0)>(%i) {
+      %4 = affine.load %arg4[%i] : memref<16xi32>
+      affine.store %4, %buf[%i] : memref<16xi32>
+    }
+  }
+  return
+}
+
+// -----
+
+// The arguments of functions which are called from within the module are not
+// streamed, since the host does not pass them.
+
+// CHECK-LABEL: func.func @callee(%arg0: memref<16xi32>) -> i32 {
+  %c0 = arith.constant 0 : i32
+  %0 = affine.for %i = 0 to 16 iter_args(%acc = %c0) -> (i32) {
+    %1 = affine.load %arg0[%i] : memref<16xi32>
+    %2 = arith.addi %acc, %1 : i32
+    affine.yield %2 : i32
+  }
+  return %0 : i32
+}
+
+func.func @caller(%arg0: memref<16xi32>) -> i32 {
+  %0 = call @callee(%arg0) : (memref<16xi32>) -> i32
+  return %0 : i32
+}
@@ -0,0 +1,49 @@
+// RUN: hls-opt -split-input-file -max-ssa="liveness" %s | FileCheck %s
+
+// CHECK-LABEL:   func.func @loop(
+// CHECK-SAME:                    %[[VAL_0:.*]]: i32, %[[VAL_1:.*]]: i32) -> i32 {
+// CHECK:           %[[VAL_2:.*]] = arith.constant 0 : i32
+// CHECK:           cf.br ^bb1(%[[VAL_2]], %[[VAL_0]], %[[VAL_1]] : i32, i32, i32)
+// CHECK:         ^bb1(%[[VAL_3:.*]]: i32, %[[VAL_4:.*]]: i32, %[[VAL_5:.*]]: i32):
+// CHECK:           %[[VAL_6:.*]] = arith.cmpi slt, %[[VAL_3]], %[[VAL_4]] : i32
+// CHECK:           cf.cond_br %[[VAL_6]], ^bb2(%[[VAL_4]], %[[VAL_5]], %[[VAL_3]] : i32, i32, i32), ^bb3(%[[VAL_3]] : i32)
+// CHECK:         ^bb2(%[[VAL_7:.*]]: i32, %[[VAL_8:.*]]: i32, %[[VAL_9:.*]]: i32):
+// CHECK:           %[[VAL_10:.*]] = arith.addi %[[VAL_9]], %[[VAL_8]] : i32
+// CHECK:           cf.br ^bb1(%[[VAL_10]], %[[VAL_7]], %[[VAL_8]] : i32, i32, i32)
+// CHECK:         ^bb3(%[[VAL_11:.*]]: i32):
+// CHECK:           return %[[VAL_11]] : i32
+// CHECK:         }
+func.func @loop(%arg0: i32, %arg1: i32) -> i32 {
+  %c0 = arith.constant 0 : i32
+  cf.br ^bb1(%c0 : i32)
+^bb1(%0: i32):
+  %1 = arith.cmpi slt, %0, %arg0 : i32
+  cf.cond_br %1, ^bb2, ^bb3
+^bb2:
+  %2 = arith.addi %0, %arg1 : i32
+  cf.br ^bb1(%2 : i32)
+^bb3:
+  return %0 : i32
+}
+
+// -----
+
+// Values are only passed to the blocks in which they are live-in.
+
+// CHECK-LABEL:   func.func @not_live(
+// CHECK-SAME:                        %[[VAL_0:.*]]: i1, %[[VAL_1:.*]]: i32) -> i32 {
+// CHECK:           cf.cond_br %[[VAL_0]], ^bb1, ^bb2(%[[VAL_1]] : i32)
+// CHECK:         ^bb1:
+// CHECK:           %[[VAL_2:.*]] = arith.constant 1 : i32
+// CHECK:           return %[[VAL_2]] : i32
+// CHECK:         ^bb2(%[[VAL_3:.*]]: i32):
+// CHECK:           return %[[VAL_3]] : i32
+// CHECK:         }
+func.func @not_live(%arg0: i1, %arg1: i32) -> i32 {
+  cf.cond_br %arg0, ^bb1, ^bb2
+^bb1:
+  %c1 = arith.constant 1 : i32
+  return %c1 : i32
+^bb2:
+  return %arg1 : i32
+}
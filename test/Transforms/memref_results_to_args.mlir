@@ -0,0 +1,73 @@
+// RUN: hls-opt -split-input-file -hls-memref-results-to-args %s | FileCheck %s
+
+// The allocated result is passed through an argument, which the kernel stores
+// to in place of the allocation.
+
+// CHECK-LABEL: func.func @square(
+// CHECK-SAME:      %[[IN:.+]]: memref<8xi32>,
+// CHECK-SAME:      %[[OUT:.+]]: memref<8xi32> {hlt.result = {index = 0 : i64}}) {
+// CHECK-NOT:     memref.alloc
+// CHECK:         affine.for %[[I:.+]] = 0 to 8 {
+// CHECK:           %[[X:.+]] = affine.load %[[IN]][%[[I]]]
+// CHECK:           %[[SQ:.+]] = arith.muli %[[X]], %[[X]] : i32
+// CHECK:           affine.store %[[SQ]], %[[OUT]][%[[I]]]
+// CHECK:         return
+// CHECK-NEXT:  }
+func.func @square(%in: memref<8xi32>) -> memref<8xi32> {
+  %out = memref.alloc() : memref<8xi32>
+  affine.for %i = 0 to 8 {
+    %x = affine.load %in[%i] : memref<8xi32>
+    %sq = arith.muli %x, %x : i32
+    affine.store %sq, %out[%i] : memref<8xi32>
+  }
+  return %out : memref<8xi32>
+}
+
+// -----
+
+// Scalar results are kept, and the index of the memref result is recorded.
+
+// CHECK-LABEL: func.func @sum_and_copy(
+// CHECK-SAME:      %[[IN:.+]]: memref<4xi32>,
+// CHECK-SAME:      %[[OUT:.+]]: memref<4xi32> {hlt.result = {index = 1 : i64}}) -> i32 {
+// CHECK:         memref.copy %[[IN]], %[[OUT]]
+// CHECK:         return %{{.+}} : i32
+func.func @sum_and_copy(%in: memref<4xi32>) -> (i32, memref<4xi32>) {
+  %out = memref.alloc() : memref<4xi32>
+  memref.copy %in, %out : memref<4xi32> to memref<4xi32>
+  %c0 = arith.constant 0 : i32
+  %sum = affine.for %i = 0 to 4 iter_args(%acc = %c0) -> i32 {
+    %x = affine.load %in[%i] : memref<4xi32>
+    %s = arith.addi %acc, %x : i32
+    affine.yield %s : i32
+  }
+  return %sum, %out : i32, memref<4xi32>
+}
+
+// -----
+
+// Results which are arguments or dynamically shaped are kept, as are the
+// results of functions which are called within the module.
+
+// CHECK-LABEL: func.func @kept(
+// CHECK-SAME:      %[[IN:.+]]: memref<4xi32>, %[[N:.+]]: index) -> (memref<4xi32>, memref<?xi32>) {
+// CHECK:         memref.alloc(%[[N]]) : memref<?xi32>
+// CHECK:         return %[[IN]], %{{.+}} : memref<4xi32>, memref<?xi32>
+func.func @kept(%in: memref<4xi32>, %n: index) -> (memref<4xi32>, memref<?xi32>) {
+  %dyn = memref.alloc(%n) : memref<?xi32>
+  return %in, %dyn : memref<4xi32>, memref<?xi32>
+}
+
+// CHECK-LABEL: func.func @callee() -> memref<4xi32> {
+// CHECK:         memref.alloc() : memref<4xi32>
+func.func @callee() -> memref<4xi32> {
+  %out = memref.alloc() : memref<4xi32>
+  return %out : memref<4xi32>
+}
+
+// CHECK-LABEL: func.func @caller() {
+func.func @caller() {
+  %0 = func.call @callee() : () -> memref<4xi32>
+  memref.dealloc %0 : memref<4xi32>
+  return
+}
@@ -0,0 +1,42 @@
+// RUN: hls-opt -split-input-file -hls-memref-results-to-args -affine-vectorize-memrefs -affine-partition-memrefs="kind=block" %s | FileCheck %s
+
+// The memory of a result argument is returned to the host as is, so it is
+// kept whole, whereas the input is vectorized.
+
+// CHECK-LABEL: func.func @vectorized(
+// CHECK-SAME:      %[[IN:.+]]: memref<4xi64> {hlt.vector = {factor = 2 : i64, shape = [8]}},
+// CHECK-SAME:      %[[OUT:.+]]: memref<8xi32> {hlt.result = {index = 0 : i64}}) {
+// CHECK:         affine.load %[[IN]][%{{.+}} floordiv 2] : memref<4xi64>
+// CHECK:         affine.store %{{.+}}, %[[OUT]][%{{.+}}] : memref<8xi32>
+// CHECK:         affine.store %{{.+}}, %[[OUT]][%{{.+}} + 1] : memref<8xi32>
+func.func @vectorized(%in: memref<8xi32>) -> memref<8xi32> {
+  %out = memref.alloc() : memref<8xi32>
+  affine.for %i = 0 to 8 step 2 {
+    %0 = affine.load %in[%i] : memref<8xi32>
+    %1 = affine.load %in[%i + 1] : memref<8xi32>
+    affine.store %1, %out[%i] : memref<8xi32>
+    affine.store %0, %out[%i + 1] : memref<8xi32>
+  }
+  return %out : memref<8xi32>
+}
+
+// -----
+
+// The input is partitioned, whereas the result argument is kept whole.
+
+// CHECK-LABEL: func.func @partitioned(
+// CHECK-SAME:      %[[B0:.+]]: memref<4xi32> {hlt.partition = {arg = 0 : i64, bank = 0 : i64, dim = 0 : i64, factor = 2 : i64, kind = "block", shape = [8]}},
+// CHECK-SAME:      %[[B1:.+]]: memref<4xi32> {hlt.partition = {arg = 0 : i64, bank = 1 : i64, dim = 0 : i64, factor = 2 : i64, kind = "block", shape = [8]}},
+// CHECK-SAME:      %[[OUT:.+]]: memref<8xi32> {hlt.result = {index = 0 : i64}}) {
+// CHECK:         affine.store %{{.+}}, %[[OUT]][%{{.+}}] : memref<8xi32>
+// CHECK:         affine.store %{{.+}}, %[[OUT]][%{{.+}} + 4] : memref<8xi32>
+func.func @partitioned(%in: memref<8xi32>) -> memref<8xi32> {
+  %out = memref.alloc() : memref<8xi32>
+  affine.for %i = 0 to 4 {
+    %0 = affine.load %in[%i] : memref<8xi32>
+    %1 = affine.load %in[%i + 4] : memref<8xi32>
+    affine.store %1, %out[%i] : memref<8xi32>
+    affine.store %0, %out[%i + 4] : memref<8xi32>
+  }
+  return %out : memref<8xi32>
+}
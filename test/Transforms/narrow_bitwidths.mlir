@@ -0,0 +1,76 @@
+// RUN: hls-opt -split-input-file -hls-narrow-bitwidths %s | FileCheck %s
+
+// The loop counts over the smallest type which holds its bounds, and the
+// masked value is computed, compared and selected at 8 bits.
+
+// CHECK-LABEL: func.func @loop(
+// CHECK-SAME:      %[[A:.+]]: memref<100xi32>)
+// CHECK-NOT:     : index
+// CHECK:         %[[C0:.+]] = arith.constant 0 : i8
+// CHECK:         %[[C100:.+]] = arith.constant 100 : i8
+// CHECK:         %[[C1:.+]] = arith.constant 1 : i8
+// CHECK:         scf.for %[[I:.+]] = %[[C0]] to %[[C100]] step %[[C1]] : i8 {
+// CHECK:           %[[IV:.+]] = arith.index_cast %[[I]] : i8 to index
+// CHECK:           %[[V:.+]] = memref.load %[[A]][%[[IV]]] : memref<100xi32>
+// CHECK:           %[[VT:.+]] = arith.trunci %[[V]] : i32 to i8
+// CHECK:           %[[MASK:.+]] = arith.constant -1 : i8
+// CHECK:           %[[AND:.+]] = arith.andi %[[VT]], %[[MASK]] : i8
+// CHECK:           %[[C16:.+]] = arith.constant 16 : i8
+// CHECK:           %[[LT:.+]] = arith.cmpi ult, %[[AND]], %[[C16]] : i8
+// CHECK:           %[[C16_0:.+]] = arith.constant 16 : i8
+// CHECK:           %[[SEL:.+]] = arith.select %[[LT]], %[[AND]], %[[C16_0]] : i8
+// CHECK:           %[[EXT:.+]] = arith.extui %[[SEL]] : i8 to i32
+// CHECK:           memref.store %[[EXT]], %[[A]][%[[IV]]] : memref<100xi32>
+func.func @loop(%arg0: memref<100xi32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c100 = arith.constant 100 : index
+  %c16 = arith.constant 16 : i32
+  %c255 = arith.constant 255 : i32
+  scf.for %i = %c0 to %c100 step %c1 {
+    %0 = memref.load %arg0[%i] : memref<100xi32>
+    %1 = arith.andi %0, %c255 : i32
+    %2 = arith.cmpi ult, %1, %c16 : i32
+    %3 = arith.select %2, %1, %c16 : i32
+    memref.store %3, %arg0[%i] : memref<100xi32>
+  }
+  return
+}
+
+// -----
+
+// A block argument is narrowed along with the values forwarded to it.
+
+// CHECK-LABEL: func.func @block_arg(
+// CHECK-SAME:      %[[X:.+]]: i32, %[[C:.+]]: i1) -> i32
+// CHECK:         %[[XT:.+]] = arith.trunci %[[X]] : i32 to i8
+// CHECK:         %[[MASK:.+]] = arith.constant -1 : i8
+// CHECK:         %[[AND:.+]] = arith.andi %[[XT]], %[[MASK]] : i8
+// CHECK:         %[[MAX:.+]] = arith.constant -1 : i8
+// CHECK:         cf.cond_br %[[C]], ^bb1(%[[AND]] : i8), ^bb1(%[[MAX]] : i8)
+// CHECK:       ^bb1(%[[ARG:.+]]: i8):
+// CHECK:         %[[C128:.+]] = arith.constant -128 : i8
+// CHECK:         %[[XOR:.+]] = arith.xori %[[ARG]], %[[C128]] : i8
+// CHECK:         %[[EXT:.+]] = arith.extui %[[XOR]] : i8 to i32
+// CHECK:         return %[[EXT]] : i32
+func.func @block_arg(%arg0: i32, %arg1: i1) -> i32 {
+  %c255 = arith.constant 255 : i32
+  %0 = arith.andi %arg0, %c255 : i32
+  cf.cond_br %arg1, ^bb1(%0 : i32), ^bb1(%c255 : i32)
+^bb1(%1: i32):
+  %c128 = arith.constant 128 : i32
+  %2 = arith.xori %1, %c128 : i32
+  return %2 : i32
+}
+
+// -----
+
+// Values of unknown range keep their width.
+
+// CHECK-LABEL: func.func @unknown(
+// CHECK-NEXT:    %[[SUM:.+]] = arith.addi %{{.+}}, %{{.+}} : i32
+// CHECK-NEXT:    return %[[SUM]] : i32
+func.func @unknown(%arg0: i32, %arg1: i32) -> i32 {
+  %0 = arith.addi %arg0, %arg1 : i32
+  return %0 : i32
+}
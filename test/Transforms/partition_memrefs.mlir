@@ -0,0 +1,64 @@
+// RUN: hls-opt -split-input-file -affine-partition-memrefs %s | FileCheck %s
+// RUN: hls-opt -split-input-file -affine-partition-memrefs="kind=block" %s | FileCheck %s --check-prefix=BLOCK
+
+// CHECK-LABEL: func.func @cyclic(
+// CHECK-SAME:      %[[B0:.+]]: memref<2x4xi32> {hlt.partition = {arg = 0 : i64, bank = 0 : i64, dim = 1 : i64, factor = 2 : i64, kind = "cyclic", shape = [2, 8]}},
+// CHECK-SAME:      %[[B1:.+]]: memref<2x4xi32> {hlt.partition = {arg = 0 : i64, bank = 1 : i64, dim = 1 : i64, factor = 2 : i64, kind = "cyclic", shape = [2, 8]}},
+// CHECK-SAME:      %{{.+}}: i32)
+// CHECK:         affine.for %[[I:.+]] = 0 to 2 {
+// CHECK:           affine.for %[[J:.+]] = 0 to 8 step 2 {
+// CHECK:             affine.load %[[B0]][%[[I]], %[[J]] floordiv 2] : memref<2x4xi32>
+// CHECK:             affine.load %[[B1]][%[[I]], %[[J]] floordiv 2] : memref<2x4xi32>
+// CHECK:             affine.store %{{.+}}, %[[B0]][%[[I]], %[[J]] floordiv 2] : memref<2x4xi32>
+// CHECK:             affine.store %{{.+}}, %[[B1]][%[[I]], %[[J]] floordiv 2] : memref<2x4xi32>
+func.func @cyclic(%arg0: memref<2x8xi32>, %arg1: i32) {
+  affine.for %i = 0 to 2 {
+    affine.for %j = 0 to 8 step 2 {
+      %0 = affine.load %arg0[%i, %j] : memref<2x8xi32>
+      %1 = affine.load %arg0[%i, %j + 1] : memref<2x8xi32>
+      %2 = arith.addi %0, %arg1 : i32
+      %3 = arith.addi %1, %arg1 : i32
+      affine.store %2, %arg0[%i, %j] : memref<2x8xi32>
+      affine.store %3, %arg0[%i, %j + 1] : memref<2x8xi32>
+    }
+  }
+  return
+}
+
+// -----
+
+// The accesses of the loop may access any element, so the memref is not
+// partitioned.
+
+// CHECK-LABEL: func.func @unpartitioned(
+// CHECK-SAME:      %{{.+}}: memref<8xi32>) -> i32
+// CHECK-NOT:     hlt.partition
+func.func @unpartitioned(%arg0: memref<8xi32>) -> i32 {
+  %c0 = arith.constant 0 : i32
+  %0 = affine.for %i = 0 to 8 iter_args(%acc = %c0) -> (i32) {
+    %1 = affine.load %arg0[%i] : memref<8xi32>
+    %2 = arith.addi %acc, %1 : i32
+    affine.yield %2 : i32
+  }
+  return %0 : i32
+}
+
+// -----
+
+// BLOCK-LABEL: func.func @block(
+// BLOCK-SAME:      %[[B0:.+]]: memref<4xi32> {hlt.partition = {arg = 0 : i64, bank = 0 : i64, dim = 0 : i64, factor = 2 : i64, kind = "block", shape = [8]}},
+// BLOCK-SAME:      %[[B1:.+]]: memref<4xi32> {hlt.partition = {arg = 0 : i64, bank = 1 : i64, dim = 0 : i64, factor = 2 : i64, kind = "block", shape = [8]}}) -> i32
+// BLOCK:         affine.for %[[I:.+]] = 0 to 4
+// BLOCK:           affine.load %[[B0]][%[[I]]] : memref<4xi32>
+// BLOCK:           affine.load %[[B1]][%[[I]]] : memref<4xi32>
+func.func @block(%arg0: memref<8xi32>) -> i32 {
+  %c0 = arith.constant 0 : i32
+  %0 = affine.for %i = 0 to 4 iter_args(%acc = %c0) -> (i32) {
+    %1 = affine.load %arg0[%i] : memref<8xi32>
+    %2 = affine.load %arg0[%i + 4] : memref<8xi32>
+    %3 = arith.addi %1, %2 : i32
+    %4 = arith.addi %acc, %3 : i32
+    affine.yield %4 : i32
+  }
+  return %0 : i32
+}
@@ -0,0 +1,84 @@
+// RUN: hls-opt -split-input-file -affine-partition-tasks %s | FileCheck %s
+
+// The second nest consumes the intermediate of the first, while the third only
+// shares a read-only input with it.
+
+// CHECK-LABEL: func.func @phases(
+// CHECK-SAME:      %[[A:.+]]: memref<8xi32> {hlt.stream}, %[[B:.+]]: memref<8xi32>, %[[C:.+]]: memref<8xi32>) {
+// CHECK:         %[[TMP:.+]] = memref.alloc() : memref<8xi32>
+// CHECK-NEXT:    %[[T0:.+]] = call @phases_task0(%[[A]], %[[TMP]]) : (memref<8xi32>, memref<8xi32>) -> i1
+// CHECK-NEXT:    %[[T1:.+]] = call @phases_task1(%[[T0]], %[[B]], %[[TMP]]) : (i1, memref<8xi32>, memref<8xi32>) -> i1
+// CHECK-NEXT:    call @phases_task2(%[[T1]], %[[A]], %[[C]]) : (i1, memref<8xi32>, memref<8xi32>) -> ()
+// CHECK-NEXT:    return
+
+// CHECK-LABEL: func.func @phases_task0(
+// CHECK-SAME:      %[[A:.+]]: memref<8xi32> {hlt.stream}, %[[TMP:.+]]: memref<8xi32>) -> i1
+// CHECK-SAME:      attributes {hlt.task = 0 : i64, hlt.task_deps = []}
+// CHECK:         %[[C2:.+]] = arith.constant 2 : i32
+// CHECK:         affine.for
+// CHECK:           arith.muli %{{.+}}, %[[C2]] : i32
+// CHECK:         %[[TRUE:.+]] = arith.constant true
+// CHECK:         return %[[TRUE]] : i1
+
+// CHECK-LABEL: func.func @phases_task1(
+// CHECK-SAME:      %{{.+}}: i1, %{{.+}}: memref<8xi32>, %{{.+}}: memref<8xi32>) -> i1
+// CHECK-SAME:      attributes {hlt.task = 1 : i64, hlt.task_deps = [0]}
+
+// CHECK-LABEL: func.func @phases_task2(
+// CHECK-SAME:      %{{.+}}: i1, %{{.+}}: memref<8xi32> {hlt.stream}, %{{.+}}: memref<8xi32>)
+// CHECK-SAME:      attributes {hlt.task = 2 : i64, hlt.task_deps = []}
+// CHECK-NOT:     arith.constant 2
+// CHECK:         return{{$}}
+func.func @phases(%a: memref<8xi32> {hlt.stream}, %b: memref<8xi32>, %c: memref<8xi32>) {
+  %c2 = arith.constant 2 : i32
+  %tmp = memref.alloc() : memref<8xi32>
+  affine.for %i = 0 to 8 {
+    %0 = affine.load %a[%i] : memref<8xi32>
+    %1 = arith.muli %0, %c2 : i32
+    affine.store %1, %tmp[%i] : memref<8xi32>
+  }
+  affine.for %i = 0 to 8 {
+    %0 = affine.load %tmp[%i] : memref<8xi32>
+    affine.store %0, %b[%i] : memref<8xi32>
+  }
+  affine.for %i = 0 to 8 {
+    %0 = affine.load %a[%i] : memref<8xi32>
+    affine.store %0, %c[%i] : memref<8xi32>
+  }
+  return
+}
+
+// -----
+
+// Kernels with results, or with ops other than loop nests which have memory
+// effects, are left as is.
+
+// CHECK-LABEL: func.func @result(
+// CHECK-NOT:     call
+func.func @result(%a: memref<8xi32>) -> i32 {
+  %c0 = arith.constant 0 : index
+  affine.for %i = 0 to 8 {
+    %0 = affine.load %a[%i] : memref<8xi32>
+    affine.store %0, %a[%i] : memref<8xi32>
+  }
+  affine.for %i = 0 to 8 {
+    %0 = affine.load %a[%i] : memref<8xi32>
+    affine.store %0, %a[%i] : memref<8xi32>
+  }
+  %1 = memref.load %a[%c0] : memref<8xi32>
+  return %1 : i32
+}
+
+// CHECK-LABEL: func.func @effects(
+// CHECK-NOT:     call
+func.func @effects(%a: memref<8xi32>, %v: i32) {
+  %c0 = arith.constant 0 : index
+  affine.for %i = 0 to 8 {
+    affine.store %v, %a[%i] : memref<8xi32>
+  }
+  memref.store %v, %a[%c0] : memref<8xi32>
+  affine.for %i = 0 to 8 {
+    affine.store %v, %a[%i] : memref<8xi32>
+  }
+  return
+}
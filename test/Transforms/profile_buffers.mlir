@@ -0,0 +1,42 @@
+// RUN: echo '{"cycles": 1000, "channels": [                                   \
+// RUN:   {"name": "fork_join.handshake_fork0_out0", "fire": 100, "stall": 300}, \
+// RUN:   {"name": "fork_join.handshake_fork0_out1", "fire": 100, "stall": 20}, \
+// RUN:   {"name": "loop.handshake_buffer0_out0", "fire": 100, "stall": 200},  \
+// RUN:   {"name": "loop.handshake_fork0_out0", "fire": 50, "stall": 100}]}'   \
+// RUN:   > %t.json
+// RUN: hls-opt -split-input-file -handshake-profile-buffers="profile=%t.json" %s | FileCheck %s
+
+// The direct branch of the fork waits for the multiplier on the other branch,
+// so it is given a sequential buffer of a slot per cycle that each of its
+// transactions stalled for. The other branch stalled for less than the
+// threshold.
+
+// CHECK-LABEL:   handshake.func @fork_join(
+// CHECK:           %[[FORK:.+]]:2 = fork [2] %{{.+}} {handshake_id = 0 : i64} : i32
+// CHECK:           %[[BUF:.+]] = buffer [3] seq %[[FORK]]#0 {handshake_id = 0 : i64} : i32
+// CHECK:           %[[MUL:.+]] = arith.muli %[[FORK]]#1,
+// CHECK-NOT:       buffer
+// CHECK:           arith.addi %[[BUF]], %[[MUL]]
+handshake.func @fork_join(%arg0: i32, %arg1: i32, %ctrl: none) -> (i32, none) {
+  %0:2 = fork [2] %arg0 {handshake_id = 0 : i64} : i32
+  %1 = arith.muli %0#1, %arg1 {handshake_id = 0 : i64} : i32
+  %2 = arith.addi %0#0, %1 {handshake_id = 0 : i64} : i32
+  return %2, %ctrl : i32, none
+}
+
+// -----
+
+// The stalled buffer of the loop is grown, and the buffer inserted after the
+// fork is transparent, since it is on the loop.
+
+// CHECK-LABEL:   handshake.func @loop(
+// CHECK:           %[[MERGE:.+]] = merge %{{.+}}, %[[BUF0:[0-9]+]] {handshake_id = 0 : i64} : i32
+// CHECK:           %[[FORK:.+]]:2 = fork [2] %[[MERGE]] {handshake_id = 0 : i64} : i32
+// CHECK:           %[[BUF1:.+]] = buffer [2] fifo %[[FORK]]#0 {handshake_id = 1 : i64} : i32
+// CHECK:           %[[BUF0]] = buffer [3] seq %[[BUF1]] {handshake_id = 0 : i64} : i32
+handshake.func @loop(%arg0: i32, %ctrl: none) -> (i32, none) {
+  %0 = merge %arg0, %2 {handshake_id = 0 : i64} : i32
+  %1:2 = fork [2] %0 {handshake_id = 0 : i64} : i32
+  %2 = buffer [1] seq %1#0 {handshake_id = 0 : i64} : i32
+  return %1#1, %ctrl : i32, none
+}
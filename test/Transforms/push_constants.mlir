@@ -0,0 +1,31 @@
+// RUN: hls-opt -push-constants %s | FileCheck %s
+// RUN: hls-opt -push-constants="max-width=8 max-copies=1" %s | FileCheck %s --check-prefix=SHARED
+
+// CHECK-LABEL: func.func @push(
+// CHECK:         cf.cond_br
+// CHECK:       ^bb1:
+// CHECK-NEXT:    %[[C1:.+]] = arith.constant 42 : i32
+// CHECK-NEXT:    arith.addi %{{.+}}, %[[C1]] : i32
+// CHECK:       ^bb2:
+// CHECK-NEXT:    %[[C2:.+]] = arith.constant 42 : i32
+// CHECK-NEXT:    arith.muli %{{.+}}, %[[C2]] : i32
+
+// The constant is wider than 'max-width' and used in more than 'max-copies'
+// other blocks, so it is left to be shared.
+// SHARED-LABEL: func.func @push(
+// SHARED:         %[[C:.+]] = arith.constant 42 : i32
+// SHARED:         cf.cond_br
+// SHARED:       ^bb1:
+// SHARED-NEXT:    arith.addi %{{.+}}, %[[C]] : i32
+// SHARED:       ^bb2:
+// SHARED-NEXT:    arith.muli %{{.+}}, %[[C]] : i32
+func.func @push(%arg0: i1, %arg1: i32) -> i32 {
+  %c42 = arith.constant 42 : i32
+  cf.cond_br %arg0, ^bb1, ^bb2
+^bb1:
+  %0 = arith.addi %arg1, %c42 : i32
+  return %0 : i32
+^bb2:
+  %1 = arith.muli %arg1, %c42 : i32
+  return %1 : i32
+}
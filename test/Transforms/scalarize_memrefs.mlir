@@ -0,0 +1,99 @@
+// RUN: hls-opt -split-input-file -hls-scalarize-memrefs %s | FileCheck %s
+
+// The coefficients are only read at constant indices, and are passed as one
+// argument per element. The input is indexed by the loop, and is kept.
+
+// CHECK-LABEL: func.func @fir(
+// CHECK-SAME:      %[[IN:.+]]: memref<8xi32>,
+// CHECK-SAME:      %[[C0:.+]]: i32 {hlt.scalar = {elem = 0 : i64, shape = [3]}},
+// CHECK-SAME:      %[[C1:.+]]: i32 {hlt.scalar = {elem = 1 : i64, shape = [3]}},
+// CHECK-SAME:      %[[C2:.+]]: i32 {hlt.scalar = {elem = 2 : i64, shape = [3]}},
+// CHECK-SAME:      %[[OUT:.+]]: memref<6xi32>) {
+// CHECK:         affine.for %[[I:.+]] = 0 to 6 {
+// CHECK:           %[[X0:.+]] = affine.load %[[IN]][%[[I]]]
+// CHECK:           arith.muli %[[X0]], %[[C0]] : i32
+// CHECK:           %[[X1:.+]] = affine.load %[[IN]][%[[I]] + 1]
+// CHECK:           arith.muli %[[X1]], %[[C1]] : i32
+// CHECK:           %[[X2:.+]] = affine.load %[[IN]][%[[I]] + 2]
+// CHECK:           arith.muli %[[X2]], %[[C2]] : i32
+func.func @fir(%in: memref<8xi32>, %coeffs: memref<3xi32>,
+               %out: memref<6xi32>) {
+  affine.for %i = 0 to 6 {
+    %x0 = affine.load %in[%i] : memref<8xi32>
+    %c0 = affine.load %coeffs[0] : memref<3xi32>
+    %p0 = arith.muli %x0, %c0 : i32
+    %x1 = affine.load %in[%i + 1] : memref<8xi32>
+    %c1 = affine.load %coeffs[1] : memref<3xi32>
+    %p1 = arith.muli %x1, %c1 : i32
+    %x2 = affine.load %in[%i + 2] : memref<8xi32>
+    %c2 = affine.load %coeffs[2] : memref<3xi32>
+    %p2 = arith.muli %x2, %c2 : i32
+    %s0 = arith.addi %p0, %p1 : i32
+    %s1 = arith.addi %s0, %p2 : i32
+    affine.store %s1, %out[%i] : memref<6xi32>
+  }
+  return
+}
+
+// -----
+
+// The elements of a multi-dimensional memref are passed in row-major order;
+// elements which are never loaded are still passed.
+
+// CHECK-LABEL: func.func @matrix(
+// CHECK-SAME:      %{{.+}}: f32 {hlt.scalar = {elem = 0 : i64, shape = [2, 2]}},
+// CHECK-SAME:      %[[M01:.+]]: f32 {hlt.scalar = {elem = 1 : i64, shape = [2, 2]}},
+// CHECK-SAME:      %[[M10:.+]]: f32 {hlt.scalar = {elem = 2 : i64, shape = [2, 2]}},
+// CHECK-SAME:      %{{.+}}: f32 {hlt.scalar = {elem = 3 : i64, shape = [2, 2]}})
+// CHECK:         %[[SUM:.+]] = arith.addf %[[M01]], %[[M10]] : f32
+// CHECK-NEXT:    return %[[SUM]] : f32
+func.func @matrix(%m: memref<2x2xf32>) -> f32 {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %0 = memref.load %m[%c0, %c1] : memref<2x2xf32>
+  %1 = affine.load %m[1, 0] : memref<2x2xf32>
+  %2 = arith.addf %0, %1 : f32
+  return %2 : f32
+}
+
+// -----
+
+// Memrefs which are written, indexed by a loop, larger than 'max-elements' or
+// partitioned are not scalarized.
+
+// CHECK-LABEL: func.func @kept(
+// CHECK-SAME:      %{{.+}}: memref<2xi32>, %{{.+}}: memref<4xi32>,
+// CHECK-SAME:      %{{.+}}: memref<16xi32>,
+// CHECK-SAME:      %{{.+}}: memref<2xi32> {hlt.partition = {{.+}}}) {
+func.func @kept(%written: memref<2xi32>, %indexed: memref<4xi32>,
+                %large: memref<16xi32>,
+                %partitioned: memref<2xi32>
+                  {hlt.partition = {factor = 2 : i64}}) {
+  %0 = affine.load %written[0] : memref<2xi32>
+  affine.store %0, %written[1] : memref<2xi32>
+  affine.for %i = 0 to 4 {
+    %1 = affine.load %indexed[%i] : memref<4xi32>
+    affine.store %1, %written[0] : memref<2xi32>
+  }
+  %2 = affine.load %large[0] : memref<16xi32>
+  %3 = affine.load %partitioned[0] : memref<2xi32>
+  %4 = arith.addi %2, %3 : i32
+  affine.store %4, %written[0] : memref<2xi32>
+  return
+}
+
+// -----
+
+// Only kernel functions are scalarized, since their callers pass memrefs.
+
+// CHECK-LABEL: func.func @callee(
+// CHECK-SAME:      %{{.+}}: memref<2xi32>) -> i32
+func.func @callee(%m: memref<2xi32>) -> i32 {
+  %0 = affine.load %m[0] : memref<2xi32>
+  return %0 : i32
+}
+
+func.func @caller(%m: memref<2xi32>) -> i32 {
+  %0 = call @callee(%m) : (memref<2xi32>) -> i32
+  return %0 : i32
+}
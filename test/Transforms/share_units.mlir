@@ -0,0 +1,58 @@
+// RUN: hls-opt -split-input-file -handshake-share-units %s | FileCheck %s
+// RUN: echo '{"cycles": 1000, "ops": [                                        \
+// RUN:   {"name": "profiled.arith_muli0", "fire": 900},                        \
+// RUN:   {"name": "profiled.arith_muli1", "fire": 100},                        \
+// RUN:   {"name": "profiled.arith_muli2", "fire": 100}]}'                      \
+// RUN:   > %t.json
+// RUN: hls-opt -split-input-file -handshake-share-units="profile=%t.json" %s | FileCheck %s --check-prefix=PROF
+
+// Without a profile, multipliers which are not on a cycle are shared. Each
+// multiplier requests the unit once its operands are available, and its result
+// is steered back to it by the index of the arbiter.
+
+// CHECK-LABEL:   handshake.func @kernel(
+// CHECK-SAME:                           %[[A:.*]]: i32, %[[B:.*]]: i32, %[[C:.*]]: i32, %[[D:.*]]: i32, %[[CTRL:.*]]: none
+// CHECK:           %[[FA:.+]]:2 = fork [2] %[[A]] : i32
+// CHECK:           %[[FB:.+]]:2 = fork [2] %[[B]] : i32
+// CHECK:           %[[J0:.+]] = join %[[FA]]#0, %[[FB]]#0
+// CHECK:           %[[FC:.+]]:2 = fork [2] %[[C]] : i32
+// CHECK:           %[[FD:.+]]:2 = fork [2] %[[D]] : i32
+// CHECK:           %[[J1:.+]] = join %[[FC]]#0, %[[FD]]#0
+// CHECK:           %[[RES:.+]], %[[IDX:.+]] = control_merge %[[J0]], %[[J1]]
+// CHECK:           sink %[[RES]]
+// CHECK:           %[[IF:.+]]:3 = fork [3] %[[IDX]] : index
+// CHECK:           %[[L:.+]] = mux %[[IF]]#0 [%[[FA]]#1, %[[FC]]#1]
+// CHECK:           %[[R:.+]] = mux %[[IF]]#1 [%[[FB]]#1, %[[FD]]#1]
+// CHECK:           %[[M:.+]] = arith.muli %[[L]], %[[R]] : i32
+// CHECK:           %[[COND:.+]] = arith.index_cast %[[IF]]#2 : index to i1
+// CHECK:           %[[T:.+]], %[[F:.+]] = cond_br %[[COND]], %[[M]] : i32
+// CHECK:           %[[B0:.+]] = buffer [2] seq %[[F]] : i32
+// CHECK:           %[[B1:.+]] = buffer [2] seq %[[T]] : i32
+// CHECK-NOT:       arith.muli
+// CHECK:           return %[[B0]], %[[B1]], %[[CTRL]] : i32, i32, none
+handshake.func @kernel(%a: i32, %b: i32, %c: i32, %d: i32, %ctrl: none) -> (i32, i32, none) {
+  %0 = arith.muli %a, %b : i32
+  %1 = arith.muli %c, %d : i32
+  return %0, %1, %ctrl : i32, i32, none
+}
+
+// -----
+
+// With a profile, the two rarely active multipliers are shared, and given IDs
+// following those of the function. Sharing the busy multiplier as well would
+// need more cycles than were simulated.
+
+// PROF-LABEL:   handshake.func @profiled(
+// PROF:           arith.muli %{{.+}}, %{{.+}} {handshake_id = 0 : i64} : i32
+// PROF:           control_merge
+// PROF-SAME:      handshake_id = 0 : i64
+// PROF:           %[[M:.+]] = arith.muli %{{.+}}, %{{.+}} {handshake_id = 3 : i64} : i32
+// PROF:           cond_br %{{.+}}, %[[M]]
+// PROF-NOT:       control_merge
+// PROF:           return
+handshake.func @profiled(%a: i32, %b: i32, %ctrl: none) -> (i32, i32, i32, none) {
+  %0 = arith.muli %a, %b {handshake_id = 0 : i64} : i32
+  %1 = arith.muli %a, %a {handshake_id = 1 : i64} : i32
+  %2 = arith.muli %b, %b {handshake_id = 2 : i64} : i32
+  return %0, %1, %2, %ctrl : i32, i32, i32, none
+}
@@ -0,0 +1,199 @@
+// RUN: hls-opt -split-input-file -hls-strength-reduce %s | FileCheck %s
+
+// The linearized index of a row is incremented by the row size on each
+// iteration.
+
+// CHECK-LABEL: func.func @rows(
+// CHECK-SAME:      %[[MEM:.+]]: memref<64xi32>) {
+// CHECK:         %[[C0:.+]] = arith.constant 0 : index
+// CHECK:         %[[INIT:.+]] = arith.constant 0 : index
+// CHECK:         cf.br ^bb1(%[[C0]], %[[INIT]] : index, index)
+// CHECK:       ^bb1(%[[I:.+]]: index, %[[ROW:.+]]: index):
+// CHECK:       ^bb2:
+// CHECK-NOT:     arith.muli
+// CHECK:         %[[IDX:.+]] = arith.addi %[[ROW]], %{{.+}} : index
+// CHECK:         memref.load %[[MEM]][%[[IDX]]] : memref<64xi32>
+// CHECK:         memref.store %{{.+}}, %[[MEM]][%[[ROW]]] : memref<64xi32>
+// CHECK:         %[[NEXT:.+]] = arith.addi %[[I]], %{{.+}} : index
+// CHECK:         %[[STEP:.+]] = arith.constant 8 : index
+// CHECK:         %[[ROWNEXT:.+]] = arith.addi %[[ROW]], %[[STEP]] : index
+// CHECK:         cf.br ^bb1(%[[NEXT]], %[[ROWNEXT]] : index, index)
+func.func @rows(%arg0: memref<64xi32>) {
+  %c0 = arith.constant 0 : index
+  cf.br ^bb1(%c0 : index)
+^bb1(%i: index):
+  %c8 = arith.constant 8 : index
+  %cond = arith.cmpi slt, %i, %c8 : index
+  cf.cond_br %cond, ^bb2, ^bb3
+^bb2:
+  %c8_0 = arith.constant 8 : index
+  %0 = arith.muli %i, %c8_0 : index
+  %c3 = arith.constant 3 : index
+  %1 = arith.addi %0, %c3 : index
+  %2 = memref.load %arg0[%1] : memref<64xi32>
+  memref.store %2, %arg0[%0] : memref<64xi32>
+  %c1 = arith.constant 1 : index
+  %next = arith.addi %i, %c1 : index
+  cf.br ^bb1(%next : index)
+^bb3:
+  return
+}
+
+// -----
+
+// Left shifts are multiplications by a power of two. A loop which enters with
+// a variable initial value multiplies it once, on the edge into the loop.
+
+// CHECK-LABEL: func.func @shifted(
+// CHECK-SAME:      %[[MEM:.+]]: memref<64xi32>, %[[LB:.+]]: index) {
+// CHECK:         %[[SCALE:.+]] = arith.constant 4 : index
+// CHECK:         %[[INIT:.+]] = arith.muli %[[LB]], %[[SCALE]] : index
+// CHECK:         cf.br ^bb1(%[[LB]], %[[INIT]] : index, index)
+// CHECK:       ^bb1(%{{.+}}: index, %[[IDX:.+]]: index):
+// CHECK-NOT:     arith.shli
+// CHECK:         memref.load %[[MEM]][%[[IDX]]] : memref<64xi32>
+// CHECK:         %[[STEP:.+]] = arith.constant 8 : index
+// CHECK:         %[[IDXNEXT:.+]] = arith.addi %[[IDX]], %[[STEP]] : index
+// CHECK:         cf.cond_br %{{.+}}, ^bb1(%{{.+}}, %[[IDXNEXT]] : index, index), ^bb2
+func.func @shifted(%arg0: memref<64xi32>, %lb: index) {
+  cf.br ^bb1(%lb : index)
+^bb1(%i: index):
+  %c2 = arith.constant 2 : index
+  %0 = arith.shli %i, %c2 : index
+  %1 = memref.load %arg0[%0] : memref<64xi32>
+  %c2_0 = arith.constant 2 : index
+  %next = arith.addi %c2_0, %i : index
+  %c16 = arith.constant 16 : index
+  %cond = arith.cmpi slt, %next, %c16 : index
+  cf.cond_br %cond, ^bb1(%next : index), ^bb2
+^bb2:
+  return
+}
+
+// -----
+
+// Successive multiplications by the inner dimensions of a memref are reduced
+// in turn.
+
+// CHECK-LABEL: func.func @chained(
+// CHECK:       ^bb1(%{{.+}}: index, %[[A:.+]]: index, %[[B:.+]]: index):
+// CHECK-NOT:     arith.muli
+// CHECK:         memref.load %{{.+}}[%[[B]]] : memref<64xi32>
+// CHECK:         %[[ANEXT:.+]] = arith.addi %[[A]], %{{.+}} : index
+// CHECK:         %[[BSTEP:.+]] = arith.constant 16 : index
+// CHECK:         %[[BNEXT:.+]] = arith.addi %[[B]], %[[BSTEP]] : index
+// CHECK:         cf.cond_br %{{.+}}, ^bb1(%{{.+}}, %[[ANEXT]], %[[BNEXT]] : index, index, index), ^bb2
+func.func @chained(%arg0: memref<64xi32>) {
+  %c0 = arith.constant 0 : index
+  cf.br ^bb1(%c0 : index)
+^bb1(%i: index):
+  %c4 = arith.constant 4 : index
+  %0 = arith.muli %i, %c4 : index
+  %1 = arith.muli %0, %c4 : index
+  %2 = memref.load %arg0[%1] : memref<64xi32>
+  %c1 = arith.constant 1 : index
+  %next = arith.addi %i, %c1 : index
+  %cond = arith.cmpi slt, %next, %c4 : index
+  cf.cond_br %cond, ^bb1(%next : index), ^bb2
+^bb2:
+  return
+}
+
+// -----
+
+// Block arguments which are not incremented by a constant along any back edge
+// are not induction variables.
+
+// CHECK-LABEL: func.func @not_induction(
+// CHECK:         arith.muli
+func.func @not_induction(%arg0: memref<64xi32>, %arg1: index) {
+  cf.br ^bb1(%arg1 : index)
+^bb1(%i: index):
+  %c4 = arith.constant 4 : index
+  %0 = arith.muli %i, %c4 : index
+  %1 = memref.load %arg0[%0] : memref<64xi32>
+  %next = arith.addi %i, %i : index
+  %cond = arith.cmpi slt, %next, %c4 : index
+  cf.cond_br %cond, ^bb1(%next : index), ^bb2
+^bb2:
+  return
+}
+
+// -----
+
+// An edge which passes the induction variable on unchanged passes the scaled
+// induction variable on unchanged as well.
+
+// CHECK-LABEL: func.func @identity_edge(
+// CHECK:       ^bb1(%[[I:.+]]: index, %[[IDX:.+]]: index):
+// CHECK-NOT:     arith.muli
+// CHECK:         memref.load %{{.+}}[%[[IDX]]] : memref<64xi32>
+// CHECK:         cf.cond_br %{{.+}}, ^bb1(%[[I]], %[[IDX]] : index, index), ^bb2
+// CHECK:       ^bb2:
+// CHECK-NOT:     arith.muli
+// CHECK:         %[[STEP:.+]] = arith.constant 4 : index
+// CHECK:         %[[IDXNEXT:.+]] = arith.addi %[[IDX]], %[[STEP]] : index
+// CHECK:         cf.cond_br %{{.+}}, ^bb1(%{{.+}}, %[[IDXNEXT]] : index, index), ^bb3
+func.func @identity_edge(%arg0: memref<64xi32>, %arg1: i1) {
+  %c0 = arith.constant 0 : index
+  cf.br ^bb1(%c0 : index)
+^bb1(%i: index):
+  %c4 = arith.constant 4 : index
+  %0 = arith.muli %i, %c4 : index
+  %1 = memref.load %arg0[%0] : memref<64xi32>
+  cf.cond_br %arg1, ^bb1(%i : index), ^bb2
+^bb2:
+  %c1 = arith.constant 1 : index
+  %next = arith.addi %i, %c1 : index
+  %c16 = arith.constant 16 : index
+  %cond = arith.cmpi slt, %next, %c16 : index
+  cf.cond_br %cond, ^bb1(%next : index), ^bb3
+^bb3:
+  return
+}
+
+// -----
+
+// The headers of a loop nest pass their induction variables to each other.
+// The inner induction variable enters the inner loop scaled by a
+// multiplication of the outer one, which is not reduced in turn.
+
+// CHECK-LABEL: func.func @nest(
+// CHECK:       ^bb1(%[[I:.+]]: index):
+// CHECK:         %[[SCALE:.+]] = arith.constant 4 : index
+// CHECK:         %[[INIT:.+]] = arith.muli %[[I]], %[[SCALE]] : index
+// CHECK:         cf.cond_br %{{.+}}, ^bb2(%[[I]], %[[INIT]] : index, index), ^bb5
+// CHECK:       ^bb2(%{{.+}}: index, %[[IDX:.+]]: index):
+// CHECK-NOT:     arith.muli
+// CHECK:         memref.load %{{.+}}[%[[IDX]]] : memref<512xi32>
+// CHECK:         %[[STEP:.+]] = arith.constant 4 : index
+// CHECK:         %[[IDXNEXT:.+]] = arith.addi %[[IDX]], %[[STEP]] : index
+// CHECK:         cf.br ^bb2(%{{.+}}, %[[IDXNEXT]] : index, index)
+// CHECK-NOT:     arith.muli
+// CHECK:         cf.cond_br %{{.+}}, ^bb1(%{{.+}} : index), ^bb1(%{{.+}} : index)
+func.func @nest(%arg0: memref<512xi32>, %arg1: i1) {
+  %c0 = arith.constant 0 : index
+  cf.br ^bb1(%c0 : index)
+^bb1(%i: index):
+  %c64 = arith.constant 64 : index
+  %cond = arith.cmpi slt, %i, %c64 : index
+  cf.cond_br %cond, ^bb2(%i : index), ^bb5
+^bb2(%j: index):
+  %c8 = arith.constant 8 : index
+  %lim = arith.addi %i, %c8 : index
+  %cond0 = arith.cmpi slt, %j, %lim : index
+  cf.cond_br %cond0, ^bb3, ^bb4
+^bb3:
+  %c4 = arith.constant 4 : index
+  %0 = arith.muli %j, %c4 : index
+  %1 = memref.load %arg0[%0] : memref<512xi32>
+  %c1 = arith.constant 1 : index
+  %next = arith.addi %j, %c1 : index
+  cf.br ^bb2(%next : index)
+^bb4:
+  %c1_0 = arith.constant 1 : index
+  %inext = arith.addi %i, %c1_0 : index
+  cf.cond_br %arg1, ^bb1(%j : index), ^bb1(%inext : index)
+^bb5:
+  return
+}
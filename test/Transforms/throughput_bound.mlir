@@ -0,0 +1,41 @@
+// RUN: hls-opt -split-input-file -handshake-throughput-bound %s -verify-diagnostics
+
+// A loop with a single token in flight is bounded by the latency of its
+// registers. The fork to the return is not part of the loop.
+
+handshake.func @single_token(%arg0: i32, %arg1: i32, %ctrl: none) -> (i32, none) {
+  // expected-remark @+1 {{loop of 5 ops is bounded by an initiation interval of 3 cycles, on the critical cycle: handshake_merge0, handshake_fork0, arith_addi0, handshake_buffer0, handshake_buffer1}}
+  %0 = merge %arg0, %4 {handshake_id = 0 : i64} : i32
+  %1:2 = fork [2] %0 {handshake_id = 0 : i64} : i32
+  %2 = arith.addi %1#0, %arg1 {handshake_id = 0 : i64} : i32
+  %3 = buffer [2] seq %2 {handshake_id = 0 : i64} : i32
+  %4 = buffer [1] seq %3 {handshake_id = 1 : i64} : i32
+  return %1#1, %ctrl : i32, none
+}
+
+// -----
+
+// The initial tokens of a loop-carried buffer are in flight together, and
+// fifo buffers add no latency. Ops without a 'handshake_id' are named by their
+// index within the function.
+
+handshake.func @initial_tokens(%arg0: i32, %arg1: i32, %ctrl: none) -> (i32, none) {
+  // expected-remark @+1 {{loop of 5 ops is bounded by an initiation interval of 3/2 cycles, on the critical cycle: handshake.merge#0, handshake.fork#1, handshake.buffer#2, handshake.buffer#3, handshake.buffer#4}}
+  %0 = merge %arg0, %4 : i32
+  %1:2 = fork [2] %0 : i32
+  %2 = buffer [4] fifo %1#0 : i32
+  %3 = buffer [1] seq %2 : i32
+  %4 = buffer [2] seq %3 {initValues = [0, 0]} : i32
+  return %1#1, %ctrl : i32, none
+}
+
+// -----
+
+// Loops without latency do not bound the throughput.
+
+handshake.func @combinational(%arg0: i32, %ctrl: none) -> (i32, none) {
+  %0 = merge %arg0, %2 : i32
+  %1:2 = fork [2] %0 : i32
+  %2 = buffer [2] fifo %1#0 : i32
+  return %1#1, %ctrl : i32, none
+}
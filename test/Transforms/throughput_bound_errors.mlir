@@ -0,0 +1,25 @@
+// RUN: hls-opt -split-input-file -handshake-throughput-bound="max-ii=2" %s -verify-diagnostics
+
+// A loop at the maximum initiation interval is only reported.
+
+handshake.func @at_max(%arg0: i32, %ctrl: none) -> (i32, none) {
+  // expected-remark @+1 {{loop of 3 ops is bounded by an initiation interval of 2 cycles, on the critical cycle: handshake_merge0, handshake_fork0, handshake_buffer0}}
+  %0 = merge %arg0, %2 {handshake_id = 0 : i64} : i32
+  %1:2 = fork [2] %0 {handshake_id = 0 : i64} : i32
+  %2 = buffer [2] seq %1#0 {handshake_id = 0 : i64} : i32
+  return %1#1, %ctrl : i32, none
+}
+
+// -----
+
+// A loop whose tokens share its latency exceeds the maximum by a fraction of
+// a cycle.
+
+handshake.func @fractional(%arg0: i32, %ctrl: none) -> (i32, none) {
+  // expected-error @+1 {{loop of 4 ops is bounded by an initiation interval of 5/2 cycles, on the critical cycle: handshake_merge0, handshake_fork0, handshake_buffer0, handshake_buffer1 (exceeds the maximum of 2)}}
+  %0 = merge %arg0, %3 {handshake_id = 0 : i64} : i32
+  %1:2 = fork [2] %0 {handshake_id = 0 : i64} : i32
+  %2 = buffer [3] seq %1#0 {handshake_id = 0 : i64} : i32
+  %3 = buffer [2] seq %2 {handshake_id = 1 : i64, initValues = [0, 0]} : i32
+  return %1#1, %ctrl : i32, none
+}
@@ -0,0 +1,45 @@
+// RUN: hls-opt -split-input-file -affine-tile-scratchpads="tile-size=4" %s | FileCheck %s
+
+// The tile of the input is copied into a scratchpad before each tile, and the
+// tile of the output is copied back after it.
+
+// CHECK-LABEL: func.func @scale(
+// CHECK-SAME:      %[[IN:.+]]: memref<16xi32>, %[[OUT:.+]]: memref<16xi32>) {
+// CHECK-DAG:     %[[INBUF:.+]] = memref.alloc() : memref<4xi32>
+// CHECK-DAG:     %[[OUTBUF:.+]] = memref.alloc() : memref<4xi32>
+// CHECK:         affine.for %{{.+}} = 0 to 16 step 4 {
+// CHECK:           affine.for
+// CHECK:             affine.load %[[IN]]
+// CHECK:             affine.store %{{.+}}, %[[INBUF]]
+// CHECK:           affine.for
+// CHECK:             affine.load %[[INBUF]]
+// CHECK:             affine.store %{{.+}}, %[[OUTBUF]]
+// CHECK:           affine.for
+// CHECK:             affine.load %[[OUTBUF]]
+// CHECK:             affine.store %{{.+}}, %[[OUT]]
+// CHECK-NOT:     memref.dealloc
+func.func @scale(%arg0: memref<16xi32>, %arg1: memref<16xi32>) {
+  affine.for %i = 0 to 16 {
+    %0 = affine.load %arg0[%i] : memref<16xi32>
+    %1 = arith.addi %0, %0 : i32
+    affine.store %1, %arg1[%i] : memref<16xi32>
+  }
+  return
+}
+
+// -----
+
+// Loops which are no longer than a tile are not tiled.
+
+// CHECK-LABEL: func.func @short(
+// CHECK-NOT:     memref.alloc
+// CHECK:         affine.for %{{.+}} = 0 to 4 {
+// CHECK-NOT:     memref.alloc
+func.func @short(%arg0: memref<4xi32>) {
+  affine.for %i = 0 to 4 {
+    %0 = affine.load %arg0[%i] : memref<4xi32>
+    %1 = arith.addi %0, %0 : i32
+    affine.store %1, %arg0[%i] : memref<4xi32>
+  }
+  return
+}
@@ -0,0 +1,92 @@
+// RUN: hls-opt -split-input-file -hls-unroll-loops %s | FileCheck %s
+// RUN: hls-opt -split-input-file -hls-unroll-loops="iteration-latency=2" %s | FileCheck %s --check-prefix=BOUND
+// RUN: hls-opt -split-input-file -hls-unroll-loops="iteration-latency=2 partition-factor=2" %s | FileCheck %s --check-prefix=PART
+
+// Each memory is accessed once per iteration, so the loop is unrolled by the
+// iteration latency.
+
+// CHECK-LABEL: func.func @unroll(
+// CHECK:         affine.for %{{.+}} = 0 to 16 step 4 {
+// CHECK-COUNT-4:   affine.load
+// CHECK-NOT:     affine.for
+func.func @unroll(%arg0: memref<16xi32>, %arg1: memref<16xi32>) {
+  affine.for %i = 0 to 16 {
+    %0 = affine.load %arg0[%i] : memref<16xi32>
+    %1 = arith.addi %0, %0 : i32
+    affine.store %1, %arg1[%i] : memref<16xi32>
+  }
+  return
+}
+
+// -----
+
+// With two accesses to the same memory per iteration, an iteration every two
+// cycles saturates the memory, unless it is to be partitioned.
+
+// CHECK-LABEL: func.func @contended(
+// CHECK:         affine.for %{{.+}} = 0 to 16 step 2 {
+
+// BOUND-LABEL: func.func @contended(
+// BOUND:         affine.for %{{.+}} = 0 to 16 {
+
+// PART-LABEL: func.func @contended(
+// PART:         affine.for %{{.+}} = 0 to 16 step 2 {
+func.func @contended(%arg0: memref<16xi32>) {
+  affine.for %i = 0 to 16 {
+    %0 = affine.load %arg0[%i] : memref<16xi32>
+    %1 = arith.addi %0, %0 : i32
+    affine.store %1, %arg0[%i] : memref<16xi32>
+  }
+  return
+}
+
+// -----
+
+// The inner loop carries a reduction, so the parallel outer loop is unrolled
+// and jammed into it.
+
+// CHECK-LABEL: func.func @jam(
+// CHECK:         affine.for %{{.+}} = 0 to 8 step 4 {
+// CHECK:           affine.for %{{.+}} = 0 to 8 iter_args({{.+}}) -> (i32, i32, i32, i32) {
+func.func @jam(%arg0: memref<8x8xi32>, %arg1: memref<8xi32>) {
+  %c0 = arith.constant 0 : i32
+  affine.for %i = 0 to 8 {
+    %0 = affine.for %j = 0 to 8 iter_args(%acc = %c0) -> (i32) {
+      %1 = affine.load %arg0[%i, %j] : memref<8x8xi32>
+      %2 = arith.addi %acc, %1 : i32
+      affine.yield %2 : i32
+    }
+    affine.store %0, %arg1[%i] : memref<8xi32>
+  }
+  return
+}
+
+// -----
+
+// Loops with an unroll pragma are unrolled by its factor, even if they are not
+// innermost, and are kept from being unrolled by a factor of 1.
+
+// CHECK-LABEL: func.func @pragmas(
+// CHECK:         affine.for %{{.+}} = 0 to 8 step 2 {
+// CHECK-COUNT-2:   affine.for %{{.+}} = 0 to 16 step 4 {
+// CHECK:         affine.for %{{.+}} = 0 to 16 {
+// CHECK-NOT:       hls.unroll
+// CHECK-COUNT-4: affine.store %{{.+}}, %arg2
+// CHECK-NOT:     affine.for
+func.func @pragmas(%arg0: memref<8x16xi32>, %arg1: memref<16xi32>, %arg2: memref<4xi32>) {
+  %c0 = arith.constant 0 : i32
+  affine.for %i = 0 to 8 {
+    affine.for %j = 0 to 16 {
+      %0 = affine.load %arg0[%i, %j] : memref<8x16xi32>
+      affine.store %0, %arg1[%j] : memref<16xi32>
+    }
+  } {hls.unroll = 2 : i64}
+  affine.for %i = 0 to 16 {
+    %0 = affine.load %arg1[%i] : memref<16xi32>
+    affine.store %0, %arg1[%i] : memref<16xi32>
+  } {hls.unroll = 1 : i64}
+  affine.for %i = 0 to 4 {
+    affine.store %c0, %arg2[%i] : memref<4xi32>
+  } {hls.unroll = 0 : i64}
+  return
+}
@@ -0,0 +1,160 @@
+// RUN: hls-opt -split-input-file -affine-vectorize-memrefs %s | FileCheck %s
+
+// CHECK-LABEL: func.func @vectorize(
+// CHECK-SAME:      %[[A:.+]]: memref<4xi64> {hlt.vector = {factor = 2 : i64, shape = [8]}},
+// CHECK-SAME:      %[[B:.+]]: memref<4xi64> {hlt.vector = {factor = 2 : i64, shape = [8]}})
+// CHECK:         affine.for %[[I:.+]] = 0 to 8 step 2 {
+// CHECK:           %[[V:.+]] = affine.load %[[A]][%[[I]] floordiv 2] : memref<4xi64>
+// CHECK:           %[[E0:.+]] = arith.trunci %[[V]] : i64 to i32
+// CHECK:           %[[C32:.+]] = arith.constant 32 : i64
+// CHECK:           %[[S:.+]] = arith.shrui %[[V]], %[[C32]] : i64
+// CHECK:           %[[E1:.+]] = arith.trunci %[[S]] : i64 to i32
+// CHECK:           %[[SUM:.+]] = arith.addi %[[E0]], %[[E1]] : i32
+// CHECK:           %[[W0:.+]] = arith.extui %[[SUM]] : i32 to i64
+// CHECK:           %[[W1:.+]] = arith.extui %[[E0]] : i32 to i64
+// CHECK:           %[[C32_0:.+]] = arith.constant 32 : i64
+// CHECK:           %[[SH:.+]] = arith.shli %[[W1]], %[[C32_0]] : i64
+// CHECK:           %[[OR:.+]] = arith.ori %[[W0]], %[[SH]] : i64
+// CHECK:           affine.store %[[OR]], %[[B]][%[[I]] floordiv 2] : memref<4xi64>
+func.func @vectorize(%arg0: memref<8xi32>, %arg1: memref<8xi32>) {
+  affine.for %i = 0 to 8 step 2 {
+    %0 = affine.load %arg0[%i] : memref<8xi32>
+    %1 = affine.load %arg0[%i + 1] : memref<8xi32>
+    %2 = arith.addi %0, %1 : i32
+    affine.store %2, %arg1[%i] : memref<8xi32>
+    affine.store %0, %arg1[%i + 1] : memref<8xi32>
+  }
+  return
+}
+
+// -----
+
+// Four elements of the innermost dimension are combined into each wide
+// element.
+
+// CHECK-LABEL: func.func @factor4(
+// CHECK-SAME:      %{{.+}}: memref<2x2xi32> {hlt.vector = {factor = 4 : i64, shape = [2, 8]}}) -> i8
+// CHECK:         affine.load %{{.+}}[%{{.+}}, %{{.+}} floordiv 4] : memref<2x2xi32>
+// CHECK-COUNT-4: arith.trunci %{{.+}} : i32 to i8
+// CHECK-NOT:     affine.load
+func.func @factor4(%arg0: memref<2x8xi8>) -> i8 {
+  %c0 = arith.constant 0 : i8
+  %0 = affine.for %i = 0 to 2 iter_args(%acc = %c0) -> (i8) {
+    %1 = affine.for %j = 0 to 8 step 4 iter_args(%acc1 = %acc) -> (i8) {
+      %2 = affine.load %arg0[%i, %j] : memref<2x8xi8>
+      %3 = affine.load %arg0[%i, %j + 1] : memref<2x8xi8>
+      %4 = affine.load %arg0[%i, %j + 2] : memref<2x8xi8>
+      %5 = affine.load %arg0[%i, %j + 3] : memref<2x8xi8>
+      %6 = arith.addi %2, %3 : i8
+      %7 = arith.addi %4, %5 : i8
+      %8 = arith.addi %6, %7 : i8
+      %9 = arith.addi %acc1, %8 : i8
+      affine.yield %9 : i8
+    }
+    affine.yield %1 : i8
+  }
+  return %0 : i8
+}
+
+// -----
+
+// The store between the loads of a wide element may not be reordered across
+// them, so the memref is not vectorized.
+
+// CHECK-LABEL: func.func @interleaved(
+// CHECK-SAME:      %{{.+}}: memref<8xi32>)
+// CHECK-NOT:     hlt.vector
+func.func @interleaved(%arg0: memref<8xi32>) {
+  affine.for %i = 0 to 8 step 2 {
+    %0 = affine.load %arg0[%i] : memref<8xi32>
+    affine.store %0, %arg0[%i] : memref<8xi32>
+    %1 = affine.load %arg0[%i + 1] : memref<8xi32>
+    affine.store %1, %arg0[%i + 1] : memref<8xi32>
+  }
+  return
+}
+
+// -----
+
+// Loads may leave some elements of a wide element unused. The factor which
+// makes for the fewest wide loads is chosen.
+
+// CHECK-LABEL: func.func @partial_load(
+// CHECK-SAME:      %[[A:.+]]: memref<2xi128> {hlt.vector = {factor = 4 : i64, shape = [8]}}) -> i32
+// CHECK:         affine.for %[[I:.+]] = 0 to 8 step 4 iter_args(%{{.+}} = %{{.+}}) -> (i32) {
+// CHECK:           %[[V:.+]] = affine.load %[[A]][%[[I]] floordiv 4] : memref<2xi128>
+// CHECK-COUNT-3:   arith.trunci %{{.+}} : i128 to i32
+// CHECK-NOT:       affine.load
+func.func @partial_load(
+// CHECK-SAME:      %[[A:.+]]: memref<4xi64> {hlt.vector = {factor = 2 : i64, shape = [8]}}) -> i32
+// CHECK:         affine.for %[[I:.+]] = 0 to 8 step 4 iter_args(%{{.+}} = %{{.+}}) -> (i32) {
+// CHECK:           %[[V0:.+]] = affine.load %[[A]][%[[I]] floordiv 2] : memref<4xi64>
+// CHECK:           arith.trunci %[[V0]] : i64 to i32
+// CHECK:           arith.shrui %[[V0]]
+// CHECK:           %[[V1:.+]] = affine.load %[[A]][%[[I]] floordiv 2 + 1] : memref<4xi64>
+// CHECK-NEXT:      arith.trunci %[[V1]] : i64 to i32
+// CHECK-NOT:       affine.load
+func.func @partial_load(%arg0: memref<8xi32>) -> i32 {
+  %c0 = arith.constant 0 : i32
+  %0 = affine.for %i = 0 to 8 step 4 iter_args(%acc = %c0) -> (i32) {
+    %1 = affine.load %arg0[%i] : memref<8xi32>
+    %2 = affine.load %arg0[%i + 1] : memref<8xi32>
+    %3 = affine.load %arg0[%i + 2] : memref<8xi32>
+    %4 = arith.addi %1, %2 : i32
+    %5 = arith.addi %4, %3 : i32
+    %6 = arith.addi %acc, %5 : i32
+    affine.yield %6 : i32
+  }
+  return %0 : i32
+}
+
+// -----
+
+// Floating-point elements are bitcast to and from the lanes, and their type is
+// recorded for the host.
+
+// CHECK-LABEL: func.func @float(
+// CHECK-SAME:      %[[A:.+]]: memref<2xi64> {hlt.vector = {element = f32, factor = 2 : i64, shape = [4]}})
+// CHECK:           %[[V:.+]] = affine.load %[[A]][%{{.+}} floordiv 2] : memref<2xi64>
+// CHECK:           %[[T0:.+]] = arith.trunci %[[V]] : i64 to i32
+// CHECK:           arith.bitcast %[[T0]] : i32 to f32
+// CHECK:           arith.bitcast %{{.+}} : f32 to i32
+// CHECK:           affine.store %{{.+}}, %[[A]][%{{.+}} floordiv 2] : memref<2xi64>
+func.func @float(%arg0: memref<4xf32>) {
+  affine.for %i = 0 to 4 step 2 {
+    %0 = affine.load %arg0[%i] : memref<4xf32>
+    %1 = affine.load %arg0[%i + 1] : memref<4xf32>
+    %2 = arith.addf %0, %1 : f32
+    affine.store %2, %arg0[%i] : memref<4xf32>
+    affine.store %1, %arg0[%i + 1] : memref<4xf32>
+  }
+  return
+}
+
+// -----
+
+// Local memories are vectorized without changing the signature, along with
+// their deallocation.
+
+// CHECK-LABEL: func.func @local(
+// CHECK-SAME:      %{{.+}}: memref<8xi16>)
+// CHECK:         %[[M:.+]] = memref.alloc() : memref<4xi32>
+// CHECK:         affine.store %{{.+}}, %[[M]][%{{.+}} floordiv 2] : memref<4xi32>
+// CHECK:         affine.load %[[M]][%{{.+}} floordiv 2] : memref<4xi32>
+// CHECK:         memref.dealloc %[[M]] : memref<4xi32>
+func.func @local(%arg0: memref<8xi16>) {
+  %0 = memref.alloc() : memref<8xi16>
+  %c1 = arith.constant 1 : i16
+  affine.for %i = 0 to 8 step 2 {
+    affine.store %c1, %0[%i] : memref<8xi16>
+    affine.store %c1, %0[%i + 1] : memref<8xi16>
+  }
+  affine.for %i = 0 to 8 step 2 {
+    %1 = affine.load %0[%i] : memref<8xi16>
+    %2 = affine.load %0[%i + 1] : memref<8xi16>
+    %3 = arith.addi %1, %2 : i16
+    affine.store %3, %arg0[%i] : memref<8xi16>
+  }
+  memref.dealloc %0 : memref<8xi16>
+  return
+}
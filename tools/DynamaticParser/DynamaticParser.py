@@ -1,14 +1,11 @@
-import networkx as nx
-from networkx.drawing.nx_pydot import read_dot
 import sys
 import argparse
+import json
 import os
 import re
-import tempfile
+from collections import defaultdict
 from dataclasses import dataclass
 
-from networkx.readwrite.json_graph import tree
-
 
 def toValues(values):
   return [f"%{v}" for v in values]
@@ -53,6 +50,9 @@ class ModuleWriter:
 class TypeResolver:
 
   def __init__(self):
+    self.reset()
+
+  def reset(self):
     self.knownIndexValues = {}
     self.valueTypes = {}
 
@@ -85,30 +85,50 @@ class TypeResolver:
   def isIndex(self, val):
     return self.getType(val) == "index"
 
-  def resolveTypesRecurse(self, ops):
-    changed = False
-
-    for op in ops.values():
-      # fork
-      if op.type == "Fork" and self.isIndex(op.operands[0]):
-        for res in op.results:
-          changed |= self.setValueType(res, index=True)
-      # Mux
-      elif op.type == "Mux":
-        isIndexMux = False
+  # Applies the type inference rules to 'op', and returns the values whose
+  # type changed.
+  def applyRules(self, op):
+    changed = []
+    # fork
+    if op.type == "Fork" and self.isIndex(op.operands[0]):
+      for res in op.results.values():
+        if self.setValueType(res, index=True):
+          changed.append(res)
+    # Mux
+    elif op.type == "Mux":
+      isIndexMux = False
+      for i in range(1, len(op.operands)):
+        if self.isIndex(op.operands[i]):
+          isIndexMux = True
+          break
+
+      if isIndexMux:
         for i in range(1, len(op.operands)):
-          if self.isIndex(op.operands[i]):
-            isIndexMux = True
-            break
-
-        if isIndexMux:
-          for i in range(1, len(op.operands)):
-            changed |= self.setValueType(op.operands[i], index=True)
-
-    if changed:
-      self.resolveTypesRecurse(ops)
-
-    return
+          if self.setValueType(op.operands[i], index=True):
+            changed.append(op.operands[i])
+    return changed
+
+  # Propagates types through the ops until a fixed point is reached. An op is
+  # only revisited when the type of one of its operands changed.
+  def resolveTypesWorklist(self, ops):
+    users = defaultdict(list)
+    worklist = []
+    for op in ops.values():
+      if op.type not in ["Fork", "Mux"]:
+        continue
+      for operand in op.operands.values():
+        users[operand].append(op)
+      worklist.append(op)
+
+    queued = set(op.name for op in worklist)
+    while worklist:
+      op = worklist.pop()
+      queued.discard(op.name)
+      for value in self.applyRules(op):
+        for user in users[value]:
+          if user.name not in queued:
+            queued.add(user.name)
+            worklist.append(user)
 
   def resolveTypes(self, ops):
     # initialize the type value mapping with integer and none types
@@ -140,7 +160,7 @@ class TypeResolver:
           self.setValueType(op.operands[1], index=True)
 
     # Iterate type inference until a fixed point is reached
-    self.resolveTypesRecurse(ops)
+    self.resolveTypesWorklist(ops)
 
 
 typeResolver = TypeResolver()
@@ -507,10 +527,45 @@ def parseIO(ins):
   return portwidths, memInfo
 
 
-def parseNodes(G):
+# Matches a node ("name" [attrs]) or edge ("src" -> "dst" [attrs]) statement
+# of a Dynamatic dot file.
+DOT_STATEMENT = re.compile(
+    r'^\s*"?([^"\s\[]+)"?(?:\s*->\s*"?([^"\s\[]+)"?)?\s*\[(.*)\]\s*;?\s*$')
+DOT_ATTRIBUTE = re.compile(r'(\w+)\s*=\s*("[^"]*"|[^\s,\]]+)')
+
+
+# Reads the nodes and edges of a Dynamatic dot file in a single pass over its
+# lines. Dynamatic writes a single statement per line; subgraphs and graph
+# attributes are ignored. Nodes and edges are returned in the order of the
+# file as (name, attributes) and (src, dst, attributes) tuples, with attribute
+# values kept as written (i.e. quoted).
+def readDot(fileName):
+  nodes = {}
+  edges = {}
+  with open(fileName, 'r') as f:
+    for line in f:
+      if line.lstrip().startswith("//"):
+        continue
+      m = DOT_STATEMENT.match(line)
+      if not m or m.group(1) in ["graph", "node", "edge"]:
+        continue
+      src, dst, attrString = m.groups()
+      attrs = dict(DOT_ATTRIBUTE.findall(attrString))
+      nodes.setdefault(src, {})
+      if dst is None:
+        nodes[src].update(attrs)
+        continue
+      nodes.setdefault(dst, {})
+      edges.setdefault((src, dst), {}).update(attrs)
+
+  return list(nodes.items()), [(src, dst, attrs)
+                               for (src, dst), attrs in edges.items()]
+
+
+def parseNodes(nodes):
   orderedFuncArgNodes = []
   ops = {}
-  for n in G.nodes(data=True):
+  for n in nodes:
     op = Op()
     op.name = stripQuotes(n[0])
     op.type = stripQuotes(n[1]['type'])
@@ -541,8 +596,8 @@ def getTrailingNum(s):
   return int(re.compile(r'(\d+)$').search(s).group(1))
 
 
-def resolveEdges(G, ops):
-  for n in G.edges(data=True):
+def resolveEdges(edges, ops):
+  for n in edges:
     srcOp = ops[n[0]]
     dstOp = ops[n[1]]
 
@@ -583,28 +638,6 @@ def writeBody(ops, writer):
   raise RuntimeError("No return node found")
 
 
-# Naively remove any 'subgraph ... {' and a following '}'
-def removeSubGraphs(filename):
-  with open(filename, 'r') as f:
-    lines = f.readlines()
-
-  outLines = []
-
-  bracketCntr = 0
-  with open(filename, 'r') as f:
-    for line in lines:
-      if 'subgraph' in line:
-        bracketCntr += 1
-        continue
-      if '}' in line and bracketCntr > 0:
-        bracketCntr -= 1
-        continue
-      outLines += [line]
-
-  with open(filename, 'w') as f:
-    f.writelines(outLines)
-
-
 def resolveFunctiontypes(nodes):
   # Find entry and exit nodes
   args = []
@@ -642,13 +675,145 @@ def getExitNodeSSAs(ops):
   return [x.operandName(0) for x in SSAOps]
 
 
+# The depth up to which the producers of the source of a channel are part of
+# its structural keys; see getChannelKeys.
+BUFFER_KEY_DEPTH = 4
+
+# Dynamatic operands of the nodes whose handshake ops take their operands in a
+# different order, by the index of the respective operand of the op.
+buffer_operand_order = {
+    "handshake.cond_br": [1, 0],
+    "handshake.load": [1, 0],
+    "handshake.store": [1, 0],
+}
+
+
+# Returns the name of the handshake op of a Dynamatic node, by which it is
+# matched to the ops of a CIRCT circuit. Function arguments are named 'arg',
+# as are block arguments by -handshake-import-buffers. Nodes which have no
+# handshake op (e.g. LSQs) keep their Dynamatic name, and match no op.
+def getNodeKind(attrs):
+  type = stripQuotes(attrs['type'])
+  if type == "Entry":
+    return "arg"
+  if type == "Operator":
+    operator = stripQuotes(attrs['op'])
+    if operator not in mlir_operator_map:
+      return f"dynamatic.{operator}"
+    name = mlir_operator_map[operator].split(" ")[0]
+    return name if "." in name else f"handshake.{name}"
+  if type not in to_handshake_opmap:
+    return f"dynamatic.{type}"
+  return f"handshake.{to_handshake_opmap[type]}"
+
+
+# Returns the structural keys of each channel of a Dynamatic circuit by which
+# -handshake-import-buffers matches it to a channel of a CIRCT circuit, keyed
+# by the destination node and operand of the channel. A channel runs from the
+# result of a source node to the operand of a sink node, through any forks and
+# buffers. Its key at depth d names the kinds of the source and its producers
+# up to depth d, the source result, and the kind and operand of the sink.
+def getChannelKeys(nodes, edges):
+  kinds = {name: getNodeKind(attrs) for name, attrs in nodes}
+  producers = defaultdict(dict)
+  consumers = defaultdict(lambda: defaultdict(list))
+  for src, dst, attrs in edges:
+    result = getTrailingNum(stripQuotes(attrs['from'])) - 1
+    operand = getTrailingNum(stripQuotes(attrs['to'])) - 1
+    producers[dst][operand] = (src, result)
+    consumers[src][result].append((dst, operand))
+
+  def isThrough(name):
+    return kinds[name] in ["handshake.fork", "handshake.buffer"]
+
+  def getSource(name, result):
+    while isThrough(name) and 0 in producers.get(name, {}):
+      name, result = producers[name][0]
+    return name, result
+
+  signatures = {}
+
+  def getSignature(name, depth):
+    if (name, depth) not in signatures:
+      sig = kinds[name]
+      if depth > 0:
+        operands = producers.get(name, {})
+        operands = [
+            getSignature(getSource(*operands[i])[0], depth - 1)
+            for i in sorted(operands)
+        ]
+        order = buffer_operand_order.get(kinds[name])
+        if order and len(operands) == len(order):
+          operands = [operands[order.index(i)] for i in range(len(order))]
+        sig += "(" + ",".join(operands) + ")"
+      signatures[(name, depth)] = sig
+    return signatures[(name, depth)]
+
+  channelKeys = {}
+  for dst, operands in producers.items():
+    if isThrough(dst):
+      continue
+    order = buffer_operand_order.get(kinds[dst])
+    for operand, (src, result) in operands.items():
+      source, sourceResult = getSource(src, result)
+      mlirOperand = order[operand] if order and operand < len(order) \
+          else operand
+      channelKeys[(dst, operand)] = [
+          f"{getSignature(source, d)}#{sourceResult}->{kinds[dst]}#"
+          f"{mlirOperand}" for d in range(BUFFER_KEY_DEPTH + 1)
+      ]
+  return channelKeys, consumers
+
+
+# Writes the buffer placement of a Dynamatic dot file as JSON, for
+# -handshake-import-buffers. Each buffer is placed on the channels from its
+# source to each sink that it reaches through forks and other buffers, by the
+# structural keys of each channel and the number of channels of the circuit
+# which share each key.
+def writeBufferPlacement(fileName, outstream):
+  nodes, edges = readDot(fileName)
+  attrsByName = dict(nodes)
+  channelKeys, consumers = getChannelKeys(nodes, edges)
+  keyCounts = defaultdict(int)
+  for keys in channelKeys.values():
+    for key in keys:
+      keyCounts[key] += 1
+
+  def getSinks(name):
+    sinks = []
+    for result in sorted(consumers[name]):
+      for dst, operand in consumers[name][result]:
+        if (dst, operand) in channelKeys:
+          sinks.append((dst, operand))
+        else:
+          sinks += getSinks(dst)
+    return sinks
+
+  buffers = []
+  for name, attrs in nodes:
+    if stripQuotes(attrs['type']) != "Buffer":
+      continue
+    slots = int(stripQuotes(attrs.get('slots', "2")))
+    transparent = stripQuotes(attrs.get('transparent', "false")) == "true"
+    channels = [{
+        "keys": [[key, keyCounts[key]] for key in channelKeys[sink]]
+    } for sink in getSinks(name)]
+    buffers.append({
+        "name": name,
+        "slots": slots,
+        "transparent": transparent,
+        "channels": channels
+    })
+  json.dump({"buffers": buffers}, outstream, indent=2)
+  outstream.write("\n")
+
+
 def parseDynamaticFile(fileName, outstream):
-  # Remove subgraphs; this is not handled by networkx.
-  tmpFile = tempfile.NamedTemporaryFile(delete=False)
-  tmpFile.write(open(fileName, 'rb').read())
-  removeSubGraphs(tmpFile.name)
+  global valueCntr
+  valueCntr = 0
+  typeResolver.reset()
 
-  G = nx.DiGraph(read_dot(tmpFile.name))
+  nodes, edges = readDot(fileName)
   basename = os.path.basename(fileName)
   basename = os.path.splitext(basename)[0]
   writer = ModuleWriter(outstream)
@@ -656,8 +821,8 @@ def parseDynamaticFile(fileName, outstream):
   # Maintain a list of the nodes which are involved in specifying the function
   # signature. Hope that the ordering in the .dot file is the same as the
   # source function...
-  ops, orderedFuncArgNodes = parseNodes(G)
-  resolveEdges(G, ops)
+  ops, orderedFuncArgNodes = parseNodes(nodes)
+  resolveEdges(edges, ops)
 
   typeResolver.resolveTypes(ops)
 
@@ -686,6 +851,11 @@ if __name__ == '__main__':
                       help='Output file',
                       type=str,
                       default=None)
+  parser.add_argument(
+      '--buffers',
+      action='store_true',
+      help='Write the buffer placement of the Dynamatic file as JSON, for '
+      'hls-opt -handshake-import-buffers, rather than its MLIR.')
   args = parser.parse_args()
 
   # Create a stream object
@@ -694,4 +864,7 @@ if __name__ == '__main__':
   else:
     outstream = sys.stdout
 
-  parseDynamaticFile(args.file, outstream)
+  if args.buffers:
+    writeBufferPlacement(args.file, outstream)
+  else:
+    parseDynamaticFile(args.file, outstream)
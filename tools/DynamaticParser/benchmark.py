@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+""" Times the conversion of the Dynamatic examples in eval/dynamatic (or the
+given .dot files) to MLIR.
+  benchmark.py [--repeat N] [file.dot ...]
+"""
+import argparse
+import glob
+import io
+import os
+import time
+
+from DynamaticParser import parseDynamaticFile
+
+EXAMPLES = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..",
+                        "..", "eval", "dynamatic", "*", "*.dot")
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser()
+  parser.add_argument("files", nargs="*", help="Dynamatic .dot files")
+  parser.add_argument("--repeat",
+                      type=int,
+                      default=10,
+                      help="The number of conversions of each file to time.")
+  args = parser.parse_args()
+
+  files = args.files if args.files else sorted(glob.glob(EXAMPLES))
+  total = 0
+  for f in files:
+    name = os.path.splitext(os.path.basename(f))[0]
+    try:
+      start = time.perf_counter()
+      for _ in range(args.repeat):
+        out = io.StringIO()
+        parseDynamaticFile(f, out)
+      elapsed = (time.perf_counter() - start) / args.repeat
+    except RuntimeError as e:
+      print(f"{name}: unsupported ({e})")
+      continue
+    total += elapsed
+    lines = out.getvalue().count("\n")
+    print(f"{name}: {elapsed * 1000:.2f} ms ({lines} lines)")
+  print(f"total: {total * 1000:.2f} ms")
@@ -0,0 +1,205 @@
+//===- CompileDaemon.cpp - Warm hls-opt instances for hlstool -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the compile daemon of hls-opt; see CompileDaemon.h.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CompileDaemon.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace llvm;
+
+#ifndef HLS_OPT_DAEMON_TIMEOUT
+// Number of seconds that the daemon waits for a client to connect before
+// exiting, unless overridden through $HLS_OPT_DAEMON_TIMEOUT.
+#define HLS_OPT_DAEMON_TIMEOUT 600
+#endif
+
+static bool makeSockAddr(StringRef path, sockaddr_un &addr) {
+  addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+    return false;
+  std::memcpy(addr.sun_path, path.data(), path.size());
+  return true;
+}
+
+/// Returns true if a daemon is serving at 'addr'.
+static bool isServing(const sockaddr_un &addr) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return false;
+  bool serving =
+      connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 0;
+  close(fd);
+  return serving;
+}
+
+static bool writeAll(int fd, StringRef data) {
+  while (!data.empty()) {
+    ssize_t n = ::write(fd, data.data(), data.size());
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data = data.drop_front(n);
+  }
+  return true;
+}
+
+/// Returns the contents of the file 'file' from its start.
+static std::string readAll(std::FILE *file) {
+  std::string contents;
+  std::rewind(file);
+  char buf[1 << 12];
+  size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), file)) != 0)
+    contents.append(buf, n);
+  return contents;
+}
+
+/// Runs the job of the client at 'fd', within a child of the daemon. The
+/// output of the job is captured in temporary files, which are sent to the
+/// client once the job has finished. Never returns.
+[[noreturn]] static void runClientJob(int fd, const char *argv0,
+                                      circt_hls::DaemonJobFn runJob) {
+  std::string request;
+  char c;
+  while (true) {
+    ssize_t n = ::read(fd, &c, 1);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0 || c == '\n')
+      break;
+    request += c;
+  }
+
+  auto json = json::parse(request);
+  auto *job = json ? json->getAsObject() : nullptr;
+  auto cwd = job ? job->getString("cwd") : None;
+  auto *jobArgs = job ? job->getArray("args") : nullptr;
+  if (!json)
+    consumeError(json.takeError());
+  if (!cwd || !jobArgs || ::chdir(cwd->str().c_str()) != 0)
+    std::_Exit(1);
+
+  std::vector<std::string> args = {argv0};
+  for (auto &arg : *jobArgs) {
+    auto str = arg.getAsString();
+    if (!str)
+      std::_Exit(1);
+    args.push_back(str->str());
+  }
+  SmallVector<char *> argv;
+  for (auto &arg : args)
+    argv.push_back(arg.data());
+  argv.push_back(nullptr);
+
+  std::FILE *out = std::tmpfile();
+  std::FILE *err = std::tmpfile();
+  int null = ::open("/dev/null", O_RDONLY);
+  if (!out || !err || null < 0)
+    std::_Exit(1);
+  ::dup2(null, STDIN_FILENO);
+  ::dup2(fileno(out), STDOUT_FILENO);
+  ::dup2(fileno(err), STDERR_FILENO);
+  ::close(null);
+
+  int code = runJob(static_cast<int>(args.size()), argv.data());
+  outs().flush();
+  errs().flush();
+  std::fflush(stdout);
+  std::fflush(stderr);
+
+  json::Object result{{"code", code},
+                      {"stdout", json::fixUTF8(readAll(out))},
+                      {"stderr", json::fixUTF8(readAll(err))}};
+  std::string response;
+  raw_string_ostream os(response);
+  os << json::Value(std::move(result)) << "\n";
+  writeAll(fd, os.str());
+  std::_Exit(code);
+}
+
+int circt_hls::serveCompileDaemon(StringRef path, const char *argv0,
+                                  DaemonJobFn runJob) {
+  sockaddr_un addr;
+  if (!makeSockAddr(path, addr)) {
+    errs() << "Compile daemon socket path too long: " << path << "\n";
+    return 1;
+  }
+  int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0)
+    return 1;
+  if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) {
+    // Another daemon may have been started concurrently, or a stale socket
+    // was left behind by a daemon which was killed.
+    if (isServing(addr)) {
+      close(listenFd);
+      outs() << "Compile daemon already running at " << path << "\n";
+      return 0;
+    }
+    ::unlink(addr.sun_path);
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) {
+      errs() << "Could not bind compile daemon to " << path << ": "
+             << std::strerror(errno) << "\n";
+      close(listenFd);
+      return 1;
+    }
+  }
+  listen(listenFd, 64);
+  outs() << "Compile daemon listening at " << path << "\n";
+  outs().flush();
+
+  int timeout = HLS_OPT_DAEMON_TIMEOUT;
+  if (const char *env = std::getenv("HLS_OPT_DAEMON_TIMEOUT"))
+    timeout = std::atoi(env);
+
+  // Jobs run concurrently, and their children are reaped by the system.
+  std::signal(SIGCHLD, SIG_IGN);
+  while (true) {
+    pollfd pfd{listenFd, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeout > 0 ? timeout * 1000 : -1);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0)
+      break;
+    int fd = accept(listenFd, nullptr, nullptr);
+    if (fd < 0)
+      continue;
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(listenFd);
+      runClientJob(fd, argv0, runJob);
+    }
+    // A job which could not be forked is answered by closing its connection,
+    // such that the client runs it itself.
+    close(fd);
+  }
+  close(listenFd);
+  ::unlink(addr.sun_path);
+  return 0;
+}
@@ -0,0 +1,45 @@
+//===- CompileDaemon.h - Warm hls-opt instances for hlstool -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The compile daemon of hls-opt ('hls-opt --daemon=<socket>'), a long-lived
+// process which has registered the dialects, passes and pipelines of hls-opt,
+// and which runs the command lines of its clients in children forked from
+// itself. Each job thus skips starting the process and registration, at no
+// risk of state leaking between jobs.
+//
+// A client connects to the Unix socket of the daemon and sends a single line
+// of JSON, {"cwd": <dir>, "args": [<arg>...]}, wherein 'args' are the
+// arguments of hls-opt less the program name. The daemon answers with a line
+// of JSON, {"code": <exit code>, "stdout": <text>, "stderr": <text>}, and
+// closes the connection. A job whose child exits without answering, such as
+// on a command line error, is run by the client itself. The daemon exits once
+// no client has connected for $HLS_OPT_DAEMON_TIMEOUT seconds (600 by
+// default; 0 waits indefinitely).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_HLS_TOOLS_HLS_OPT_COMPILEDAEMON_H
+#define CIRCT_HLS_TOOLS_HLS_OPT_COMPILEDAEMON_H
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace circt_hls {
+
+/// Runs a job of the daemon, given the command line of hls-opt, and returns
+/// its exit code.
+using DaemonJobFn = llvm::function_ref<int(int argc, char **argv)>;
+
+/// Serves the jobs of clients at the Unix socket 'path' through 'runJob', until
+/// the daemon times out. Returns non-zero if the socket could not be created.
+int serveCompileDaemon(llvm::StringRef path, const char *argv0,
+                       DaemonJobFn runJob);
+
+} // namespace circt_hls
+
+#endif // CIRCT_HLS_TOOLS_HLS_OPT_COMPILEDAEMON_H
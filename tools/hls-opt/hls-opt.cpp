@@ -11,11 +11,16 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "CompileDaemon.h"
 #include "mlir/Pass/PassRegistry.h"
 #include "circt-hls/InitAllDialects.h"
 #include "circt-hls/InitAllPasses.h"
 
+#include "circt/Conversion/Passes.h"
+#include "circt/Dialect/Handshake/HandshakePasses.h"
 #include "circt/Support/LoweringOptions.h"
+#include "circt/Transforms/Passes.h"
+#include "mlir/Conversion/Passes.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
 #include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/ControlFlow/IR/ControlFlow.h"
@@ -24,8 +29,271 @@
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/SCF/Transforms/Passes.h"
+#include "mlir/Pass/PassManager.h"
 #include "mlir/Tools/mlir-opt/MlirOptMain.h"
 #include "mlir/Transforms/Passes.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FormatVariadic.h"
+
+using namespace mlir;
+
+namespace {
+
+struct AffineToCFPipelineOptions
+    : public PassPipelineOptions<AffineToCFPipelineOptions> {
+  Option<bool> memrefResultsToArgs{
+      *this, "memref-results-to-args",
+      llvm::cl::desc("Pass the allocated memref results of the kernel through "
+                     "arguments; see -hls-memref-results-to-args"),
+      llvm::cl::init(false)};
+  Option<unsigned> unrollFactor{
+      *this, "unroll-factor",
+      llvm::cl::desc("Unroll innermost loops by up to this factor; see "
+                     "-hls-unroll-loops. 0 disables unrolling"),
+      llvm::cl::init(0)};
+  Option<bool> unrollPragmas{
+      *this, "unroll-pragmas",
+      llvm::cl::desc("Unroll the loops with unroll pragmas, even if "
+                     "unroll-factor disables unrolling; see -hls-unroll-loops"),
+      llvm::cl::init(false)};
+  Option<unsigned> partitionFactor{
+      *this, "partition-factor",
+      llvm::cl::desc("Partition memrefs into up to this many memories; see "
+                     "-affine-partition-memrefs. 0 disables partitioning"),
+      llvm::cl::init(0)};
+  Option<std::string> partitionKind{
+      *this, "partition-kind",
+      llvm::cl::desc("Kind of memref partitioning (cyclic or block)"),
+      llvm::cl::init("cyclic")};
+  Option<unsigned> vectorFactor{
+      *this, "vector-factor",
+      llvm::cl::desc("Combine up to this many consecutive elements of each "
+                     "memref into a wide element; see "
+                     "-affine-vectorize-memrefs. 0 disables vectorization"),
+      llvm::cl::init(0)};
+  Option<bool> fuseLoops{
+      *this, "fuse-loops",
+      llvm::cl::desc("Fuse producer and consumer loop nests; see "
+                     "-affine-fuse-loops"),
+      llvm::cl::init(false)};
+  Option<unsigned> tileSize{
+      *this, "tile-size",
+      llvm::cl::desc("Tile loop nests by this size, and copy the tiles of the "
+                     "memref arguments into scratchpads; see "
+                     "-affine-tile-scratchpads. 0 disables tiling"),
+      llvm::cl::init(0)};
+  Option<unsigned> scalarizeMemRefs{
+      *this, "scalarize-memrefs",
+      llvm::cl::desc("Pass read-only memrefs of up to this many elements as "
+                     "scalars; see -hls-scalarize-memrefs. 0 disables "
+                     "scalarization"),
+      llvm::cl::init(0)};
+  Option<bool> inferStreams{
+      *this, "infer-streams",
+      llvm::cl::desc("Mark the memrefs which are accessed sequentially as "
+                     "streams; see -affine-infer-streams"),
+      llvm::cl::init(false)};
+  Option<bool> narrowBitwidths{
+      *this, "narrow-bitwidths",
+      llvm::cl::desc("Narrow loops and arithmetic to the widths of their "
+                     "values; see -hls-narrow-bitwidths"),
+      llvm::cl::init(false)};
+};
+
+struct DynamicPipelineOptions
+    : public PassPipelineOptions<DynamicPipelineOptions> {
+  Option<std::string> bufferStrategy{
+      *this, "buffer-strategy",
+      llvm::cl::desc("Buffer strategy; see -handshake-insert-buffers"),
+      llvm::cl::init("cycles")};
+  Option<unsigned> bufferSize{
+      *this, "buffer-size",
+      llvm::cl::desc("Number of slots in each buffer; see "
+                     "-handshake-insert-buffers"),
+      llvm::cl::init(2)};
+  Option<std::string> bufferProfile{
+      *this, "buffer-profile",
+      llvm::cl::desc("A channel profile to buffer the kernel by; see "
+                     "-handshake-profile-buffers"),
+      llvm::cl::init("")};
+  Option<std::string> bufferPlacement{
+      *this, "buffer-placement",
+      llvm::cl::desc("A Dynamatic buffer placement to buffer the kernel by; "
+                     "see -handshake-import-buffers"),
+      llvm::cl::init("")};
+  Option<double> shareUnits{
+      *this, "share-units",
+      llvm::cl::desc("Share expensive units up to this estimated loss of "
+                     "throughput; see -handshake-share-units. A negative loss "
+                     "disables sharing"),
+      llvm::cl::init(-1.0)};
+  Option<std::string> shareProfile{
+      *this, "share-profile",
+      llvm::cl::desc("An op profile to share units by; see "
+                     "-handshake-share-units"),
+      llvm::cl::init("")};
+  Option<bool> lowerToFIRRTL{
+      *this, "lower-to-firrtl",
+      llvm::cl::desc("Lower the handshake kernel to FIRRTL"),
+      llvm::cl::init(false)};
+  Option<bool> flattenFIRRTL{
+      *this, "flatten-firrtl",
+      llvm::cl::desc("Flatten the top-level FIRRTL component; see "
+                     "-lower-handshake-to-firrtl"),
+      llvm::cl::init(false)};
+  Option<bool> narrowBitwidths{
+      *this, "narrow-bitwidths",
+      llvm::cl::desc("Narrow arithmetic and block arguments to the widths of "
+                     "their values; see -hls-narrow-bitwidths"),
+      llvm::cl::init(false)};
+  Option<bool> strengthReduce{
+      *this, "strength-reduce",
+      llvm::cl::desc("Replace multiplications of induction variables by "
+                     "additions; see -hls-strength-reduce"),
+      llvm::cl::init(false)};
+  Option<unsigned> ifConvert{
+      *this, "if-convert",
+      llvm::cl::desc("Convert branches of up to this many operations into "
+                     "selects; see -hls-if-convert. 0 disables if-conversion"),
+      llvm::cl::init(0)};
+};
+
+struct StaticPipelineOptions
+    : public PassPipelineOptions<StaticPipelineOptions> {
+  Option<std::string> topLevelFunction{
+      *this, "top-level-function",
+      llvm::cl::desc("The top-level function of the kernel; see "
+                     "-lower-scf-to-calyx"),
+      llvm::cl::init("")};
+};
+
+} // namespace
+
+/// Adds the passes of the textual 'pipeline' to 'pm'. Passes are nested
+/// implicitly, such that the pipelines don't depend on the operations which
+/// each pass is anchored on.
+static void addPipeline(OpPassManager &pm, const std::string &pipeline) {
+  pm.setNesting(OpPassManager::Nesting::Implicit);
+  if (failed(parsePassPipeline(pipeline, pm)))
+    llvm::report_fatal_error("invalid HLS pipeline: " + pipeline);
+}
+
+/// Registers the pipelines of the HLS flows, which run the steps of the flows
+/// within a single hls-opt invocation rather than one tool invocation each.
+/// The dynamic flow runs Polygeist's -mem2reg in between
+/// -hls-affine-to-cf-pipeline and -hls-dynamic-pipeline, since it has no
+/// upstream equivalent.
+static void registerPipelines() {
+  PassPipelineRegistration<AffineToCFPipelineOptions>(
+      "hls-affine-to-cf-pipeline",
+      "Unroll, partition and lower an affine kernel to control flow",
+      [](OpPassManager &pm, const AffineToCFPipelineOptions &opts) {
+        std::string pipeline;
+        // A vectorized memory serves as many elements per access as a memory
+        // partitioned by the vector factor.
+        unsigned partitionFactor =
+            std::max(opts.partitionFactor.getValue(), 1U) *
+            std::max(opts.vectorFactor.getValue(), 1U);
+        if (opts.memrefResultsToArgs)
+          pipeline += "hls-memref-results-to-args,";
+        if (opts.fuseLoops)
+          pipeline += "affine-fuse-loops,";
+        if (opts.tileSize > 0)
+          pipeline += llvm::formatv("affine-tile-scratchpads{{tile-size={0}},",
+                                    opts.tileSize)
+                          .str();
+        if (opts.unrollFactor > 1 || opts.unrollPragmas)
+          pipeline += llvm::formatv(
+                          "hls-unroll-loops{{max-factor={0} "
+                          "partition-factor={1}},",
+                          std::max(opts.unrollFactor.getValue(), 1U),
+                          partitionFactor)
+                          .str();
+        if (opts.vectorFactor > 1)
+          pipeline +=
+              llvm::formatv("affine-vectorize-memrefs{{max-factor={0}},",
+                            opts.vectorFactor)
+                  .str();
+        if (opts.partitionFactor > 1)
+          pipeline += llvm::formatv(
+              "affine-partition-memrefs{{max-factor={0} kind={1}},",
+              opts.partitionFactor, opts.partitionKind)
+                          .str();
+        if (opts.scalarizeMemRefs > 0)
+          pipeline +=
+              llvm::formatv("hls-scalarize-memrefs{{max-elements={0}},",
+                            opts.scalarizeMemRefs)
+                  .str();
+        if (opts.inferStreams)
+          pipeline += "affine-infer-streams,";
+        pipeline += "lower-affine,";
+        if (opts.narrowBitwidths)
+          pipeline += "hls-narrow-bitwidths,";
+        pipeline += "convert-scf-to-cf";
+        addPipeline(pm, pipeline);
+      });
+
+  PassPipelineRegistration<DynamicPipelineOptions>(
+      "hls-dynamic-pipeline",
+      "Lower a control flow kernel to a buffered handshake kernel, and "
+      "optionally to FIRRTL",
+      [](OpPassManager &pm, const DynamicPipelineOptions &opts) {
+        // Canonicalization is not run before the lowering to handshake, since
+        // it would undo -push-constants.
+        std::string pipeline;
+        if (opts.strengthReduce)
+          pipeline += "hls-strength-reduce,";
+        if (opts.ifConvert > 0)
+          pipeline +=
+              llvm::formatv("hls-if-convert{{max-ops={0}},", opts.ifConvert)
+                  .str();
+        pipeline += "push-constants,max-ssa{ignore-memref liveness},";
+        if (opts.narrowBitwidths)
+          pipeline += "hls-narrow-bitwidths,";
+        pipeline += "lower-std-to-handshake{source-constants},canonicalize,"
+                    "handshake-materialize-forks-sinks,";
+        pipeline += llvm::formatv(
+            "handshake-insert-buffers{{strategy={0} buffer-size={1}},",
+            opts.bufferStrategy, opts.bufferSize)
+                        .str();
+        pipeline += "canonicalize,handshake-add-ids";
+        if (!opts.bufferPlacement.empty())
+          pipeline += llvm::formatv(
+                          ",handshake-import-buffers{{placement={0}}",
+                          opts.bufferPlacement)
+                          .str();
+        if (!opts.bufferProfile.empty())
+          pipeline += llvm::formatv(",handshake-profile-buffers{{profile={0}}",
+                                    opts.bufferProfile)
+                          .str();
+        if (opts.shareUnits >= 0) {
+          pipeline += llvm::formatv(",handshake-share-units{{max-loss={0}",
+                                    opts.shareUnits)
+                          .str();
+          if (!opts.shareProfile.empty())
+            pipeline += " profile=" + opts.shareProfile;
+          pipeline += "}";
+        }
+        if (opts.lowerToFIRRTL) {
+          pipeline += opts.flattenFIRRTL
+                          ? ",lower-handshake-to-firrtl{flatten}"
+                          : ",lower-handshake-to-firrtl";
+          pipeline += ",clean-unregistered-attributes{dialect=dlti}";
+        }
+        addPipeline(pm, pipeline);
+      });
+
+  PassPipelineRegistration<StaticPipelineOptions>(
+      "hls-static-pipeline", "Lower an affine kernel to Calyx",
+      [](OpPassManager &pm, const StaticPipelineOptions &opts) {
+        addPipeline(pm, llvm::formatv("lower-affine,scf-for-to-while,"
+                                      "lower-scf-to-calyx{{top-level-function="
+                                      "{0}}",
+                                      opts.topLevelFunction)
+                                .str());
+      });
+}
 
 int main(int argc, char **argv) {
   mlir::DialectRegistry registry;
@@ -48,9 +316,31 @@ int main(int argc, char **argv) {
   mlir::registerInlinerPass();
   mlir::registerCanonicalizerPass();
 
+  // Register the upstream and CIRCT passes of the HLS flows.
+  mlir::registerConvertAffineToStandard();
+  mlir::registerSCFToControlFlow();
+  mlir::registerSCFPasses();
+  circt::registerFlattenMemRef();
+  circt::registerStandardToHandshake();
+  circt::registerHandshakeToFIRRTL();
+  circt::registerSCFToCalyx();
+  circt::handshake::registerPasses();
+
   circt_hls::registerAllPasses();
+  registerPipelines();
+
+  auto optMain = [&](int argc, char **argv) {
+    return mlir::failed(mlir::MlirOptMain(
+        argc, argv, "CIRCT HLS modular optimizer driver", registry,
+        /*preloadDialectsInContext=*/false));
+  };
 
-  return mlir::failed(mlir::MlirOptMain(
-      argc, argv, "CIRCT HLS modular optimizer driver", registry,
-      /*preloadDialectsInContext=*/false));
+  // Serve the jobs of hlstool from this process, once registered, if started
+  // as a compile daemon; see CompileDaemon.h.
+  llvm::StringRef daemonFlag = "--daemon=";
+  if (argc == 2 && llvm::StringRef(argv[1]).startswith(daemonFlag))
+    return circt_hls::serveCompileDaemon(
+        llvm::StringRef(argv[1]).drop_front(daemonFlag.size()), argv[0],
+        optMain);
+  return optMain(argc, argv);
 }
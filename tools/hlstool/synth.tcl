@@ -1,8 +1,9 @@
 # HLSTool general synthesis script
 
-if { $argc != 4 } {
-  puts "The synth.tcl script requires three arguments"
-  puts "Usage: synth <top level> <part name> <output directory> <do route>"
+if { $argc < 4 } {
+  puts "The synth.tcl script requires at least four arguments"
+  puts "Usage: synth <top level> <part name> <output directory> <do route>\
+        \[<checkpoint directory> \[<sources>...\]\]"
   exit 1
 }
 set top [lindex $argv 0]
@@ -10,25 +11,54 @@ set part [lindex $argv 1]
 set outdir [lindex $argv 2]
 set doRouting [lindex $argv 3]
 
+# The checkpoints of the last run of the top level are kept in the checkpoint
+# directory, if given ("-" for none), and seed the synthesis and
+# implementation of the next run.
+set checkpointDir ""
+if { $argc > 4 && [lindex $argv 4] != "-" } {
+  set checkpointDir [file normalize [lindex $argv 4]]
+}
+set synthRef [file join $checkpointDir ${top}_synth.dcp]
+set implRef [file join $checkpointDir ${top}_routed.dcp]
+
+# The sources default to those of the current directory.
+set sources [lrange $argv 5 end]
+if { [llength $sources] == 0 } {
+  set sources [concat [glob -nocomplain ./*.sv] [glob -nocomplain ./*.vhd] \
+                      [glob -nocomplain ./*.xdc] [glob -nocomplain ./*.saif]]
+}
+
 set_param general.maxThreads 8
 
 # Create the project (forcibly overwriting) and add sources SystemVerilog
 # (*.sv) and Xilinx constraint files (*.xdc), which contain directives for
-# connecting design signals to physical FPGA pins.
+# connecting design signals to physical FPGA pins. Switching activity files
+# (*.saif) of a simulation of the design annotate the power report.
 create_project -force -part $part $top $outdir
 
-foreach item [glob -nocomplain ./*.sv] {
-  add_files -norecurse $item
-}
-foreach item [glob -nocomplain ./*.vhd] {
-  add_files -norecurse $item
-  # Enforce VHDL-2008 on the file
-  set file [file normalize $item]
-  set file_obj [get_files -of_objects [get_filesets sources_1] [list "*$file"]]
-  set_property -name "file_type" -value "VHDL 2008" -objects $file_obj
+set saifFiles {}
+foreach item $sources {
+  switch [file extension $item] {
+    .saif {
+      lappend saifFiles [file normalize $item]
+    }
+    .xdc {
+      add_files -fileset constrs_1 $item
+    }
+    .vhd {
+      add_files -norecurse $item
+      # Enforce VHDL-2008 on the file
+      set file [file normalize $item]
+      set file_obj [get_files -of_objects [get_filesets sources_1] \
+                              [list "*$file"]]
+      set_property -name "file_type" -value "VHDL 2008" -objects $file_obj
+    }
+    default {
+      add_files -norecurse $item
+    }
+  }
 }
 
-add_files -fileset constrs_1 [glob ./*.xdc]
 set_property top $top [current_fileset]
 
 # Switch the project to "out-of-context" mode, which frees us from the need to
@@ -38,6 +68,22 @@ set_property \
     -value {-mode out_of_context -flatten_hierarchy "full"} \
     -objects [get_runs synth_1]
 
+# Synthesize and implement incrementally against the checkpoints of the last
+# run, such that the parts of the design which are unchanged since then are
+# reused rather than synthesized, placed and routed again.
+if { $checkpointDir != "" } {
+  if { [file exists $synthRef] } {
+    puts "Synthesizing incrementally against $synthRef"
+    set_property -name INCREMENTAL_CHECKPOINT -value $synthRef \
+        -objects [get_runs synth_1]
+  }
+  if { [file exists $implRef] } {
+    puts "Implementing incrementally against $implRef"
+    set_property -name INCREMENTAL_CHECKPOINT -value $implRef \
+        -objects [get_runs impl_1]
+  }
+}
+
 # Run synthesis. This is enough to generate the utilization report mentioned
 # above but does not include timing information.
 launch_runs synth_1
@@ -49,4 +95,28 @@ if { $doRouting != 0} {
   # faster if you just need the resource report!
   launch_runs impl_1 -to_step route_design
   wait_on_run impl_1
-}
\ No newline at end of file
+}
+
+# Estimate the power of the implemented design from the simulated switching
+# activity, rather than from vectorless estimates.
+if { $doRouting != 0 && [llength $saifFiles] != 0 } {
+  open_run impl_1
+  foreach saif $saifFiles {
+    read_saif -strip_path $top $saif
+  }
+  report_power -file [file join $outdir ${top}_power_saif.rpt]
+  close_design
+}
+
+# Keep the checkpoints of this run as the reference of the next one.
+if { $checkpointDir != "" } {
+  file mkdir $checkpointDir
+  set synthDcp [file join $outdir ${top}.runs synth_1 ${top}.dcp]
+  if { [file exists $synthDcp] } {
+    file copy -force $synthDcp $synthRef
+  }
+  set implDcp [file join $outdir ${top}.runs impl_1 ${top}_routed.dcp]
+  if { $doRouting != 0 && [file exists $implDcp] } {
+    file copy -force $implDcp $implRef
+  }
+}
@@ -0,0 +1,25 @@
+//===- HLTPrebuilt.cpp - Prebuilt HLT simulator instantiations ------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Explicit instantiations of the handshake ports and memory interfaces of the
+// HLT simulator for each Verilator data type. Simulators which are built with
+// HLT_PREBUILT link against these, rather than instantiating them in each
+// generated wrapper.
+//
+//===----------------------------------------------------------------------===//
+
+#define HLT_PREBUILT_INSTANTIATE
+#include "circt-hls/Tools/hlt/Simulator/HandshakeSimInterface.h"
+
+namespace circt {
+namespace hlt {
+
+HLT_INSTANTIATE_HANDSHAKE()
+
+} // namespace hlt
+} // namespace circt
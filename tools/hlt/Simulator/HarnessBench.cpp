@@ -0,0 +1,245 @@
+//===- HarnessBench.cpp - HLT simulator harness micro-benchmark -----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures the overhead of the HLT handshake simulator harness per cycle, per
+// transaction and per memory access. The harness drives the trivial verilated
+// models of HarnessBench.sv, whose evaluations are counted and timed
+// separately, such that the cost of evaluating the RTL can be subtracted from
+// the cost of each simulated cycle.
+//
+// The round-trip through SimDriver additionally measures the host-side queues
+// and the SimRunner. This writes the simulator log of the run to the current
+// directory.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt-hls/Tools/hlt/Simulator/HandshakeSimInterface.h"
+#include "circt-hls/Tools/hlt/Simulator/SimDriver.h"
+
+#include "VMemLoad.h"
+#include "VPassThrough.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <tuple>
+#include <vector>
+
+using namespace circt::hlt;
+using Clock = std::chrono::steady_clock;
+
+// Number of cycles, transactions or memory accesses of each benchmark.
+static size_t kIterations = 1000000;
+
+// Number of elements of the memory which the MemLoad model loads from.
+static constexpr size_t kMemSize = 1024;
+
+static double nsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+      .count();
+}
+
+/// Counts the evaluations of a verilated model. Verilated models don't
+/// declare eval() virtual, so the harness calls this through the TModel
+/// template parameter.
+template <typename TVModel>
+struct CountingModel : public TVModel {
+  using TVModel::TVModel;
+  void eval() {
+    ++evals;
+    TVModel::eval();
+  }
+  static inline uint64_t evals = 0;
+};
+
+using PassThroughModel = CountingModel<VPassThrough>;
+using MemLoadModel = CountingModel<VMemLoad>;
+
+using PassThroughInput = std::tuple<IData>;
+using MemLoadInput = std::tuple<IData *, IData>;
+using TOutput = std::tuple<IData>;
+
+// Mirrors the simulators which hlt-wrapgen emits for handshake kernels.
+class PassThroughSim
+    : public HandshakeSimInterface<PassThroughInput, TOutput,
+                                   PassThroughModel> {
+public:
+  PassThroughSim() {
+    interface.clock = &dut->clock;
+    interface.reset = &dut->reset;
+    inCtrl = std::make_unique<HandshakeInPort>(&dut->inCtrl_ready,
+                                               &dut->inCtrl_valid);
+    outCtrl = std::make_unique<HandshakeOutPort>(&dut->outCtrl_ready,
+                                                 &dut->outCtrl_valid);
+    addInputPort<HandshakeDataInPort<IData>>("in0", &dut->in0_ready,
+                                             &dut->in0_valid, &dut->in0_data);
+    addOutputPort<HandshakeDataOutPort<IData>>(
+        "out0", &dut->out0_ready, &dut->out0_valid, &dut->out0_data);
+  }
+};
+
+class MemLoadSim
+    : public HandshakeSimInterface<MemLoadInput, TOutput, MemLoadModel> {
+public:
+  MemLoadSim() {
+    interface.clock = &dut->clock;
+    interface.reset = &dut->reset;
+    inCtrl = std::make_unique<HandshakeInPort>(&dut->inCtrl_ready,
+                                               &dut->inCtrl_valid);
+    outCtrl = std::make_unique<HandshakeOutPort>(&dut->outCtrl_ready,
+                                                 &dut->outCtrl_valid);
+    auto in0 =
+        addInputPort<HandshakeMemoryInterface<IData, IData>>(/*size=*/kMemSize);
+    in0->addLoadPort(std::make_shared<HandshakeDataInPort<IData>>(
+                         "in0_ldData0", &dut->in0_ldData0_ready,
+                         &dut->in0_ldData0_valid, &dut->in0_ldData0_data),
+                     std::make_shared<HandshakeDataOutPort<IData>>(
+                         "in0_ldAddr0", &dut->in0_ldAddr0_ready,
+                         &dut->in0_ldAddr0_valid, &dut->in0_ldAddr0_data),
+                     std::make_shared<HandshakeInPort>(
+                         "in0_ldDone0", &dut->in0_ldDone0_ready,
+                         &dut->in0_ldDone0_valid));
+    addInputPort<HandshakeDataInPort<IData>>("in1", &dut->in1_ready,
+                                             &dut->in1_valid, &dut->in1_data);
+    addOutputPort<HandshakeDataOutPort<IData>>(
+        "out0", &dut->out0_ready, &dut->out0_valid, &dut->out0_data);
+  }
+};
+
+struct Result {
+  // Wall time per unit (cycle, transaction or access), in ns.
+  double wall;
+  // Simulated cycles and model evaluations per unit.
+  double cycles;
+  double evals;
+};
+
+// Average time of a single evaluation of a verilated model, outside of the
+// harness.
+template <typename TVModel>
+static double evalCost() {
+  VerilatedContext ctx;
+  TVModel model(&ctx);
+  auto start = Clock::now();
+  for (size_t i = 0; i < kIterations; ++i) {
+    model.clock = !model.clock;
+    ctx.timeInc(1);
+    model.eval();
+  }
+  double ns = nsSince(start) / kIterations;
+  model.final();
+  return ns;
+}
+
+// Sets up a simulator which is driven directly, rather than by a SimRunner.
+template <typename TSim>
+static void setup(TSim &sim) {
+  sim.setKeepAliveCallback([]() {});
+  sim.setup();
+}
+
+// Steps the simulator without any inputs.
+static Result idleCycles() {
+  PassThroughSim sim;
+  setup(sim);
+  uint64_t evals = PassThroughModel::evals;
+  auto start = Clock::now();
+  for (size_t i = 0; i < kIterations; ++i)
+    sim.step();
+  double ns = nsSince(start);
+  double n = kIterations;
+  return {ns / n, 1.0, (PassThroughModel::evals - evals) / n};
+}
+
+// Streams 'kIterations' inputs through the simulator, pushing an input
+// whenever the simulator is ready and popping each output as soon as it is
+// valid, like SimRunner does.
+template <typename TSim, typename TModel, typename GetInput>
+static Result transactions(GetInput getInput) {
+  TSim sim;
+  setup(sim);
+  uint64_t evals = TModel::evals;
+  uint64_t cycles = sim.time();
+  size_t pushed = 0, popped = 0;
+  auto start = Clock::now();
+  while (popped < kIterations) {
+    if (pushed < kIterations && sim.inReady())
+      sim.pushInput(getInput(pushed++));
+    sim.step();
+    if (sim.outValid()) {
+      TOutput out = sim.popOutput();
+      assert(std::get<0>(out) == popped % kMemSize && "Wrong output");
+      (void)out;
+      ++popped;
+    }
+  }
+  double ns = nsSince(start);
+  double n = kIterations;
+  return {ns / n, (sim.time() - cycles) / n, (TModel::evals - evals) / n};
+}
+
+// Round-trip of batches of inputs through a SimDriver, which runs the
+// simulator on a SimRunner thread.
+static Result driverRoundTrip() {
+  static constexpr size_t kBatch = 64;
+  // The runner thread is never joined, so the driver is leaked, as in the
+  // wrappers emitted by hlt-wrapgen.
+  auto *driver = new SimDriver<PassThroughInput, TOutput, PassThroughSim>();
+  std::vector<PassThroughInput> in(kBatch);
+  std::vector<TOutput> out(kBatch);
+  size_t n = kIterations / 10 / kBatch * kBatch;
+  auto start = Clock::now();
+  for (size_t i = 0; i < n; i += kBatch) {
+    for (size_t j = 0; j < kBatch; ++j)
+      in[j] = PassThroughInput((i + j) % kMemSize);
+    driver->pushBatch(in.data(), kBatch);
+    driver->popBatch(out.data(), kBatch);
+  }
+  return {nsSince(start) / n, 0.0, 0.0};
+}
+
+static void print(const char *name, const char *unit, const Result &r,
+                  double evalNs) {
+  std::cout << name << ":\n"
+            << "  wall:    " << r.wall << " ns/" << unit << "\n";
+  if (r.evals == 0)
+    return;
+  std::cout << "  cycles:  " << r.cycles << " /" << unit << "\n"
+            << "  evals:   " << r.evals << " /" << unit << "\n"
+            << "  harness: " << r.wall - r.evals * evalNs << " ns/" << unit
+            << "\n";
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1)
+    kIterations = std::strtoull(argv[1], nullptr, 10);
+
+  double passThroughEval = evalCost<VPassThrough>();
+  double memLoadEval = evalCost<VMemLoad>();
+  std::cout << "Model evaluation:\n"
+            << "  PassThrough: " << passThroughEval << " ns/eval\n"
+            << "  MemLoad:     " << memLoadEval << " ns/eval\n";
+
+  print("Idle cycle", "cycle", idleCycles(), passThroughEval);
+  print("Transaction", "transaction",
+        transactions<PassThroughSim, PassThroughModel>([](size_t i) {
+          return PassThroughInput(i % kMemSize);
+        }),
+        passThroughEval);
+
+  std::vector<IData> mem(kMemSize);
+  for (size_t i = 0; i < kMemSize; ++i)
+    mem[i] = i;
+  print("Memory load", "access",
+        transactions<MemLoadSim, MemLoadModel>([&](size_t i) {
+          return MemLoadInput(mem.data(), i % kMemSize);
+        }),
+        memLoadEval);
+
+  print("SimDriver round-trip", "transaction", driverRoundTrip(), 0.0);
+  return 0;
+}
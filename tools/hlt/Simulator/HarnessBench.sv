@@ -0,0 +1,59 @@
+// Trivial handshake models for HarnessBench.cpp. Both models are purely
+// combinational, such that evaluating them costs next to nothing compared to
+// the simulator harness which drives them.
+
+// f(a: i32) -> i32 { return a; }
+module PassThrough(
+  input         clock,
+  input         reset,
+  input  [31:0] in0_data,
+  input         in0_valid,
+  output        in0_ready,
+  input         inCtrl_valid,
+  output        inCtrl_ready,
+  output [31:0] out0_data,
+  output        out0_valid,
+  input         out0_ready,
+  output        outCtrl_valid,
+  input         outCtrl_ready);
+
+  assign out0_data = in0_data;
+  assign out0_valid = in0_valid;
+  assign in0_ready = out0_ready;
+  assign outCtrl_valid = inCtrl_valid;
+  assign inCtrl_ready = outCtrl_ready;
+endmodule
+
+// f(mem: memref<?xi32>, idx: i32) -> i32 { return mem[idx]; }
+module MemLoad(
+  input         clock,
+  input         reset,
+  input  [31:0] in0_ldData0_data,
+  input         in0_ldData0_valid,
+  output        in0_ldData0_ready,
+  output [31:0] in0_ldAddr0_data,
+  output        in0_ldAddr0_valid,
+  input         in0_ldAddr0_ready,
+  input         in0_ldDone0_valid,
+  output        in0_ldDone0_ready,
+  input  [31:0] in1_data,
+  input         in1_valid,
+  output        in1_ready,
+  input         inCtrl_valid,
+  output        inCtrl_ready,
+  output [31:0] out0_data,
+  output        out0_valid,
+  input         out0_ready,
+  output        outCtrl_valid,
+  input         outCtrl_ready);
+
+  assign in0_ldAddr0_data = in1_data;
+  assign in0_ldAddr0_valid = in1_valid;
+  assign in1_ready = in0_ldAddr0_ready;
+  assign out0_data = in0_ldData0_data;
+  assign out0_valid = in0_ldData0_valid;
+  assign in0_ldData0_ready = out0_ready;
+  assign in0_ldDone0_ready = 1'b1;
+  assign outCtrl_valid = inCtrl_valid;
+  assign inCtrl_ready = outCtrl_ready;
+endmodule
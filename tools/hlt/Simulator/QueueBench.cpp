@@ -0,0 +1,90 @@
+//===- QueueBench.cpp - HLT queue micro-benchmark -------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures push/pop latency and throughput of the queues used between the HLT
+// simulator driver and runner threads. The list-based AtomicQueue is compared
+// against the lock-free SPSCQueue.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt-hls/Tools/hlt/Simulator/SimInterface.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <tuple>
+
+using namespace circt::hlt;
+using Clock = std::chrono::steady_clock;
+using TValue = std::tuple<uint32_t, uint64_t>;
+
+// Number of values transferred between the two threads in each benchmark.
+static size_t kIterations = 1000000;
+
+// Pops from a queue, spinning until a value is available.
+template <typename TQueue>
+static TValue spinPop(TQueue &q) {
+  while (q.empty())
+    std::this_thread::yield();
+  return q.pop();
+}
+
+// Average time per value when a producer streams values to a consumer.
+template <typename TQueue>
+static double throughput() {
+  TQueue q;
+  auto start = Clock::now();
+  std::thread producer([&]() {
+    for (size_t i = 0; i < kIterations; ++i)
+      q.push(TValue(i, i));
+  });
+  uint64_t sum = 0;
+  for (size_t i = 0; i < kIterations; ++i)
+    sum += std::get<1>(spinPop(q));
+  producer.join();
+  auto end = Clock::now();
+  assert(sum == kIterations * (kIterations - 1) / 2 && "Lost values");
+  (void)sum;
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         kIterations;
+}
+
+// Average round-trip time of a value sent to another thread and back, like a
+// driver push() followed by a pop().
+template <typename TQueue>
+static double latency() {
+  TQueue ping, pong;
+  size_t n = kIterations / 10;
+  std::thread echo([&]() {
+    for (size_t i = 0; i < n; ++i)
+      pong.push(spinPop(ping));
+  });
+  auto start = Clock::now();
+  for (size_t i = 0; i < n; ++i) {
+    ping.push(TValue(i, i));
+    spinPop(pong);
+  }
+  auto end = Clock::now();
+  echo.join();
+  return std::chrono::duration<double, std::nano>(end - start).count() / n;
+}
+
+template <typename TQueue>
+static void run(const char *name) {
+  std::cout << name << ":\n"
+            << "  throughput: " << throughput<TQueue>() << " ns/value\n"
+            << "  round-trip: " << latency<TQueue>() << " ns\n";
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1)
+    kIterations = std::strtoull(argv[1], nullptr, 10);
+
+  run<AtomicQueue<TValue>>("AtomicQueue");
+  run<SPSCQueue<TValue>>("SPSCQueue");
+  return 0;
+}
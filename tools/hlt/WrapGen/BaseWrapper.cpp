@@ -13,6 +13,11 @@
 #include "circt-hls/Tools/hlt/WrapGen/BaseWrapper.h"
 #include "circt-hls/Tools/hlt/WrapGen/CEmitterUtils.h"
 
+#include "mlir/IR/OwningOpRef.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+
 using namespace llvm;
 using namespace mlir;
 
@@ -20,17 +25,60 @@ namespace circt_hls {
 
 LogicalResult BaseWrapper::wrap(mlir::func::FuncOp _funcOp, Operation *refOp,
                                 Operation *kernelOp) {
-  funcOp = _funcOp;
-  if (init(refOp, kernelOp).failed())
+  return wrap({WrapTarget{_funcOp, refOp, kernelOp}}, _funcOp.getName());
+}
+
+LogicalResult BaseWrapper::wrap(ArrayRef<WrapTarget> targets,
+                                StringRef wrapperName) {
+  LogicalResult res = emitWrapper(targets, wrapperName);
+  // The last file is written even if the wrapper failed, as its earlier files
+  // have been.
+  if (failed(closeFile()))
     return failure();
+  return res;
+}
 
-  if (createFile(refOp->getLoc(), funcOp.getName() + ".cpp").failed())
+LogicalResult BaseWrapper::emitWrapper(ArrayRef<WrapTarget> targets,
+                                       StringRef wrapperName) {
+  assert(!targets.empty() && "Expected at least one kernel to wrap");
+  signatures.clear();
+  classDecls.clear();
+  pyBindings.clear();
+  if (createFile(targets.front().refOp->getLoc(), wrapperName + ".cpp")
+          .failed())
     return failure();
   osi() << "// This file is generated. Do not modify!\n";
 
-  // Emit includes
-  for (auto include : getIncludes())
+  // Emit includes of all kernels, in order of first appearance.
+  llvm::SetVector<std::string> includes;
+  for (auto &target : targets) {
+    funcOp = target.funcOp;
+    auto kernelIncludes = getIncludes();
+    includes.insert(kernelIncludes.begin(), kernelIncludes.end());
+  }
+  for (auto &include : includes)
     osi() << "#include \"" << include << "\"\n";
+  if (poolSize != 1)
+    osi() << "#include \"circt-hls/Tools/hlt/Simulator/SimDriverPool.h\"\n";
+  if (!chainName.empty())
+    osi() << "#include \"circt-hls/Tools/hlt/Simulator/SimPipeline.h\"\n";
+  // The runtime headers define the extern "C" functions which testbenches
+  // call, as do HostBuffer.h and FuzzInput.h (through SimDriver.h). The DPI-C
+  // functions of HandshakeDpiMemory.h are called by the model instead. The
+  // wrapper is the only file of a simulator library which includes the
+  // simulator headers, so they are defined once, here, and resolved by the
+  // testbench or model through the library.
+  osi() << "#include \"circt-hls/Tools/hlt/Simulator/CosimProfile.h\"\n";
+  osi() << "#include \"circt-hls/Tools/hlt/Simulator/CosimRuntime.h\"\n";
+  osi() << "#include \"circt-hls/Tools/hlt/Simulator/CosimSnapshot.h\"\n";
+  osi() << "#include \"circt-hls/Tools/hlt/Simulator/RefCache.h\"\n";
+  osi() << "#include \"circt-hls/Tools/hlt/Simulator/SimRecord.h\"\n";
+  osi() << "#include \"circt-hls/Tools/hlt/Simulator/SimServer.h\"\n";
+  osi() << "#include \"circt-hls/Tools/hlt/Simulator/SimStream.h\"\n";
+  // The kernel classes are declared in the header.
+  osi() << "#include \"" << wrapperName << ".h\"\n";
+  osi() << "#include <deque>\n";
+  osi() << "#include <vector>\n";
   osi() << "\n";
 
   // Emit namespaces
@@ -38,21 +86,374 @@ LogicalResult BaseWrapper::wrap(mlir::func::FuncOp _funcOp, Operation *refOp,
     osi() << "using namespace " << ns << ";\n";
   osi() << "\n";
 
+  // Each kernel gets its own simulator and driver. If multiple kernels are
+  // wrapped, the types and driver of each kernel are emitted within a separate
+  // namespace; the extern "C" call and await functions are unaffected by this.
+  for (auto &target : targets) {
+    funcOp = target.funcOp;
+    if (init(target.refOp, target.kernelOp).failed())
+      return failure();
+    bool multiKernel = targets.size() > 1;
+    if (multiKernel)
+      osi() << "namespace " << funcName() << "_hlt {\n\n";
+    if (emitKernel(target).failed())
+      return failure();
+    if (multiKernel)
+      osi() << "\n} // namespace " << funcName() << "_hlt\n\n";
+    std::string ns = multiKernel ? funcName().str() + "_hlt" : std::string();
+    if (emitKernelClass(ns).failed())
+      return failure();
+  }
+  if (!chainName.empty() && emitChain(targets).failed())
+    return failure();
+
+  // Create wrapper header file
+  if (createFile(targets.front().refOp->getLoc(), wrapperName + ".h").failed())
+    return failure();
+  osi() << "// This file is generated. Do not modify!\n";
+  // cstdint should be included to support the int#_t types used in the function
+  // arguments.
+  osi() << "#include \"cstdint\"\n";
+  osi() << "#include <future>\n";
+  osi() << "#include <memory>\n";
+  osi() << "#include <tuple>\n";
+  // The await functions of kernels with memref results return descriptors.
+  if (memRefResults)
+    osi() << "#include \"circt-hls/Tools/hlt/Simulator/MemoryInterface.h\"\n";
+  for (auto &signature : signatures)
+    osi() << signature << ";\n";
+  for (auto &classDecl : classDecls)
+    osi() << "\n" << classDecl;
+
+  if (!mainName.empty() && emitMain(targets, wrapperName).failed())
+    return failure();
+  if (nativeTb && emitNativeTb(targets, wrapperName).failed())
+    return failure();
+  if (!python)
+    return success();
+  if (createFile(targets.front().refOp->getLoc(), wrapperName + "_py.cpp")
+          .failed())
+    return failure();
+  osi() << "// This file is generated. Do not modify!\n";
+  osi() << "#include \"" << wrapperName << ".h\"\n";
+  osi() << "#include \"circt-hls/Tools/hlt/Simulator/PyBindings.h\"\n\n";
+  osi() << "using namespace circt::hlt;\n\n";
+  osi() << "PYBIND11_MODULE(" << wrapperName << ", m) {\n";
+  for (auto &binding : pyBindings)
+    osi() << binding;
+  osi() << "}\n";
+  return success();
+}
+
+LogicalResult BaseWrapper::emitMain(ArrayRef<WrapTarget> targets,
+                                    StringRef wrapperName) {
+  // The main function of a standalone executable, which streams the calls of
+  // an input stream through the simulator of the kernel (see emitStream).
+  Location loc = targets.front().refOp->getLoc();
+  if (llvm::none_of(targets, [&](const WrapTarget &target) {
+        return target.funcOp.getName() == mainName;
+      }))
+    return emitError(loc) << "No wrapped function named '" << mainName
+                          << "' to emit a main function for";
+  if (createFile(loc, "main.cpp").failed())
+    return failure();
+  osi() << "// This file is generated. Do not modify!\n";
+  osi() << "#include \"" << wrapperName << ".h\"\n";
+  osi() << "#include <cstdlib>\n";
+  osi() << "#include <iostream>\n\n";
+  osi() << "int main(int argc, char **argv) {\n";
+  osi().indent();
+  osi() << "if (argc < 3 || argc > 4) {\n";
+  osi() << "  std::cerr << \"Usage: \" << argv[0]\n";
+  osi() << "            << \" <input stream> <output stream> "
+           "[<calls in flight>]\\n\";\n";
+  osi() << "  return 1;\n";
+  osi() << "}\n";
+  osi() << "int64_t depth = argc == 4 ? std::atoll(argv[3]) : 64;\n";
+  osi() << "int64_t calls = " << mainName
+        << "_stream(argv[1], argv[2], depth);\n";
+  osi() << "if (calls < 0)\n";
+  osi() << "  return 1;\n";
+  osi() << "std::cerr << \"Streamed \" << calls << \" calls of '" << mainName
+        << "'\\n\";\n";
+  osi() << "return 0;\n";
+  osi().unindent();
+  osi() << "}\n";
+  return success();
+}
+
+LogicalResult BaseWrapper::emitNativeTb(ArrayRef<WrapTarget> targets,
+                                        StringRef wrapperName) {
+  // The testbench calls each kernel by its C signature, in which memref
+  // arguments are pointers to their contiguous elements. Each such function
+  // unpacks the memrefs into the MLIR calling convention of the call function
+  // (see emitType), and awaits the call before returning.
+  std::string defs;
+  llvm::raw_string_ostream defsStream(defs);
+  for (auto &target : targets) {
+    funcOp = target.funcOp;
+    Location loc = funcOp.getLoc();
+    ArrayRef<Type> results = funcOp.getFunctionType().getResults();
+    if (getMemRefResultArg())
+      return emitError(loc) << "Cannot emit the native testbench function of "
+                               "a kernel with memref results";
+    if (results.size() > 1)
+      return emitError(loc) << "Cannot emit the native testbench function of "
+                               "a kernel with more than one result";
+
+    std::string resultType;
+    llvm::raw_string_ostream resultStream(resultType);
+    if (emitTypes(resultStream, loc, results).failed())
+      return failure();
+
+    // The parameters of the function, the arguments of the call function, and
+    // of the reference, which is called on copies of the memories.
+    SmallVector<std::string> params, callArgs, refArgs, copies, compares;
+    for (auto it : enumerate(getHostInputs())) {
+      std::string in = "in" + std::to_string(it.index());
+      auto memrefType = it.value().dyn_cast<MemRefType>();
+      Type elemType = memrefType ? memrefType.getElementType() : it.value();
+      if (elemType.isIntOrFloat() && elemType.getIntOrFloatBitWidth() > 64)
+        return emitError(loc) << "Native testbenches of values wider than 64 "
+                                 "bits are unhandled for now";
+      std::string elemStr;
+      llvm::raw_string_ostream elemStream(elemStr);
+      if (emitArgType(elemStream, loc, elemType).failed())
+        return failure();
+      if (!memrefType) {
+        params.push_back(elemStr + " " + in);
+        callArgs.push_back(in);
+        refArgs.push_back(in);
+        continue;
+      }
+      if (!memrefType.hasStaticShape())
+        return emitError(loc) << "Native testbenches of dynamically shaped "
+                                 "memories are unhandled for now";
+
+      // The memory is contiguous, in row-major order.
+      std::string ptr = "static_cast<" + elemStr + " *>(" + in + ")";
+      std::string args = ptr + ", " + ptr + ", 0";
+      for (int64_t size : memrefType.getShape())
+        args += ", " + std::to_string(size);
+      SmallVector<int64_t> strides(memrefType.getRank(), 1);
+      for (int64_t d = memrefType.getRank() - 2; d >= 0; --d)
+        strides[d] = strides[d + 1] * memrefType.getDimSize(d + 1);
+      for (int64_t stride : strides)
+        args += ", " + std::to_string(stride);
+      params.push_back("void *" + in);
+      callArgs.push_back(args);
+
+      std::string ref = "ref" + std::to_string(it.index());
+      std::string elements = std::to_string(memrefType.getNumElements());
+      copies.push_back("auto *" + ref + " = cosim.copy<" + elemStr + ">(" +
+                       in + ", " + elements + ");");
+      refArgs.push_back(ref);
+      compares.push_back("cosim.compare(\"" + in + "\", " + ref + ", " + ptr +
+                         ", " + elements + ");");
+    }
+
+    std::string name = funcName().str();
+    bool hasResult = !results.empty();
+    defsStream << "#ifdef HLT_NATIVE_COSIM\n";
+    defsStream << "extern \"C\" " << resultType << " " << name << "_ref(";
+    llvm::interleaveComma(params, defsStream);
+    defsStream << ");\n";
+    defsStream << "#endif\n\n";
+    defsStream << "extern \"C\" " << resultType << " " << name << "(";
+    llvm::interleaveComma(params, defsStream);
+    defsStream << ") {\n";
+    defsStream << "#ifdef HLT_NATIVE_COSIM\n";
+    defsStream << "  NativeCosim cosim(\"" << name << "\");\n";
+    for (auto &copy : copies)
+      defsStream << "  " << copy << "\n";
+    defsStream << "  " << (hasResult ? "auto ref = " : "") << name << "_ref(";
+    llvm::interleaveComma(refArgs, defsStream);
+    defsStream << ");\n";
+    defsStream << "#endif\n";
+    defsStream << "  " << name << "_call(";
+    llvm::interleaveComma(callArgs, defsStream);
+    defsStream << ");\n";
+    defsStream << "  " << (hasResult ? "auto result = " : "") << name
+               << "_await();\n";
+    defsStream << "#ifdef HLT_NATIVE_COSIM\n";
+    for (auto &compare : compares)
+      defsStream << "  " << compare << "\n";
+    if (hasResult)
+      defsStream << "  cosim.compare(\"result\", ref, result);\n";
+    defsStream << "#endif\n";
+    if (hasResult)
+      defsStream << "  return result;\n";
+    defsStream << "}\n\n";
+  }
+
+  if (createFile(targets.front().refOp->getLoc(), wrapperName + "_tb.cpp")
+          .failed())
+    return failure();
+  osi() << "// This file is generated. Do not modify!\n";
+  osi() << "#include \"" << wrapperName << ".h\"\n";
+  osi() << "#include \"circt-hls/Tools/hlt/Simulator/NativeCosim.h\"\n\n";
+  osi() << "using namespace circt::hlt;\n\n";
+  osi() << defsStream.str();
+  return success();
+}
+
+LogicalResult BaseWrapper::emitKernel(const WrapTarget &target) {
   // Emit preamble;
-  if (emitPreamble(kernelOp).failed())
+  if (emitPreamble(target.kernelOp).failed())
     return failure();
+  return emitDriver();
+}
+
+LogicalResult BaseWrapper::emitChain(ArrayRef<WrapTarget> targets) {
+  Location loc = targets.front().funcOp.getLoc();
+  if (targets.size() < 2)
+    return emitError(loc) << "Expected at least two kernels to chain";
+
+  // The arguments of the pipeline are those of the first kernel, followed by
+  // the arguments of each subsequent kernel which are not results of the
+  // previous kernel.
+  SmallVector<Type> inputs;
+  for (auto it : enumerate(targets)) {
+    func::FuncOp stageOp = it.value().funcOp;
+    for (unsigned i = 0; i < stageOp.getNumArguments(); ++i) {
+      if (stageOp.getArgAttr(i, "hlt.partition") ||
+          stageOp.getArgAttr(i, "hlt.vector") ||
+          stageOp.getArgAttr(i, "hlt.scalar") ||
+          stageOp.getArgAttr(i, "hlt.result"))
+        return emitError(stageOp.getLoc())
+               << "Cannot chain kernel '" << stageOp.getName()
+               << "' with partitioned, vectorized or scalarized memref "
+                  "arguments, or memref results";
+    }
+    ArrayRef<Type> stageInputs = stageOp.getFunctionType().getInputs();
+    if (it.index() != 0) {
+      func::FuncOp prevOp = targets[it.index() - 1].funcOp;
+      ArrayRef<Type> prevResults = prevOp.getFunctionType().getResults();
+      if (stageInputs.take_front(prevResults.size()) != prevResults)
+        return emitError(stageOp.getLoc())
+               << "Cannot chain kernel '" << stageOp.getName()
+               << "': its leading arguments do not match the results of '"
+               << prevOp.getName() << "'";
+      stageInputs = stageInputs.drop_front(prevResults.size());
+    }
+    inputs.append(stageInputs.begin(), stageInputs.end());
+  }
+  ArrayRef<Type> results =
+      targets.back().funcOp.getFunctionType().getResults();
+
+  // The call and await functions of the pipeline are emitted for a function
+  // of its signature.
+  OwningOpRef<func::FuncOp> chainOp = func::FuncOp::create(
+      loc, chainName, FunctionType::get(loc.getContext(), inputs, results));
+  func::FuncOp kernelFuncOp = funcOp;
+  funcOp = chainOp.get();
 
+  osi() << "namespace " << funcName() << "_hlt {\n\n";
+  osi() << "using TSim = SimPipeline<";
+  interleaveComma(targets, osi(), [&](const WrapTarget &target) {
+    osi() << target.funcOp.getName() << "_hlt::TSim";
+  });
+  osi() << ">;\n";
+  osi() << "using TInput = TSim::Input;\n";
+  osi() << "using TOutput = TSim::Output;\n";
+  for (unsigned i = 0; i < inputs.size(); ++i)
+    osi() << "using TArg" << i << " = std::tuple_element_t<" << i
+          << ", TInput>;\n";
+  osi() << "\n";
+  LogicalResult res = emitDriver();
+  osi() << "\n} // namespace " << funcName() << "_hlt\n\n";
+  if (succeeded(res))
+    res = emitKernelClass((funcName() + "_hlt").str());
+  funcOp = kernelFuncOp;
+  return res;
+}
+
+LogicalResult BaseWrapper::emitDriver() {
   // Emit simulator driver and instantiation. This is dependent on types TInput,
-  // TOutput, TSim that should have been defined in emitPreamble.
-  osi() << "using TSimDriver = SimDriver<TInput, TOutput, TSim>;\n";
-  osi() << "static TSimDriver *driver = nullptr;\n\n";
+  // TOutput, TSim that should have been defined in emitPreamble. The driver
+  // simulates the kernel in-process, or forwards its calls to a simulation
+  // server if HLT_SIM_SERVER is set (see SimServer.h). The objects of the
+  // kernel class each simulate the kernel in-process.
+  std::string kernelName = funcOp.getName().str();
+  std::string driverArgs =
+      poolSize != 1 ? ", " + std::to_string(poolSize) : std::string();
+  osi() << "using TKernelDriver = ";
+  if (poolSize != 1)
+    osi() << "SimDriverPool<TInput, TOutput, TSim>;\n";
+  else
+    osi() << "SimDriver<TInput, TOutput, TSim>;\n";
+  osi() << "using TSimDriver = SimServerDriver<TInput, TOutput, "
+           "TKernelDriver>;\n";
+  osi() << "static TSimDriver *driver = nullptr;\n";
+  // The driver of a parallel testbench is created by the first thread which
+  // submits a call.
+  osi() << "static std::once_flag driverOnce;\n";
+  if (canReplay())
+    osi() << "static std::unique_ptr<SimRecorder> recorder;\n";
+  osi() << "\n";
   osi() << "void init_sim() {\n";
   osi() << "  assert(driver == nullptr && \"Simulator already initialized "
            "!\");\n";
-  osi() << "  driver = new TSimDriver();\n";
+  osi() << "  driver = new TSimDriver(\"" << kernelName << "\"" << driverArgs
+        << ");\n";
+  if (canReplay())
+    osi() << "  recorder = SimRecorder::fromEnv(\"" << kernelName << "\");\n";
+  osi() << "}\n\n";
+
+  // Register the driver with the fork server of fuzzing testbenches, which
+  // sets the simulator up before it forks the jobs of the testbench (see
+  // SimFork.h).
+  osi() << "#if HLT_FUZZ\n";
+  osi() << "static const bool forkTarget = SimForkServer::get().addTarget(\n";
+  osi() << "    []() {\n";
+  osi() << "      if (driver == nullptr)\n";
+  osi() << "        init_sim();\n";
+  osi() << "      driver->suspend();\n";
+  osi() << "    },\n";
+  osi() << "    []() { driver->resume(true); });\n";
+  osi() << "#endif\n\n";
+
+  // Emit the entry point of a simulation server of the kernel.
+  osi() << "extern \"C\" int " << kernelName << "_serve(const char *path) {\n";
+  osi() << "  assert(driver == nullptr && \"Simulator already initialized "
+           "!\");\n";
+  osi() << "  return TSimDriver::serve(path" << driverArgs << ");\n";
   osi() << "}\n\n";
 
+  // Emit the simulated cycles of the last call, which profiled cosim
+  // testbenches resolve at runtime (see CosimProfile.h).
+  osi() << "extern \"C\" uint64_t " << kernelName << "_cycles() {\n";
+  osi() << "  return driver ? driver->lastCallCycles() : 0;\n";
+  osi() << "}\n\n";
+
+  if (emitReplay().failed() || emitStream().failed())
+    return failure();
+
+  // A kernel with a memref result writes it to a memory which the call
+  // function allocates, and which the await function returns as the result.
+  // The memories of the calls in flight are queued in the order of the calls,
+  // in which their outputs are popped.
+  Optional<unsigned> resultArg = getMemRefResultArg();
+  if (resultArg) {
+    auto resultType =
+        funcOp.getArgument(*resultArg).getType().cast<MemRefType>();
+    if (funcOp.getNumResults() != 0 ||
+        llvm::count_if(llvm::iota_range(0U, funcOp.getNumArguments(), false),
+                       [&](unsigned i) { return getResultArg(i); }) != 1)
+      return emitError(funcOp.getLoc())
+             << "Expected a kernel with a memref result to have no other "
+                "results";
+    if (resultType.getRank() == 0 || !resultType.hasStaticShape() ||
+        isHostConverted(resultType))
+      return emitError(funcOp.getLoc())
+             << "Expected the memref result of a kernel to be statically "
+                "shaped, of at least one dimension, and of host elements";
+    osi() << "static std::deque<TArg" << *resultArg << "> results;\n\n";
+    memRefResults = true;
+  }
+
   // Emit async call
+  std::string callSignature;
   llvm::raw_string_ostream callSigStream(callSignature);
   callSigStream << "extern \"C\" void " << funcOp.getName().str() + "_call"
                 << "(";
@@ -60,58 +461,452 @@ LogicalResult BaseWrapper::wrap(mlir::func::FuncOp _funcOp, Operation *refOp,
   // InterleaveComma doesn't accept enumerate(inTypes)
   int i = 0;
   bool failed = false;
-  interleaveComma(
-      funcOp.getFunctionType().getInputs(), callSigStream, [&](auto inType) {
-        auto varName = "in" + std::to_string(i++);
-        failed |= emitType(callSigStream, _funcOp->getLoc(), inType, {varName})
-                      .failed();
-      });
+  SmallVector<Type> hostInputs = getHostInputs();
+  interleaveComma(hostInputs, callSigStream, [&](auto inType) {
+    auto varName = "in" + std::to_string(i++);
+    failed |= emitArgType(callSigStream, funcOp.getLoc(), inType, {varName})
+                  .failed();
+  });
   if (failed)
     return failure();
   callSigStream << ")";
   os() << callSignature << "{\n";
   osi().indent();
+  osi() << "HLT_PROFILE_SCOPE(\"" << kernelName << "_call\");\n";
   emitAsyncCall();
   osi().unindent();
   osi() << "}\n\n";
 
   // Emit async await
+  std::string awaitSignature;
   llvm::raw_string_ostream awaitSigStream(awaitSignature);
   awaitSigStream << "extern \"C\" ";
-  if (emitTypes(awaitSigStream, funcOp.getLoc(),
-                funcOp.getFunctionType().getResults())
-          .failed())
+  if (resultArg) {
+    // The descriptor of a memref result is laid out like the struct which
+    // the MLIR calling convention returns it as.
+    auto resultType =
+        funcOp.getArgument(*resultArg).getType().cast<MemRefType>();
+    awaitSigStream << "MemRefDescriptor<";
+    if (emitType(awaitSigStream, funcOp.getLoc(), resultType.getElementType())
+            .failed())
+      return failure();
+    awaitSigStream << ", " << resultType.getRank() << ">";
+  } else if (emitTypes(awaitSigStream, funcOp.getLoc(),
+                       funcOp.getFunctionType().getResults())
+                 .failed())
     return failure();
   awaitSigStream << " " << funcOp.getName().str() + "_await"
                  << "()";
   os() << awaitSignature << "{\n";
   osi().indent();
+  osi() << "HLT_PROFILE_SCOPE(\"" << kernelName << "_await\");\n";
   emitAsyncAwait();
+  osi().unindent();
+  osi() << "}\n\n";
+
+  // The batched and tagged functions pass no memories of memref results.
+  if (resultArg) {
+    signatures.push_back(callSignature);
+    signatures.push_back(awaitSignature);
+    return success();
+  }
+
+  // Emit batched async call. Each input argument is passed as an array of n
+  // values; memref arguments are passed as arrays of base pointers.
+  std::string callBatchSignature;
+  llvm::raw_string_ostream callBatchSigStream(callBatchSignature);
+  callBatchSigStream << "extern \"C\" void "
+                     << funcOp.getName().str() + "_call_batch"
+                     << "(int64_t n";
+  for (auto inType : enumerate(hostInputs)) {
+    callBatchSigStream << ", ";
+    Type elemType = inType.value();
+    bool isPtr = false;
+    if (auto memRefType = elemType.dyn_cast<MemRefType>()) {
+      elemType = memRefType.getElementType();
+      isPtr = true;
+    }
+    // Elements without a C type are passed through untyped pointers, as in
+    // emitType.
+    if (isPtr && elemType.isa<IntegerType>() &&
+        elemType.getIntOrFloatBitWidth() > 128)
+      callBatchSigStream << "void";
+    else if (emitArgType(callBatchSigStream, funcOp.getLoc(), elemType)
+                 .failed())
+      return failure();
+    callBatchSigStream << (isPtr ? "**" : "*") << " in" << inType.index();
+  }
+  callBatchSigStream << ")";
+  os() << callBatchSignature << "{\n";
+  osi().indent();
+  osi() << "HLT_PROFILE_SCOPE(\"" << kernelName << "_call_batch\");\n";
+  emitAsyncCallBatch();
+  osi().unindent();
+  osi() << "}\n\n";
+
+  // Emit batched async await. Results are written to an array of n values.
+  std::string awaitBatchSignature;
+  llvm::raw_string_ostream awaitBatchSigStream(awaitBatchSignature);
+  awaitBatchSigStream << "extern \"C\" void "
+                      << funcOp.getName().str() + "_await_batch"
+                      << "(int64_t n";
+  if (funcOp.getNumResults() != 0) {
+    awaitBatchSigStream << ", ";
+    if (emitTypes(awaitBatchSigStream, funcOp.getLoc(),
+                  funcOp.getFunctionType().getResults())
+            .failed())
+      return failure();
+    awaitBatchSigStream << "* out";
+  }
+  awaitBatchSigStream << ")";
+  os() << awaitBatchSignature << "{\n";
+  osi().indent();
+  osi() << "HLT_PROFILE_SCOPE(\"" << kernelName << "_await_batch\");\n";
+  emitAsyncAwaitBatch();
+  osi().unindent();
+  osi() << "}\n\n";
+
+  // Emit tagged async call. The input is tagged with an ID, which is returned
+  // along with its output by the tagged await. Outputs may then be awaited out
+  // of order, when the driver simulates multiple instances of the kernel.
+  std::string callTaggedSignature;
+  llvm::raw_string_ostream callTaggedSigStream(callTaggedSignature);
+  callTaggedSigStream << "extern \"C\" void "
+                      << funcOp.getName().str() + "_call_tagged"
+                      << "(int64_t tag";
+  i = 0;
+  for (auto inType : hostInputs) {
+    auto varName = "in" + std::to_string(i++);
+    callTaggedSigStream << ", ";
+    if (emitArgType(callTaggedSigStream, funcOp.getLoc(), inType, {varName})
+            .failed())
+      return failure();
+  }
+  callTaggedSigStream << ")";
+  os() << callTaggedSignature << "{\n";
+  osi().indent();
+  osi() << "HLT_PROFILE_SCOPE(\"" << kernelName << "_call_tagged\");\n";
+  emitAsyncCallTagged();
+  osi().unindent();
+  osi() << "}\n\n";
+
+  // Emit tagged async await. The tag of the output is written to a memref of a
+  // single element, following the MLIR calling convention.
+  std::string awaitTaggedSignature;
+  llvm::raw_string_ostream awaitTaggedSigStream(awaitTaggedSignature);
+  awaitTaggedSigStream << "extern \"C\" ";
+  if (emitTypes(awaitTaggedSigStream, funcOp.getLoc(),
+                funcOp.getFunctionType().getResults())
+          .failed())
+    return failure();
+  awaitTaggedSigStream << " " << funcOp.getName().str() + "_await_tagged"
+                       << "(";
+  auto tagType =
+      MemRefType::get({1}, IntegerType::get(funcOp.getContext(), 64));
+  if (emitType(awaitTaggedSigStream, funcOp.getLoc(), tagType, {"tag"})
+          .failed())
+    return failure();
+  awaitTaggedSigStream << ")";
+  os() << awaitTaggedSignature << "{\n";
+  osi().indent();
+  osi() << "HLT_PROFILE_SCOPE(\"" << kernelName << "_await_tagged\");\n";
+  emitAsyncAwaitTagged();
+  osi().unindent();
+  osi() << "}\n\n";
+
+  // Emit the submission of a call by one of the threads of a parallel
+  // testbench. The call is identified by the returned ticket, through which
+  // the thread awaits its output, regardless of the calls of other threads.
+  std::string submitSignature;
+  llvm::raw_string_ostream submitSigStream(submitSignature);
+  submitSigStream << "extern \"C\" int64_t "
+                  << funcOp.getName().str() + "_submit"
+                  << "(";
+  i = 0;
+  interleaveComma(hostInputs, submitSigStream, [&](auto inType) {
+    auto varName = "in" + std::to_string(i++);
+    failed |= emitArgType(submitSigStream, funcOp.getLoc(), inType, {varName})
+                  .failed();
+  });
+  if (failed)
+    return failure();
+  submitSigStream << ")";
+  os() << submitSignature << "{\n";
+  osi().indent();
+  osi() << "HLT_PROFILE_SCOPE(\"" << kernelName << "_submit\");\n";
+  emitAsyncSubmit();
+  osi().unindent();
+  osi() << "}\n\n";
+
+  std::string awaitTicketSignature;
+  llvm::raw_string_ostream awaitTicketSigStream(awaitTicketSignature);
+  awaitTicketSigStream << "extern \"C\" ";
+  if (emitTypes(awaitTicketSigStream, funcOp.getLoc(),
+                funcOp.getFunctionType().getResults())
+          .failed())
+    return failure();
+  awaitTicketSigStream << " " << funcOp.getName().str() + "_await_ticket"
+                       << "(int64_t ticket)";
+  os() << awaitTicketSignature << "{\n";
+  osi().indent();
+  osi() << "HLT_PROFILE_SCOPE(\"" << kernelName << "_await_ticket\");\n";
+  emitAsyncAwaitTicket();
 
   // End
   osi().unindent();
   osi() << "}\n";
 
-  // Create wrapper header file
-  if (createFile(refOp->getLoc(), funcOp.getName() + ".h").failed())
+  signatures.push_back(callSignature);
+  signatures.push_back(awaitSignature);
+  signatures.push_back(callBatchSignature);
+  signatures.push_back(awaitBatchSignature);
+  signatures.push_back(callTaggedSignature);
+  signatures.push_back(awaitTaggedSignature);
+  signatures.push_back(submitSignature);
+  signatures.push_back(awaitTicketSignature);
+  return success();
+}
+
+LogicalResult BaseWrapper::emitKernelClass(StringRef ns) {
+  Location loc = funcOp.getLoc();
+  // The memories of memref results are only allocated by the call function.
+  if (getMemRefResultArg()) {
+    if (python)
+      return emitError(loc) << "Cannot emit python bindings of a kernel with "
+                               "memref results";
+    return success();
+  }
+  std::string className = funcName().str() + "Kernel";
+  className[0] = llvm::toUpper(className[0]);
+
+  // The call method takes the arguments of the call function, and returns a
+  // future of the value returned by the await function.
+  std::string resultType;
+  llvm::raw_string_ostream resultStream(resultType);
+  if (emitTypes(resultStream, loc, funcOp.getFunctionType().getResults())
+          .failed())
     return failure();
-  osi() << "// This file is generated. Do not modify!\n";
-  // cstdint should be included to support the int#_t types used in the function
-  // arguments.
-  osi() << "#include \"cstdint\"\n";
-  osi() << callSignature << ";\n";
-  osi() << awaitSignature << ";\n";
+  std::string callArgs;
+  llvm::raw_string_ostream callArgsStream(callArgs);
+  int i = 0;
+  bool failed = false;
+  interleaveComma(getHostInputs(), callArgsStream, [&](auto inType) {
+    auto varName = "in" + std::to_string(i++);
+    failed |= emitArgType(callArgsStream, loc, inType, {varName}).failed();
+  });
+  if (failed)
+    return failure();
+  std::string future = "std::future<" + resultStream.str() + ">";
+
+  // The driver is kept behind a pointer to an implementation, since the
+  // simulator types are only defined within the wrapper.
+  std::string decl;
+  llvm::raw_string_ostream declStream(decl);
+  declStream << "// Simulates '" << funcName()
+             << "' on a simulator which each object owns.\n";
+  declStream << "class " << className << " {\n";
+  declStream << "public:\n";
+  declStream << "  // 'instance' identifies the simulator among those of the "
+                "process; see SimDriver.\n";
+  declStream << "  explicit " << className << "(unsigned instance = 0);\n";
+  declStream << "  ~" << className << "();\n";
+  declStream << "  " << className << "(" << className << " &&);\n";
+  declStream << "  " << className << " &operator=(" << className
+             << " &&);\n\n";
+  declStream << "  // Non-blocking. The result is converted once the future is "
+                "retrieved.\n";
+  declStream << "  " << future << " call(" << callArgsStream.str() << ");\n\n";
+  declStream << "private:\n";
+  declStream << "  struct Impl;\n";
+  declStream << "  std::unique_ptr<Impl> impl;\n";
+  declStream << "};\n";
+  classDecls.push_back(declStream.str());
 
+  // The output of each call is popped as soon as the call is pushed, such that
+  // the futures may be retrieved in any order. A pool thus has no pending
+  // outputs to balance its load by, and dispatches the calls round-robin.
+  std::string qualifier = ns.empty() ? std::string() : ns.str() + "::";
+  osi() << "struct " << className << "::Impl {\n";
+  osi() << "  Impl(unsigned instance) : driver(";
+  if (poolSize != 1)
+    osi() << poolSize << ", DispatchPolicy::RoundRobin, ";
+  osi() << "instance) {}\n";
+  osi() << "  " << qualifier << "TKernelDriver driver;\n";
+  osi() << "};\n\n";
+  osi() << className << "::" << className << "(unsigned instance)\n";
+  osi() << "    : impl(std::make_unique<Impl>(instance)) {}\n";
+  osi() << className << "::~" << className << "() = default;\n";
+  osi() << className << "::" << className << "(" << className
+        << " &&) = default;\n";
+  osi() << className << " &" << className << "::operator=(" << className
+        << " &&) = default;\n\n";
+
+  osi() << future << " " << className << "::call(" << callArgs << ") {\n";
+  osi().indent();
+  if (!ns.empty())
+    osi() << "using namespace " << ns << ";\n";
+  osi() << "impl->driver.emplace(";
+  emitInputArgs("");
+  osi() << "); // non-blocking\n";
+  osi() << "auto output = impl->driver.popAsync();\n";
+  osi() << "return std::async(std::launch::deferred,\n";
+  osi() << "                  [output = std::move(output)]() mutable -> "
+        << resultType << " {\n";
+  osi().indent();
+  if (funcOp.getNumResults() == 0) {
+    osi() << "output.get();\n";
+  } else {
+    osi() << "auto result = output.get();\n";
+    osi() << "return ";
+    emitOutput("result");
+    osi() << ";\n";
+  }
+  osi().unindent();
+  osi() << "});\n";
+  osi().unindent();
+  osi() << "}\n\n";
+  if (python)
+    return emitPythonBinding(className, resultType);
+  return success();
+}
+
+LogicalResult BaseWrapper::emitPythonBinding(StringRef className,
+                                             StringRef resultType) {
+  // NumPy has no types of integers wider than 64 bits.
+  Location loc = funcOp.getLoc();
+  auto isBindable = [](Type type) {
+    if (auto memRefType = type.dyn_cast<MemRefType>())
+      type = memRefType.getElementType();
+    return type.isIndex() ||
+           (type.isIntOrFloat() && type.getIntOrFloatBitWidth() <= 64);
+  };
+  SmallVector<Type> hostInputs = getHostInputs();
+  for (Type type : llvm::concat<const Type>(
+           hostInputs, funcOp.getFunctionType().getResults()))
+    if (!isBindable(type))
+      return emitError(loc) << "Cannot emit Python bindings of type " << type;
+
+  // Each memref argument is passed as a NumPy array, from which a memref of
+  // the C type of its elements is derived. The arguments of the batched call
+  // are arrays with an outer dimension of a value (or memref) per call.
+  std::string memrefs;
+  llvm::raw_string_ostream memrefsStream(memrefs);
+  std::string batchMemrefs;
+  llvm::raw_string_ostream batchMemrefsStream(batchMemrefs);
+  std::string params;
+  llvm::raw_string_ostream paramsStream(params);
+  std::string batchParams;
+  llvm::raw_string_ostream batchParamsStream(batchParams);
+  SmallVector<std::string> args, batchArgs, arrays, batchArrays;
+  for (auto it : enumerate(hostInputs)) {
+    std::string in = "in" + std::to_string(it.index());
+    std::string memref = in + "_memref";
+    Type elemType = it.value();
+    unsigned rank = 0;
+    if (auto memRefType = elemType.dyn_cast<MemRefType>()) {
+      elemType = memRefType.getElementType();
+      rank = memRefType.getRank();
+    }
+    std::string elemStr;
+    llvm::raw_string_ostream elemStream(elemStr);
+    if (emitArgType(elemStream, loc, elemType).failed())
+      return failure();
+    auto emitMemRef = [&](llvm::raw_ostream &os, unsigned memrefRank) {
+      os << "      auto " << memref << " = toMemRef<" << elemStream.str()
+         << ", " << memrefRank << ">(" << in << ", \"" << in << "\");\n";
+    };
+    auto memrefArgs = [&](StringRef desc) {
+      std::string str;
+      llvm::raw_string_ostream os(str);
+      os << desc << ".data, " << desc << ".data, 0";
+      for (unsigned d = 0; d < rank; ++d)
+        os << ", " << desc << ".sizes[" << d << "]";
+      for (unsigned d = 0; d < rank; ++d)
+        os << ", " << desc << ".strides[" << d << "]";
+      return os.str();
+    };
+    if (it.index() != 0) {
+      paramsStream << ", ";
+      batchParamsStream << ", ";
+    }
+    batchParamsStream << "py::array " << in;
+    batchArrays.push_back(in);
+    emitMemRef(batchMemrefsStream, rank + 1);
+    if (!it.value().isa<MemRefType>()) {
+      paramsStream << elemStream.str() << " " << in;
+      args.push_back(in);
+      batchArgs.push_back(memref + ".data[i * " + memref + ".strides[0]]");
+      continue;
+    }
+    paramsStream << "py::array " << in;
+    arrays.push_back(in);
+    emitMemRef(memrefsStream, rank);
+    args.push_back(memrefArgs(memref));
+    batchArgs.push_back(memrefArgs(memref + ".slice(i)"));
+  }
+
+  std::string binding;
+  llvm::raw_string_ostream os(binding);
+  std::string call = "PyCall<" + className.str() + ", " + resultType.str() +
+                     ">";
+  os << "  " << call << "::bind(m, \""
+     << className.drop_back(sizeof("Kernel") - 1) << "Call\");\n";
+  os << "  py::class_<" << className << ">(m, \"" << className << "\")\n";
+  os << "    .def(py::init<unsigned>(), py::arg(\"instance\") = 0)\n";
+  os << "    .def(\"call\", [](" << className << " &kernel"
+     << (paramsStream.str().empty() ? "" : ", ") << paramsStream.str()
+     << ") {\n";
+  os << memrefsStream.str();
+  os << "      return " << call << "(kernel.call(";
+  llvm::interleaveComma(args, os);
+  os << "), {";
+  llvm::interleaveComma(arrays, os);
+  os << "});\n";
+  os << "    })";
+  // A batch is sized by the outer dimension of its arguments, so kernels
+  // without arguments are only called one at a time.
+  if (!hostInputs.empty()) {
+    os << "\n    .def(\"call_batch\", [](" << className << " &kernel, "
+       << batchParamsStream.str() << ") {\n";
+    os << batchMemrefsStream.str();
+    os << "      int64_t n = getBatchSize({";
+    llvm::interleaveComma(batchArrays, os);
+    os << "});\n";
+    os << "      py::list calls;\n";
+    os << "      for (int64_t i = 0; i < n; ++i)\n";
+    os << "        calls.append(" << call << "(kernel.call(";
+    llvm::interleaveComma(batchArgs, os);
+    os << "), {";
+    llvm::interleaveComma(batchArrays, os);
+    os << "}));\n";
+    os << "      return calls;\n";
+    os << "    })";
+  }
+  os << ";\n";
+  pyBindings.push_back(os.str());
   return success();
 }
 
 LogicalResult BaseWrapper::emitIOTypes(const TypeEmitter &emitter) {
   auto funcType = funcOp.getFunctionType();
 
-  // Emit in types.
+  // Emit in types. The banks of a partitioned memref are views of the host
+  // memref, and so are of its rank, even if the kernel has flattened them.
   for (auto &inType : enumerate(funcType.getInputs())) {
     osi() << "using TArg" << inType.index() << " = ";
-    if (emitter(osi(), funcOp.getLoc(), inType.value(), {}).failed())
+    Type type = inType.value();
+    if (auto partition = getPartition(inType.index())) {
+      SmallVector<int64_t> bankShape = partition->shape;
+      bankShape[partition->dim] /= partition->factor;
+      type = MemRefType::get(bankShape,
+                             type.cast<MemRefType>().getElementType());
+    } else if (auto vector = getVector(inType.index())) {
+      SmallVector<int64_t> vectorShape = vector->shape;
+      vectorShape.back() /= vector->factor;
+      type = MemRefType::get(vectorShape,
+                             type.cast<MemRefType>().getElementType());
+    }
+    if (emitter(osi(), funcOp.getLoc(), type, {}).failed())
       return failure();
     osi() << ";\n";
   }
@@ -135,51 +930,768 @@ LogicalResult BaseWrapper::emitIOTypes(const TypeEmitter &emitter) {
 }
 
 LogicalResult BaseWrapper::createFile(Location loc, Twine fn) {
-  std::error_code EC;
+  if (failed(closeFile()))
+    return failure();
   SmallString<128> absFn = outDir;
   sys::path::append(absFn, fn);
-  outputFile = std::make_unique<raw_fd_ostream>(absFn, EC, sys::fs::OF_None);
-  if (EC)
-    return emitError(loc) << "Error while opening file";
   outputFilename = absFn.str().str();
+  outputLoc = loc;
+  outputContents.clear();
+  outputFile = std::make_unique<raw_string_ostream>(outputContents);
   outputFileIndented = std::make_unique<raw_indented_ostream>(*outputFile);
   return success();
 }
 
-void BaseWrapper::emitAsyncCall() {
+LogicalResult BaseWrapper::closeFile() {
+  if (!outputFile)
+    return success();
+  outputFileIndented.reset();
+  outputFile->flush();
+  outputFile.reset();
+  return writeOutputFile(*outputLoc, outputFilename, outputContents);
+}
+
+LogicalResult BaseWrapper::writeOutputFile(Location loc, StringRef fn,
+                                           StringRef contents) {
+  outputFiles.push_back(fn.str());
+  // Rewriting an unchanged file would bump its modification time, and with
+  // it rebuild the simulator.
+  if (auto existing = MemoryBuffer::getFile(fn, /*IsText=*/false,
+                                            /*RequiresNullTerminator=*/false))
+    if ((*existing)->getBuffer() == contents)
+      return success();
+
+  std::error_code EC;
+  raw_fd_ostream os(fn, EC, sys::fs::OF_None);
+  if (EC)
+    return emitError(loc) << "Error while opening file '" << fn
+                          << "': " << EC.message();
+  os << contents;
+  return success();
+}
+
+LogicalResult BaseWrapper::emitArgType(llvm::raw_ostream &os, Location loc,
+                                       Type type, Optional<StringRef> varName) {
+  return emitType(os, loc, type, varName);
+}
+
+void BaseWrapper::emitInputArgs(StringRef argSuffix) {
+  // The call signatures are emitted with the TArg types (see emitArgType), so
+  // the arguments are passed through as-is. Memrefs are packed into a
+  // descriptor from the unpacked arguments of the MLIR calling convention (see
+  // emitType). Batched calls only pass the base pointer of each memref, which
+  // is a flat memory of the static shape of the memref, if any. The banks of a
+  // partitioned memref are views of the host memref.
+  SmallVector<Type> hostInputs = getHostInputs();
+  SmallVector<unsigned> hostArgIndices = getHostArgIndices();
+  interleaveComma(
+      enumerate(funcOp.getFunctionType().getInputs()), osi(), [&](auto it) {
+        unsigned hostIdx = hostArgIndices[it.index()];
+        std::string in = "in" + std::to_string(hostIdx);
+        bool converted = isHostConverted(it.value());
+        if (getResultArg(it.index())) {
+          // The memory allocated by the call function.
+          osi() << "result";
+          return;
+        }
+        if (auto scalar = getScalar(it.index())) {
+          // The element is read from the host memref. Batched calls pass a
+          // flat memory of the static shape of the memref.
+          if (!argSuffix.empty()) {
+            osi() << in << argSuffix << "[" << scalar->elem << "]";
+            return;
+          }
+          osi() << in << "_aligned_ptr[" << in << "_offset";
+          int64_t elem = scalar->elem;
+          for (unsigned d = scalar->shape.size(); d-- > 0;) {
+            osi() << " + " << elem % scalar->shape[d] << " * " << in
+                  << "_stride" << d;
+            elem /= scalar->shape[d];
+          }
+          osi() << "]";
+          return;
+        }
+        auto memRefType = it.value().template dyn_cast<MemRefType>();
+        if (!memRefType) {
+          if (converted)
+            osi() << "fromHost<TArg" << it.index() << ">(" << in << argSuffix
+                  << ")";
+          else
+            osi() << in << argSuffix;
+          return;
+        }
+        // Emits a pointer argument of the memref.
+        auto ptr = [&](StringRef name) {
+          if (converted)
+            osi() << "reinterpret_cast<MemoryElement<TArg" << it.index()
+                  << ">::type *>(" << name << ")";
+          else
+            osi() << name;
+        };
+        std::string ptrs = in + argSuffix.str();
+        unsigned rank = hostInputs[hostIdx].cast<MemRefType>().getRank();
+        if (auto vector = getVector(it.index())) {
+          // The host memref is reinterpreted as a memref of wide elements.
+          osi() << "vectorizeMemRef<TArg" << it.index() << ">(";
+          if (!argSuffix.empty()) {
+            osi() << ptrs << ", " << ptrs << ", 0, {";
+            interleaveComma(vector->shape, osi());
+            osi() << "}, {}";
+          } else {
+            osi() << in << ", " << in << "_aligned_ptr, " << in
+                  << "_offset, {";
+            interleaveComma(llvm::iota_range(0U, rank, false), osi(),
+                            [&](unsigned d) { osi() << in << "_size" << d; });
+            osi() << "}, {";
+            interleaveComma(
+                llvm::iota_range(0U, rank, false), osi(),
+                [&](unsigned d) { osi() << in << "_stride" << d; });
+            osi() << "}";
+          }
+          osi() << ", /*factor=*/" << vector->factor << ")";
+          return;
+        }
+        if (auto partition = getPartition(it.index())) {
+          osi() << "partitionMemRef<TArg" << it.index() << ">(";
+          if (!argSuffix.empty()) {
+            ptr(ptrs);
+            osi() << ", ";
+            ptr(ptrs);
+            osi() << ", 0, {";
+          } else {
+            ptr(in);
+            osi() << ", ";
+            ptr(in + "_aligned_ptr");
+            osi() << ", " << in << "_offset, {";
+          }
+          interleaveComma(partition->shape, osi());
+          osi() << "}, {";
+          if (argSuffix.empty())
+            interleaveComma(llvm::iota_range(0U, rank, false), osi(),
+                            [&](unsigned d) { osi() << in << "_stride" << d; });
+          osi() << "}, /*dim=*/" << partition->dim
+                << ", /*factor=*/" << partition->factor
+                << ", /*bank=*/" << partition->bank << ", /*cyclic=*/"
+                << (partition->cyclic ? "true" : "false") << ")";
+          return;
+        }
+        osi() << "TArg" << it.index() << "{";
+        if (!argSuffix.empty()) {
+          ptr(ptrs);
+          osi() << ", ";
+          ptr(ptrs);
+          osi() << ", 0, {";
+          auto hostType = hostInputs[hostIdx].cast<MemRefType>();
+          if (hostType.hasStaticShape()) {
+            if (hostType.getRank() == 0)
+              osi() << "1";
+            else
+              interleaveComma(hostType.getShape(), osi());
+          }
+          osi() << "}, {}}";
+          return;
+        }
+        ptr(in);
+        osi() << ", ";
+        ptr(in + "_aligned_ptr");
+        osi() << ", " << in << "_offset, {";
+        interleaveComma(llvm::iota_range(0U, rank, false), osi(),
+                        [&](unsigned d) { osi() << in << "_size" << d; });
+        osi() << "}, {";
+        interleaveComma(llvm::iota_range(0U, rank, false), osi(),
+                        [&](unsigned d) { osi() << in << "_stride" << d; });
+        osi() << "}}";
+      });
+}
+
+void BaseWrapper::emitResult(StringRef output, unsigned idx) {
+  if (isHostConverted(funcOp.getFunctionType().getResult(idx)))
+    osi() << "toHost(std::get<" << idx << ">(" << output << "))";
+  else
+    osi() << "std::get<" << idx << ">(" << output << ")";
+}
+
+void BaseWrapper::emitOutput(StringRef output) {
+  auto resultTypes = funcOp.getFunctionType().getResults();
+  auto emitValue = [&](unsigned idx) { emitResult(output, idx); };
+  if (resultTypes.size() == 1) {
+    emitValue(0);
+    return;
+  }
+  if (llvm::none_of(resultTypes,
+                    [&](Type type) { return isHostConverted(type); })) {
+    osi() << output;
+    return;
+  }
+  osi() << "{";
+  interleaveComma(llvm::iota_range(0U, unsigned(resultTypes.size()), false),
+                  osi(), emitValue);
+  osi() << "}";
+}
+
+Optional<MemRefPartition> BaseWrapper::getPartition(unsigned idx) {
+  auto attr = funcOp.getArgAttrOfType<DictionaryAttr>(idx, "hlt.partition");
+  if (!attr)
+    return {};
+  auto getInt = [&](StringRef name) {
+    auto intAttr = attr.getAs<IntegerAttr>(name);
+    assert(intAttr && "Expected partition attribute to have integer fields");
+    return intAttr.getInt();
+  };
+  auto kindAttr = attr.getAs<StringAttr>("kind");
+  auto shapeAttr = attr.getAs<ArrayAttr>("shape");
+  assert(kindAttr && shapeAttr &&
+         "Expected partition attribute to have a kind and shape");
+  MemRefPartition partition;
+  partition.arg = getInt("arg");
+  partition.dim = getInt("dim");
+  partition.factor = getInt("factor");
+  partition.bank = getInt("bank");
+  partition.cyclic = kindAttr.getValue() == "cyclic";
+  for (auto dim : shapeAttr.getAsValueRange<IntegerAttr>())
+    partition.shape.push_back(dim.getSExtValue());
+  return partition;
+}
+
+Optional<MemRefVector> BaseWrapper::getVector(unsigned idx) {
+  auto attr = funcOp.getArgAttrOfType<DictionaryAttr>(idx, "hlt.vector");
+  if (!attr)
+    return {};
+  auto factorAttr = attr.getAs<IntegerAttr>("factor");
+  auto shapeAttr = attr.getAs<ArrayAttr>("shape");
+  assert(factorAttr && shapeAttr &&
+         "Expected vector attribute to have a factor and shape");
+  MemRefVector vector;
+  vector.factor = factorAttr.getInt();
+  for (auto dim : shapeAttr.getAsValueRange<IntegerAttr>())
+    vector.shape.push_back(dim.getSExtValue());
+  if (auto elementAttr = attr.getAs<TypeAttr>("element"))
+    vector.element = elementAttr.getValue();
+  return vector;
+}
+
+Optional<MemRefScalar> BaseWrapper::getScalar(unsigned idx) {
+  auto attr = funcOp.getArgAttrOfType<DictionaryAttr>(idx, "hlt.scalar");
+  if (!attr)
+    return {};
+  auto elemAttr = attr.getAs<IntegerAttr>("elem");
+  auto shapeAttr = attr.getAs<ArrayAttr>("shape");
+  assert(elemAttr && shapeAttr &&
+         "Expected scalar attribute to have an element and shape");
+  MemRefScalar scalar;
+  scalar.elem = elemAttr.getInt();
+  for (auto dim : shapeAttr.getAsValueRange<IntegerAttr>())
+    scalar.shape.push_back(dim.getSExtValue());
+  return scalar;
+}
+
+Optional<unsigned> BaseWrapper::getResultArg(unsigned idx) {
+  auto attr = funcOp.getArgAttrOfType<DictionaryAttr>(idx, "hlt.result");
+  if (!attr)
+    return {};
+  auto indexAttr = attr.getAs<IntegerAttr>("index");
+  assert(indexAttr && "Expected result attribute to have an index");
+  return indexAttr.getInt();
+}
+
+Optional<unsigned> BaseWrapper::getMemRefResultArg() {
+  for (unsigned i = 0; i < funcOp.getNumArguments(); ++i)
+    if (getResultArg(i))
+      return i;
+  return {};
+}
+
+SmallVector<Type> BaseWrapper::getHostInputs() {
+  SmallVector<Type> hostInputs;
+  for (auto it : enumerate(funcOp.getFunctionType().getInputs())) {
+    if (getResultArg(it.index()))
+      continue;
+    if (auto scalar = getScalar(it.index())) {
+      if (scalar->elem == 0)
+        hostInputs.push_back(MemRefType::get(scalar->shape, it.value()));
+      continue;
+    }
+    if (auto vector = getVector(it.index())) {
+      Type hostElemType = vector->element;
+      if (!hostElemType) {
+        auto elemType = it.value().cast<MemRefType>().getElementType();
+        hostElemType = IntegerType::get(
+            funcOp.getContext(),
+            elemType.getIntOrFloatBitWidth() / vector->factor);
+      }
+      hostInputs.push_back(MemRefType::get(vector->shape, hostElemType));
+      continue;
+    }
+    auto partition = getPartition(it.index());
+    if (!partition) {
+      hostInputs.push_back(it.value());
+      continue;
+    }
+    if (partition->bank != 0)
+      continue;
+
+    // The host memref is flattened if the kernel has been.
+    auto bankType = it.value().cast<MemRefType>();
+    SmallVector<int64_t> shape = partition->shape;
+    if (bankType.getRank() != static_cast<int64_t>(shape.size()))
+      shape = {bankType.getNumElements() * partition->factor};
+    hostInputs.push_back(MemRefType::get(shape, bankType.getElementType()));
+  }
+  return hostInputs;
+}
+
+SmallVector<unsigned> BaseWrapper::getHostArgIndices() {
+  SmallVector<unsigned> indices;
+  unsigned hostIdx = 0;
+  for (unsigned i = 0; i < funcOp.getNumArguments(); ++i) {
+    auto partition = getPartition(i);
+    auto scalar = getScalar(i);
+    if (i != 0 && !(partition && partition->bank != 0) &&
+        !(scalar && scalar->elem != 0))
+      ++hostIdx;
+    assert((!partition || partition->arg == hostIdx) &&
+           "Expected the banks of a partitioned memref to be consecutive");
+    indices.push_back(hostIdx);
+  }
+  return indices;
+}
+
+/// Returns the number of bytes of each element of type 'type' of a host
+/// memref, as laid out by the C type of the element (see emitType).
+static int64_t getHostElementBytes(Type type) {
+  if (type.isIndex())
+    return IndexType::kInternalStorageBitWidth / 8;
+  unsigned width = type.getIntOrFloatBitWidth();
+  if (width > 128)
+    return width / 8;
+  return std::max<int64_t>(llvm::PowerOf2Ceil(width) / 8, 1);
+}
+
+bool BaseWrapper::canReplay() {
+  // Records hold no memories of memref results.
+  if (getMemRefResultArg())
+    return false;
+  return llvm::all_of(getHostInputs(), [](Type type) {
+    auto memRefType = type.dyn_cast<MemRefType>();
+    return !memRefType || memRefType.hasStaticShape();
+  });
+}
+
+void BaseWrapper::emitRecordInputs() {
+  if (!canReplay())
+    return;
+  osi() << "if (recorder) {\n";
+  for (auto it : enumerate(getHostInputs())) {
+    std::string in = "in" + std::to_string(it.index());
+    auto memRefType = it.value().dyn_cast<MemRefType>();
+    if (!memRefType) {
+      osi() << "  recorder->recordInput(" << in << ");\n";
+      continue;
+    }
+    osi() << "  recorder->recordMemory(" << in << "_aligned_ptr, " << in
+          << "_offset, " << getHostElementBytes(memRefType.getElementType())
+          << ", " << memRefType.getNumElements() << ");\n";
+  }
+  osi() << "  recorder->issue();\n";
+  osi() << "}\n";
+}
+
+void BaseWrapper::emitRecordOutputs(StringRef output) {
+  if (!canReplay())
+    return;
+  osi() << "if (recorder) {\n";
+  for (unsigned i = 0; i < funcOp.getNumResults(); ++i) {
+    osi() << "  recorder->recordResult(";
+    emitResult(output, i);
+    osi() << ");\n";
+  }
+  osi() << "  recorder->complete();\n";
+  osi() << "}\n";
+}
+
+LogicalResult BaseWrapper::emitReplay() {
+  // Emit the entry point which replays a record file against the kernel (see
+  // SimRecord.h). The inputs of each call are passed as those of a batch of a
+  // single call, from the fields of the record, and its outputs are compared
+  // to the remaining fields.
+  std::string kernelName = funcOp.getName().str();
+  osi() << "extern \"C\" int64_t " << kernelName
+        << "_replay(const char *path) {\n";
+  osi().indent();
+  if (!canReplay()) {
+    osi() << "std::cerr << \"Calls of '" << kernelName
+          << "' cannot be replayed, since it has dynamically shaped memref "
+             "arguments, or memref results\\n\";\n";
+    osi() << "return -1;\n";
+    osi().unindent();
+    osi() << "}\n\n";
+    return success();
+  }
+
+  SmallVector<Type> hostInputs = getHostInputs();
+  unsigned numMemories = llvm::count_if(
+      hostInputs, [](Type type) { return type.isa<MemRefType>(); });
   osi() << "if (driver == nullptr)\n";
   osi() << "  init_sim();\n";
+  osi() << "SimReplayer replayer(path);\n";
+  osi() << "int64_t calls = 0, mismatches = 0;\n";
+  osi() << "const int64_t i = 0;\n";
+  osi() << "while (!replayer.atEnd()) {\n";
+  osi().indent();
+  osi() << "replayer.begin("
+        << hostInputs.size() + funcOp.getNumResults() + numMemories << ");\n";
+  for (auto it : enumerate(hostInputs)) {
+    std::string in = "in" + std::to_string(it.index());
+    auto memRefType = it.value().dyn_cast<MemRefType>();
+    if (!memRefType) {
+      osi() << "auto *" << in << " = replayer.next<";
+      if (emitArgType(osi(), funcOp.getLoc(), it.value()).failed())
+        return failure();
+      osi() << ">();\n";
+      continue;
+    }
+    // Elements without a C type are passed through untyped pointers, as in
+    // emitType.
+    Type elemType = memRefType.getElementType();
+    std::string elemStr;
+    llvm::raw_string_ostream elemStream(elemStr);
+    if (elemType.isa<IntegerType>() && elemType.getIntOrFloatBitWidth() > 128)
+      elemStream << "void";
+    else if (emitArgType(elemStream, funcOp.getLoc(), elemType).failed())
+      return failure();
+    int64_t bytes =
+        getHostElementBytes(elemType) * memRefType.getNumElements();
+    osi() << elemStream.str() << " *" << in << "_data = replayer.next<"
+          << elemStream.str() << ">(" << bytes << ");\n";
+    osi() << "auto *" << in << " = &" << in << "_data;\n";
+  }
 
-  // Pack arguments
-  osi() << "TInput input;\n";
-  for (auto arg : llvm::enumerate(funcOp.getFunctionType().getInputs())) {
-    // Reinterpret/static cast here is just a hack around software interface
-    // providing i.e. int32_t* as pointer type, and verilator using uint32_t*.
-    // Should obviously be fixed so we don't throw away type safety.
-    bool isPtr = arg.value().isa<MemRefType>();
+  // Simulators built with HLT_STREAM_CHECK check the outputs of the call as
+  // they are produced. Its recorded outputs are read ahead of the call, and
+  // read again once it has returned. Stores are only checked for memories
+  // which the kernel accesses in place, in the layout of the host.
+  osi() << "#if HLT_STREAM_CHECK\n";
+  osi() << "size_t outputsPos = replayer.position();\n";
+  osi() << "auto expected = std::make_shared<SimExpectation<TOutput>>();\n";
+  for (unsigned i = 0; i < funcOp.getNumResults(); ++i) {
+    std::string elem =
+        "std::tuple_element_t<" + std::to_string(i) + ", TOutput>";
+    osi() << "std::get<" << i << ">(expected->output) = ";
+    if (isHostConverted(funcOp.getFunctionType().getResult(i)))
+      osi() << "fromHost<" << elem
+            << ">(*replayer.next<unsigned __int128>());\n";
+    else
+      osi() << "*replayer.next<" << elem << ">();\n";
+  }
+  osi() << "expected->memories.resize(std::tuple_size_v<TInput>);\n";
+  SmallVector<unsigned> hostArgIndices = getHostArgIndices();
+  DenseMap<unsigned, unsigned> kernelArgs;
+  for (auto it : enumerate(funcOp.getFunctionType().getInputs())) {
+    auto memRefType = it.value().dyn_cast<MemRefType>();
+    if (memRefType && !isHostConverted(memRefType) &&
+        !getPartition(it.index()) && !getScalar(it.index()) &&
+        !getResultArg(it.index()))
+      kernelArgs[hostArgIndices[it.index()]] = it.index();
+  }
+  for (auto it : enumerate(hostInputs)) {
+    auto memRefType = it.value().dyn_cast<MemRefType>();
+    if (!memRefType)
+      continue;
+    int64_t bytes = getHostElementBytes(memRefType.getElementType()) *
+                    memRefType.getNumElements();
+    auto kernelArg = kernelArgs.find(it.index());
+    if (kernelArg == kernelArgs.end()) {
+      osi() << "replayer.next(" << bytes << ");\n";
+      continue;
+    }
+    osi() << "expected->memories[" << kernelArg->second
+          << "] = replayer.next(" << bytes << ");\n";
+  }
+  osi() << "replayer.rewind(outputsPos);\n";
+  osi() << "driver->emplaceExpected(std::move(expected), ";
+  emitInputArgs("[i]");
+  osi() << ");\n";
+  osi() << "#else\n";
+  osi() << "driver->emplace(";
+  emitInputArgs("[i]");
+  osi() << ");\n";
+  osi() << "#endif\n";
+  if (funcOp.getNumResults() != 0)
+    osi() << "TOutput output = driver->pop();\n";
+  else
+    osi() << "driver->pop();\n";
+  osi() << "bool match = true;\n";
+  for (unsigned i = 0; i < funcOp.getNumResults(); ++i) {
+    osi() << "match &= replayer.matches(";
+    emitResult("output", i);
+    osi() << ");\n";
+  }
+  for (auto it : enumerate(hostInputs)) {
+    auto memRefType = it.value().dyn_cast<MemRefType>();
+    if (!memRefType)
+      continue;
+    osi() << "match &= replayer.matches(in" << it.index() << "_data, "
+          << getHostElementBytes(memRefType.getElementType()) *
+                 memRefType.getNumElements()
+          << ");\n";
+  }
+  osi() << "if (!match) {\n";
+  osi() << "  std::cerr << \"Call \" << calls << \" of '" << kernelName
+        << "' does not match its record\\n\";\n";
+  osi() << "  ++mismatches;\n";
+  osi() << "}\n";
+  osi() << "++calls;\n";
+  osi().unindent();
+  osi() << "}\n";
+  osi() << "std::cerr << \"Replayed \" << calls << \" calls of '" << kernelName
+        << "', \" << mismatches << \" of which mismatch\\n\";\n";
+  osi() << "return mismatches;\n";
+  osi().unindent();
+  osi() << "}\n\n";
+  return success();
+}
+
+LogicalResult BaseWrapper::emitStream() {
+  // Emit the entry point which streams the calls of an input stream through
+  // the kernel, and their outputs to an output stream (see SimStream.h).
+  // Calls are issued as those of a batch of a single call, as in emitReplay,
+  // until 'depth' calls are in flight, after which the oldest call is awaited
+  // before issuing the next.
+  std::string kernelName = funcOp.getName().str();
+  std::string signature;
+  llvm::raw_string_ostream sigStream(signature);
+  sigStream << "extern \"C\" int64_t " << kernelName
+            << "_stream(const char *inPath, const char *outPath, "
+               "int64_t depth)";
+  signatures.push_back(sigStream.str());
+  osi() << sigStream.str() << " {\n";
+  osi().indent();
+  SmallVector<Type> hostInputs = getHostInputs();
+  if (!canReplay() || hostInputs.empty()) {
+    osi() << "std::cerr << \"Calls of '" << kernelName
+          << "' cannot be streamed, since it has no arguments, dynamically "
+             "shaped memref arguments, or memref results\\n\";\n";
+    osi() << "return -1;\n";
+    osi().unindent();
+    osi() << "}\n\n";
+    return success();
+  }
 
-    osi() << "std::get<" << arg.index() << ">(input) = ";
-    osi() << (isPtr ? "reinterpret_cast" : "static_cast");
-    osi() << "<TArg" << arg.index() << ">(in" << arg.index() << ");\n";
+  // The C type of each scalar input and memory element, and the bytes of each
+  // memory.
+  SmallVector<std::string> types;
+  SmallVector<int64_t> bytes;
+  for (Type type : hostInputs) {
+    auto memRefType = type.dyn_cast<MemRefType>();
+    Type elemType = memRefType ? memRefType.getElementType() : type;
+    std::string typeStr;
+    llvm::raw_string_ostream typeStream(typeStr);
+    // Elements without a C type are passed through untyped pointers, as in
+    // emitType.
+    if (memRefType && elemType.isa<IntegerType>() &&
+        elemType.getIntOrFloatBitWidth() > 128)
+      typeStream << "void";
+    else if (emitArgType(typeStream, funcOp.getLoc(), elemType).failed())
+      return failure();
+    types.push_back(typeStream.str());
+    bytes.push_back(memRefType ? getHostElementBytes(elemType) *
+                                     memRefType.getNumElements()
+                               : 0);
   }
 
-  // Push to driver
-  osi() << "driver->push(input); // non-blocking\n";
+  osi() << "if (driver == nullptr)\n";
+  osi() << "  init_sim();\n";
+  osi() << "size_t callBytes = 0;\n";
+  for (auto it : enumerate(hostInputs)) {
+    std::string field = it.value().isa<MemRefType>()
+                            ? std::to_string(bytes[it.index()])
+                            : "sizeof(" + types[it.index()] + ")";
+    osi() << "callBytes += " << field << " + recordPadding(" << field
+          << ");\n";
+  }
+  osi() << "SimStreamReader reader(inPath, callBytes);\n";
+  osi() << "SimStreamWriter writer(outPath);\n";
+  osi() << "// The memories of each call in flight, which are written after "
+           "its results.\n";
+  osi() << "std::deque<std::vector<std::pair<const void *, size_t>>> "
+           "inFlight;\n";
+  osi() << "auto await = [&]() {\n";
+  osi().indent();
+  if (funcOp.getNumResults() != 0)
+    osi() << "TOutput output = driver->pop();\n";
+  else
+    osi() << "driver->pop();\n";
+  for (unsigned i = 0; i < funcOp.getNumResults(); ++i) {
+    osi() << "writer.write(";
+    emitResult("output", i);
+    osi() << ");\n";
+  }
+  osi() << "for (auto &memory : inFlight.front())\n";
+  osi() << "  writer.write(memory.first, memory.second);\n";
+  osi() << "inFlight.pop_front();\n";
+  osi().unindent();
+  osi() << "};\n";
+  osi() << "const int64_t i = 0;\n";
+  osi() << "for (size_t call = 0; call < reader.size(); ++call) {\n";
+  osi().indent();
+  osi() << "if (depth > 0 && static_cast<int64_t>(inFlight.size()) >= depth)\n";
+  osi() << "  await();\n";
+  osi() << "reader.begin(call);\n";
+  osi() << "std::vector<std::pair<const void *, size_t>> memories;\n";
+  for (auto it : enumerate(hostInputs)) {
+    std::string in = "in" + std::to_string(it.index());
+    const std::string &type = types[it.index()];
+    if (!it.value().isa<MemRefType>()) {
+      osi() << "auto *" << in << " = reader.next<" << type << ">();\n";
+      continue;
+    }
+    osi() << type << " *" << in << "_data = reader.next<" << type << ">("
+          << bytes[it.index()] << ");\n";
+    osi() << "auto *" << in << " = &" << in << "_data;\n";
+    osi() << "memories.push_back({" << in << "_data, " << bytes[it.index()]
+          << "});\n";
+  }
+  osi() << "driver->emplace(";
+  emitInputArgs("[i]");
+  osi() << ");\n";
+  osi() << "inFlight.push_back(std::move(memories));\n";
+  osi().unindent();
+  osi() << "}\n";
+  osi() << "while (!inFlight.empty())\n";
+  osi() << "  await();\n";
+  osi() << "return reader.size();\n";
+  osi().unindent();
+  osi() << "}\n\n";
+  return success();
+}
+
+void BaseWrapper::emitAsyncCall() {
+  osi() << "if (driver == nullptr)\n";
+  osi() << "  init_sim();\n";
+  emitRecordInputs();
+  if (auto resultArg = getMemRefResultArg()) {
+    auto resultType =
+        funcOp.getArgument(*resultArg).getType().cast<MemRefType>();
+    std::string argType = "TArg" + std::to_string(*resultArg);
+    osi() << "auto result = allocateMemRef<" << argType << ">({";
+    interleaveComma(resultType.getShape(), osi());
+    osi() << "});\n";
+    osi() << "results.push_back(result);\n";
+  }
+
+  // Construct the input in place within the driver's input queue.
+  osi() << "driver->emplace(";
+  emitInputArgs("");
+  osi() << "); // non-blocking\n";
+}
+
+void BaseWrapper::emitAsyncCallBatch() {
+  osi() << "if (driver == nullptr)\n";
+  osi() << "  init_sim();\n";
+
+  // Pack arguments
+  osi() << "std::vector<TInput> inputs;\n";
+  osi() << "inputs.reserve(n);\n";
+  osi() << "for (int64_t i = 0; i < n; ++i)\n";
+  osi() << "  inputs.emplace_back(";
+  emitInputArgs("[i]");
+  osi() << ");\n";
+
+  // Move all inputs to the driver at once.
+  osi() << "driver->pushBatch(std::move(inputs)); // non-blocking\n";
 }
 
 void BaseWrapper::emitAsyncAwait() {
+  if (auto resultArg = getMemRefResultArg()) {
+    // The memory of the result has been written once the output is popped.
+    osi() << "driver->pop(); // blocking\n";
+    osi() << "auto result = results.front();\n";
+    osi() << "results.pop_front();\n";
+    auto resultType =
+        funcOp.getArgument(*resultArg).getType().cast<MemRefType>();
+    osi() << "return castMemRef<MemRefDescriptor<";
+    (void)emitType(osi(), funcOp.getLoc(), resultType.getElementType());
+    osi() << ", " << resultType.getRank() << ">>(result);\n";
+    return;
+  }
   osi() << "TOutput output = driver->pop(); // blocking\n";
+  emitRecordOutputs("output");
   switch (funcOp.getNumResults()) {
   case 0: {
     osi() << "return;\n";
     break;
   }
-  case 1: {
-    osi() << "return std::get<0>(output);\n";
+  default: {
+    osi() << "return ";
+    emitOutput("output");
+    osi() << ";\n";
     break;
   }
+  }
+}
+
+void BaseWrapper::emitAsyncCallTagged() {
+  osi() << "if (driver == nullptr)\n";
+  osi() << "  init_sim();\n";
+  osi() << "driver->emplaceTagged(tag, ";
+  emitInputArgs("");
+  osi() << "); // non-blocking\n";
+}
+
+void BaseWrapper::emitAsyncAwaitTagged() {
+  osi() << "auto [outputTag, output] = driver->popTagged(); // blocking\n";
+  osi() << "tag_aligned_ptr[tag_offset] = outputTag;\n";
+  switch (funcOp.getNumResults()) {
+  case 0: {
+    osi() << "return;\n";
+    break;
+  }
+  default: {
+    osi() << "return ";
+    emitOutput("output");
+    osi() << ";\n";
+    break;
+  }
+  }
+}
+
+void BaseWrapper::emitAsyncSubmit() {
+  osi() << "std::call_once(driverOnce, []() {\n";
+  osi() << "  if (driver == nullptr)\n";
+  osi() << "    init_sim();\n";
+  osi() << "});\n";
+  osi() << "return driver->submit(";
+  emitInputArgs("");
+  osi() << "); // blocking while the input window is full\n";
+}
+
+void BaseWrapper::emitAsyncAwaitTicket() {
+  osi() << "TOutput output = driver->awaitTicket(ticket); // blocking\n";
+  switch (funcOp.getNumResults()) {
+  case 0: {
+    osi() << "return;\n";
+    break;
+  }
+  default: {
+    osi() << "return ";
+    emitOutput("output");
+    osi() << ";\n";
+    break;
+  }
+  }
+}
+
+void BaseWrapper::emitAsyncAwaitBatch() {
+  osi() << "std::vector<TOutput> outputs(n);\n";
+  osi() << "driver->popBatch(outputs.data(), n); // blocking\n";
+  switch (funcOp.getNumResults()) {
+  case 0:
+    break;
   default: {
-    osi() << "return output;\n";
+    osi() << "for (int64_t i = 0; i < n; ++i)\n";
+    osi() << "  out[i] = ";
+    emitOutput("outputs[i]");
+    osi() << ";\n";
     break;
   }
   }
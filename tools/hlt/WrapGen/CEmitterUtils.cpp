@@ -89,13 +89,24 @@ LogicalResult emitType(llvm::raw_ostream &os, Location loc, Type type,
     // %arg2: i64              // Offset.
     // %arg3: i64              // Size in dim 0.
     // %arg4: i64              // Stride in dim 0.
-    assert(memRefType.getRank() == 1 &&
-           "Only unidimensional memories supported.. for now");
+    // For multidimensional memrefs, the sizes of all dimensions are followed by
+    // the strides of all dimensions.
 
     os << "\n";
+    // Integers without a C type, which are wider than 128 bits, are accessed
+    // through untyped pointers.
+    auto emitElementType = [&]() {
+      auto elemType = memRefType.getElementType().dyn_cast<IntegerType>();
+      if (elemType && elemType.getWidth() > 128) {
+        os << "void";
+        return success();
+      }
+      return emitType(os, loc, memRefType.getElementType());
+    };
+
     // Allocated pointer. If we've been provided with a variable name, this wil
     // be the named variable.
-    if (emitType(os, loc, memRefType.getElementType()).failed())
+    if (emitElementType().failed())
       return failure();
     os << "* ";
     if (variable)
@@ -103,20 +114,27 @@ LogicalResult emitType(llvm::raw_ostream &os, Location loc, Type type,
     os << ", ";
 
     // Aligned pointer
-    if (emitType(os, loc, memRefType.getElementType()).failed())
+    if (emitElementType().failed())
       return failure();
     os << "* ";
     if (variable)
       os << *variable << "_aligned_ptr";
     os << ", ";
 
-    // Offset, size and stride
+    // Offset, and the sizes and strides of each dimension
+    unsigned rank = memRefType.getRank();
     if (variable) {
-      os << "int64_t " << *variable << "_offset, ";
-      os << "int64_t " << *variable << "_size, ";
-      os << "int64_t " << *variable << "_stride";
-    } else
-      os << "int64_t, int64_t, int64_t\n";
+      os << "int64_t " << *variable << "_offset";
+      for (unsigned d = 0; d < rank; ++d)
+        os << ", int64_t " << *variable << "_size" << d;
+      for (unsigned d = 0; d < rank; ++d)
+        os << ", int64_t " << *variable << "_stride" << d;
+    } else {
+      os << "int64_t";
+      for (unsigned d = 0; d < 2 * rank; ++d)
+        os << ", int64_t";
+      os << "\n";
+    }
     return success();
   } else if (auto iType = type.dyn_cast<IntegerType>()) {
     switch (iType.getWidth()) {
@@ -133,6 +151,13 @@ LogicalResult emitType(llvm::raw_ostream &os, Location loc, Type type,
         (os << "int" << iType.getWidth() << "_t");
       break;
     }
+    case 128: {
+      if (shouldMapToUnsigned(iType.getSignedness()))
+        (os << "unsigned __int128");
+      else
+        (os << "__int128");
+      break;
+    }
     default:
       return emitError(loc, "cannot emit integer type ") << type;
     }
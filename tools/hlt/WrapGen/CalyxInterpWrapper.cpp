@@ -0,0 +1,186 @@
+//===- CalyxInterpWrapper.cpp - Calyx interpreter wrapper -----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the implementation of the CalyxInterpWrapper class, an
+// HLT wrapper for wrapping calyx.component based kernels, simulated by the
+// Calyx interpreter. The simulator describes the ports of the component, from
+// which CalyxInterpSimInterface emits a harness program for each call. This
+// avoids lowering the kernel to RTL and verilating it, at the cost of cycle
+// counts, which are not reported.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt-hls/Tools/hlt/WrapGen/calyx/CalyxInterpWrapper.h"
+#include "circt-hls/Tools/hlt/WrapGen/VerilatorEmitterUtils.h"
+
+using namespace llvm;
+using namespace mlir;
+using namespace circt;
+
+namespace circt_hls {
+
+LogicalResult CalyxInterpWrapper::init(Operation *refOp,
+                                       Operation * /*kernelOp*/) {
+  // The Calyx program of the component is interpreted directly, so there is
+  // no kernel operation.
+  compOp = dyn_cast<calyx::ComponentOp>(refOp);
+  if (!compOp)
+    return refOp->emitOpError()
+           << "expected reference operation to be a calyx.component operation.";
+  return success();
+}
+
+// Verifies that values of 'type' can be passed to the interpreter.
+static LogicalResult verifyInterpType(Location loc, Type type) {
+  if (auto memref = type.dyn_cast<MemRefType>()) {
+    // The memories of the harness are std_mem_d1 through std_mem_d4.
+    if (memref.getRank() < 1 || memref.getRank() > 4)
+      return emitError(loc) << "Calyx interpreter memories must be of rank 1 "
+                               "to 4, got "
+                            << type;
+    type = memref.getElementType();
+  }
+  if (type.isa<IntegerType>() && type.getIntOrFloatBitWidth() > 64)
+    return emitError(loc) << "Calyx kernels with values wider than 64 bits "
+                             "are unhandled for now";
+  return success();
+}
+
+LogicalResult CalyxInterpWrapper::emitArgType(llvm::raw_ostream &os,
+                                              Location loc, Type type,
+                                              Optional<StringRef> varName) {
+  if (verifyInterpType(loc, type).failed())
+    return failure();
+  // Values are passed to the simulator as unsigned integers, like those of the
+  // Verilator wrapper, such that a simulator of either kind may be linked
+  // against the same testbench.
+  return emitType(os, loc, getVerilatorSignedness(type), varName);
+}
+
+// Emits the TArg and TRes types of the simulator. These are the unsigned C
+// types of emitArgType, and memref descriptors of memref arguments.
+static LogicalResult emitInterpType(llvm::raw_ostream &os, Location loc,
+                                    Type type, Optional<StringRef> varName) {
+  type = getVerilatorSignedness(type);
+  if (auto memref = type.dyn_cast<MemRefType>()) {
+    os << "MemRefDescriptor<";
+    if (emitType(os, loc, memref.getElementType()).failed())
+      return failure();
+    os << ", " << memref.getRank() << ">";
+    return success();
+  }
+  return emitType(os, loc, type, varName);
+}
+
+SmallVector<std::string> CalyxInterpWrapper::getIncludes() {
+  SmallVector<std::string> includes;
+  includes.push_back(
+      "circt-hls/Tools/hlt/Simulator/CalyxInterpSimInterface.h");
+  includes.push_back("circt-hls/Tools/hlt/Simulator/SimDriver.h");
+  includes.push_back("cstdint");
+  return includes;
+}
+
+LogicalResult CalyxInterpWrapper::emitPreamble(Operation * /*kernelOp*/) {
+  auto funcType = funcOp.getFunctionType();
+  for (Type type :
+       llvm::concat<const Type>(funcType.getInputs(), funcType.getResults()))
+    if (verifyInterpType(funcOp.getLoc(), type).failed())
+      return failure();
+
+  if (emitIOTypes(emitInterpType).failed())
+    return failure();
+
+  osi() << "using " << funcName()
+        << "SimInterface = CalyxInterpSimInterface<TInput, TOutput>;\n\n";
+
+  // Emit simulator.
+  if (emitSimulator().failed())
+    return failure();
+
+  // Emit simulator driver type.
+  osi() << "using TSim = " << funcName() << "Sim;\n";
+  return success();
+}
+
+void CalyxInterpWrapper::emitPort(unsigned idx, bool isInput) {
+  calyx::PortInfo info = isInput ? compOp.getInputPortInfo()[idx]
+                                  : compOp.getOutputPortInfo()[idx];
+  osi() << "{\"" << info.name.getValue() << "\", "
+        << info.type.getIntOrFloatBitWidth() << "}";
+}
+
+LogicalResult CalyxInterpWrapper::emitSimulator() {
+  std::string program =
+      calyxProgram.empty() ? (funcName() + ".futil").str() : calyxProgram;
+
+  osi() << "class " << funcName() << "Sim : public " << funcName()
+        << "SimInterface {\n";
+  osi() << "public:\n";
+  osi().indent();
+
+  osi() << funcName() << "Sim() : " << funcName() << "SimInterface(\""
+        << program << "\", \"" << compOp.getName() << "\") {\n";
+  osi().indent();
+
+  // We expect equivalence between the order of function arguments and the
+  // ports of the Calyx component; see CalyxVerilatorWrapper.
+  unsigned calyxInPortIdx = 0;
+  unsigned calyxOutPortIdx = 0;
+  osi() << "// --- Software interface\n";
+  osi() << "// - Input ports\n";
+  for (auto arg : funcOp.getArguments()) {
+    auto memrefType = arg.getType().dyn_cast<MemRefType>();
+    if (!memrefType) {
+      osi() << "addScalarArg(";
+      emitPort(calyxInPortIdx++, true);
+      osi() << ");\n";
+      continue;
+    }
+
+    osi() << "addMemoryArg({/*width=*/"
+          << memrefType.getElementTypeBitWidth() << ", /*shape=*/{";
+    llvm::interleaveComma(memrefType.getShape(), osi());
+    osi() << "},\n";
+    osi().indent();
+    osi() << "/*readData=*/";
+    emitPort(calyxInPortIdx++, true);
+    osi() << ",\n/*done=*/";
+    emitPort(calyxInPortIdx++, true);
+    osi() << ",\n/*writeData=*/";
+    emitPort(calyxOutPortIdx++, false);
+    unsigned addrPortIdx = calyxOutPortIdx;
+    calyxOutPortIdx += memrefType.getRank();
+    osi() << ",\n/*writeEn=*/";
+    emitPort(calyxOutPortIdx++, false);
+    osi() << ",\n/*addrs=*/{";
+    for (int64_t i = 0; i < memrefType.getRank(); ++i) {
+      if (i != 0)
+        osi() << ", ";
+      emitPort(addrPortIdx + i, false);
+    }
+    osi() << "}});\n";
+    osi().unindent();
+  }
+
+  osi() << "\n// - Output ports\n";
+  for (unsigned i = 0; i < funcOp.getNumResults(); ++i) {
+    osi() << "addResult(";
+    emitPort(calyxOutPortIdx++, false);
+    osi() << ");\n";
+  }
+
+  osi().unindent();
+  osi() << "};\n";
+
+  osi().unindent();
+  osi() << "};\n\n";
+  return success();
+}
+
+} // namespace circt_hls
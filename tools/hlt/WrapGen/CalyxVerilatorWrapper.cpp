@@ -21,6 +21,10 @@ using namespace circt;
 
 namespace circt_hls {
 
+// Attribute of a static component which holds its latency, in cycles, as
+// inferred by the Calyx compiler.
+static constexpr StringLiteral kStaticLatencyAttr = "static";
+
 struct GroundPort : public PortMapping {
   GroundPort(calyx::ComponentOp component, unsigned idx, bool isInput)
       : PortMapping(component), idx(idx), isInput(isInput) {}
@@ -135,6 +139,9 @@ void CalyxVerilatorWrapper::generateIOPortMapping() {
   // of the calyx component.
   unsigned calyxInPortIdx = 0;
   unsigned calyxOutPortIdx = 0;
+  // Clear the mapping of any previously wrapped kernel.
+  inputMapping.clear();
+  outputMapping.clear();
   // Input ports
   for (auto it : llvm::enumerate(funcOp.getArguments())) {
     if (auto memrefType = it.value().getType().dyn_cast<MemRefType>()) {
@@ -169,9 +176,29 @@ void CalyxVerilatorWrapper::generateIOPortMapping() {
   }
 }
 
+LogicalResult
+CalyxVerilatorWrapper::emitArgType(llvm::raw_ostream &os, Location loc,
+                                   Type type, Optional<StringRef> varName) {
+  // Calyx ports are scalar Verilator signals.
+  Type valueType = type;
+  if (auto memref = type.dyn_cast<MemRefType>())
+    valueType = memref.getElementType();
+  if (valueType.isa<IntegerType>() && valueType.getIntOrFloatBitWidth() > 64)
+    return emitError(loc) << "Calyx kernels with values wider than 64 bits "
+                             "are unhandled for now";
+
+  // Verilator ports are unsigned; see getVerilatorSignedness.
+  return emitType(os, loc, getVerilatorSignedness(type), varName);
+}
+
 SmallVector<std::string> CalyxVerilatorWrapper::getIncludes() {
   SmallVector<std::string> includes;
-  includes.push_back(("V" + funcName() + ".h").str());
+  if (arcilator)
+    includes.push_back((funcName() + "_arc.h").str());
+  else
+    includes.push_back(("V" + funcName() + ".h").str());
+  if (arcilator)
+    includes.push_back("circt-hls/Tools/hlt/Simulator/ArcSimInterface.h");
   includes.push_back("circt-hls/Tools/hlt/Simulator/CalyxSimInterface.h");
   includes.push_back("circt-hls/Tools/hlt/Simulator/SimDriver.h");
   includes.push_back("cstdint");
@@ -179,14 +206,22 @@ SmallVector<std::string> CalyxVerilatorWrapper::getIncludes() {
 }
 
 LogicalResult CalyxVerilatorWrapper::emitPreamble(Operation *kernelOp) {
+  if (arcilator) {
+    auto funcType = funcOp.getFunctionType();
+    for (Type type : llvm::concat<const Type>(funcType.getInputs(),
+                                              funcType.getResults()))
+      if (verifyArcilatorType(funcOp.getLoc(), type).failed())
+        return failure();
+  }
+
   if (emitIOTypes(emitVerilatorType).failed())
     return failure();
 
-  // Emit model type.
-  osi() << "using TModel = V" << funcName() << ";\n";
+  // Emit model type. Arcilator models are named after the kernel module.
+  osi() << "using TModel = " << (arcilator ? "" : "V") << funcName() << ";\n";
   osi() << "using " << funcName()
-        << "SimInterface = CalyxSimInterface<TInput, TOutput, "
-           "TModel>;\n\n";
+        << "SimInterface = CalyxSimInterface<TInput, TOutput, TModel"
+        << (arcilator ? ", ArcSimInterface" : "") << ">;\n\n";
 
   // Emit simulator.
   if (emitSimulator().failed())
@@ -220,8 +255,13 @@ LogicalResult CalyxVerilatorWrapper::emitSimulator() {
   auto outCtrlName = getResName(funcOp.getNumResults());
   osi() << "// --- Calyx interface\n";
   osi() << "go = std::make_shared<CalyxInPort<CData>>(&dut->go);\n";
-  osi() << "done = std::make_shared<CalyxInPort<CData>>(&dut->done);";
-  osi() << "\n\n";
+  osi() << "done = std::make_shared<CalyxInPort<CData>>(&dut->done);\n";
+  // The harness skips the cycles of an invocation of a static component
+  // before 'done' is due.
+  if (auto latency = compOp->getAttrOfType<IntegerAttr>(kStaticLatencyAttr))
+    osi() << "setStaticLatency(" << latency.getValue().getZExtValue()
+          << ");\n";
+  osi() << "\n";
 
   // We expect equivalence between the order of function arguments and the ports
   // of the Calyx component.
@@ -0,0 +1,522 @@
+//===- HandshakeNativeWrapper.cpp - Native handshake wrapper --------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the implementation of the HandshakeNativeWrapper class,
+// an HLT wrapper for wrapping handshake.funcOp based kernels, simulated by a
+// C++ dataflow model of the handshake function. Each operation of the function
+// is emitted as a node of HandshakeNativeSimInterface, and each SSA value as a
+// channel between two nodes. This avoids lowering the kernel to RTL and
+// verilating it, at the cost of cycle counts which only approximate those of
+// the RTL.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt-hls/Tools/hlt/WrapGen/handshake/HandshakeNativeWrapper.h"
+#include "circt-hls/Tools/hlt/WrapGen/handshake/HandshakeVerilatorWrapper.h"
+#include "circt-hls/Tools/hlt/WrapGen/VerilatorEmitterUtils.h"
+
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/IR/AsmState.h"
+#include "llvm/ADT/TypeSwitch.h"
+
+#include <algorithm>
+
+using namespace llvm;
+using namespace mlir;
+using namespace circt;
+
+namespace circt_hls {
+
+LogicalResult HandshakeNativeWrapper::init(Operation *refOp,
+                                           Operation * /*kernelOp*/) {
+  // The handshake function is simulated directly, so there is no kernel
+  // operation.
+  auto hsRefOp = dyn_cast<handshake::FuncOp>(refOp);
+  if (!hsRefOp)
+    return refOp->emitOpError()
+           << "expected reference operation to be a handshake.func operation.";
+  hsOp = hsRefOp;
+  return success();
+}
+
+LogicalResult
+HandshakeNativeWrapper::emitArgType(llvm::raw_ostream &os, Location loc,
+                                    Type type, Optional<StringRef> varName) {
+  // Values are passed to the simulator as unsigned integers, like those of the
+  // Verilator wrapper, such that a simulator of either kind may be linked
+  // against the same testbench.
+  return emitType(os, loc, getVerilatorSignedness(type), varName);
+}
+
+// Emits the TArg and TRes types of the simulator. These are the unsigned C
+// types of emitArgType, and memref descriptors of memref arguments.
+static LogicalResult emitNativeType(llvm::raw_ostream &os, Location loc,
+                                    Type type, Optional<StringRef> varName) {
+  type = getVerilatorSignedness(type);
+  if (auto memref = type.dyn_cast<MemRefType>()) {
+    os << "MemRefDescriptor<";
+    if (emitType(os, loc, memref.getElementType()).failed())
+      return failure();
+    os << ", " << std::max<int64_t>(memref.getRank(), 1) << ">";
+    return success();
+  }
+  return emitType(os, loc, type, varName);
+}
+
+SmallVector<std::string> HandshakeNativeWrapper::getIncludes() {
+  SmallVector<std::string> includes;
+  includes.push_back(
+      "circt-hls/Tools/hlt/Simulator/HandshakeNativeSimInterface.h");
+  includes.push_back("circt-hls/Tools/hlt/Simulator/SimDriver.h");
+  includes.push_back("cstdint");
+  return includes;
+}
+
+LogicalResult HandshakeNativeWrapper::emitPreamble(Operation * /*kernelOp*/) {
+  if (emitIOTypes(emitNativeType).failed())
+    return failure();
+
+  osi() << "using " << funcName()
+        << "SimInterface = HandshakeNativeSimInterface<TInput, TOutput>;\n\n";
+
+  // Emit simulator.
+  if (emitSimulator().failed())
+    return failure();
+
+  // Emit simulator driver type.
+  osi() << "using TSim = " << funcName() << "Sim;\n";
+  return success();
+}
+
+std::string HandshakeNativeWrapper::ch(Value v) {
+  return "ch(" + std::to_string(channelIds.lookup(v)) + ")";
+}
+
+std::string HandshakeNativeWrapper::chs(ValueRange values) {
+  std::string str = "Channels{";
+  llvm::raw_string_ostream ss(str);
+  interleaveComma(values, ss, [&](Value v) { ss << ch(v); });
+  ss << "}";
+  return ss.str();
+}
+
+// Returns the number of bits of the tokens of a value of type 'type'.
+static FailureOr<unsigned> getTokenWidth(Location loc, Type type) {
+  if (type.isa<NoneType>())
+    return 0U;
+  if (type.isa<IndexType>())
+    return IndexType::kInternalStorageBitWidth;
+  if (auto intType = type.dyn_cast<IntegerType>()) {
+    if (intType.getWidth() > 64)
+      return emitError(loc)
+             << "Integers wider than 64 bits are unhandled for now";
+    return intType.getWidth();
+  }
+  return emitError(loc) << "cannot simulate values of type " << type
+                        << " natively";
+}
+
+// Returns the C++ expression, in terms of the operand tokens 'v', which
+// computes the result of an arithmetic operation. Fails if 'op' is not an
+// arithmetic operation known to the native simulator.
+static FailureOr<std::string> getOpExpression(Operation *op) {
+  auto unsupported = [&]() -> FailureOr<std::string> {
+    return op->emitOpError()
+           << "is not supported by the native handshake simulator";
+  };
+  if (op->getNumResults() != 1)
+    return unsupported();
+
+  // Widths of the result and of the first operand.
+  auto w = getTokenWidth(op->getLoc(), op->getResult(0).getType());
+  if (failed(w))
+    return failure();
+  FailureOr<unsigned> inW = 0U;
+  if (op->getNumOperands() != 0)
+    inW = getTokenWidth(op->getLoc(), op->getOperand(0).getType());
+  if (failed(inW))
+    return failure();
+  std::string ws = std::to_string(*w);
+  std::string inWs = std::to_string(*inW);
+
+  auto binary = [&](const std::string &fn) {
+    return fn + "(v[0], v[1], " + ws + ")";
+  };
+  auto signedCmp = [&](const std::string &cmp) {
+    return "signExtend(v[0], " + inWs + ") " + cmp + " signExtend(v[1], " +
+           inWs + ")";
+  };
+
+  return llvm::TypeSwitch<Operation *, FailureOr<std::string>>(op)
+      .Case<handshake::BranchOp>([&](auto) { return std::string("v[0]"); })
+      .Case<handshake::ConstantOp>([&](auto) -> FailureOr<std::string> {
+        auto value = op->getAttrOfType<IntegerAttr>("value");
+        if (!value)
+          return op->emitOpError()
+                 << "only integer constants can be simulated natively";
+        return "Token(" + std::to_string(value.getValue().getZExtValue()) +
+               "ULL)";
+      })
+      .Case<arith::AddIOp>(
+          [&](auto) { return "truncate(v[0] + v[1], " + ws + ")"; })
+      .Case<arith::SubIOp>(
+          [&](auto) { return "truncate(v[0] - v[1], " + ws + ")"; })
+      .Case<arith::MulIOp>(
+          [&](auto) { return "truncate(v[0] * v[1], " + ws + ")"; })
+      .Case<arith::AndIOp>([&](auto) { return std::string("v[0] & v[1]"); })
+      .Case<arith::OrIOp>([&](auto) { return std::string("v[0] | v[1]"); })
+      .Case<arith::XOrIOp>([&](auto) { return std::string("v[0] ^ v[1]"); })
+      .Case<arith::DivSIOp>([&](auto) { return binary("divSigned"); })
+      .Case<arith::DivUIOp>([&](auto) { return binary("divUnsigned"); })
+      .Case<arith::RemSIOp>([&](auto) { return binary("remSigned"); })
+      .Case<arith::RemUIOp>([&](auto) { return binary("remUnsigned"); })
+      .Case<arith::ShLIOp>([&](auto) { return binary("shiftLeft"); })
+      .Case<arith::ShRUIOp>([&](auto) { return binary("shiftRightUnsigned"); })
+      .Case<arith::ShRSIOp>([&](auto) { return binary("shiftRightSigned"); })
+      .Case<arith::SelectOp>(
+          [&](auto) { return std::string("v[0] ? v[1] : v[2]"); })
+      .Case<arith::ExtSIOp, arith::IndexCastOp>([&](auto) {
+        return "truncate(signExtend(v[0], " + inWs + "), " + ws + ")";
+      })
+      .Case<arith::ExtUIOp>([&](auto) { return std::string("v[0]"); })
+      .Case<arith::TruncIOp>(
+          [&](auto) { return "truncate(v[0], " + ws + ")"; })
+      .Case<arith::CmpIOp>([&](arith::CmpIOp cmpOp) -> std::string {
+        switch (cmpOp.getPredicate()) {
+        case arith::CmpIPredicate::eq:
+          return "v[0] == v[1]";
+        case arith::CmpIPredicate::ne:
+          return "v[0] != v[1]";
+        case arith::CmpIPredicate::slt:
+          return signedCmp("<");
+        case arith::CmpIPredicate::sle:
+          return signedCmp("<=");
+        case arith::CmpIPredicate::sgt:
+          return signedCmp(">");
+        case arith::CmpIPredicate::sge:
+          return signedCmp(">=");
+        case arith::CmpIPredicate::ult:
+          return "v[0] < v[1]";
+        case arith::CmpIPredicate::ule:
+          return "v[0] <= v[1]";
+        case arith::CmpIPredicate::ugt:
+          return "v[0] > v[1]";
+        case arith::CmpIPredicate::uge:
+          return "v[0] >= v[1]";
+        }
+        llvm_unreachable("Unexpected cmpi predicate");
+      })
+      .Default([&](auto) { return unsupported(); });
+}
+
+LogicalResult HandshakeNativeWrapper::emitMemory(Operation *op,
+                                                 MemRefType type,
+                                                 ValueRange inputs,
+                                                 unsigned ldCount,
+                                                 unsigned stCount,
+                                                 Optional<unsigned> arg) {
+  // Memories are addressed by the row-major (flattened) index of the memref;
+  // the simulator maps this onto the strides of the host memory.
+  if (!type.hasStaticShape())
+    return op->emitOpError() << "only statically sized memories can be "
+                                "simulated natively";
+
+  // The operands of a memory are the data and address of each store port,
+  // followed by the address of each load port. Its results are the data of
+  // each load port, followed by the done signals of each store and load port.
+  SmallVector<Value> stData, stAddr;
+  for (unsigned i = 0; i < stCount; ++i) {
+    stData.push_back(inputs[2 * i]);
+    stAddr.push_back(inputs[2 * i + 1]);
+  }
+  auto ldAddr = inputs.drop_front(2 * stCount);
+  auto results = op->getResults();
+  auto ldData = results.take_front(ldCount);
+  auto stDone = results.drop_front(ldCount).take_front(stCount);
+  auto ldDone = results.drop_front(ldCount + stCount);
+
+  // The load latency and initiation interval are specified as for the
+  // Verilator simulator. As there, the initiation interval only applies to
+  // loads of a memory with a latency.
+  unsigned latency = 0, initiationInterval = 1;
+  if (auto attr = op->getAttrOfType<IntegerAttr>(kMemLatencyAttr)) {
+    if (attr.getInt() < 0)
+      return op->emitOpError()
+             << "expected '" << kMemLatencyAttr << "' to be non-negative";
+    latency = attr.getInt();
+  }
+  if (auto attr = op->getAttrOfType<IntegerAttr>(kMemIIAttr)) {
+    if (attr.getInt() < 1)
+      return op->emitOpError()
+             << "expected '" << kMemIIAttr << "' to be at least 1";
+    if (latency != 0)
+      initiationInterval = attr.getInt();
+  }
+
+  std::string memType = "Memory<";
+  llvm::raw_string_ostream ss(memType);
+  if (emitType(ss, op->getLoc(), getVerilatorSignedness(type.getElementType()))
+          .failed())
+    return failure();
+  ss << ">";
+  std::string name = "mem" + std::to_string(memories.size());
+  std::string memName = arg ? "arg" + std::to_string(*arg) : name;
+  memories.push_back({ss.str(), name});
+  if (arg)
+    argMemories[*arg] = name;
+
+  osi() << name << " = addNode<" << memType << ">(\"" << memName
+        << "\", /*size=*/" << type.getNumElements() << ", /*latency=*/"
+        << latency << ", /*initiationInterval=*/" << initiationInterval
+        << ",\n";
+  osi().indent();
+  osi() << chs(ldAddr) << ", " << chs(ldData) << ", " << chs(ldDone) << ",\n";
+  osi() << chs(stAddr) << ", " << chs(stData) << ", " << chs(stDone) << ");\n";
+  osi().unindent();
+  if (!arg)
+    osi() << name << "->allocate();\n";
+  else if (llvm::is_contained(mappedArgs, *arg))
+    osi() << name << "->mapFileFromEnv(" << *arg << ");\n";
+  return success();
+}
+
+LogicalResult HandshakeNativeWrapper::emitNode(Operation *op) {
+  auto operands = op->getOperands();
+  auto results = op->getResults();
+  return llvm::TypeSwitch<Operation *, LogicalResult>(op)
+      .Case<handshake::ForkOp, handshake::LazyForkOp>([&](auto) {
+        osi() << "addNode<Fork>(" << ch(operands[0]) << ", " << chs(results)
+              << ");\n";
+        return success();
+      })
+      .Case<handshake::JoinOp>([&](auto) {
+        osi() << "addNode<Join>(" << chs(operands) << ", " << ch(results[0])
+              << ");\n";
+        return success();
+      })
+      .Case<handshake::SyncOp>([&](auto) {
+        osi() << "addNode<Sync>(" << chs(operands) << ", " << chs(results)
+              << ");\n";
+        return success();
+      })
+      .Case<handshake::MergeOp>([&](auto) {
+        osi() << "addNode<Merge>(" << chs(operands) << ", " << ch(results[0])
+              << ");\n";
+        return success();
+      })
+      .Case<handshake::ControlMergeOp>([&](auto) {
+        osi() << "addNode<ControlMerge>(" << chs(operands) << ", "
+              << ch(results[0]) << ", " << ch(results[1]) << ");\n";
+        return success();
+      })
+      .Case<handshake::MuxOp>([&](auto) {
+        osi() << "addNode<Mux>(" << ch(operands[0]) << ", "
+              << chs(operands.drop_front()) << ", " << ch(results[0])
+              << ");\n";
+        return success();
+      })
+      .Case<handshake::ConditionalBranchOp>([&](auto) {
+        osi() << "addNode<ConditionalBranch>(" << ch(operands[0]) << ", "
+              << ch(operands[1]) << ", " << ch(results[0]) << ", "
+              << ch(results[1]) << ");\n";
+        return success();
+      })
+      .Case<handshake::SinkOp>([&](auto) {
+        osi() << "addNode<Sink>(" << ch(operands[0]) << ");\n";
+        return success();
+      })
+      .Case<handshake::SourceOp>([&](auto) {
+        osi() << "addNode<Source>(" << ch(results[0]) << ");\n";
+        return success();
+      })
+      .Case<handshake::BufferOp>([&](handshake::BufferOp bufferOp) {
+        osi() << "addNode<Buffer>(" << ch(operands[0]) << ", "
+              << ch(results[0]) << ", /*slots=*/" << bufferOp.getNumSlots()
+              << ", /*sequential=*/"
+              << (bufferOp.getBufferType() == handshake::BufferTypeEnum::seq
+                      ? "true"
+                      : "false");
+        if (auto init = op->getAttrOfType<ArrayAttr>("initValues")) {
+          osi() << ", std::vector<Token>{";
+          interleaveComma(init, osi(), [&](Attribute attr) {
+            osi() << attr.cast<IntegerAttr>().getValue().getZExtValue()
+                  << "ULL";
+          });
+          osi() << "}";
+        }
+        osi() << ");\n";
+        return success();
+      })
+      .Case<handshake::LoadOp>([&](auto) {
+        // Operands: addresses, data from memory, control. Results: data,
+        // addresses to memory.
+        unsigned numAddr = operands.size() - 2;
+        osi() << "addNode<Load>(" << chs(operands.take_front(numAddr)) << ", "
+              << ch(operands[numAddr + 1]) << ", " << chs(results.drop_front())
+              << ", " << ch(operands[numAddr]) << ", " << ch(results[0])
+              << ");\n";
+        return success();
+      })
+      .Case<handshake::StoreOp>([&](auto) {
+        // Operands: addresses, data, control. Results: data and addresses to
+        // memory.
+        unsigned numAddr = operands.size() - 2;
+        osi() << "addNode<Store>(" << chs(operands.take_front(numAddr)) << ", "
+              << ch(operands[numAddr]) << ", " << ch(operands[numAddr + 1])
+              << ", " << chs(results.drop_front()) << ", " << ch(results[0])
+              << ");\n";
+        return success();
+      })
+      .Case<handshake::ExternalMemoryOp>(
+          [&](handshake::ExternalMemoryOp extMemOp) -> LogicalResult {
+            auto arg = operands[0].dyn_cast<BlockArgument>();
+            if (!arg)
+              return extMemOp.emitOpError()
+                     << "expected the memref to be an argument of the "
+                        "function";
+            return emitMemory(op, operands[0].getType().cast<MemRefType>(),
+                              operands.drop_front(), extMemOp.getLdCount(),
+                              extMemOp.getStCount(), arg.getArgNumber());
+          })
+      .Case<handshake::MemoryOp>([&](handshake::MemoryOp memOp) {
+        return emitMemory(op, memOp.getMemRefType(), operands,
+                          memOp.getLdCount(), memOp.getStCount(), llvm::None);
+      })
+      .Default([&](auto) -> LogicalResult {
+        // Otherwise, the operation is a function of its operands.
+        auto expr = getOpExpression(op);
+        if (failed(expr))
+          return failure();
+        osi() << "addOp<" << operands.size() << ">({";
+        interleaveComma(operands, osi(), [&](Value v) { osi() << ch(v); });
+        osi() << "}, " << ch(results[0]) << ",\n";
+        osi().indent();
+        osi() << "[](const Token *" << (operands.empty() ? "" : "v")
+              << ") -> Token { return " << *expr << "; });\n";
+        osi().unindent();
+        return success();
+      });
+}
+
+LogicalResult HandshakeNativeWrapper::emitSimulator() {
+  if (hsOp.isExternal())
+    return hsOp.emitOpError() << "cannot simulate an external function";
+  Block &body = hsOp.getBody().front();
+  unsigned numArgs = funcOp.getNumArguments();
+  if (body.getNumArguments() != numArgs + 1)
+    return hsOp.emitOpError()
+           << "expected the handshake function to have a control argument in "
+              "addition to the " << numArgs << " arguments of the kernel";
+  auto returnOp = cast<handshake::ReturnOp>(body.getTerminator());
+
+  // Assign a channel to each value of the function. Every value must have a
+  // single consumer.
+  channelIds.clear();
+  memories.clear();
+  argMemories.clear();
+  SmallVector<Value> values;
+  for (auto arg : body.getArguments())
+    if (!arg.getType().isa<MemRefType>())
+      values.push_back(arg);
+  for (auto &op : body.without_terminator())
+    llvm::append_range(values, op.getResults());
+  for (auto value : values) {
+    if (!value.hasOneUse())
+      return emitError(value.getLoc())
+             << "expected value to have a single use; forks and sinks must be "
+                "materialized for the handshake function to be simulated";
+    unsigned id = channelIds.size();
+    channelIds[value] = id;
+  }
+
+  osi() << "class " << funcName() << "Sim : public " << funcName()
+        << "SimInterface {\n";
+  osi() << "public:\n";
+  osi().indent();
+
+  osi() << funcName() << "Sim() {\n";
+  osi().indent();
+
+  // Channels are named by the values they model.
+  AsmState asmState(hsOp);
+  osi() << "addChannels({";
+  interleaveComma(values, osi(), [&](Value v) {
+    osi() << "\"";
+    v.printAsOperand(osi(), asmState);
+    osi() << "\"";
+  });
+  osi() << "});\n\n";
+
+  osi() << "// --- Software interface\n";
+  for (auto arg : body.getArguments())
+    if (!arg.getType().isa<MemRefType>())
+      osi() << "addInput(" << ch(arg) << ");\n";
+  for (auto res : returnOp.getOperands())
+    osi() << "addOutput(" << ch(res) << ");\n";
+
+  osi() << "\n// --- Operations\n";
+  for (auto &op : body.without_terminator()) {
+    osi() << "// " << op.getName() << "\n";
+    if (emitNode(&op).failed())
+      return failure();
+  }
+  osi().unindent();
+  osi() << "}\n\n";
+
+  // Push the arguments to their channels, and point the external memories to
+  // the memories of the memref arguments.
+  osi() << "void pushInput(const TInput &input) override {\n";
+  osi().indent();
+  for (unsigned i = 0; i < numArgs; ++i) {
+    auto arg = body.getArgument(i);
+    if (!arg.getType().isa<MemRefType>()) {
+      osi() << ch(arg) << "->push(std::get<" << i << ">(input));\n";
+      continue;
+    }
+    auto it = argMemories.find(i);
+    if (it == argMemories.end())
+      return hsOp.emitOpError() << "expected memref argument " << i
+                                << " to be used by a handshake.extmemory";
+    osi() << it->second << "->setMemory(std::get<" << i << ">(input));\n";
+  }
+  osi() << ch(body.getArgument(numArgs)) << "->push(0);\n";
+  osi().unindent();
+  osi() << "}\n\n";
+
+  // Pop the results from their channels, along with the output control.
+  unsigned numResults = funcOp.getNumResults();
+  if (returnOp.getNumOperands() != numResults + 1)
+    return returnOp.emitOpError()
+           << "expected a control result in addition to the " << numResults
+           << " results of the kernel";
+  osi() << "TOutput popOutput() override {\n";
+  osi().indent();
+  osi() << "TOutput output{";
+  interleaveComma(llvm::seq(0U, numResults), osi(), [&](unsigned i) {
+    osi() << "static_cast<TRes" << i << ">("
+          << ch(returnOp.getOperand(i)) << "->pop())";
+  });
+  osi() << "};\n";
+  osi() << ch(returnOp.getOperand(numResults)) << "->pop();\n";
+  osi() << "return output;\n";
+  osi().unindent();
+  osi() << "}\n";
+
+  if (!memories.empty()) {
+    osi().unindent();
+    osi() << "\nprivate:\n";
+    osi().indent();
+    for (auto &[type, name] : memories)
+      osi() << type << " *" << name << ";\n";
+  }
+  osi().unindent();
+  osi() << "};\n\n";
+  return success();
+}
+
+} // namespace circt_hls
@@ -15,6 +15,9 @@
 #include "circt-hls/Tools/hlt/WrapGen/handshake/HandshakeVerilatorWrapper.h"
 #include "circt-hls/Tools/hlt/WrapGen/VerilatorEmitterUtils.h"
 
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSwitch.h"
+
 using namespace llvm;
 using namespace mlir;
 using namespace circt;
@@ -41,10 +44,42 @@ LogicalResult HandshakeVerilatorWrapper::init(Operation *refOp,
   return success();
 }
 
+LogicalResult
+HandshakeVerilatorWrapper::emitArgType(llvm::raw_ostream &os, Location loc,
+                                       Type type, Optional<StringRef> varName) {
+  // Elements of memories wider than 64 bits are accessed in place as the
+  // words of their VlWide signals, which must match the layout of the host
+  // memory.
+  if (auto memref = type.dyn_cast<MemRefType>()) {
+    auto elemType = memref.getElementType().dyn_cast<IntegerType>();
+    if (elemType && elemType.getWidth() > 64 && elemType.getWidth() % 128 != 0)
+      return emitError(loc) << "elements of memories wider than 64 bits must "
+                               "be a multiple of 128 bits wide";
+  }
+
+  // Verilator ports are unsigned; see getVerilatorSignedness.
+  return emitType(os, loc, getVerilatorSignedness(type), varName);
+}
+
+bool HandshakeVerilatorWrapper::isHostConverted(Type type) {
+  // Integers wider than 64 bits are VlWide signals.
+  if (auto memref = type.dyn_cast<MemRefType>())
+    type = memref.getElementType();
+  auto intType = type.dyn_cast<IntegerType>();
+  return intType && intType.getWidth() > 64;
+}
+
 SmallVector<std::string> HandshakeVerilatorWrapper::getIncludes() {
   SmallVector<std::string> includes;
-  includes.push_back(("V" + funcName() + ".h").str());
+  if (arcilator)
+    includes.push_back((funcName() + "_arc.h").str());
+  else
+    includes.push_back(("V" + funcName() + ".h").str());
+  if (arcilator)
+    includes.push_back("circt-hls/Tools/hlt/Simulator/ArcSimInterface.h");
   includes.push_back("circt-hls/Tools/hlt/Simulator/HandshakeSimInterface.h");
+  if (dpiMemories)
+    includes.push_back("circt-hls/Tools/hlt/Simulator/HandshakeDpiMemory.h");
   includes.push_back("circt-hls/Tools/hlt/Simulator/SimDriver.h");
   includes.push_back("cstdint");
   return includes;
@@ -56,17 +91,48 @@ LogicalResult HandshakeVerilatorWrapper::emitPreamble(Operation *kernelOp) {
     return kernelOp->emitOpError() << "Expected a FIRRTL module of the "
                                       "handshake kernel that is to be wrapped";
 
+  if (arcilator) {
+    // Arcilator models are compiled from the kernel alone; memories are
+    // served by the harness.
+    if (dpiMemories)
+      return funcOp.emitError() << "memories cannot be served through DPI-C "
+                                   "by arcilator models";
+    auto funcType = funcOp.getFunctionType();
+    for (Type type : llvm::concat<const Type>(funcType.getInputs(),
+                                              funcType.getResults()))
+      if (verifyArcilatorType(funcOp.getLoc(), type).failed())
+        return failure();
+  }
+
   if (emitIOTypes(emitVerilatorType).failed())
     return failure();
 
-  // Emit model type.
-  osi() << "using TModel = V" << funcName() << ";\n";
-  osi() << "using " << funcName()
-        << "SimInterface = HandshakeSimInterface<TInput, TOutput, "
-           "TModel>;\n\n";
+  // Emit model type. Arcilator models are named after the kernel module.
+  firrtlOp = handshakeFirMod;
+  if (dpiMemories && emitDpiAdapter().failed())
+    return failure();
+  osi() << "using TModel = " << (arcilator ? "" : "V") << funcName() << ";\n";
+  std::string staticPortsType = "void";
+  if (staticPorts) {
+    if (emitStaticPortTypes().failed())
+      return failure();
+    staticPortsType = "HandshakeStaticPorts<TInPorts, TOutPorts>";
+  }
+  if (arcilator) {
+    osi() << "using " << funcName()
+          << "SimInterface = HandshakeSimInterface<TInput, TOutput, TModel, "
+          << staticPortsType << ", ArcSimInterface>;\n\n";
+  } else if (staticPorts) {
+    osi() << "using " << funcName()
+          << "SimInterface = HandshakeSimInterface<TInput, TOutput, TModel, "
+          << staticPortsType << ">;\n\n";
+  } else {
+    osi() << "using " << funcName()
+          << "SimInterface = HandshakeSimInterface<TInput, TOutput, "
+             "TModel>;\n\n";
+  }
 
   // Emit simulator.
-  firrtlOp = handshakeFirMod;
   if (emitSimulator().failed())
     return failure();
 
@@ -93,6 +159,63 @@ unsigned HandshakeVerilatorWrapper::inCtrlIdx() {
   return funcOp.getNumArguments();
 }
 
+LogicalResult HandshakeVerilatorWrapper::emitStaticPortTypes() {
+  auto funcType = funcOp.getFunctionType();
+  osi() << "using TInPorts = std::tuple<";
+  for (auto &input : enumerate(funcType.getInputs())) {
+    if (input.index() != 0)
+      osi() << ", ";
+    if (emitInputPortType(osi(), input.value(), input.index()).failed())
+      return failure();
+  }
+  osi() << ">;\n";
+
+  osi() << "using TOutPorts = std::tuple<";
+  for (auto &res : enumerate(funcType.getResults())) {
+    if (res.index() != 0)
+      osi() << ", ";
+    emitOutputPortType(osi(), res.index());
+  }
+  osi() << ">;\n";
+  return success();
+}
+
+// String attributes on handshake.memory operations naming the $readmemh-style
+// image which the memory is initialized from at reset, and the file which the
+// memory is written to when the simulation finishes; see
+// VerilatorMemoryImages.h. Relative paths are relative to the directory of the
+// simulation.
+static constexpr StringLiteral kMemInitAttr = "hlt.init";
+static constexpr StringLiteral kMemDumpAttr = "hlt.dump";
+
+LogicalResult HandshakeVerilatorWrapper::emitMemoryImages() {
+  bool first = true;
+  for (auto memOp : hsOp.getBody().getOps<handshake::MemoryOp>()) {
+    auto init = memOp->getAttrOfType<StringAttr>(kMemInitAttr);
+    auto dump = memOp->getAttrOfType<StringAttr>(kMemDumpAttr);
+    if (!init && !dump)
+      continue;
+    // The memory is found within the instance that the op is lowered to,
+    // named after the op and its 'handshake_id'.
+    auto idAttr = memOp->getAttrOfType<IntegerAttr>("handshake_id");
+    if (!idAttr)
+      return memOp.emitOpError()
+             << "requires a 'handshake_id' to be initialized or written out "
+                "by the simulator; run -handshake-add-ids first.";
+    if (arcilator)
+      return memOp.emitOpError()
+             << "cannot be initialized or written out by the simulator of an "
+                "arcilator model.";
+    if (first)
+      osi() << "\n// - Memory images\n";
+    first = false;
+    osi() << "addMemoryImage(\"handshake_memory" << idAttr.getInt() << "\", \""
+          << (init ? init.getValue() : "") << "\", \""
+          << (dump ? dump.getValue() : "") << "\");\n";
+  }
+  return success();
+}
+
 LogicalResult HandshakeVerilatorWrapper::emitSimulator() {
   osi() << "class " << funcName() << "Sim : public " << funcName()
         << "SimInterface {\n";
@@ -131,14 +254,61 @@ LogicalResult HandshakeVerilatorWrapper::emitSimulator() {
     if (emitOutputPort(res.value(), res.index()).failed())
       return failure();
   }
+  if (emitMemoryImages().failed())
+    return failure();
+  if (dpiMemories) {
+    osi() << "\n// - Memories served by the model through DPI-C\n";
+    osi() << "dut->hlt_memories = "
+             "reinterpret_cast<uint64_t>(&dpiMemoryList);\n";
+  }
   osi().unindent();
   osi() << "};\n";
 
+  if (dpiMemories) {
+    osi().unindent();
+    osi() << "\nprivate:\n";
+    osi().indent();
+    osi() << "// Memories accessed by the model through DPI-C, in the order of "
+             "their\n// memory indices.\n";
+    osi() << "DpiMemories dpiMemoryList;\n";
+  }
+
   osi().unindent();
   osi() << "};\n\n";
   return success();
 }
 
+// Attributes on handshake.extmemory operations specifying the banking of the
+// simulated memory: the number of banks, the number of ports per bank, and the
+// address interleaving ("cyclic" or "block").
+static constexpr StringLiteral kMemBanksAttr = "hlt.banks";
+static constexpr StringLiteral kMemBankPortsAttr = "hlt.bank_ports";
+static constexpr StringLiteral kMemBankInterleavingAttr =
+    "hlt.bank_interleaving";
+
+// Dictionary attribute on handshake.extmemory operations which places a cache
+// in front of the simulated memory. Recognized keys are "size", "line" (both
+// in bytes), "associativity", "policy" ("lru", "fifo" or "random"),
+// "hit_latency" and "miss_latency" (both in cycles). Omitted keys use the
+// CacheConfig defaults.
+static constexpr StringLiteral kMemCacheAttr = "hlt.cache";
+
+// Dictionary attribute on handshake.extmemory operations which places an AXI4
+// master between the kernel and the simulated memory. Recognized keys are
+// "beat_bytes", "burst" (in beats), "outstanding", "read_latency" and
+// "write_latency" (both in cycles). Omitted keys use the AxiConfig defaults.
+static constexpr StringLiteral kMemAxiAttr = "hlt.axi";
+
+// Dictionary attribute on handshake.extmemory operations which streams the
+// simulated memory through an AXI-Stream channel, as for --stream-args.
+// Recognized keys are "beat_bytes", "interval" (in cycles) and "depth" (in
+// elements). Omitted keys use the HLT_STREAM_ARG_* defaults.
+static constexpr StringLiteral kMemAxisAttr = "hlt.axis";
+
+// Unit attribute on memref arguments of the kernel function which are
+// streamed, as for --stream-args (see -affine-infer-streams).
+static constexpr StringLiteral kStreamAttr = "hlt.stream";
+
 static raw_indented_ostream &emitHSPortCtor(raw_indented_ostream &os,
                                             StringRef prefix,
                                             bool hasData = true) {
@@ -159,12 +329,7 @@ static raw_indented_ostream &emitHSTypeAssert(raw_indented_ostream &os,
   return os;
 }
 
-LogicalResult HandshakeVerilatorWrapper::emitExtMemPort(MemRefType memref,
-                                                        unsigned idx) {
-  auto shape = memref.getShape();
-  assert(shape.size() == 1 && "Only support unidimensional memories");
-  std::string name = getInputName(idx);
-
+unsigned HandshakeVerilatorWrapper::getMemAddrWidth(unsigned idx) {
   // Find any ldAddr#/stAddr# bundle within the memory port
   auto bundleType = firrtlOp.getPortType(idx).cast<firrtl::BundleType>();
   unsigned addrWidth = 0;
@@ -174,21 +339,237 @@ LogicalResult HandshakeVerilatorWrapper::emitExtMemPort(MemRefType memref,
       addrWidth = getBundleDataWidth(sig.type.cast<firrtl::BundleType>());
   }
   assert(addrWidth > 0 && "Found no address signal in memory bundle!");
+  return addrWidth;
+}
 
-  osi() << "auto " << name << " = addInputPort<HandshakeMemoryInterface<";
-  if (emitVerilatorType(osi(), hsOp.getLoc(), memref.getElementType()).failed())
-    return failure();
-  osi() << ", ";
-  if (emitVerilatorTypeFromWidth(osi(), hsOp.getLoc(), addrWidth).failed())
-    return failure();
-  osi() << ">>(/*size=*/" << shape.front() << ");\n";
-
-  // Locate the external memory operation referencing the input
+handshake::ExternalMemoryOp
+HandshakeVerilatorWrapper::getExtMemOp(unsigned idx) {
   auto extMemUsers = hsOp.getArgument(idx).getUsers();
   assert(std::distance(extMemUsers.begin(), extMemUsers.end()) == 1 &&
          "expected exactly 1 user of a memref input argument");
-  handshake::ExternalMemoryOp extMemOp =
-      cast<handshake::ExternalMemoryOp>(*extMemUsers.begin());
+  return cast<handshake::ExternalMemoryOp>(*extMemUsers.begin());
+}
+
+bool HandshakeVerilatorWrapper::isStreamArg(unsigned idx) {
+  return llvm::is_contained(streamArgs, idx) ||
+         funcOp.getArgAttr(idx, kStreamAttr);
+}
+
+bool HandshakeVerilatorWrapper::isDpiMemory(unsigned idx) {
+  if (!dpiMemories ||
+      !funcOp.getFunctionType().getInput(idx).isa<MemRefType>() ||
+      isStreamArg(idx))
+    return false;
+
+  // The adapter answers loads in the next cycle, and has no notion of banks
+  // or caches; such memories are simulated by the harness.
+  auto extMemOp = getExtMemOp(idx);
+  for (StringRef attr : {kMemLatencyAttr, kMemIIAttr, kMemBanksAttr,
+                         kMemCacheAttr, kMemAxiAttr, kMemAxisAttr})
+    if (extMemOp->hasAttr(attr))
+      return false;
+
+  // Addresses and data are passed to the DPI-C functions as 64-bit values.
+  auto bundleType = firrtlOp.getPortType(idx).cast<firrtl::BundleType>();
+  for (auto sig : bundleType.getElements()) {
+    auto sigType = sig.type.cast<firrtl::BundleType>();
+    if (sigType.getElement("data").hasValue() &&
+        getBundleDataWidth(sigType) > 64)
+      return false;
+  }
+  return true;
+}
+
+LogicalResult
+HandshakeVerilatorWrapper::emitInputPortType(llvm::raw_ostream &os, Type t,
+                                             unsigned idx) {
+  if (auto memref = t.dyn_cast<MemRefType>(); memref && isDpiMemory(idx)) {
+    os << "HandshakeDpiMemory<";
+    if (emitVerilatorType(os, hsOp.getLoc(), memref.getElementType())
+            .failed())
+      return failure();
+    os << ">";
+  } else if (memref) {
+    os << "HandshakeMemoryInterface<";
+    if (emitVerilatorType(os, hsOp.getLoc(), memref.getElementType())
+            .failed())
+      return failure();
+    os << ", ";
+    if (emitVerilatorTypeFromWidth(os, hsOp.getLoc(), getMemAddrWidth(idx))
+            .failed())
+      return failure();
+    os << ">";
+  } else {
+    os << "HandshakeDataInPort<TArg" << idx << ">";
+  }
+  return success();
+}
+
+void HandshakeVerilatorWrapper::emitOutputPortType(llvm::raw_ostream &os,
+                                                   unsigned idx) {
+  os << "HandshakeDataOutPort<TRes" << idx << ">";
+}
+
+LogicalResult HandshakeVerilatorWrapper::emitExtMemPort(MemRefType memref,
+                                                        unsigned idx) {
+  // Multidimensional memories are addressed by their row-major (flattened)
+  // index; the simulator maps this onto the strides of the host memory.
+  assert(memref.hasStaticShape() && "Only support statically sized memories");
+  std::string name = getInputName(idx);
+  unsigned addrWidth = getMemAddrWidth(idx);
+
+  // Locate the external memory operation referencing the input
+  handshake::ExternalMemoryOp extMemOp = getExtMemOp(idx);
+
+  // The load and store ports of a DPI memory are connected to the adapter of
+  // the model (see emitDpiAdapter), so only the memory itself is emitted.
+  if (isDpiMemory(idx)) {
+    osi() << "auto " << name << " = addInputPort<";
+    if (emitInputPortType(osi(), memref, idx).failed())
+      return failure();
+    osi() << ">(/*size=*/" << memref.getNumElements()
+          << ", /*numLoads=*/" << extMemOp.getLdCount()
+          << ", /*numStores=*/" << extMemOp.getStCount() << ");\n";
+    if (llvm::is_contained(mappedArgs, idx))
+      osi() << name << "->mapFileFromEnv(" << idx << ");\n";
+    osi() << "dpiMemoryList.push_back(" << name << ");\n";
+    return success();
+  }
+
+  // The load latency and initiation interval of the memory may be specified
+  // through attributes on the external memory operation.
+  unsigned latency = 0, initiationInterval = 1;
+  if (auto attr = extMemOp->getAttrOfType<IntegerAttr>(kMemLatencyAttr)) {
+    if (attr.getInt() < 0)
+      return extMemOp.emitOpError()
+             << "expected '" << kMemLatencyAttr << "' to be non-negative";
+    latency = attr.getInt();
+  }
+  if (auto attr = extMemOp->getAttrOfType<IntegerAttr>(kMemIIAttr)) {
+    if (attr.getInt() < 1)
+      return extMemOp.emitOpError()
+             << "expected '" << kMemIIAttr << "' to be at least 1";
+    initiationInterval = attr.getInt();
+  }
+
+  osi() << "auto " << name << " = addInputPort<";
+  if (emitInputPortType(osi(), memref, idx).failed())
+    return failure();
+  osi() << ">(/*size=*/" << memref.getNumElements();
+  if (latency != 0)
+    osi() << ", /*latency=*/" << latency
+          << ", /*initiationInterval=*/" << initiationInterval;
+  osi() << ");\n";
+
+  if (auto banksAttr = extMemOp->getAttrOfType<IntegerAttr>(kMemBanksAttr)) {
+    int64_t bankPorts = 1;
+    if (auto attr = extMemOp->getAttrOfType<IntegerAttr>(kMemBankPortsAttr))
+      bankPorts = attr.getInt();
+    if (banksAttr.getInt() < 1 || bankPorts < 1)
+      return extMemOp.emitOpError()
+             << "expected '" << kMemBanksAttr << "' and '" << kMemBankPortsAttr
+             << "' to be at least 1";
+
+    StringRef interleaving = "Cyclic";
+    if (auto attr =
+            extMemOp->getAttrOfType<StringAttr>(kMemBankInterleavingAttr)) {
+      if (attr.getValue() == "block")
+        interleaving = "Block";
+      else if (attr.getValue() != "cyclic")
+        return extMemOp.emitOpError()
+               << "expected '" << kMemBankInterleavingAttr
+               << "' to be either \"cyclic\" or \"block\"";
+    }
+    osi() << name << "->setBanking(/*numBanks=*/" << banksAttr.getInt()
+          << ", /*portsPerBank=*/" << bankPorts
+          << ", BankInterleaving::" << interleaving << ");\n";
+  }
+
+  if (llvm::is_contained(mappedArgs, idx))
+    osi() << name << "->mapFileFromEnv(" << idx << ");\n";
+
+  auto axisAttr = extMemOp->getAttrOfType<DictionaryAttr>(kMemAxisAttr);
+  if (isStreamArg(idx) || axisAttr) {
+    if (extMemOp.getLdCount() + extMemOp.getStCount() != 1 ||
+        extMemOp->hasAttr(kMemBanksAttr) || extMemOp->hasAttr(kMemCacheAttr) ||
+        extMemOp->hasAttr(kMemAxiAttr))
+      return extMemOp.emitOpError()
+             << "expected streamed memref argument " << idx
+             << " to have a single load or store port, and no banks, cache "
+                "or AXI master";
+    auto emitAxisField = [&](StringRef key, StringRef defaultValue) {
+      IntegerAttr attr;
+      if (axisAttr)
+        attr = axisAttr.getAs<IntegerAttr>(key);
+      if (attr)
+        osi() << attr.getInt();
+      else
+        osi() << defaultValue;
+    };
+    osi() << name << "->setStream(/*interval=*/";
+    emitAxisField("interval", "HLT_STREAM_ARG_INTERVAL");
+    osi() << ", /*depth=*/";
+    emitAxisField("depth", "HLT_STREAM_ARG_DEPTH");
+    osi() << ", /*beatBytes=*/";
+    emitAxisField("beat_bytes", "0");
+    osi() << ");\n";
+  }
+
+  // The AXI master must be set before adding load ports.
+  if (auto axiAttr = extMemOp->getAttrOfType<DictionaryAttr>(kMemAxiAttr)) {
+    if (extMemOp->hasAttr(kMemCacheAttr) || latency != 0)
+      return extMemOp.emitOpError()
+             << "expected a memory with an AXI master to have no cache or "
+                "load latency";
+    osi() << "{\n";
+    osi().indent();
+    osi() << "AxiConfig axiConfig;\n";
+    static const std::pair<StringRef, StringRef> axiFields[] = {
+        {"beat_bytes", "beatBytes"},
+        {"burst", "burstBeats"},
+        {"outstanding", "maxOutstanding"},
+        {"read_latency", "readLatency"},
+        {"write_latency", "writeLatency"}};
+    for (auto &[key, field] : axiFields) {
+      if (auto attr = axiAttr.getAs<IntegerAttr>(key))
+        osi() << "axiConfig." << field << " = " << attr.getInt() << ";\n";
+    }
+    osi() << name << "->setAxi(axiConfig);\n";
+    osi().unindent();
+    osi() << "}\n";
+  }
+
+  // The cache must be set before adding load ports.
+  if (auto cacheAttr = extMemOp->getAttrOfType<DictionaryAttr>(kMemCacheAttr)) {
+    osi() << "{\n";
+    osi().indent();
+    osi() << "CacheConfig cacheConfig;\n";
+    static const std::pair<StringRef, StringRef> intFields[] = {
+        {"size", "sizeBytes"},
+        {"line", "lineBytes"},
+        {"associativity", "associativity"},
+        {"hit_latency", "hitLatency"},
+        {"miss_latency", "missLatency"}};
+    for (auto &[key, field] : intFields) {
+      if (auto attr = cacheAttr.getAs<IntegerAttr>(key))
+        osi() << "cacheConfig." << field << " = " << attr.getInt() << ";\n";
+    }
+    if (auto attr = cacheAttr.getAs<StringAttr>("policy")) {
+      StringRef policy = llvm::StringSwitch<StringRef>(attr.getValue())
+                             .Case("lru", "LRU")
+                             .Case("fifo", "FIFO")
+                             .Case("random", "Random")
+                             .Default("");
+      if (policy.empty())
+        return extMemOp.emitOpError()
+               << "expected cache policy to be one of \"lru\", \"fifo\" or "
+                  "\"random\"";
+      osi() << "cacheConfig.policy = ReplacementPolicy::" << policy << ";\n";
+    }
+    osi() << name << "->setCache(cacheConfig);\n";
+    osi().unindent();
+    osi() << "}\n";
+  }
 
   // Load ports
   for (unsigned i = 0; i < extMemOp.getLdCount(); ++i) {
@@ -266,7 +647,10 @@ LogicalResult HandshakeVerilatorWrapper::emitInputPort(Type t, unsigned idx) {
         "Type mismatch between handshake data port type and actual "
         "port type. This might be a verilator version issue");
 
-    osi() << "addInputPort<HandshakeDataInPort<" << dataType << ">>";
+    osi() << "addInputPort<";
+    if (emitInputPortType(osi(), t, idx).failed())
+      return failure();
+    osi() << ">";
     emitHSPortCtor(osi(), arg) << ";\n";
   }
   return success();
@@ -281,9 +665,173 @@ LogicalResult HandshakeVerilatorWrapper::emitOutputPort(Type t, unsigned idx) {
                    "Type mismatch between handshake data port type and actual "
                    "port type. This might be a verilator version issue");
 
-  osi() << "addOutputPort<HandshakeDataOutPort<" << dataType << ">>";
+  osi() << "addOutputPort<";
+  emitOutputPortType(osi(), idx);
+  osi() << ">";
   emitHSPortCtor(osi(), arg) << ";\n";
   return success();
 }
 
+namespace {
+/// A ground signal of the Verilog module of a FIRRTL module. Bundle ports are
+/// lowered to a signal per field, named <port>_<field>.
+struct VerilogSignal {
+  std::string name;
+  bool isInput;
+  int64_t width;
+};
+} // namespace
+
+static void flattenPort(const Twine &name, Type type, bool isInput,
+                        SmallVectorImpl<VerilogSignal> &signals) {
+  if (auto bundle = type.dyn_cast<firrtl::BundleType>()) {
+    for (auto &elt : bundle.getElements())
+      flattenPort(name + "_" + elt.name.getValue(), elt.type,
+                  isInput != elt.isFlip, signals);
+    return;
+  }
+  // Zero-width signals are removed when lowering to Verilog.
+  int64_t width = type.cast<firrtl::FIRRTLType>().getBitWidthOrSentinel();
+  if (width != 0)
+    signals.push_back({name.str(), isInput, width});
+}
+
+static std::string verilogRange(int64_t width) {
+  return width > 1 ? "[" + std::to_string(width - 1) + ":0] " : "";
+}
+
+LogicalResult HandshakeVerilatorWrapper::emitDpiAdapter() {
+  std::string kernel = funcName().str();
+  SmallString<128> fn = outDir;
+  sys::path::append(fn, kernel + "_dpi.sv");
+  std::string contents;
+  raw_string_ostream os(contents);
+
+  // Signals of the ports which remain ports of the top-level module, and of
+  // the memory ports which are connected to the adapters.
+  SmallVector<VerilogSignal> topSignals, memSignals;
+  SmallVector<unsigned> memArgs;
+  llvm::StringMap<int64_t> memWidths;
+  for (unsigned i = 0, e = firrtlOp.getNumPorts(); i < e; ++i) {
+    bool isMemory = i < funcOp.getNumArguments() && isDpiMemory(i);
+    if (isMemory)
+      memArgs.push_back(i);
+    flattenPort(firrtlOp.getPortName(i), firrtlOp.getPortType(i),
+                firrtlOp.getPortDirection(i) == firrtl::Direction::In,
+                isMemory ? memSignals : topSignals);
+  }
+  for (auto &signal : memSignals)
+    memWidths[signal.name] = signal.width;
+
+  os << "// Generated by hlt-wrapgen. Top-level module of the model of '"
+     << kernel << "',\n// which serves the memories of the kernel through "
+                  "DPI-C; see HandshakeDpiMemory.h.\n\n";
+  os << "import \"DPI-C\" function longint unsigned hlt_dpi_read(\n"
+     << "  input longint unsigned memories, input int mem, input int port,\n"
+     << "  input longint unsigned addr);\n";
+  os << "import \"DPI-C\" function void hlt_dpi_write(\n"
+     << "  input longint unsigned memories, input int mem, input int port,\n"
+     << "  input longint unsigned addr, input longint unsigned data);\n\n";
+
+  // The address of the DpiMemories of the simulator is set by the harness.
+  os << "module " << kernel << "_dpi(\n";
+  os << "  input [63:0] hlt_memories";
+  for (auto &signal : topSignals)
+    os << ",\n  " << (signal.isInput ? "input " : "output ")
+       << verilogRange(signal.width) << signal.name;
+  os << ");\n\n";
+
+  for (auto &signal : memSignals)
+    os << "  wire " << verilogRange(signal.width) << signal.name << ";\n";
+  os << "\n  " << kernel << " kernel(";
+  llvm::interleave(
+      llvm::concat<VerilogSignal>(topSignals, memSignals),
+      [&](auto &signal) {
+        os << "\n    ." << signal.name << "(" << signal.name << ")";
+      },
+      [&]() { os << ","; });
+  os << ");\n";
+
+  // A load is answered in the cycle after its address was accepted; the data
+  // and done tokens are held until consumed by the kernel. A store is
+  // performed once both its address and data are valid.
+  for (auto &it : llvm::enumerate(memArgs)) {
+    unsigned idx = it.value();
+    auto extMemOp = getExtMemOp(idx);
+    std::string mem = getInputName(idx);
+    std::string memIdx = std::to_string(it.index());
+    std::string reset, loads, stores;
+    raw_string_ostream resetOs(reset), loadsOs(loads), storesOs(stores);
+
+    os << "\n  // Memory " << memIdx << " (" << mem << ")\n";
+    for (unsigned i = 0; i < extMemOp.getLdCount(); ++i) {
+      std::string port = std::to_string(i);
+      std::string addr = mem + "_ldAddr" + port;
+      std::string data = mem + "_ldData" + port;
+      std::string done = mem + "_ldDone" + port;
+      std::string ld = mem + "_ld" + port;
+      int64_t dataWidth = memWidths.lookup(data + "_data");
+      os << "  reg " << ld << "_dataValid;\n";
+      os << "  reg " << ld << "_doneValid;\n";
+      os << "  reg " << verilogRange(dataWidth) << ld << "_data;\n";
+      os << "  assign " << addr << "_ready = (~" << ld << "_dataValid | "
+         << data << "_ready) & (~" << ld << "_doneValid | " << done
+         << "_ready);\n";
+      os << "  assign " << data << "_valid = " << ld << "_dataValid;\n";
+      os << "  assign " << data << "_data = " << ld << "_data;\n";
+      os << "  assign " << done << "_valid = " << ld << "_doneValid;\n";
+
+      resetOs << "      " << ld << "_dataValid <= 1'b0;\n";
+      resetOs << "      " << ld << "_doneValid <= 1'b0;\n";
+      loadsOs << "      if (" << addr << "_valid & " << addr
+              << "_ready) begin\n"
+              << "        " << ld << "_data <= " << dataWidth
+              << "'(hlt_dpi_read(hlt_memories, " << memIdx << ", " << port
+              << ", 64'(" << addr << "_data)));\n"
+              << "        " << ld << "_dataValid <= 1'b1;\n"
+              << "        " << ld << "_doneValid <= 1'b1;\n"
+              << "      end else begin\n"
+              << "        if (" << data << "_ready)\n"
+              << "          " << ld << "_dataValid <= 1'b0;\n"
+              << "        if (" << done << "_ready)\n"
+              << "          " << ld << "_doneValid <= 1'b0;\n"
+              << "      end\n";
+    }
+    for (unsigned i = 0; i < extMemOp.getStCount(); ++i) {
+      std::string port = std::to_string(i);
+      std::string addr = mem + "_stAddr" + port;
+      std::string data = mem + "_stData" + port;
+      std::string done = mem + "_stDone" + port;
+      std::string st = mem + "_st" + port;
+      os << "  reg " << st << "_doneValid;\n";
+      os << "  wire " << st << "_free = ~" << st << "_doneValid | " << done
+         << "_ready;\n";
+      os << "  assign " << addr << "_ready = " << data << "_valid & " << st
+         << "_free;\n";
+      os << "  assign " << data << "_ready = " << addr << "_valid & " << st
+         << "_free;\n";
+      os << "  assign " << done << "_valid = " << st << "_doneValid;\n";
+
+      resetOs << "      " << st << "_doneValid <= 1'b0;\n";
+      storesOs << "      if (" << addr << "_valid & " << data << "_valid & "
+               << st << "_free) begin\n"
+               << "        hlt_dpi_write(hlt_memories, " << memIdx << ", "
+               << port << ", 64'(" << addr << "_data), 64'(" << data
+               << "_data));\n"
+               << "        " << st << "_doneValid <= 1'b1;\n"
+               << "      end else if (" << done << "_ready)\n"
+               << "        " << st << "_doneValid <= 1'b0;\n";
+    }
+
+    // Loads are performed before the stores of the same cycle.
+    os << "  always @(posedge clock) begin\n"
+       << "    if (reset) begin\n"
+       << resetOs.str() << "    end else begin\n"
+       << loadsOs.str() << storesOs.str() << "    end\n"
+       << "  end\n";
+  }
+  os << "endmodule\n";
+  return writeOutputFile(hsOp.getLoc(), fn, os.str());
+}
+
 } // namespace circt_hls
@@ -21,6 +21,7 @@ namespace circt_hls {
 
 SmallVector<std::string> StdWrapper::getIncludes() {
   SmallVector<std::string> includes;
+  includes.push_back("circt-hls/Tools/hlt/Simulator/StdJIT.h");
   includes.push_back("circt-hls/Tools/hlt/Simulator/StdSimInterface.h");
   includes.push_back("circt-hls/Tools/hlt/Simulator/SimDriver.h");
   includes.push_back("cstdint");
@@ -37,12 +38,17 @@ LogicalResult StdWrapper::emitPreamble(Operation * /*kernelOp*/) {
   if (emitIOTypes(emitType).failed())
     return failure();
 
-  // Emit simulator interface type.
-  osi() << "using " << funcName()
-        << "SimInterface = StdSimInterface<TInput, TOutput>;\n\n";
+  // Emit simulator interface type. Calls are run on a pool of threads if
+  // requested.
+  osi() << "using " << funcName() << "SimInterface = ";
+  if (callThreads != 1)
+    osi() << "StdPoolSimInterface<TInput, TOutput, " << callThreads << ">;\n\n";
+  else
+    osi() << "StdSimInterface<TInput, TOutput>;\n\n";
 
   // Forward declare kernel function; this is an external symbol that is defined
-  // in the lowered LLVMIR version of the kernel.
+  // in the lowered LLVMIR version of the kernel, unless the kernel is JIT
+  // compiled.
   std::string retType;
   auto funcType = funcOp.getFunctionType();
   if (funcType.getNumResults() > 1)
@@ -54,14 +60,18 @@ LogicalResult StdWrapper::emitPreamble(Operation * /*kernelOp*/) {
   } else
     retType = "void";
 
-  osi() << "extern \"C\" " << retType << " " << funcName() << "(";
+  std::string argTypes;
+  llvm::raw_string_ostream argTypesOS(argTypes);
   bool failed = false;
-  interleaveComma(funcOp.getArgumentTypes(), osi(), [&](Type type) {
-    failed |= emitType(osi(), funcOp.getLoc(), type).failed();
+  interleaveComma(funcOp.getArgumentTypes(), argTypesOS, [&](Type type) {
+    failed |= emitType(argTypesOS, funcOp.getLoc(), type).failed();
   });
   if (failed)
     return failure();
-  osi() << ");\n\n";
+  osi() << "#if !HLT_JIT\n";
+  osi() << "extern \"C\" " << retType << " " << funcName() << "("
+        << argTypesOS.str() << ");\n";
+  osi() << "#endif\n\n";
 
   // Emit simulator.
   osi() << "class " << funcName() << "Sim : public " << funcName()
@@ -69,23 +79,57 @@ LogicalResult StdWrapper::emitPreamble(Operation * /*kernelOp*/) {
   osi() << "protected:\n";
   osi().indent();
 
+  // When JIT compiling the kernel, the kernel function is looked up on the
+  // first call.
+  auto emitLookup = [&]() {
+    osi() << "#if HLT_JIT\n";
+    osi() << "static auto *" << funcName() << " = StdJIT::get().lookup<"
+          << retType << "(" << argTypesOS.str() << ")>(\"" << funcName()
+          << "\");\n";
+    osi() << "#endif\n";
+  };
+  auto emitCall = [&]() {
+    osi() << funcName() << "(";
+    interleaveComma(llvm::iota_range(0U, funcOp.getNumArguments(), false),
+                    osi(), [&](unsigned idx) { osi() << "a" << idx; });
+    osi() << ");\n";
+  };
+  auto emitUnpack = [&]() {
+    for (auto type : enumerate(funcOp.getArgumentTypes())) {
+      osi() << "auto a" << type.index() << " = std::get<" << type.index()
+            << ">(input);\n";
+    }
+  };
+
   // Emit 'call' function.
   osi() << "TOutput call(const TInput& input) override {\n";
   osi().indent();
-
-  // Unpack arguments
-  for (auto type : enumerate(funcOp.getArgumentTypes())) {
-    osi() << "auto a" << type.index() << " = std::get<" << type.index()
-          << ">(input);\n";
-  }
-
-  // Call
-  osi() << "return " << funcName() << "(";
-  interleaveComma(llvm::iota_range(0U, funcOp.getNumArguments(), false), osi(),
-                  [&](unsigned idx) { osi() << "a" << idx; });
-  osi() << ");\n";
+  emitUnpack();
+  emitLookup();
+  osi() << "return ";
+  emitCall();
   osi().unindent();
   osi() << "};\n";
+
+  // Emit 'callBatch' function; a tight loop over the kernel, which the kernel
+  // is inlined into when the simulator is built with LTO. Pooled calls are not
+  // batched.
+  if (callThreads == 1) {
+    osi() << "void callBatch(const TInput* inputs, TOutput* outputs, "
+             "size_t n) override {\n";
+    osi().indent();
+    emitLookup();
+    osi() << "for (size_t i = 0; i < n; ++i) {\n";
+    osi().indent();
+    osi() << "const TInput& input = inputs[i];\n";
+    emitUnpack();
+    osi() << "outputs[i] = ";
+    emitCall();
+    osi().unindent();
+    osi() << "}\n";
+    osi().unindent();
+    osi() << "};\n";
+  }
   osi().unindent();
   osi() << "};\n\n";
 
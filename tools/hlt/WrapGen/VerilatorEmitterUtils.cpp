@@ -14,6 +14,8 @@
 #include "circt-hls/Tools/hlt/WrapGen/VerilatorEmitterUtils.h"
 #include "llvm/ADT/TypeSwitch.h"
 
+#include <algorithm>
+
 using namespace mlir;
 
 namespace circt_hls {
@@ -29,8 +31,8 @@ LogicalResult emitVerilatorTypeFromWidth(llvm::raw_ostream &os, Location loc,
   else if (width <= 64)
     os << "QData";
   else
-    return emitError(loc)
-           << "Integers wider than 64 bits are unhandled for now";
+    // Wide signals are arrays of 32-bit words.
+    os << "VlWide<" << (width + 31) / 32 << ">";
   return success();
 }
 
@@ -47,9 +49,13 @@ LogicalResult emitVerilatorType(llvm::raw_ostream &os, Location loc, Type type,
             IntegerType::get(type.getContext(), type.kInternalStorageBitWidth));
       })
       .Case<MemRefType>([&](MemRefType type) {
+        // Memories are passed as the memref descriptors of the MLIR calling
+        // convention, such that strided views of host memories can be
+        // accessed in place. A 0-D memref is a single element memory.
+        os << "MemRefDescriptor<";
         if (emitVerilatorType(os, loc, type.getElementType()).failed())
           return failure();
-        os << "*";
+        os << ", " << std::max<int64_t>(type.getRank(), 1) << ">";
         return success();
       })
       .Default([&](auto type) {
@@ -58,4 +64,31 @@ LogicalResult emitVerilatorType(llvm::raw_ostream &os, Location loc, Type type,
       });
 }
 
+Type getVerilatorSignedness(Type type) {
+  return llvm::TypeSwitch<Type, Type>(type)
+      .Case<IntegerType>([&](IntegerType type) -> Type {
+        // i1 is emitted as bool, irrespective of its signedness.
+        if (type.getWidth() == 1)
+          return type;
+        return IntegerType::get(type.getContext(), type.getWidth(),
+                                IntegerType::Unsigned);
+      })
+      .Case<MemRefType>([&](MemRefType type) -> Type {
+        return MemRefType::Builder(type).setElementType(
+            getVerilatorSignedness(type.getElementType()));
+      })
+      .Default([&](Type type) { return type; });
+}
+
+LogicalResult verifyArcilatorType(Location loc, Type type) {
+  if (auto memref = type.dyn_cast<MemRefType>())
+    type = memref.getElementType();
+  auto intType = type.dyn_cast<IntegerType>();
+  if (intType && intType.getWidth() > 64)
+    return emitError(loc) << "'" << type
+                          << "' is wider than the 64 bits of the ports of "
+                             "arcilator models";
+  return success();
+}
+
 } // namespace circt_hls
@@ -8,14 +8,17 @@
 //
 // This file implements the hlt-wrapgen tool. Based on an input reference
 // function, a target kernel operation is wrapped to generate a .cpp file
-// suitable for interaction with the HLT simulation library.
+// suitable for interaction with the HLT simulation library. Multiple kernels
+// may be wrapped into a single .cpp file.
 //
 //===----------------------------------------------------------------------===//
 
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/MLIRContext.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Parser/Parser.h"
 
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/TypeSwitch.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
@@ -36,7 +39,9 @@
 #include "mlir/Dialect/SCF/IR/SCF.h"
 
 #include "circt-hls/Tools/hlt/WrapGen/BaseWrapper.h"
+#include "circt-hls/Tools/hlt/WrapGen/calyx/CalyxInterpWrapper.h"
 #include "circt-hls/Tools/hlt/WrapGen/calyx/CalyxVerilatorWrapper.h"
+#include "circt-hls/Tools/hlt/WrapGen/handshake/HandshakeNativeWrapper.h"
 #include "circt-hls/Tools/hlt/WrapGen/handshake/HandshakeVerilatorWrapper.h"
 #include "circt-hls/Tools/hlt/WrapGen/std/StdWrapper.h"
 
@@ -66,11 +71,125 @@ static cl::opt<std::string> outputDirectory("o", cl::Required,
                                             cl::desc("<output directory>"),
                                             cl::init("-"));
 
-static cl::opt<std::string>
-    functionName("name", cl::Required,
-                 cl::desc("The name of the function to wrap"), cl::init("-"));
-
-enum class KernelType { HandshakeFIRRTL, Calyx, Standard };
+static cl::list<std::string> functionNames(
+    "name", cl::OneOrMore, cl::CommaSeparated,
+    cl::desc("The names of the functions to wrap. Each function is wrapped "
+             "with its own simulator and driver, within a single wrapper."));
+
+static cl::opt<std::string> wrapperName(
+    "wrapper-name", cl::Optional,
+    cl::desc("Name of the generated wrapper files. Defaults to the name of "
+             "the first function to wrap."));
+
+static cl::opt<unsigned> poolSize(
+    "pool", cl::Optional,
+    cl::desc("Number of simulator instances to distribute kernel calls over. "
+             "Only valid if kernel calls are independent of each other. If 0, "
+             "an instance is created for each hardware thread."),
+    cl::init(1));
+
+static cl::opt<bool> staticPorts(
+    "static-ports", cl::Optional,
+    cl::desc("Emit the simulator ports as a tuple of concrete port types, "
+             "allowing the simulator to evaluate ports without virtual "
+             "dispatch. Only supported by the handshake wrapper."),
+    cl::init(false));
+
+static cl::opt<unsigned> callThreads(
+    "std-threads", cl::Optional,
+    cl::desc("Number of threads to run kernel calls on concurrently within "
+             "each simulator instance. Only valid if kernel calls are "
+             "independent of each other. If 0, a thread is created for each "
+             "hardware thread. Only supported by the standard wrapper."),
+    cl::init(1));
+
+static cl::list<unsigned> mappedArgs(
+    "mmap-args", cl::ZeroOrMore, cl::CommaSeparated,
+    cl::desc("Indices of the memref arguments whose memories may be backed by "
+             "a memory mapped file, named by the HLT_MMAP_ARG<idx> "
+             "environment variable of the simulation, instead of by the host "
+             "memory. Only supported by the handshake wrappers."));
+
+static cl::opt<bool> dpiMemories(
+    "dpi-memories", cl::Optional,
+    cl::desc("Serve the memories of the kernel from within the verilated "
+             "model, through a SystemVerilog adapter (<kernel>_dpi.sv) which "
+             "accesses them by DPI-C calls. Memories with a latency, banking "
+             "or cache are still simulated by the harness. Only supported by "
+             "the handshake wrapper."),
+    cl::init(false));
+
+static cl::opt<bool> arcilator(
+    "arcilator", cl::Optional,
+    cl::desc("Simulate the kernel on a model compiled by arcilator, whose "
+             "class <kernel> is declared by <kernel>_arc.h (see "
+             "arcilator-header-cpp.py), rather than on a verilated model. "
+             "Ports may be at most 64 bits wide. Only supported by the "
+             "handshake and Calyx wrappers."),
+    cl::init(false));
+
+static cl::opt<std::string> calyxProgram(
+    "calyx-program", cl::Optional,
+    cl::desc("The Calyx program (.futil) of the kernel, which the Calyx "
+             "interpreter wrapper (--type=calyx-interp) runs the kernel from. "
+             "Defaults to <name>.futil in the directory of the simulation."));
+
+static cl::list<unsigned> streamArgs(
+    "stream-args", cl::ZeroOrMore, cl::CommaSeparated,
+    cl::desc("Indices of the memref arguments which are streamed between the "
+             "host and the kernel, at the rate given by "
+             "HLT_STREAM_ARG_INTERVAL, rather than served as random access "
+             "memories. The kernel must access each of these in order, "
+             "through a single load or store port. Only supported by the "
+             "handshake wrapper."));
+
+static cl::opt<std::string> chainName(
+    "chain", cl::Optional,
+    cl::desc("Additionally chain the functions to wrap, in the order given by "
+             "--name, into a pipeline of this name. The results of each "
+             "function are streamed to the leading arguments of the next "
+             "function through a bounded channel, within a single "
+             "simulator. The pipeline is called through <chain>_call and its "
+             "siblings, with the arguments of the first function followed by "
+             "the remaining arguments of each subsequent function."));
+
+static cl::opt<bool> python(
+    "python", cl::Optional, cl::init(false),
+    cl::desc("Additionally emit pybind11 bindings of the class of each "
+             "function to <wrapper>_py.cpp, as a Python module named after "
+             "the wrapper. NumPy arrays are passed as memref arguments, and "
+             "are accessed in place by the simulator."));
+
+static cl::opt<std::string> mainName(
+    "emit-main", cl::Optional,
+    cl::desc("Additionally emit main.cpp, the main function of a standalone "
+             "executable which streams the calls of an input file through "
+             "the simulator of this function, and writes their outputs to an "
+             "output file (see SimStream.h). Usage of the executable: "
+             "<inputs> <outputs> [<calls in flight>]."));
+
+static cl::opt<bool> nativeTb(
+    "emit-native-tb", cl::Optional, cl::init(false),
+    cl::desc("Additionally emit <wrapper>_tb.cpp, which defines each "
+             "function with the C signature that a natively compiled "
+             "testbench calls it by. Each call is simulated synchronously, "
+             "and is compared against <function>_ref if compiled with "
+             "HLT_NATIVE_COSIM (see NativeCosim.h)."));
+
+static cl::opt<std::string> depFilename(
+    "depfile", cl::Optional,
+    cl::desc("Write a Makefile-style dependency file of the generated files "
+             "on the input files to this path, for build systems which run "
+             "the wrapper generator. Generated files are only rewritten if "
+             "their contents change."));
+
+enum class KernelType {
+  HandshakeFIRRTL,
+  HandshakeNative,
+  Calyx,
+  CalyxInterp,
+  Standard
+};
 
 static cl::opt<KernelType> kernelType(
     "type", cl::Required,
@@ -81,7 +200,13 @@ static cl::opt<KernelType> kernelType(
     llvm::cl::values(
         clEnumValN(KernelType::HandshakeFIRRTL, "handshakeFIRRTL",
                    "Use the Handshake wrapper"),
+        clEnumValN(KernelType::HandshakeNative, "handshake-native",
+                   "Use the native Handshake wrapper, which simulates the "
+                   "handshake function (--ref) without Verilator"),
         clEnumValN(KernelType::Calyx, "calyx", "Use the Calyx wrapper"),
+        clEnumValN(KernelType::CalyxInterp, "calyx-interp",
+                   "Use the Calyx interpreter wrapper, which simulates the "
+                   "Calyx program of the kernel without Verilator"),
         clEnumValN(KernelType::Standard, "std", "Use the standard wrapper")));
 
 namespace circt_hls {
@@ -91,18 +216,28 @@ static std::unique_ptr<BaseWrapper> getWrapper() {
   switch (kernelType) {
   case KernelType::HandshakeFIRRTL:
     return std::make_unique<HandshakeVerilatorWrapper>(outputDirectory);
+  case KernelType::HandshakeNative:
+    return std::make_unique<HandshakeNativeWrapper>(outputDirectory);
   case KernelType::Standard:
     return std::make_unique<StdWrapper>(outputDirectory);
   case KernelType::Calyx:
     return std::make_unique<CalyxVerilatorWrapper>(outputDirectory);
+  case KernelType::CalyxInterp:
+    return std::make_unique<CalyxInterpWrapper>(outputDirectory);
   }
 }
 
 /// Container for the current set of loaded modules.
 static SmallVector<mlir::OwningOpRef<mlir::ModuleOp>> modules;
 
-/// Load a module from the argument file fn into the modules vector.
-static ModuleOp getModule(MLIRContext *ctx, StringRef fn) {
+/// The loaded module of each file, such that each file is only parsed once
+/// when wrapping multiple kernels.
+static llvm::StringMap<ModuleOp> modulesByFile;
+
+/// Parses the module in the argument file fn. The file may contain either
+/// textual MLIR or MLIR bytecode.
+static mlir::OwningOpRef<mlir::ModuleOp> parseModule(MLIRContext *ctx,
+                                                     StringRef fn) {
   auto file_or_err = MemoryBuffer::getFileOrSTDIN(fn);
   if (std::error_code error = file_or_err.getError()) {
     errs() << "Error: Could not open input file '" << fn
@@ -113,11 +248,45 @@ static ModuleOp getModule(MLIRContext *ctx, StringRef fn) {
   // Load the MLIR module.
   SourceMgr source_mgr;
   source_mgr.AddNewSourceBuffer(std::move(*file_or_err), SMLoc());
-  modules.emplace_back(mlir::parseSourceFile<ModuleOp>(source_mgr, ctx));
-  if (!modules.back()) {
+  auto mod = mlir::parseSourceFile<ModuleOp>(source_mgr, ctx);
+  if (!mod)
     errs() << "Error: Found no modules in input file '" << fn << "'\n";
-    return nullptr;
+  return mod;
+}
+
+/// Parses each distinct file of fns which has not yet been loaded, in parallel
+/// on the thread pool of the context, into the set of loaded modules.
+static void loadModules(MLIRContext *ctx, ArrayRef<StringRef> fns) {
+  SmallVector<StringRef> toLoad;
+  for (auto fn : fns)
+    if (!fn.empty() && !modulesByFile.count(fn) &&
+        !llvm::is_contained(toLoad, fn))
+      toLoad.push_back(fn);
+
+  // The parser loads dialects on demand, which is not thread-safe.
+  if (toLoad.size() > 1)
+    ctx->loadAllAvailableDialects();
+
+  std::vector<mlir::OwningOpRef<mlir::ModuleOp>> parsed(toLoad.size());
+  mlir::parallelFor(ctx, 0, toLoad.size(),
+                    [&](size_t i) { parsed[i] = parseModule(ctx, toLoad[i]); });
+  for (auto it : llvm::enumerate(parsed)) {
+    if (!it.value())
+      continue;
+    modulesByFile[toLoad[it.index()]] = it.value().get();
+    modules.push_back(std::move(it.value()));
   }
+}
+
+/// Load a module from the argument file fn into the modules vector.
+static ModuleOp getModule(MLIRContext *ctx, StringRef fn) {
+  if (auto it = modulesByFile.find(fn); it != modulesByFile.end())
+    return it->second;
+
+  modules.push_back(parseModule(ctx, fn));
+  if (!modules.back())
+    return nullptr;
+  modulesByFile[fn] = modules.back().get();
   return modules.back().get();
 }
 
@@ -125,13 +294,6 @@ static ModuleOp getModule(MLIRContext *ctx, StringRef fn) {
 /// modules.
 static mlir::Operation *getOpToWrap(mlir::MLIRContext *ctx, StringRef fn,
                                     StringRef symbol) {
-  auto file_or_err = MemoryBuffer::getFileOrSTDIN(fn);
-  if (std::error_code error = file_or_err.getError()) {
-    errs() << ": could not open input file '" << fn << "': " << error.message()
-           << "\n";
-    return nullptr;
-  }
-
   auto mod = getModule(ctx, fn);
   if (!mod) {
     errs() << "No module in file: " << fn << "\n";
@@ -185,6 +347,41 @@ static Operation *getOpToWrapErroring(MLIRContext *ctx, StringRef fileName,
   return op;
 }
 
+// Escapes 'path' as a target or prerequisite of a Makefile rule.
+static std::string escapeDepPath(StringRef path) {
+  std::string escaped;
+  for (char c : path) {
+    if (c == ' ' || c == '#')
+      escaped += '\\';
+    else if (c == '$')
+      escaped += '$';
+    escaped += c;
+  }
+  return escaped;
+}
+
+// Writes the dependency file of --depfile, whose rule has the generated files
+// of 'wrapper' as targets, and 'inputFiles' as prerequisites.
+static LogicalResult writeDepFile(circt_hls::BaseWrapper &wrapper,
+                                  ArrayRef<StringRef> inputFiles) {
+  std::error_code EC;
+  raw_fd_ostream os(depFilename, EC, sys::fs::OF_None);
+  if (EC) {
+    errs() << "Could not open dependency file '" << depFilename
+           << "': " << EC.message() << "\n";
+    return failure();
+  }
+  llvm::interleave(
+      wrapper.getOutputFiles(), os,
+      [&](const std::string &fn) { os << escapeDepPath(fn); }, " ");
+  os << ":";
+  for (StringRef input : inputFiles)
+    if (input != "-")
+      os << " " << escapeDepPath(input);
+  os << "\n";
+  return success();
+}
+
 int main(int argc, char **argv) {
   InitLLVM y(argc, argv);
   cl::ParseCommandLineOptions(argc, argv, "hlt test wrapper generator\n\n");
@@ -199,27 +396,40 @@ int main(int argc, char **argv) {
   mlir::MLIRContext context(registry);
   context.allowUnregisteredDialects();
 
-  Operation *funcOpPtr =
-      getOpToWrapErroring(&context, inputFunctionFilename, functionName);
-  if (!funcOpPtr)
-    return 1;
-
-  auto funcOp = dyn_cast<mlir::func::FuncOp>(funcOpPtr);
-  if (!funcOp) {
-    errs() << "Expected --func to be a builtin.func\n";
-    return 1;
-  }
+  // --func, --ref and --kernel commonly refer to distinct, large files; parse
+  // them up front and in parallel.
+  SmallVector<StringRef> inputFiles = {inputFunctionFilename,
+                                       inputReferenceFilename};
+  if (inputKernelFilename.getNumOccurrences() != 0)
+    inputFiles.push_back(inputKernelFilename);
+  circt_hls::loadModules(&context, inputFiles);
+
+  SmallVector<circt_hls::WrapTarget> targets;
+  for (auto &functionName : functionNames) {
+    Operation *funcOpPtr =
+        getOpToWrapErroring(&context, inputFunctionFilename, functionName);
+    if (!funcOpPtr)
+      return 1;
 
-  Operation *refOp =
-      getOpToWrapErroring(&context, inputReferenceFilename, functionName);
-  if (!refOp)
-    return 1;
+    auto funcOp = dyn_cast<mlir::func::FuncOp>(funcOpPtr);
+    if (!funcOp) {
+      errs() << "Expected --func to be a builtin.func\n";
+      return 1;
+    }
 
-  Operation *kernelOp = nullptr;
-  if (inputKernelFilename.getNumOccurrences() != 0) {
-    kernelOp = getOpToWrapErroring(&context, inputKernelFilename, functionName);
-    if (!kernelOp)
+    Operation *refOp =
+        getOpToWrapErroring(&context, inputReferenceFilename, functionName);
+    if (!refOp)
       return 1;
+
+    Operation *kernelOp = nullptr;
+    if (inputKernelFilename.getNumOccurrences() != 0) {
+      kernelOp =
+          getOpToWrapErroring(&context, inputKernelFilename, functionName);
+      if (!kernelOp)
+        return 1;
+    }
+    targets.push_back({funcOp, refOp, kernelOp});
   }
 
   /// Locate wrapping handler for the operation.
@@ -227,7 +437,25 @@ int main(int argc, char **argv) {
   if (!wrapper)
     return 1;
 
+  wrapper->setPoolSize(poolSize);
+  wrapper->setStaticPorts(staticPorts);
+  wrapper->setCallThreads(callThreads);
+  wrapper->setMappedArgs(mappedArgs);
+  wrapper->setDpiMemories(dpiMemories);
+  wrapper->setArcilator(arcilator);
+  wrapper->setCalyxProgram(calyxProgram);
+  wrapper->setStreamArgs(streamArgs);
+  wrapper->setChainName(chainName);
+  wrapper->setPython(python);
+  wrapper->setMainName(mainName);
+  wrapper->setNativeTb(nativeTb);
+
   /// Go wrap!
-  if (wrapper->wrap(funcOp, refOp, kernelOp).failed())
+  std::string name = wrapperName.getNumOccurrences() != 0
+                         ? wrapperName.getValue()
+                         : functionNames.front();
+  if (wrapper->wrap(targets, name).failed())
+    return 1;
+  if (!depFilename.empty() && writeDepFile(*wrapper, inputFiles).failed())
     return 1;
 }
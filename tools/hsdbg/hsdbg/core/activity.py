@@ -0,0 +1,175 @@
+import heapq
+import os
+import pickle
+from array import array
+from bisect import bisect_right
+
+
+class CycleMap:
+  """ Maps the steps of a trace onto the cycles of the simulation. If the
+  trace has a clock, the values of each cycle are those before its rising
+  edge; otherwise, as in token traces, each step is a cycle.
+  """
+
+  def __init__(self, trace, clock="clock"):
+    self.trace = trace
+    self.clock = clock
+    # The steps of the rising edges of the clock, if any.
+    self.edges = None
+    top = trace.getTopInstance()
+    clocks = [s for s in top.signals if s.name == clock]
+    if not clocks:
+      print(f"No clock '{clock}' found; each step is a cycle.")
+      self.numCycles = trace.getEndTime() - trace.getStartTime() + 1
+      return
+    self.edges = array("q")
+    prev = "0"
+    for step, value in trace.changes(clocks[0]):
+      if value == "1" and prev != "1":
+        self.edges.append(step)
+      prev = value
+    self.numCycles = len(self.edges)
+
+  def cycles(self, begin, end):
+    """ Returns the cycles [first, last) whose values are those of the steps
+    [begin, end).
+    """
+    if self.edges is None:
+      start = self.trace.getStartTime()
+      return begin - start, end - start
+    # A value is sampled by the edges after it changed, up to and including
+    # the step at which it changes again.
+    return bisect_right(self.edges, begin), bisect_right(self.edges, end)
+
+  def cycleOf(self, step):
+    # Returns the cycle which samples the values at 'step'.
+    if self.edges is None:
+      return step - self.trace.getStartTime()
+    return min(bisect_right(self.edges, step), max(self.numCycles - 1, 0))
+
+  def endStep(self):
+    # One step past the last, such that the final values span the last step.
+    return self.trace.getEndTime() + (1 if self.edges is None else 0)
+
+
+def channelIntervals(trace, cycleMap, valid, ready):
+  """ Yields the cycles [begin, end) of each interval in which the 'valid' and
+  'ready' signals of a channel are constant, along with their values, from a
+  single pass over the changes of the signals.
+  """
+  isValid = isReady = False
+  prevStep = None
+  changes = heapq.merge(((step, 0, v) for step, v in trace.changes(valid)),
+                        ((step, 1, v) for step, v in trace.changes(ready)))
+  for step, which, value in changes:
+    if prevStep is not None and step != prevStep:
+      yield (*cycleMap.cycles(prevStep, step), isValid, isReady)
+    prevStep = step
+    if which == 0:
+      isValid = value == "1"
+    else:
+      isReady = value == "1"
+  if prevStep is not None:
+    yield (*cycleMap.cycles(prevStep, cycleMap.endStep()), isValid, isReady)
+
+
+class ActivitySummary:
+  """ The number of cycles in which each handshake channel fired (valid and
+  ready) and stalled (valid only), per window of cycles of each of LEVELS.
+  The summary is built in a single pass over the changes of each channel, and
+  is cached next to the trace (as '<trace>.hsdbgact'), like the index of a
+  VCD trace.
+  """
+
+  VERSION = 1
+  # The cycles of the windows of each level, from the finest. Each is a
+  # multiple of the previous.
+  LEVELS = (1 << 10, 1 << 16, 1 << 20)
+
+  def __init__(self, trace, cycleMap, channels):
+    # 'channels' maps the name of each channel to its valid and ready signals.
+    self.numCycles = cycleMap.numCycles
+    st = os.stat(trace.filename)
+    self.stamp = (ActivitySummary.VERSION, st.st_size, st.st_mtime_ns,
+                  cycleMap.clock, ActivitySummary.LEVELS)
+    self.summaryFile = trace.filename + ".hsdbgact"
+    if not self.load():
+      self.build(trace, cycleMap, channels)
+      self.store()
+
+  def load(self):
+    try:
+      with open(self.summaryFile, "rb") as f:
+        summary = pickle.load(f)
+    except (OSError, pickle.UnpicklingError, EOFError):
+      return False
+    if summary["stamp"] != self.stamp:
+      return False
+    self.counts = summary["counts"]
+    return True
+
+  def store(self):
+    try:
+      with open(self.summaryFile, "wb") as f:
+        pickle.dump({
+            "stamp": self.stamp,
+            "counts": self.counts
+        }, f, pickle.HIGHEST_PROTOCOL)
+    except OSError:
+      # The summary is rebuilt by the next run.
+      pass
+
+  def build(self, trace, cycleMap, channels):
+    # For each channel, the fired and stalled cycles of each window of each
+    # level. The finest level is accumulated from the trace, and each coarser
+    # level from the previous.
+    self.counts = {}
+    finest = ActivitySummary.LEVELS[0]
+    numWindows = max((self.numCycles + finest - 1) // finest, 1)
+    for name, (valid, ready) in channels.items():
+      fired = array("Q", bytes(8 * numWindows))
+      stalled = array("Q", bytes(8 * numWindows))
+      for begin, end, isValid, isReady in channelIntervals(
+          trace, cycleMap, valid, ready):
+        if not isValid:
+          continue
+        counts = fired if isReady else stalled
+        while begin < end:
+          w = begin // finest
+          windowEnd = min(end, (w + 1) * finest)
+          counts[w] += windowEnd - begin
+          begin = windowEnd
+      levels = [(fired, stalled)]
+      for prev, size in zip(ActivitySummary.LEVELS, ActivitySummary.LEVELS[1:]):
+        factor = size // prev
+        levels.append(
+            tuple(
+                array("Q", (sum(c[i:i + factor])
+                            for i in range(0, len(c), factor)))
+                for c in levels[-1]))
+      self.counts[name] = levels
+
+  def window(self, level, cycle):
+    """ Returns the cycles [begin, end) of the window of 'level' which holds
+    'cycle'. Level len(LEVELS) is the whole run.
+    """
+    if level >= len(ActivitySummary.LEVELS):
+      return 0, self.numCycles
+    size = ActivitySummary.LEVELS[level]
+    begin = cycle // size * size
+    return begin, min(begin + size, self.numCycles)
+
+  def query(self, name, level, cycle):
+    """ Returns the fired and stalled cycles of channel 'name' within the
+    window of 'level' which holds 'cycle'.
+    """
+    levels = self.counts.get(name)
+    if levels is None:
+      return 0, 0
+    if level >= len(ActivitySummary.LEVELS):
+      return tuple(sum(c) for c in levels[-1])
+    w = cycle // ActivitySummary.LEVELS[level]
+    fired, stalled = levels[level]
+    if w >= len(fired):
+      return 0, 0
+    return fired[w], stalled[w]
@@ -0,0 +1,32 @@
+import os
+import shutil
+import subprocess
+from hsdbg.core.vcdtrace import *
+
+
+class FSTTrace(VCDTrace):
+  """ A trace interface for FST files. FST traces are converted to VCD using
+  the fst2vcd tool that is distributed with GTKWave, and then indexed as a
+  VCD trace. The VCD is kept next to the FST trace (as '<file>.vcd'), since
+  values are read from it on demand, and reused until the FST trace changes.
+  """
+
+  def __init__(self, filename):
+    super().__init__(filename)
+
+  def load(self):
+    vcdFile = self.filename + ".vcd"
+    if os.path.exists(vcdFile) and \
+        os.path.getmtime(vcdFile) >= os.path.getmtime(self.filename):
+      return VCDIndex(vcdFile)
+
+    if not shutil.which("fst2vcd"):
+      raise Exception("fst2vcd was not found. It is needed to read FST "
+                      "traces, and is distributed with GTKWave.")
+
+    # Convert to a temporary file first, such that an interrupted conversion
+    # is not mistaken for a complete one.
+    tmpFile = vcdFile + ".tmp"
+    subprocess.run(["fst2vcd", "-f", self.filename, "-o", tmpFile], check=True)
+    os.replace(tmpFile, vcdFile)
+    return VCDIndex(vcdFile)
@@ -0,0 +1,118 @@
+import socket
+import sys
+from hsdbg.core.vcdtrace import *
+
+
+class LiveSimulation:
+  """ A connection to the debug server of a running HLT simulation (see
+  SimDebugServer.h). The simulation is paused on connecting, and is stepped
+  forward as later cycles are queried. The values of each cycle which the
+  simulation was paused at are kept, such that earlier cycles can be revisited.
+  """
+
+  def __init__(self, address):
+    host, port = address.rsplit(":", 1)
+    self.sock = socket.create_connection((host, int(port)))
+    self.file = self.sock.makefile("rw")
+
+    self.signals = []
+    self.widths = []
+    for line in self.command("signals", until="end"):
+      name, width = line.split()
+      self.signals.append(name)
+      self.widths.append(int(width))
+    self.ids = {name: i for i, name in enumerate(self.signals)}
+
+    # Values of the signals at each sampled cycle, as bit strings.
+    self.values = {}
+    self.pause()
+    self.begintime = self.cycle
+
+  @property
+  def endtime(self):
+    # A live simulation can always be stepped further.
+    return sys.maxsize
+
+  def command(self, cmd, until=None):
+    # Sends 'cmd' to the server and returns its reply. If 'until' is set,
+    # returns the lines of the reply up to the line 'until'.
+    self.file.write(cmd + "\n")
+    self.file.flush()
+    if until is None:
+      return self.readLine()
+    lines = []
+    while True:
+      line = self.readLine()
+      if line == until:
+        return lines
+      lines.append(line)
+
+  def readLine(self):
+    line = self.file.readline()
+    if not line:
+      raise Exception("The simulation closed the debug connection.")
+    line = line.strip()
+    if line.startswith("error"):
+      raise Exception(f"Debug server: {line}")
+    return line
+
+  def pause(self):
+    self.onPaused(self.command("pause"))
+
+  def step(self, n=1):
+    self.onPaused(self.command(f"step {n}"))
+
+  def resume(self):
+    self.command("resume")
+    self.paused = False
+
+  def onPaused(self, reply):
+    self.paused = True
+    self.cycle = int(reply.split()[1])
+    self.sample()
+
+  def sample(self):
+    cycle, *values = self.command("values").split()
+    self.values[int(cycle)] = [
+        format(int(v, 16), f"0{w}b") for v, w in zip(values, self.widths)
+    ]
+
+  def query(self, name, step):
+    # Returns the value of signal 'name' at cycle 'step', as a bit string.
+    # Cycles which the simulation ran past without pausing are unknown.
+    if not self.paused:
+      self.pause()
+    if step > self.cycle:
+      self.step(step - self.cycle)
+    values = self.values.get(step)
+    if values is None:
+      return "x"
+    return values[self.ids[name]]
+
+
+class LiveTrace(VCDTrace):
+  """ A trace interface for a running simulation, connected to through the
+  debug server of the simulation at 'address' (host:port). The debug server
+  names its signals as in a trace of the simulation, so the instance hierarchy
+  is indexed as for a VCD trace.
+  """
+
+  # Querying ahead would run the simulation ahead of the user.
+  prefetch = False
+
+  def __init__(self, address):
+    self.filename = address
+    self.signalMap = {}
+    self.top = self.index()
+
+  def load(self):
+    return LiveSimulation(self.filename)
+
+  def pause(self):
+    self.vcd.pause()
+
+  def step(self, n=1):
+    self.vcd.step(n)
+
+  def resume(self):
+    self.vcd.resume()
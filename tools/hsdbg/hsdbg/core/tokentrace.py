@@ -0,0 +1,147 @@
+import struct
+from array import array
+from bisect import bisect_right
+from hsdbg.core.vcdtrace import *
+
+
+class TokenIndex:
+  """ The tokens of a token trace of an HLT simulation (see
+  VerilatorTokenTrace.h). A token trace only holds the cycles at which each
+  handshake channel transacted, and the data value transferred with each
+  token. The channels are presented as the '_valid', '_ready' and '_data'
+  signals of a VCD trace: valid and ready are high in the cycles that a token
+  was transferred, and data holds the value of the last transferred token.
+  """
+
+  MAGIC = b"HLTTOKEN"
+  VERSION = 1
+
+  def __init__(self, filename):
+    with open(filename, "rb") as f:
+      self.parse(memoryview(f.read()))
+
+    self.signals = []
+    # For each signal, the channel which it is part of and its kind.
+    self.ids = {}
+    for i, (name, width) in enumerate(self.channels):
+      kinds = ["valid", "ready"] + (["data"] if width else [])
+      for kind in kinds:
+        signal = f"TOP.{name}_{kind}"
+        self.signals.append(signal)
+        self.ids[signal] = (i, kind)
+
+  def parse(self, buf):
+    if bytes(buf[:8]) != TokenIndex.MAGIC:
+      raise Exception("Not an HLT token trace.")
+    version, numChannels = struct.unpack_from("<II", buf, 8)
+    if version != TokenIndex.VERSION:
+      raise Exception(f"Unsupported token trace version {version}.")
+    offset = 16
+
+    # Name and data width of each channel.
+    self.channels = []
+    for _ in range(numChannels):
+      (length,) = struct.unpack_from("<I", buf, offset)
+      offset += 4
+      name = bytes(buf[offset:offset + length]).decode()
+      offset += length
+      (width,) = struct.unpack_from("<I", buf, offset)
+      offset += 4
+      self.channels.append((name, width))
+
+    # The cycles at which each channel transacted, and the transferred values.
+    self.cycles = [array("Q") for _ in self.channels]
+    self.values = [array("Q") for _ in self.channels]
+    self.begintime = None
+    self.endtime = 0
+
+    chunkHeader = struct.Struct("<IQIII")
+    while offset + chunkHeader.size <= len(buf):
+      numTokens, cycle, cyclesSize, idsSize, dataSize = \
+          chunkHeader.unpack_from(buf, offset)
+      offset += chunkHeader.size
+      end = offset + cyclesSize + idsSize + dataSize
+      if end > len(buf):
+        # The last chunk is still being written by the simulation.
+        break
+      deltas = readVarints(buf, offset, numTokens)
+      ids = readVarints(buf, offset + cyclesSize, numTokens)
+      numData = sum(1 for i in ids if self.channels[i][1])
+      data = iter(readVarints(buf, offset + cyclesSize + idsSize, numData))
+      offset = end
+
+      if self.begintime is None:
+        self.begintime = cycle
+      for delta, i in zip(deltas, ids):
+        cycle += delta
+        self.cycles[i].append(cycle)
+        if self.channels[i][1]:
+          self.values[i].append(next(data))
+      self.endtime = max(self.endtime, cycle)
+
+    if self.begintime is None:
+      self.begintime = 0
+
+  def query(self, name, step):
+    # Returns the value of signal 'name' at cycle 'step', as a bit string.
+    i, kind = self.ids[name]
+    cycles = self.cycles[i]
+    j = bisect_right(cycles, step) - 1
+    if kind != "data":
+      return "1" if j >= 0 and cycles[j] == step else "0"
+    if j < 0:
+      return "x"
+    return format(self.values[i][j], f"0{self.channels[i][1]}b")
+
+  def iterChanges(self, name):
+    # Yields the cycle and value of each change of signal 'name', in order.
+    # Valid and ready rise in the first cycle of each run of consecutive
+    # transfers, and fall in the cycle after it.
+    i, kind = self.ids[name]
+    cycles = self.cycles[i]
+    if kind == "data":
+      width = self.channels[i][1]
+      for cycle, value in zip(cycles, self.values[i]):
+        yield cycle, format(value, f"0{width}b")
+      return
+    last = None
+    for cycle in cycles:
+      if last is not None and cycle <= last + 1:
+        last = cycle
+        continue
+      if last is not None:
+        yield last + 1, "0"
+      yield cycle, "1"
+      last = cycle
+    if last is not None:
+      yield last + 1, "0"
+
+
+def readVarints(buf, offset, n):
+  # Reads 'n' unsigned LEB128 varints from 'buf', starting at 'offset'.
+  values = []
+  for _ in range(n):
+    value = 0
+    shift = 0
+    while True:
+      byte = buf[offset]
+      offset += 1
+      value |= (byte & 0x7f) << shift
+      shift += 7
+      if byte < 0x80:
+        break
+    values.append(value)
+  return values
+
+
+class TokenTrace(VCDTrace):
+  """ A trace interface for the token traces of HLT simulations built with
+  `hlstool --token_trace`. Since only transactions are recorded, channels
+  which are stalled are shown as idle.
+  """
+
+  def __init__(self, filename):
+    super().__init__(filename)
+
+  def load(self):
+    return TokenIndex(self.filename)
@@ -36,6 +36,10 @@ class Trace:
   runtime system.
   """
 
+  # Whether the values of steps ahead of the current step may be queried in the
+  # background.
+  prefetch = True
+
   def __init__(self, filename):
     self.filename = filename
     self.file = open(filename, "r")
@@ -59,6 +63,11 @@ class Trace:
     # step.
     raise NotImplementedError()
 
+  def changes(self, signal):
+    # Returns an iterator over the (step, value) pairs of each change of
+    # 'signal', in order of the steps, for passes over the full trace.
+    raise NotImplementedError()
+
   def getStartTime(self):
     # Returns the first timestep of the simulation
     raise NotImplementedError()
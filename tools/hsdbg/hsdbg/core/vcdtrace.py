@@ -1,12 +1,178 @@
+import os
+import pickle
+import re
+from array import array
+from bisect import bisect_right
 from collections import defaultdict
 from hsdbg.core.trace import *
 
-# @TODO: VCDVCD is very slow for large files since it builds an in-memory
-# representation of the VCD trace. Low hanging fruit could be to index the
-# VCD trace and build a form of "finger table" for correlating step locations
-# to file locations. This can then be used as a basis for a fast runtime
-# forward search for the exact timestep.
-from vcdvcd import VCDVCD
+
+class VCDIndex:
+  """ An index of the value changes of a VCD file, which is built in a single
+  pass over the file and cached next to it (as '<file>.hsdbgidx'). For each
+  signal, the index holds the sorted timesteps at which it changed, and the
+  file offset of each new value. A query binary searches the timesteps of
+  the signal and reads the value from the file, such that the trace itself
+  is never loaded into memory.
+  """
+
+  VERSION = 1
+
+  def __init__(self, filename):
+    self.filename = filename
+    self.file = open(filename, "rb")
+    st = os.stat(filename)
+    self.stamp = (VCDIndex.VERSION, st.st_size, st.st_mtime_ns)
+    self.indexFile = filename + ".hsdbgidx"
+    if not self.loadIndex():
+      self.build()
+      self.storeIndex()
+
+  def loadIndex(self):
+    try:
+      with open(self.indexFile, "rb") as f:
+        index = pickle.load(f)
+    except (OSError, pickle.UnpicklingError, EOFError):
+      return False
+    if index["stamp"] != self.stamp:
+      return False
+    self.__dict__.update(index["data"])
+    return True
+
+  def storeIndex(self):
+    data = {
+        k: getattr(self, k)
+        for k in ["signals", "ids", "changes", "begintime", "endtime"]
+    }
+    try:
+      with open(self.indexFile, "wb") as f:
+        pickle.dump({"stamp": self.stamp, "data": data}, f,
+                    pickle.HIGHEST_PROTOCOL)
+    except OSError:
+      # The index is rebuilt by the next run.
+      pass
+
+  def build(self):
+    # Hierarchical names of the signals, and the identifier of each.
+    self.signals = []
+    self.ids = {}
+    # For each identifier, the timesteps at which it changed and the file
+    # offsets of the new values. Offsets are shifted left by one, and the low
+    # bit is set if the value is a vector (i.e. a token of its own) rather
+    # than a scalar (the first character of a token).
+    self.changes = {}
+    self.begintime = None
+    self.endtime = 0
+
+    f = self.file
+    f.seek(0)
+    offset = 0
+    scopes = []
+    time = 0
+    inHeader = True
+    vectorOffset = None
+    for line in f:
+      lineOffset = offset
+      offset += len(line)
+      if inHeader:
+        tokens = line.split()
+        # Declarations may span multiple lines; accumulate up to '$end'.
+        while tokens and tokens[0] in (b"$scope", b"$var") and \
+            tokens[-1] != b"$end":
+          more = f.readline()
+          offset += len(more)
+          tokens += more.split()
+        if not tokens:
+          continue
+        if tokens[0] == b"$scope":
+          scopes.append(tokens[2].decode())
+        elif tokens[0] == b"$upscope":
+          scopes.pop()
+        elif tokens[0] == b"$var":
+          # $var <type> <size> <id> <reference> [<bit select>] $end
+          id = tokens[3].decode()
+          name = "".join(t.decode() for t in tokens[4:-1])
+          name = ".".join(scopes + [name])
+          self.signals.append(name)
+          self.ids[name] = id
+          self.changes.setdefault(id, (array("q"), array("q")))
+        elif b"$enddefinitions" in tokens:
+          inHeader = False
+        continue
+
+      # Value changes are typically one per line, but a line may hold several
+      # (e.g. within '$dumpvars').
+      for m in re.finditer(rb"\S+", line):
+        token = m.group()
+        c = token[:1]
+        if vectorOffset is not None:
+          # Vector values are followed by their identifier.
+          id = token.decode()
+          valueOffset = vectorOffset << 1 | 1
+          vectorOffset = None
+        elif c == b"#":
+          time = int(token[1:])
+          if self.begintime is None:
+            self.begintime = time
+          self.endtime = time
+          continue
+        elif c == b"$":
+          continue
+        elif c in b"bBrR":
+          vectorOffset = lineOffset + m.start() + 1
+          continue
+        else:
+          id = token[1:].decode()
+          valueOffset = (lineOffset + m.start()) << 1
+        change = self.changes.get(id)
+        if change is None:
+          continue
+        times, offsets = change
+        if times and times[-1] == time:
+          # Only the last value of a timestep is visible.
+          offsets[-1] = valueOffset
+        else:
+          times.append(time)
+          offsets.append(valueOffset)
+
+    if self.begintime is None:
+      self.begintime = 0
+
+  def readToken(self, offset):
+    # Reads the whitespace-delimited token at 'offset' in the file.
+    self.file.seek(offset)
+    token = b""
+    while True:
+      chunk = self.file.read(64)
+      end = re.search(rb"\s", chunk)
+      if end:
+        return token + chunk[:end.start()]
+      if not chunk:
+        return token
+      token += chunk
+
+  def query(self, name, step):
+    # Returns the value of signal 'name' at timestep 'step', as a (bit)
+    # string.
+    times, offsets = self.changes[self.ids[name]]
+    i = bisect_right(times, step) - 1
+    if i < 0:
+      return "x"
+    return self.readValue(offsets[i])
+
+  def iterChanges(self, name):
+    # Yields the timestep and value of each change of signal 'name', in order.
+    times, offsets = self.changes[self.ids[name]]
+    for time, offset in zip(times, offsets):
+      yield time, self.readValue(offset)
+
+  def readValue(self, offset):
+    # Reads the value at the shifted 'offset' of a change (see build).
+    offset, isVector = offset >> 1, offset & 1
+    if isVector:
+      return self.readToken(offset).decode()
+    self.file.seek(offset)
+    return self.file.read(1).decode()
 
 
 def joinVCDName(lhs, rhs):
@@ -51,11 +217,16 @@ class VCDTrace(Trace):
   def query(self, signal, step):
     # A signal value is read from the VCD trace based on its hierarchical
     # name and the step value.
-    return self.vcd[self.signalMap[signal.getHierName()]][step]
+    return self.vcd.query(self.signalMap[signal.getHierName()], step)
+
+  def changes(self, signal):
+    return self.vcd.iterChanges(self.signalMap[signal.getHierName()])
+
+  def load(self):
+    return VCDIndex(self.filename)
 
   def index(self):
-    # We use VCDVCD as the VCD parsing library.
-    self.vcd = VCDVCD(self.filename)
+    self.vcd = self.load()
 
     # Infer top module name
     hier = resolveVCDHierarchy(self.vcd)
@@ -63,6 +234,11 @@ class VCDTrace(Trace):
       raise Exception("Expected exactly one top-level in VCD hierarchy!")
     top = list(hier.keys())[0]
 
+    # Group the signals by the instance which they're in.
+    signalsByInstance = defaultdict(list)
+    for s in self.vcd.signals:
+      signalsByInstance[s.rsplit(".", 1)[0]].append(s)
+
     def indexModule(instanceName, parentInstance):
       # hierarchical name of the instance in the VCD file.
       vcdHierInstanceName = instanceName if not parentInstance else joinVCDName(
@@ -71,15 +247,8 @@ class VCDTrace(Trace):
                           signals=[],
                           parent=parentInstance)
 
-      # Find all items under this instance
-      items = [s for s in self.vcd.signals if s.startswith(vcdHierInstanceName)]
-
-      # Filter those which are in submodules. For this, we just check if
-      # there any any more '.' characters in the name.
-      vcdSignals = [
-          s for s in items
-          if s.replace(f"{vcdHierInstanceName}.", "").count(".") == 0
-      ]
+      # Find all signals directly within this instance.
+      vcdSignals = signalsByInstance.get(vcdHierInstanceName, [])
 
       # Create Signal objects from the VCD signals in this instance.
       signals = []
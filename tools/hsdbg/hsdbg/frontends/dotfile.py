@@ -1,6 +1,7 @@
 from dataclasses import dataclass
 from collections import defaultdict
 from hsdbg.core.model import *
+from hsdbg.core.utils import *
 import tempfile
 import os
 
@@ -66,32 +67,41 @@ class DotFile:
     This is unfortunately not available in any existing graphviz library.
     This class doesn't parse the vcd grammer. Rather, it looks for edges in the
     input file and registers these edges. It then allows the user to add
-    attributes to edges and rewrite the file.
+    attributes to edges, which are applied to the rendered layout of the file
+    rather than to the file itself; see DotModel.
     """
 
   def __init__(self, filename):
     self.rawDot = []  # List of lines
-    self.modifiedDot = []
     self.edgeToLine = {}
     self.lineToEdge = {}
     self.edges = set()
+    # The edges which connect to each node or node port, keyed by the name of
+    # the node (or node + port); see getEdgesByName.
+    self.edgesByName = defaultdict(set)
+    # The attributes added to each edge, keyed by the ID of the edge.
+    self.edgeAttrs = {}
     self.parseDot(filename)
     self.reset()
 
   def reset(self):
-    # Resets the modifiedDot to the rawDot.
-    self.modifiedDot = self.rawDot
+    # Drops the attributes added to the edges.
+    self.edgeAttrs = {}
+
+  def getEdgesByName(self, name):
+    """ Returns the edges whose source or destination is 'name', or whose source
+    + output port or destination + input port is 'name'."""
+    return self.edgesByName.get(name, set())
+
+  @staticmethod
+  def edgeId(edge):
+    """ Returns the ID of 'edge' in the rendered layout of the file."""
+    return f"hsdbg_edge{edge.line}"
 
   def addAttributesToEdge(self, edge, attrs):
     if edge not in self.edges:
       raise Exception(f"Edge not found: {edge}")
-    # Edges are frozen to allow for hashing, so we need to make a copy.
-    edgeAttrs = set(edge.attributes)
-    for attr in attrs:
-      edgeAttrs.add(attr)
-    self.modifiedDot[edge.line] = str(
-        DotEdge(edge.src, edge.dst, edgeAttrs, edge.line,
-                edge.customAttributes))
+    self.edgeAttrs.setdefault(self.edgeId(edge), {}).update(attrs)
 
   def parseCustomAttributes(self, attrString):
     """ Parses custom attributes on a handshake graphviz edge."""
@@ -133,6 +143,14 @@ class DotFile:
     self.edgeToLine[edge] = i
     self.lineToEdge[i] = edge
     self.edges.add(edge)
+    self.edgesByName[src].add(edge)
+    self.edgesByName[dst].add(edge)
+    srcPort = edge.getCustomAttr(CA_OUTPUT)
+    if srcPort:
+      self.edgesByName[joinHierName(src, srcPort)].add(edge)
+    dstPort = edge.getCustomAttr(CA_INPUT)
+    if dstPort:
+      self.edgesByName[joinHierName(dst, dstPort)].add(edge)
 
   def parseDot(self, filename):
     with open(filename, 'r') as f:
@@ -144,6 +162,13 @@ class DotFile:
         self.parseDotEdge(i, line)
 
   def dump(self, path):
-    """ write the modified dot file to path."""
+    """ Writes the dot file to path, with each edge given a stable ID such that
+    it can be found in the rendered layout."""
+    lines = list(self.rawDot)
+    for i, edge in self.lineToEdge.items():
+      lines[i] = str(
+          DotEdge(edge.src, edge.dst,
+                  edge.attributes | {("id", self.edgeId(edge))}, edge.line,
+                  edge.customAttributes))
     with open(path, "w") as f:
-      f.write("".join(self.modifiedDot))
+      f.write("".join(lines))
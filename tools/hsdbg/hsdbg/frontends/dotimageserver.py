@@ -20,8 +20,8 @@ class DotImageServer:
     """ Starts the image server in a separate thread."""
 
     def runServer():
-      # A simple flask application which serves index.html to continuously update
-      # the svg file.
+      # A simple flask application which serves index.html, the svg layout of
+      # the dot file and the state of its edges at the current step.
       log = logging.getLogger('werkzeug')
       log.setLevel(logging.ERROR)
       app = Flask(__name__)
@@ -35,11 +35,19 @@ class DotImageServer:
       def step():
         return jsonify(step=self.dotmodel.currentStep())
 
-      # Serve the svg file on any path request.
+      # The attributes of each edge at the current step. The client applies
+      # these to the layout; see templates/index.html.
+      @app.route("/state")
+      def state():
+        step = self.dotmodel.currentStep()
+        return jsonify(step=step,
+                       view=self.dotmodel.viewName(),
+                       edges=self.dotmodel.getState(step))
+
+      # Serve the svg layout on any other path request.
       @app.route("/<path:path>")
       def serveFile(path):
-        return send_file(self.dotmodel.workingImagePath,
-                         mimetype="image/svg+xml")
+        return send_file(self.dotmodel.layoutPath, mimetype="image/svg+xml")
 
       app.run(host="localhost", port=self.port)
 
@@ -56,6 +64,8 @@ Usage:
     right arrow: step forward 1 timestep in vcd time
     left arrow: step backwards 1 timestep in vcd time
     g <step>: step to a specific step in vcd time
+    h: toggle a heatmap of the utilization of each channel over the run
+    + / -: zoom the heatmap in or out, down to the current step
 
 "Entering interactive mode. Type 'q' to quit."
 """
@@ -74,3 +84,9 @@ Usage:
     elif command == "g":
       step = input("Goto step: ")
       model.setStep(step)
+    elif command == "h":
+      model.toggleHeatmap()
+    elif command == "+":
+      model.zoom(-1)
+    elif command == "-":
+      model.zoom(1)
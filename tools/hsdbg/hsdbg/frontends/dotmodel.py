@@ -3,7 +3,18 @@ from hsdbg.core.utils import *
 from hsdbg.core.model import *
 from hsdbg.frontends.dotimageserver import *
 
+import hashlib
 import subprocess
+import threading
+from collections import OrderedDict
+from concurrent.futures import ThreadPoolExecutor
+
+# Number of steps after the current step whose edge states are computed in the
+# background, such that stepping forward doesn't wait on the trace.
+PREFETCH_STEPS = 8
+
+# Number of steps whose edge states are kept.
+STATE_CACHE_SIZE = 1024
 
 
 class DotModelEdge():
@@ -51,32 +62,86 @@ class DotModel(Model):
     # Maintain the source code of the dot file. Since there aren't any good
     # python libraries for in-place modification of
     self.dotFile = DotFile(dot)
-    self.workingImagePath = self.setupWorkingImage(dot)
 
-    # Ensure the initial state of the working image file.
-    self.dotUpdateFinished()
+    # The layout of the graph does not depend on the simulation step, so it is
+    # rendered once. Steps only restyle the edges of the layout, which is done
+    # by the image server's client.
+    self.layoutPath = self.renderLayout(dot)
+
+    # The edge states of recently visited and prefetched steps. Computing a
+    # state modifies the dot file, so states are computed one at a time.
+    self.states = OrderedDict()
+    self.stateLock = threading.Lock()
+    self.prefetcher = ThreadPoolExecutor(max_workers=1)
 
     # Port to run the image server on.
     self.port = port
 
-  def dotUpdateFinished(self):
-    # Dump the modified dot file to a temporary file.
-    workingDotfile = self.workingImagePath + ".dot"
-    self.dotFile.dump(workingDotfile)
-
-    # Run 'dot' on the file to produce an svg file and place it in the
-    # working image path, updating any viewers that have the file opened.
-    subprocess.call(
-        ["dot", workingDotfile, "-Tsvg", "-o", self.workingImagePath])
-
-    # Reset modifications to original dot file after each update.
-    self.dotFile.reset()
-
-  def setupWorkingImage(self, dotFile):
+  def styleStep(self, step):
+    """Adds the attributes of each edge at 'step' to the dot file."""
+    raise NotImplementedError()
+
+  def stateKey(self, step):
+    """Returns the key of the edge state at 'step'. Steps of the same key share
+    their state, e.g. those within the window of a heatmap."""
+    return step
+
+  def viewName(self):
+    """Returns a description of what the edges show, if they show more than
+    the current step."""
+    return None
+
+  def toggleHeatmap(self):
+    print("\nHeatmaps are not supported by this model.")
+
+  def zoom(self, levels):
+    print("\nHeatmaps are not supported by this model.")
+
+  def getState(self, step):
+    """Returns the attributes of each edge at 'step', keyed by the ID of the
+    edge in the layout."""
+    with self.stateLock:
+      key = self.stateKey(step)
+      if key in self.states:
+        self.states.move_to_end(key)
+        return self.states[key]
+      self.styleStep(step)
+      state = self.dotFile.edgeAttrs
+      self.dotFile.reset()
+      self.states[key] = state
+      if len(self.states) > STATE_CACHE_SIZE:
+        self.states.popitem(last=False)
+      return state
+
+  def updateModel(self):
+    self.getState(self.step)
+    if not self.getTrace().prefetch:
+      return
+    for step in range(self.step + 1, self.step + 1 + PREFETCH_STEPS):
+      if step > self.endTime():
+        break
+      self.prefetcher.submit(self.getState, step)
+
+  def renderLayout(self, dotFile):
+    """Renders the layout of 'dotFile' to an svg file, unless the layout of the
+    same file contents has been rendered before. Returns the path of the svg
+    file."""
+    with open(dotFile, "rb") as f:
+      digest = hashlib.sha1(f.read()).hexdigest()[:16]
     temp_dir = tempfile.gettempdir()
     dotFileName = dotFile.split("/")[-1]
-    temp_path = os.path.join(temp_dir, dotFileName + ".svg")
-    return temp_path
+    svgPath = os.path.join(temp_dir, f"{dotFileName}.{digest}.svg")
+    if os.path.exists(svgPath):
+      return svgPath
+
+    # Render to a temporary file first, such that an interrupted render is not
+    # mistaken for a complete one.
+    layoutDot = svgPath + ".dot"
+    self.dotFile.dump(layoutDot)
+    subprocess.run(["dot", layoutDot, "-Tsvg", "-o", svgPath + ".tmp"],
+                   check=True)
+    os.replace(svgPath + ".tmp", svgPath)
+    return svgPath
 
   def startImageServer(self):
     viewer = DotImageServer(self, self.port)
@@ -0,0 +1,226 @@
+import csv
+import heapq
+import os
+from collections import Counter
+from hsdbg.core.activity import *
+from hsdbg.frontends.handshake.handshake import *
+
+
+class ChannelStats:
+  """ The statistics of a single handshake channel, which are accumulated from
+  the intervals of cycles in which its valid and ready signals are constant.
+  A token is transferred in each cycle in which both are high, and the channel
+  stalls in each cycle in which only valid is.
+  """
+
+  def __init__(self, name, window):
+    self.name = name
+    self.window = window
+    self.transfers = 0
+    self.stallCycles = 0
+    # Transfers and stall cycles of each window of cycles.
+    self.windows = {}
+    # Histogram of the cycles between consecutive transfers.
+    self.gaps = Counter()
+    self.lastTransfer = None
+    # First cycle of the current stall, if the channel is stalled.
+    self.stallStart = None
+
+  def addWindowed(self, begin, end, field):
+    # Adds the cycles [begin, end) to 'field' of the windows that they span.
+    while begin < end:
+      w = begin // self.window
+      windowEnd = min(end, (w + 1) * self.window)
+      self.windows.setdefault(w, [0, 0])[field] += windowEnd - begin
+      begin = windowEnd
+
+  def addInterval(self, begin, end, valid, ready, stalls):
+    """ Accounts for the cycles [begin, end), in which the channel is 'valid'
+    and 'ready'. Stalls which end are passed to 'stalls'.
+    """
+    if begin >= end:
+      return
+    stalled = valid and not ready
+    if not stalled and self.stallStart is not None:
+      stalls(self.name, self.stallStart, begin)
+      self.stallStart = None
+    if valid and ready:
+      if self.lastTransfer is not None:
+        self.gaps[begin - self.lastTransfer] += 1
+      if end - begin > 1:
+        self.gaps[1] += end - begin - 1
+      self.lastTransfer = end - 1
+      self.transfers += end - begin
+      self.addWindowed(begin, end, 0)
+    elif stalled:
+      if self.stallStart is None:
+        self.stallStart = begin
+      self.stallCycles += end - begin
+      self.addWindowed(begin, end, 1)
+
+  def finish(self, end, stalls):
+    # Closes a stall which lasts until the end of the trace.
+    if self.stallStart is not None:
+      stalls(self.name, self.stallStart, end)
+      self.stallStart = None
+
+
+class HandshakeAnalysis:
+  """ Headless analytics of the handshake channels of a trace: the utilization
+  of each channel over time, a histogram of the cycles between the tokens of
+  each channel, and the longest stalls. Channels are resolved from the trace
+  as those of the handshake model (see HandshakeModelNode.resolveBundles).
+  The changes of the valid and ready signals of each channel are walked once,
+  as held by the index of the trace, such that only the rising edges of the
+  clock are held in memory, rather than the values of each cycle (see
+  CycleMap).
+  """
+
+  @staticmethod
+  def name():
+    return "analyze"
+
+  @staticmethod
+  def addArguments(subparser):
+    subparser.add_argument("--vcd",
+                           help="The trace file to use (.vcd or .fst).",
+                           type=str)
+    subparser.add_argument(
+        "--tokens",
+        help="A token trace of the simulation (tokens.bin, see hlstool "
+        "--token_trace), in place of a VCD trace. Token traces hold no "
+        "stalls.",
+        type=str)
+    subparser.add_argument(
+        "--clock",
+        help="The name of the clock signal of the top-level instance. If it "
+        "is not found, each step of the trace is a cycle. default='clock'",
+        type=str,
+        default="clock")
+    subparser.add_argument(
+        "--window",
+        help="The number of cycles of each window of the utilization over "
+        "time. default='1000'",
+        type=int,
+        default=1000)
+    subparser.add_argument(
+        "--top",
+        help="The number of longest stalls to export. default='20'",
+        type=int,
+        default=20)
+    subparser.add_argument(
+        "-o",
+        "--output",
+        help="The directory to write the tables to. default='.'",
+        type=str,
+        default=".")
+    subparser.add_argument(
+        "--format",
+        help="The format of the tables; 'csv' or 'parquet' (requires "
+        "pyarrow). default='csv'",
+        type=str,
+        default="csv")
+
+  def __init__(self, args) -> None:
+    if not args.vcd and not args.tokens:
+      raise ValueError("No vcd file or token trace specified.")
+    if args.window < 1:
+      raise ValueError("Expected a window of at least one cycle.")
+    if args.format not in ("csv", "parquet"):
+      raise ValueError(f"Unknown table format '{args.format}'")
+    self.args = args
+    self.trace = openTrace(args)
+    self.channels = resolveChannels(self.trace)
+    self.cycleMap = CycleMap(self.trace, args.clock)
+    self.numCycles = self.cycleMap.numCycles
+    self.run()
+
+  def run(self):
+    stalls = []
+
+    def addStall(name, begin, end):
+      # Keeps the longest 'top' stalls, of which the shortest is first.
+      entry = (end - begin, begin, name, end)
+      if self.args.top <= 0:
+        return
+      if len(stalls) < self.args.top:
+        heapq.heappush(stalls, entry)
+      elif entry > stalls[0]:
+        heapq.heapreplace(stalls, entry)
+
+    stats = []
+    for channel in self.channels:
+      stat = ChannelStats(channel.dotBaseName(), self.args.window)
+      for begin, end, valid, ready in channelIntervals(
+          self.trace, self.cycleMap, channel.valid, channel.ready):
+        stat.addInterval(begin, end, valid, ready, addStall)
+      stat.finish(self.numCycles, addStall)
+      stats.append(stat)
+
+    self.writeTables(stats, sorted(stalls, reverse=True))
+
+  def writeTables(self, stats, stalls):
+    window = self.args.window
+    tables = {
+        "channels": (["channel", "transfers", "stall_cycles", "utilization"], [
+            (s.name, s.transfers, s.stallCycles,
+             s.transfers / max(self.numCycles, 1)) for s in stats
+        ]),
+        "utilization": ([
+            "channel", "window_start", "window_end", "transfers",
+            "stall_cycles", "utilization"
+        ], [(s.name, w * window, min((w + 1) * window, self.numCycles),
+             transfers, stallCycles,
+             transfers / max(min(window, self.numCycles - w * window), 1))
+            for s in stats
+            for w, (transfers, stallCycles) in sorted(s.windows.items())]),
+        "interarrival": (["channel", "cycles", "count"],
+                         [(s.name, gap, count) for s in stats
+                          for gap, count in sorted(s.gaps.items())]),
+        "stalls": (["channel", "start", "end", "cycles"],
+                   [(name, begin, end, length)
+                    for length, begin, name, end in stalls]),
+    }
+    writeTables(tables, self.args.output, self.args.format)
+
+
+def resolveChannels(trace):
+  # Returns the handshake bundles of all instances of the trace.
+  channels = []
+
+  def visit(instance):
+    node = HandshakeModelNode(signals=instance.signals, instance=instance)
+    node.resolveBundles()
+    channels.extend(node.edges)
+    for child in instance.children:
+      visit(child)
+
+  visit(trace.getTopInstance())
+  return channels
+
+
+def writeTables(tables, output, format):
+  # Writes each table of 'tables', which maps the name of each table to its
+  # header and rows, to 'output' in 'format'.
+  os.makedirs(output, exist_ok=True)
+  for name, (header, rows) in tables.items():
+    path = os.path.join(output, f"{name}.{format}")
+    if format == "csv":
+      with open(path, "w", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerow(header)
+        writer.writerows(rows)
+    else:
+      writeParquet(path, header, rows)
+    print(f"Wrote {len(rows)} rows to {path}")
+
+
+def writeParquet(path, header, rows):
+  try:
+    import pyarrow
+    import pyarrow.parquet
+  except ImportError:
+    raise Exception("pyarrow is needed to write Parquet tables.")
+  columns = list(zip(*rows)) if rows else [[] for _ in header]
+  table = pyarrow.table({h: list(c) for h, c in zip(header, columns)})
+  pyarrow.parquet.write_table(table, path)
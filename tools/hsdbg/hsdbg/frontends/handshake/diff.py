@@ -0,0 +1,188 @@
+import argparse
+from itertools import zip_longest
+from hsdbg.frontends.handshake.analysis import *
+
+
+def tokenCycles(trace, cycleMap, channel):
+  # Yields the cycle of each token transferred over 'channel', in order.
+  for begin, end, valid, ready in channelIntervals(trace, cycleMap,
+                                                   channel.valid,
+                                                   channel.ready):
+    if valid and ready:
+      yield from range(begin, end)
+
+
+def openTraceFile(filename, clock):
+  """ Opens a trace for diffing, as a token trace if the file starts with the
+  magic of token traces, and as a VCD or FST trace otherwise. Returns the
+  trace, along with its channels by name and its cycle map.
+  """
+  with open(filename, "rb") as f:
+    magic = f.read(len(TokenIndex.MAGIC))
+  isTokens = magic == TokenIndex.MAGIC
+  trace = openTrace(
+      argparse.Namespace(vcd=None if isTokens else filename,
+                         tokens=filename if isTokens else None))
+  channels = {c.dotBaseName(): c for c in resolveChannels(trace)}
+  return trace, channels, CycleMap(trace, clock)
+
+
+class ChannelDiff:
+  """ The divergence of the tokens of a single channel between two runs. The
+  k-th token of the channel in one run is aligned with its k-th token in the
+  other; the slip of a token is the number of cycles by which it was
+  transferred later in the second run than in the first.
+  """
+
+  def __init__(self, name):
+    self.name = name
+    self.tokens = [0, 0]
+    # The index of the first token whose cycles differ, along with its cycles
+    # in each run (None if the run transferred fewer tokens).
+    self.firstToken = None
+    self.firstCycles = None
+    self.finalSlip = 0
+
+  def divergence(self):
+    # The earliest cycle of the first diverging token, in either run.
+    return min(c for c in self.firstCycles if c is not None)
+
+
+class HandshakeDiff:
+  """ Compares the token timing of the handshake channels of two traces of the
+  same kernel, e.g. before and after an optimization, to locate where their
+  cycle counts diverge. The tokens of each channel are aligned by their
+  sequence numbers, and the channels are reported in the order of the cycle
+  at which their first token diverged. The slip of the tokens over time is
+  accumulated per window of cycles of the first run. Like 'hsdbg analyze', each
+  trace is read in a single pass over the changes of each channel, as held by
+  the index of the trace.
+  """
+
+  @staticmethod
+  def name():
+    return "diff"
+
+  @staticmethod
+  def addArguments(subparser):
+    subparser.add_argument(
+        "before",
+        help="The trace of the first run (.vcd, .fst, or a token trace of "
+        "hlstool --token_trace).",
+        type=str)
+    subparser.add_argument(
+        "after",
+        help="The trace of the second run, of the same format.",
+        type=str)
+    subparser.add_argument(
+        "--clock",
+        help="The name of the clock signal of the top-level instance. If it "
+        "is not found, each step of the trace is a cycle. default='clock'",
+        type=str,
+        default="clock")
+    subparser.add_argument(
+        "--window",
+        help="The number of cycles of the first run of each window of the "
+        "slip over time. default='1000'",
+        type=int,
+        default=1000)
+    subparser.add_argument(
+        "--top",
+        help="The number of diverging channels to print. default='10'",
+        type=int,
+        default=10)
+    subparser.add_argument(
+        "-o",
+        "--output",
+        help="The directory to write the tables to. default='.'",
+        type=str,
+        default=".")
+    subparser.add_argument(
+        "--format",
+        help="The format of the tables; 'csv' or 'parquet' (requires "
+        "pyarrow). default='csv'",
+        type=str,
+        default="csv")
+
+  def __init__(self, args) -> None:
+    if args.window < 1:
+      raise ValueError("Expected a window of at least one cycle.")
+    if args.format not in ("csv", "parquet"):
+      raise ValueError(f"Unknown table format '{args.format}'")
+    self.args = args
+    self.runs = [
+        openTraceFile(args.before, args.clock),
+        openTraceFile(args.after, args.clock)
+    ]
+    self.run()
+
+  def run(self):
+    (traceA, channelsA, cyclesA), (traceB, channelsB, cyclesB) = self.runs
+    window = self.args.window
+    # The tokens, summed slip, and minimum and maximum slip of the tokens of
+    # each window of cycles of the first run.
+    windows = {}
+    diffs = []
+    for name in sorted(channelsA.keys() & channelsB.keys()):
+      diff = ChannelDiff(name)
+      for a, b in zip_longest(tokenCycles(traceA, cyclesA, channelsA[name]),
+                              tokenCycles(traceB, cyclesB, channelsB[name])):
+        diff.tokens[0] += a is not None
+        diff.tokens[1] += b is not None
+        if diff.firstToken is None and a != b:
+          diff.firstToken = diff.tokens[0 if a is not None else 1] - 1
+          diff.firstCycles = (a, b)
+        if a is None or b is None:
+          continue
+        slip = b - a
+        diff.finalSlip = slip
+        w = windows.setdefault(a // window, [0, 0, slip, slip])
+        w[0] += 1
+        w[1] += slip
+        w[2] = min(w[2], slip)
+        w[3] = max(w[3], slip)
+      diffs.append(diff)
+
+    diverged = sorted((d for d in diffs if d.firstToken is not None),
+                      key=lambda d: (d.divergence(), d.name))
+    self.report(diverged, cyclesA.numCycles, cyclesB.numCycles)
+    for name in sorted(channelsA.keys() ^ channelsB.keys()):
+      run = "first" if name in channelsA else "second"
+      print(f"Channel {name} is only in the {run} trace.")
+    self.writeTables(diffs, windows)
+
+  def report(self, diverged, numCyclesA, numCyclesB):
+    print(f"The first run took {numCyclesA} cycles, and the second "
+          f"{numCyclesB} ({numCyclesB - numCyclesA:+d}).")
+    if not diverged:
+      print("The token timing of all channels is identical.")
+      return
+    print(f"{len(diverged)} channels diverged; the first are:")
+    for d in diverged[:max(self.args.top, 0)]:
+      a, b = d.firstCycles
+      print(f"  {d.name}: token {d.firstToken} at cycle "
+            f"{'-' if a is None else a} / {'-' if b is None else b}, "
+            f"{d.tokens[0]} / {d.tokens[1]} tokens, final slip "
+            f"{d.finalSlip:+d}")
+
+  def writeTables(self, diffs, windows):
+    window = self.args.window
+
+    def cell(value):
+      # Missing values are written as empty cells.
+      return "" if value is None else value
+
+    tables = {
+        "divergence": ([
+            "channel", "tokens_before", "tokens_after", "first_token",
+            "cycle_before", "cycle_after", "final_slip"
+        ], [(d.name, d.tokens[0], d.tokens[1], cell(d.firstToken),
+             *(cell(c) for c in (d.firstCycles or (None, None))), d.finalSlip)
+            for d in diffs]),
+        "slip": ([
+            "window_start", "window_end", "tokens", "mean_slip", "min_slip",
+            "max_slip"
+        ], [(w * window, (w + 1) * window, tokens, total / tokens, low, high)
+            for w, (tokens, total, low, high) in sorted(windows.items())]),
+    }
+    writeTables(tables, self.args.output, self.args.format)
@@ -1,7 +1,12 @@
 from hsdbg.frontends.dotmodel import *
 from hsdbg.core.vcdtrace import *
+from hsdbg.core.fsttrace import *
+from hsdbg.core.livetrace import *
+from hsdbg.core.tokentrace import *
+from hsdbg.core.activity import *
 from hsdbg.frontends.dotfile import *
 from hsdbg.core.utils import *
+import colorsys
 
 
 class HandshakeModelEdge(DotModelEdge):
@@ -23,42 +28,21 @@ class HandshakeModelEdge(DotModelEdge):
         "_valid")[0]
     return dotName
 
-  def resolveToDot(self, dotEdges):
+  def resolveToDot(self, dotFile):
+    """ Resolves the dot edge of this handshake bundle through the edge name
+    index of 'dotFile'. An edge matches if its source or destination is the
+    bundle itself; this is true for in- and output variables which, due to the
+    single-use requirement of handshake circuits should only ever have 1 edge
+    with the variable as a source or destination. Otherwise, an edge matches
+    if its source + source port or destination + sink port is the bundle.
     """
-    Filters the 
-    """
-    # First, locate all of the candidate edges. These are the edges which
-    # originate from the source of this handshake bundle.
-    basename = self.dotBaseName()
-
-    def checkEdge(edge):
-      # Check if there exists a direct name match; this is true for in- and output variables
-      # which, due to the single-use requirement of handshake circuits should
-      # only ever have 1 edge with the variable as a source or destination.
-      if edge.src == basename or edge.dst == basename:
-        return True
-
-      # Check if there exists an edge where the edge basename + source port or basename + sinkport
-      # matches the handshake bundle basename.
-      srcPort = edge.getCustomAttr(CA_OUTPUT)
-      if srcPort and joinHierName(edge.src, srcPort) == basename:
-        return edge
-
-      dstPort = edge.getCustomAttr(CA_INPUT)
-      if dstPort and joinHierName(edge.dst, dstPort) == basename:
-        return edge
-
-      return None
-
-    # A bit of course filtering to disregard things which we know cannot be
-    # this edge (edges of other parent modules).
-    candidates = [e for e in dotEdges if checkEdge(e)]
+    candidates = dotFile.getEdgesByName(self.dotBaseName())
 
     if len(candidates) == 0:
       # Could not resolve a .dot edge to the handshake bundle.
       return
     elif len(candidates) == 1:
-      self.edge = candidates[0]
+      self.edge = next(iter(candidates))
 
   def updateDot(self, trace, step, dot):
     """ Creates a set of attributes that are to be added to the dot edge to
@@ -92,6 +76,27 @@ class HandshakeModelEdge(DotModelEdge):
     # Add the attributes to the dot edge object.
     dot.addAttributesToEdge(self.edge, attrs)
 
+  def updateHeatmap(self, activity, level, cycle, dot):
+    """ Colors the dot edge by the utilization of the bundle within the window
+    of 'level' which holds 'cycle', from blue (idle) to red (firing in every
+    cycle).
+    """
+    if self.edge == None:
+      return
+    fired, stalled = activity.query(self.dotBaseName(), level, cycle)
+    begin, end = activity.window(level, cycle)
+    cycles = max(end - begin, 1)
+    utilization = fired / cycles
+    r, g, b = colorsys.hsv_to_rgb((1 - utilization) * 2 / 3, 1, 0.9)
+    label = f"{utilization:.0%}"
+    if stalled:
+      label += f" ({stalled / cycles:.0%} stalled)"
+    dot.addAttributesToEdge(
+        self.edge, [("color", f"#{int(r * 255):02x}{int(g * 255):02x}"
+                     f"{int(b * 255):02x}"),
+                    ("penwidth", f"{1 + 4 * utilization:.1f}"),
+                    ("label", label)])
+
 
 class HandshakeModelNode(DotModelNode):
 
@@ -113,7 +118,15 @@ class HandshakeModelNode(DotModelNode):
   def getHierName(self):
     return self.instance.getHierName()
 
-  def resolve(self, dotEdges):
+  def resolve(self, dotFile):
+    """ Identifies the handshake bundles of this node (see resolveBundles), and
+    resolves them to the edges in the dot file.
+    """
+    self.resolveBundles()
+    for edge in self.edges:
+      edge.resolveToDot(dotFile)
+
+  def resolveBundles(self):
     """ Identifies handshake bundle signals based on the set of VCD signals provided
     to this model node, and creates HandshakeModelEdge's from these.
 
@@ -161,10 +174,6 @@ class HandshakeModelNode(DotModelNode):
                                ready=readySig,
                                data=dataSig))
 
-      # Resolve bundles to the edges in the dot file.
-      for edge in self.edges:
-        edge.resolveToDot(dotEdges)
-
   def updateDot(self, trace, step, dot):
     # Update the state of the edges
     for edge in self.edges:
@@ -173,6 +182,31 @@ class HandshakeModelNode(DotModelNode):
     for child in self.children:
       child.updateDot(trace, step, dot)
 
+  def updateHeatmap(self, activity, level, cycle, dot):
+    for edge in self.edges:
+      edge.updateHeatmap(activity, level, cycle, dot)
+
+    for child in self.children:
+      child.updateHeatmap(activity, level, cycle, dot)
+
+  def getBundles(self):
+    # Returns the handshake bundles of this node and its children.
+    bundles = list(self.edges)
+    for child in self.children:
+      bundles += child.getBundles()
+    return bundles
+
+
+def openTrace(args):
+  """ Opens the trace given by the --vcd, --live or --tokens arguments. """
+  if getattr(args, "live", None):
+    return LiveTrace(args.live)
+  if args.tokens:
+    return TokenTrace(args.tokens)
+  if args.vcd.endswith(".fst"):
+    return FSTTrace(args.vcd)
+  return VCDTrace(args.vcd)
+
 
 class HandshakeModel(DotModel):
 
@@ -183,7 +217,26 @@ class HandshakeModel(DotModel):
   @staticmethod
   def addArguments(subparser):
     # Initialize handshake arguments
-    subparser.add_argument("--vcd", help="The vcdfile to use.", type=str)
+    subparser.add_argument("--vcd",
+                           help="The trace file to use (.vcd or .fst).",
+                           type=str)
+    subparser.add_argument(
+        "--live",
+        help="The debug server of a running simulation to connect to "
+        "(host:port), in place of a trace file.",
+        type=str)
+    subparser.add_argument(
+        "--tokens",
+        help="A token trace of the simulation (tokens.bin, see hlstool "
+        "--token_trace), in place of a VCD trace.",
+        type=str)
+    subparser.add_argument(
+        "--clock",
+        help="The name of the clock signal of the top-level instance, by "
+        "which the cycles of heatmaps are counted. If it is not found, each "
+        "step of the trace is a cycle. default='clock'",
+        type=str,
+        default="clock")
 
     # Initialize dot model arguments
     DotModel.addArguments(subparser)
@@ -191,12 +244,20 @@ class HandshakeModel(DotModel):
   def __init__(self, args) -> None:
     super().__init__(dot=args.dot, port=args.port)
 
-    if not args.vcd:
-      raise ValueError("No vcd file specified.")
+    if not args.vcd and not args.live and not args.tokens:
+      raise ValueError("No vcd file, token trace or live simulation specified.")
 
-    self.trace = VCDTrace(args.vcd)
+    self.trace = openTrace(args)
+    self.clock = args.clock
     self.resolve()
 
+    # The activity summary of the trace, which is built once a heatmap is
+    # first shown, and the level of the shown heatmap, if any (see
+    # ActivitySummary.window).
+    self.cycleMap = None
+    self.activity = None
+    self.heatmapLevel = None
+
     # Go!
     self.startImageServer()
 
@@ -216,21 +277,79 @@ class HandshakeModel(DotModel):
 
       # Resolve the node - this is where the magic happens! associate handshake
       # signal bundles to edges in the .dot file.
-      node.resolve(dotEdges=self.dotFile.edges)
+      node.resolve(dotFile=self.dotFile)
       for childInstance in instance.children:
         node.children.append(createModelNode(childInstance))
       return node
 
     self.topNode = createModelNode(self.getTrace().getTopInstance())
 
-  def updateModel(self):
-    """ Updates the model based on the current trace step. """
+  def styleStep(self, step):
+    """ Styles the dot file based on the given trace step. """
 
-    # Updating is performed recursively through the top model node.
+    # Styling is performed recursively through the top model node.
     # Each node will instruct its associated edges to modify the state of
     # the DotFile object.
-    self.topNode.updateDot(self.trace, self.step, self.dotFile)
+    if self.heatmapLevel is not None:
+      self.topNode.updateHeatmap(self.activity, self.heatmapLevel,
+                                 self.cycleMap.cycleOf(step), self.dotFile)
+      return
+    self.topNode.updateDot(self.trace, step, self.dotFile)
+
+  def stateKey(self, step):
+    if self.heatmapLevel is None:
+      return step
+    begin, _ = self.activity.window(self.heatmapLevel,
+                                    self.cycleMap.cycleOf(step))
+    return ("heatmap", self.heatmapLevel, begin)
 
-    # Finally, dump the modified dot file through the DotModel. This will
-    # also reset the dot object to a clean state, ready for the next step.
-    self.dotUpdateFinished()
+  def viewName(self):
+    if self.heatmapLevel is None:
+      return None
+    begin, end = self.activity.window(self.heatmapLevel,
+                                      self.cycleMap.cycleOf(self.step))
+    return f"utilization of cycles {begin}-{end - 1}"
+
+  def loadActivity(self):
+    # Builds the activity summary of the trace, unless it has been cached.
+    if self.activity:
+      return True
+    if isinstance(self.trace, LiveTrace):
+      print("\nHeatmaps need a full trace, rather than a live simulation.")
+      return False
+    print("\nSummarizing the activity of the trace...", flush=True)
+    self.cycleMap = CycleMap(self.trace, self.clock)
+    channels = {
+        b.dotBaseName(): (b.valid, b.ready) for b in self.topNode.getBundles()
+    }
+    self.activity = ActivitySummary(self.trace, self.cycleMap, channels)
+    return True
+
+  def toggleHeatmap(self):
+    # A heatmap is first shown over the whole run.
+    if self.heatmapLevel is not None:
+      level = None
+    elif self.loadActivity():
+      level = len(ActivitySummary.LEVELS)
+    else:
+      return
+    self.setHeatmapLevel(level)
+
+  def zoom(self, levels):
+    # Zooms out by 'levels'. Zooming in from the finest level shows the
+    # current step, and zooming out from it shows the finest level.
+    if self.heatmapLevel is None:
+      if levels <= 0 or not self.loadActivity():
+        return
+      level = levels - 1
+    else:
+      level = self.heatmapLevel + levels
+    level = min(level, len(ActivitySummary.LEVELS))
+    self.setHeatmapLevel(level if level >= 0 else None)
+
+  def setHeatmapLevel(self, level):
+    # States are computed under the state lock, which the level is thus
+    # changed under as well.
+    with self.stateLock:
+      self.heatmapLevel = level
+    self.updateModel()
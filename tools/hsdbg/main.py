@@ -19,6 +19,8 @@ runs a simple web page which will automatically update the shown image.
 """
 
 from hsdbg.frontends.handshake.handshake import *
+from hsdbg.frontends.handshake.analysis import *
+from hsdbg.frontends.handshake.diff import *
 
 if __name__ == "__main__":
   parser = argparse.ArgumentParser(
@@ -35,6 +37,8 @@ if __name__ == "__main__":
     targets[type.name()] = type
 
   addTarget(HandshakeModel)
+  addTarget(HandshakeAnalysis)
+  addTarget(HandshakeDiff)
 
   # Parse args
   args = parser.parse_args()
@@ -6,16 +6,23 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file implements the mlir-resolve tool. The tool will, given two input
-// files, resolve any private symbols of file 1 which are defined in file 2, and
-// output the resulting module.
+// This file implements the mlir-resolve tool. The tool will, given an input
+// file 1 and any number of library files 2, resolve any private symbols of file
+// 1 which are defined in a file 2, and output the resulting module. Functions
+// of the libraries which are referenced by a resolved function are pulled in as
+// well. Inputs may be textual MLIR or MLIR bytecode. With --strip-dead, the
+// functions and globals which are unreachable from the entry points are removed
+// from the output once resolved.
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Bytecode/BytecodeWriter.h"
 #include "mlir/IR/BlockAndValueMapping.h"
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/MLIRContext.h"
+#include "mlir/IR/SymbolTable.h"
 #include "mlir/Parser/Parser.h"
+#include "mlir/Support/FileUtilities.h"
 
 #include "circt/Dialect/FIRRTL/FIRRTLDialect.h"
 #include "circt/Dialect/Handshake/HandshakeDialect.h"
@@ -27,6 +34,8 @@
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/TypeSwitch.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
@@ -35,6 +44,7 @@
 #include "llvm/Support/InitLLVM.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ToolOutputFile.h"
 
 #include <iostream>
 
@@ -45,8 +55,25 @@ using namespace func;
 
 static cl::opt<std::string> inputFile1("file1", cl::Required,
                                        cl::desc("<first file>"), cl::init("-"));
-static cl::opt<std::string>
-    inputFile2("file2", cl::Optional, cl::desc("<second file>"), cl::init("-"));
+static cl::list<std::string>
+    inputFiles2("file2", cl::ZeroOrMore,
+                cl::desc("<second file>; may be given multiple times. Defaults "
+                         "to stdin."));
+static cl::opt<std::string> outputFilename("o", cl::desc("Output filename"),
+                                           cl::value_desc("filename"),
+                                           cl::init("-"));
+static cl::opt<bool> emitBytecode("emit-bytecode",
+                                  cl::desc("Emit the module as MLIR bytecode"),
+                                  cl::init(false));
+static cl::opt<bool> stripDead(
+    "strip-dead",
+    cl::desc("Remove the functions and globals which are not reachable from "
+             "the entry points (--entry), or from other top-level operations, "
+             "once symbols have been resolved"),
+    cl::init(false));
+static cl::list<std::string> entryPoints(
+    "entry", cl::ZeroOrMore, cl::CommaSeparated,
+    cl::desc("The entry points of --strip-dead. Defaults to main."));
 
 /// Container for the current set of loaded modules.
 static SmallVector<mlir::OwningOpRef<mlir::ModuleOp>> modules;
@@ -71,6 +98,46 @@ static ModuleOp getModule(MLIRContext *ctx, StringRef fn) {
   return modules.back().get();
 }
 
+/// Returns true if 'op' is a top-level symbol which --strip-dead removes when
+/// it is unreachable.
+static bool isStrippable(Operation *op) {
+  return isa<FuncOp, LLVM::LLVMFuncOp, memref::GlobalOp, LLVM::GlobalOp>(op);
+}
+
+/// Removes the functions and globals of 'mod' which are not reachable through
+/// symbol uses from the functions 'entries', nor from the other top-level ops
+/// of 'mod', such as global constructors.
+static void stripDeadSymbols(ModuleOp mod, ArrayRef<std::string> entries) {
+  SymbolTable symbolTable(mod);
+  SmallPtrSet<Operation *, 16> live;
+  SmallVector<Operation *> worklist;
+  auto markLive = [&](Operation *op) {
+    if (op && live.insert(op).second)
+      worklist.push_back(op);
+  };
+  for (auto &entry : entries) {
+    Operation *op = symbolTable.lookup(entry);
+    if (!op)
+      errs() << "Warning: Entry point '" << entry << "' was not found\n";
+    markLive(op);
+  }
+  for (Operation &op : *mod.getBody())
+    if (!isStrippable(&op))
+      markLive(&op);
+
+  while (!worklist.empty()) {
+    auto uses = SymbolTable::getSymbolUses(worklist.pop_back_val());
+    if (!uses)
+      continue;
+    for (auto &use : *uses)
+      markLive(symbolTable.lookup(use.getSymbolRef().getRootReference()));
+  }
+
+  for (Operation &op : llvm::make_early_inc_range(*mod.getBody()))
+    if (isStrippable(&op) && !live.contains(&op))
+      op.erase();
+}
+
 static void registerDialects(mlir::DialectRegistry &registry) {
   registry.insert<mlir::memref::MemRefDialect>();
   registry.insert<mlir::cf::ControlFlowDialect>();
@@ -93,26 +160,74 @@ int main(int argc, char **argv) {
   auto mod1 = getModule(&context, inputFile1);
   if (!mod1)
     return 1;
-  auto mod2 = getModule(&context, inputFile2);
-  if (!mod2)
-    return 1;
 
-  for (mlir::func::FuncOp funcOp : mod1.getOps<mlir::func::FuncOp>()) {
-    if (funcOp.isPrivate()) {
-      auto mod2FuncOps = mod2.getOps<mlir::func::FuncOp>();
-      auto it = llvm::find_if(mod2FuncOps, [&](mlir::func::FuncOp f2FuncOp) {
-        return f2FuncOp.getName() == funcOp.getName() &&
-               f2FuncOp.getFunctionType() == funcOp.getFunctionType();
-      });
-      if (it != mod2FuncOps.end()) {
-        // Found a match, clone the definition from f2 into f1
-        BlockAndValueMapping m;
-        FuncOp f = *it;
-        f.cloneInto(funcOp, m);
-        funcOp.setPublic();
-      }
+  // Index the function definitions of the libraries by name. If multiple
+  // libraries define a function, the first definition is used.
+  llvm::StringMap<FuncOp> definitions;
+  if (inputFiles2.empty())
+    inputFiles2.push_back("-");
+  for (auto &fn : inputFiles2) {
+    auto mod2 = getModule(&context, fn);
+    if (!mod2)
+      return 1;
+    for (FuncOp f : mod2.getOps<FuncOp>())
+      if (!f.isExternal())
+        definitions.try_emplace(f.getName(), f);
+  }
+
+  // Resolve the private declarations of file 1. Resolved functions may
+  // reference other functions of the libraries, which are then cloned into file
+  // 1 as well.
+  SymbolTable symbolTable(mod1);
+  SmallVector<FuncOp> worklist;
+  for (FuncOp funcOp : mod1.getOps<FuncOp>()) {
+    if (!funcOp.isPrivate() || !funcOp.isExternal())
+      continue;
+    auto it = definitions.find(funcOp.getName());
+    if (it == definitions.end() ||
+        it->second.getFunctionType() != funcOp.getFunctionType())
+      continue;
+    // Found a match, clone the definition from f2 into f1
+    BlockAndValueMapping m;
+    it->second.cloneInto(funcOp, m);
+    funcOp.setPublic();
+    worklist.push_back(funcOp);
+  }
+
+  while (!worklist.empty()) {
+    FuncOp funcOp = worklist.pop_back_val();
+    auto uses = SymbolTable::getSymbolUses(&funcOp.getBody());
+    if (!uses)
+      continue;
+    for (auto &use : *uses) {
+      StringAttr name = use.getSymbolRef().getRootReference();
+      if (symbolTable.lookup(name))
+        continue;
+      auto it = definitions.find(name.getValue());
+      if (it == definitions.end())
+        continue;
+      FuncOp clone = it->second.clone();
+      clone.setPrivate();
+      symbolTable.insert(clone);
+      worklist.push_back(clone);
     }
   }
 
-  mod1->print(llvm::outs());
+  if (stripDead) {
+    if (entryPoints.empty())
+      entryPoints.push_back("main");
+    stripDeadSymbols(mod1, entryPoints);
+  }
+
+  std::string errorMessage;
+  auto output = mlir::openOutputFile(outputFilename, &errorMessage);
+  if (!output) {
+    errs() << errorMessage << "\n";
+    return 1;
+  }
+  if (emitBytecode)
+    (void)mlir::writeBytecodeToFile(mod1, output->os());
+  else
+    mod1->print(output->os());
+  output->keep();
 }